@@ -0,0 +1,119 @@
+#if !defined(ActiveLaneLimit_h)
+#define ActiveLaneLimit_h
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace cce::tf {
+  /**
+     Hands out a fixed number of tokens. A Lane holds one while it processes
+     an event so that with more Lanes than threads only as many events as
+     there are tokens compete for the CPU. The other Lanes are parked in a
+     first in, first out queue and resumed as tokens are released. Reads are
+     not limited so parked Lanes still have their events read.
+
+     The number of tokens can be changed while Lanes run. Added tokens resume
+     parked Lanes at once, removed ones are taken from the free tokens and
+     otherwise from the next releases.
+   */
+  class ActiveLaneLimit {
+  public:
+    explicit ActiveLaneLimit(unsigned int iNTokens): available_{iNTokens}, nTokens_{iNTokens} {}
+
+    ActiveLaneLimit(ActiveLaneLimit const&) = delete;
+    ActiveLaneLimit& operator=(ActiveLaneLimit const&) = delete;
+
+    //iResume is called now if a token is free, else by the release which hands it the token
+    void acquire(std::function<void()> iResume) {
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if(available_ == 0) {
+          parked_.emplace_back(std::move(iResume), std::chrono::steady_clock::now());
+          ++nParked_;
+          if(parked_.size() > maxParked_) {
+            maxParked_ = parked_.size();
+          }
+          return;
+        }
+        --available_;
+      }
+      iResume();
+    }
+
+    void release() {
+      std::function<void()> next;
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if(owed_ != 0) {
+          //the token was removed by setNTokens
+          --owed_;
+          return;
+        }
+        if(parked_.empty()) {
+          ++available_;
+          return;
+        }
+        next = std::move(parked_.front().first);
+        parkedTime_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - parked_.front().second);
+        parked_.pop_front();
+      }
+      next();
+    }
+
+    void setNTokens(unsigned int iNTokens) {
+      std::vector<std::function<void()>> resume;
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if(iNTokens >= nTokens_) {
+          unsigned int added = iNTokens - nTokens_;
+          auto const repaid = std::min(added, owed_);
+          owed_ -= repaid;
+          available_ += added - repaid;
+          auto const now = std::chrono::steady_clock::now();
+          while(available_ != 0 and not parked_.empty()) {
+            --available_;
+            resume.push_back(std::move(parked_.front().first));
+            parkedTime_ += std::chrono::duration_cast<std::chrono::microseconds>(now - parked_.front().second);
+            parked_.pop_front();
+          }
+        } else {
+          owed_ += nTokens_ - iNTokens;
+          auto const taken = std::min(available_, owed_);
+          available_ -= taken;
+          owed_ -= taken;
+        }
+        nTokens_ = iNTokens;
+      }
+      for(auto& r: resume) {
+        r();
+      }
+    }
+
+    unsigned int nTokens() const {
+      std::lock_guard<std::mutex> guard(mutex_);
+      return nTokens_;
+    }
+    //the following are only meaningful once all tokens were released
+    unsigned long long nParked() const { return nParked_; }
+    std::size_t maxParked() const { return maxParked_; }
+    //summed over the parked Lanes
+    std::chrono::microseconds parkedTime() const { return parkedTime_; }
+
+  private:
+    mutable std::mutex mutex_;
+    unsigned int available_;
+    unsigned int nTokens_;
+    //tokens removed by setNTokens while held by Lanes
+    unsigned int owed_ = 0;
+    std::deque<std::pair<std::function<void()>, std::chrono::steady_clock::time_point>> parked_;
+    unsigned long long nParked_ = 0;
+    std::size_t maxParked_ = 0;
+    std::chrono::microseconds parkedTime_ = std::chrono::microseconds::zero();
+  };
+}
+#endif
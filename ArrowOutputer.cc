@@ -0,0 +1,287 @@
+#include "ArrowOutputer.h"
+#include "OutputerFactory.h"
+#include "ConfigurationParameters.h"
+#include "UnrolledSerializerWrapper.h"
+#include "FixedLayoutSerializerWrapper.h"
+#include "SerializerWrapper.h"
+#include "summarize_serializers.h"
+#include "summarize_queue.h"
+
+#include "TClass.h"
+#include "TVirtualCollectionProxy.h"
+
+#include "arrow/util/compression.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+using namespace cce::tf;
+using namespace cce::tf::arrowcolumns;
+
+ArrowOutputer::ArrowOutputer(std::string const& iFileName, unsigned int iNLanes, Format iFormat, arrow::Compression::type iCompression,
+                             int iCompressionLevel, pds::Serialization iSerialization, unsigned int iBatchSize):
+  fileName_{iFileName},
+  format_{iFormat},
+  compression_{iCompression},
+  compressionLevel_{iCompressionLevel},
+  serialization_{iSerialization},
+  batchSize_{std::max(iBatchSize, 1U)},
+  file_{check(arrow::io::FileOutputStream::Open(iFileName), "ArrowOutputer opening the file")},
+  serializers_{std::size_t(iNLanes)},
+  retrievers_(iNLanes, nullptr),
+  serialTime_{std::chrono::microseconds::zero()},
+  writeTime_{std::chrono::microseconds::zero()},
+  parallelTime_{iNLanes}
+{
+  runs_.reserve(batchSize_);
+  lumis_.reserve(batchSize_);
+  events_.reserve(batchSize_);
+}
+
+ArrowOutputer::~ArrowOutputer() = default;
+
+void ArrowOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) {
+  auto& s = serializers_[iLaneIndex];
+  switch(serialization_) {
+  case pds::Serialization::kRoot:
+    {   s = SerializeStrategy::make<SerializeProxy<SerializerWrapper>>(); break; }
+  case pds::Serialization::kRootUnrolled:
+    {   s = SerializeStrategy::make<SerializeProxy<UnrolledSerializerWrapper>>(); break; }
+  case pds::Serialization::kNativeUnrolled:
+    {   s = SerializeStrategy::make<SerializeProxy<NativeUnrolledSerializerWrapper>>(); break; }
+  case pds::Serialization::kFixedLayout:
+    {   s = SerializeStrategy::make<SerializeProxy<FixedLayoutSerializerWrapper>>(); break; }
+  }
+  s.reserve(iDPs.size());
+  for(auto const& dp: iDPs) {
+    s.emplace_back(dp.name(), dp.classType());
+  }
+  retrievers_[iLaneIndex] = &iDPs;
+  if(not schema_) {
+    makeColumns(iDPs);
+  }
+}
+
+void ArrowOutputer::makeColumns(std::vector<DataProductRetriever> const& iDPs) {
+  std::vector<std::shared_ptr<arrow::Field>> fields;
+  fields.reserve(iDPs.size()+3);
+  fields.push_back(arrow::field(kRunColumn, arrow::uint32(), false));
+  fields.push_back(arrow::field(kLumiColumn, arrow::uint32(), false));
+  fields.push_back(arrow::field(kEventColumn, arrow::uint64(), false));
+  columns_.reserve(iDPs.size());
+  for(auto const& dp: iDPs) {
+    Column column;
+    column.name_ = dp.name();
+    column.elementType_ = listElementType(*dp.classType());
+    std::shared_ptr<arrow::DataType> type = arrow::large_binary();
+    if(column.elementType_) {
+      column.elementSize_ = elementSize(*column.elementType_);
+      column.proxy_.reset(dp.classType()->GetCollectionProxy()->Generate());
+      type = arrow::large_list(column.elementType_);
+      ++nListColumns_;
+    }
+    column.offsets_.push_back(0);
+    fields.push_back(arrow::field(dp.name(), type, false, arrow::key_value_metadata({kClassNameKey}, {dp.classType()->GetName()})));
+    columns_.push_back(std::move(column));
+  }
+  schema_ = arrow::schema(std::move(fields),
+                          arrow::key_value_metadata({kSerializationKey}, {std::to_string(static_cast<int>(serialization_))}));
+
+  if(format_ == Format::kParquet) {
+    parquet::WriterProperties::Builder builder;
+    builder.compression(compression_);
+    if(compression_ == arrow::Compression::ZSTD) {
+      builder.compression_level(compressionLevel_);
+    }
+    //keeps the large types and the metadata when read back
+    auto arrowProperties = parquet::ArrowWriterProperties::Builder().store_schema()->build();
+    parquetWriter_ = check(parquet::arrow::FileWriter::Open(*schema_, arrow::default_memory_pool(), file_, builder.build(), arrowProperties),
+                           "ArrowOutputer opening the Parquet writer");
+  } else {
+    auto options = arrow::ipc::IpcWriteOptions::Defaults();
+    if(compression_ != arrow::Compression::UNCOMPRESSED) {
+      auto level = compression_ == arrow::Compression::ZSTD ? compressionLevel_ : arrow::util::kUseDefaultCompressionLevel;
+      options.codec = check(arrow::util::Codec::Create(compression_, level), "ArrowOutputer making the IPC codec");
+    }
+    ipcWriter_ = check(arrow::ipc::MakeFileWriter(file_, schema_, options), "ArrowOutputer opening the IPC writer");
+  }
+}
+
+void ArrowOutputer::productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const {
+  if(columns_[iDataProduct.index()].elementType_) {
+    //the elements are copied from the object when the event is output
+    if(iDataProduct.serialization()) {
+      throw std::runtime_error("ArrowOutputer needs the object of data product "+iDataProduct.name()+", the Source only passed its serialized bytes");
+    }
+    iCallback.doneWaiting();
+    return;
+  }
+  serializeOrPassThroughAsync(serializers_[iLaneIndex][iDataProduct.index()], iDataProduct, serialization_, std::move(iCallback), 0);
+}
+
+void ArrowOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+  auto start = std::chrono::high_resolution_clock::now();
+  queue_.push(*iCallback.group(), [this, iEventID, iLaneIndex, callback=std::move(iCallback)]() mutable {
+      auto start = std::chrono::high_resolution_clock::now();
+      const_cast<ArrowOutputer*>(this)->output(iLaneIndex, iEventID);
+      serialTime_ += std::chrono::duration_cast<decltype(serialTime_)>(std::chrono::high_resolution_clock::now() - start);
+      callback.doneWaiting();
+    });
+  auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+  parallelTime_.add(iLaneIndex, time.count());
+}
+
+void ArrowOutputer::output(unsigned int iLaneIndex, EventIdentifier const& iEventID) {
+  runs_.push_back(iEventID.run);
+  lumis_.push_back(iEventID.lumi);
+  events_.push_back(iEventID.event);
+  auto const& retrievers = *retrievers_[iLaneIndex];
+  auto const& serializers = serializers_[iLaneIndex];
+  for(std::size_t index = 0; index < columns_.size(); ++index) {
+    auto& column = columns_[index];
+    char const* begin;
+    std::size_t size;
+    std::size_t bytes;
+    if(column.elementType_) {
+      auto [nElements, elements] = vectorElements(*column.proxy_, *retrievers[index].address());
+      begin = static_cast<char const*>(elements);
+      size = nElements;
+      bytes = nElements*column.elementSize_;
+    } else {
+      auto blob = serializers[index].blob();
+      begin = blob.data();
+      size = blob.size();
+      bytes = blob.size();
+    }
+    column.values_.insert(column.values_.end(), begin, begin+bytes);
+    column.offsets_.push_back(column.offsets_.back()+size);
+  }
+  if(runs_.size() == batchSize_) {
+    writeBatch();
+  }
+}
+
+void ArrowOutputer::writeBatch() {
+  auto const nEvents = runs_.size();
+  if(nEvents == 0) {
+    return;
+  }
+  auto start = std::chrono::high_resolution_clock::now();
+  std::vector<std::shared_ptr<arrow::Array>> arrays;
+  arrays.reserve(columns_.size()+3);
+  //the buffers take over the memory of the vectors so nothing is copied
+  arrays.push_back(std::make_shared<arrow::UInt32Array>(nEvents, arrow::Buffer::FromVector(std::move(runs_))));
+  arrays.push_back(std::make_shared<arrow::UInt32Array>(nEvents, arrow::Buffer::FromVector(std::move(lumis_))));
+  arrays.push_back(std::make_shared<arrow::UInt64Array>(nEvents, arrow::Buffer::FromVector(std::move(events_))));
+  for(auto& column: columns_) {
+    auto const nValues = column.offsets_.back();
+    auto offsets = arrow::Buffer::FromVector(std::move(column.offsets_));
+    auto values = arrow::Buffer::FromVector(std::move(column.values_));
+    if(column.elementType_) {
+      auto elements = arrow::MakeArray(arrow::ArrayData::Make(column.elementType_, nValues, {nullptr, std::move(values)}));
+      arrays.push_back(std::make_shared<arrow::LargeListArray>(arrow::large_list(column.elementType_), nEvents, std::move(offsets), std::move(elements)));
+    } else {
+      arrays.push_back(std::make_shared<arrow::LargeBinaryArray>(nEvents, std::move(offsets), std::move(values)));
+    }
+    column.offsets_ = {0};
+    column.values_ = {};
+  }
+  runs_ = {};
+  lumis_ = {};
+  events_ = {};
+  runs_.reserve(batchSize_);
+  lumis_.reserve(batchSize_);
+  events_.reserve(batchSize_);
+
+  auto batch = arrow::RecordBatch::Make(schema_, nEvents, std::move(arrays));
+  if(parquetWriter_) {
+    //one row group per batch
+    auto table = check(arrow::Table::FromRecordBatches({batch}), "ArrowOutputer making the table");
+    check(parquetWriter_->WriteTable(*table, nEvents), "ArrowOutputer writing the row group");
+  } else {
+    check(ipcWriter_->WriteRecordBatch(*batch), "ArrowOutputer writing the record batch");
+  }
+  ++nBatches_;
+  writeTime_ += std::chrono::duration_cast<decltype(writeTime_)>(std::chrono::high_resolution_clock::now() - start);
+}
+
+void ArrowOutputer::printSummary() const {
+  {
+    //all lanes are done so the last batch can be written
+    auto nonConstThis = const_cast<ArrowOutputer*>(this);
+    nonConstThis->writeBatch();
+    if(parquetWriter_) {
+      check(parquetWriter_->Close(), "ArrowOutputer closing the Parquet writer");
+    }
+    if(ipcWriter_) {
+      check(ipcWriter_->Close(), "ArrowOutputer closing the IPC writer");
+    }
+    if(not file_->closed()) {
+      check(file_->Close(), "ArrowOutputer closing the file");
+    }
+  }
+  std::cout <<"ArrowOutputer\n  total serial time at end event: "<<serialTime_.count()<<"us\n"
+    "  total parallel time at end event: "<<parallelTime_.sum()<<"us\n"
+    "  write time: "<<writeTime_.count()<<"us\n"
+    "  "<<(format_ == Format::kParquet ? "row groups" : "record batches")<<" written: "<<nBatches_<<"\n"
+    "  list columns: "<<nListColumns_<<" binary columns: "<<columns_.size()-nListColumns_<<"\n";
+  summarize_queue("write", queue_);
+  summarize_serializers(serializers_);
+}
+
+void ArrowOutputer::fillProfile(ProductProfile& oProfile) const {
+  profile_serializers(oProfile, serializers_);
+}
+
+namespace {
+  class Maker : public OutputerMakerBase {
+  public:
+    Maker(): OutputerMakerBase("ArrowOutputer") {}
+
+    std::unique_ptr<OutputerBase> create(unsigned int iNLanes, ConfigurationParameters const& params) const final {
+      auto fileName = params.get<std::string>("fileName");
+      if(not fileName) {
+        std::cout<<" no file name given for ArrowOutputer\n";
+        return {};
+      }
+      auto formatName = params.get<std::string>("format", "parquet");
+      auto format = toFormat(formatName);
+      if(not format) {
+        std::cout <<"unknown format '"<<formatName<<"' for ArrowOutputer, allowed values are parquet or ipc"<<std::endl;
+        return {};
+      }
+      auto compressionName = params.get<std::string>("compressionAlgorithm", "ZSTD");
+      auto pdsCompression = pds::toCompression(compressionName);
+      std::optional<arrow::Compression::type> compression;
+      if(pdsCompression) {
+        compression = toArrowCompression(*pdsCompression, *format);
+      }
+      if(not compression) {
+        std::cout <<"unknown compression "<<compressionName<<" for ArrowOutputer, allowed values are None, LZ4 or ZSTD"<<std::endl;
+        return {};
+      }
+      int compressionLevel = params.get<int>("compressionLevel", 3);
+      auto serializationName = params.get<std::string>("serializationAlgorithm", "ROOT");
+      auto serialization = pds::toSerialization(serializationName);
+      if(not serialization) {
+        std::cout <<"unknown serialization "<<serializationName<<std::endl;
+        return {};
+      }
+      auto batchSize = params.get<int>("batchSize", 1000);
+      if(batchSize < 1) {
+        std::cout <<"batchSize for ArrowOutputer must be at least 1"<<std::endl;
+        return {};
+      }
+      try {
+        return std::make_unique<ArrowOutputer>(*fileName, iNLanes, *format, *compression, compressionLevel, *serialization,
+                                               static_cast<unsigned int>(batchSize));
+      } catch(std::runtime_error const& iError) {
+        std::cout <<iError.what()<<std::endl;
+        return {};
+      }
+    }
+  };
+
+  Maker s_maker;
+}
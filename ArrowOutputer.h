@@ -0,0 +1,96 @@
+#if !defined(ArrowOutputer_h)
+#define ArrowOutputer_h
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "arrow/api.h"
+#include "arrow/io/file.h"
+#include "arrow/ipc/writer.h"
+#include "parquet/arrow/writer.h"
+
+#include "OutputerBase.h"
+#include "EventIdentifier.h"
+#include "SerializeStrategy.h"
+#include "DataProductRetriever.h"
+#include "SerialTaskQueue.h"
+#include "PerLaneCounter.h"
+#include "arrow_common.h"
+
+class TVirtualCollectionProxy;
+
+namespace cce::tf {
+  /**
+     Writes the events as the rows of a Parquet or Arrow IPC file. A data
+     product which is a std::vector of a number becomes a list column whose
+     elements are copied directly from the vector, all other data products
+     become binary columns holding the bytes of the chosen serialization.
+     Each batch of events is written as one Parquet row group or IPC record
+     batch.
+   */
+  class ArrowOutputer : public OutputerBase {
+  public:
+    ArrowOutputer(std::string const& iFileName, unsigned int iNLanes, arrowcolumns::Format iFormat, arrow::Compression::type iCompression,
+                  int iCompressionLevel, pds::Serialization iSerialization, unsigned int iBatchSize);
+    ~ArrowOutputer();
+
+    void setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) final;
+
+    void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const final;
+    bool usesProductReadyAsync() const final {return true;}
+
+    void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+
+    void printSummary() const final;
+    void fillProfile(ProductProfile&) const final;
+
+  private:
+    //The values of one data product for the events of the present batch
+    struct Column {
+      std::string name_;
+      //nullptr for a binary column
+      std::shared_ptr<arrow::DataType> elementType_;
+      std::size_t elementSize_ = 0;
+      //only used from queue_ so one is enough for all lanes
+      std::unique_ptr<TVirtualCollectionProxy> proxy_;
+      //the end of each event's values in values_, in elements for a list column and bytes for a binary column
+      std::vector<int64_t> offsets_;
+      std::vector<char> values_;
+    };
+
+    void makeColumns(std::vector<DataProductRetriever> const& iDPs);
+    //must be called from queue_
+    void output(unsigned int iLaneIndex, EventIdentifier const& iEventID);
+    void writeBatch();
+
+    std::string fileName_;
+    arrowcolumns::Format format_;
+    arrow::Compression::type compression_;
+    int compressionLevel_;
+    pds::Serialization serialization_;
+    unsigned int batchSize_;
+
+    std::shared_ptr<arrow::Schema> schema_;
+    std::shared_ptr<arrow::io::FileOutputStream> file_;
+    std::unique_ptr<parquet::arrow::FileWriter> parquetWriter_;
+    std::shared_ptr<arrow::ipc::RecordBatchWriter> ipcWriter_;
+
+    mutable SerialTaskQueue queue_;
+    std::vector<Column> columns_;
+    std::vector<uint32_t> runs_;
+    std::vector<uint32_t> lumis_;
+    std::vector<uint64_t> events_;
+    mutable std::vector<SerializeStrategy> serializers_;
+    //the retrievers of each lane, the list columns are filled from their objects
+    std::vector<std::vector<DataProductRetriever> const*> retrievers_;
+
+    unsigned long long nBatches_ = 0;
+    unsigned long long nListColumns_ = 0;
+    mutable std::chrono::microseconds serialTime_;
+    std::chrono::microseconds writeTime_;
+    mutable PerLaneCounter<std::chrono::microseconds::rep> parallelTime_;
+  };
+}
+#endif
@@ -0,0 +1,199 @@
+#include "ArrowSource.h"
+#include "SourceFactory.h"
+#include "ReplicatedSharedSource.h"
+#include "Deserializer.h"
+#include "UnrolledDeserializer.h"
+#include "FixedLayoutDeserializer.h"
+
+#include "TClass.h"
+#include "TVirtualCollectionProxy.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace cce::tf;
+using namespace cce::tf::arrowcolumns;
+
+namespace {
+  std::string metadataValue(std::shared_ptr<const arrow::KeyValueMetadata> const& iMetadata, char const* iKey, std::string const& iWhere) {
+    if(not iMetadata or not iMetadata->Contains(iKey)) {
+      throw std::runtime_error("ArrowSource found no '"+std::string(iKey)+"' in the metadata of "+iWhere+", was the file written by ArrowOutputer?");
+    }
+    return check(iMetadata->Get(iKey), "ArrowSource reading the metadata");
+  }
+}
+
+ArrowSource::ArrowSource(std::string const& iName, ProductSelector const& iSelector):
+  file_{check(arrow::io::ReadableFile::Open(iName), "ArrowSource opening the file")}
+{
+  auto format = formatOfFile(iName);
+  if(not format) {
+    throw std::runtime_error("ArrowSource file "+iName+" is neither a Parquet nor an Arrow IPC file");
+  }
+  format_ = *format;
+
+  std::shared_ptr<arrow::Schema> schema;
+  if(format_ == Format::kParquet) {
+    check(parquet::arrow::OpenFile(file_, arrow::default_memory_pool(), &parquetReader_), "ArrowSource opening the Parquet reader");
+    check(parquetReader_->GetSchema(&schema), "ArrowSource reading the Parquet schema");
+  } else {
+    ipcReader_ = check(arrow::ipc::RecordBatchFileReader::Open(file_), "ArrowSource opening the IPC reader");
+    schema = ipcReader_->schema();
+  }
+
+  pds::Serialization serialization{std::stoi(metadataValue(schema->metadata(), kSerializationKey, iName))};
+  switch(serialization) {
+  case pds::Serialization::kRoot: {
+    deserializers_ = DeserializeStrategy::make<DeserializeProxy<Deserializer>>(); break;
+  }
+  case pds::Serialization::kRootUnrolled: {
+    deserializers_ = DeserializeStrategy::make<DeserializeProxy<UnrolledDeserializer>>(); break;
+  }
+  case pds::Serialization::kNativeUnrolled: {
+    deserializers_ = DeserializeStrategy::make<DeserializeProxy<NativeUnrolledDeserializer>>(); break;
+  }
+  case pds::Serialization::kFixedLayout: {
+    deserializers_ = DeserializeStrategy::make<DeserializeProxy<FixedLayoutDeserializer>>(); break;
+  }
+  }
+
+  fileColumns_ = {schema->GetFieldIndex(kRunColumn), schema->GetFieldIndex(kLumiColumn), schema->GetFieldIndex(kEventColumn)};
+  if(fileColumns_ != std::vector<int>{0, 1, 2}) {
+    throw std::runtime_error("ArrowSource expects the run, lumi and event columns first in "+iName);
+  }
+  std::vector<std::shared_ptr<arrow::Field>> products;
+  for(auto const& field: schema->fields()) {
+    if(field->name() == kRunColumn or field->name() == kLumiColumn or field->name() == kEventColumn) {
+      continue;
+    }
+    if(iSelector.keep(field->name())) {
+      //all columns have a single leaf so the field index is also the Parquet column index
+      fileColumns_.push_back(schema->GetFieldIndex(field->name()));
+      products.push_back(field);
+    }
+  }
+
+  dataProducts_.reserve(products.size());
+  dataBuffers_.resize(products.size(), nullptr);
+  deserializers_.reserve(products.size());
+  columns_.resize(products.size());
+  for(std::size_t index = 0; index < products.size(); ++index) {
+    auto const& field = *products[index];
+    auto className = metadataValue(field.metadata(), kClassNameKey, field.name());
+    TClass* cls = TClass::GetClass(className.c_str());
+    if(not cls) {
+      throw std::runtime_error("ArrowSource unknown class "+className+" of data product "+field.name());
+    }
+    auto& column = columns_[index];
+    if(field.type()->id() == arrow::Type::LARGE_LIST) {
+      column.elementType_ = static_cast<arrow::LargeListType const&>(*field.type()).value_type();
+      column.elementSize_ = elementSize(*column.elementType_);
+      column.proxy_.reset(cls->GetCollectionProxy()->Generate());
+    }
+    dataBuffers_[index] = cls->New();
+    dataProducts_.emplace_back(index, &dataBuffers_[index], field.name(), cls, &delayedRetriever_);
+    deserializers_.emplace_back(cls);
+  }
+
+  batchStarts_.push_back(0);
+  if(format_ == Format::kParquet) {
+    auto const& metadata = *parquetReader_->parquet_reader()->metadata();
+    for(int i = 0; i < metadata.num_row_groups(); ++i) {
+      batchStarts_.push_back(batchStarts_.back()+metadata.RowGroup(i)->num_rows());
+    }
+  } else {
+    //only the run column is read to learn the size of each record batch
+    auto options = arrow::ipc::IpcReadOptions::Defaults();
+    options.included_fields = {fileColumns_[0]};
+    auto counter = check(arrow::ipc::RecordBatchFileReader::Open(file_, options), "ArrowSource opening the IPC reader");
+    for(int i = 0; i < counter->num_record_batches(); ++i) {
+      auto batch = check(counter->ReadRecordBatch(i), "ArrowSource reading a record batch");
+      batchStarts_.push_back(batchStarts_.back()+batch->num_rows());
+    }
+    options.included_fields = fileColumns_;
+    ipcReader_ = check(arrow::ipc::RecordBatchFileReader::Open(file_, options), "ArrowSource opening the IPC reader");
+  }
+}
+
+ArrowSource::~ArrowSource() {
+  auto it = dataProducts_.begin();
+  for( void * b: dataBuffers_) {
+    it->classType()->Destructor(b);
+    ++it;
+  }
+}
+
+void ArrowSource::readBatch(long iBatch) {
+  //both readers give the selected columns in the order of the file, which is the order of fileColumns_
+  std::vector<std::shared_ptr<arrow::Array>> arrays;
+  if(format_ == Format::kParquet) {
+    std::shared_ptr<arrow::Table> table;
+    check(parquetReader_->ReadRowGroup(iBatch, fileColumns_, &table), "ArrowSource reading a row group");
+    table = check(table->CombineChunks(), "ArrowSource combining the chunks of a row group");
+    arrays.reserve(table->num_columns());
+    for(auto const& column: table->columns()) {
+      arrays.push_back(column->chunk(0));
+    }
+  } else {
+    arrays = check(ipcReader_->ReadRecordBatch(iBatch), "ArrowSource reading a record batch")->columns();
+  }
+  runs_ = std::static_pointer_cast<arrow::UInt32Array>(arrays[0]);
+  lumis_ = std::static_pointer_cast<arrow::UInt32Array>(arrays[1]);
+  events_ = std::static_pointer_cast<arrow::UInt64Array>(arrays[2]);
+  for(std::size_t index = 0; index < columns_.size(); ++index) {
+    columns_[index].array_ = std::move(arrays[index+3]);
+  }
+  currentBatch_ = iBatch;
+}
+
+bool ArrowSource::readEvent(long iEventIndex) {
+  if(iEventIndex >= batchStarts_.back()) {
+    return false;
+  }
+  if(currentBatch_ < 0 or iEventIndex < batchStarts_[currentBatch_] or iEventIndex >= batchStarts_[currentBatch_+1]) {
+    auto batch = std::upper_bound(batchStarts_.begin(), batchStarts_.end(), iEventIndex) - batchStarts_.begin() - 1;
+    readBatch(batch);
+  }
+  auto const row = iEventIndex - batchStarts_[currentBatch_];
+  eventID_ = {runs_->Value(row), lumis_->Value(row), events_->Value(row)};
+  for(std::size_t index = 0; index < columns_.size(); ++index) {
+    auto& column = columns_[index];
+    if(column.elementType_) {
+      auto const& list = static_cast<arrow::LargeListArray const&>(*column.array_);
+      auto const& values = *list.values();
+      auto const nElements = list.value_length(row);
+      auto elements = values.data()->GetValues<char>(1, 0) + (values.offset()+list.value_offset(row))*column.elementSize_;
+      auto object = resizeVector(*column.proxy_, dataBuffers_[index], nElements);
+      if(nElements != 0) {
+        std::memcpy(object, elements, nElements*column.elementSize_);
+      }
+      dataProducts_[index].setSize(nElements*column.elementSize_);
+    } else {
+      auto bytes = static_cast<arrow::LargeBinaryArray const&>(*column.array_).GetView(row);
+      deserializers_[index].deserialize(bytes.data(), bytes.size(), dataBuffers_[index]);
+      dataProducts_[index].setSize(bytes.size());
+    }
+  }
+  return true;
+}
+
+namespace {
+    class Maker : public SourceMakerBase {
+  public:
+    Maker(): SourceMakerBase("ArrowSource") {}
+      std::unique_ptr<SharedSourceBase> create(unsigned int iNLanes, unsigned long long iNEvents, ConfigurationParameters const& params) const final {
+        auto fileName = params.get<std::string>("fileName");
+        if(not fileName) {
+          std::cout <<"no file name given\n";
+          return {};
+        }
+        ProductSelector selector{params.get<std::string>("products", "")};
+        return makeReplicatedSource<ArrowSource>(iNLanes, iNEvents, params, *fileName, selector);
+    }
+    };
+
+  Maker s_maker;
+}
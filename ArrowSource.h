@@ -0,0 +1,75 @@
+#if !defined(ArrowSource_h)
+#define ArrowSource_h
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "arrow/api.h"
+#include "arrow/io/file.h"
+#include "arrow/ipc/reader.h"
+#include "parquet/arrow/reader.h"
+
+#include "DataProductRetriever.h"
+#include "DelayedProductRetriever.h"
+#include "DeserializeStrategy.h"
+#include "SourceBase.h"
+#include "ProductSelector.h"
+#include "arrow_common.h"
+
+class TVirtualCollectionProxy;
+
+namespace cce::tf {
+class ArrowDelayedRetriever : public DelayedProductRetriever {
+  void getAsync(DataProductRetriever&, int index, TaskHolder) override {}
+};
+
+//Reads the files written by ArrowOutputer, the format is found from the start of the file
+class ArrowSource : public SourceBase {
+public:
+  ArrowSource(std::string const& iName, ProductSelector const& iSelector = ProductSelector());
+  ArrowSource(ArrowSource&&) = default;
+  ArrowSource(ArrowSource const&) = delete;
+  ~ArrowSource();
+
+  size_t numberOfDataProducts() const final {return dataProducts_.size();}
+  std::vector<DataProductRetriever>& dataProducts() final {return dataProducts_;}
+  EventIdentifier eventIdentifier() final { return eventID_;}
+  std::optional<long> numberOfEvents() const final { return batchStarts_.back(); }
+
+private:
+  struct Column {
+    //nullptr for a binary column
+    std::shared_ptr<arrow::DataType> elementType_;
+    std::size_t elementSize_ = 0;
+    std::unique_ptr<TVirtualCollectionProxy> proxy_;
+    //the values of the present batch
+    std::shared_ptr<arrow::Array> array_;
+  };
+
+  bool readEvent(long iEventIndex) final; //returns true if an event was read
+  //reads only the selected columns of the row group or record batch
+  void readBatch(long iBatch);
+
+  arrowcolumns::Format format_;
+  std::shared_ptr<arrow::io::ReadableFile> file_;
+  std::unique_ptr<parquet::arrow::FileReader> parquetReader_;
+  std::shared_ptr<arrow::ipc::RecordBatchFileReader> ipcReader_;
+  //the run, lumi and event columns followed by the selected data products
+  std::vector<int> fileColumns_;
+  //the first event of each batch, the last entry is the number of events in the file
+  std::vector<long> batchStarts_;
+  long currentBatch_ = -1;
+  std::shared_ptr<arrow::UInt32Array> runs_;
+  std::shared_ptr<arrow::UInt32Array> lumis_;
+  std::shared_ptr<arrow::UInt64Array> events_;
+  std::vector<Column> columns_;
+  DeserializeStrategy deserializers_;
+  EventIdentifier eventID_;
+  std::vector<DataProductRetriever> dataProducts_;
+  std::vector<void*> dataBuffers_;
+  ArrowDelayedRetriever delayedRetriever_;
+};
+}
+#endif
@@ -0,0 +1,200 @@
+#if !defined(AsyncPipeline_h)
+#define AsyncPipeline_h
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "tbb/task_group.h"
+
+#include "TaskHolder.h"
+#include "SerialTaskQueue.h"
+#include "RunReport.h"
+#include "summarize_queue.h"
+
+namespace cce::tf {
+  /**
+     Passes items through a chain of stages, like tbb::parallel_pipeline but
+     driven by TaskHolders. A parallel stage runs each item in its own task, a
+     serial stage runs one item at a time, in the order the items reached it,
+     through its own SerialTaskQueue.
+
+     At most iMaxInFlight items are in the stages at once. The callback given
+     with an item is released as soon as the item enters the first stage, so
+     e.g. a Lane can continue while its event is written. When all tokens are
+     taken, the item and its callback wait until an earlier item has left the
+     last stage. This bounds the memory held by the items. With iMaxInFlight
+     of 0 the callback is instead held until the item has left the last stage.
+
+     The stages run in the tbb::task_group of the item's callback and that
+     group is kept from finishing its wait until the item is done.
+   */
+  template<typename T>
+  class AsyncPipeline {
+  public:
+    using StageFunction = std::function<void(T&)>;
+
+    explicit AsyncPipeline(unsigned int iMaxInFlight): maxInFlight_{iMaxInFlight} {}
+
+    AsyncPipeline(AsyncPipeline const&) = delete;
+    AsyncPipeline& operator=(AsyncPipeline const&) = delete;
+
+    //stages must all be added before the first push
+    AsyncPipeline& parallelStage(std::string iName, StageFunction iFunction) {
+      stages_.push_back({std::move(iName), std::move(iFunction), {}});
+      return *this;
+    }
+    AsyncPipeline& serialStage(std::string iName, StageFunction iFunction) {
+      stages_.push_back({std::move(iName), std::move(iFunction), std::make_unique<SerialTaskQueue>()});
+      return *this;
+    }
+
+    void pushAsync(T iItem, TaskHolder iCallback) {
+      auto group = iCallback.group();
+      auto entry = std::make_shared<Entry>(Entry{std::move(iItem), group, group->defer([](){}), {}, std::chrono::steady_clock::now()});
+      if(maxInFlight_ == 0) {
+        entry->waiting_.emplace(std::move(iCallback));
+        runStage(std::move(entry), 0);
+        return;
+      }
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        ++nItems_;
+        if(inFlight_ == maxInFlight_) {
+          entry->waiting_.emplace(std::move(iCallback));
+          pending_.push_back(std::move(entry));
+          ++nWaited_;
+          if(pending_.size() > maxPending_) {
+            maxPending_ = pending_.size();
+          }
+          return;
+        }
+        ++inFlight_;
+      }
+      runStage(std::move(entry), 0);
+      iCallback.doneWaiting();
+    }
+
+    unsigned int maxInFlight() const { return maxInFlight_; }
+    //the following are only meaningful once all items are done
+    unsigned long long nItems() const { return nItems_; }
+    //number of items which had to wait for a token
+    unsigned long long nWaited() const { return nWaited_; }
+    std::size_t maxPending() const { return maxPending_; }
+    //summed time items waited for a token
+    std::chrono::microseconds waitTime() const { return waitTime_; }
+
+    std::size_t nStages() const { return stages_.size(); }
+    std::string const& stageName(std::size_t iIndex) const { return stages_[iIndex].name_; }
+    //nullptr for a parallel stage
+    SerialTaskQueue const* stageQueue(std::size_t iIndex) const { return stages_[iIndex].queue_.get(); }
+
+  private:
+    struct Entry {
+      T item_;
+      tbb::task_group* group_;
+      //keeps the group from finishing its wait while the item is in the pipeline
+      tbb::task_handle keepGroupWaiting_;
+      std::optional<TaskHolder> waiting_;
+      std::chrono::steady_clock::time_point pushTime_;
+    };
+    struct Stage {
+      std::string name_;
+      StageFunction function_;
+      std::unique_ptr<SerialTaskQueue> queue_;
+    };
+
+    void runStage(std::shared_ptr<Entry> iEntry, std::size_t iIndex) {
+      if(iIndex == stages_.size()) {
+        finished(std::move(iEntry));
+        return;
+      }
+      auto& stage = stages_[iIndex];
+      auto group = iEntry->group_;
+      auto work = [this, &stage, entry = std::move(iEntry), iIndex]() {
+        stage.function_(entry->item_);
+        runStage(entry, iIndex+1);
+      };
+      if(stage.queue_) {
+        stage.queue_->push(*group, std::move(work));
+      } else {
+        group->run(std::move(work));
+      }
+    }
+
+    void finished(std::shared_ptr<Entry> iEntry) {
+      //free what the item holds before letting another in
+      iEntry->item_ = T();
+      if(iEntry->waiting_) {
+        iEntry->waiting_.reset();
+      }
+      if(maxInFlight_ != 0) {
+        std::shared_ptr<Entry> next;
+        {
+          std::lock_guard<std::mutex> guard(mutex_);
+          if(pending_.empty()) {
+            --inFlight_;
+          } else {
+            next = std::move(pending_.front());
+            pending_.pop_front();
+            waitTime_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - next->pushTime_);
+          }
+        }
+        if(next) {
+          auto callback = std::move(*next->waiting_);
+          next->waiting_.reset();
+          runStage(std::move(next), 0);
+          callback.doneWaiting();
+        }
+      }
+      iEntry->group_->run(std::move(iEntry->keepGroupWaiting_));
+    }
+
+    std::vector<Stage> stages_;
+    unsigned int const maxInFlight_;
+    std::mutex mutex_;
+    unsigned int inFlight_ = 0;
+    std::deque<std::shared_ptr<Entry>> pending_;
+    unsigned long long nItems_ = 0;
+    unsigned long long nWaited_ = 0;
+    std::size_t maxPending_ = 0;
+    std::chrono::microseconds waitTime_ = std::chrono::microseconds::zero();
+  };
+
+  template<typename T>
+  inline void summarize_pipeline(std::string_view iName, AsyncPipeline<T> const& iPipeline) {
+    std::cout <<"  "<<iName<<" pipeline: max in flight "<<iPipeline.maxInFlight();
+    if(iPipeline.maxInFlight() != 0) {
+      std::cout <<" items "<<iPipeline.nItems()<<" waited for a token "<<iPipeline.nWaited()
+                <<" max waiting "<<iPipeline.maxPending()<<" wait time "<<iPipeline.waitTime().count()<<"us";
+    }
+    std::cout <<"\n";
+    for(std::size_t i = 0; i < iPipeline.nStages(); ++i) {
+      if(auto queue = iPipeline.stageQueue(i)) {
+        summarize_queue(iPipeline.stageName(i), *queue);
+      }
+    }
+  }
+
+  template<typename T>
+  inline void report_pipeline(RunReport& oReport, std::string_view iName, AsyncPipeline<T> const& iPipeline) {
+    auto& section = oReport.section(std::string(iName)+"Pipeline");
+    section.set("maxInFlight", iPipeline.maxInFlight());
+    section.set("items", iPipeline.nItems());
+    section.set("waited", iPipeline.nWaited());
+    section.set("maxWaiting", iPipeline.maxPending());
+    section.set("waitTime_us", iPipeline.waitTime().count());
+    for(std::size_t i = 0; i < iPipeline.nStages(); ++i) {
+      if(auto queue = iPipeline.stageQueue(i)) {
+        report_queue(section, iPipeline.stageName(i), *queue);
+      }
+    }
+  }
+}
+#endif
@@ -0,0 +1,282 @@
+#include "BatchDecompressor.h"
+#include "pds_reading.h"
+
+#include "tbb/enumerable_thread_specific.h"
+#include "tbb/parallel_for.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(TF_ENABLE_NVCOMP)
+#include <cuda_runtime.h>
+#include "nvcomp/lz4.h"
+#include "nvcomp/zstd.h"
+#endif
+
+using namespace cce::tf;
+
+namespace {
+  //the largest buffer nvCOMP's batched LZ4 and ZSTD decompression handle
+  constexpr std::size_t kMaxGPUBufferBytes = 16*1024*1024;
+
+  bool gpuCanDecompress(pds::Compression iCompression) {
+    //ZSTD's long mode uses windows larger than nvCOMP supports
+    return pds::isLZ4(iCompression) or iCompression == pds::Compression::kZSTD;
+  }
+}
+
+#if defined(TF_ENABLE_NVCOMP)
+namespace {
+  void checkCuda(cudaError_t iError, char const* iWhat) {
+    if(iError != cudaSuccess) {
+      throw std::runtime_error(std::string("BatchDecompressor ")+iWhat+" failed: "+cudaGetErrorString(iError));
+    }
+  }
+
+  void checkNvcomp(nvcompStatus_t iStatus, char const* iWhat) {
+    if(iStatus != nvcompSuccess) {
+      throw std::runtime_error(std::string("BatchDecompressor ")+iWhat+" failed with nvCOMP status "+std::to_string(iStatus));
+    }
+  }
+
+  //memory which only grows so it is allocated once for a job
+  struct DeviceBuffer {
+    void* ptr_ = nullptr;
+    std::size_t size_ = 0;
+    void reserve(std::size_t iSize) {
+      if(iSize <= size_) {
+        return;
+      }
+      cudaFree(ptr_);
+      ptr_ = nullptr;
+      size_ = 0;
+      checkCuda(cudaMalloc(&ptr_, iSize), "cudaMalloc");
+      size_ = iSize;
+    }
+    ~DeviceBuffer() { cudaFree(ptr_); }
+  };
+
+  //page locked so the copies to and from the GPU run at full speed
+  struct PinnedBuffer {
+    char* ptr_ = nullptr;
+    std::size_t size_ = 0;
+    void reserve(std::size_t iSize) {
+      if(iSize <= size_) {
+        return;
+      }
+      cudaFreeHost(ptr_);
+      ptr_ = nullptr;
+      size_ = 0;
+      checkCuda(cudaMallocHost(reinterpret_cast<void**>(&ptr_), iSize), "cudaMallocHost");
+      size_ = iSize;
+    }
+    ~PinnedBuffer() { cudaFreeHost(ptr_); }
+  };
+}
+
+struct BatchDecompressor::GPU {
+  explicit GPU(pds::Compression iCompression): lz4_{pds::isLZ4(iCompression)} {
+    checkCuda(cudaStreamCreate(&stream_), "cudaStreamCreate");
+  }
+  ~GPU() { cudaStreamDestroy(stream_); }
+
+  void decompress(std::vector<Request const*> const& iRequests);
+
+  bool lz4_;
+  cudaStream_t stream_;
+  PinnedBuffer hostCompressed_;
+  PinnedBuffer hostUncompressed_;
+  DeviceBuffer compressed_;
+  DeviceBuffer uncompressed_;
+  DeviceBuffer temp_;
+  //per buffer pointers and sizes given to nvCOMP
+  DeviceBuffer compressedPtrs_;
+  DeviceBuffer uncompressedPtrs_;
+  DeviceBuffer compressedSizes_;
+  DeviceBuffer uncompressedSizes_;
+  DeviceBuffer actualSizes_;
+  DeviceBuffer statuses_;
+};
+
+void BatchDecompressor::GPU::decompress(std::vector<Request const*> const& iRequests) {
+  auto const n = iRequests.size();
+  std::vector<std::size_t> compressedSizes(n);
+  std::vector<std::size_t> uncompressedSizes(n);
+  std::vector<std::size_t> compressedOffsets(n);
+  std::vector<std::size_t> uncompressedOffsets(n);
+  std::size_t compressedBytes = 0;
+  std::size_t uncompressedBytes = 0;
+  std::size_t maxUncompressed = 0;
+  for(std::size_t i = 0; i < n; ++i) {
+    compressedSizes[i] = iRequests[i]->compressedSize_;
+    uncompressedSizes[i] = iRequests[i]->uncompressedSize_;
+    compressedOffsets[i] = compressedBytes;
+    uncompressedOffsets[i] = uncompressedBytes;
+    compressedBytes += compressedSizes[i];
+    uncompressedBytes += uncompressedSizes[i];
+    maxUncompressed = std::max(maxUncompressed, uncompressedSizes[i]);
+  }
+
+  hostCompressed_.reserve(compressedBytes);
+  hostUncompressed_.reserve(uncompressedBytes);
+  compressed_.reserve(compressedBytes);
+  uncompressed_.reserve(uncompressedBytes);
+  compressedPtrs_.reserve(n*sizeof(void*));
+  uncompressedPtrs_.reserve(n*sizeof(void*));
+  compressedSizes_.reserve(n*sizeof(std::size_t));
+  uncompressedSizes_.reserve(n*sizeof(std::size_t));
+  actualSizes_.reserve(n*sizeof(std::size_t));
+  statuses_.reserve(n*sizeof(nvcompStatus_t));
+
+  std::size_t tempBytes = 0;
+  if(lz4_) {
+    checkNvcomp(nvcompBatchedLZ4DecompressGetTempSize(n, maxUncompressed, &tempBytes), "nvcompBatchedLZ4DecompressGetTempSize");
+  } else {
+    checkNvcomp(nvcompBatchedZstdDecompressGetTempSize(n, maxUncompressed, &tempBytes), "nvcompBatchedZstdDecompressGetTempSize");
+  }
+  temp_.reserve(tempBytes);
+
+  //all buffers go to the GPU with one copy
+  std::vector<void const*> compressedPtrs(n);
+  std::vector<void*> uncompressedPtrs(n);
+  for(std::size_t i = 0; i < n; ++i) {
+    std::memcpy(hostCompressed_.ptr_+compressedOffsets[i], iRequests[i]->compressed_, compressedSizes[i]);
+    compressedPtrs[i] = static_cast<char const*>(compressed_.ptr_)+compressedOffsets[i];
+    uncompressedPtrs[i] = static_cast<char*>(uncompressed_.ptr_)+uncompressedOffsets[i];
+  }
+  checkCuda(cudaMemcpyAsync(compressed_.ptr_, hostCompressed_.ptr_, compressedBytes, cudaMemcpyHostToDevice, stream_), "cudaMemcpyAsync");
+  checkCuda(cudaMemcpyAsync(compressedPtrs_.ptr_, compressedPtrs.data(), n*sizeof(void*), cudaMemcpyHostToDevice, stream_), "cudaMemcpyAsync");
+  checkCuda(cudaMemcpyAsync(uncompressedPtrs_.ptr_, uncompressedPtrs.data(), n*sizeof(void*), cudaMemcpyHostToDevice, stream_), "cudaMemcpyAsync");
+  checkCuda(cudaMemcpyAsync(compressedSizes_.ptr_, compressedSizes.data(), n*sizeof(std::size_t), cudaMemcpyHostToDevice, stream_), "cudaMemcpyAsync");
+  checkCuda(cudaMemcpyAsync(uncompressedSizes_.ptr_, uncompressedSizes.data(), n*sizeof(std::size_t), cudaMemcpyHostToDevice, stream_), "cudaMemcpyAsync");
+
+  auto dCompressedPtrs = static_cast<void const* const*>(compressedPtrs_.ptr_);
+  auto dUncompressedPtrs = static_cast<void* const*>(uncompressedPtrs_.ptr_);
+  auto dCompressedSizes = static_cast<std::size_t const*>(compressedSizes_.ptr_);
+  auto dUncompressedSizes = static_cast<std::size_t const*>(uncompressedSizes_.ptr_);
+  auto dActualSizes = static_cast<std::size_t*>(actualSizes_.ptr_);
+  auto dStatuses = static_cast<nvcompStatus_t*>(statuses_.ptr_);
+  if(lz4_) {
+    checkNvcomp(nvcompBatchedLZ4DecompressAsync(dCompressedPtrs, dCompressedSizes, dUncompressedSizes, dActualSizes, n,
+                                                temp_.ptr_, tempBytes, dUncompressedPtrs, dStatuses, stream_), "nvcompBatchedLZ4DecompressAsync");
+  } else {
+    checkNvcomp(nvcompBatchedZstdDecompressAsync(dCompressedPtrs, dCompressedSizes, dUncompressedSizes, dActualSizes, n,
+                                                 temp_.ptr_, tempBytes, dUncompressedPtrs, dStatuses, stream_), "nvcompBatchedZstdDecompressAsync");
+  }
+
+  std::vector<std::size_t> actualSizes(n);
+  std::vector<nvcompStatus_t> statuses(n);
+  checkCuda(cudaMemcpyAsync(hostUncompressed_.ptr_, uncompressed_.ptr_, uncompressedBytes, cudaMemcpyDeviceToHost, stream_), "cudaMemcpyAsync");
+  checkCuda(cudaMemcpyAsync(actualSizes.data(), dActualSizes, n*sizeof(std::size_t), cudaMemcpyDeviceToHost, stream_), "cudaMemcpyAsync");
+  checkCuda(cudaMemcpyAsync(statuses.data(), dStatuses, n*sizeof(nvcompStatus_t), cudaMemcpyDeviceToHost, stream_), "cudaMemcpyAsync");
+  checkCuda(cudaStreamSynchronize(stream_), "cudaStreamSynchronize");
+
+  for(std::size_t i = 0; i < n; ++i) {
+    checkNvcomp(statuses[i], "decompression of a buffer");
+    if(actualSizes[i] != uncompressedSizes[i]) {
+      throw std::runtime_error("BatchDecompressor decompressed "+std::to_string(actualSizes[i])+" bytes but expected "+
+                               std::to_string(uncompressedSizes[i]));
+    }
+    std::memcpy(iRequests[i]->uncompressed_, hostUncompressed_.ptr_+uncompressedOffsets[i], uncompressedSizes[i]);
+  }
+}
+
+bool BatchDecompressor::gpuAvailable() {
+  int nDevices = 0;
+  return cudaGetDeviceCount(&nDevices) == cudaSuccess and nDevices > 0;
+}
+#else
+struct BatchDecompressor::GPU {
+  void decompress(std::vector<Request const*> const&) {}
+};
+
+bool BatchDecompressor::gpuAvailable() {
+  return false;
+}
+#endif
+
+BatchDecompressor::BatchDecompressor(pds::Compression iCompression, bool iUseGPU):
+  compression_{iCompression}
+{
+#if defined(TF_ENABLE_NVCOMP)
+  if(iUseGPU and gpuCanDecompress(iCompression) and gpuAvailable()) {
+    gpu_ = std::make_unique<GPU>(iCompression);
+  }
+#endif
+}
+
+BatchDecompressor::~BatchDecompressor() = default;
+
+void BatchDecompressor::decompressOnCPU(std::vector<Request> const& iRequests) const {
+  static tbb::enumerable_thread_specific<pds::DecompressionContext> s_contexts;
+  TaskHolder::WaitScope waitScope;
+  tbb::parallel_for(std::size_t(0), iRequests.size(), [this, &iRequests](std::size_t i) {
+      auto const& r = iRequests[i];
+      pds::uncompressBuffer(compression_, r.compressed_, r.compressedSize_, r.uncompressedSize_, r.uncompressed_, s_contexts.local());
+    });
+}
+
+void BatchDecompressor::decompress(std::vector<Request> const& iRequests) {
+  if(iRequests.empty()) {
+    return;
+  }
+  if(not gpu_) {
+    decompressOnCPU(iRequests);
+    return;
+  }
+  //The first caller to find no launch running launches the requests of all callers waiting at that time.
+  // Requests arriving during a launch are gathered for the next one so the GPU sees large batches.
+  Waiter waiter{&iRequests, {}};
+  std::unique_lock<std::mutex> lock(mutex_);
+  pending_.push_back(&waiter);
+  auto const myLaunch = nextLaunch_;
+  while(nFinished_ <= myLaunch) {
+    if(launching_) {
+      launched_.wait(lock);
+      continue;
+    }
+    launching_ = true;
+    std::vector<Waiter*> waiters;
+    waiters.swap(pending_);
+    ++nextLaunch_;
+    lock.unlock();
+    launch(waiters);
+    lock.lock();
+    launching_ = false;
+    ++nFinished_;
+    launched_.notify_all();
+  }
+  lock.unlock();
+  if(waiter.error_) {
+    std::rethrow_exception(waiter.error_);
+  }
+}
+
+void BatchDecompressor::launch(std::vector<Waiter*> const& iWaiters) {
+  try {
+    std::vector<Request const*> onGPU;
+    std::vector<Request> onCPU;
+    for(auto w: iWaiters) {
+      for(auto const& r: *w->requests_) {
+        if(r.uncompressedSize_ <= kMaxGPUBufferBytes) {
+          onGPU.push_back(&r);
+        } else {
+          onCPU.push_back(r);
+        }
+      }
+    }
+    if(not onGPU.empty()) {
+      gpu_->decompress(onGPU);
+      ++nLaunches_;
+      nBuffers_ += onGPU.size();
+    }
+    decompressOnCPU(onCPU);
+  } catch(...) {
+    auto error = std::current_exception();
+    for(auto w: iWaiters) {
+      w->error_ = error;
+    }
+  }
+}
@@ -0,0 +1,74 @@
+#if !defined(BatchDecompressor_h)
+#define BatchDecompressor_h
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "pds_common.h"
+
+namespace cce::tf {
+  /**
+     Decompresses many independently compressed buffers, e.g. the ZSTD frames
+     of the batches of several Lanes, with as few calls as possible. When built
+     with nvCOMP (ENABLE_NVCOMP) and a GPU is found, the buffers handed over by
+     all threads calling decompress while a launch is running are gathered and
+     decompressed together in the next single GPU launch. Otherwise, or for
+     buffers the GPU can not handle, the buffers are decompressed in parallel
+     on the CPU.
+   */
+  class BatchDecompressor {
+  public:
+    struct Request {
+      char const* compressed_;
+      std::size_t compressedSize_;
+      char* uncompressed_;
+      std::size_t uncompressedSize_;
+    };
+
+    //iUseGPU false always decompresses on the CPU
+    BatchDecompressor(pds::Compression, bool iUseGPU);
+    ~BatchDecompressor();
+    BatchDecompressor(BatchDecompressor const&) = delete;
+    BatchDecompressor& operator=(BatchDecompressor const&) = delete;
+
+    //returns once all of iRequests were decompressed, throws if one failed
+    void decompress(std::vector<Request> const& iRequests);
+
+    bool usesGPU() const { return static_cast<bool>(gpu_); }
+    //number of GPU launches and the number of buffers they decompressed
+    unsigned long long nLaunches() const { return nLaunches_; }
+    unsigned long long nBuffers() const { return nBuffers_; }
+
+    //false if the library was built without nvCOMP or no GPU can be used
+    static bool gpuAvailable();
+
+  private:
+    struct Waiter {
+      std::vector<Request> const* requests_;
+      std::exception_ptr error_;
+    };
+    struct GPU;
+
+    void decompressOnCPU(std::vector<Request> const&) const;
+    //decompresses the requests of all iWaiters in one launch
+    void launch(std::vector<Waiter*> const& iWaiters);
+
+    pds::Compression compression_;
+    std::unique_ptr<GPU> gpu_;
+
+    std::mutex mutex_;
+    std::condition_variable launched_;
+    std::vector<Waiter*> pending_;
+    //the launch the next pending request goes into and the number of launches finished
+    unsigned long long nextLaunch_ = 0;
+    unsigned long long nFinished_ = 0;
+    bool launching_ = false;
+    unsigned long long nLaunches_ = 0;
+    unsigned long long nBuffers_ = 0;
+  };
+}
+#endif
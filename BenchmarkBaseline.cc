@@ -0,0 +1,389 @@
+#include "BenchmarkBaseline.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+#include "RunReport.h"
+
+namespace cce::tf {
+  namespace {
+    //just enough JSON for what RunReport writes
+    struct JSONValue {
+      enum class Kind { kNull, kBool, kNumber, kString, kArray, kObject };
+      Kind kind_ = Kind::kNull;
+      double number_ = 0;
+      std::string string_;
+      std::vector<JSONValue> array_;
+      std::vector<std::pair<std::string, JSONValue>> object_;
+
+      JSONValue const* find(std::string_view iKey) const {
+        for(auto const& [key, value]: object_) {
+          if(key == iKey) {
+            return &value;
+          }
+        }
+        return nullptr;
+      }
+    };
+
+    class JSONParser {
+    public:
+      explicit JSONParser(std::string_view iText): text_{iText} {}
+
+      JSONValue parse() {
+        auto value = parseValue();
+        skipSpace();
+        if(pos_ != text_.size()) {
+          fail("unexpected text after the value");
+        }
+        return value;
+      }
+
+    private:
+      [[noreturn]] void fail(std::string const& iWhat) const {
+        throw std::runtime_error(iWhat+" at character "+std::to_string(pos_));
+      }
+      void skipSpace() {
+        while(pos_ < text_.size() and std::isspace(static_cast<unsigned char>(text_[pos_]))) {
+          ++pos_;
+        }
+      }
+      bool consume(char iChar) {
+        skipSpace();
+        if(pos_ < text_.size() and text_[pos_] == iChar) {
+          ++pos_;
+          return true;
+        }
+        return false;
+      }
+      void expect(char iChar) {
+        if(not consume(iChar)) {
+          fail(std::string("expected '")+iChar+"'");
+        }
+      }
+      bool consumeWord(std::string_view iWord) {
+        if(text_.substr(pos_, iWord.size()) == iWord) {
+          pos_ += iWord.size();
+          return true;
+        }
+        return false;
+      }
+
+      std::string parseString() {
+        expect('"');
+        std::string value;
+        while(pos_ < text_.size() and text_[pos_] != '"') {
+          char c = text_[pos_++];
+          if(c == '\\') {
+            if(pos_ >= text_.size()) {
+              break;
+            }
+            char e = text_[pos_++];
+            switch(e) {
+            case 'n': value.push_back('\n'); break;
+            case 't': value.push_back('\t'); break;
+            case 'r': value.push_back('\r'); break;
+            case 'u': {
+              if(pos_+4 > text_.size()) {
+                fail("short \\u escape");
+              }
+              //RunReport only escapes control characters this way
+              value.push_back(static_cast<char>(std::stoi(std::string(text_.substr(pos_, 4)), nullptr, 16)));
+              pos_ += 4;
+              break;
+            }
+            default: value.push_back(e);
+            }
+          } else {
+            value.push_back(c);
+          }
+        }
+        if(pos_ >= text_.size()) {
+          fail("unterminated string");
+        }
+        ++pos_;
+        return value;
+      }
+
+      JSONValue parseValue() {
+        skipSpace();
+        if(pos_ >= text_.size()) {
+          fail("missing value");
+        }
+        JSONValue value;
+        char c = text_[pos_];
+        if(c == '{') {
+          value.kind_ = JSONValue::Kind::kObject;
+          ++pos_;
+          if(consume('}')) {
+            return value;
+          }
+          do {
+            skipSpace();
+            auto key = parseString();
+            expect(':');
+            value.object_.emplace_back(std::move(key), parseValue());
+          } while(consume(','));
+          expect('}');
+        } else if(c == '[') {
+          value.kind_ = JSONValue::Kind::kArray;
+          ++pos_;
+          if(consume(']')) {
+            return value;
+          }
+          do {
+            value.array_.push_back(parseValue());
+          } while(consume(','));
+          expect(']');
+        } else if(c == '"') {
+          value.kind_ = JSONValue::Kind::kString;
+          value.string_ = parseString();
+        } else if(consumeWord("true")) {
+          value.kind_ = JSONValue::Kind::kBool;
+          value.number_ = 1;
+        } else if(consumeWord("false")) {
+          value.kind_ = JSONValue::Kind::kBool;
+        } else if(consumeWord("null")) {
+        } else {
+          std::string rest(text_.substr(pos_, 64));
+          std::size_t used = 0;
+          try {
+            value.number_ = std::stod(rest, &used);
+          } catch(std::logic_error const&) {
+            fail("expected a value");
+          }
+          value.kind_ = JSONValue::Kind::kNumber;
+          pos_ += used;
+        }
+        return value;
+      }
+
+      std::string_view text_;
+      std::size_t pos_ = 0;
+    };
+
+    struct MeanAndVariance {
+      double mean_ = 0;
+      //of the sample, 0 with fewer than 2 values
+      double variance_ = 0;
+    };
+    MeanAndVariance meanAndVariance(std::vector<double> const& iValues) {
+      MeanAndVariance result;
+      if(iValues.empty()) {
+        return result;
+      }
+      for(auto v: iValues) {
+        result.mean_ += v;
+      }
+      result.mean_ /= iValues.size();
+      if(iValues.size() > 1) {
+        for(auto v: iValues) {
+          result.variance_ += (v-result.mean_)*(v-result.mean_);
+        }
+        result.variance_ /= iValues.size()-1;
+      }
+      return result;
+    }
+
+    //two sided 95% quantile of Student's t distribution
+    double studentT95(double iDegreesOfFreedom) {
+      constexpr std::array<double, 30> kTable = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                                 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                                 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+      //rounding down gives the wider interval
+      long df = static_cast<long>(std::floor(iDegreesOfFreedom));
+      if(df < 1) {
+        return kTable[0];
+      }
+      if(df <= static_cast<long>(kTable.size())) {
+        return kTable[df-1];
+      }
+      return 1.960 + 2.4/df;
+    }
+  }
+
+  std::optional<std::vector<BenchmarkScenario>> readScenarios(std::istream& iStream) {
+    std::vector<BenchmarkScenario> scenarios;
+    std::string line;
+    unsigned int lineNumber = 0;
+    while(std::getline(iStream, line)) {
+      ++lineNumber;
+      std::istringstream items(line);
+      BenchmarkScenario scenario;
+      if(not (items >> scenario.name_) or scenario.name_[0] == '#') {
+        continue;
+      }
+      if(not (items >> scenario.threads_ >> scenario.source_ >> scenario.outputer_) or scenario.threads_ <= 0) {
+        std::cout <<"scenario line "<<lineNumber<<" is not '<name> <# threads> <Source configuration> <Outputer configuration> [<# lanes>]'"<<std::endl;
+        return {};
+      }
+      scenario.lanes_ = scenario.threads_;
+      int lanes = 0;
+      if(items >> lanes) {
+        if(lanes <= 0) {
+          std::cout <<"scenario line "<<lineNumber<<" has an invalid number of lanes"<<std::endl;
+          return {};
+        }
+        scenario.lanes_ = lanes;
+      }
+      for(auto const& s: scenarios) {
+        if(s.name_ == scenario.name_) {
+          std::cout <<"scenario "<<scenario.name_<<" is given more than once"<<std::endl;
+          return {};
+        }
+      }
+      scenarios.push_back(std::move(scenario));
+    }
+    return scenarios;
+  }
+
+  void fillBaseline(RunReport& oReport, BenchmarkBaseline const& iBaseline) {
+    auto& scenarios = oReport.section("scenarios");
+    for(auto const& [name, samples]: iBaseline) {
+      auto& s = scenarios.section(name);
+      s.set("source", samples.scenario_.source_);
+      s.set("outputer", samples.scenario_.outputer_);
+      s.set("threads", samples.scenario_.threads_);
+      s.set("lanes", samples.scenario_.lanes_);
+      auto& metrics = s.section("metrics");
+      for(auto const& [metric, values]: samples.metrics_) {
+        metrics.set(metric, values);
+      }
+    }
+  }
+
+  std::optional<BenchmarkBaseline> readBaseline(std::istream& iStream) {
+    std::string text(std::istreambuf_iterator<char>(iStream), {});
+    BenchmarkBaseline baseline;
+    try {
+      auto root = JSONParser(text).parse();
+      auto scenarios = root.find("scenarios");
+      if(not scenarios or scenarios->kind_ != JSONValue::Kind::kObject) {
+        std::cout <<"the baseline has no scenarios"<<std::endl;
+        return {};
+      }
+      for(auto const& [name, value]: scenarios->object_) {
+        ScenarioSamples samples;
+        samples.scenario_.name_ = name;
+        if(auto v = value.find("source")) { samples.scenario_.source_ = v->string_; }
+        if(auto v = value.find("outputer")) { samples.scenario_.outputer_ = v->string_; }
+        if(auto v = value.find("threads")) { samples.scenario_.threads_ = v->number_; }
+        if(auto v = value.find("lanes")) { samples.scenario_.lanes_ = v->number_; }
+        if(auto metrics = value.find("metrics")) {
+          for(auto const& [metric, values]: metrics->object_) {
+            auto& m = samples.metrics_[metric];
+            for(auto const& v: values.array_) {
+              if(v.kind_ == JSONValue::Kind::kNumber) {
+                m.push_back(v.number_);
+              }
+            }
+          }
+        }
+        baseline.emplace(name, std::move(samples));
+      }
+    } catch(std::exception const& e) {
+      std::cout <<"unable to read the baseline: "<<e.what()<<std::endl;
+      return {};
+    }
+    return baseline;
+  }
+
+  MetricComparison compareMetric(std::vector<double> const& iBaseline, std::vector<double> const& iCurrent,
+                                 bool iHigherIsBetter, double iThreshold) {
+    MetricComparison result;
+    auto base = meanAndVariance(iBaseline);
+    auto current = meanAndVariance(iCurrent);
+    result.baselineMean_ = base.mean_;
+    result.currentMean_ = current.mean_;
+    if(base.mean_ == 0) {
+      return result;
+    }
+    double const difference = current.mean_ - base.mean_;
+    result.change_ = difference/base.mean_;
+    result.changeLow_ = result.change_;
+    result.changeHigh_ = result.change_;
+    if(iBaseline.size() > 1 and iCurrent.size() > 1) {
+      double const baseTerm = base.variance_/iBaseline.size();
+      double const currentTerm = current.variance_/iCurrent.size();
+      double const standardError = std::sqrt(baseTerm + currentTerm);
+      double halfWidth = 0;
+      if(standardError > 0) {
+        //Welch-Satterthwaite
+        double const df = (baseTerm+currentTerm)*(baseTerm+currentTerm)/
+          (baseTerm*baseTerm/(iBaseline.size()-1) + currentTerm*currentTerm/(iCurrent.size()-1));
+        halfWidth = studentT95(df)*standardError;
+      }
+      result.changeLow_ = (difference - halfWidth)/base.mean_;
+      result.changeHigh_ = (difference + halfWidth)/base.mean_;
+      result.hasInterval_ = true;
+    }
+    if(iHigherIsBetter) {
+      result.regression_ = result.change_ < -iThreshold and result.changeHigh_ < 0;
+    } else {
+      result.regression_ = result.change_ > iThreshold and result.changeLow_ > 0;
+    }
+    return result;
+  }
+
+  std::vector<MetricComparison> compareBaselines(BenchmarkBaseline const& iBaseline, BenchmarkBaseline const& iCurrent, double iThreshold) {
+    std::vector<MetricComparison> comparisons;
+    for(auto const& [name, current]: iCurrent) {
+      auto itBase = iBaseline.find(name);
+      if(itBase == iBaseline.end()) {
+        continue;
+      }
+      for(auto const& [metric, values]: current.metrics_) {
+        auto itMetric = itBase->second.metrics_.find(metric);
+        if(itMetric == itBase->second.metrics_.end() or itMetric->second.empty() or values.empty()) {
+          continue;
+        }
+        auto comparison = compareMetric(itMetric->second, values, metric == kEventRateMetric, iThreshold);
+        comparison.scenario_ = name;
+        comparison.metric_ = metric;
+        comparisons.push_back(std::move(comparison));
+      }
+    }
+    return comparisons;
+  }
+
+  void printComparisons(std::vector<MetricComparison> const& iComparisons) {
+    std::cout <<"----------\n"
+              <<"baseline comparison, change of the mean with its 95% confidence interval\n";
+    for(auto const& c: iComparisons) {
+      std::cout <<(c.regression_ ? "REGRESSION " : "           ")<<c.scenario_<<" "<<c.metric_
+                <<" baseline "<<c.baselineMean_<<" now "<<c.currentMean_
+                <<std::showpos<<" change "<<std::lround(c.change_*1000)/10.<<"%";
+      if(c.hasInterval_) {
+        std::cout <<" ["<<std::lround(c.changeLow_*1000)/10.<<"%, "<<std::lround(c.changeHigh_*1000)/10.<<"%]";
+      }
+      std::cout <<std::noshowpos<<"\n";
+    }
+    auto nRegressions = std::count_if(iComparisons.begin(), iComparisons.end(), [](auto const& c) { return c.regression_; });
+    std::cout <<"regressions: "<<nRegressions<<" of "<<iComparisons.size()<<" metrics\n"
+              <<"----------"<<std::endl;
+  }
+
+  void fillComparisonReport(RunReport& oReport, std::vector<MetricComparison> const& iComparisons) {
+    unsigned int nRegressions = 0;
+    for(auto const& c: iComparisons) {
+      auto& m = oReport.section(c.scenario_).section(c.metric_);
+      m.set("baselineMean", c.baselineMean_);
+      m.set("mean", c.currentMean_);
+      m.set("change", c.change_);
+      if(c.hasInterval_) {
+        m.set("changeLow", c.changeLow_);
+        m.set("changeHigh", c.changeHigh_);
+      }
+      m.set("regression", c.regression_);
+      nRegressions += c.regression_ ? 1 : 0;
+    }
+    oReport.set("regressions", nRegressions);
+  }
+}
@@ -0,0 +1,75 @@
+#if !defined(BenchmarkBaseline_h)
+#define BenchmarkBaseline_h
+
+#include <iosfwd>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cce::tf {
+  class RunReport;
+
+  /**
+     The measurements of the repetitions of benchmark scenarios, kept to
+     compare later versions of the code against. A scenario is a Source, an
+     Outputer and a number of threads. Each metric holds one value per
+     repetition. "eventRate" is the events per second, where higher is
+     better; the other metrics are times per event, e.g.
+     "outputer.serialTime_us", where lower is better.
+   */
+  struct BenchmarkScenario {
+    std::string name_;
+    std::string source_;
+    std::string outputer_;
+    int threads_ = 1;
+    unsigned int lanes_ = 1;
+  };
+
+  struct ScenarioSamples {
+    BenchmarkScenario scenario_;
+    std::map<std::string, std::vector<double>> metrics_;
+  };
+
+  using BenchmarkBaseline = std::map<std::string, ScenarioSamples>;
+
+  constexpr std::string_view kEventRateMetric = "eventRate";
+
+  //Reads a scenario file: one scenario per line as
+  //   <name> <# threads> <Source configuration> <Outputer configuration> [<# lanes>]
+  // Empty lines and those starting with '#' are skipped. Without a number
+  // of lanes it is the number of threads. Prints the problem and returns nothing if not valid.
+  std::optional<std::vector<BenchmarkScenario>> readScenarios(std::istream&);
+
+  void fillBaseline(RunReport&, BenchmarkBaseline const&);
+  //reads what fillBaseline wrote. Prints the problem and returns nothing if not valid.
+  std::optional<BenchmarkBaseline> readBaseline(std::istream&);
+
+  struct MetricComparison {
+    std::string scenario_;
+    std::string metric_;
+    double baselineMean_ = 0;
+    double currentMean_ = 0;
+    //relative change of the mean and the 95% confidence interval of it
+    double change_ = 0;
+    double changeLow_ = 0;
+    double changeHigh_ = 0;
+    //the confidence interval is only known with at least 2 repetitions of each
+    bool hasInterval_ = false;
+    bool regression_ = false;
+  };
+
+  //Uses Welch's t interval for the difference of the means. A metric is a
+  // regression when it got worse by more than iThreshold, relative to the
+  // baseline, and, if the interval is known, the whole interval is worse.
+  MetricComparison compareMetric(std::vector<double> const& iBaseline, std::vector<double> const& iCurrent,
+                                 bool iHigherIsBetter, double iThreshold);
+
+  //the metrics found in both, scenarios are matched by name
+  std::vector<MetricComparison> compareBaselines(BenchmarkBaseline const& iBaseline, BenchmarkBaseline const& iCurrent, double iThreshold);
+
+  void printComparisons(std::vector<MetricComparison> const&);
+  void fillComparisonReport(RunReport&, std::vector<MetricComparison> const&);
+}
+#endif
@@ -0,0 +1,112 @@
+#include "BlobDumpOutputer.h"
+#include "OutputerFactory.h"
+#include "ConfigurationParameters.h"
+#include "UnrolledSerializerWrapper.h"
+#include "FixedLayoutSerializerWrapper.h"
+#include "SerializerWrapper.h"
+#include "summarize_serializers.h"
+#include "summarize_queue.h"
+#include "RunReport.h"
+#include <iostream>
+#include <map>
+#include <stdexcept>
+
+using namespace cce::tf;
+
+void BlobDumpOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) {
+  auto& s = serializers_[iLaneIndex];
+  switch(serialization_) {
+  case pds::Serialization::kRoot:
+    {   s = SerializeStrategy::make<SerializeProxy<SerializerWrapper>>(); break; }
+  case pds::Serialization::kRootUnrolled:
+    {   s = SerializeStrategy::make<SerializeProxy<UnrolledSerializerWrapper>>(); break; }
+  case pds::Serialization::kNativeUnrolled:
+    {   s = SerializeStrategy::make<SerializeProxy<NativeUnrolledSerializerWrapper>>(); break; }
+  case pds::Serialization::kFixedLayout:
+    {   s = SerializeStrategy::make<SerializeProxy<FixedLayoutSerializerWrapper>>(); break; }
+  }
+  s.reserve(iDPs.size());
+  for(auto const& dp: iDPs) {
+    s.emplace_back(dp.name(), dp.classType());
+  }
+  //all Lanes have the same data products
+  std::call_once(writersOnce_, [this, &s]() {
+      if(not corpus::makeDirectory(directory_)) {
+        throw std::runtime_error("unable to make the corpus directory "+directory_);
+      }
+      std::map<std::string, unsigned int> classToWriter;
+      productToWriter_.reserve(s.size());
+      for(auto const& w: s) {
+        auto [it, inserted] = classToWriter.emplace(w.className(), writers_.size());
+        if(inserted) {
+          writers_.push_back(std::make_unique<corpus::CorpusWriter>(directory_, w.className(), static_cast<uint32_t>(serialization_)));
+          writerClassNames_.emplace_back(w.className());
+        }
+        productToWriter_.push_back(it->second);
+      }
+    });
+}
+
+void BlobDumpOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+  queue_.push(*iCallback.group(), [this, iLaneIndex, callback=std::move(iCallback)]() mutable {
+      write(serializers_[iLaneIndex]);
+      callback.doneWaiting();
+    });
+}
+
+void BlobDumpOutputer::write(SerializeStrategy const& iSerializers) const {
+  for(std::size_t i = 0; i < iSerializers.size(); ++i) {
+    auto& writer = *writers_[productToWriter_[i]];
+    if(maxBlobsPerType_ == 0 or writer.nBlobs() < maxBlobsPerType_) {
+      writer.write(iSerializers[i].blob());
+    }
+  }
+}
+
+void BlobDumpOutputer::printSummary() const {
+  summarize_queue("BlobDumpOutputer", queue_);
+  std::cout <<"BlobDumpOutputer corpus "<<directory_<<"\n";
+  for(std::size_t i = 0; i < writers_.size(); ++i) {
+    std::cout <<"  blobs: "<<writers_[i]->nBlobs()<<"\tbytes: "<<writers_[i]->bytes()<<"\ttype: "<<writerClassNames_[i]<<"\n";
+  }
+  summarize_serializers(serializers_);
+}
+
+void BlobDumpOutputer::fillProfile(ProductProfile& oProfile) const {
+  profile_serializers(oProfile, serializers_);
+}
+
+void BlobDumpOutputer::fillReport(RunReport& oReport) const {
+  oReport.set("directory", directory_);
+  auto& types = oReport.section("types");
+  for(std::size_t i = 0; i < writers_.size(); ++i) {
+    auto& type = types.section(writerClassNames_[i]);
+    type.set("blobs", writers_[i]->nBlobs());
+    type.set("bytes", writers_[i]->bytes());
+  }
+}
+
+namespace {
+  class Maker : public OutputerMakerBase {
+  public:
+    Maker(): OutputerMakerBase("BlobDumpOutputer") {}
+
+    std::unique_ptr<OutputerBase> create(unsigned int iNLanes, ConfigurationParameters const& params) const final {
+      auto directory = params.get<std::string>("fileName");
+      if(not directory) {
+        std::cout <<"no corpus directory given for BlobDumpOutputer\n";
+        return {};
+      }
+      auto serializationName = params.get<std::string>("serializationAlgorithm", "ROOT");
+      auto serialization = pds::toSerialization(serializationName);
+      if(not serialization) {
+        std::cout <<"unknown serialization "<<serializationName<<std::endl;
+        return {};
+      }
+      auto maxBlobs = params.get<unsigned int>("maxBlobsPerType", 0);
+      return std::make_unique<BlobDumpOutputer>(*directory, iNLanes, *serialization, maxBlobs);
+    }
+  };
+
+  Maker s_maker;
+}
@@ -0,0 +1,62 @@
+#if !defined(BlobDumpOutputer_h)
+#define BlobDumpOutputer_h
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "OutputerBase.h"
+#include "EventIdentifier.h"
+#include "SerializeStrategy.h"
+#include "DataProductRetriever.h"
+#include "SerialTaskQueue.h"
+#include "blob_corpus.h"
+#include "pds_common.h"
+
+namespace cce::tf {
+/**
+   Writes the serialized bytes of each data product to a corpus directory, one
+   file per data product type, to be used by codec_bench to compare the
+   compression algorithms on real data. Data products passed through by a
+   Source with the same serialization are written as they were read.
+ */
+class BlobDumpOutputer :public OutputerBase {
+ public:
+  //iMaxBlobsPerType 0 means no limit
+  BlobDumpOutputer(std::string iDirectory, unsigned int iNLanes, pds::Serialization iSerialization, unsigned long long iMaxBlobsPerType):
+    directory_{std::move(iDirectory)}, serializers_(iNLanes), serialization_{iSerialization}, maxBlobsPerType_{iMaxBlobsPerType} {}
+
+  void setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) final;
+  bool setupForLaneIsThreadSafe() const final { return true; }
+
+  void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const final {
+    auto& laneSerializers = serializers_[iLaneIndex];
+    serializeOrPassThroughAsync(laneSerializers[iDataProduct.index()], iDataProduct, serialization_, std::move(iCallback), 0);
+  }
+  bool usesProductReadyAsync() const final { return true; }
+
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+
+  void printSummary() const final;
+  void fillReport(RunReport&) const final;
+  void fillProfile(ProductProfile&) const final;
+
+ private:
+  void write(SerializeStrategy const& iSerializers) const;
+
+  std::string const directory_;
+  mutable std::vector<SerializeStrategy> serializers_;
+  pds::Serialization const serialization_;
+  unsigned long long const maxBlobsPerType_;
+
+  std::once_flag writersOnce_;
+  //one per data product type, only used from within queue_
+  mutable std::vector<std::unique_ptr<corpus::CorpusWriter>> writers_;
+  //the index into writers_ of each data product
+  std::vector<unsigned int> productToWriter_;
+  std::vector<std::string> writerClassNames_;
+  mutable SerialTaskQueue queue_;
+};
+}
+#endif
@@ -0,0 +1,29 @@
+#if !defined(BlobView_h)
+#define BlobView_h
+
+#include <cstddef>
+#include <vector>
+
+namespace cce::tf {
+  /**
+     Non-owning view of a serialized data product. The memory is owned by
+     whatever produced the view, e.g. the TBufferFile of a serializer, and is
+     only valid until that object serializes again.
+   */
+  class BlobView {
+  public:
+    BlobView() = default;
+    BlobView(char const* iData, std::size_t iSize): data_{iData}, size_{iSize} {}
+    BlobView(std::vector<char> const& iBlob): data_{iBlob.data()}, size_{iBlob.size()} {}
+
+    char const* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    char const* begin() const { return data_; }
+    char const* end() const { return data_+size_; }
+  private:
+    char const* data_ = nullptr;
+    std::size_t size_ = 0;
+  };
+}
+#endif
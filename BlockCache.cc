@@ -0,0 +1,253 @@
+#include "BlockCache.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "RunReport.h"
+#include "configKeyValuePairs.h"
+
+namespace cce::tf {
+  namespace {
+    std::unique_ptr<BlockCache> s_cache;
+
+    void readAll(int iFD, char* oBuffer, std::size_t iSize, uint64_t iOffset) {
+      while(iSize != 0) {
+        auto nRead = ::pread(iFD, oBuffer, iSize, iOffset);
+        if(nRead <= 0) {
+          throw std::runtime_error("failed to read "+std::to_string(iSize)+" bytes from the block cache");
+        }
+        oBuffer += nRead;
+        iOffset += nRead;
+        iSize -= nRead;
+      }
+    }
+
+    void writeAll(int iFD, char const* iBuffer, std::size_t iSize, uint64_t iOffset) {
+      while(iSize != 0) {
+        auto nWritten = ::pwrite(iFD, iBuffer, iSize, iOffset);
+        if(nWritten <= 0) {
+          throw std::runtime_error(std::string("failed to write to the block cache: ")+std::strerror(errno));
+        }
+        iBuffer += nWritten;
+        iOffset += nWritten;
+        iSize -= nWritten;
+      }
+    }
+  }
+
+  BlockCache::BlockCache(Config const& iConfig): config_{iConfig} {
+    if(config_.blockSize_ == 0 or config_.nShards_ == 0) {
+      throw std::runtime_error("the block cache needs a block size and at least one shard");
+    }
+    unsigned int const slotsPerShard = std::max<std::size_t>(config_.size_/config_.blockSize_/config_.nShards_, 1);
+    shards_.reserve(config_.nShards_);
+    for(unsigned int i = 0; i < config_.nShards_; ++i) {
+      auto shard = std::make_unique<Shard>();
+      auto name = config_.directory_+"/block_cache_"+std::to_string(::getpid())+"_"+std::to_string(i);
+      shard->fd_ = ::open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+      if(shard->fd_ < 0) {
+        throw std::runtime_error("unable to make block cache file "+name+": "+std::strerror(errno));
+      }
+      //the file stays usable until closed
+      ::unlink(name.c_str());
+      shard->slots_.resize(slotsPerShard);
+      shard->freeSlots_.reserve(slotsPerShard);
+      //hand out the slots from the start of the file
+      for(unsigned int s = slotsPerShard; s != 0; --s) {
+        shard->freeSlots_.push_back(s-1);
+      }
+      shards_.push_back(std::move(shard));
+    }
+  }
+
+  BlockCache::~BlockCache() {
+    for(auto& shard: shards_) {
+      ::close(shard->fd_);
+    }
+  }
+
+  BlockCache::Shard& BlockCache::shardFor(Key const& iKey) {
+    return *shards_[KeyHash()(iKey) % shards_.size()];
+  }
+
+  bool BlockCache::contains(Key const& iKey) {
+    auto& shard = shardFor(iKey);
+    std::lock_guard<std::mutex> guard(shard.mutex_);
+    return shard.index_.find(iKey) != shard.index_.end();
+  }
+
+  std::optional<std::size_t> BlockCache::copyFromCache(Key const& iKey, uint64_t iOffset, std::size_t iSize, char* oBuffer) {
+    auto& shard = shardFor(iKey);
+    std::lock_guard<std::mutex> guard(shard.mutex_);
+    auto found = shard.index_.find(iKey);
+    if(found == shard.index_.end()) {
+      return {};
+    }
+    auto& slot = shard.slots_[found->second];
+    shard.lru_.splice(shard.lru_.begin(), shard.lru_, slot.lru_);
+    uint64_t const blockStart = iKey.block_*config_.blockSize_;
+    uint64_t const begin = std::max(iOffset, blockStart);
+    uint64_t const end = std::min(iOffset+iSize, blockStart+slot.length_);
+    if(end > begin) {
+      //the slot can not be reused while the lock is held
+      readAll(shard.fd_, oBuffer + (begin-iOffset), end-begin, uint64_t(found->second)*config_.blockSize_ + (begin-blockStart));
+      bytesFromCache_ += end-begin;
+    }
+    ++nHits_;
+    return slot.length_;
+  }
+
+  void BlockCache::insert(Key const& iKey, char const* iData, std::size_t iLength) {
+    auto& shard = shardFor(iKey);
+    std::lock_guard<std::mutex> guard(shard.mutex_);
+    if(shard.index_.find(iKey) != shard.index_.end()) {
+      //another thread fetched it as well
+      return;
+    }
+    unsigned int slotIndex;
+    if(not shard.freeSlots_.empty()) {
+      slotIndex = shard.freeSlots_.back();
+      shard.freeSlots_.pop_back();
+    } else {
+      slotIndex = shard.lru_.back();
+      shard.lru_.pop_back();
+      shard.index_.erase(shard.slots_[slotIndex].key_);
+      ++nEvictions_;
+    }
+    writeAll(shard.fd_, iData, iLength, uint64_t(slotIndex)*config_.blockSize_);
+    auto& slot = shard.slots_[slotIndex];
+    slot.key_ = iKey;
+    slot.length_ = iLength;
+    shard.lru_.push_front(slotIndex);
+    slot.lru_ = shard.lru_.begin();
+    shard.index_.emplace(iKey, slotIndex);
+  }
+
+  std::size_t BlockCache::read(std::string const& iFile, uint64_t iOffset, std::size_t iSize, char* oBuffer, Fetch const& iFetch) {
+    if(iSize == 0) {
+      return 0;
+    }
+    auto const blockSize = config_.blockSize_;
+    uint64_t const lastBlock = (iOffset+iSize-1)/blockSize;
+    uint64_t block = iOffset/blockSize;
+    //the end of the bytes given to oBuffer
+    uint64_t end = iOffset;
+    auto copied = [&](uint64_t iBlock, std::size_t iLength) {
+      end = std::max(end, std::min(iOffset+iSize, iBlock*blockSize+iLength));
+    };
+    std::vector<char> fetched;
+    while(block <= lastBlock) {
+      Key key{iFile, block};
+      if(auto length = copyFromCache(key, iOffset, iSize, oBuffer)) {
+        copied(block, *length);
+        if(*length < blockSize) {
+          //the last block of the file
+          break;
+        }
+        ++block;
+        continue;
+      }
+      //the following missing blocks are fetched with the same request
+      uint64_t endBlock = block+1;
+      while(endBlock <= lastBlock and not contains(Key{iFile, endBlock})) {
+        ++endBlock;
+      }
+      fetched.resize((endBlock-block)*blockSize);
+      auto const nFetched = iFetch(block*blockSize, fetched.size(), fetched.data());
+      ++nFetches_;
+      bytesFetched_ += nFetched;
+      for(uint64_t b = block; b < endBlock; ++b) {
+        std::size_t const start = (b-block)*blockSize;
+        if(start >= nFetched) {
+          break;
+        }
+        auto const length = std::min(blockSize, nFetched-start);
+        insert(Key{iFile, b}, fetched.data()+start, length);
+        ++nMisses_;
+        uint64_t const blockStart = b*blockSize;
+        uint64_t const begin = std::max(iOffset, blockStart);
+        uint64_t const blockEnd = std::min(iOffset+iSize, blockStart+length);
+        if(blockEnd > begin) {
+          std::copy(fetched.data()+start+(begin-blockStart), fetched.data()+start+(blockEnd-blockStart), oBuffer+(begin-iOffset));
+        }
+        copied(b, length);
+      }
+      if(nFetched < fetched.size()) {
+        break;
+      }
+      block = endBlock;
+    }
+    return end-iOffset;
+  }
+
+  void BlockCache::printSummary() const {
+    std::cout <<"Block cache "<<config_.directory_<<" size: "<<config_.size_<<" bytes block size: "<<config_.blockSize_
+              <<" shards: "<<config_.nShards_<<"\n"
+              <<"  block hits: "<<nHits()<<" misses: "<<nMisses()<<" evictions: "<<nEvictions()<<"\n"
+              <<"  bytes from cache: "<<bytesFromCache()<<" bytes fetched: "<<bytesFetched()<<" in "<<nFetches()<<" requests\n";
+  }
+
+  void BlockCache::fillReport(RunReport& oReport) const {
+    oReport.set("directory", config_.directory_);
+    oReport.set("size", config_.size_);
+    oReport.set("blockSize", config_.blockSize_);
+    oReport.set("shards", config_.nShards_);
+    oReport.set("hits", nHits());
+    oReport.set("misses", nMisses());
+    oReport.set("evictions", nEvictions());
+    oReport.set("fetches", nFetches());
+    oReport.set("bytesFromCache", bytesFromCache());
+    oReport.set("bytesFetched", bytesFetched());
+  }
+
+  std::optional<BlockCache::Config> parseBlockCacheConfig(std::string_view iConfig) {
+    BlockCache::Config config;
+    for(auto const& [key, value]: configKeyValuePairs(iConfig)) {
+      try {
+        std::size_t used = 0;
+        if(key == "dir") {
+          config.directory_ = value;
+          used = value.size();
+        } else if(key == "size_MB") {
+          config.size_ = std::stoull(value, &used)*1000*1000;
+        } else if(key == "block_kB") {
+          config.blockSize_ = std::stoull(value, &used)*1024;
+        } else if(key == "shards") {
+          config.nShards_ = std::stoul(value, &used);
+        } else {
+          std::cout <<"Unknown block cache parameter '"<<key<<"', allowed are dir, size_MB, block_kB and shards"<<std::endl;
+          return {};
+        }
+        if(used != value.size()) {
+          throw std::invalid_argument(value);
+        }
+      } catch(std::logic_error const&) {
+        std::cout <<"block cache parameter "<<key<<" has the invalid value '"<<value<<"'"<<std::endl;
+        return {};
+      }
+    }
+    if(config.directory_.empty()) {
+      std::cout <<"the block cache needs the directory, dir, to hold its files"<<std::endl;
+      return {};
+    }
+    if(config.blockSize_ == 0 or config.nShards_ == 0) {
+      std::cout <<"block cache block_kB and shards must not be 0"<<std::endl;
+      return {};
+    }
+    return config;
+  }
+
+  BlockCache* blockCache() {
+    return s_cache.get();
+  }
+
+  void setBlockCache(std::unique_ptr<BlockCache> iCache) {
+    s_cache = std::move(iCache);
+  }
+}
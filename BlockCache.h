@@ -0,0 +1,115 @@
+#if !defined(BlockCache_h)
+#define BlockCache_h
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cce::tf {
+  class RunReport;
+
+  /**
+     Keeps blocks of remote files in files on a local disk, e.g. an NVMe SSD,
+     so reading the same bytes again, by a later pass over the file or by
+     another replica of the Source, does not go to the remote storage. Blocks
+     are keyed by the file name and the block's index within the file. The
+     cache is split into shards, each with its own lock, cache file and least
+     recently used list, so concurrent reads of different blocks rarely
+     contend. The cache files are removed once opened so they go away with the
+     process.
+   */
+  class BlockCache {
+  public:
+    struct Config {
+      std::string directory_;
+      //total bytes held on the local disk
+      std::size_t size_ = std::size_t(1) << 30;
+      std::size_t blockSize_ = std::size_t(1) << 20;
+      unsigned int nShards_ = 16;
+    };
+    //throws if the cache files can not be made
+    explicit BlockCache(Config const&);
+    ~BlockCache();
+
+    BlockCache(BlockCache const&) = delete;
+    BlockCache& operator=(BlockCache const&) = delete;
+
+    //reads iSize bytes at iOffset of the file into oBuffer and returns how many it
+    // read, fewer only at the end of the file
+    using Fetch = std::function<std::size_t(uint64_t iOffset, std::size_t iSize, char* oBuffer)>;
+    //Reads iSize bytes at iOffset of iFile into oBuffer. The blocks not in the cache
+    // are read with iFetch, consecutive missing blocks with one call, and then added.
+    // Returns the number of bytes read. Can be called concurrently.
+    std::size_t read(std::string const& iFile, uint64_t iOffset, std::size_t iSize, char* oBuffer, Fetch const& iFetch);
+
+    Config const& config() const { return config_; }
+    unsigned long long nHits() const { return nHits_.load(); }
+    unsigned long long nMisses() const { return nMisses_.load(); }
+    unsigned long long nFetches() const { return nFetches_.load(); }
+    unsigned long long nEvictions() const { return nEvictions_.load(); }
+    //bytes given to the readers from the cache files and bytes read with Fetch
+    unsigned long long bytesFromCache() const { return bytesFromCache_.load(); }
+    unsigned long long bytesFetched() const { return bytesFetched_.load(); }
+
+    void printSummary() const;
+    void fillReport(RunReport&) const;
+
+  private:
+    struct Key {
+      std::string file_;
+      uint64_t block_;
+      bool operator==(Key const& iOther) const { return block_ == iOther.block_ and file_ == iOther.file_; }
+    };
+    struct KeyHash {
+      std::size_t operator()(Key const& iKey) const { return std::hash<std::string>()(iKey.file_) ^ (iKey.block_*0x9E3779B97F4A7C15ULL); }
+    };
+    struct Slot {
+      Key key_;
+      std::size_t length_ = 0;
+      std::list<unsigned int>::iterator lru_;
+    };
+    struct Shard {
+      std::mutex mutex_;
+      int fd_ = -1;
+      std::vector<Slot> slots_;
+      //most recently used first
+      std::list<unsigned int> lru_;
+      std::unordered_map<Key, unsigned int, KeyHash> index_;
+      std::vector<unsigned int> freeSlots_;
+    };
+
+    Shard& shardFor(Key const&);
+    bool contains(Key const&);
+    //copies the part of the block in [iOffset, iOffset+iSize) to oBuffer. Returns
+    // nothing if the block is not in the cache, else the length of the block.
+    std::optional<std::size_t> copyFromCache(Key const&, uint64_t iOffset, std::size_t iSize, char* oBuffer);
+    void insert(Key const&, char const* iData, std::size_t iLength);
+
+    Config const config_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    std::atomic<unsigned long long> nHits_{0};
+    std::atomic<unsigned long long> nMisses_{0};
+    std::atomic<unsigned long long> nFetches_{0};
+    std::atomic<unsigned long long> nEvictions_{0};
+    std::atomic<unsigned long long> bytesFromCache_{0};
+    std::atomic<unsigned long long> bytesFetched_{0};
+  };
+
+  //parses e.g. 'dir=/nvme/cache:size_MB=4096:block_kB=1024:shards=16'. Prints the problem and returns nothing if not valid.
+  std::optional<BlockCache::Config> parseBlockCacheConfig(std::string_view iConfig);
+
+  //the cache used by all readers of remote files, nullptr unless one was set
+  BlockCache* blockCache();
+  void setBlockCache(std::unique_ptr<BlockCache>);
+}
+#endif
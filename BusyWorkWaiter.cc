@@ -0,0 +1,142 @@
+
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include "EventIdentifier.h"
+#include "DataProductRetriever.h"
+#include "TaskHolder.h"
+#include "WaiterBase.h"
+#include "WaiterFactory.h"
+
+
+namespace cce::tf {
+  /**
+     Keeps the core busy for the time the sleep based waiters would sleep.
+     The number of iterations of the work loop done per microsecond is measured
+     when the waiter is created. If a working set is given, each iteration also
+     reads a cache line of the Lane's own buffer so the work competes for the
+     caches and memory bandwidth.
+   */
+  class BusyWorkWaiter : public WaiterBase {
+ public:
+
+    BusyWorkWaiter(double iScaleFactor, std::vector<double> iEventTimes, std::size_t iNDataProducts,
+                   unsigned int iNLanes, std::size_t iWorkingSetBytes):
+      scale_{iScaleFactor},
+      eventTimes_(std::move(iEventTimes)),
+      nDataProducts_{iNDataProducts},
+      workingSets_(iNLanes, std::vector<unsigned char>(iWorkingSetBytes, 1)) {
+      calibrate();
+    }
+
+    void waitAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, long iEventIndex,
+                   std::vector<DataProductRetriever> const& iRetrievers, unsigned int index,
+                   TaskHolder iCallback) const final {
+      double time;
+      if(eventTimes_.empty()) {
+        time = scale_*iRetrievers[index].size();
+      } else {
+        time = eventTimes_[iEventIndex % eventTimes_.size()]/nDataProducts_;
+      }
+      if(time <= 0.) {
+        return;
+      }
+      iCallback.group()->run([iCallback, iLaneIndex, time, this]() {
+          auto const& workingSet = workingSets_[iLaneIndex];
+          sink_ += work(time*iterationsPerMicrosecond_, workingSet.data(), workingSet.size());
+        });
+    }
+
+    double iterationsPerMicrosecond() const { return iterationsPerMicrosecond_; }
+
+    void fillReport(RunReport& oReport) const final {
+      oReport.set("iterationsPerMicrosecond", iterationsPerMicrosecond_);
+    }
+
+ private:
+    static std::uint64_t work(std::uint64_t iIterations, unsigned char const* iData, std::size_t iSize) {
+      constexpr std::size_t kCacheLine = 64;
+      std::uint64_t value = 0x9E3779B97F4A7C15ULL;
+      std::size_t pos = 0;
+      for(std::uint64_t i = 0; i < iIterations; ++i) {
+        value = value*6364136223846793005ULL + 1442695040888963407ULL;
+        if(iSize != 0) {
+          value += iData[pos];
+          pos += kCacheLine;
+          if(pos >= iSize) {
+            pos = 0;
+          }
+        }
+      }
+      return value;
+    }
+
+    void calibrate() {
+      using namespace std::chrono;
+      auto const& workingSet = workingSets_[0];
+      //warm up the caches the same way a Lane would
+      sink_ += work(1000, workingSet.data(), workingSet.size());
+      std::uint64_t iterations = 1 << 16;
+      while(true) {
+        auto start = steady_clock::now();
+        sink_ += work(iterations, workingSet.data(), workingSet.size());
+        auto elapsed = duration_cast<microseconds>(steady_clock::now() - start).count();
+        if(elapsed > 20000) {
+          iterationsPerMicrosecond_ = double(iterations)/elapsed;
+          return;
+        }
+        iterations *= 2;
+      }
+    }
+
+    double scale_;
+    std::vector<double> eventTimes_;
+    std::size_t nDataProducts_;
+    std::vector<std::vector<unsigned char>> workingSets_;
+    double iterationsPerMicrosecond_ = 0.;
+    //keeps the compiler from removing the work
+    mutable std::atomic<std::uint64_t> sink_{0};
+};
+}
+
+namespace {
+
+  using namespace cce::tf;
+  class Maker : public WaiterMakerBase {
+  public:
+    Maker(): WaiterMakerBase("BusyWorkWaiter") {}
+
+    std::unique_ptr<WaiterBase> create(unsigned int iNLanes, std::size_t iNDataProducts, ConfigurationParameters const& params) const final {
+      auto scale = params.get<float>("scale", 0);
+
+      std::vector<double> eventTimes;
+      auto filename = params.get<std::string>("filename");
+      if(filename) {
+        std::ifstream file(*filename);
+        if(not file.is_open()) {
+          std::cout <<"unable to open file "<<*filename<<" with event times";
+          return {};
+        }
+        double value;
+        while(file >> value) {
+          eventTimes.push_back(value);
+        }
+        if(eventTimes.empty()) {
+          std::cout <<"file "<<*filename<<" contained no event times"<<std::endl;
+          return {};
+        }
+      }
+
+      auto workingSetBytes = params.get<std::size_t>("workingSetBytes", 0);
+      auto waiter = std::make_unique<BusyWorkWaiter>(scale, std::move(eventTimes), iNDataProducts, iNLanes, workingSetBytes);
+      std::cout <<"BusyWorkWaiter calibrated to "<<waiter->iterationsPerMicrosecond()<<" iterations per us"<<std::endl;
+      return waiter;
+    }
+
+  };
+
+  Maker s_maker;
+}
@@ -0,0 +1,197 @@
+#include "CPUAffinity.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+#include <tuple>
+
+#include "RunReport.h"
+
+namespace cce::tf {
+  namespace {
+    int readTopologyValue(int iCPU, char const* iName) {
+      std::ifstream file("/sys/devices/system/cpu/cpu"+std::to_string(iCPU)+"/topology/"+iName);
+      int value = -1;
+      if(not (file >> value)) {
+        return -1;
+      }
+      return value;
+    }
+
+    std::mutex s_dedicatedMutex;
+    std::vector<int> s_dedicatedCPUs;
+    std::atomic<unsigned int> s_nDedicatedPinned{0};
+    std::atomic<unsigned int> s_nDedicatedFailed{0};
+  }
+
+  std::vector<CPUTopology> allowedCPUs() {
+    std::vector<CPUTopology> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(0 != sched_getaffinity(0, sizeof(set), &set)) {
+      return cpus;
+    }
+    for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if(CPU_ISSET(cpu, &set)) {
+        //without the topology each CPU is taken to be its own core
+        int package = readTopologyValue(cpu, "physical_package_id");
+        int core = readTopologyValue(cpu, "core_id");
+        cpus.push_back({cpu, package < 0 ? 0 : package, core < 0 ? cpu : core});
+      }
+    }
+    return cpus;
+  }
+
+  std::optional<std::vector<int>> parseCPUList(std::string_view iList) {
+    std::vector<int> cpus;
+    if(iList.empty()) {
+      return {};
+    }
+    while(not iList.empty()) {
+      auto comma = iList.find(',');
+      auto range = iList.substr(0, comma);
+      iList = comma == std::string_view::npos ? std::string_view() : iList.substr(comma+1);
+      auto dash = range.find('-');
+      try {
+        std::size_t used = 0;
+        std::string first(range.substr(0, dash));
+        int begin = std::stoi(first, &used);
+        if(used != first.size() or begin < 0) {
+          return {};
+        }
+        int end = begin;
+        if(dash != std::string_view::npos) {
+          std::string last(range.substr(dash+1));
+          end = std::stoi(last, &used);
+          if(used != last.size() or end < begin) {
+            return {};
+          }
+        }
+        if(end >= CPU_SETSIZE) {
+          return {};
+        }
+        for(int cpu = begin; cpu <= end; ++cpu) {
+          cpus.push_back(cpu);
+        }
+      } catch(std::logic_error const&) {
+        return {};
+      }
+    }
+    return cpus;
+  }
+
+  std::optional<AffinityConfig> parseAffinityConfig(std::string_view iConfig) {
+    if(iConfig == "compact") {
+      return AffinityConfig{AffinityPolicy::kCompact, {}};
+    }
+    if(iConfig == "scatter") {
+      return AffinityConfig{AffinityPolicy::kScatter, {}};
+    }
+    auto cpus = parseCPUList(iConfig);
+    if(not cpus) {
+      std::cout <<"thread affinity '"<<iConfig<<"' is not compact, scatter or a list of CPUs, e.g. 0-3,8"<<std::endl;
+      return {};
+    }
+    return AffinityConfig{AffinityPolicy::kList, std::move(*cpus)};
+  }
+
+  std::string name(AffinityPolicy iPolicy) {
+    switch(iPolicy) {
+    case AffinityPolicy::kCompact: return "compact";
+    case AffinityPolicy::kScatter: return "scatter";
+    case AffinityPolicy::kList: return "list";
+    }
+    return "unknown";
+  }
+
+  std::vector<int> orderCPUs(std::vector<CPUTopology> const& iCPUs, AffinityConfig const& iConfig) {
+    std::vector<int> order;
+    if(iConfig.policy_ == AffinityPolicy::kList) {
+      //only those the process may use
+      for(auto cpu: iConfig.cpus_) {
+        if(iCPUs.end() != std::find_if(iCPUs.begin(), iCPUs.end(), [cpu](auto const& c) { return c.cpu_ == cpu; })) {
+          order.push_back(cpu);
+        }
+      }
+      return order;
+    }
+    //number the SMT siblings of each core and the cores of each package
+    std::map<std::pair<int,int>, int> siblingsOfCore;
+    std::map<int, std::map<int,int>> coresOfPackage;
+    struct Keyed {
+      CPUTopology topology_;
+      int sibling_;
+      int coreIndex_;
+    };
+    std::vector<CPUTopology> sorted = iCPUs;
+    std::sort(sorted.begin(), sorted.end(), [](auto const& a, auto const& b) {
+        return std::tie(a.package_, a.core_, a.cpu_) < std::tie(b.package_, b.core_, b.cpu_); });
+    std::vector<Keyed> keyed;
+    keyed.reserve(sorted.size());
+    for(auto const& c: sorted) {
+      int sibling = siblingsOfCore[{c.package_, c.core_}]++;
+      auto& cores = coresOfPackage[c.package_];
+      auto itCore = cores.emplace(c.core_, static_cast<int>(cores.size())).first;
+      keyed.push_back({c, sibling, itCore->second});
+    }
+    if(iConfig.policy_ == AffinityPolicy::kScatter) {
+      std::stable_sort(keyed.begin(), keyed.end(), [](auto const& a, auto const& b) {
+          return std::tie(a.sibling_, a.coreIndex_, a.topology_.package_) < std::tie(b.sibling_, b.coreIndex_, b.topology_.package_); });
+    }
+    order.reserve(keyed.size());
+    for(auto const& k: keyed) {
+      order.push_back(k.topology_.cpu_);
+    }
+    return order;
+  }
+
+  bool pinThisThread(std::vector<int> const& iCPUs) {
+    if(iCPUs.empty()) {
+      return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(auto cpu: iCPUs) {
+      CPU_SET(cpu, &set);
+    }
+    return 0 == pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+
+  void setDedicatedThreadCPUs(std::vector<int> iCPUs) {
+    std::lock_guard<std::mutex> guard(s_dedicatedMutex);
+    s_dedicatedCPUs = std::move(iCPUs);
+  }
+
+  void pinDedicatedThread() {
+    std::vector<int> cpus;
+    {
+      std::lock_guard<std::mutex> guard(s_dedicatedMutex);
+      if(s_dedicatedCPUs.empty()) {
+        return;
+      }
+      cpus = s_dedicatedCPUs;
+    }
+    if(pinThisThread(cpus)) {
+      ++s_nDedicatedPinned;
+    } else {
+      ++s_nDedicatedFailed;
+    }
+  }
+
+  void fillDedicatedThreadReport(RunReport& oReport) {
+    std::vector<double> cpus;
+    {
+      std::lock_guard<std::mutex> guard(s_dedicatedMutex);
+      cpus.assign(s_dedicatedCPUs.begin(), s_dedicatedCPUs.end());
+    }
+    oReport.set("cpus", cpus);
+    oReport.set("pinnedThreads", s_nDedicatedPinned.load());
+    oReport.set("failedThreads", s_nDedicatedFailed.load());
+  }
+}
@@ -0,0 +1,59 @@
+#if !defined(CPUAffinity_h)
+#define CPUAffinity_h
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cce::tf {
+  class RunReport;
+
+  //where a logical CPU sits in the machine, as given in /sys/devices/system/cpu
+  struct CPUTopology {
+    int cpu_;
+    int package_;
+    int core_;
+  };
+
+  //the CPUs the process is allowed to run on
+  std::vector<CPUTopology> allowedCPUs();
+
+  enum class AffinityPolicy {
+    //fill a core, including its SMT siblings, before going to the next core
+    kCompact,
+    //one CPU of each core, alternating between the packages, before using SMT siblings
+    kScatter,
+    //the CPUs given in the list, in its order
+    kList
+  };
+
+  struct AffinityConfig {
+    AffinityPolicy policy_;
+    //the CPUs of a kList policy
+    std::vector<int> cpus_;
+  };
+
+  //'compact', 'scatter' or a CPU list, e.g. '0-3,8,10'. Prints the problem and returns nothing if not valid.
+  std::optional<AffinityConfig> parseAffinityConfig(std::string_view iConfig);
+  std::string name(AffinityPolicy);
+
+  //parses the Linux CPU list format, e.g. '0-3,8,10'. Returns nothing if not valid.
+  std::optional<std::vector<int>> parseCPUList(std::string_view iList);
+
+  //the order in which threads are given CPUs
+  std::vector<int> orderCPUs(std::vector<CPUTopology> const& iCPUs, AffinityConfig const& iConfig);
+
+  //binds the calling thread to the CPUs, returns false if that failed
+  bool pinThisThread(std::vector<int> const& iCPUs);
+
+  /**
+     The CPUs for the threads doing dedicated work outside of TBB, e.g. those
+     of ReadAheadBuffer, WriteBehindBuffer and WaiterTimer. Those threads call
+     pinDedicatedThread when they start. If no CPUs were set they float freely.
+   */
+  void setDedicatedThreadCPUs(std::vector<int> iCPUs);
+  void pinDedicatedThread();
+  void fillDedicatedThreadReport(RunReport&);
+}
+#endif
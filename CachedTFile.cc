@@ -0,0 +1,64 @@
+#include "CachedTFile.h"
+
+#include <unistd.h>
+
+#include "TPluginManager.h"
+#include "TROOT.h"
+
+#include "BlockCache.h"
+#include "StorageEmulator.h"
+
+namespace {
+  std::string localName(const char* iName) {
+    std::string name(iName);
+    std::string const prefix = "cache:";
+    if(name.compare(0, prefix.size(), prefix) == 0) {
+      name.erase(0, prefix.size());
+      //cache:///path keeps the leading / of the path
+      if(name.compare(0, 2, "//") == 0) {
+        name.erase(0, 2);
+      }
+    }
+    return name;
+  }
+}
+
+namespace cce::tf {
+  CachedTFile::CachedTFile(const char* iName, Option_t* iOption, const char* iTitle, Int_t iCompress):
+    TFile(localName(iName).c_str(), iOption, iTitle, iCompress),
+    localName_{localName(iName)} {}
+
+  Int_t CachedTFile::SysRead(Int_t iFileDescriptor, void* oBuffer, Int_t iLength) {
+    auto cache = blockCache();
+    if(not cache or IsWritable()) {
+      emulateStorageRequest(iLength);
+      return TFile::SysRead(iFileDescriptor, oBuffer, iLength);
+    }
+    auto const offset = TFile::SysSeek(iFileDescriptor, 0, SEEK_CUR);
+    if(offset < 0) {
+      return -1;
+    }
+    auto const nRead = cache->read(localName_, offset, iLength, static_cast<char*>(oBuffer),
+                                   [iFileDescriptor](uint64_t iStart, std::size_t iSize, char* oData) {
+        emulateStorageRequest(iSize);
+        std::size_t nFetched = 0;
+        while(nFetched != iSize) {
+          auto n = ::pread(iFileDescriptor, oData+nFetched, iSize-nFetched, iStart+nFetched);
+          if(n <= 0) {
+            //the end of the file
+            break;
+          }
+          nFetched += n;
+        }
+        return nFetched;
+      });
+    //continue after the bytes read as a read of the file would
+    TFile::SysSeek(iFileDescriptor, offset+nRead, SEEK_SET);
+    return nRead;
+  }
+
+  void registerCachedTFile() {
+    gROOT->GetPluginManager()->AddHandler("TFile", "^cache:", "cce::tf::CachedTFile", "storage_emulation_dictDict",
+                                          "CachedTFile(const char*,Option_t*,const char*,Int_t)");
+  }
+}
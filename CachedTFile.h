@@ -0,0 +1,32 @@
+#if !defined(CachedTFile_h)
+#define CachedTFile_h
+
+#include <string>
+
+#include "TFile.h"
+
+namespace cce::tf {
+  /**
+     A file on remote storage, e.g. a network file system, whose reads go
+     through the BlockCache when one is set. Once registerCachedTFile was
+     called, TFile::Open makes one for names starting with 'cache:', e.g.
+     cache:///eos/data/file.root or cache:file.root. Each read which is not
+     served by the cache is one request to the StorageEmulator, if set, so a
+     local file can stand in for a remote one. Files opened for writing and
+     the reads done while the file is opened bypass the cache.
+   */
+  class CachedTFile : public TFile {
+  public:
+    CachedTFile(const char* iName, Option_t* iOption = "", const char* iTitle = "", Int_t iCompress = ROOT::RCompressionSetting::EDefaults::kUseCompiledDefault);
+
+  protected:
+    Int_t SysRead(Int_t iFileDescriptor, void* oBuffer, Int_t iLength) override;
+
+  private:
+    std::string localName_;
+  };
+
+  //adds the TFile plugin handler for the 'cache:' prefix
+  void registerCachedTFile();
+}
+#endif
@@ -0,0 +1,44 @@
+#if !defined(ClusterIndexClaimer_h)
+#define ClusterIndexClaimer_h
+
+#include <atomic>
+#include <algorithm>
+#include <utility>
+
+#include "EventIndexClaimer.h"
+#include "SharedSourceBase.h"
+
+namespace cce::tf {
+  /**
+     Hands a Lane consecutive events of one cluster of the Source, up to the
+     cluster's end, so the Lane reuses the baskets it had to read and
+     decompress instead of each cluster being spread over all the Lanes.
+   */
+  class ClusterIndexClaimer : public EventIndexClaimer {
+  public:
+    //iMaxClaim is the most events handed out at one time, the Lane's chunk if larger
+    ClusterIndexClaimer(SharedSourceBase const& iSource, std::atomic<long>& iIndex, long iMaxClaim):
+      source_{iSource}, index_{iIndex}, maxClaim_{iMaxClaim} {}
+
+    long claim(long iN) final { return index_.fetch_add(iN); }
+
+    std::pair<long, long> claimRange(long iN) final {
+      auto first = index_.load();
+      long end;
+      do {
+        end = std::max(first+1, std::min(source_.clusterEnd(first), first+std::max(iN, maxClaim_)));
+      } while(not index_.compare_exchange_weak(first, end));
+      nClaims_.fetch_add(1, std::memory_order_relaxed);
+      return {first, end};
+    }
+
+    unsigned long long nClaims() const { return nClaims_.load(); }
+
+  private:
+    SharedSourceBase const& source_;
+    std::atomic<long>& index_;
+    long const maxClaim_;
+    std::atomic<unsigned long long> nClaims_{0};
+  };
+}
+#endif
@@ -0,0 +1,64 @@
+#include "ClusterRootSource.h"
+#include "SourceFactory.h"
+
+using namespace cce::tf;
+
+ClusterRootSource::ClusterRootSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iName,
+                                     ProductSelector const& iSelector):
+  SharedSourceBase(iNEvents),
+  nextCluster_{0}
+{
+  laneInfos_.reserve(iNLanes);
+  for(unsigned int i = 0; i< iNLanes; ++i) {
+    laneInfos_.emplace_back(iName, iSelector);
+  }
+  clusters_ = laneInfos_[0].source_.clusters();
+}
+
+void ClusterRootSource::readEventAsync(unsigned int iLane, long iEventIndex, OptionalTaskHolder iTask) {
+  auto& laneInfo = laneInfos_[iLane];
+  if(laneInfo.nextEntry_ == laneInfo.endEntry_) {
+    auto cluster = nextCluster_++;
+    if(cluster >= clusters_.size()) {
+      return;
+    }
+    std::tie(laneInfo.nextEntry_, laneInfo.endEntry_) = clusters_[cluster];
+    laneInfo.source_.setCacheEntryRange(laneInfo.nextEntry_, laneInfo.endEntry_);
+    ++laneInfo.nClusters_;
+  }
+  if(laneInfo.source_.gotoEvent(laneInfo.nextEntry_++)) {
+    iTask.runNow();
+  }
+}
+
+void ClusterRootSource::printSummary() const {
+  std::chrono::microseconds sourceTime = std::chrono::microseconds::zero();
+  for(auto const& l: laneInfos_) {
+    sourceTime += l.source_.accumulatedTime();
+  }
+  std::cout <<"\nSource time: "<<sourceTime.count()<<"us\n"
+    "   clusters: "<<clusters_.size()<<"\n"
+    "   clusters per lane:";
+  for(auto const& l: laneInfos_) {
+    std::cout <<" "<<l.nClusters_;
+  }
+  std::cout <<"\n"<<std::endl;
+}
+
+namespace {
+    class Maker : public SourceMakerBase {
+  public:
+    Maker(): SourceMakerBase("ClusterRootSource") {}
+      std::unique_ptr<SharedSourceBase> create(unsigned int iNLanes, unsigned long long iNEvents, ConfigurationParameters const& params) const final {
+        auto fileName = params.get<std::string>("fileName");
+        if(not fileName) {
+          std::cout <<"no file name given\n";
+          return {};
+        }
+        ProductSelector selector{params.get<std::string>("products", "")};
+        return std::make_unique<ClusterRootSource>(iNLanes, iNEvents, *fileName, selector);
+    }
+    };
+
+  Maker s_maker;
+}
@@ -0,0 +1,56 @@
+#if !defined(ClusterRootSource_h)
+#define ClusterRootSource_h
+
+#include <vector>
+#include <atomic>
+#include <utility>
+#include <chrono>
+#include <iostream>
+
+#include "SharedSourceBase.h"
+#include "RootSource.h"
+#include "ProductSelector.h"
+#include "PerLaneCounter.h"
+
+namespace cce::tf {
+  /**
+     Reads a standard ROOT file using one RootSource per Lane. Rather than
+     reading the events in the order given by the Lanes, each Lane claims a
+     whole cluster of the `Events` TTree and reads its entries one after the
+     other. The Lane's TTreeCache then only holds baskets of that cluster and
+     no synchronization is needed between Lanes other than claiming a cluster.
+     The events are therefore not processed in file order.
+   */
+  class ClusterRootSource : public SharedSourceBase {
+  public:
+    ClusterRootSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iName,
+                      ProductSelector const& iSelector = ProductSelector());
+    ClusterRootSource(ClusterRootSource&&) = delete;
+    ClusterRootSource(ClusterRootSource const&) = delete;
+
+    size_t numberOfDataProducts() const final {return laneInfos_[0].source_.numberOfDataProducts();}
+    std::vector<DataProductRetriever>& dataProducts(unsigned int iLane, long iEventIndex) final {
+      return laneInfos_[iLane].source_.dataProducts();
+    }
+    EventIdentifier eventIdentifier(unsigned int iLane, long iEventIndex) final {
+      return laneInfos_[iLane].source_.eventIdentifier();
+    }
+
+    void printSummary() const final;
+  private:
+    void readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder) final;
+
+    struct alignas(kCacheLineSize) LaneInfo {
+      LaneInfo(std::string const& iName, ProductSelector const& iSelector): source_(iName, iSelector) {}
+      RootSource source_;
+      //remaining entries of the claimed cluster
+      long nextEntry_ = 0;
+      long endEntry_ = 0;
+      unsigned int nClusters_ = 0;
+    };
+    std::vector<LaneInfo> laneInfos_;
+    std::vector<std::pair<long, long>> clusters_;
+    std::atomic<unsigned int> nextCluster_;
+  };
+}
+#endif
@@ -4,6 +4,8 @@
 #include <memory>
 #include <unordered_map>
 
+#include "pluginLoader.h"
+
 namespace cce::tf {
 
   template <class T>
@@ -36,7 +38,14 @@ namespace cce::tf {
     std::unique_ptr<R> create(const std::string& iName, Args... args) const {
       auto itFound =makers_.find(iName);
       if(itFound == makers_.end()) {
-        return std::unique_ptr<R>();
+        //components not linked into the executable may be in a plugin library
+        if(not loadPlugins()) {
+          return std::unique_ptr<R>();
+        }
+        itFound = makers_.find(iName);
+        if(itFound == makers_.end()) {
+          return std::unique_ptr<R>();
+        }
       }
       return itFound->second->create(std::forward<Args>(args)...);
     }
@@ -0,0 +1,124 @@
+#if !defined(CompressionLevelController_h)
+#define CompressionLevelController_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+#include "PerLaneCounter.h"
+
+namespace cce::tf {
+  /**
+     Picks the compression level of each Lane of an Outputer from what was
+     seen while running. Every iEventsPerUpdate events a Lane compares
+
+       - the backlog of the output queue, averaged over those events, with iTargetBacklog
+       - the bytes per second all Lanes could compress, assuming they run as fast as this one,
+         with the bytes per second the output queue writes.
+
+     If writing is falling behind the Lane moves to a higher level, spending
+     CPU to write fewer bytes. If the queue is waiting on the Lanes it moves to
+     a lower level. Otherwise the level is kept, so writes stay busy using as
+     little CPU as the levels allow.
+   */
+  class CompressionLevelController {
+  public:
+    CompressionLevelController(unsigned int iNLanes, int iMinLevel, int iMaxLevel, unsigned long long iTargetBacklog,
+                               unsigned int iEventsPerUpdate=16):
+      lanes_(iNLanes), minLevel_{iMinLevel}, maxLevel_{std::max(iMinLevel, iMaxLevel)},
+      targetBacklog_{iTargetBacklog}, eventsPerUpdate_{std::max(iEventsPerUpdate, 1U)} {
+      for(auto& lane: lanes_) {
+        lane.level_ = maxLevel_;
+      }
+    }
+
+    CompressionLevelController(CompressionLevelController const&) = delete;
+    CompressionLevelController& operator=(CompressionLevelController const&) = delete;
+
+    //only to be called from the Lane
+    int level(unsigned int iLane) const { return lanes_[iLane].level_; }
+
+    //called from the Lane once its event is compressed. iBacklog is the number
+    // of tasks waiting in the output queue.
+    void compressed(unsigned int iLane, std::size_t iCompressedBytes, std::chrono::microseconds iTime, unsigned long long iBacklog) {
+      auto& lane = lanes_[iLane];
+      lane.bytes_ += iCompressedBytes;
+      lane.time_ += iTime;
+      lane.backlog_ += iBacklog;
+      lane.levelSum_ += lane.level_;
+      ++lane.nEvents_;
+      ++lane.nTotalEvents_;
+      if(lane.nEvents_ < eventsPerUpdate_) {
+        return;
+      }
+      auto const writeTime = writeTime_.load();
+      if(writeTime != 0) {
+        //bytes per microsecond
+        double const written = double(writtenBytes_.load())/writeTime;
+        double const compressed = lanes_.size()*double(lane.bytes_)/std::max<std::chrono::microseconds::rep>(lane.time_.count(), 1);
+        double const backlog = double(lane.backlog_)/lane.nEvents_;
+        if(backlog > targetBacklog_ and compressed > written and lane.level_ < maxLevel_) {
+          ++lane.level_;
+          ++lane.nChanges_;
+        } else if(backlog < targetBacklog_ and compressed < written and lane.level_ > minLevel_) {
+          --lane.level_;
+          ++lane.nChanges_;
+        }
+      }
+      lane.bytes_ = 0;
+      lane.time_ = std::chrono::microseconds::zero();
+      lane.backlog_ = 0;
+      lane.nEvents_ = 0;
+    }
+
+    //called from the output queue for the bytes it wrote
+    void written(std::size_t iBytes, std::chrono::microseconds iTime) {
+      writtenBytes_ += iBytes;
+      writeTime_ += iTime.count();
+    }
+
+    int minLevel() const { return minLevel_; }
+    int maxLevel() const { return maxLevel_; }
+    //the following are only meaningful once all events were compressed
+    double meanLevel() const {
+      long long sum = 0;
+      unsigned long long n = 0;
+      for(auto const& lane: lanes_) {
+        sum += lane.levelSum_;
+        n += lane.nTotalEvents_;
+      }
+      return n == 0 ? maxLevel_ : double(sum)/n;
+    }
+    unsigned long long nChanges() const {
+      unsigned long long n = 0;
+      for(auto const& lane: lanes_) {
+        n += lane.nChanges_;
+      }
+      return n;
+    }
+
+  private:
+    struct alignas(kCacheLineSize) Lane {
+      int level_ = 0;
+      //since the last update
+      std::size_t bytes_ = 0;
+      std::chrono::microseconds time_ = std::chrono::microseconds::zero();
+      unsigned long long backlog_ = 0;
+      unsigned int nEvents_ = 0;
+      //for the summary
+      long long levelSum_ = 0;
+      unsigned long long nTotalEvents_ = 0;
+      unsigned long long nChanges_ = 0;
+    };
+    std::vector<Lane> lanes_;
+    int const minLevel_;
+    int const maxLevel_;
+    unsigned long long const targetBacklog_;
+    unsigned int const eventsPerUpdate_;
+    std::atomic<unsigned long long> writtenBytes_{0};
+    std::atomic<std::chrono::microseconds::rep> writeTime_{0};
+  };
+}
+#endif
@@ -23,6 +23,23 @@ namespace cce::tf {
 
     ConfigurationParameters() = delete;
 
+    //unusedKeys_ refers to the keys in keyValues_ so it has to be rebuilt
+    // from the copied map
+    ConfigurationParameters(ConfigurationParameters const& iOther):
+    keyValues_{iOther.keyValues_} {
+      copyUnusedKeys(iOther);
+    }
+    ConfigurationParameters& operator=(ConfigurationParameters const& iOther) {
+      if(this != &iOther) {
+        keyValues_ = iOther.keyValues_;
+        copyUnusedKeys(iOther);
+      }
+      return *this;
+    }
+    //the nodes of a moved std::map keep their addresses so the keys stay valid
+    ConfigurationParameters(ConfigurationParameters&&) = default;
+    ConfigurationParameters& operator=(ConfigurationParameters&&) = default;
+
     template<typename T> 
       std::optional<T> get(std::string_view iName) const {
 
@@ -48,9 +65,28 @@ namespace cce::tf {
       return unusedKeys_;
     }
 
+    //Used by a component which configures other components with the parameters
+    // it did not use itself. Those parameters are then treated as used here.
+    KeyValueMap takeUnusedKeyValues() const {
+      KeyValueMap unused;
+      for(auto const& key: unusedKeys_) {
+        unused.emplace(key, keyValues_.find(key)->second);
+      }
+      unusedKeys_.clear();
+      return unused;
+    }
+
   private:
     template<typename T> static T convert(std::string const& iValue);
 
+    void copyUnusedKeys(ConfigurationParameters const& iOther) {
+      unusedKeys_.clear();
+      unusedKeys_.reserve(iOther.unusedKeys_.size());
+      for(auto const& key: iOther.unusedKeys_) {
+        unusedKeys_.push_back(keyValues_.find(key)->first);
+      }
+    }
+
     void keyUsed(std::string_view iName) const {
       auto itUsed = std::lower_bound(unusedKeys_.begin(), unusedKeys_.end(), iName);
       if(itUsed != unusedKeys_.end() and *itUsed == iName) {
@@ -2,12 +2,35 @@
 #define DataProductRetriever_h
 
 #include <string>
+#include <optional>
+#include <mutex>
+#include <set>
 #include "DelayedProductRetriever.h"
 #include "TaskHolder.h"
+#include "BlobView.h"
+#include "pds_common.h"
 
 class TClass;
 
 namespace cce::tf {
+//What does not change from one event or Lane to the next. Only one is made for each
+// name and class so all Lanes share it.
+struct DataProductDescriptor {
+  std::string name_;
+  TClass* class_;
+
+  bool operator<(DataProductDescriptor const& iOther) const {
+    return name_ < iOther.name_ or (name_ == iOther.name_ and class_ < iOther.class_);
+  }
+
+  static DataProductDescriptor const* get(std::string iName, TClass* iClass) {
+    static std::mutex s_mutex;
+    static std::set<DataProductDescriptor> s_descriptors;
+    std::lock_guard<std::mutex> guard(s_mutex);
+    return &*s_descriptors.insert(DataProductDescriptor{std::move(iName), iClass}).first;
+  }
+};
+
 class DataProductRetriever {
  public:
  DataProductRetriever(int iIndex, 
@@ -16,19 +39,31 @@ class DataProductRetriever {
                        TClass* iClass,
 		       DelayedProductRetriever* iDelayed):
   address_(iAddress),
-    name_(std::move(iName)),
-    class_(iClass),
     delayedReader_(iDelayed),
+    descriptor_(DataProductDescriptor::get(std::move(iName), iClass)),
     index_(iIndex){}
 
   void** address() const {return address_; }
   size_t size() const { return size_; }
-  std::string const& name() const { return name_;}
-  TClass* classType() const { return class_;}
+  std::string const& name() const { return descriptor_->name_;}
+  TClass* classType() const { return descriptor_->class_;}
+  DataProductDescriptor const& descriptor() const { return *descriptor_; }
 
   void setAddress(void** iAddress) { address_ = iAddress; }
   void setSize(size_t iSize) { size_ = iSize;}
 
+  //Set by a Source which passes data products through without deserializing them.
+  // The bytes stay valid until the Lane's next event and the object at address()
+  // is then not filled.
+  void setSerialized(BlobView iBlob, pds::Serialization iSerialization) {
+    serialized_ = iBlob;
+    serialization_ = iSerialization;
+    size_ = iBlob.size();
+  }
+  BlobView serialized() const { return serialized_; }
+  //not set if the object at address() holds the data product
+  std::optional<pds::Serialization> serialization() const { return serialization_; }
+
   void getAsync(TaskHolder iCallback) {
     delayedReader_->getAsync(*this, index_, std::move(iCallback));
   }
@@ -36,12 +71,14 @@ class DataProductRetriever {
   int index() const { return index_;}
 
  private:
+  //the members used for every event come first and the whole object fits in a cache line
   void** address_;
   size_t size_ = 0;
-  std::string name_;
-  TClass* class_;
   DelayedProductRetriever* delayedReader_;
+  BlobView serialized_;
+  DataProductDescriptor const* descriptor_;
   int index_;
+  std::optional<pds::Serialization> serialization_;
 };
 }
 #endif
@@ -15,8 +15,8 @@ class DeserializeProxyBase {
 
  virtual ~DeserializeProxyBase();
 
-  virtual int deserialize(std::vector<char> const& iBuffer, void* iWriteTo) const = 0;
-  virtual int deserialize(char const * iBuffer, size_t iBufferSize, void* iWriteTo) const = 0;
+  virtual int deserialize(std::vector<char> const& iBuffer, void* iWriteTo) = 0;
+  virtual int deserialize(char const * iBuffer, size_t iBufferSize, void* iWriteTo) = 0;
 };
 
 
@@ -26,16 +26,17 @@ class DeserializeProxy final : public DeserializeProxyBase {
  DeserializeProxy(TClass* tClass):
   deserializer_{tClass} {}
 
-  int deserialize(std::vector<char> const& iBuffer, void* iWriteTo) const {
+  int deserialize(std::vector<char> const& iBuffer, void* iWriteTo) final {
     return deserializer_.deserialize(iBuffer, iWriteTo);
   }
-  int deserialize(char const * iBuffer, size_t iBufferSize, void* iWriteTo) const {
+  int deserialize(char const * iBuffer, size_t iBufferSize, void* iWriteTo) final {
     return deserializer_.deserialize(iBuffer, iBufferSize, iWriteTo);
   }
  private:
   D deserializer_;
 };
 
+//each lane needs its own DeserializeStrategy since the deserializers reuse their buffers
 using DeserializeStrategy = ProxyVector<DeserializeProxyBase, TClass*>;
 
 }
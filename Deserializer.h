@@ -6,24 +6,29 @@
 #include "TClass.h"
 
 namespace cce::tf {
+//holds a TBufferFile which is reused for each call so an instance must only be used by one lane
 class Deserializer {
 public:
-  explicit Deserializer(TClass* iClass) : class_{iClass} {}
+  explicit Deserializer(TClass* iClass) : class_{iClass}, bufferFile_{TBuffer::kRead} {}
 
-  int deserialize(std::vector<char> const& iBuffer, void* iWriteTo) const {
+  Deserializer(Deserializer&& iOther) : class_{iOther.class_}, bufferFile_{TBuffer::kRead} {}
+  Deserializer(Deserializer const& iOther) : class_{iOther.class_}, bufferFile_{TBuffer::kRead} {}
+
+  int deserialize(std::vector<char> const& iBuffer, void* iWriteTo) {
     return deserialize(&iBuffer.front(), iBuffer.size(), iWriteTo);
   }
-  int deserialize(char const * iBuffer, size_t iBufferSize, void* iWriteTo) const{
-    TBufferFile bufferFile{TBuffer::kRead};
-
-    bufferFile.SetBuffer( const_cast<char*>(iBuffer), iBufferSize, kFALSE);
+  int deserialize(char const * iBuffer, size_t iBufferSize, void* iWriteTo) {
+    bufferFile_.SetBuffer( const_cast<char*>(iBuffer), iBufferSize, kFALSE);
+    //object references from the previous call must not be found
+    bufferFile_.ResetMap();
 
-    class_->ReadBuffer(bufferFile, iWriteTo);
-    return bufferFile.Length();
+    class_->ReadBuffer(bufferFile_, iWriteTo);
+    return bufferFile_.Length();
   }
 
 private:
   TClass* class_;
+  TBufferFile bufferFile_;
 };
 }
 #endif
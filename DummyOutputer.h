@@ -13,8 +13,9 @@ class DummyOutputer : public OutputerBase {
   void setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const&) final {}
   void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const&, TaskHolder iCallback) const final {}
 
-  void outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final {}
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final {}
   bool usesProductReadyAsync() const final {return use_;}
+  std::optional<ProductNeeds> neededProducts() const final { return std::nullopt; }
 
   void printSummary() const final {}
  private:
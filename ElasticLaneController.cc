@@ -0,0 +1,143 @@
+#include "ElasticLaneController.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "RunReport.h"
+#include "configKeyValuePairs.h"
+
+namespace cce::tf {
+  ElasticLaneController::ElasticLaneController(Config const& iConfig):
+    config_{iConfig},
+    active_{std::min(iConfig.minLanes_, iConfig.maxLanes_)},
+    bestLanes_{active_} {}
+
+  unsigned int ElasticLaneController::update(std::chrono::milliseconds iTime, double iRate, unsigned long long iResidentBytes) {
+    if(iRate > bestRate_) {
+      bestRate_ = iRate;
+      bestLanes_ = active_;
+    }
+    auto const previous = lastRate_;
+    lastRate_ = iRate;
+
+    if(config_.maxResidentBytes_ != 0 and iResidentBytes > config_.maxResidentBytes_) {
+      ++nMemoryLimited_;
+      direction_ = 0;
+      sinceProbe_ = 0;
+      return change(iTime, iRate, -1);
+    }
+    if(not previous) {
+      //the first interval only gives the rate to compare to
+      return change(iTime, iRate, direction_);
+    }
+    double const gain = *previous > 0 ? (iRate - *previous)/ *previous : (iRate > 0 ? 1. : 0.);
+    if(direction_ == 0) {
+      if(config_.probeIntervals_ == 0 or ++sinceProbe_ < config_.probeIntervals_) {
+        return active_;
+      }
+      //alternate between trying more and fewer Lanes
+      sinceProbe_ = 0;
+      direction_ = nextProbe_;
+      nextProbe_ = -nextProbe_;
+      return change(iTime, iRate, direction_);
+    }
+    if(direction_ > 0) {
+      if(gain > config_.minGain_) {
+        return change(iTime, iRate, 1);
+      }
+      direction_ = 0;
+      return change(iTime, iRate, -1);
+    }
+    //fewer Lanes are kept as long as the rate does not drop
+    if(gain > -config_.minGain_) {
+      return change(iTime, iRate, -1);
+    }
+    direction_ = 0;
+    return change(iTime, iRate, 1);
+  }
+
+  unsigned int ElasticLaneController::change(std::chrono::milliseconds iTime, double iRate, int iSteps) {
+    long target = static_cast<long>(active_) + iSteps*static_cast<long>(config_.step_);
+    target = std::clamp(target, static_cast<long>(std::min(config_.minLanes_, config_.maxLanes_)), static_cast<long>(config_.maxLanes_));
+    if(static_cast<unsigned int>(target) == active_) {
+      //reached a bound
+      direction_ = 0;
+      return active_;
+    }
+    changes_.push_back({iTime, active_, static_cast<unsigned int>(target), iRate});
+    active_ = target;
+    return active_;
+  }
+
+  void ElasticLaneController::printSummary() const {
+    std::cout <<"Elastic lanes: active "<<active_<<" highest rate with "<<bestLanes_<<" range ["<<std::min(config_.minLanes_, config_.maxLanes_)
+              <<", "<<config_.maxLanes_<<"]\n"
+              <<"  changes: "<<changes_.size()<<" removed for memory: "<<nMemoryLimited_<<"\n";
+  }
+
+  void ElasticLaneController::fillReport(RunReport& oReport) const {
+    oReport.set("minLanes", std::min(config_.minLanes_, config_.maxLanes_));
+    oReport.set("maxLanes", config_.maxLanes_);
+    oReport.set("finalLanes", active_);
+    oReport.set("bestLanes", bestLanes_);
+    oReport.set("memoryLimited", nMemoryLimited_);
+    std::vector<double> times;
+    std::vector<double> lanes;
+    std::vector<double> rates;
+    for(auto const& c: changes_) {
+      times.push_back(c.time_.count());
+      lanes.push_back(c.to_);
+      rates.push_back(c.rate_);
+    }
+    oReport.set("changeTimes_ms", times);
+    oReport.set("changeLanes", lanes);
+    oReport.set("changeRates", rates);
+  }
+
+  std::optional<ElasticLaneController::Config> parseElasticLaneConfig(std::string_view iConfig, unsigned int iMaxLanes) {
+    ElasticLaneController::Config config;
+    config.maxLanes_ = iMaxLanes;
+    for(auto const& [key, value]: configKeyValuePairs(iConfig)) {
+      try {
+        std::size_t used = 0;
+        if(key == "min") {
+          config.minLanes_ = std::stoul(value, &used);
+          if(config.minLanes_ == 0) {
+            throw std::invalid_argument(value);
+          }
+        } else if(key == "step") {
+          config.step_ = std::stoul(value, &used);
+          if(config.step_ == 0) {
+            throw std::invalid_argument(value);
+          }
+        } else if(key == "interval_ms") {
+          config.interval_ = std::chrono::milliseconds(std::stoul(value, &used));
+          if(config.interval_.count() == 0) {
+            throw std::invalid_argument(value);
+          }
+        } else if(key == "gain") {
+          config.minGain_ = std::stod(value, &used);
+          if(config.minGain_ < 0) {
+            throw std::invalid_argument(value);
+          }
+        } else if(key == "maxRSS_MB") {
+          config.maxResidentBytes_ = std::stoull(value, &used)*1000000ULL;
+        } else if(key == "probe") {
+          config.probeIntervals_ = std::stoul(value, &used);
+        } else {
+          std::cout <<"Unknown elastic lanes parameter '"<<key<<"', allowed are min, step, interval_ms, gain, maxRSS_MB and probe"<<std::endl;
+          return {};
+        }
+        if(used != value.size()) {
+          throw std::invalid_argument(value);
+        }
+      } catch(std::logic_error const&) {
+        std::cout <<"elastic lanes parameter "<<key<<" has the invalid value '"<<value<<"'"<<std::endl;
+        return {};
+      }
+    }
+    return config;
+  }
+}
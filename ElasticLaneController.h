@@ -0,0 +1,82 @@
+#if !defined(ElasticLaneController_h)
+#define ElasticLaneController_h
+
+#include <chrono>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace cce::tf {
+  class RunReport;
+
+  /**
+     Chooses how many Lanes are active while the job runs. It is given the
+     event rate and memory use of each interval and climbs the rate: starting
+     from minLanes_ it adds step_ Lanes while doing so raises the rate by more
+     than minGain_. When more Lanes did not pay, e.g. because a serial queue
+     or the storage is the limit, it goes back one step and stays there. Every
+     probeIntervals_ intervals it tries, in turn, one step more or one step
+     less, keeping on in that direction while the rate does not get worse,
+     so it follows changes of the load. Using more than maxResidentBytes_
+     always removes a step.
+
+     The caller applies the returned number, e.g. with ActiveLaneLimit::setNTokens.
+   */
+  class ElasticLaneController {
+  public:
+    struct Config {
+      unsigned int minLanes_ = 2;
+      unsigned int maxLanes_ = 0;
+      unsigned int step_ = 1;
+      std::chrono::milliseconds interval_{1000};
+      //relative change of the rate which counts as better or worse
+      double minGain_ = 0.05;
+      //0 means no limit
+      unsigned long long maxResidentBytes_ = 0;
+      unsigned int probeIntervals_ = 10;
+    };
+
+    struct Change {
+      std::chrono::milliseconds time_;
+      unsigned int from_;
+      unsigned int to_;
+      //events per second in the interval before the change
+      double rate_;
+    };
+
+    explicit ElasticLaneController(Config const& iConfig);
+
+    unsigned int activeLanes() const { return active_; }
+    Config const& config() const { return config_; }
+
+    //called at the end of each interval, returns the number of Lanes to have active
+    unsigned int update(std::chrono::milliseconds iTime, double iRate, unsigned long long iResidentBytes);
+
+    std::vector<Change> const& changes() const { return changes_; }
+    unsigned long long nMemoryLimited() const { return nMemoryLimited_; }
+    //the number of Lanes with the highest rate seen
+    unsigned int bestLanes() const { return bestLanes_; }
+
+    void printSummary() const;
+    void fillReport(RunReport&) const;
+
+  private:
+    unsigned int change(std::chrono::milliseconds iTime, double iRate, int iSteps);
+
+    Config const config_;
+    unsigned int active_;
+    //+1 adding Lanes, -1 removing Lanes, 0 settled
+    int direction_ = 1;
+    int nextProbe_ = 1;
+    std::optional<double> lastRate_;
+    unsigned int sinceProbe_ = 0;
+    std::vector<Change> changes_;
+    unsigned long long nMemoryLimited_ = 0;
+    unsigned int bestLanes_;
+    double bestRate_ = 0;
+  };
+
+  //parses e.g. 'min=2:step=1:interval_ms=500:gain=0.05:maxRSS_MB=4000:probe=10'. Prints the problem and returns nothing if not valid.
+  std::optional<ElasticLaneController::Config> parseElasticLaneConfig(std::string_view iConfig, unsigned int iMaxLanes);
+}
+#endif
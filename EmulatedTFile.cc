@@ -0,0 +1,43 @@
+#include "EmulatedTFile.h"
+
+#include <string>
+
+#include "TPluginManager.h"
+#include "TROOT.h"
+
+#include "StorageEmulator.h"
+
+namespace {
+  std::string localName(const char* iName) {
+    std::string name(iName);
+    std::string const prefix = "emulate:";
+    if(name.compare(0, prefix.size(), prefix) == 0) {
+      name.erase(0, prefix.size());
+      //emulate:///path keeps the leading / of the path
+      if(name.compare(0, 2, "//") == 0) {
+        name.erase(0, 2);
+      }
+    }
+    return name;
+  }
+}
+
+namespace cce::tf {
+  EmulatedTFile::EmulatedTFile(const char* iName, Option_t* iOption, const char* iTitle, Int_t iCompress):
+    TFile(localName(iName).c_str(), iOption, iTitle, iCompress) {}
+
+  Int_t EmulatedTFile::SysRead(Int_t iFileDescriptor, void* oBuffer, Int_t iLength) {
+    emulateStorageRequest(iLength);
+    return TFile::SysRead(iFileDescriptor, oBuffer, iLength);
+  }
+
+  Int_t EmulatedTFile::SysWrite(Int_t iFileDescriptor, const void* iBuffer, Int_t iLength) {
+    emulateStorageRequest(iLength);
+    return TFile::SysWrite(iFileDescriptor, iBuffer, iLength);
+  }
+
+  void registerEmulatedTFile() {
+    gROOT->GetPluginManager()->AddHandler("TFile", "^emulate:", "cce::tf::EmulatedTFile", "storage_emulation_dictDict",
+                                          "EmulatedTFile(const char*,Option_t*,const char*,Int_t)");
+  }
+}
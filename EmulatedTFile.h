@@ -0,0 +1,26 @@
+#if !defined(EmulatedTFile_h)
+#define EmulatedTFile_h
+
+#include "TFile.h"
+
+namespace cce::tf {
+  /**
+     A local file whose reads and writes each go through the StorageEmulator
+     as one request. Once registerEmulatedTFile was called, TFile::Open makes
+     one for names starting with 'emulate:', e.g. emulate:///data/file.root
+     or emulate:file.root. The reads done while the file is opened are not
+     delayed.
+   */
+  class EmulatedTFile : public TFile {
+  public:
+    EmulatedTFile(const char* iName, Option_t* iOption = "", const char* iTitle = "", Int_t iCompress = ROOT::RCompressionSetting::EDefaults::kUseCompiledDefault);
+
+  protected:
+    Int_t SysRead(Int_t iFileDescriptor, void* oBuffer, Int_t iLength) override;
+    Int_t SysWrite(Int_t iFileDescriptor, const void* iBuffer, Int_t iLength) override;
+  };
+
+  //adds the TFile plugin handler for the 'emulate:' prefix
+  void registerEmulatedTFile();
+}
+#endif
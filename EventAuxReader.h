@@ -12,6 +12,10 @@
 
 namespace cce::tf {
 
+  //Only the EventID is used. The ProcessHistoryID is never compacted or
+  // converted to a string, and since the branch reads every entry into
+  // the same EventAuxiliary, ROOT reuses the storage of its hash string so
+  // reading the auxiliary does not allocate once the first event is read.
   inline EventIdentifier cmsEventID(void** address) {
     assert(address);
     auto aux = *reinterpret_cast<edm::EventAuxiliary**>(address);
@@ -0,0 +1,26 @@
+#if !defined(EventIndexClaimer_h)
+#define EventIndexClaimer_h
+
+#include <utility>
+
+namespace cce::tf {
+  /**
+     Hands out event indices to the Lanes in place of the job's shared counter,
+     e.g. to share the indices with other processes.
+   */
+  class EventIndexClaimer {
+  public:
+    virtual ~EventIndexClaimer() = default;
+
+    //returns the first of iN consecutive event indices no one else was given
+    virtual long claim(long iN) = 0;
+
+    //returns the first and one past the last of the consecutive event indices
+    // claimed when asking for iN. Claimers may give fewer or more than iN.
+    virtual std::pair<long, long> claimRange(long iN) {
+      auto const first = claim(iN);
+      return {first, first+iN};
+    }
+  };
+}
+#endif
@@ -0,0 +1,99 @@
+#include "EventList.h"
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+namespace cce::tf {
+  namespace {
+    bool lessThan(EventIdentifier const& iLHS, EventIdentifier const& iRHS) {
+      return std::tie(iLHS.run, iLHS.lumi, iLHS.event) < std::tie(iRHS.run, iRHS.lumi, iRHS.event);
+    }
+
+    //the parts of the identifier which are not given are the lowest values, or with iLast the highest
+    EventIdentifier parseIdentifier(std::string const& iText, std::string const& iItem, bool iLast) {
+      EventIdentifier id{0, 0, 0};
+      if(iLast) {
+        id = {std::numeric_limits<unsigned int>::max(), std::numeric_limits<unsigned int>::max(),
+              std::numeric_limits<unsigned long long>::max()};
+      }
+      std::istringstream stream(iText);
+      std::string part;
+      unsigned int nParts = 0;
+      while(std::getline(stream, part, '.')) {
+        if(part.empty() or part.find_first_not_of("0123456789") != std::string::npos or nParts == 3) {
+          throw std::runtime_error("event selection item '"+iItem+"' is not run, run.lumi or run.lumi.event");
+        }
+        switch(nParts++) {
+        case 0: { id.run = std::stoul(part); break; }
+        case 1: { id.lumi = std::stoul(part); break; }
+        case 2: { id.event = std::stoull(part); break; }
+        }
+      }
+      if(nParts == 0) {
+        throw std::runtime_error("event selection item '"+iItem+"' is empty");
+      }
+      return id;
+    }
+  }
+
+  std::vector<EventIdentifier> readEventList(std::istream& iStream) {
+    std::vector<EventIdentifier> events;
+    std::string line;
+    unsigned int lineNumber = 0;
+    while(std::getline(iStream, line)) {
+      ++lineNumber;
+      auto first = line.find_first_not_of(" \t");
+      if(first == std::string::npos or line[first] == '#') {
+        continue;
+      }
+      std::istringstream lineStream(line);
+      EventIdentifier id;
+      std::string rest;
+      if(not (lineStream >> id.run >> id.lumi >> id.event) or (lineStream >> rest)) {
+        throw std::runtime_error("line "+std::to_string(lineNumber)+" of the event list is not 'run lumi event': "+line);
+      }
+      events.push_back(id);
+    }
+    return events;
+  }
+
+  std::vector<long> selectEvents(std::vector<EventIdentifier> const& iFileIDs, std::vector<EventIdentifier> iWanted) {
+    std::sort(iWanted.begin(), iWanted.end(), lessThan);
+    std::vector<long> positions;
+    for(long i = 0; i < static_cast<long>(iFileIDs.size()); ++i) {
+      if(std::binary_search(iWanted.begin(), iWanted.end(), iFileIDs[i], lessThan)) {
+        positions.push_back(i);
+      }
+    }
+    return positions;
+  }
+
+  EventSelection::EventSelection(std::string const& iSpecification) {
+    std::istringstream stream(iSpecification);
+    std::string item;
+    while(std::getline(stream, item, ',')) {
+      auto dash = item.find('-');
+      if(dash == std::string::npos) {
+        ranges_.push_back({parseIdentifier(item, item, false), parseIdentifier(item, item, true)});
+      } else {
+        ranges_.push_back({parseIdentifier(item.substr(0, dash), item, false), parseIdentifier(item.substr(dash+1), item, true)});
+      }
+    }
+  }
+
+  bool EventSelection::operator()(EventIdentifier const& iID) const {
+    if(ranges_.empty()) {
+      return true;
+    }
+    for(auto const& range: ranges_) {
+      if(not lessThan(iID, range.first_) and not lessThan(range.last_, iID)) {
+        return true;
+      }
+    }
+    return false;
+  }
+}
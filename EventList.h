@@ -0,0 +1,43 @@
+#if !defined(EventList_h)
+#define EventList_h
+
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "EventIdentifier.h"
+
+namespace cce::tf {
+  //Reads one whitespace separated run, lumi and event per line. Empty lines and
+  // lines starting with # are skipped. Throws std::runtime_error on a bad line.
+  std::vector<EventIdentifier> readEventList(std::istream&);
+
+  //the positions in iFileIDs, in increasing order, of the events in iWanted
+  std::vector<long> selectEvents(std::vector<EventIdentifier> const& iFileIDs, std::vector<EventIdentifier> iWanted);
+
+  /**
+     Selects events by ranges of their identifiers. The specification is a comma
+     separated list of items, each either one identifier or two joined by '-' which
+     selects all events from the first through the second. An identifier is `run`,
+     `run.lumi` or `run.lumi.event` where the parts not given match any value, e.g.
+     `1.3-1.7,5` selects luminosity blocks 3 through 7 of run 1 and all of run 5.
+   */
+  class EventSelection {
+  public:
+    EventSelection() = default;
+    //Throws std::runtime_error on a bad item
+    explicit EventSelection(std::string const& iSpecification);
+
+    //true if no items were given, all events are then selected
+    bool selectsAll() const { return ranges_.empty(); }
+    bool operator()(EventIdentifier const& iID) const;
+
+  private:
+    struct Range {
+      EventIdentifier first_;
+      EventIdentifier last_;
+    };
+    std::vector<Range> ranges_;
+  };
+}
+#endif
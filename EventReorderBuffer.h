@@ -0,0 +1,68 @@
+#if !defined(EventReorderBuffer_h)
+#define EventReorderBuffer_h
+
+#include <cstddef>
+#include <map>
+
+namespace cce::tf {
+  /**
+     Takes events in any order and passes them on in order of their event
+     index, starting from index 0 unless told otherwise. An event arriving before all the earlier ones
+     have been passed is held. Once iMaxHeld events are held, isFull() is true
+     so the caller can keep further events' Lanes waiting until the held events
+     are passed, which bounds the memory used.
+
+     Calls are expected to be made serially, e.g. from a SerialTaskQueue.
+   */
+  template<typename T>
+  class EventReorderBuffer {
+  public:
+    explicit EventReorderBuffer(std::size_t iMaxHeld): maxHeld_{iMaxHeld} {}
+
+    //iPass is called for each event which is now next in order, possibly including iEvent
+    template<typename F>
+    void push(long iEventIndex, T iEvent, F&& iPass) {
+      if(iEventIndex != next_) {
+        held_.emplace(iEventIndex, std::move(iEvent));
+        if(held_.size() > maxHeldReached_) {
+          maxHeldReached_ = held_.size();
+        }
+        return;
+      }
+      iPass(std::move(iEvent));
+      ++next_;
+      auto it = held_.begin();
+      while(it != held_.end() and it->first == next_) {
+        iPass(std::move(it->second));
+        it = held_.erase(it);
+        ++next_;
+      }
+    }
+
+    //passes on all held events in index order, skipping over missing indices
+    template<typename F>
+    void flush(F&& iPass) {
+      for(auto& e: held_) {
+        iPass(std::move(e.second));
+        next_ = e.first+1;
+      }
+      held_.clear();
+    }
+
+    //the first event to pass, can only be called before any event was pushed
+    void setFirstEventIndex(long iEventIndex) { next_ = iEventIndex; }
+
+    //true if pushing an event which is not next in order would go beyond iMaxHeld
+    bool isFull() const { return held_.size() >= maxHeld_; }
+    bool isNext(long iEventIndex) const { return iEventIndex == next_; }
+    std::size_t size() const { return held_.size(); }
+    std::size_t maxHeldReached() const { return maxHeldReached_; }
+
+  private:
+    std::map<long, T> held_;
+    std::size_t maxHeld_;
+    std::size_t maxHeldReached_ = 0;
+    long next_ = 0;
+  };
+}
+#endif
@@ -0,0 +1,42 @@
+#if !defined(EventSerializationBuffer_h)
+#define EventSerializationBuffer_h
+
+#include "TBufferFile.h"
+#include "BlobView.h"
+
+namespace cce::tf {
+  /**
+     One buffer per Lane into which the small data products of an event are
+     serialized one after the other, instead of each going through a buffer
+     of its own. Each data product's blob is then a part of this buffer.
+   */
+  class EventSerializationBuffer {
+  public:
+    EventSerializationBuffer(): buffer_{TBuffer::kWrite} {}
+    //keep any capacity the buffer has already grown to
+    EventSerializationBuffer(EventSerializationBuffer&& iOther):
+      buffer_{TBuffer::kWrite, iOther.buffer_.BufferSize()} {}
+    EventSerializationBuffer(EventSerializationBuffer const&) = delete;
+
+    //starts the next event, growing the buffer once up front to at least iSize bytes
+    void reset(int iSize) {
+      buffer_.Reset();
+      if(iSize > buffer_.BufferSize()) {
+        buffer_.Expand(iSize, false);
+        ++nExpansions_;
+      }
+    }
+
+    TBufferFile& buffer() { return buffer_; }
+    //valid until the next reset
+    BlobView view(int iStart, int iLength) const { return BlobView(buffer_.Buffer()+iStart, iLength); }
+
+    std::size_t capacity() const { return buffer_.BufferSize(); }
+    unsigned int nExpansions() const { return nExpansions_; }
+
+  private:
+    TBufferFile buffer_;
+    unsigned int nExpansions_ = 0;
+  };
+}
+#endif
@@ -2,29 +2,44 @@
 #include <vector>
 #include <fstream>
 #include <thread>
+#include <memory>
+#include <atomic>
 #include <iostream>
 #include "EventIdentifier.h"
 #include "DataProductRetriever.h"
 #include "TaskHolder.h"
 #include "WaiterBase.h"
 #include "WaiterFactory.h"
+#include "WaiterTimer.h"
 
 
 namespace cce::tf {
   class EventSleepWaiter : public WaiterBase {
  public:
 
-    EventSleepWaiter(std::vector<double> iEventSleepTimes, std::size_t iNDataProducts):
+    EventSleepWaiter(std::vector<double> iEventSleepTimes, std::size_t iNDataProducts, bool iAsyncSleep, bool iWeighted):
       sleepTimes_(std::move(iEventSleepTimes)),
-      nDataProducts_{iNDataProducts} {}
+      nDataProducts_{iNDataProducts} {
+      if(iAsyncSleep) {
+        timer_ = std::make_unique<WaiterTimer>();
+      }
+      if(iWeighted) {
+        productBytes_ = std::make_unique<std::atomic<unsigned long long>[]>(nDataProducts_);
+        productCounts_ = std::make_unique<std::atomic<unsigned long long>[]>(nDataProducts_);
+      }
+    }
 
     void waitAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, long iEventIndex,
                    std::vector<DataProductRetriever> const& iRetrievers, unsigned int index, 
                    TaskHolder iCallback) const final {
-      iCallback.group()->run([iCallback, iEventIndex, this]() {
-	  using namespace std::chrono_literals;
-          auto index = iEventIndex % sleepTimes_.size();
-	  auto sleep = (sleepTimes_[index]/nDataProducts_)*1us;
+      using namespace std::chrono_literals;
+      auto sleep = sleepTime(iEventIndex, iRetrievers[index].size(), index)*1us;
+      if(timer_) {
+        timer_->callAfter(sleep, [callback=std::move(iCallback)]() mutable { callback.doneWaiting(); });
+        return;
+      }
+      auto group = iCallback.group();
+      group->run([callback=std::move(iCallback), sleep]() {
 	  //std::cout <<"sleep "<<sleep.count()<<std::endl;
 	  std::this_thread::sleep_for( sleep);
 	  //std::cout <<"awake"<<std::endl;
@@ -32,8 +47,36 @@ namespace cce::tf {
     }
 
  private:
+    double sleepTime(long iEventIndex, std::size_t iSize, unsigned int iProductIndex) const {
+      auto eventTime = sleepTimes_[iEventIndex % sleepTimes_.size()];
+      if(not productBytes_) {
+        return eventTime/nDataProducts_;
+      }
+      //the other products of the event may not be read yet so their sizes are
+      // estimated by their average over all events seen so far
+      productBytes_[iProductIndex] += iSize;
+      ++productCounts_[iProductIndex];
+      double expectedEventBytes = 0;
+      for(std::size_t i=0; i< nDataProducts_; ++i) {
+        auto count = productCounts_[i].load();
+        if(count != 0) {
+          expectedEventBytes += double(productBytes_[i].load())/count;
+        }
+      }
+      if(expectedEventBytes == 0) {
+        return eventTime/nDataProducts_;
+      }
+      return eventTime*iSize/expectedEventBytes;
+    }
+
+
     std::vector<double> sleepTimes_;
     std::size_t nDataProducts_;
+    //only used for asyncSleep
+    std::unique_ptr<WaiterTimer> timer_;
+    //only used for weighted, total bytes and number of waits of each product
+    std::unique_ptr<std::atomic<unsigned long long>[]> productBytes_;
+    std::unique_ptr<std::atomic<unsigned long long>[]> productCounts_;
 };
 }
 
@@ -67,7 +110,7 @@ namespace {
         return {};
       }
 
-      return std::make_unique<EventSleepWaiter>(std::move(sleepTimes), iNDataProducts);
+      return std::make_unique<EventSleepWaiter>(std::move(sleepTimes), iNDataProducts, params.get<bool>("asyncSleep", false), params.get<bool>("weighted", false));
     }
     
   };
@@ -2,27 +2,39 @@
 #include <vector>
 #include <fstream>
 #include <thread>
+#include <memory>
 #include <iostream>
 #include "EventIdentifier.h"
 #include "DataProductRetriever.h"
 #include "TaskHolder.h"
 #include "WaiterBase.h"
 #include "WaiterFactory.h"
+#include "WaiterTimer.h"
 
 
 namespace cce::tf {
   class EventUnevenSleepWaiter : public WaiterBase {
  public:
 
-    EventUnevenSleepWaiter(std::vector<double> iEventSleepTimes, unsigned int iDivideBetween, std::size_t iNDataProducts):
+    EventUnevenSleepWaiter(std::vector<double> iEventSleepTimes, unsigned int iDivideBetween, std::size_t iNDataProducts, bool iAsyncSleep):
       sleepTimes_(std::move(iEventSleepTimes)),
       divideBetween_(iDivideBetween),
-      nDataProducts_{iNDataProducts} {}
+      nDataProducts_{iNDataProducts} {
+      if(iAsyncSleep) {
+        timer_ = std::make_unique<WaiterTimer>();
+      }
+    }
 
     void waitAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, long iEventIndex,
                    std::vector<DataProductRetriever> const& iRetrievers, unsigned int index, 
                    TaskHolder iCallback) const final {
       if(index < divideBetween_) {
+        if(timer_) {
+          using namespace std::chrono_literals;
+          auto sleep = (sleepTimes_[iEventIndex % sleepTimes_.size()]/divideBetween_)*1us;
+          timer_->callAfter(sleep, [callback=std::move(iCallback)]() mutable { callback.doneWaiting(); });
+          return;
+        }
         iCallback.group()->run([iCallback, iEventIndex, this]() {
             using namespace std::chrono_literals;
             auto index = iEventIndex % sleepTimes_.size();
@@ -38,6 +50,8 @@ namespace cce::tf {
     std::vector<double> sleepTimes_;
     unsigned int divideBetween_;
     std::size_t nDataProducts_;
+    //only used for asyncSleep
+    std::unique_ptr<WaiterTimer> timer_;
 };
 }
 
@@ -81,7 +95,7 @@ namespace {
         return {};
       }     
 
-      return std::make_unique<EventUnevenSleepWaiter>(std::move(sleepTimes), divideBetween, iNDataProducts);
+      return std::make_unique<EventUnevenSleepWaiter>(std::move(sleepTimes), divideBetween, iNDataProducts, params.get<bool>("asyncSleep", false));
     }
     
   };
@@ -0,0 +1,327 @@
+#include "FileChainSource.h"
+#include "SourceFactory.h"
+
+#include <iostream>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+using namespace cce::tf;
+
+namespace cce::tf {
+  bool isFileList(std::string_view iFileName) {
+    return (not iFileName.empty() and iFileName[0] == '@') or iFileName.find(',') != std::string_view::npos;
+  }
+
+  std::vector<std::string> parseFileList(std::string_view iFileNames) {
+    std::vector<std::string> names;
+    if(not iFileNames.empty() and iFileNames[0] == '@') {
+      std::string listName(iFileNames.substr(1));
+      std::ifstream list(listName);
+      if(not list) {
+        throw std::runtime_error("unable to open file list "+listName);
+      }
+      std::string line;
+      while(std::getline(list, line)) {
+        auto first = line.find_first_not_of(" \t");
+        if(first == std::string::npos or line[first] == '#') {
+          continue;
+        }
+        auto last = line.find_last_not_of(" \t\r");
+        names.push_back(line.substr(first, last+1-first));
+      }
+      return names;
+    }
+    while(not iFileNames.empty()) {
+      auto comma = iFileNames.find(',');
+      auto name = iFileNames.substr(0, comma);
+      if(not name.empty()) {
+        names.emplace_back(name);
+      }
+      if(comma == std::string_view::npos) {
+        break;
+      }
+      iFileNames.remove_prefix(comma+1);
+    }
+    return names;
+  }
+}
+
+//Handed to the Source of a file as its task. If the Source drops the task,
+// the file has no more events and the request is passed to the next file.
+class FileChainSource::Attempt {
+public:
+  Attempt(FileChainSource& iChain, unsigned int iLane, unsigned int iFile, long iLocalIndex, OptionalTaskHolder iTask):
+    chain_{&iChain}, task_{std::move(iTask)}, lane_{iLane}, file_{iFile}, localIndex_{iLocalIndex} {}
+  Attempt(Attempt&& iOther):
+    chain_{std::exchange(iOther.chain_, nullptr)}, task_{std::move(iOther.task_)},
+    lane_{iOther.lane_}, file_{iOther.file_}, localIndex_{iOther.localIndex_} {}
+  Attempt(Attempt const&) = delete;
+  Attempt& operator=(Attempt&&) = delete;
+  Attempt& operator=(Attempt const&) = delete;
+
+  ~Attempt() {
+    if(chain_) {
+      chain_->failed(lane_, file_, std::move(*task_));
+    }
+  }
+
+  void succeeded() {
+    std::exchange(chain_, nullptr)->succeeded(lane_, file_, localIndex_, std::move(*task_));
+  }
+
+private:
+  FileChainSource* chain_;
+  std::optional<OptionalTaskHolder> task_;
+  unsigned int lane_;
+  unsigned int file_;
+  long localIndex_;
+};
+
+FileChainSource::FileChainSource(unsigned int iNLanes, unsigned long long iNEvents, std::string iSourceType,
+                                 ConfigurationParameters::KeyValueMap iKeyValues, std::vector<std::string> iFileNames,
+                                 std::unique_ptr<SharedSourceBase> iFirstSource):
+  SharedSourceBase(iNEvents),
+  sourceType_{std::move(iSourceType)},
+  keyValues_{std::move(iKeyValues)},
+  nLanes_{iNLanes},
+  laneInfos_(iNLanes),
+  nDataProducts_{iFirstSource->numberOfDataProducts()}
+{
+  files_.reserve(iFileNames.size());
+  for(auto& name: iFileNames) {
+    files_.push_back(std::make_unique<File>(std::move(name)));
+  }
+  //Outputers are set up before the first event is read
+  for(unsigned int lane = 0; lane < iNLanes; ++lane) {
+    laneInfos_[lane].dataProducts_ = iFirstSource->dataProducts(lane, 0);
+  }
+  files_[0]->source_ = std::move(iFirstSource);
+  openInBackground(1);
+}
+
+FileChainSource::~FileChainSource() {
+  if(next_.valid()) {
+    try {
+      next_.get();
+    } catch(std::exception const&) {
+      //the file was never needed
+    }
+  }
+}
+
+std::unique_ptr<SharedSourceBase> FileChainSource::makeSource(std::string const& iSourceType, unsigned int iNLanes,
+                                                              ConfigurationParameters::KeyValueMap iKeyValues,
+                                                              std::string const& iFileName) {
+  iKeyValues["fileName"] = iFileName;
+  ConfigurationParameters params(std::move(iKeyValues));
+  //the chain decides when the job ends
+  auto source = SourceFactory::get()->create(iSourceType, iNLanes, std::numeric_limits<unsigned long long>::max(), params);
+  if(not source) {
+    return source;
+  }
+  auto unusedOptions = params.unusedKeys();
+  if(not unusedOptions.empty()) {
+    std::cout <<"Unused options in "<<iSourceType<<"\n";
+    for(auto const& key: unusedOptions) {
+      std::cout <<"  '"<<key<<"'"<<std::endl;
+    }
+    return {};
+  }
+  return source;
+}
+
+void FileChainSource::openInBackground(unsigned int iFile) {
+  if(iFile >= files_.size()) {
+    return;
+  }
+  next_ = std::async(std::launch::async, [this, iFile]() {
+      auto source = makeSource(sourceType_, nLanes_, keyValues_, files_[iFile]->name_);
+      if(not source) {
+        throw std::runtime_error("FileChainSource unable to read "+files_[iFile]->name_);
+      }
+      if(source->numberOfDataProducts() != nDataProducts_) {
+        throw std::runtime_error("FileChainSource: "+files_[iFile]->name_+" has a different number of data products than "+
+                                 files_[0]->name_);
+      }
+      return source;
+    });
+}
+
+void FileChainSource::advance(std::vector<std::unique_ptr<SharedSourceBase>>& oRetired) {
+  ++current_;
+  if(current_ >= 2) {
+    release(current_-2, oRetired);
+  }
+  if(current_ >= files_.size()) {
+    return;
+  }
+  auto start = std::chrono::high_resolution_clock::now();
+  try {
+    files_[current_]->source_ = next_.get();
+  } catch(std::exception const& iError) {
+    //called while a Source drops a task so the chain ends here
+    error_ = iError.what();
+    std::cout <<error_<<std::endl;
+    current_ = files_.size();
+    return;
+  }
+  openWaitTime_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+  ++nOpened_;
+  openInBackground(current_+1);
+}
+
+void FileChainSource::release(unsigned int iFile, std::vector<std::unique_ptr<SharedSourceBase>>& oRetired) {
+  //A Source may still be returning from the call which ran or dropped our task, so
+  // it is only destroyed once the Lanes have moved past the file after it.
+  auto& f = *files_[iFile];
+  if(iFile+2 <= current_ and f.users_ == 0 and f.source_) {
+    oRetired.push_back(std::move(f.source_));
+  }
+}
+
+void FileChainSource::readEventAsync(unsigned int iLane, long, OptionalTaskHolder iTask) {
+  std::vector<std::unique_ptr<SharedSourceBase>> retired;
+  unsigned int file;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto& info = laneInfos_[iLane];
+    //the Lane is done with its previous event
+    if(info.file_) {
+      --files_[*info.file_]->users_;
+      release(*info.file_, retired);
+      info.file_.reset();
+    }
+    file = current_;
+    if(file < files_.size()) {
+      ++files_[file]->users_;
+    }
+  }
+  retired.clear();
+  if(file < files_.size()) {
+    attempt(iLane, file, std::move(iTask));
+  }
+}
+
+void FileChainSource::attempt(unsigned int iLane, unsigned int iFile, OptionalTaskHolder iTask) {
+  auto& f = *files_[iFile];
+  long localIndex = f.nextIndex_++;
+  auto& group = *iTask.group();
+  f.source_->gotoEventAsync(iLane, localIndex,
+                            OptionalTaskHolder(group, make_functor_task([attempt = Attempt(*this, iLane, iFile, localIndex, std::move(iTask))]() mutable {
+                                  attempt.succeeded();
+                                })));
+}
+
+void FileChainSource::succeeded(unsigned int iLane, unsigned int iFile, long iLocalIndex, OptionalTaskHolder iTask) {
+  auto& f = *files_[iFile];
+  ++f.nEvents_;
+  auto& info = laneInfos_[iLane];
+  info.file_ = iFile;
+  info.localIndex_ = iLocalIndex;
+  info.dataProducts_ = f.source_->dataProducts(iLane, iLocalIndex);
+  iTask.runNow();
+}
+
+void FileChainSource::failed(unsigned int iLane, unsigned int iFile, OptionalTaskHolder iTask) {
+  std::vector<std::unique_ptr<SharedSourceBase>> retired;
+  unsigned int file;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    --files_[iFile]->users_;
+    //the first Lane to find the end of the file moves the chain on
+    if(current_ == iFile) {
+      advance(retired);
+    }
+    release(iFile, retired);
+    file = current_;
+    if(file < files_.size()) {
+      ++files_[file]->users_;
+    }
+  }
+  retired.clear();
+  if(file < files_.size()) {
+    attempt(iLane, file, std::move(iTask));
+  }
+}
+
+std::vector<DataProductRetriever>& FileChainSource::dataProducts(unsigned int iLane, long) {
+  return laneInfos_[iLane].dataProducts_;
+}
+
+EventIdentifier FileChainSource::eventIdentifier(unsigned int iLane, long) {
+  auto const& info = laneInfos_[iLane];
+  return files_[*info.file_]->source_->eventIdentifier(iLane, info.localIndex_);
+}
+
+void FileChainSource::printSummary() const {
+  std::cout <<"\nFileChainSource\n";
+  std::cout <<" files: "<<files_.size()<<" opened: "<<nOpened_<<"\n";
+  std::cout <<" time waiting for the next file to open: "<<openWaitTime_.count()<<"us\n";
+  if(not error_.empty()) {
+    std::cout <<" stopped early: "<<error_<<"\n";
+  }
+  for(auto const& f: files_) {
+    if(f->nEvents_ != 0) {
+      std::cout <<"  "<<f->name_<<" events: "<<f->nEvents_<<"\n";
+    }
+  }
+  //the Source of the last file read is still available
+  for(auto it = files_.rbegin(); it != files_.rend(); ++it) {
+    if((*it)->source_) {
+      (*it)->source_->printSummary();
+      break;
+    }
+  }
+}
+
+void FileChainSource::fillReport(RunReport& oReport) const {
+  oReport.set("files", files_.size());
+  oReport.set("filesOpened", nOpened_);
+  oReport.set("openWaitTime_us", openWaitTime_.count());
+  if(not error_.empty()) {
+    oReport.set("error", error_);
+  }
+}
+
+namespace {
+  class Maker : public SourceMakerBase {
+  public:
+    Maker(): SourceMakerBase("FileChainSource") {}
+    std::unique_ptr<SharedSourceBase> create(unsigned int iNLanes, unsigned long long iNEvents, ConfigurationParameters const& params) const final {
+      auto fileName = params.get<std::string>("fileName");
+      if(not fileName) {
+        std::cout <<"no file names given for FileChainSource\n";
+        return {};
+      }
+      auto sourceType = params.get<std::string>("source");
+      if(not sourceType) {
+        std::cout <<"no source given for FileChainSource\n";
+        return {};
+      }
+      std::vector<std::string> fileNames;
+      try {
+        fileNames = parseFileList(*fileName);
+      } catch(std::runtime_error const& iError) {
+        std::cout <<iError.what()<<std::endl;
+        return {};
+      }
+      if(fileNames.empty()) {
+        std::cout <<"no files listed for FileChainSource in "<<*fileName<<std::endl;
+        return {};
+      }
+
+      //all other parameters are for the Sources of the files
+      auto keyValues = params.takeUnusedKeyValues();
+      auto first = FileChainSource::makeSource(*sourceType, iNLanes, keyValues, fileNames[0]);
+      if(not first) {
+        return {};
+      }
+      return std::make_unique<FileChainSource>(iNLanes, iNEvents, *sourceType, std::move(keyValues),
+                                               std::move(fileNames), std::move(first));
+    }
+  };
+
+  Maker s_maker;
+}
@@ -0,0 +1,110 @@
+#if !defined(FileChainSource_h)
+#define FileChainSource_h
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <mutex>
+#include <future>
+#include <atomic>
+#include <optional>
+#include <chrono>
+
+#include "SharedSourceBase.h"
+#include "ConfigurationParameters.h"
+#include "PerLaneCounter.h"
+
+namespace cce::tf {
+  //The file names given as a comma separated list or, if iFileNames starts with
+  // '@', read from the named text file, one per line. Empty lines and lines
+  // starting with '#' are ignored.
+  std::vector<std::string> parseFileList(std::string_view iFileNames);
+
+  //true if iFileName is a comma separated list or an '@' list file
+  bool isFileList(std::string_view iFileName);
+
+  /**
+     Reads a list of files one after the other as one dataset. Each file is read
+     by its own Source of the same type, made with the same parameters. While the
+     Lanes read the present file the Source for the following file is made on a
+     separate thread, so opening it and reading its header, and any read ahead
+     its Source starts, overlap with the processing. A Source is destroyed once
+     no Lane uses it anymore.
+   */
+class FileChainSource : public SharedSourceBase {
+ public:
+  FileChainSource(unsigned int iNLanes, unsigned long long iNEvents, std::string iSourceType,
+                  ConfigurationParameters::KeyValueMap iKeyValues, std::vector<std::string> iFileNames,
+                  std::unique_ptr<SharedSourceBase> iFirstSource);
+  FileChainSource(FileChainSource&&) = delete;
+  FileChainSource(FileChainSource const&) = delete;
+  ~FileChainSource();
+
+  size_t numberOfDataProducts() const final { return nDataProducts_; }
+  std::vector<DataProductRetriever>& dataProducts(unsigned int iLane, long iEventIndex) final;
+  EventIdentifier eventIdentifier(unsigned int iLane, long iEventIndex) final;
+
+  void printSummary() const final;
+  void fillReport(RunReport&) const final;
+
+  //makes the Source for one file, returns nothing if the Source could not be made
+  static std::unique_ptr<SharedSourceBase> makeSource(std::string const& iSourceType, unsigned int iNLanes,
+                                                      ConfigurationParameters::KeyValueMap iKeyValues,
+                                                      std::string const& iFileName);
+
+ private:
+  class Attempt;
+
+  void readEventAsync(unsigned int iLane, long iEventIndex, OptionalTaskHolder iTask) final;
+
+  //asks the Source of file iFile for its next event
+  void attempt(unsigned int iLane, unsigned int iFile, OptionalTaskHolder iTask);
+  void succeeded(unsigned int iLane, unsigned int iFile, long iLocalIndex, OptionalTaskHolder iTask);
+  //the Source of iFile dropped the request so the file has no more events
+  void failed(unsigned int iLane, unsigned int iFile, OptionalTaskHolder iTask);
+
+  //the following functions require mutex_ to be held. Sources no longer
+  // needed are moved to oRetired so they are destroyed after mutex_ is released.
+  void advance(std::vector<std::unique_ptr<SharedSourceBase>>& oRetired);
+  void openInBackground(unsigned int iFile);
+  void release(unsigned int iFile, std::vector<std::unique_ptr<SharedSourceBase>>& oRetired);
+
+  struct File {
+    explicit File(std::string iName): name_{std::move(iName)} {}
+    std::string name_;
+    std::unique_ptr<SharedSourceBase> source_;
+    //the index given to the next request to the Source of this file
+    std::atomic<long> nextIndex_{0};
+    std::atomic<unsigned long long> nEvents_{0};
+    //Lanes holding an event of this file or waiting for one, guarded by mutex_
+    unsigned int users_ = 0;
+  };
+
+  struct alignas(kCacheLineSize) LaneInfo {
+    //copies of the retrievers of the file's Source so Outputers always see the same container
+    std::vector<DataProductRetriever> dataProducts_;
+    std::optional<unsigned int> file_;
+    long localIndex_ = 0;
+  };
+
+  std::string const sourceType_;
+  ConfigurationParameters::KeyValueMap const keyValues_;
+  unsigned int const nLanes_;
+  std::vector<std::unique_ptr<File>> files_;
+  std::vector<LaneInfo> laneInfos_;
+  std::size_t const nDataProducts_;
+
+  std::mutex mutex_;
+  //the file new requests go to, files_.size() once all were read
+  unsigned int current_ = 0;
+  unsigned int nOpened_ = 1;
+  std::chrono::microseconds openWaitTime_{0};
+  //why the chain stopped before its last file
+  std::string error_;
+  //the Source of the file following current_, declared last so the thread
+  // making it is joined before the other members go away
+  std::future<std::unique_ptr<SharedSourceBase>> next_;
+};
+}
+#endif
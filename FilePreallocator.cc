@@ -0,0 +1,128 @@
+#include "FilePreallocator.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace cce::tf;
+
+namespace {
+  //the largest extent is this many times the smallest
+  constexpr std::uint64_t kMaxExtentFactor = 64;
+
+  std::uint64_t roundUp(std::uint64_t iValue, std::uint64_t iMultiple) {
+    return ((iValue + iMultiple - 1)/iMultiple)*iMultiple;
+  }
+}
+
+FilePreallocator::FilePreallocator(std::string const& iFileName, std::uint64_t iMinExtent, double iSecondsAhead):
+  minExtent_{std::max(iMinExtent, std::uint64_t(1))},
+  secondsAhead_{iSecondsAhead},
+  lastTime_{Clock::now()}
+{
+  //the file was already created by what writes it
+  fd_ = ::open(iFileName.c_str(), O_WRONLY);
+  if(fd_ < 0) {
+    throw std::runtime_error("FilePreallocator unable to open file "+iFileName+": "+std::strerror(errno));
+  }
+#if !defined(__linux__)
+  supported_ = false;
+#endif
+}
+
+FilePreallocator::~FilePreallocator() {
+  finish();
+}
+
+std::uint64_t FilePreallocator::extentSize(std::uint64_t iMinExtent, double iBytesPerSecond, double iSecondsAhead) {
+  iMinExtent = std::max(iMinExtent, std::uint64_t(1));
+  double const wanted = std::min(iBytesPerSecond*iSecondsAhead, double(kMaxExtentFactor*iMinExtent));
+  if(not (wanted > iMinExtent)) {
+    return iMinExtent;
+  }
+  return roundUp(static_cast<std::uint64_t>(wanted), iMinExtent);
+}
+
+std::uint64_t FilePreallocator::fileSize() const {
+  struct stat info;
+  if(::fstat(fd_, &info) != 0) {
+    throw std::runtime_error(std::string("FilePreallocator unable to stat file: ")+std::strerror(errno));
+  }
+  return info.st_size;
+}
+
+void FilePreallocator::written() {
+  if(fd_ < 0 or not supported_) {
+    return;
+  }
+  written(fileSize());
+}
+
+void FilePreallocator::written(std::uint64_t iPosition, Clock::time_point iNow) {
+  //the next extent is allocated once less than half the smallest one is left
+  if(fd_ < 0 or not supported_ or iPosition + minExtent_/2 <= allocatedEnd_) {
+    return;
+  }
+  double bytesPerSecond = 0.;
+  double const seconds = std::chrono::duration<double>(iNow - lastTime_).count();
+  if(nAllocations_ != 0 and seconds > 0. and iPosition > lastPosition_) {
+    bytesPerSecond = (iPosition - lastPosition_)/seconds;
+  }
+  auto const begin = std::max(allocatedEnd_, iPosition);
+  auto const end = roundUp(iPosition + extentSize(minExtent_, bytesPerSecond, secondsAhead_), minExtent_);
+#if defined(__linux__)
+  //keeping the size lets readers, and the library writing the file, see only what was written
+  if(::fallocate(fd_, FALLOC_FL_KEEP_SIZE, begin, end - begin) != 0) {
+    if(errno != EOPNOTSUPP and errno != ENOSYS) {
+      std::cout <<"FilePreallocator stopped allocating ahead: "<<std::strerror(errno)<<std::endl;
+    }
+    supported_ = false;
+    return;
+  }
+#endif
+  allocatedEnd_ = end;
+  lastPosition_ = iPosition;
+  lastTime_ = iNow;
+  ++nAllocations_;
+}
+
+void FilePreallocator::finish() {
+  if(fd_ < 0) {
+    return;
+  }
+  auto const size = fileSize();
+  if(allocatedEnd_ > size) {
+    unusedBytes_ = allocatedEnd_ - size;
+    //the size is unchanged but the blocks allocated beyond it are freed
+    if(::ftruncate(fd_, size) != 0) {
+      std::cout <<"FilePreallocator unable to truncate file: "<<std::strerror(errno)<<std::endl;
+    }
+  }
+  ::close(fd_);
+  fd_ = -1;
+}
+
+namespace cce::tf {
+  void summarize_preallocation(FilePreallocator const& iPreallocator) {
+    std::cout <<"  preallocated extents: "<<iPreallocator.nAllocations()
+              <<" up to "<<iPreallocator.allocatedEnd()<<" bytes, unused at close "<<iPreallocator.unusedBytes()<<" bytes";
+    if(not iPreallocator.supported()) {
+      std::cout <<" (not supported by the file system)";
+    }
+    std::cout <<"\n";
+  }
+
+  void report_preallocation(RunReport& oReport, FilePreallocator const& iPreallocator) {
+    auto& preallocation = oReport.section("preallocation");
+    preallocation.set("extents", iPreallocator.nAllocations());
+    preallocation.set("allocatedEnd", iPreallocator.allocatedEnd());
+    preallocation.set("unusedBytes", iPreallocator.unusedBytes());
+    preallocation.set("supported", iPreallocator.supported());
+  }
+}
@@ -0,0 +1,72 @@
+#if !defined(FilePreallocator_h)
+#define FilePreallocator_h
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "RunReport.h"
+
+namespace cce::tf {
+  /**
+     Allocates the blocks of a file being written in large extents ahead of
+     its write position, using fallocate, so file systems such as XFS or
+     Lustre can lay the file out in a few contiguous extents instead of
+     growing it by each small append. The size of the file is not changed by
+     the allocation, the file always looks as it has been written.
+
+     The extent allocated ahead follows the rate the file is written at, so
+     about iSecondsAhead of writes are covered, but is never smaller than
+     iMinExtent nor larger than 64 times it. Extents end on multiples of
+     iMinExtent. finish() truncates the file to its size, freeing the blocks
+     allocated beyond its end.
+
+     The file is opened again by name, so the object writing it can be
+     anything, e.g. a std::ofstream, a TFile or an HDF5 file. If the file
+     system can not allocate ahead, nothing more is tried.
+   */
+  class FilePreallocator {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    FilePreallocator(std::string const& iFileName, std::uint64_t iMinExtent, double iSecondsAhead = 1.);
+    ~FilePreallocator();
+    FilePreallocator(FilePreallocator const&) = delete;
+    FilePreallocator& operator=(FilePreallocator const&) = delete;
+
+    //iPosition is where the writes of the file have reached. Must not be called concurrently.
+    void written(std::uint64_t iPosition, Clock::time_point iNow = Clock::now());
+    //uses the present size of the file as the position
+    void written();
+    //truncates the file to its present size and closes it, only the first call does anything
+    void finish();
+
+    //bytes to allocate ahead when the file is written at iBytesPerSecond
+    static std::uint64_t extentSize(std::uint64_t iMinExtent, double iBytesPerSecond, double iSecondsAhead);
+
+    bool supported() const { return supported_; }
+    unsigned long long nAllocations() const { return nAllocations_; }
+    //the file's blocks have been allocated up to this offset
+    std::uint64_t allocatedEnd() const { return allocatedEnd_; }
+    //bytes which were allocated but not written, known once finish() was called
+    std::uint64_t unusedBytes() const { return unusedBytes_; }
+
+  private:
+    std::uint64_t fileSize() const;
+
+    int fd_ = -1;
+    std::uint64_t minExtent_;
+    double secondsAhead_;
+    bool supported_ = true;
+    std::uint64_t allocatedEnd_ = 0;
+    //where the file was when the previous extent was allocated, to find the write rate
+    std::uint64_t lastPosition_ = 0;
+    Clock::time_point lastTime_;
+    unsigned long long nAllocations_ = 0;
+    std::uint64_t unusedBytes_ = 0;
+  };
+
+  void summarize_preallocation(FilePreallocator const&);
+  void report_preallocation(RunReport&, FilePreallocator const&);
+}
+#endif
@@ -0,0 +1,45 @@
+#include "FixedLayout.h"
+
+#include <unordered_map>
+#include <typeindex>
+
+using namespace cce::tf;
+
+namespace {
+  std::unordered_map<std::type_index, FixedLayoutFunctions>& registry() {
+    static std::unordered_map<std::type_index, FixedLayoutFunctions> s_registry;
+    return s_registry;
+  }
+
+  FixedLayoutRegistration<std::vector<char>> s_chars;
+  FixedLayoutRegistration<std::vector<unsigned char>> s_uchars;
+  FixedLayoutRegistration<std::vector<short>> s_shorts;
+  FixedLayoutRegistration<std::vector<unsigned short>> s_ushorts;
+  FixedLayoutRegistration<std::vector<int>> s_ints;
+  FixedLayoutRegistration<std::vector<unsigned int>> s_uints;
+  FixedLayoutRegistration<std::vector<long>> s_longs;
+  FixedLayoutRegistration<std::vector<unsigned long>> s_ulongs;
+  FixedLayoutRegistration<std::vector<float>> s_floats;
+  FixedLayoutRegistration<std::vector<double>> s_doubles;
+  FixedLayoutRegistration<std::vector<std::vector<int>>> s_intVectors;
+  FixedLayoutRegistration<std::vector<std::vector<float>>> s_floatVectors;
+  FixedLayoutRegistration<std::vector<std::vector<double>>> s_doubleVectors;
+}
+
+namespace cce::tf {
+  FixedLayoutFunctions const* findFixedLayout(TClass const& iClass) {
+    auto typeInfo = iClass.GetTypeInfo();
+    if(not typeInfo) {
+      return nullptr;
+    }
+    auto itFound = registry().find(std::type_index(*typeInfo));
+    if(itFound == registry().end()) {
+      return nullptr;
+    }
+    return &itFound->second;
+  }
+
+  void registerFixedLayout(std::type_info const& iType, FixedLayoutFunctions iFunctions) {
+    registry()[std::type_index(iType)] = iFunctions;
+  }
+}
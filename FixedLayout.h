@@ -0,0 +1,93 @@
+#if !defined(FixedLayout_h)
+#define FixedLayout_h
+
+#include <vector>
+#include <typeinfo>
+#include <type_traits>
+#include "TBufferFile.h"
+#include "TClass.h"
+
+namespace cce::tf {
+  /**
+     Compile-time generated serialization of a fixed-layout type. Contiguous
+     arrays and fixed fields are written with single TBufferFile calls rather
+     than by dispatching through TStreamerInfoActions. A type is given a layout
+     by specializing FixedLayout<T> with static write and read functions, which
+     must be the inverse of each other, and registering it with
+     FixedLayoutRegistration<T>.
+   */
+  template<typename T>
+  struct FixedLayout;
+
+  template<typename T>
+  struct FixedLayout<std::vector<T>> {
+    static_assert(std::is_arithmetic_v<T>);
+    static void write(TBufferFile& oBuffer, std::vector<T> const& iValue) {
+      Int_t size = iValue.size();
+      oBuffer << size;
+      oBuffer.WriteFastArray(iValue.data(), size);
+    }
+    static void read(TBufferFile& iBuffer, std::vector<T>& oValue) {
+      Int_t size;
+      iBuffer >> size;
+      oValue.resize(size);
+      iBuffer.ReadFastArray(oValue.data(), size);
+    }
+  };
+
+  //Reading reuses the capacity of the inner vectors across events. Inner vectors
+  // dropped when the outer vector shrinks are kept for later reads on the same thread
+  // instead of having their storage freed.
+  template<typename T>
+  struct FixedLayout<std::vector<std::vector<T>>> {
+    static void write(TBufferFile& oBuffer, std::vector<std::vector<T>> const& iValue) {
+      Int_t size = iValue.size();
+      oBuffer << size;
+      for(auto const& v: iValue) {
+        FixedLayout<std::vector<T>>::write(oBuffer, v);
+      }
+    }
+    static void read(TBufferFile& iBuffer, std::vector<std::vector<T>>& oValue) {
+      thread_local std::vector<std::vector<T>> s_spares;
+      Int_t size;
+      iBuffer >> size;
+      std::size_t const newSize = size;
+      while(oValue.size() > newSize) {
+        s_spares.push_back(std::move(oValue.back()));
+        oValue.pop_back();
+      }
+      oValue.reserve(newSize);
+      while(oValue.size() < newSize) {
+        if(s_spares.empty()) {
+          oValue.emplace_back();
+        } else {
+          oValue.push_back(std::move(s_spares.back()));
+          s_spares.pop_back();
+        }
+      }
+      for(auto& v: oValue) {
+        FixedLayout<std::vector<T>>::read(iBuffer, v);
+      }
+    }
+  };
+
+  struct FixedLayoutFunctions {
+    void (*write_)(TBufferFile&, void const*);
+    void (*read_)(TBufferFile&, void*);
+  };
+
+  //returns nullptr if no layout was registered for the type of the class
+  FixedLayoutFunctions const* findFixedLayout(TClass const& iClass);
+
+  void registerFixedLayout(std::type_info const&, FixedLayoutFunctions);
+
+  template<typename T>
+  struct FixedLayoutRegistration {
+    FixedLayoutRegistration() {
+      registerFixedLayout(typeid(T), {
+          [](TBufferFile& oBuffer, void const* iAddress) { FixedLayout<T>::write(oBuffer, *static_cast<T const*>(iAddress)); },
+          [](TBufferFile& iBuffer, void* iAddress) { FixedLayout<T>::read(iBuffer, *static_cast<T*>(iAddress)); } });
+    }
+  };
+}
+#endif
@@ -0,0 +1,48 @@
+#if !defined(FixedLayoutDeserializer_h)
+#define FixedLayoutDeserializer_h
+
+#include <vector>
+#include <optional>
+#include "TBufferFile.h"
+#include "TClass.h"
+#include "FixedLayout.h"
+#include "UnrolledDeserializer.h"
+
+namespace cce::tf {
+/**
+   Reads what FixedLayoutSerializer wrote. Uses the FixedLayout registered
+   for the class if there is one, else falls back to the unrolled deserialization.
+ */
+class FixedLayoutDeserializer {
+public:
+  FixedLayoutDeserializer(TClass* iClass): layout_{findFixedLayout(*iClass)}, bufferFile_{TBuffer::kRead} {
+    if(not layout_) {
+      unrolled_.emplace(iClass);
+    }
+  }
+
+  FixedLayoutDeserializer(FixedLayoutDeserializer&& iOther):
+    layout_{iOther.layout_}, unrolled_{std::move(iOther.unrolled_)}, bufferFile_{TBuffer::kRead} {}
+
+  FixedLayoutDeserializer(FixedLayoutDeserializer const&) = delete;
+
+  int deserialize(std::vector<char> const& iBuffer, void* iWriteTo) {
+    return deserialize(&iBuffer.front(), iBuffer.size(), iWriteTo);
+  }
+  int deserialize(char const * iBuffer, size_t iBufferSize, void* iWriteTo) {
+    if(unrolled_) {
+      return unrolled_->deserialize(iBuffer, iBufferSize, iWriteTo);
+    }
+    bufferFile_.SetBuffer( const_cast<char*>(iBuffer), iBufferSize, kFALSE);
+
+    layout_->read_(bufferFile_, iWriteTo);
+    return bufferFile_.Length();
+  }
+
+private:
+  FixedLayoutFunctions const* layout_;
+  std::optional<UnrolledDeserializer> unrolled_;
+  TBufferFile bufferFile_;
+};
+}
+#endif
@@ -0,0 +1,63 @@
+#if !defined(FixedLayoutSerializer_h)
+#define FixedLayoutSerializer_h
+
+#include <vector>
+#include <optional>
+#include "TBufferFile.h"
+#include "TClass.h"
+#include "BlobView.h"
+#include "FixedLayout.h"
+#include "UnrolledSerializer.h"
+
+namespace cce::tf {
+/**
+   Uses the FixedLayout registered for the class if there is one,
+   else falls back to the unrolled serialization.
+ */
+class FixedLayoutSerializer {
+public:
+  FixedLayoutSerializer(TClass* iClass):
+    bufferFile_{TBuffer::kWrite}, layout_{findFixedLayout(*iClass)} {
+    if(not layout_) {
+      unrolled_.emplace(iClass);
+    }
+  }
+
+  FixedLayoutSerializer(FixedLayoutSerializer&& iOther):
+    bufferFile_{TBuffer::kWrite, iOther.bufferFile_.BufferSize()}, layout_{iOther.layout_}, unrolled_{std::move(iOther.unrolled_)} {}
+
+  FixedLayoutSerializer(FixedLayoutSerializer const&) = delete;
+
+  std::vector<char> serialize(void const* address) {
+    auto view = serializeToView(address);
+    return std::vector<char>(view.begin(), view.end());
+  }
+
+  //Avoids copying the serialized data product. The view is valid until the next call.
+  BlobView serializeToView(void const* address) {
+    if(unrolled_) {
+      return unrolled_->serializeToView(address);
+    }
+    bufferFile_.Reset();
+    layout_->write_(bufferFile_, address);
+    return BlobView(bufferFile_.Buffer(), bufferFile_.Length());
+  }
+
+  int capacity() const { return unrolled_ ? unrolled_->capacity() : bufferFile_.BufferSize(); }
+  void reserve(int iSize) {
+    if(unrolled_) {
+      unrolled_->reserve(iSize);
+    } else if(iSize > bufferFile_.BufferSize()) {
+      bufferFile_.Expand(iSize, false);
+    }
+  }
+
+  bool usesFixedLayout() const { return not unrolled_; }
+
+private:
+  TBufferFile bufferFile_;
+  FixedLayoutFunctions const* layout_;
+  std::optional<UnrolledSerializer> unrolled_;
+};
+}
+#endif
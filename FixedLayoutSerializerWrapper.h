@@ -0,0 +1,63 @@
+#if !defined(FixedLayoutSerializerWrapper_h)
+#define FixedLayoutSerializerWrapper_h
+
+#include <vector>
+#include <chrono>
+#include "TClass.h"
+#include "SerializedSizeStats.h"
+#include "ProductProfile.h"
+
+#include "tbb/task_group.h"
+#include "FixedLayoutSerializer.h"
+#include "TaskHolder.h"
+
+namespace cce::tf {
+class FixedLayoutSerializerWrapper {
+public:
+ FixedLayoutSerializerWrapper(std::string_view iName,  TClass* tClass):
+  name_{iName}, class_(tClass), serializer_{tClass},
+  accumulatedTime_{std::chrono::microseconds::zero()} {
+    if(auto profile = serializationProfile(iName)) {
+      serializer_.reserve(profile->p99Bytes_);
+    }
+  }
+
+  void doWorkAsync(tbb::task_group& iGroup, void** iAddress, TaskHolder iCallback) {
+    iGroup.run([this, iAddress, callback=std::move(iCallback)] () {
+	doWork(iAddress);
+	const_cast<TaskHolder&>(callback).doneWaiting();
+      });
+  }
+  //serializes in the calling task
+  void doWork(void** iAddress) {
+    auto start = std::chrono::high_resolution_clock::now();
+    serializer_.reserve(sizeStats_.p99());
+    auto const capacity = serializer_.capacity();
+    blob_ = serializer_.serializeToView(*iAddress);
+    if(serializer_.capacity() > capacity) {
+      ++nExpansions_;
+    }
+    sizeStats_.fill(blob_.size());
+    accumulatedTime_ += std::chrono::duration_cast<decltype(accumulatedTime_)>(std::chrono::high_resolution_clock::now() - start);
+  }
+  BlobView blob() const {return blob_;}
+
+  std::string_view  name() const {return name_;}
+  char const* className() const { return class_->GetName(); }
+  std::chrono::microseconds accumulatedTime() const { return accumulatedTime_;}
+  //number of times the buffer had to grow while serializing
+  unsigned int nExpansions() const { return nExpansions_;}
+  //bytes held by the serialization buffer
+  std::size_t bufferCapacity() const { return serializer_.capacity();}
+  SerializedSizeStats const& sizeStats() const { return sizeStats_;}
+private:
+  BlobView blob_;
+  std::string_view name_;
+  TClass const* class_;
+  FixedLayoutSerializer serializer_;
+  std::chrono::microseconds accumulatedTime_;
+  SerializedSizeStats sizeStats_;
+  unsigned int nExpansions_ = 0;
+};
+}
+#endif
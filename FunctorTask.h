@@ -5,6 +5,7 @@
 #include <memory>
 
 #include "TaskBase.h"
+#include "TaskPool.h"
 
 namespace cce::tf {
 template <typename F>
@@ -24,6 +25,12 @@ template <typename F>
 std::unique_ptr<FunctorTask<F>>  make_functor_task(F f) {
   return std::make_unique<FunctorTask<F>>(std::move(f));
 }
+
+//memory for the task comes from iPool and is returned there once the task is deleted
+template <typename F>
+std::unique_ptr<FunctorTask<F>>  make_functor_task(TaskPool& iPool, F f) {
+  return std::unique_ptr<FunctorTask<F>>(new (iPool) FunctorTask<F>(std::move(f)));
+}
 }
 #endif
 
@@ -1,59 +1,69 @@
-#ifndef H5_TIMING_H
-
-#define H5_TIMING_H
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <sys/time.h>
-#include <unistd.h>
-#include <vector>
-#include <map>
-#include <string>
-#undef H5_TIMING_ENABLE
-
-#ifdef H5_TIMING_ENABLE
-typedef struct H5Timer{
-    double start;
-    double end;
-    size_t data_size;
-    char *name;
-} H5Timer;
-
-typedef struct H5TimerClass{
-    std::vector<H5Timer> *dataset_timers;
-    std::vector<H5Timer> *dataset_sz_timers;
-    std::vector<H5Timer> *dataset_read_timers;
-    std::vector<H5Timer> *dataset_sz_read_timers;
-    int H5Dwrite_count;
-    int H5Dread_count;
-
-    double H5Dclose_time;
-    double wrap_requests_time;
-    double merge_requests_time;
-    double H5Dwrite_time;
-    double H5Dread_time;
-    double total_start_time;
-    double total_end_time;
-} H5TimerClass;
-
-int init_timers();
-int register_timer_start(double *start_time);
-int register_merge_requests_timer_end(double start_time);
-int register_wrap_requests_timer_end(double start_time);
-int register_H5Dclose_timer_end(double start_time);
-int register_H5Dwrite_timer_end(double start_time);
-
-int register_dataset_timer_start(const char *name);
-int register_dataset_timer_end(size_t data_size);
-int register_dataset_sz_timer_start(const char *name);
-int register_dataset_sz_timer_end(size_t data_size);
-int register_dataset_read_timer_start(const char *name);
-int register_dataset_read_timer_end(size_t data_size);
-int register_dataset_sz_read_timer_start(const char *name);
-int register_dataset_sz_read_timer_end(size_t data_size);
-int increment_H5Dwrite();
-int increment_H5Dread();
-int finalize_timers();
-#endif
+#if !defined(H5Timing_h)
+#define H5Timing_h
+
+#include <chrono>
+#include <cstddef>
+#include "tbb/enumerable_thread_specific.h"
+
+namespace cce::tf::hdf5 {
+  /**
+     Accumulates the number of calls, the time and the bytes of the HDF5 steps
+     of an outputer. Each thread adds to its own counters so recording takes no
+     lock, the totals are combined when asked for. When disabled, timing a step
+     only tests a bool.
+   */
+  class H5Timing {
+  public:
+    enum Step { kWrite, kMerge, kNSteps };
+
+    explicit H5Timing(bool iEnabled = false): enabled_{iEnabled} {}
+    bool enabled() const { return enabled_; }
+
+    //records the step when it goes out of scope. iTiming may be null.
+    class Timer {
+    public:
+      Timer(H5Timing const* iTiming, Step iStep, std::size_t iBytes = 0):
+        timing_{(iTiming and iTiming->enabled_) ? iTiming : nullptr}, step_{iStep}, bytes_{iBytes},
+        start_{timing_ ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point()} {}
+      ~Timer() {
+        if(timing_) {
+          timing_->add(step_, std::chrono::steady_clock::now() - start_, bytes_);
+        }
+      }
+      Timer(Timer const&) = delete;
+      Timer& operator=(Timer const&) = delete;
+    private:
+      H5Timing const* timing_;
+      Step step_;
+      std::size_t bytes_;
+      std::chrono::steady_clock::time_point start_;
+    };
+    Timer time(Step iStep, std::size_t iBytes = 0) const { return Timer(this, iStep, iBytes); }
+
+    struct Totals {
+      unsigned long long calls_ = 0;
+      std::chrono::microseconds time_ = std::chrono::microseconds::zero();
+      unsigned long long bytes_ = 0;
+    };
+    Totals totals(Step) const;
+
+    void printSummary() const;
+
+  private:
+    struct Counters {
+      unsigned long long calls_[kNSteps] = {};
+      std::chrono::steady_clock::duration time_[kNSteps] = {};
+      unsigned long long bytes_[kNSteps] = {};
+    };
+    void add(Step iStep, std::chrono::steady_clock::duration iTime, std::size_t iBytes) const {
+      auto& c = counters_.local();
+      ++c.calls_[iStep];
+      c.time_[iStep] += iTime;
+      c.bytes_[iStep] += iBytes;
+    }
 
+    bool enabled_;
+    mutable tbb::enumerable_thread_specific<Counters> counters_;
+  };
+}
 #endif
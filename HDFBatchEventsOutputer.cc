@@ -2,14 +2,27 @@
 #include "OutputerFactory.h"
 #include "ConfigurationParameters.h"
 #include "UnrolledSerializerWrapper.h"
+#include "FixedLayoutSerializerWrapper.h"
 #include "SerializerWrapper.h"
 #include "summarize_serializers.h"
+#include "summarize_queue.h"
+#include "summarize_batches.h"
+#include "MemoryUsage.h"
 #include "FunctorTask.h"
 #include <memory>
 #include <iostream>
 #include <cstring>
 #include <cmath>
 #include <set>
+#include <thread>
+#include <algorithm>
+#include <hdf5_hl.h>
+
+//collective writes need both MPI and an HDF5 library built with MPI-IO support
+#if defined(TF_ENABLE_MPI) && defined(H5_HAVE_PARALLEL)
+#define TF_HDF5_COLLECTIVE
+#include <mpi.h>
+#endif
 
 using namespace cce::tf;
 using namespace cce::tf::pds;
@@ -18,12 +31,17 @@ namespace {
   constexpr const char* const PRODUCTS_DSNAME="Products";
   constexpr const char* const EVENTS_DSNAME="EventIDs";
   constexpr const char* const OFFSETS_DSNAME="Offsets";
+  //per batch, the number of its events followed by the number of its bytes in the Products dataset
+  constexpr const char* const BATCHES_DSNAME="BatchSizes";
   constexpr const char* const GNAME="Lumi";
   constexpr const char* const RUN_ANAME="run";
   constexpr const char* const LUMISEC_ANAME="lumisec";
   constexpr const char* const COMPRESSION_ANAME="Compression";
   constexpr const char* const COMPRESSION_LEVEL_ANAME="CompressionLevel";
   constexpr const char* const COMPRESSION_CHOICE_ANAME="CompressionChoice";
+  constexpr const char* const SERIALIZATION_ANAME="Serialization";
+  //the data product names, in the order of their offsets, separated by new lines
+  constexpr const char* const PRODUCT_NAMES_ANAME="ProductNames";
   template <typename T> 
   void 
   write_ds(hid_t gid, 
@@ -47,29 +65,189 @@ namespace {
     auto mem_space = hdf5::Dataspace::create_simple(ndims, slab_size, max_dims);
     dset.write<T>(mem_space, new_fspace, data); //H5Dwrite
   }
+
+  //"out.h5" becomes "out_<index>.h5"
+  std::string shardFileName(std::string const& iFileName, unsigned int iIndex) {
+    auto const dot = iFileName.find_last_of('.');
+    auto const slash = iFileName.find_last_of('/');
+    if(dot == std::string::npos or (slash != std::string::npos and dot < slash)) {
+      return iFileName+"_"+std::to_string(iIndex);
+    }
+    return iFileName.substr(0,dot)+"_"+std::to_string(iIndex)+iFileName.substr(dot);
+  }
+
+  hsize_t datasetLength(hid_t iGroup, const char* iName) {
+    auto dset = hdf5::Dataset::open(iGroup, iName);
+    auto space = hdf5::Dataspace::get_space(dset);
+    hsize_t dims[1];
+    H5Sget_simple_extent_dims(space, dims, nullptr);
+    return dims[0];
+  }
+
+  //the source files are given without their directory so they are found next to the virtual file
+  template<typename T>
+  void createVirtualDataset(hid_t iGroup, const char* iName, std::vector<std::string> const& iFiles, std::vector<hsize_t> const& iLengths) {
+    constexpr hsize_t ndims = 1;
+    hsize_t dims[ndims] = {0};
+    for(auto l: iLengths) {
+      dims[0] += l;
+    }
+    auto space = hdf5::Dataspace::create_simple(ndims, dims, dims);
+    auto prop = hdf5::Property::create();
+    std::string const sourceName = std::string("/")+GNAME+"/"+iName;
+    hsize_t start[ndims] = {0};
+    for(std::size_t i=0; i< iFiles.size(); ++i) {
+      if(iLengths[i] == 0) {
+        continue;
+      }
+      hsize_t count[ndims] = {iLengths[i]};
+      space.select_hyperslab(start, count);
+      auto sourceSpace = hdf5::Dataspace::create_simple(ndims, count, count);
+      auto const slash = iFiles[i].find_last_of('/');
+      auto const file = slash == std::string::npos ? iFiles[i] : iFiles[i].substr(slash+1);
+      if(H5Pset_virtual(prop, space, file.c_str(), sourceName.c_str(), sourceSpace) < 0) {
+        throw std::runtime_error("Unable to map "+iFiles[i]+" into the virtual dataset "+iName+"\n");
+      }
+      start[0] += iLengths[i];
+    }
+    H5Sselect_all(space);
+    hdf5::Dataset::create<T>(iGroup, iName, space, prop);
+  }
+
+#if defined(TF_HDF5_COLLECTIVE)
+  //keeps each rank's part of one H5Dwrite below the 2GB limit of an MPI count
+  constexpr hsize_t kMaxCollectiveWriteBytes = hsize_t(1) << 30;
+
+  //Appends the data of all ranks to the dataset, the data of rank i following that of ranks 0 to i-1.
+  // Must be called by all ranks. Returns the number of elements written by all ranks.
+  template<typename T>
+  unsigned long long writeCollectiveDataset(hid_t iGroup, const char* iName, std::vector<T> const& iData, hid_t iTransfer) {
+    constexpr hsize_t ndims = 1;
+    unsigned long long const length = iData.size();
+    unsigned long long offset = 0;
+    MPI_Exscan(&length, &offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if(rank == 0) {
+      //MPI_Exscan leaves the value on rank 0 undefined
+      offset = 0;
+    }
+    unsigned long long total = 0;
+    MPI_Allreduce(&length, &total, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+    hsize_t const perWrite = std::max<hsize_t>(1, kMaxCollectiveWriteBytes/sizeof(T));
+    unsigned long long nWrites = (length+perWrite-1)/perWrite;
+    MPI_Allreduce(MPI_IN_PLACE, &nWrites, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, MPI_COMM_WORLD);
+
+    auto dset = hdf5::Dataset::open(iGroup, iName);
+    auto oldSpace = hdf5::Dataspace::get_space(dset);
+    hsize_t start[ndims];
+    H5Sget_simple_extent_dims(oldSpace, start, nullptr);
+    hsize_t newDims[ndims] = {start[0]+total};
+    dset.set_extent(newDims);
+    start[0] += offset;
+    auto fileSpace = hdf5::Dataspace::get_space(dset);
+    //a rank with nothing left to write still takes part in the write
+    T const empty{};
+    for(unsigned long long i = 0; i < nWrites; ++i) {
+      hsize_t const begin = std::min<hsize_t>(length, i*perWrite);
+      hsize_t count[ndims] = {std::min<hsize_t>(length-begin, perWrite)};
+      auto memSpace = hdf5::Dataspace::create_simple(ndims, count, count);
+      if(count[0] == 0) {
+        fileSpace.select_none();
+        memSpace.select_none();
+        dset.write<T>(memSpace, fileSpace, &empty, iTransfer);
+        continue;
+      }
+      hsize_t slabStart[ndims] = {start[0]+begin};
+      fileSpace.select_hyperslab(slabStart, count);
+      dset.write<T>(memSpace, fileSpace, iData.data()+begin, iTransfer);
+    }
+    return total;
+  }
+#endif
+}
+
+HDFBatchEventsOutputer::Shard::Shard(std::string const& iFileName, bool iMultiDatasetWrite, hid_t iFileAccess, std::size_t iPreallocateBytes):
+  file_(hdf5::File::create(iFileName.c_str(), iFileAccess)),
+  group_(hdf5::Group::create(file_, GNAME)) {
+  if(iMultiDatasetWrite) {
+    multiWriter_.emplace();
+  }
+  if(iPreallocateBytes != 0) {
+    preallocator_ = std::make_unique<FilePreallocator>(iFileName, iPreallocateBytes);
+  }
 }
 
-HDFBatchEventsOutputer::HDFBatchEventsOutputer(std::string const& iFileName, unsigned int iNLanes, int iChunkSize, pds::Compression iCompression, int iCompressionLevel, CompressionChoice iChoice, pds::Serialization iSerialization, uint32_t iBatchSize) : 
-  file_(hdf5::File::create(iFileName.c_str())),
-  group_(hdf5::Group::create(file_, GNAME)),
+HDFBatchEventsOutputer::HDFBatchEventsOutputer(std::string const& iFileName, unsigned int iNLanes, int iChunkSize, pds::Compression iCompression, int iCompressionLevel, CompressionChoice iChoice, pds::Serialization iSerialization, uint32_t iBatchSize, std::size_t iBatchBytes, bool iMultiDatasetWrite, unsigned int iNShards, bool iDirectChunkWrite, bool iCollective,
+                                               bool iSWMR, std::chrono::milliseconds iSWMRFlushInterval,
+                                               std::size_t iPreallocateBytes, std::size_t iWriteAlignment) : 
+  fileName_(iFileName),
+  nextShard_{0},
   chunkSize_{iChunkSize},
   serializers_{std::size_t(iNLanes)},
-  eventBatches_{iNLanes},
-  waitingEventsInBatch_(iNLanes),
+  compressionContexts_{std::size_t(iNLanes)},
   presentEventEntry_(0),
   batchSize_(iBatchSize),
   compression_{iCompression},
   compressionLevel_{iCompressionLevel},
   compressionChoice_{iChoice},
   serialization_{iSerialization},
+  directChunkWrite_{iDirectChunkWrite},
+  collective_{iCollective},
   serialTime_{std::chrono::microseconds::zero()},
-  parallelTime_{0}
+  parallelTime_{iNLanes}
   {
-    for(auto& v: waitingEventsInBatch_) {
-      v.store(0);
+    if(collective_) {
+#if defined(TF_HDF5_COLLECTIVE)
+      int initialized = 0;
+      MPI_Initialized(&initialized);
+      if(not initialized) {
+        throw std::runtime_error("HDFBatchEventsOutputer collective writes require the job to be run with --mpi");
+      }
+      //all ranks open the same file
+      auto access = hdf5::Property::create_file_access();
+      if(H5Pset_fapl_mpio(access, MPI_COMM_WORLD, MPI_INFO_NULL) < 0) {
+        throw std::runtime_error("Unable to use the MPI-IO driver for "+iFileName);
+      }
+      shards_.push_back(std::make_unique<Shard>(iFileName, false, access));
+#else
+      throw std::runtime_error("HDFBatchEventsOutputer collective writes require building with -DENABLE_MPI=ON and an HDF5 library built with MPI support");
+#endif
+    } else {
+      auto access = hdf5::Property::create_file_access();
+      if(iSWMR) {
+        access.set_latest_format();
+      }
+      if(iWriteAlignment != 0) {
+        //the chunks of the datasets are large so each is written starting at an aligned offset
+        access.set_alignment(iWriteAlignment, iWriteAlignment);
+      }
+      if(iNShards == 1) {
+        shards_.push_back(std::make_unique<Shard>(iFileName, iMultiDatasetWrite, access, iPreallocateBytes));
+      } else {
+        shards_.reserve(iNShards);
+        for(unsigned int i=0; i<iNShards; ++i) {
+          shards_.push_back(std::make_unique<Shard>(shardFileName(iFileName, i), iMultiDatasetWrite, access, iPreallocateBytes));
+        }
+      }
+      if(iSWMR) {
+        for(auto& shard: shards_) {
+          shard->swmrFlusher_.emplace(iSWMRFlushInterval);
+        }
+      }
     }
-    for(auto& v:eventBatches_) {
-      v.store(nullptr);
+    hbool_t threadSafe = false;
+    H5is_library_threadsafe(&threadSafe);
+    hdf5ThreadSafe_ = threadSafe;
+    if(iBatchBytes != 0) {
+      sizeBatcher_.emplace(iBatchBytes, batchSize_);
+    } else {
+      //twice the number of lanes lets a full batch be compressed while the next ones fill
+      batchSlots_.reserve(2*iNLanes);
+      for(unsigned int i=0; i<2*iNLanes; ++i) {
+        batchSlots_.push_back(std::make_unique<BatchSlot>(batchSize_, i));
+      }
     }
     
   }
@@ -82,6 +260,10 @@ void HDFBatchEventsOutputer::setupForLane(unsigned int iLaneIndex, std::vector<D
     {   s = SerializeStrategy::make<SerializeProxy<SerializerWrapper>>(); break; }
   case pds::Serialization::kRootUnrolled:
     {   s = SerializeStrategy::make<SerializeProxy<UnrolledSerializerWrapper>>(); break; }
+  case pds::Serialization::kNativeUnrolled:
+    {   s = SerializeStrategy::make<SerializeProxy<NativeUnrolledSerializerWrapper>>(); break; }
+  case pds::Serialization::kFixedLayout:
+    {   s = SerializeStrategy::make<SerializeProxy<FixedLayoutSerializerWrapper>>(); break; }
   }
   s.reserve(iDPs.size());
   for(auto const& dp: iDPs) {
@@ -98,37 +280,43 @@ void HDFBatchEventsOutputer::productReadyAsync(unsigned int iLaneIndex, DataProd
   laneSerializers[iDataProduct.index()].doWorkAsync(*group, iDataProduct.address(), std::move(iCallback));
 }
 
-void HDFBatchEventsOutputer::outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+void HDFBatchEventsOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
   auto start = std::chrono::high_resolution_clock::now();
-  auto [offsets, buffer] = writeDataProductsToOutputBuffer(serializers_[iLaneIndex]);
-
-  auto eventIndex = presentEventEntry_++;
-  auto batchIndex = (eventIndex/batchSize_) % eventBatches_.size();
-
+  auto [offsets, buffer] = writeDataProductsToOutputBuffer(serializers_[iLaneIndex], compressionContexts_[iLaneIndex]);
 
-  auto& batchContainerPtr = eventBatches_[batchIndex];
-  auto batchContainer = batchContainerPtr.load();
-  if( nullptr == batchContainer ) {
-    auto newContainer = std::make_unique<std::vector<EventInfo>>(batchSize_);
-    if(batchContainerPtr.compare_exchange_strong(batchContainer, newContainer.get())) {
-      newContainer.release();
-      batchContainer = batchContainerPtr.load();
+  if(sizeBatcher_) {
+    auto const bytes = buffer.size();
+    auto batch = sizeBatcher_->add({iEventID, std::move(offsets), std::move(buffer)}, bytes);
+    if(not batch.empty()) {
+      const_cast<HDFBatchEventsOutputer*>(this)->writeBatchAsync(collectBatch(batch.data(), batch.data()+batch.size()), compressionContexts_[iLaneIndex], std::move(iCallback));
     }
+    auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+    parallelTime_.add(iLaneIndex, time.count());
+    return;
   }
 
-  auto indexInBatch = eventIndex % (batchSize_);
-  //std::cout <<"indexInBatch "<<indexInBatch<<std::endl;
-  (*batchContainer)[indexInBatch] = std::make_tuple(iEventID, std::move(offsets), std::move(buffer));
+  auto eventIndex = presentEventEntry_++;
+  auto const batchNumber = eventIndex/batchSize_;
+  auto const slotIndex = batchNumber % batchSlots_.size();
+  auto& slot = *batchSlots_[slotIndex];
+  while(slot.batchNumber_.load() != batchNumber) {
+    //an earlier batch is still being taken out of the slot
+    std::this_thread::yield();
+  }
 
-  assert(waitingEventsInBatch_[batchIndex].load() < batchSize_);
+  auto indexInBatch = eventIndex % (batchSize_);
+  auto& event = slot.events_[indexInBatch];
+  std::get<0>(event) = iEventID;
+  std::get<1>(event) = std::move(offsets);
+  std::get<2>(event) = std::move(buffer);
 
-  auto waitingEvents = ++waitingEventsInBatch_[batchIndex];
+  assert(slot.nFilled_.load() < batchSize_);
 
-  if(waitingEvents == batchSize_ ) {
-    const_cast<HDFBatchEventsOutputer*>(this)->finishBatchAsync(batchIndex, std::move(iCallback));
+  if(++slot.nFilled_ == batchSize_ ) {
+    const_cast<HDFBatchEventsOutputer*>(this)->finishBatchAsync(slotIndex, compressionContexts_[iLaneIndex], std::move(iCallback));
   }
   auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
-  parallelTime_ += time.count();
+  parallelTime_.add(iLaneIndex, time.count());
 }
 
 void HDFBatchEventsOutputer::printSummary() const  {
@@ -140,71 +328,176 @@ void HDFBatchEventsOutputer::printSummary() const  {
     
     {
       TaskHolder th(group, make_functor_task([](){}));
-      for( int index=0; index < waitingEventsInBatch_.size();++index) {
-        if(0 != waitingEventsInBatch_[index].load()) {
-          const_cast<HDFBatchEventsOutputer*>(this)->finishBatchAsync(index, th);
+      for( int index=0; index < batchSlots_.size();++index) {
+        if(0 != batchSlots_[index]->nFilled_.load()) {
+          //all lanes are done so their contexts are free to use
+          const_cast<HDFBatchEventsOutputer*>(this)->finishBatchAsync(index, compressionContexts_[0], th);
+        }
+      }
+      if(sizeBatcher_) {
+        auto batch = sizeBatcher_->takeRemaining();
+        if(not batch.empty()) {
+          const_cast<HDFBatchEventsOutputer*>(this)->writeBatchAsync(collectBatch(batch.data(), batch.data()+batch.size()), compressionContexts_[0], th);
         }
       }
     }
     
     group.wait();
   }
+  if(directChunkWrite_) {
+    for(auto& shard: shards_) {
+      flushChunkTail(*shard);
+    }
+  }
+  for(auto& shard: shards_) {
+    if(shard->swmrFlusher_) {
+      //readers see the last batches without waiting for the file to be closed
+      shard->swmrFlusher_->flush(shard->file_);
+    }
+  }
+  if(shards_.size() > 1) {
+    writeVirtualFile();
+  }
+  if(collective_) {
+    writeCollective(*shards_[0]);
+  }
+  for(auto& shard: shards_) {
+    if(shard->preallocator_) {
+      //only the little HDF5 writes when closing the file is left, the blocks not used can be freed now
+      H5Fflush(shard->file_, H5F_SCOPE_LOCAL);
+      shard->preallocator_->finish();
+    }
+  }
   auto writeTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
 
   std::cout <<"HDFBatchEventsOutputer\n  total serial time at end event: "<<serialTime_.count()<<"us\n"
-    "  total parallel time at end event: "<<parallelTime_.load()<<"us\n";
+    "  total parallel time at end event: "<<parallelTime_.sum()<<"us\n";
   std::cout << "  end of job file write time: "<<writeTime.count()<<"us\n";
+  if(sizeBatcher_) {
+    summarize_batches(*sizeBatcher_);
+  }
+  if(shards_.size() > 1) {
+    std::cout <<"  batches per shard:";
+    for(auto const& shard: shards_) {
+      std::cout <<" "<<shard->nBatches_;
+    }
+    std::cout <<(hdf5ThreadSafe_ ? "" : " (HDF5 calls serialized, library is not thread safe)")<<"\n";
+  }
+  if(directChunkWrite_) {
+    unsigned long long nChunks = 0;
+    for(auto const& shard: shards_) {
+      nChunks += shard->nChunksWritten_;
+    }
+    std::cout <<"  direct chunk writes: "<<nChunks<<"\n";
+  }
+  if(collective_) {
+    std::cout <<"  collective write of "<<nCollectiveEvents_<<" events from all ranks: "<<collectiveWriteTime_.count()<<"us\n";
+  }
+  if(shards_[0]->swmrFlusher_) {
+    unsigned long long nFlushes = 0;
+    for(auto const& shard: shards_) {
+      nFlushes += shard->swmrFlusher_->nFlushes();
+    }
+    std::cout <<"  SWMR flushes: "<<nFlushes<<"\n";
+  }
+  for(auto const& shard: shards_) {
+    if(shard->multiWriter_) {
+      std::cout <<"  multi-dataset flushes: "<<shard->multiWriter_->nFlushes()<<" write calls: "<<shard->multiWriter_->nWriteCalls()<<"\n";
+    }
+  }
 
+  for(auto const& shard: shards_) {
+    if(shard->preallocator_) {
+      summarize_preallocation(*shard->preallocator_);
+    }
+  }
+  std::cout <<"  largest batch buffer: "<<maxBatchBytes_.load()<<" bytes\n";
+  for(std::size_t i = 0; i < shards_.size(); ++i) {
+    summarize_queue(shards_.size() == 1 ? std::string("write") : "write "+std::to_string(i), shards_[i]->queue_);
+  }
   summarize_serializers(serializers_);
 }
 
-void HDFBatchEventsOutputer::finishBatchAsync(unsigned int iBatchIndex, TaskHolder iCallback) {
+void HDFBatchEventsOutputer::fillProfile(ProductProfile& oProfile) const {
+  profile_serializers(oProfile, serializers_);
+}
+
+void HDFBatchEventsOutputer::fillReport(RunReport& oReport) const {
+  oReport.set("maxBatchBytes", maxBatchBytes_.load());
+  if(collective_) {
+    oReport.set("collectiveEvents", nCollectiveEvents_);
+    oReport.set("collectiveWriteTime_us", collectiveWriteTime_.count());
+  }
+  for(std::size_t i = 0; i < shards_.size(); ++i) {
+    if(shards_[i]->preallocator_) {
+      report_preallocation(shards_.size() == 1 ? oReport : oReport.section("shard"+std::to_string(i)), *shards_[i]->preallocator_);
+    }
+  }
+  report_serializers(oReport, serializers_);
+  for(std::size_t i = 0; i < shards_.size(); ++i) {
+    report_queue(oReport, shards_.size() == 1 ? std::string("write") : "write "+std::to_string(i), shards_[i]->queue_);
+  }
+}
+
+void HDFBatchEventsOutputer::finishBatchAsync(unsigned int iSlotIndex, pds::CompressionContext& iContext, TaskHolder iCallback) {
+  auto& slot = *batchSlots_[iSlotIndex];
+  //batch can be smaller than usual at end of job
+  auto eventsInBatch = slot.nFilled_.load();
+  auto batch = collectBatch(slot.events_.data(), slot.events_.data()+eventsInBatch);
 
-  std::unique_ptr<std::vector<EventInfo>> batch(eventBatches_[iBatchIndex].exchange(nullptr));
-  auto eventsInBatch = waitingEventsInBatch_[iBatchIndex].load();
-  waitingEventsInBatch_[iBatchIndex] = 0;
+  //the slot can now be used by the next batch assigned to it
+  slot.nFilled_ = 0;
+  slot.batchNumber_ += batchSlots_.size();
+
+  writeBatchAsync(std::move(batch), iContext, std::move(iCallback));
+}
 
-  std::vector<EventIdentifier> batchEventIDs;
-  batchEventIDs.reserve(batch->size());
+HDFBatchEventsOutputer::CollectedBatch HDFBatchEventsOutputer::collectBatch(EventInfo* iBegin, EventInfo* iEnd) const {
+  CollectedBatch batch;
+  batch.eventIDs_.reserve(iEnd-iBegin);
 
-  std::vector<uint32_t> batchOffsets;
-  batchOffsets.reserve(batch->size() * (serializers_.size()+2));
+  batch.offsets_.reserve((iEnd-iBegin) * (serializers_.size()+2));
   //one extra size to but the final blob size. This is either the
   // compressed size or the uncompressed size depending on the compression choice
 
-  std::vector<char> batchBlob;
+  for(auto event = iBegin; event != iEnd; ++event) {
+    auto& [id, offsets, blob] = *event;
+    batch.eventIDs_.push_back(id);
 
-  int index = 0;
-  for(auto& [id, offsets, blob]: *batch) {
-    if(index++ == eventsInBatch) {
-      //batch was smaller than usual. Can happen at end of job
-      break;
-    }
-    batchEventIDs.push_back(id);
-
-    std::copy(offsets.begin(), offsets.end(), std::back_inserter(batchOffsets));
+    std::copy(offsets.begin(), offsets.end(), std::back_inserter(batch.offsets_));
 
     //record the size of the blob as the final offset. Needed to decompress
     // the event during reading
-    batchOffsets.push_back(blob.size());
-    std::copy(blob.begin(), blob.end(), std::back_inserter(batchBlob));
+    batch.offsets_.push_back(blob.size());
+    std::copy(blob.begin(), blob.end(), std::back_inserter(batch.blob_));
 
     //release memory
     blob = {};
   }
+  recordMax(maxBatchBytes_, batch.blob_.size());
+  return batch;
+}
 
+void HDFBatchEventsOutputer::writeBatchAsync(CollectedBatch iBatch, pds::CompressionContext& iContext, TaskHolder iCallback) {
   std::vector<char> bufferToWrite;
   if(compressionChoice_ == CompressionChoice::kBatch or compressionChoice_ == CompressionChoice::kBoth) {
-    bufferToWrite  = pds::compressBuffer(0,0, compression_, compressionLevel_, batchBlob);
-    batchBlob = std::vector<char>();
+    bufferToWrite  = pds::compressBuffer(0,0, compression_, compressionLevel_, iBatch.blob_, iContext);
+    iBatch.blob_ = std::vector<char>();
   } else {
-    bufferToWrite = std::move(batchBlob);
+    bufferToWrite = std::move(iBatch.blob_);
   }
 
   
-  queue_.push(*iCallback.group(), [this, eventIDs=std::move(batchEventIDs), offsets = std::move(batchOffsets), buffer = std::move(bufferToWrite),  callback=std::move(iCallback)]() mutable {
+  auto& shard = *shards_[nextShard_++ % shards_.size()];
+  shard.queue_.push(*iCallback.group(), [this, &shard, eventIDs=std::move(iBatch.eventIDs_), offsets = std::move(iBatch.offsets_), buffer = std::move(bufferToWrite),  callback=std::move(iCallback)]() mutable {
       auto start = std::chrono::high_resolution_clock::now();
-      const_cast<HDFBatchEventsOutputer*>(this)->output(std::move(eventIDs), std::move(buffer), std::move(offsets));
+      {
+        std::unique_lock<std::mutex> lock(hdf5Mutex_, std::defer_lock);
+        if(shards_.size() > 1 and not hdf5ThreadSafe_) {
+          lock.lock();
+        }
+        const_cast<HDFBatchEventsOutputer*>(this)->output(shard, std::move(eventIDs), std::move(buffer), std::move(offsets));
+      }
         serialTime_ += std::chrono::duration_cast<decltype(serialTime_)>(std::chrono::high_resolution_clock::now() - start);
       callback.doneWaiting();
     });
@@ -212,31 +505,124 @@ void HDFBatchEventsOutputer::finishBatchAsync(unsigned int iBatchIndex, TaskHold
 }
 
 void 
-HDFBatchEventsOutputer::output(std::vector<EventIdentifier> iEventIDs, 
+HDFBatchEventsOutputer::output(Shard& iShard,
+                         std::vector<EventIdentifier> iEventIDs, 
                          std::vector<char> iBuffer,
                          std::vector<uint32_t> iOffsets ) {
-  if (firstEvent_) {
+  auto& group = iShard.group_;
+  auto& multiWriter = iShard.multiWriter_;
+  ++iShard.nBatches_;
+  if(collective_) {
+    //written together with the other ranks at the end of the job, as are the attributes
+    if(not iShard.firstEventID_) {
+      iShard.firstEventID_ = iEventIDs[0];
+    }
+    for(auto const& id: iEventIDs) {
+      iShard.collectedIDs_.push_back(id.event);
+    }
+    iShard.collectedBatchSizes_.push_back(iEventIDs.size());
+    iShard.collectedBatchSizes_.push_back(iBuffer.size());
+    iShard.collectedProducts_.insert(iShard.collectedProducts_.end(), iBuffer.begin(), iBuffer.end());
+    iShard.collectedOffsets_.insert(iShard.collectedOffsets_.end(), iOffsets.begin(), iOffsets.end());
+    return;
+  }
+  if (not iShard.firstEventID_) {
     assert(not iEventIDs.empty());
-    firstEvent_ = false;
-    auto r = hdf5::Attribute::open(group_, RUN_ANAME);
-    r.write(iEventIDs[0].run);  
-    auto sr = hdf5::Attribute::open(group_, LUMISEC_ANAME);
-    sr.write(iEventIDs[0].lumi); 
-    auto comp = hdf5::Attribute::open(group_, COMPRESSION_ANAME);
-    comp.write(std::string(name(compression_)));
-    auto level = hdf5::Attribute::open(group_, COMPRESSION_LEVEL_ANAME);
-    level.write(compressionLevel_); 
-    auto choice = hdf5::Attribute::open(group_, COMPRESSION_CHOICE_ANAME);
-    choice.write(static_cast<int>(compressionChoice_)); 
+    iShard.firstEventID_ = iEventIDs[0];
+    writeAttributes(group, iEventIDs[0]);
+    if(iShard.swmrFlusher_) {
+      //the attributes are set so readers can now follow the file
+      iShard.file_.start_swmr_write();
+    }
   }
   std::vector<unsigned long long> ids;
   ids.reserve(iEventIDs.size());
   std::transform(iEventIDs.begin(), iEventIDs.end(), std::back_inserter(ids), [](auto const&id) {return id.event;});
-  //std::cout <<" ids "<<ids.size()<<std::endl;
-  write_ds<unsigned long long>(group_, EVENTS_DSNAME, ids);
-  //std::cout <<"wrote ids"<<std::endl;
-  write_ds<char>(group_, PRODUCTS_DSNAME, iBuffer);
-  write_ds<uint32_t>(group_, OFFSETS_DSNAME, iOffsets); 
+  std::vector<unsigned long long> const batchSizes = {ids.size(), iBuffer.size()};
+  if(directChunkWrite_) {
+    writeProductChunks(iShard, iBuffer);
+  }
+  if(multiWriter) {
+    multiWriter->append(group, EVENTS_DSNAME, ids);
+    if(not directChunkWrite_) {
+      multiWriter->append(group, PRODUCTS_DSNAME, iBuffer);
+    }
+    multiWriter->append(group, OFFSETS_DSNAME, iOffsets);
+    multiWriter->append(group, BATCHES_DSNAME, batchSizes);
+    multiWriter->flush();
+  } else {
+    //the events are written last so a reader of the file being written does not see an event before its data products
+    if(not directChunkWrite_) {
+      write_ds<char>(group, PRODUCTS_DSNAME, iBuffer);
+    }
+    write_ds<uint32_t>(group, OFFSETS_DSNAME, iOffsets); 
+    write_ds<unsigned long long>(group, BATCHES_DSNAME, batchSizes);
+    write_ds<unsigned long long>(group, EVENTS_DSNAME, ids);
+  }
+  if(iShard.swmrFlusher_) {
+    iShard.swmrFlusher_->flushIfDue(iShard.file_);
+  }
+  if(iShard.preallocator_) {
+    iShard.preallocator_->written();
+  }
+}
+
+void
+HDFBatchEventsOutputer::writeProductChunks(Shard& iShard, std::vector<char> const& iBuffer) const {
+  if(not iShard.products_) {
+    iShard.products_.emplace(hdf5::Dataset::open(iShard.group_, PRODUCTS_DSNAME));
+  }
+  iShard.productsLength_ += iBuffer.size();
+  iShard.products_->set_extent(&iShard.productsLength_);
+
+  std::size_t const chunkSize = chunkSize_;
+  auto& tail = iShard.chunkTail_;
+  char const* data = iBuffer.data();
+  std::size_t left = iBuffer.size();
+  if(not tail.empty()) {
+    auto const n = std::min(chunkSize-tail.size(), left);
+    tail.insert(tail.end(), data, data+n);
+    data += n;
+    left -= n;
+    if(tail.size() < chunkSize) {
+      return;
+    }
+    writeChunk(iShard, tail.data());
+    tail.clear();
+  }
+  //full chunks are written straight from the batch's buffer
+  while(left >= chunkSize) {
+    writeChunk(iShard, data);
+    data += chunkSize;
+    left -= chunkSize;
+  }
+  tail.insert(tail.end(), data, data+left);
+}
+
+void
+HDFBatchEventsOutputer::writeChunk(Shard& iShard, char const* iData) const {
+  hsize_t offset[1] = {iShard.nChunksWritten_*chunkSize_};
+  //the Products dataset has no filters so the filter mask is 0
+#if H5_VERSION_GE(1,10,3)
+  auto err = H5Dwrite_chunk(*iShard.products_, H5P_DEFAULT, 0, offset, chunkSize_, iData);
+#else
+  auto err = H5DOwrite_chunk(*iShard.products_, H5P_DEFAULT, 0, offset, chunkSize_, iData);
+#endif
+  if(err < 0) {
+    throw std::runtime_error("Unable to write a chunk of the Products dataset\n");
+  }
+  ++iShard.nChunksWritten_;
+}
+
+void
+HDFBatchEventsOutputer::flushChunkTail(Shard& iShard) const {
+  if(iShard.chunkTail_.empty()) {
+    return;
+  }
+  //the edge chunk is stored full size, the extent hides the padding
+  iShard.chunkTail_.resize(chunkSize_, 0);
+  writeChunk(iShard, iShard.chunkTail_.data());
+  iShard.chunkTail_ = std::vector<char>();
 }
 
 void 
@@ -248,29 +634,126 @@ HDFBatchEventsOutputer::writeFileHeader(SerializeStrategy const& iSerializers) {
   auto space = hdf5::Dataspace::create_simple (ndims, dims, max_dims); 
   auto prop   = hdf5::Property::create();
   prop.set_chunk(ndims, chunk_dims);
-  hdf5::Dataset::create<int>(group_, EVENTS_DSNAME, space, prop);
-  hdf5::Dataset::create<char>(group_, PRODUCTS_DSNAME, space, prop);
-  hdf5::Dataset::create<int>(group_, OFFSETS_DSNAME, space, prop);
+  //only two entries per batch so a smaller chunk is used
+  hsize_t batches_chunk_dims[ndims] = {1024};
+  auto batches_prop = hdf5::Property::create();
+  batches_prop.set_chunk(ndims, batches_chunk_dims);
+  for(auto& shard: shards_) {
+    hdf5::Dataset::create<int>(shard->group_, EVENTS_DSNAME, space, prop);
+    hdf5::Dataset::create<char>(shard->group_, PRODUCTS_DSNAME, space, prop);
+    hdf5::Dataset::create<int>(shard->group_, OFFSETS_DSNAME, space, prop);
+    hdf5::Dataset::create<unsigned long long>(shard->group_, BATCHES_DSNAME, space, batches_prop);
+    createAttributes(shard->group_, iSerializers);
+  }
+}
 
+void
+HDFBatchEventsOutputer::createAttributes(hid_t iGroup, SerializeStrategy const& iSerializers) const {
+  constexpr hsize_t ndims = 1;
   const auto scalar_space  = hdf5::Dataspace::create_scalar();
-  hdf5::Attribute::create<int>(group_, RUN_ANAME, scalar_space);
-  hdf5::Attribute::create<int>(group_, LUMISEC_ANAME, scalar_space);
-  hdf5::Attribute::create<int>(group_, COMPRESSION_LEVEL_ANAME, scalar_space);
-  hdf5::Attribute::create<int>(group_, COMPRESSION_CHOICE_ANAME, scalar_space);
+  hdf5::Attribute::create<int>(iGroup, RUN_ANAME, scalar_space);
+  hdf5::Attribute::create<int>(iGroup, LUMISEC_ANAME, scalar_space);
+  hdf5::Attribute::create<int>(iGroup, COMPRESSION_LEVEL_ANAME, scalar_space);
+  hdf5::Attribute::create<int>(iGroup, COMPRESSION_CHOICE_ANAME, scalar_space);
+  hdf5::Attribute::create<int>(iGroup, SERIALIZATION_ANAME, scalar_space);
   constexpr hsize_t     str_dims[ndims] = {10};
   auto const attr_type = H5Tcopy (H5T_C_S1);
   H5Tset_size(attr_type, H5T_VARIABLE);
   auto const attr_space  = H5Screate(H5S_SCALAR);
-  hdf5::Attribute compression = hdf5::Attribute::create<std::string>(group_,COMPRESSION_ANAME, attr_space); 
+  hdf5::Attribute compression = hdf5::Attribute::create<std::string>(iGroup,COMPRESSION_ANAME, attr_space); 
+  std::string names;
   for(auto const& s: iSerializers) {
     std::string const type(s.className());
     std::string const name(s.name());
-    hdf5::Attribute prod_name = hdf5::Attribute::create<std::string>(group_, name.c_str(), attr_space); 
+    hdf5::Attribute prod_name = hdf5::Attribute::create<std::string>(iGroup, name.c_str(), attr_space); 
     prod_name.write<std::string>(type);
+    names += name + "\n";
+  }
+  //the attributes of the data products are not kept in the order they were made
+  hdf5::Attribute::create<std::string>(iGroup, PRODUCT_NAMES_ANAME, attr_space).write<std::string>(names);
+}
+
+void
+HDFBatchEventsOutputer::writeAttributes(hid_t iGroup, EventIdentifier const& iFirstEventID) const {
+  auto r = hdf5::Attribute::open(iGroup, RUN_ANAME);
+  r.write(iFirstEventID.run);  
+  auto sr = hdf5::Attribute::open(iGroup, LUMISEC_ANAME);
+  sr.write(iFirstEventID.lumi); 
+  auto comp = hdf5::Attribute::open(iGroup, COMPRESSION_ANAME);
+  comp.write(std::string(name(compression_)));
+  auto level = hdf5::Attribute::open(iGroup, COMPRESSION_LEVEL_ANAME);
+  level.write(compressionLevel_); 
+  auto choice = hdf5::Attribute::open(iGroup, COMPRESSION_CHOICE_ANAME);
+  choice.write(static_cast<int>(compressionChoice_)); 
+  auto serialization = hdf5::Attribute::open(iGroup, SERIALIZATION_ANAME);
+  serialization.write(static_cast<int>(serialization_));
+}
+
+void
+HDFBatchEventsOutputer::writeVirtualFile() const {
+  //the batches of each shard are complete so the datasets can simply be concatenated
+  std::vector<std::string> files;
+  std::vector<hsize_t> events, products, offsets, batches;
+  std::optional<EventIdentifier> firstEventID;
+  for(unsigned int i=0; i< shards_.size(); ++i) {
+    auto const& shard = *shards_[i];
+    //make sure all the data is in the files before they are referenced
+    H5Fflush(shard.file_, H5F_SCOPE_LOCAL);
+    files.push_back(shardFileName(fileName_, i));
+    events.push_back(datasetLength(shard.group_, EVENTS_DSNAME));
+    products.push_back(datasetLength(shard.group_, PRODUCTS_DSNAME));
+    offsets.push_back(datasetLength(shard.group_, OFFSETS_DSNAME));
+    batches.push_back(datasetLength(shard.group_, BATCHES_DSNAME));
+    if(not firstEventID) {
+      firstEventID = shard.firstEventID_;
+    }
+  }
+  auto file = hdf5::File::create(fileName_.c_str());
+  auto group = hdf5::Group::create(file, GNAME);
+  createVirtualDataset<int>(group, EVENTS_DSNAME, files, events);
+  createVirtualDataset<char>(group, PRODUCTS_DSNAME, files, products);
+  createVirtualDataset<int>(group, OFFSETS_DSNAME, files, offsets);
+  createVirtualDataset<unsigned long long>(group, BATCHES_DSNAME, files, batches);
+  createAttributes(group, serializers_[0]);
+  if(firstEventID) {
+    writeAttributes(group, *firstEventID);
+  }
+}
+
+void
+HDFBatchEventsOutputer::writeCollective(Shard& iShard) const {
+#if defined(TF_HDF5_COLLECTIVE)
+  auto start = std::chrono::high_resolution_clock::now();
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  //attribute writes are collective so all ranks use the first event of the lowest rank with events
+  int owner = iShard.firstEventID_ ? rank : size;
+  MPI_Allreduce(MPI_IN_PLACE, &owner, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+  if(owner != size) {
+    auto const id = iShard.firstEventID_.value_or(EventIdentifier{});
+    unsigned long long values[3] = {id.run, id.lumi, id.event};
+    MPI_Bcast(values, 3, MPI_UNSIGNED_LONG_LONG, owner, MPI_COMM_WORLD);
+    writeAttributes(iShard.group_, EventIdentifier{static_cast<unsigned int>(values[0]), static_cast<unsigned int>(values[1]), values[2]});
+  }
+
+  auto transfer = hdf5::Property::create_transfer();
+  if(H5Pset_dxpl_mpio(transfer, H5FD_MPIO_COLLECTIVE) < 0) {
+    throw std::runtime_error("Unable to ask for collective MPI-IO writes\n");
   }
+  nCollectiveEvents_ = writeCollectiveDataset(iShard.group_, EVENTS_DSNAME, iShard.collectedIDs_, transfer);
+  writeCollectiveDataset(iShard.group_, PRODUCTS_DSNAME, iShard.collectedProducts_, transfer);
+  writeCollectiveDataset(iShard.group_, OFFSETS_DSNAME, iShard.collectedOffsets_, transfer);
+  writeCollectiveDataset(iShard.group_, BATCHES_DSNAME, iShard.collectedBatchSizes_, transfer);
+  iShard.collectedIDs_ = std::vector<unsigned long long>();
+  iShard.collectedProducts_ = std::vector<char>();
+  iShard.collectedOffsets_ = std::vector<uint32_t>();
+  iShard.collectedBatchSizes_ = std::vector<unsigned long long>();
+  collectiveWriteTime_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+#endif
 }
 
-std::pair<std::vector<uint32_t>, std::vector<char>> HDFBatchEventsOutputer::writeDataProductsToOutputBuffer(SerializeStrategy const& iSerializers) const{
+std::pair<std::vector<uint32_t>, std::vector<char>> HDFBatchEventsOutputer::writeDataProductsToOutputBuffer(SerializeStrategy const& iSerializers, pds::CompressionContext& iContext) const{
   //Calculate buffer size needed
   uint32_t bufferSize = 0;
   std::vector<uint32_t> offsets;
@@ -295,7 +778,7 @@ std::pair<std::vector<uint32_t>, std::vector<char>> HDFBatchEventsOutputer::writ
   }
 
   if(compressionChoice_ == CompressionChoice::kEvents or compressionChoice_ == CompressionChoice::kBoth) {
-    auto cBuffer  = pds::compressBuffer(0,0, compression_, compressionLevel_, buffer);
+    auto cBuffer  = pds::compressBuffer(0,0, compression_, compressionLevel_, buffer, iContext);
 
     return {std::move(offsets), std::move(cBuffer)};
   }
@@ -342,9 +825,47 @@ namespace {
         return {};
       }
 
-      auto batchSize = params.get<int>("batchSize",1);
+      auto batchBytes = params.get<std::size_t>("batchBytes", 0);
+      //with batchBytes only an explicit batchSize limits the number of events
+      auto batchSize = params.get<int>("batchSize", batchBytes == 0 ? 1 : 0);
+      auto multiDatasetWrite = params.get<bool>("multiDatasetWrite", false);
+      auto shards = params.get<int>("shards", 1);
+      auto directChunkWrite = params.get<bool>("directChunkWrite", false);
+      auto collective = params.get<bool>("collective", false);
+      if(shards < 1) {
+        std::cout <<"shards for HDFBatchEventsOutputer must be at least 1"<<std::endl;
+        return {};
+      }
+      if(collective and (shards != 1 or directChunkWrite or multiDatasetWrite)) {
+        std::cout <<"collective for HDFBatchEventsOutputer can not be combined with shards, directChunkWrite or multiDatasetWrite"<<std::endl;
+        return {};
+      }
+      auto preallocateBytes = params.get<std::size_t>("preallocateBytes", 0);
+      auto writeAlignment = params.get<std::size_t>("writeAlignment", 0);
+      if(collective and (preallocateBytes != 0 or writeAlignment != 0)) {
+        //the MPI-IO driver decides how the ranks write the one file
+        std::cout <<"collective for HDFBatchEventsOutputer can not be combined with preallocateBytes or writeAlignment"<<std::endl;
+        return {};
+      }
+      auto swmr = params.get<bool>("swmr", false);
+      auto swmrFlushInterval = params.get<int>("swmrFlushInterval_ms", 1000);
+      if(swmrFlushInterval < 0) {
+        std::cout <<"swmrFlushInterval_ms for HDFBatchEventsOutputer can not be negative"<<std::endl;
+        return {};
+      }
+      if(swmr and (collective or directChunkWrite)) {
+        //direct chunk writes extend the Products dataset before the bytes of its last chunk are written
+        std::cout <<"swmr for HDFBatchEventsOutputer can not be combined with collective or directChunkWrite"<<std::endl;
+        return {};
+      }
 
-      return std::make_unique<HDFBatchEventsOutputer>(*fileName, iNLanes, chunkSize, *compression, compressionLevel, compressionChoice, *serialization, batchSize);
+      try {
+        return std::make_unique<HDFBatchEventsOutputer>(*fileName, iNLanes, chunkSize, *compression, compressionLevel, compressionChoice, *serialization, batchSize, batchBytes, multiDatasetWrite, shards, directChunkWrite, collective,
+                                                        swmr, std::chrono::milliseconds(swmrFlushInterval), preallocateBytes, writeAlignment);
+      } catch(std::runtime_error const& iError) {
+        std::cout <<iError.what()<<std::endl;
+        return {};
+      }
     }
   };
 
@@ -6,6 +6,11 @@
 #include <string>
 #include <cstdint>
 #include <fstream>
+#include <optional>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
 
 
 #include "OutputerBase.h"
@@ -15,8 +20,12 @@
 #include "pds_writer.h"
 
 #include "SerialTaskQueue.h"
+#include "PerLaneCounter.h"
+#include "SizeTargetBatcher.h"
+#include "FilePreallocator.h"
 
 #include "HDFCxx.h"
+#include "multidataset_plugin.h"
 
 
 namespace cce::tf {
@@ -29,7 +38,9 @@ namespace cce::tf {
         kBoth
     };
 
-    HDFBatchEventsOutputer(std::string const& iFileName, unsigned int iNLanes, int iChunkSize, pds::Compression iCompression, int iCompressionLevel, CompressionChoice iChoice, pds::Serialization iSerialization, uint32_t iBatchSize);
+    HDFBatchEventsOutputer(std::string const& iFileName, unsigned int iNLanes, int iChunkSize, pds::Compression iCompression, int iCompressionLevel, CompressionChoice iChoice, pds::Serialization iSerialization, uint32_t iBatchSize, std::size_t iBatchBytes=0, bool iMultiDatasetWrite=false, unsigned int iNShards=1, bool iDirectChunkWrite=false, bool iCollective=false,
+                           bool iSWMR=false, std::chrono::milliseconds iSWMRFlushInterval=std::chrono::milliseconds(1000),
+                           std::size_t iPreallocateBytes=0, std::size_t iWriteAlignment=0);
     HDFBatchEventsOutputer(HDFBatchEventsOutputer&&) = default;
     HDFBatchEventsOutputer(HDFBatchEventsOutputer const&) = default;
 
@@ -38,40 +49,108 @@ namespace cce::tf {
   void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const final;
   bool usesProductReadyAsync() const final {return true;}
 
-  void outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
   
   void printSummary() const final;
+  void fillReport(RunReport&) const final;
+  void fillProfile(ProductProfile&) const final;
 
  private:
+  using EventInfo = std::tuple<EventIdentifier, std::vector<uint32_t>, std::vector<char>>;
 
-  void finishBatchAsync(unsigned int iBatchIndex, TaskHolder iCallback);
-
-  void output(std::vector<EventIdentifier> iEventID, std::vector<char> iBuffer, std::vector<uint32_t> iOffset);
+  //The batches are filled in a ring of slots. The events of batch number N go to slot N % (number of slots)
+  // and may only be added once the slot's batchNumber_ is N, i.e. once batch N - (number of slots)
+  // has been taken out of the slot.
+  struct BatchSlot {
+    explicit BatchSlot(uint32_t iBatchSize, uint64_t iFirstBatchNumber):
+      events_(iBatchSize), nFilled_{0}, batchNumber_{iFirstBatchNumber} {}
+    std::vector<EventInfo> events_;
+    std::atomic<uint32_t> nFilled_;
+    std::atomic<uint64_t> batchNumber_;
+  };
+  struct CollectedBatch {
+    std::vector<EventIdentifier> eventIDs_;
+    std::vector<uint32_t> offsets_;
+    std::vector<char> blob_;
+  };
+  //One HDF5 file with its own write queue. With more than one shard, batches are
+  // spread over the shards and a virtual dataset file joins them at the end of the job.
+  struct Shard {
+    Shard(std::string const& iFileName, bool iMultiDatasetWrite, hid_t iFileAccess = H5P_DEFAULT, std::size_t iPreallocateBytes = 0);
+    hdf5::File file_;
+    hdf5::Group group_;
+    //when set, the three datasets of a batch are written together
+    std::optional<hdf5::MultiDatasetWriter> multiWriter_;
+    SerialTaskQueue queue_;
+    std::optional<EventIdentifier> firstEventID_;
+    unsigned long long nBatches_ = 0;
+    //used with direct chunk writes, the Products bytes not yet making a full chunk
+    std::optional<hdf5::Dataset> products_;
+    std::vector<char> chunkTail_;
+    hsize_t productsLength_ = 0;
+    unsigned long long nChunksWritten_ = 0;
+    //used with collective writes, the batches of this rank waiting for the end of the job
+    std::vector<unsigned long long> collectedIDs_;
+    std::vector<char> collectedProducts_;
+    std::vector<uint32_t> collectedOffsets_;
+    std::vector<unsigned long long> collectedBatchSizes_;
+    //set when readers may read the file while it is written
+    std::optional<hdf5::SWMRFlusher> swmrFlusher_;
+    //when set, the file's blocks are allocated ahead of what HDF5 has written
+    std::unique_ptr<FilePreallocator> preallocator_;
+  };
+
+  void finishBatchAsync(unsigned int iSlotIndex, pds::CompressionContext&, TaskHolder iCallback);
+  CollectedBatch collectBatch(EventInfo* iBegin, EventInfo* iEnd) const;
+  void writeBatchAsync(CollectedBatch iBatch, pds::CompressionContext&, TaskHolder iCallback);
+
+  void output(Shard& iShard, std::vector<EventIdentifier> iEventID, std::vector<char> iBuffer, std::vector<uint32_t> iOffset);
   void writeFileHeader(SerializeStrategy const& iSerializers);
-  std::pair<std::vector<uint32_t>,std::vector<char>> writeDataProductsToOutputBuffer(SerializeStrategy const& iSerializers) const;
+  //writes the bytes to the Products dataset as raw chunks, bypassing the HDF5 chunk cache
+  void writeProductChunks(Shard& iShard, std::vector<char> const& iBuffer) const;
+  void writeChunk(Shard& iShard, char const* iData) const;
+  //writes the last, partially filled, chunk
+  void flushChunkTail(Shard& iShard) const;
+  void createAttributes(hid_t iGroup, SerializeStrategy const& iSerializers) const;
+  void writeAttributes(hid_t iGroup, EventIdentifier const& iFirstEventID) const;
+  void writeVirtualFile() const;
+  //all MPI ranks write their batches to the datasets of the one file together
+  void writeCollective(Shard& iShard) const;
+  std::pair<std::vector<uint32_t>,std::vector<char>> writeDataProductsToOutputBuffer(SerializeStrategy const& iSerializers, pds::CompressionContext&) const;
 
 private:
-  hdf5::File file_;
-  hdf5::Group group_;
-  mutable SerialTaskQueue queue_;
+  std::string fileName_;
+  mutable std::vector<std::unique_ptr<Shard>> shards_;
+  mutable std::atomic<unsigned int> nextShard_;
+  //libhdf5 calls from different shards must not overlap unless the library is thread safe
+  mutable std::mutex hdf5Mutex_;
+  bool hdf5ThreadSafe_ = false;
   int chunkSize_;
   mutable std::vector<SerializeStrategy> serializers_;
+  //one per lane so the compression state does not need to be remade for each event
+  mutable std::vector<pds::CompressionContext> compressionContexts_;
 
-  //This is used as a circular buffer of length nLanes but only entries being used exist
-  using EventInfo = std::tuple<EventIdentifier, std::vector<uint32_t>, std::vector<char>>;
-  mutable std::vector<std::atomic<std::vector<EventInfo>*>> eventBatches_;
-  mutable std::vector<std::atomic<uint32_t>> waitingEventsInBatch_;
+  //allocated once so filling a batch only moves the event's buffers into place
+  mutable std::vector<std::unique_ptr<BatchSlot>> batchSlots_;
 
   mutable std::atomic<uint64_t> presentEventEntry_;
+  //when set, batches are closed by their size in bytes instead of batchSlots_ being used
+  mutable std::optional<SizeTargetBatcher<EventInfo>> sizeBatcher_;
 
   uint32_t batchSize_;
-  bool firstEvent_ = true;
   pds::Compression compression_;
   int compressionLevel_;
   CompressionChoice compressionChoice_;
   pds::Serialization serialization_;
+  bool directChunkWrite_;
+  bool collective_;
+  //events written by all ranks with the collective write
+  mutable unsigned long long nCollectiveEvents_ = 0;
+  mutable std::chrono::microseconds collectiveWriteTime_{0};
   mutable std::chrono::microseconds serialTime_;
-  mutable std::atomic<std::chrono::microseconds::rep> parallelTime_;
+  mutable PerLaneCounter<std::chrono::microseconds::rep> parallelTime_;
+  //largest buffer holding all the events of one batch
+  mutable std::atomic<std::size_t> maxBatchBytes_{0};
   };    
 }
 #endif
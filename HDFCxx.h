@@ -2,6 +2,7 @@
 #define HDFCxx_h
 
 #include "hdf5.h"
+#include <chrono>
 #include <stdexcept>
 #include <vector>
 
@@ -37,9 +38,28 @@ class File {
     static File create(const char *name) {
       return File(H5Fcreate(name, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT));
     } 
+    //iAccess is a file access property list, e.g. one using the MPI-IO driver
+    static File create(const char *name, hid_t iAccess) {
+      return File(H5Fcreate(name, H5F_ACC_TRUNC, H5P_DEFAULT, iAccess));
+    }
     static File open(const char *name) {
       return File(H5Fopen(name, H5F_ACC_RDONLY, H5P_DEFAULT));
     }
+    //reads a file which may still be written with single-writer/multiple-reader access
+    static File open_swmr_read(const char *name) {
+      return File(H5Fopen(name, H5F_ACC_RDONLY | H5F_ACC_SWMR_READ, H5P_DEFAULT));
+    }
+    //afterwards objects and attributes can not be added, datasets can only be extended and written
+    void start_swmr_write() {
+      if(H5Fstart_swmr_write(file_) < 0) {
+        throw std::runtime_error("Unable to start single-writer/multiple-reader access\n");
+      }
+    }
+    void flush() {
+      if(H5Fflush(file_, H5F_SCOPE_LOCAL) < 0) {
+        throw std::runtime_error("Unable to flush the file\n");
+      }
+    }
     ~File() {
       H5Fclose(file_);
     }
@@ -78,22 +98,39 @@ class Group {
 class Dataset {
   public: 
     template<typename T> 
-    static Dataset create(hid_t id, const char *name, hid_t space_id, hid_t dcpl_id) {
+    static Dataset create(hid_t id, const char *name, hid_t space_id, hid_t dcpl_id, hid_t dapl_id = H5P_DEFAULT) {
     
-     return Dataset(H5Dcreate2(id, name, H5filetype_for<T>, space_id, H5P_DEFAULT, dcpl_id, H5P_DEFAULT)); 
+     return Dataset(H5Dcreate2(id, name, H5filetype_for<T>, space_id, H5P_DEFAULT, dcpl_id, dapl_id)); 
     } 
     static Dataset open(hid_t id, const char *name){
       return Dataset(H5Dopen2(id, name, H5P_DEFAULT));}
+    Dataset(Dataset&& iOther): dataset_(iOther.dataset_) { iOther.dataset_ = H5I_INVALID_HID; }
     ~Dataset() { 
+      if(dataset_ >= 0) {
        H5Dclose(dataset_);
+      }
     }
     operator hid_t() const {return dataset_;}
+
+    //with single-writer/multiple-reader access, a reader sees the writes flushed since it opened the dataset
+    void refresh() {
+      if(H5Drefresh(dataset_) < 0) {
+        throw std::runtime_error("Unable to refresh the dataset\n");
+      }
+    }
     
     template<typename T>
     auto 
     write(hid_t dspace, hid_t filespace, std::vector<T> const & data) {
       return H5Dwrite(dataset_, H5memtype_for<T>, dspace, filespace, H5P_DEFAULT, &data[0]);
     }
+    //iTransfer is a data transfer property list, e.g. asking for a collective MPI-IO write
+    template<typename T>
+    void write(hid_t dspace, hid_t filespace, T const* data, hid_t iTransfer) {
+      if(H5Dwrite(dataset_, H5memtype_for<T>, dspace, filespace, iTransfer, data) < 0) {
+        throw std::runtime_error("Unable to write the dataset\n");
+      }
+    }
   
     auto set_extent(hsize_t const *dims) {
      auto err = H5Dset_extent(dataset_, dims);
@@ -159,6 +196,12 @@ class Dataspace {
         throw std::runtime_error("Unable to select hyperslab\n");
       }
     } 
+    //used by a process taking part in a collective write without data of its own
+    void select_none() {
+      if (H5Sselect_none(dspace_) < 0) {
+        throw std::runtime_error("Unable to select none\n");
+      }
+    }
     ~Dataspace() {
       H5Sclose(dspace_);
     }
@@ -181,12 +224,42 @@ class Property {
     static Property create() {
       return Property(H5Pcreate(H5P_DATASET_CREATE));
     }
+    static Property create_access() {
+      return Property(H5Pcreate(H5P_DATASET_ACCESS));
+    }
+    static Property create_file_access() {
+      return Property(H5Pcreate(H5P_FILE_ACCESS));
+    }
+    static Property create_transfer() {
+      return Property(H5Pcreate(H5P_DATASET_XFER));
+    }
     void set_chunk(hsize_t ndims, hsize_t const *dims) {
       auto err = H5Pset_chunk(prop_, ndims, dims);
       if (err < 0) {
         throw std::runtime_error("Unable to set chunk size\n");
       }
     } 
+    //only for a property made with create_file_access, single-writer/multiple-reader access needs it
+    void set_latest_format() {
+      auto err = H5Pset_libver_bounds(prop_, H5F_LIBVER_LATEST, H5F_LIBVER_LATEST);
+      if (err < 0) {
+        throw std::runtime_error("Unable to set the file format\n");
+      }
+    }
+    //only for a property made with create_file_access, objects of at least iThreshold bytes start at multiples of iAlignment
+    void set_alignment(hsize_t iThreshold, hsize_t iAlignment) {
+      auto err = H5Pset_alignment(prop_, iThreshold, iAlignment);
+      if (err < 0) {
+        throw std::runtime_error("Unable to set the alignment\n");
+      }
+    }
+    //only for a property made with create_access
+    void set_chunk_cache(size_t nslots, size_t nbytes, double w0) {
+      auto err = H5Pset_chunk_cache(prop_, nslots, nbytes, w0);
+      if (err < 0) {
+        throw std::runtime_error("Unable to set chunk cache\n");
+      }
+    }
     ~Property() {
       H5Pclose(prop_);
     }
@@ -199,5 +272,37 @@ class Property {
     }
     hid_t prop_;
 };
+
+//with iSWMR the file uses the latest format so it can later be given single-writer/multiple-reader access
+inline File create_file(const char *name, bool iSWMR) {
+  if(not iSWMR) {
+    return File::create(name);
+  }
+  auto access = Property::create_file_access();
+  access.set_latest_format();
+  return File::create(name, access);
+}
+
+//With single-writer/multiple-reader access readers only see what the writer flushed.
+// Flushes the file once the interval passed since the last flush.
+class SWMRFlusher {
+  public:
+    explicit SWMRFlusher(std::chrono::milliseconds iInterval): interval_{iInterval}, last_{std::chrono::steady_clock::now()} {}
+    void flushIfDue(File& iFile) {
+      if(std::chrono::steady_clock::now() - last_ >= interval_) {
+        flush(iFile);
+      }
+    }
+    void flush(File& iFile) {
+      iFile.flush();
+      last_ = std::chrono::steady_clock::now();
+      ++nFlushes_;
+    }
+    unsigned long long nFlushes() const { return nFlushes_; }
+  private:
+    std::chrono::milliseconds interval_;
+    std::chrono::steady_clock::time_point last_;
+    unsigned long long nFlushes_ = 0;
+};
 }
 #endif
@@ -2,14 +2,17 @@
 #include "OutputerFactory.h"
 #include "ConfigurationParameters.h"
 #include "UnrolledSerializerWrapper.h"
+#include "FixedLayoutSerializerWrapper.h"
 #include "SerializerWrapper.h"
 #include "summarize_serializers.h"
+#include "summarize_queue.h"
 #include "lz4.h"
 #include <memory>
 #include <iostream>
 #include <cstring>
 #include <cmath>
 #include <set>
+#include <algorithm>
 
 using namespace cce::tf;
 using namespace cce::tf::pds;
@@ -19,42 +22,32 @@ namespace {
   constexpr const char* const EVENTS_DSNAME="EventIDs";
   constexpr const char* const OFFSETS_DSNAME="Offsets";
   constexpr const char* const GNAME="Lumi";
-  template <typename T> 
-  void 
-  write_ds(hid_t gid, 
-           std::string const& dsname, 
-           std::vector<T> const& data) {
-    constexpr hsize_t ndims = 1;
-    auto dset = hdf5::Dataset::open(gid, dsname.c_str()); 
-    auto old_fspace = hdf5::Dataspace::get_space(dset);
-    hsize_t max_dims[ndims]; //= {H5S_UNLIMITED};
-    hsize_t old_dims[ndims]; //our datasets are 1D
-    H5Sget_simple_extent_dims(old_fspace, old_dims, max_dims);
-    //now old_dims[0] has existing length
-    //we need to extend by the size of data
-    hsize_t new_dims[ndims];
-    new_dims[0] = old_dims[0] + data.size();
-    hsize_t slab_size[ndims];
-    slab_size[0] = data.size();
-    dset.set_extent(new_dims);
-    auto new_fspace = hdf5::Dataspace::get_space (dset);
-    new_fspace.select_hyperslab(old_dims, slab_size);
-    auto mem_space = hdf5::Dataspace::create_simple(ndims, slab_size, max_dims);
-    dset.write<T>(mem_space, new_fspace, data); //H5Dwrite
-  }
-}
-
-HDFEventOutputer::HDFEventOutputer(std::string const& iFileName, unsigned int iNLanes, int iChunkSize, pds::Compression iCompression, int iCompressionLevel, pds::Serialization iSerialization) : 
-  file_(hdf5::File::create(iFileName.c_str())),
+}
+
+HDFEventOutputer::HDFEventOutputer(std::string const& iFileName, unsigned int iNLanes, int iChunkSize, pds::Compression iCompression, int iCompressionLevel, pds::Serialization iSerialization,
+                                   bool iOrderedOutput, unsigned int iOrderedOutputWindow,
+                                   std::size_t iChunkCacheBytes, unsigned int iEventsPerWrite,
+                                   bool iSWMR, std::chrono::milliseconds iSWMRFlushInterval) : 
+  file_(hdf5::create_file(iFileName.c_str(), iSWMR)),
   group_(hdf5::Group::create(file_, GNAME)),
   chunkSize_{iChunkSize},
+  chunkCacheBytes_{iChunkCacheBytes},
+  eventsPerWrite_{std::max(iEventsPerWrite, 1U)},
   serializers_{std::size_t(iNLanes)},
+  compressionContexts_{std::size_t(iNLanes)},
   compression_{iCompression},
   compressionLevel_{iCompressionLevel},
   serialization_{iSerialization},
   serialTime_{std::chrono::microseconds::zero()},
-  parallelTime_{0}
-  {}
+  parallelTime_{iNLanes}
+  {
+    if(iOrderedOutput) {
+      reorderBuffer_.emplace(iOrderedOutputWindow);
+    }
+    if(iSWMR) {
+      swmrFlusher_.emplace(iSWMRFlushInterval);
+    }
+  }
 
 
 void HDFEventOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) {
@@ -64,6 +57,10 @@ void HDFEventOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataPro
     {   s = SerializeStrategy::make<SerializeProxy<SerializerWrapper>>(); break; }
   case pds::Serialization::kRootUnrolled:
     {   s = SerializeStrategy::make<SerializeProxy<UnrolledSerializerWrapper>>(); break; }
+  case pds::Serialization::kNativeUnrolled:
+    {   s = SerializeStrategy::make<SerializeProxy<NativeUnrolledSerializerWrapper>>(); break; }
+  case pds::Serialization::kFixedLayout:
+    {   s = SerializeStrategy::make<SerializeProxy<FixedLayoutSerializerWrapper>>(); break; }
   }
   s.reserve(iDPs.size());
   offsetsAndBlob_.first.resize(iDPs.size()+1, 0);
@@ -81,25 +78,75 @@ void HDFEventOutputer::productReadyAsync(unsigned int iLaneIndex, DataProductRet
   laneSerializers[iDataProduct.index()].doWorkAsync(*group, iDataProduct.address(), std::move(iCallback));
 }
 
-void HDFEventOutputer::outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+void HDFEventOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
   auto start = std::chrono::high_resolution_clock::now();
-  auto [offsets, buffer] = writeDataProductsToOutputBuffer(serializers_[iLaneIndex]);
-  queue_.push(*iCallback.group(), [this, iEventID, iLaneIndex, callback=std::move(iCallback), buffer = std::move(buffer), offsets = std::move(offsets)]() mutable {
+  auto [offsets, buffer] = writeDataProductsToOutputBuffer(serializers_[iLaneIndex], compressionContexts_[iLaneIndex]);
+  queue_.push(*iCallback.group(), [this, iEventIndex, iEventID, iLaneIndex, callback=std::move(iCallback), buffer = std::move(buffer), offsets = std::move(offsets)]() mutable {
       auto start = std::chrono::high_resolution_clock::now();
+      if(reorderBuffer_) {
+        const_cast<HDFEventOutputer*>(this)->outputInOrder(iEventIndex, {iEventID, iLaneIndex, std::move(buffer), std::move(offsets), {}}, std::move(callback));
+        serialTime_ += std::chrono::duration_cast<decltype(serialTime_)>(std::chrono::high_resolution_clock::now() - start);
+        return;
+      }
       const_cast<HDFEventOutputer*>(this)->output(iEventID, serializers_[iLaneIndex], std::move(buffer), std::move(offsets));
         serialTime_ += std::chrono::duration_cast<decltype(serialTime_)>(std::chrono::high_resolution_clock::now() - start);
       callback.doneWaiting();
     });
     auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
-    parallelTime_ += time.count();
+    parallelTime_.add(iLaneIndex, time.count());
+}
+
+void HDFEventOutputer::outputInOrder(long iEventIndex, OrderedEvent iEvent, TaskHolder iCallback) {
+  if(not reorderBuffer_->isNext(iEventIndex) and reorderBuffer_->isFull()) {
+    //iCallback is released once the event is written
+    iEvent.waitingLane_.emplace(std::move(iCallback));
+  }
+  reorderBuffer_->push(iEventIndex, std::move(iEvent), [this](OrderedEvent iEvent) { outputOrdered(iEvent); });
+}
+
+void HDFEventOutputer::outputOrdered(OrderedEvent& iEvent) {
+  output(iEvent.eventID_, serializers_[iEvent.laneIndex_], std::move(iEvent.buffer_), std::move(iEvent.offsets_));
+}
+
+void HDFEventOutputer::setFirstEventIndex(long iEventIndex) {
+  if(reorderBuffer_) {
+    reorderBuffer_->setFirstEventIndex(iEventIndex);
+  }
 }
 
 void HDFEventOutputer::printSummary() const  {
+  if(reorderBuffer_) {
+    //all lanes are done so any events still held can be written
+    auto nonConstThis = const_cast<HDFEventOutputer*>(this);
+    nonConstThis->reorderBuffer_->flush([nonConstThis](OrderedEvent iEvent) { nonConstThis->outputOrdered(iEvent); });
+  }
+  {
+    auto nonConstThis = const_cast<HDFEventOutputer*>(this);
+    nonConstThis->writePending();
+    nonConstThis->trim(nonConstThis->eventsDataset_);
+    nonConstThis->trim(nonConstThis->productsDataset_);
+    nonConstThis->trim(nonConstThis->offsetsDataset_);
+    if(swmrFlusher_) {
+      nonConstThis->swmrFlusher_->flush(nonConstThis->file_);
+    }
+  }
   std::cout <<"HDFEventOutputer\n  total serial time at end event: "<<serialTime_.count()<<"us\n"
-    "  total parallel time at end event: "<<parallelTime_.load()<<"us\n";
+    "  total parallel time at end event: "<<parallelTime_.sum()<<"us\n";
+  if(reorderBuffer_) {
+    std::cout <<"  most events held for ordering: "<<reorderBuffer_->maxHeldReached()<<"\n";
+  }
+  std::cout <<"  dataset writes: "<<nWrites_<<" extents: "<<nExtents_<<"\n";
+  if(swmrFlusher_) {
+    std::cout <<"  SWMR flushes: "<<swmrFlusher_->nFlushes()<<"\n";
+  }
+  summarize_queue("write", queue_);
   summarize_serializers(serializers_);
 }
 
+void HDFEventOutputer::fillProfile(ProductProfile& oProfile) const {
+  profile_serializers(oProfile, serializers_);
+}
+
 
 
 void 
@@ -117,11 +164,64 @@ HDFEventOutputer::output(EventIdentifier const& iEventID,
      comp.write(std::string(name(compression_)));
      auto level = hdf5::Attribute::open(group_, "CompressionLevel");
      level.write(compressionLevel_); 
+     if(swmrFlusher_) {
+       //the attributes are set so readers can now follow the file
+       file_.start_swmr_write();
+     }
+  }
+  pendingEventIDs_.push_back(iEventID.event);
+  pendingProducts_.insert(pendingProducts_.end(), iBuffer.begin(), iBuffer.end());
+  pendingOffsets_.insert(pendingOffsets_.end(), iOffsets.begin(), iOffsets.end());
+  if(pendingEventIDs_.size() >= eventsPerWrite_) {
+    writePending();
+  }
+}
+
+void HDFEventOutputer::writePending() {
+  if(pendingEventIDs_.empty()) {
+    return;
+  }
+  //the events are written last so a reader of the file being written does not see an event before its data products
+  append(productsDataset_, pendingProducts_);
+  append(offsetsDataset_, pendingOffsets_);
+  append(eventsDataset_, pendingEventIDs_);
+  pendingEventIDs_.clear();
+  pendingProducts_.clear();
+  pendingOffsets_.clear();
+  if(swmrFlusher_) {
+    swmrFlusher_->flushIfDue(file_);
+  }
+}
+
+template<typename T>
+void HDFEventOutputer::append(AppendingDataset& iDataset, std::vector<T> const& iData) {
+  if(iData.empty()) {
+    return;
+  }
+  constexpr hsize_t ndims = 1;
+  auto& dset = *iDataset.dataset_;
+  hsize_t const needed = iDataset.written_ + iData.size();
+  if(needed > iDataset.allocated_) {
+    //growing geometrically makes the number of H5Dset_extent calls logarithmic in the number of events
+    iDataset.allocated_ = swmrFlusher_ ? needed : std::max(needed, 2*iDataset.allocated_);
+    dset.set_extent(&iDataset.allocated_);
+    ++nExtents_;
+  }
+  auto fspace = hdf5::Dataspace::get_space(dset);
+  hsize_t const offset[ndims] = {iDataset.written_};
+  hsize_t const slab_size[ndims] = {iData.size()};
+  fspace.select_hyperslab(offset, slab_size);
+  auto mem_space = hdf5::Dataspace::create_simple(ndims, slab_size, slab_size);
+  dset.write<T>(mem_space, fspace, iData); //H5Dwrite
+  iDataset.written_ = needed;
+  ++nWrites_;
+}
+
+void HDFEventOutputer::trim(AppendingDataset& iDataset) {
+  if(iDataset.dataset_ and iDataset.allocated_ != iDataset.written_) {
+    iDataset.dataset_->set_extent(&iDataset.written_);
+    iDataset.allocated_ = iDataset.written_;
   }
-  std::vector<unsigned long long> ids = {{iEventID.event}};
-  write_ds<unsigned long long>(group_, EVENTS_DSNAME, ids);
-  write_ds<char>(group_, PRODUCTS_DSNAME, iBuffer);
-  write_ds<uint32_t>(group_, OFFSETS_DSNAME, iOffsets); 
 }
 
 void 
@@ -133,9 +233,14 @@ HDFEventOutputer::writeFileHeader(SerializeStrategy const& iSerializers) {
   auto space = hdf5::Dataspace::create_simple (ndims, dims, max_dims); 
   auto prop   = hdf5::Property::create();
   prop.set_chunk(ndims, chunk_dims);
-  hdf5::Dataset::create<int>(group_, EVENTS_DSNAME, space, prop);
-  hdf5::Dataset::create<char>(group_, PRODUCTS_DSNAME, space, prop);
-  hdf5::Dataset::create<int>(group_, OFFSETS_DSNAME, space, prop);
+  auto access = hdf5::Property::create_access();
+  if(chunkCacheBytes_ != 0) {
+    //data is only appended so fully written chunks are evicted first
+    access.set_chunk_cache(H5D_CHUNK_CACHE_NSLOTS_DEFAULT, chunkCacheBytes_, 1.0);
+  }
+  eventsDataset_.dataset_.emplace(hdf5::Dataset::create<int>(group_, EVENTS_DSNAME, space, prop, access));
+  productsDataset_.dataset_.emplace(hdf5::Dataset::create<char>(group_, PRODUCTS_DSNAME, space, prop, access));
+  offsetsDataset_.dataset_.emplace(hdf5::Dataset::create<int>(group_, OFFSETS_DSNAME, space, prop, access));
 
   const auto scalar_space  = hdf5::Dataspace::create_scalar();
   hdf5::Attribute::create<int>(group_, "run", scalar_space);
@@ -154,7 +259,7 @@ HDFEventOutputer::writeFileHeader(SerializeStrategy const& iSerializers) {
   }
 }
 
-std::pair<std::vector<uint32_t>, std::vector<char>> HDFEventOutputer::writeDataProductsToOutputBuffer(SerializeStrategy const& iSerializers) const{
+std::pair<std::vector<uint32_t>, std::vector<char>> HDFEventOutputer::writeDataProductsToOutputBuffer(SerializeStrategy const& iSerializers, pds::CompressionContext& iContext) const{
   //Calculate buffer size needed
   uint32_t bufferSize = 0;
   std::vector<uint32_t> offsets;
@@ -178,7 +283,7 @@ std::pair<std::vector<uint32_t>, std::vector<char>> HDFEventOutputer::writeDataP
     assert(buffer.size() == offsets[index]);
   }
 
-  auto cBuffer  = pds::compressBuffer(0,0, compression_, compressionLevel_, buffer);
+  auto cBuffer  = pds::compressBuffer(0,0, compression_, compressionLevel_, buffer, iContext);
 
   return {offsets, cBuffer};
 }
@@ -209,7 +314,21 @@ namespace {
         return {};
       }
 
-      return std::make_unique<HDFEventOutputer>(*fileName, iNLanes, chunkSize, *compression, compressionLevel, *serialization);
+      bool orderedOutput = params.get<bool>("orderedOutput", false);
+      auto orderedOutputWindow = params.get<unsigned int>("orderedOutputWindow", 64);
+      auto chunkCacheBytes = params.get<std::size_t>("hdfChunkCacheBytes", 0);
+      auto eventsPerWrite = params.get<unsigned int>("eventsPerWrite", 1);
+
+      auto swmr = params.get<bool>("swmr", false);
+      auto swmrFlushInterval = params.get<int>("swmrFlushInterval_ms", 1000);
+      if(swmrFlushInterval < 0) {
+        std::cout <<"swmrFlushInterval_ms for HDFEventOutputer can not be negative\n";
+        return {};
+      }
+
+      return std::make_unique<HDFEventOutputer>(*fileName, iNLanes, chunkSize, *compression, compressionLevel, *serialization,
+                                                orderedOutput, orderedOutputWindow, chunkCacheBytes, eventsPerWrite,
+                                                swmr, std::chrono::milliseconds(swmrFlushInterval));
     }
   };
 
@@ -6,6 +6,8 @@
 #include <string>
 #include <cstdint>
 #include <fstream>
+#include <optional>
+#include <chrono>
 
 
 #include "OutputerBase.h"
@@ -15,6 +17,8 @@
 #include "pds_writer.h"
 
 #include "SerialTaskQueue.h"
+#include "PerLaneCounter.h"
+#include "EventReorderBuffer.h"
 
 #include "HDFCxx.h"
 
@@ -22,7 +26,10 @@
 namespace cce::tf {
   class HDFEventOutputer : public OutputerBase {
     public:
-    HDFEventOutputer(std::string const& iFileName, unsigned int iNLanes, int iChunkSize, pds::Compression iCompression, int iCompressionLevel, pds::Serialization iSerialization);
+    HDFEventOutputer(std::string const& iFileName, unsigned int iNLanes, int iChunkSize, pds::Compression iCompression, int iCompressionLevel, pds::Serialization iSerialization,
+                     bool iOrderedOutput = false, unsigned int iOrderedOutputWindow = 0,
+                     std::size_t iChunkCacheBytes = 0, unsigned int iEventsPerWrite = 1,
+                     bool iSWMR = false, std::chrono::milliseconds iSWMRFlushInterval = std::chrono::milliseconds(1000));
     HDFEventOutputer(HDFEventOutputer&&) = default;
     HDFEventOutputer(HDFEventOutputer const&) = default;
 
@@ -31,28 +38,70 @@ namespace cce::tf {
   void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const final;
   bool usesProductReadyAsync() const final {return true;}
 
-  void outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+  void setFirstEventIndex(long iEventIndex) final;
   
   void printSummary() const final;
+  void fillProfile(ProductProfile&) const final;
 
  private:
+  struct OrderedEvent {
+    EventIdentifier eventID_;
+    unsigned int laneIndex_;
+    std::vector<char> buffer_;
+    std::vector<uint32_t> offsets_;
+    //set when the Lane must wait for the event to be written
+    std::optional<TaskHolder> waitingLane_;
+  };
+  void outputInOrder(long iEventIndex, OrderedEvent iEvent, TaskHolder iCallback);
+  void outputOrdered(OrderedEvent& iEvent);
 
   void output(EventIdentifier const& iEventID, SerializeStrategy const& iSerializers, std::vector<char> iBuffer, std::vector<uint32_t> iOffset);
+  void writePending();
+
+  //A 1D dataset kept open so its chunk cache is kept between writes. The extent is
+  // doubled when more space is needed and trimmed to the written size at the end.
+  // With SWMR the extent is always the written size so readers never see unwritten entries.
+  struct AppendingDataset {
+    std::optional<hdf5::Dataset> dataset_;
+    hsize_t written_ = 0;
+    hsize_t allocated_ = 0;
+  };
+  template<typename T>
+  void append(AppendingDataset&, std::vector<T> const&);
+  void trim(AppendingDataset&);
   void writeFileHeader(SerializeStrategy const& iSerializers);
-  std::pair<std::vector<uint32_t>,std::vector<char>> writeDataProductsToOutputBuffer(SerializeStrategy const& iSerializers) const;
+  std::pair<std::vector<uint32_t>,std::vector<char>> writeDataProductsToOutputBuffer(SerializeStrategy const& iSerializers, pds::CompressionContext&) const;
 private:
   hdf5::File file_;
   hdf5::Group group_;
+  //set when readers may read the file while it is written
+  std::optional<hdf5::SWMRFlusher> swmrFlusher_;
   mutable SerialTaskQueue queue_;
   int chunkSize_;
+  std::size_t chunkCacheBytes_;
+  unsigned int eventsPerWrite_;
+  AppendingDataset eventsDataset_;
+  AppendingDataset productsDataset_;
+  AppendingDataset offsetsDataset_;
+  //events not yet written to the datasets
+  std::vector<unsigned long long> pendingEventIDs_;
+  std::vector<char> pendingProducts_;
+  std::vector<uint32_t> pendingOffsets_;
+  unsigned long long nWrites_ = 0;
+  unsigned long long nExtents_ = 0;
   mutable std::vector<SerializeStrategy> serializers_;
+  //one per lane so the compression state does not need to be remade for each event
+  mutable std::vector<pds::CompressionContext> compressionContexts_;
   mutable std::pair<std::vector<uint32_t>, std::vector<char>> offsetsAndBlob_;
   bool firstEvent_ = true;
+  //when set, events are written in the order of their event index
+  std::optional<EventReorderBuffer<OrderedEvent>> reorderBuffer_;
   pds::Compression compression_;
   int compressionLevel_;
   pds::Serialization serialization_;
   mutable std::chrono::microseconds serialTime_;
-  mutable std::atomic<std::chrono::microseconds::rep> parallelTime_;
+  mutable PerLaneCounter<std::chrono::microseconds::rep> parallelTime_;
   };    
 }
 #endif
@@ -1,7 +1,11 @@
 #include "HDFOutputer.h"
 #include "OutputerFactory.h"
 #include "ConfigurationParameters.h"
+#include "UnrolledSerializerWrapper.h"
+#include "FixedLayoutSerializerWrapper.h"
+#include "SerializerWrapper.h"
 #include "summarize_serializers.h"
+#include "summarize_queue.h"
 #include "lz4.h"
 #include <memory>
 #include <iostream>
@@ -9,8 +13,7 @@
 #include <cmath>
 #include <set>
 #include <hdf5_hl.h>
-#include "multidataset_plugin.h"
-#include "H5Timing.h"
+#include "tbb/parallel_for.h"
 
 using namespace cce::tf;
 using product_t = std::vector<char>; 
@@ -48,33 +51,45 @@ int append_dataset(hid_t gid, const char *name, char* data, size_t data_size, hi
   return 0;
 }
 
-int write_multidatasets(hid_t gid, const char *name, char* data, size_t data_size, hid_t mtype) {
-  register_multidataset_request_append(name, gid, data, data_size, mtype);
-  return 0;
-}
-
-HDFOutputer::HDFOutputer(std::string const& iFileName, unsigned int iNLanes, int iBatchSize, int iChunkSize) : 
-  file_(hdf5::File::create(iFileName.c_str())),
+HDFOutputer::HDFOutputer(std::string const& iFileName, unsigned int iNLanes, int iBatchSize, int iChunkSize, WriteMethod iWriteMethod, bool iH5Timing,
+                         pds::Serialization iSerialization, bool iSWMR, std::chrono::milliseconds iSWMRFlushInterval) : 
+  file_(hdf5::create_file(iFileName.c_str(), iSWMR)),
+  timing_{iH5Timing},
+  multiWriter_{&timing_},
+  writeMethod_{iWriteMethod},
   chunkSize_{iChunkSize},
   maxBatchSize_{iBatchSize},
   serializers_{std::size_t(iNLanes)},
+  serialization_{iSerialization},
   serialTime_{std::chrono::microseconds::zero()},
-  parallelTime_{0}
-  {}
+  parallelTime_{iNLanes}
+  {
+    if(iSWMR) {
+      swmrFlusher_.emplace(iSWMRFlushInterval);
+    }
+  }
 
 HDFOutputer::~HDFOutputer() { }
 
 void HDFOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) {
   auto& s = serializers_[iLaneIndex];
+  switch(serialization_) {
+  case pds::Serialization::kRoot:
+    {   s = SerializeStrategy::make<SerializeProxy<SerializerWrapper>>(); break; }
+  case pds::Serialization::kRootUnrolled:
+    {   s = SerializeStrategy::make<SerializeProxy<UnrolledSerializerWrapper>>(); break; }
+  case pds::Serialization::kNativeUnrolled:
+    {   s = SerializeStrategy::make<SerializeProxy<NativeUnrolledSerializerWrapper>>(); break; }
+  case pds::Serialization::kFixedLayout:
+    {   s = SerializeStrategy::make<SerializeProxy<FixedLayoutSerializerWrapper>>(); break; }
+  }
   s.reserve(iDPs.size());
   dataProductIndices_.reserve(iDPs.size());
   for(auto const& dp: iDPs) {
     s.emplace_back(dp.name(), dp.classType());
   }
-  products_.reserve(iDPs.size() * maxBatchSize_);
+  batchProducts_.reserve(maxBatchSize_);
   events_.reserve(maxBatchSize_);
-  offsets_.reserve(maxBatchSize_);
-
 }
 
 void HDFOutputer::productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const {
@@ -83,133 +98,168 @@ void HDFOutputer::productReadyAsync(unsigned int iLaneIndex, DataProductRetrieve
   laneSerializers[iDataProduct.index()].doWorkAsync(*group, iDataProduct.address(), std::move(iCallback));
 }
 
-void HDFOutputer::outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+void HDFOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
   auto start = std::chrono::high_resolution_clock::now();
-  queue_.push(*iCallback.group(), [this, iEventID, iLaneIndex, callback=std::move(iCallback)]() mutable {
+  auto products = writeDataProductsToOutputBuffer(serializers_[iLaneIndex]);
+  queue_.push(*iCallback.group(), [this, iEventID, iLaneIndex, products=std::move(products), callback=std::move(iCallback)]() mutable {
       auto start = std::chrono::high_resolution_clock::now();
-      const_cast<HDFOutputer*>(this)->output(iEventID, serializers_[iLaneIndex]);
+      const_cast<HDFOutputer*>(this)->output(iEventID, serializers_[iLaneIndex], std::move(products));
         serialTime_ += std::chrono::duration_cast<decltype(serialTime_)>(std::chrono::high_resolution_clock::now() - start);
       callback.doneWaiting();
     });
     auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
-    parallelTime_ += time.count();
+    parallelTime_.add(iLaneIndex, time.count());
 }
 
 void HDFOutputer::printSummary() const  {
   std::cout <<"HDFOutputer\n  total serial time at end event: "<<serialTime_.count()<<"us\n"
-    "  total parallel time at end event: "<<parallelTime_.load()<<"us\n";
+    "  total parallel time at end event: "<<parallelTime_.sum()<<"us\n";
 
   auto start = std::chrono::high_resolution_clock::now();
-  if (batch_ != 0) {
+  if (not batchProducts_.empty()) {
     //flush the remaining data to the file
     const_cast<HDFOutputer*>(this)->writeBatch();
   }
+  if(swmrFlusher_) {
+    //readers see the last batch without waiting for the file to be closed
+    auto nonConstThis = const_cast<HDFOutputer*>(this);
+    nonConstThis->swmrFlusher_->flush(nonConstThis->file_);
+  }
 
-  finalize_multidataset();
   auto writeTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
   
   std::cout << "  end of job file write time: "<<writeTime.count()<<"us\n";
+  if(writeMethod_ == WriteMethod::kMulti) {
+    std::cout <<"  multi-dataset flushes: "<<multiWriter_.nFlushes()<<" write calls: "<<multiWriter_.nWriteCalls()<<"\n";
+  }
+  if(swmrFlusher_) {
+    std::cout <<"  SWMR flushes: "<<swmrFlusher_->nFlushes()<<"\n";
+  }
+  timing_.printSummary();
 
+  summarize_queue("write", queue_);
   summarize_serializers(serializers_);
 }
 
-std::pair<product_t, std::vector<size_t>> 
-HDFOutputer::
-get_prods_and_sizes(std::vector<product_t> & input, 
-         int prod_index, 
-         int stride) {
-  product_t products; 
-  std::vector<size_t> sizes;
-  sizes.reserve(input.size()); 
-  // or may use (std::ceil(double(input.size()-prod_index)/stride)); 
-  for(int j = prod_index; j< input.size(); j+=stride) {
-    sizes.push_back(offsets_[prod_index]+=input[j].size());
-    products.insert(end(products), std::make_move_iterator(begin(input[j])), std::make_move_iterator(end(input[j])));
-  }
-  return {products, sizes};
+void HDFOutputer::fillProfile(ProductProfile& oProfile) const {
+  profile_serializers(oProfile, serializers_);
 }
 
+std::vector<product_t>
+HDFOutputer::writeDataProductsToOutputBuffer(SerializeStrategy const& iSerializers) const {
+  std::vector<product_t> products;
+  products.reserve(iSerializers.size());
+  for(auto const& s: iSerializers) {
+    auto blob = s.blob();
+    products.emplace_back(blob.begin(), blob.end());
+  }
+  return products;
+}
 
+void
+HDFOutputer::concatenateProduct(std::size_t iProductIndex,
+                                product_t& oProducts,
+                                std::vector<size_t>& oSizes) {
+  std::size_t bytes = 0;
+  for(auto const& event: batchProducts_) {
+    bytes += event[iProductIndex].size();
+  }
+  oProducts.reserve(bytes);
+  oSizes.reserve(batchProducts_.size());
+  auto& offset = offsets_[iProductIndex];
+  for(auto const& event: batchProducts_) {
+    auto const& blob = event[iProductIndex];
+    oProducts.insert(oProducts.end(), blob.begin(), blob.end());
+    offset += blob.size();
+    oSizes.push_back(offset);
+  }
+}
 
 void 
 HDFOutputer::output(EventIdentifier const& iEventID, 
-                    std::vector<SerializerWrapper> const& iSerializers) {
+                    SerializeStrategy const& iSerializers,
+                    std::vector<product_t> iProducts) {
   if(firstTime_) {
     writeFileHeader(iEventID, iSerializers);
     firstTime_ = false;
+    if(swmrFlusher_) {
+      //all datasets and attributes exist so readers can now follow the file
+      file_.start_swmr_write();
+    }
   }
-  // accumulate events before writing, go through all the data products in the curret event
-  for(auto& s: iSerializers) 
-     products_.push_back(s.blob());
+  // accumulate events before writing
+  batchProducts_.push_back(std::move(iProducts));
   events_.push_back(iEventID.event);
 
-  ++batch_;
-  if (batch_ == maxBatchSize_) {
+  if (batchProducts_.size() == static_cast<std::size_t>(maxBatchSize_)) {
     writeBatch();
-    batch_ = 0;
-    products_.clear();
-    events_.clear();
   }
 }
 
 void
 HDFOutputer::writeBatch() {
-  init_multidataset();
-
-  int method = get_hdf5_method();
-#ifdef H5_TIMING_ENABLE
-  size_t total_data_size = 0;
-#endif
-  hdf5::Group gid = hdf5::Group::open(file_, "Lumi");   
-  write_ds<int>(gid, "Event_IDs", events_);
+  using hdf5::H5Timing;
+  hdf5::Group gid = hdf5::Group::open(file_, "Lumi");
   auto const dpi_size = dataProductIndices_.size();
+  std::vector<product_t> allProds(dpi_size);
+  std::vector<std::vector<size_t>> allSizes(dpi_size);
+  {
+    //each data product is concatenated by its own task, the writes stay serial
+    auto timer = timing_.time(H5Timing::kMerge);
+    TaskHolder::WaitScope waitScope;
+    tbb::parallel_for(std::size_t(0), dpi_size, [this, &allProds, &allSizes](std::size_t i) {
+        concatenateProduct(i, allProds[i], allSizes[i]);
+      });
+  }
   for(auto & [name, index]: dataProductIndices_) {
-      auto [prods, sizes] = get_prods_and_sizes(products_, index, dpi_size);
-#ifdef H5_TIMING_ENABLE
-      register_dataset_timer_start(name.c_str());
-#endif
-      if ( method == 1 ) {
-        write_ds<char>(gid, name, prods);
-      } else if (method == 0 ) {
-        write_multidatasets(gid, name.c_str(), (char*) &(prods[0]), prods.size(), H5T_NATIVE_CHAR);
-      } else {
-        append_dataset(gid, name.c_str(), (char*) &(prods[0]), prods.size(), H5T_NATIVE_CHAR);
-      }
-#ifdef H5_TIMING_ENABLE
-      register_dataset_timer_end((size_t)prods.size());
-#endif
+      auto const& prods = allProds[index];
+      auto const& sizes = allSizes[index];
       auto s = name+"_sz";
-#ifdef H5_TIMING_ENABLE
-      register_dataset_sz_timer_start(s.c_str());
-#endif
-      if (method == 1) {
-        write_ds<size_t>(gid, s, sizes);
-      } else if ( method == 0 ) {
-        write_multidatasets(gid, s.c_str(), (char*) &(sizes[0]), sizes.size(), H5T_NATIVE_ULLONG);
-      } else {
-        append_dataset(gid, s.c_str(), (char*) &(sizes[0]), sizes.size(), H5T_NATIVE_ULLONG);
+      if ( writeMethod_ == WriteMethod::kMulti ) {
+        auto timer = timing_.time(H5Timing::kMerge);
+        multiWriter_.append(gid, name, prods);
+        multiWriter_.append(gid, s, sizes);
+        continue;
+      }
+      {
+        auto timer = timing_.time(H5Timing::kWrite, prods.size());
+        if ( writeMethod_ == WriteMethod::kDirect ) {
+          write_ds<char>(gid, name, prods);
+        } else {
+          append_dataset(gid, name.c_str(), const_cast<char*>(prods.data()), prods.size(), H5T_NATIVE_CHAR);
+        }
+      }
+      {
+        auto timer = timing_.time(H5Timing::kWrite, sizes.size()*sizeof(size_t));
+        if ( writeMethod_ == WriteMethod::kDirect ) {
+          write_ds<size_t>(gid, s, sizes);
+        } else {
+          append_dataset(gid, s.c_str(), reinterpret_cast<char*>(const_cast<size_t*>(sizes.data())), sizes.size(), H5T_NATIVE_ULLONG);
+        }
       }
-#ifdef H5_TIMING_ENABLE
-      register_dataset_sz_timer_end((size_t)sizes.size() * sizeof(size_t));
-#endif
-#ifdef H5_TIMING_ENABLE
-      total_data_size += (size_t)prods.size() + (size_t)sizes.size() * sizeof(size_t);
-#endif
   }
 
-#ifdef H5_TIMING_ENABLE
-  register_dataset_timer_start("flush_all");
-#endif
-  flush_multidatasets();
-#ifdef H5_TIMING_ENABLE
-  register_dataset_timer_end(total_data_size);
-#endif
-
+  //the events are written last so a reader of the file being written does not see an event before its data products
+  if(writeMethod_ == WriteMethod::kMulti) {
+    auto timer = timing_.time(H5Timing::kMerge);
+    multiWriter_.append(gid, "Event_IDs", events_);
+  } else {
+    auto timer = timing_.time(H5Timing::kWrite, events_.size()*sizeof(int));
+    write_ds<int>(gid, "Event_IDs", events_);
+  }
+  if(writeMethod_ == WriteMethod::kMulti) {
+    multiWriter_.flush();
+  }
+  batchProducts_.clear();
+  events_.clear();
+  if(swmrFlusher_) {
+    swmrFlusher_->flushIfDue(file_);
+  }
 }
 
 void 
 HDFOutputer::writeFileHeader(EventIdentifier const& iEventID, 
-                             std::vector<SerializerWrapper> const& iSerializers) {
+                             SerializeStrategy const& iSerializers) {
   constexpr hsize_t ndims = 1;
   constexpr hsize_t     dims[ndims] = {0};
   const hsize_t     chunk_dims[ndims] = {static_cast<hsize_t>(chunkSize_)};
@@ -226,6 +276,7 @@ HDFOutputer::writeFileHeader(EventIdentifier const& iEventID,
   r.write<int>(iEventID.run);
   l.write<int>(iEventID.lumi);
   int dp_index = 0; //for data product indices
+  offsets_.assign(iSerializers.size(), 0);
   
   for(auto const& s: iSerializers) {
     std::string dp_name{s.name()};
@@ -255,7 +306,37 @@ namespace {
       auto batchSize = params.get<int>("batchSize", 1);
       auto chunkSize = params.get<int>("hdfchunkSize", 1048576);
 
-      return std::make_unique<HDFOutputer>(*fileName, iNLanes, batchSize, chunkSize);
+      auto writeMethodName = params.get<std::string>("writeMethod", "direct");
+      HDFOutputer::WriteMethod writeMethod;
+      if(writeMethodName == "direct") {
+        writeMethod = HDFOutputer::WriteMethod::kDirect;
+      } else if(writeMethodName == "multi") {
+        writeMethod = HDFOutputer::WriteMethod::kMulti;
+      } else if(writeMethodName == "append") {
+        writeMethod = HDFOutputer::WriteMethod::kAppend;
+      } else {
+        std::cout<<"unknown writeMethod '"<<writeMethodName<<"' for HDFOutputer, allowed values are direct, multi or append\n";
+        return {};
+      }
+
+      auto h5Timing = params.get<bool>("h5Timing", false);
+
+      auto serializationName = params.get<std::string>("serializationAlgorithm", "ROOT");
+      auto serialization = pds::toSerialization(serializationName);
+      if(not serialization) {
+        std::cout <<"unknown serialization "<<serializationName<<std::endl;
+        return {};
+      }
+
+      auto swmr = params.get<bool>("swmr", false);
+      auto swmrFlushInterval = params.get<int>("swmrFlushInterval_ms", 1000);
+      if(swmrFlushInterval < 0) {
+        std::cout <<"swmrFlushInterval_ms for HDFOutputer can not be negative\n";
+        return {};
+      }
+
+      return std::make_unique<HDFOutputer>(*fileName, iNLanes, batchSize, chunkSize, writeMethod, h5Timing, *serialization,
+                                           swmr, std::chrono::milliseconds(swmrFlushInterval));
     }
   };
 
@@ -6,23 +6,33 @@
 #include <string>
 #include <cstdint>
 #include <fstream>
+#include <optional>
+#include <chrono>
 
 
 #include "OutputerBase.h"
 #include "EventIdentifier.h"
-#include "SerializerWrapper.h"
+#include "SerializeStrategy.h"
 #include "DataProductRetriever.h"
+#include "pds_writer.h"
 
 #include "SerialTaskQueue.h"
+#include "PerLaneCounter.h"
 
 #include "HDFCxx.h"
+#include "multidataset_plugin.h"
 
 using product_t = std::vector<char>;
 
 namespace cce::tf {
   class HDFOutputer : public OutputerBase {
     public:
-    HDFOutputer(std::string const& iFileName, unsigned int iNLanes, int iBatchSize, int iChunkSize);
+    //kDirect: one H5Dwrite per dataset, kMulti: all datasets of a batch written by one
+    // MultiDatasetWriter flush, kAppend: H5DOappend
+    enum class WriteMethod {kDirect, kMulti, kAppend};
+    HDFOutputer(std::string const& iFileName, unsigned int iNLanes, int iBatchSize, int iChunkSize, WriteMethod iWriteMethod = WriteMethod::kDirect, bool iH5Timing = false,
+                pds::Serialization iSerialization = pds::Serialization::kRoot, bool iSWMR = false,
+                std::chrono::milliseconds iSWMRFlushInterval = std::chrono::milliseconds(1000));
     HDFOutputer(HDFOutputer&&) = default;
     HDFOutputer(HDFOutputer const&) = default;
     ~HDFOutputer();
@@ -32,35 +42,45 @@ namespace cce::tf {
   void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const final;
   bool usesProductReadyAsync() const final {return true;}
 
-  void outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
   
   void printSummary() const final;
+  void fillProfile(ProductProfile&) const final;
 
  private:
 
-  void output(EventIdentifier const& iEventID, std::vector<SerializerWrapper> const& iSerializers);
-  void writeFileHeader(EventIdentifier const& iEventID, std::vector<SerializerWrapper> const& iSerializers);
+  void output(EventIdentifier const& iEventID, SerializeStrategy const& iSerializers, std::vector<product_t> iProducts);
+  void writeFileHeader(EventIdentifier const& iEventID, SerializeStrategy const& iSerializers);
 
-  std::vector<std::vector<char>> writeDataProductsToOutputBuffer(std::vector<SerializerWrapper> const& iSerializers) const;
-std::pair<product_t, std::vector<size_t>> get_prods_and_sizes(std::vector<product_t> & input,int prod_index,int stride);
-private:
- void writeBatch();
+  //copies the blobs of the event so the Lane's serializers can be reused
+  std::vector<product_t> writeDataProductsToOutputBuffer(SerializeStrategy const& iSerializers) const;
+  //concatenates the data product of all events of the batch and gives the end offset of each
+  void concatenateProduct(std::size_t iProductIndex, product_t& oProducts, std::vector<size_t>& oSizes);
+  void writeBatch();
 
   hdf5::File file_;
+  hdf5::H5Timing timing_;
+  //declared after file_ so its datasets are closed before the file
+  mutable hdf5::MultiDatasetWriter multiWriter_;
+  //set when readers may read the file while it is written
+  std::optional<hdf5::SWMRFlusher> swmrFlusher_;
+  WriteMethod const writeMethod_;
   mutable SerialTaskQueue queue_;
   int chunkSize_;
   int maxBatchSize_;
   std::vector<std::pair<std::string, uint32_t>> dataProductIndices_;
-  mutable std::vector<std::vector<SerializerWrapper>> serializers_;
+  mutable std::vector<SerializeStrategy> serializers_;
+  pds::Serialization serialization_;
   bool firstTime_ = true;
   
-  std::vector<product_t> products_; 
-  std::vector<size_t> offsets_ = decltype(offsets_)(1000, 0);
-  mutable int batch_ = 0;
+  //one entry per event of the batch, each with the blobs of all data products
+  std::vector<std::vector<product_t>> batchProducts_;
+  //per data product, the bytes written so far
+  std::vector<size_t> offsets_;
   std::vector<int> events_;
   
   mutable std::chrono::microseconds serialTime_;
-  mutable std::atomic<std::chrono::microseconds::rep> parallelTime_;
+  mutable PerLaneCounter<std::chrono::microseconds::rep> parallelTime_;
   };    
 }
 #endif
@@ -5,9 +5,10 @@
 #include "TClass.h"
 #include "TBufferFile.h"
 
+#include <algorithm>
+
 using namespace cce::tf;
 
-using product_t = std::vector<char>;
 namespace {
   // C function (copied from HDF5 examples) that is passed as Operator function
   // to H5Literate.  
@@ -31,15 +32,51 @@ namespace {
     }
     return 0;
   }
+
+  template<typename T>
+  std::vector<T> readAll(hid_t iDataset, hid_t iMemType) {
+    auto space = hdf5::Dataspace::get_space(iDataset);
+    hsize_t dims[1];
+    H5Sget_simple_extent_dims(space, dims, nullptr);
+    std::vector<T> values(dims[0]);
+    if(not values.empty()) {
+      H5Dread(iDataset, iMemType, H5S_ALL, H5S_ALL, H5P_DEFAULT, values.data());
+    }
+    return values;
+  }
 }
 
 
-HDFSource::HDFSource(std::string const& iName):
+HDFSource::ProductDataset::ProductDataset(hid_t iGroup, std::string const& iName):
+  products_(hdf5::Dataset::open(iGroup, iName.c_str())),
+  ends_(readAll<unsigned long long>(hdf5::Dataset::open(iGroup, (iName+"_sz").c_str()), H5T_NATIVE_ULLONG)) {}
+
+HDFSource::HDFSource(std::string const& iName, ProductSelector const& iSelector, unsigned int iEventsPerRead):
 file_(hdf5::File::open(iName.c_str())),
-lumi_(hdf5::Group::open(file_, "/Lumi"))
+lumi_(hdf5::Group::open(file_, "/Lumi")),
+eventsPerRead_{iEventsPerRead == 0 ? 1 : iEventsPerRead}
 {
   H5Literate (lumi_, H5_INDEX_NAME, H5_ITER_NATIVE, NULL, op_func, &productInfos_);
+  if(not iSelector.keepsAll()) {
+    std::vector<ProductInfo> kept;
+    for(auto& pi: productInfos_) {
+      if(iSelector.keep(pi.name())) {
+        kept.emplace_back(std::move(pi.name_), kept.size());
+      }
+    }
+    productInfos_ = std::move(kept);
+  }
   
+  productDatasets_.reserve(productInfos_.size());
+  for(auto const& pi: productInfos_) {
+    productDatasets_.emplace_back(lumi_, pi.name());
+  }
+  eventIDs_ = readAll<unsigned int>(hdf5::Dataset::open(lumi_, "Event_IDs"), H5T_NATIVE_UINT);
+  auto attr_r = hdf5::Attribute::open(lumi_, "run");
+  H5Aread(attr_r, H5T_NATIVE_UINT, &run_);
+  auto attr_l = hdf5::Attribute::open(lumi_, "lumisec");
+  H5Aread(attr_l, H5T_NATIVE_UINT, &lumi_num_);
+
   dataProducts_.reserve(productInfos_.size());
   dataBuffers_.resize(productInfos_.size(), nullptr);
   classnames_=readClassNames();
@@ -68,13 +105,12 @@ HDFSource::~HDFSource() {
 std::vector<std::string>
 HDFSource::readClassNames() {
   std::vector<std::string> classnames;
-  for (auto const& pi : productInfos_) {
-    auto dset = hdf5::Dataset::open(lumi_, (pi.name()).c_str());
-    auto aid = hdf5::Attribute::open(dset, "classname");
+  for (auto const& pd : productDatasets_) {
+    auto aid = hdf5::Attribute::open(pd.products_, "classname");
     auto tid = H5Aget_type(aid); 
-    auto sz = H5Aget_storage_size(aid);
     char* attribute_name; 
     H5Aread(aid, tid, &attribute_name);
+    H5Tclose(tid);
     std::string s(attribute_name);
     free(attribute_name);
     classnames.push_back(std::move(s));
@@ -84,84 +120,57 @@ HDFSource::readClassNames() {
 
 
 std::pair<long unsigned int, long unsigned int>
-HDFSource::getEventOffsets(long iEventIndex, std::string const& pname) {
-  constexpr hsize_t nelements = 2;
-  long unsigned int offsets[nelements];
-  hsize_t coords[nelements]; 
-  coords[0] = (iEventIndex == 0) ? iEventIndex: iEventIndex-1;
-  coords[1] = iEventIndex;
-  auto dset = hdf5::Dataset::open(lumi_, (pname+"_sz").c_str());
-  auto fspace = hdf5::Dataspace::get_space(dset);
-  auto mspace = hdf5::Dataspace::create_simple(1, &nelements, NULL); 
-  H5Sselect_elements(fspace, H5S_SELECT_SET, 2, (const hsize_t *)&coords);
-  H5Dread(dset, H5T_STD_U64LE, mspace, fspace, H5P_DEFAULT, offsets); 
+HDFSource::getEventOffsets(long iEventIndex, ProductDataset const& iDataset) const {
   if (iEventIndex == 0) {
-    return {0, offsets[0]};
+    return {0, iDataset.ends_[0]};
   } else {
-   return {offsets[0], offsets[1]};
+   return {iDataset.ends_[iEventIndex-1], iDataset.ends_[iEventIndex]};
   }
 }
 
+void
+HDFSource::readBlock(ProductDataset& iDataset, long iEventIndex) const {
+  long const nEvents = std::min<long>(eventsPerRead_, iDataset.ends_.size() - iEventIndex);
+  auto const begin = getEventOffsets(iEventIndex, iDataset).first;
+  auto const end = getEventOffsets(iEventIndex+nEvents-1, iDataset).second;
+  iDataset.firstEvent_ = iEventIndex;
+  iDataset.nEvents_ = nEvents;
+  hsize_t count[1] = {end-begin};
+  iDataset.block_.resize(count[0]);
+  if(count[0] == 0) {
+    return;
+  }
+  hsize_t start[1] = {begin};
+  auto fspace = hdf5::Dataspace::get_space(iDataset.products_);
+  fspace.select_hyperslab(start, count);
+  auto mspace = hdf5::Dataspace::create_simple(1, count, NULL); 
+  H5Dread(iDataset.products_, H5T_NATIVE_CHAR, mspace, fspace, H5P_DEFAULT, iDataset.block_.data());
+}
 
 bool
 HDFSource::readEvent(long iEventIndex) {
-  constexpr hsize_t ndims = 1;
-  unsigned int run_num[ndims];
-  unsigned int lumi_num[ndims];
-  auto attr_r = hdf5::Attribute::open(lumi_, "run");
-  H5Aread(attr_r, H5T_STD_I32LE,run_num);
-  auto attr_l = hdf5::Attribute::open(lumi_, "lumisec");
-  H5Aread(attr_l, H5T_STD_I32LE,lumi_num);
-  auto dset = hdf5::Dataset::open(lumi_, "Event_IDs");
-  unsigned int eventID[ndims];
-  hsize_t coords[ndims]; 
-  coords[0] = iEventIndex;
-  auto fspace = hdf5::Dataspace::get_space(dset);
-  auto mspace = hdf5::Dataspace::create_simple(1, &ndims, NULL); 
-  H5Sselect_elements(fspace, H5S_SELECT_SET, 1, (const hsize_t *)&coords);
-  H5Dread(dset, H5T_STD_I32LE, mspace, fspace, H5P_DEFAULT, eventID); 
-  eventID_ = {run_num[0], lumi_num[0], eventID[0]};
-  hsize_t start[1];
-  hsize_t count[1];
-  long unsigned int begin;
-  long unsigned int end;
-  std::vector<product_t> products;
-  products.reserve(productInfos_.size());
-  for (auto pi : productInfos_) {
-      std::tie(begin, end) = getEventOffsets(iEventIndex, pi.name());
-      auto prods_dset = hdf5::Dataset::open(lumi_, (pi.name()).c_str());
-      auto prods_fspace = hdf5::Dataspace::get_space(prods_dset);
-      hsize_t dp_sz[1];
-      dp_sz[0] = end-begin;
-      auto prods_mspace = hdf5::Dataspace::create_simple(1, &dp_sz[0], NULL); 
-      //std::cout << "Reading: " << pi.name() << ", Begin at: " << begin << ", and end at : " << end << '\n';
-      std::unique_ptr<char[]> product(new char[dp_sz[0]]);
-      start[0]  = begin;
-      count[0]  = dp_sz[0];
-      prods_fspace.select_hyperslab(start, count);
-      H5Dread(prods_dset, H5T_NATIVE_CHAR, prods_mspace, prods_fspace, H5P_DEFAULT, product.get());
-      products.push_back({product.get(), product.get() + dp_sz[0]});
+  if(iEventIndex >= static_cast<long>(eventIDs_.size())) {
+    return false;
+  }
+  eventID_ = {run_, lumi_num_, eventIDs_[iEventIndex]};
+  TBufferFile bufferFile{TBuffer::kRead};
+  unsigned int productIndex = 0;
+  for (auto& pd : productDatasets_) {
+    if(iEventIndex < pd.firstEvent_ or iEventIndex >= pd.firstEvent_ + pd.nEvents_) {
+      readBlock(pd, iEventIndex);
+    }
+    auto [begin, end] = getEventOffsets(iEventIndex, pd);
+    auto const blockBegin = getEventOffsets(pd.firstEvent_, pd).first;
+    deserializeDataProduct(productIndex++, pd.block_.data()+(begin-blockBegin), end-begin, bufferFile);
   }
-
-  deserializeDataProducts(products.begin(), products.end());
   return true;
 }
 
-void HDFSource::deserializeDataProducts(buffer_iterator it, buffer_iterator itEnd) {
-  int productIndex = 0;
-  TBufferFile bufferFile{TBuffer::kRead};
-  while(it < itEnd) {
-    auto const & product = *(it);
-    auto storedSize = product.size();
-    bufferFile.SetBuffer(const_cast<char*>(reinterpret_cast<char const*>(&product[0])), storedSize, kFALSE);
-    dataProducts_[productIndex].classType()->ReadBuffer(bufferFile, dataBuffers_[productIndex]);
-    dataProducts_[productIndex].setSize(bufferFile.Length());
-    //std::cout <<"Product Name: " << dataProducts_[productIndex].name()  << "Product Index "<< productIndex << ", " << dataProducts_[productIndex].classType() << ", storedSize " << storedSize  <<" Buffer size "<<bufferFile.Length() << ", and Buffer data: " << dataBuffers_[productIndex]<< std::endl;
-    bufferFile.Reset();
-    ++productIndex;
-    ++it;
-  }
-  assert(it==itEnd);
+void HDFSource::deserializeDataProduct(unsigned int iIndex, char const* iBuffer, std::size_t iSize, TBufferFile& bufferFile) {
+  bufferFile.SetBuffer(const_cast<char*>(iBuffer), iSize, kFALSE);
+  dataProducts_[iIndex].classType()->ReadBuffer(bufferFile, dataBuffers_[iIndex]);
+  dataProducts_[iIndex].setSize(bufferFile.Length());
+  bufferFile.Reset();
 }
 
 namespace {
@@ -174,7 +183,13 @@ namespace {
           std::cout <<"no file name given\n";
           return {};
         }
-        return std::make_unique<ReplicatedSharedSource<HDFSource>>(iNLanes, iNEvents, *fileName);
+        ProductSelector selector{params.get<std::string>("products", "")};
+        auto eventsPerRead = params.get<int>("eventsPerRead", 1);
+        if(eventsPerRead < 1) {
+          std::cout <<"eventsPerRead for HDFSource must be at least 1\n";
+          return {};
+        }
+        return makeReplicatedSource<HDFSource>(iNLanes, iNEvents, params, *fileName, selector, static_cast<unsigned int>(eventsPerRead));
     }
     };
 
@@ -10,9 +10,12 @@
 #include "DataProductRetriever.h"
 #include "DelayedProductRetriever.h"
 #include "SourceBase.h"
+#include "ProductSelector.h"
 
 #include "HDFCxx.h"
 
+class TBufferFile;
+
 namespace cce::tf {
 class HDFDelayedRetriever : public DelayedProductRetriever {
   void getAsync(DataProductRetriever&, int index, TaskHolder) override {}
@@ -20,7 +23,7 @@ class HDFDelayedRetriever : public DelayedProductRetriever {
 
 class HDFSource : public SourceBase {
 public:
-  HDFSource(std::string const& iName);
+  HDFSource(std::string const& iName, ProductSelector const& iSelector = ProductSelector(), unsigned int iEventsPerRead = 1);
   HDFSource(HDFSource&&) = default;
   HDFSource(HDFSource const&) = default;
   ~HDFSource();
@@ -38,15 +41,34 @@ public:
   size_t numberOfDataProducts() const final {return productInfos_.size();}
   std::vector<DataProductRetriever>& dataProducts() final {return dataProducts_;}
   EventIdentifier eventIdentifier() final { return eventID_;}
-  using buffer_iterator = std::vector<std::vector<char>>::const_iterator;
+  std::optional<long> numberOfEvents() const final { return eventIDs_.size(); }
 
 private: 
+  //The dataset of a data product is kept open for the life of the source and its
+  // table of offsets is read once when the file is opened
+  struct ProductDataset {
+    ProductDataset(hid_t iGroup, std::string const& iName);
+    hdf5::Dataset products_;
+    //end of the bytes of each event
+    std::vector<unsigned long long> ends_;
+    //bytes of events [firstEvent_, firstEvent_+nEvents_) taken with one read
+    std::vector<char> block_;
+    long firstEvent_ = 0;
+    long nEvents_ = 0;
+  };
+
   std::vector<std::string> readClassNames();
-  std::pair<long unsigned int, long unsigned int> getEventOffsets(long eventindex, std::string const& pname);
+  std::pair<long unsigned int, long unsigned int> getEventOffsets(long eventindex, ProductDataset const&) const;
+  void readBlock(ProductDataset&, long iEventIndex) const;
   bool readEvent(long iEventIndex) final; //returns true if an event was read
-  void deserializeDataProducts(buffer_iterator, buffer_iterator);
+  void deserializeDataProduct(unsigned int iIndex, char const* iBuffer, std::size_t iSize, TBufferFile&);
   hdf5::File file_;
   hdf5::Group lumi_;
+  std::vector<ProductDataset> productDatasets_;
+  std::vector<unsigned int> eventIDs_;
+  unsigned int run_ = 0;
+  unsigned int lumi_num_ = 0;
+  unsigned int eventsPerRead_;
   EventIdentifier eventID_;
   std::vector<DataProductRetriever> dataProducts_; 
   std::vector<void*> dataBuffers_;  
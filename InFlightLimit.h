@@ -0,0 +1,102 @@
+#if !defined(InFlightLimit_h)
+#define InFlightLimit_h
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace cce::tf {
+  /**
+     Counts the events, and their bytes, an Outputer holds before they are
+     written. Functions passed to whenRoom are held while either count is at
+     or above its limit and are called once enough events were removed. A
+     limit of 0 means no limit.
+
+     Holding a Lane's read of its next event this way keeps the Source from
+     racing ahead of slow storage.
+   */
+  class InFlightLimit {
+  public:
+    InFlightLimit(unsigned long long iMaxEvents, unsigned long long iMaxBytes):
+      maxEvents_{iMaxEvents}, maxBytes_{iMaxBytes} {}
+
+    InFlightLimit(InFlightLimit const&) = delete;
+    InFlightLimit& operator=(InFlightLimit const&) = delete;
+
+    void add(unsigned long long iBytes) {
+      std::lock_guard<std::mutex> guard(mutex_);
+      ++events_;
+      bytes_ += iBytes;
+      if(events_ > maxEventsHeld_) {
+        maxEventsHeld_ = events_;
+      }
+      if(bytes_ > maxBytesHeld_) {
+        maxBytesHeld_ = bytes_;
+      }
+    }
+
+    //iBytes must be the value given to the matching add
+    void remove(unsigned long long iBytes) {
+      std::vector<std::function<void()>> ready;
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        --events_;
+        bytes_ -= iBytes;
+        if(waiting_.empty() or full()) {
+          return;
+        }
+        auto const now = std::chrono::steady_clock::now();
+        waitTime_ += std::chrono::duration_cast<std::chrono::microseconds>(now - waitStart_)*waiting_.size();
+        ready.swap(waiting_);
+      }
+      //called without the lock as they may add events
+      for(auto& f: ready) {
+        f();
+      }
+    }
+
+    //iReady is called now if there is room, else once there is
+    void whenRoom(std::function<void()> iReady) {
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if(full()) {
+          if(waiting_.empty()) {
+            waitStart_ = std::chrono::steady_clock::now();
+          }
+          ++nWaited_;
+          waiting_.push_back(std::move(iReady));
+          return;
+        }
+      }
+      iReady();
+    }
+
+    unsigned long long maxEvents() const { return maxEvents_; }
+    unsigned long long maxBytes() const { return maxBytes_; }
+    unsigned long long maxEventsHeld() const { return maxEventsHeld_; }
+    unsigned long long maxBytesHeld() const { return maxBytesHeld_; }
+    //number of times whenRoom had to hold its function
+    unsigned long long nWaited() const { return nWaited_; }
+    //summed over the held functions, measured from when the first of them was held
+    std::chrono::microseconds waitTime() const { return waitTime_; }
+
+  private:
+    bool full() const {
+      return (maxEvents_ != 0 and events_ >= maxEvents_) or (maxBytes_ != 0 and bytes_ >= maxBytes_);
+    }
+
+    unsigned long long const maxEvents_;
+    unsigned long long const maxBytes_;
+    std::mutex mutex_;
+    unsigned long long events_ = 0;
+    unsigned long long bytes_ = 0;
+    std::vector<std::function<void()>> waiting_;
+    std::chrono::steady_clock::time_point waitStart_;
+    unsigned long long maxEventsHeld_ = 0;
+    unsigned long long maxBytesHeld_ = 0;
+    unsigned long long nWaited_ = 0;
+    std::chrono::microseconds waitTime_ = std::chrono::microseconds::zero();
+  };
+}
+#endif
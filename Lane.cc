@@ -1,80 +1,574 @@
 #include <utility>
 #include <iostream>
 #include <string>
+#include <algorithm>
+#include <tuple>
 
 #include "Lane.h"
 #include "FunctorTask.h"
+#include "Tracer.h"
 
 using namespace cce::tf;
 
-Lane::Lane(unsigned int iIndex, SharedSourceBase* iSource, WaiterBase const* iWaiter): source_(iSource), waiter_(iWaiter), index_{iIndex} {
+Lane::Lane(unsigned int iIndex, SharedSourceBase* iSource, WaiterBase const* iWaiter, unsigned int iPrefetchDepth):
+  source_(iSource), waiter_(iWaiter), taskPool_{std::make_unique<TaskPool>()},
+  latencies_{std::make_unique<LatencyHistogram>()},
+  slotsMutex_{std::make_unique<std::mutex>()},
+  slots_(std::max(iPrefetchDepth, 1U)), readOrder_(slots_.size(),0),
+  index_{iIndex} {
 }
 
 void Lane::processEventsAsync(std::atomic<long>& index, tbb::task_group& group, const OutputerBase& outputer, 
 			      TaskHolder finalTask) {
-  doNextEvent(index, group,  outputer, std::move(finalTask));
+  eventIndex_ = &index;
+  group_ = &group;
+  outputer_ = &outputer;
+  {
+    std::lock_guard<std::mutex> guard(*slotsMutex_);
+    //indices left from a previous call were not used
+    endReached_ = false;
+    nextIndexInChunk_ = 0;
+    endOfChunk_ = 0;
+  }
+#if defined(TF_ENABLE_COROUTINES)
+  if(useCoroutine_) {
+    processEventsCoroutine(*taskPool_, std::move(finalTask));
+    return;
+  }
+#endif
+  issueReads(finalTask);
+}
+
+void Lane::resetStatistics() {
+  nEventsProcessed_ = 0;
+  nPrefetchedEvents_ = 0;
+  latencies_ = std::make_unique<LatencyHistogram>();
 }
 
 
-TaskHolder Lane::makeWaiterTask(tbb::task_group& group, size_t index, TaskHolder holder) {
+TaskHolder Lane::makeWaiterTask(unsigned int iSlot, size_t index, TaskHolder holder) {
   if(not waiter_) {
     return holder;
   } else {  
-    return TaskHolder(group,
-                      make_functor_task([index,  holder, this]() {
-                          waiter_->waitAsync(index_, 
-                                             source_->eventIdentifier(index_, presentEventIndex_),
-                                             presentEventIndex_,
-                                             dataProducts(),index, std::move(holder));
+    return TaskHolder(*group_,
+                      make_functor_task(*taskPool_, [index, iSlot, holder, this]() {
+                          auto const laneIndex = sourceLaneIndex(iSlot);
+                          auto const eventIndex = slots_[iSlot].eventIndex_;
+                          waiter_->waitAsync(laneIndex,
+                                             source_->eventIdentifier(laneIndex, eventIndex),
+                                             eventIndex,
+                                             dataProducts(iSlot),index, std::move(holder));
                         }) );
   }
 }
 
-TaskHolder Lane::makeTaskForDataProduct(tbb::task_group& group, size_t index, DataProductRetriever& iDP, OutputerBase const& outputer, TaskHolder holder) {
-  if(outputer.usesProductReadyAsync()) {
-    auto laneIndex = this->index_;
-    return makeWaiterTask(group, index,TaskHolder(group, 
-                                                  make_functor_task([holder, laneIndex, &iDP, &outputer]() {
-                                                      outputer.productReadyAsync(laneIndex, iDP, std::move(holder));
+TaskHolder Lane::makeTaskForDataProduct(unsigned int iSlot, size_t index, DataProductRetriever& iDP, TaskHolder holder) {
+  if(outputer_->usesProductReadyAsync()) {
+    auto laneIndex = sourceLaneIndex(iSlot);
+    auto outputer = outputer_;
+    return makeWaiterTask(iSlot, index,TaskHolder(*group_, 
+                                                  make_functor_task(*taskPool_, [holder, laneIndex, &iDP, outputer]() {
+                                                      outputer->productReadyAsync(laneIndex, iDP, std::move(holder));
                                                     })));
   } else {
-    return makeWaiterTask(group, index, holder);
+    return makeWaiterTask(iSlot, index, holder);
   }
 }
 
-void Lane::processEventAsync(tbb::task_group& group, TaskHolder iCallback, const OutputerBase& outputer) { 
+void Lane::processEventAsync(unsigned int iSlot, TaskHolder iCallback) { 
   //Process order: retrieve data product, do wait, serialize, do output, call iCallback 
   
   //std::cout <<"make process event task"<<std::endl;
-  TaskHolder holder(group, 
-                    make_functor_task([&outputer, this, callback=std::move(iCallback)]() {
-                        outputer.outputAsync(this->index_, source_->eventIdentifier(index_, presentEventIndex_),
-                                             std::move(callback));
+  TaskHolder holder(*group_, 
+                    make_functor_task(*taskPool_, [this, iSlot, callback=std::move(iCallback)]() {
+                        auto const laneIndex = sourceLaneIndex(iSlot);
+                        auto const eventIndex = slots_[iSlot].eventIndex_;
+                        outputer_->outputAsync(laneIndex, eventIndex, source_->eventIdentifier(laneIndex, eventIndex),
+                                               std::move(callback));
                       }));
   
+  getDataProductsAsync(iSlot, holder);
+}
+
+void Lane::getDataProductsAsync(unsigned int iSlot, TaskHolder const& iHolder) {
+  auto& dataProducts = mutableDataProducts(iSlot);
+  if(neededProducts_) {
+    for(auto index: *neededProducts_) {
+      auto& d = dataProducts[index];
+      d.getAsync(makeTaskForDataProduct(iSlot, index, d, iHolder));
+    }
+    return;
+  }
   //NOTE: I once replaced with with a tbb::parallel_for but that made the code slower and did not
   // scale as well as the number of threads were increased.
   size_t index=0;
-  for(auto& d: mutableDataProducts()) {
-    d.getAsync(makeTaskForDataProduct(group, index,d, outputer, holder));
+  for(auto& d: dataProducts) {
+    d.getAsync(makeTaskForDataProduct(iSlot, index,d, iHolder));
     ++index;
   }
 }
 
-void Lane::doNextEvent(std::atomic<long>& index, tbb::task_group& group,  const OutputerBase& outputer, TaskHolder finalTask) {
-  using namespace std::string_literals;
-  presentEventIndex_ = index++;
-  if(source_->mayBeAbleToGoToEvent(presentEventIndex_)) {
+long Lane::nextEventIndex() {
+  //Claiming a block of indices at once avoids having all Lanes contend on
+  // the shared counter for every event. Since mayBeAbleToGoToEvent only
+  // becomes false once the end is reached, any indices left in the block
+  // after that are also beyond the end and can be dropped.
+  if(nextIndexInChunk_ == endOfChunk_) {
+    //a batch takes one index per slot so it never spans two blocks
+    auto const chunkSize = indexChunkSize();
+    if(indexClaimer_) {
+      std::tie(nextIndexInChunk_, endOfChunk_) = indexClaimer_->claimRange(chunkSize);
+    } else {
+      nextIndexInChunk_ = eventIndex_->fetch_add(chunkSize);
+      endOfChunk_ = nextIndexInChunk_ + chunkSize;
+    }
+  }
+  return nextIndexInChunk_++;
+}
+
+void Lane::issueReads(TaskHolder const& finalTask) {
+  if(batchEvents_) {
+    issueBatchRead(finalTask);
+    return;
+  }
+  if(slots_.size() == 1) {
+    issueSingleRead(finalTask);
+    return;
+  }
+  //start reading an event into each idle slot
+  while(true) {
+    unsigned int slotIndex = 0;
+    long eventIndex = 0;
+    {
+      std::lock_guard<std::mutex> guard(*slotsMutex_);
+      if(endReached_) {
+        return;
+      }
+      auto itSlot = std::find_if(slots_.begin(), slots_.end(), [](auto const& iSlot) { return iSlot.state_ == SlotState::kIdle;});
+      if(itSlot == slots_.end()) {
+        return;
+      }
+      eventIndex = nextEventIndex();
+      if(eventIndex >= endIndex_ or (stop_ and stop_->load(std::memory_order_relaxed)) or
+         not source_->mayBeAbleToGoToEvent(eventIndex)) {
+        endReached_ = true;
+        return;
+      }
+      slotIndex = itSlot - slots_.begin();
+      itSlot->state_ = SlotState::kReading;
+      itSlot->eventIndex_ = eventIndex;
+      itSlot->readStart_ = std::chrono::steady_clock::now();
+      readOrder_[(readOrderBegin_+readOrderSize_) % readOrder_.size()] = slotIndex;
+      ++readOrderSize_;
+    }
     if(verbose_) {
-      std::cout <<"event "+std::to_string(presentEventIndex_)+"\n"<<std::flush;
+      std::cout <<"event "+std::to_string(eventIndex)+"\n"<<std::flush;
     }
     
-    OptionalTaskHolder processEventTask(group, make_functor_task([this,&index, &group, &outputer, finalTask=std::move(finalTask)]() {
-          TaskHolder recursiveTask(group, make_functor_task([this, &index, &group, &outputer, finalTask=std::move(finalTask)]() {
-                doNextEvent(index, group, outputer, std::move(finalTask));
-              }));
-          processEventAsync(group, std::move(recursiveTask), outputer);
+    OptionalTaskHolder readTask(*group_, make_functor_task(*taskPool_, [this, slotIndex, request = ReadRequest(this, slotIndex, finalTask)]() mutable {
+          readFinished(slotIndex, request.succeeded());
         }) );
-    source_->gotoEventAsync(this->index_, presentEventIndex_, std::move(processEventTask));
+    startRead(slotIndex, eventIndex, 1, std::move(readTask));
+  }
+}
+
+void Lane::issueSingleRead(TaskHolder const& finalTask) {
+  //only one step of the Lane's one event is going on at a time, the tasks order the accesses to the slot
+  if(endReached_) {
+    return;
+  }
+  auto const eventIndex = nextEventIndex();
+  if(eventIndex >= endIndex_ or (stop_ and stop_->load(std::memory_order_relaxed)) or
+     not source_->mayBeAbleToGoToEvent(eventIndex)) {
+    endReached_ = true;
+    return;
+  }
+  auto& slot = slots_[0];
+  slot.state_ = SlotState::kReading;
+  slot.eventIndex_ = eventIndex;
+  slot.readStart_ = std::chrono::steady_clock::now();
+  if(verbose_) {
+    std::cout <<"event "+std::to_string(eventIndex)+"\n"<<std::flush;
+  }
+
+  OptionalTaskHolder readTask(*group_, make_functor_task(*taskPool_, [this, request = ReadRequest(this, 0, finalTask)]() mutable {
+        readFinished(0, request.succeeded());
+      }) );
+  startRead(0, eventIndex, 1, std::move(readTask));
+}
+
+void Lane::startRead(unsigned int iSlot, long iEventIndex, unsigned int iNEvents, OptionalTaskHolder iReadTask) {
+  auto read = [this, iSlot, iEventIndex, iNEvents](OptionalTaskHolder iTask) {
+    if(iNEvents == 1) {
+      source_->gotoEventAsync(sourceLaneIndex(iSlot), iEventIndex, std::move(iTask));
+    } else {
+      source_->gotoEventsAsync(sourceLaneIndex(iSlot), iEventIndex, iNEvents, std::move(iTask));
+    }
+  };
+  if(outputer_->usesReadyForEventAsync() or readArena_) {
+    auto startRead = [&]() {
+      TaskHolder readHolder(*group_, make_functor_task(*taskPool_, [read, readTask = std::move(iReadTask)]() mutable {
+            read(std::move(readTask));
+          }));
+      if(readArena_) {
+        return inArena(*readArena_, std::move(readHolder));
+      }
+      return readHolder;
+    }();
+    if(outputer_->usesReadyForEventAsync()) {
+      //the Outputer may have too many events waiting to be written
+      outputer_->readyForEventAsync(sourceLaneIndex(iSlot), std::move(startRead));
+    } else {
+      startRead.doneWaiting();
+    }
+    return;
+  }
+  read(std::move(iReadTask));
+}
+
+void Lane::issueBatchRead(TaskHolder const& finalTask) {
+  //claim one event per slot once all the slots are idle
+  long firstEventIndex = 0;
+  unsigned int nEvents = 0;
+  {
+    std::lock_guard<std::mutex> guard(*slotsMutex_);
+    if(endReached_) {
+      return;
+    }
+    if(std::any_of(slots_.begin(), slots_.end(), [](auto const& iSlot) { return iSlot.state_ != SlotState::kIdle;})) {
+      return;
+    }
+    auto const now = std::chrono::steady_clock::now();
+    for(auto& slot: slots_) {
+      if(nEvents != 0 and nextIndexInChunk_ == endOfChunk_) {
+        //the events of a batch are consecutive and a claimer may end a block within a batch
+        break;
+      }
+      auto const eventIndex = nextEventIndex();
+      if(eventIndex >= endIndex_ or (stop_ and stop_->load(std::memory_order_relaxed)) or
+         not source_->mayBeAbleToGoToEvent(eventIndex)) {
+        endReached_ = true;
+        break;
+      }
+      if(nEvents == 0) {
+        firstEventIndex = eventIndex;
+      }
+      slot.state_ = SlotState::kReading;
+      slot.eventIndex_ = eventIndex;
+      slot.readStart_ = now;
+      ++nEvents;
+    }
+    if(nEvents == 0) {
+      return;
+    }
+  }
+  if(verbose_) {
+    std::cout <<"events "+std::to_string(firstEventIndex)+" to "+std::to_string(firstEventIndex+nEvents-1)+"\n"<<std::flush;
+  }
+  OptionalTaskHolder readTask(*group_, make_functor_task(*taskPool_, [this, nEvents, request = ReadRequest(this, 0, finalTask, nEvents)]() mutable {
+        batchReadFinished(nEvents, request.succeeded());
+      }) );
+  startRead(0, firstEventIndex, nEvents, std::move(readTask));
+}
+
+void Lane::batchReadFinished(unsigned int iNEvents, TaskHolder finalTask) {
+  auto const now = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> guard(*slotsMutex_);
+    for(unsigned int i = 0; i < iNEvents; ++i) {
+      auto& slot = slots_[i];
+      slot.state_ = SlotState::kProcessing;
+      slot.readDone_ = now;
+      slot.processStart_ = now;
+    }
+    nEventsProcessed_ += iNEvents;
+  }
+  auto process = [this, iNEvents, finalTask = std::move(finalTask)]() mutable {
+    TaskHolder batchDoneTask(*group_, make_functor_task(*taskPool_, [this, iNEvents, finalTask = std::move(finalTask)]() mutable {
+          batchFinished(iNEvents, std::move(finalTask));
+        }));
+    if(activeLaneLimit_) {
+      //the whole batch holds one token
+      TaskHolder processTask(*group_, make_functor_task(*taskPool_, [this, iNEvents, done=std::move(batchDoneTask)]() mutable {
+            processBatchAsync(iNEvents, std::move(done));
+          }));
+      activeLaneLimit_->acquire([processTask]() mutable { processTask.doneWaiting(); });
+      return;
+    }
+    processBatchAsync(iNEvents, std::move(batchDoneTask));
+  };
+  if(processArena_) {
+    //the read ran in readArena_
+    using Process = decltype(process);
+    processArena_->enqueue([process = std::move(process)]() { const_cast<Process&>(process)(); });
+    return;
+  }
+  process();
+}
+
+void Lane::processBatchAsync(unsigned int iNEvents, TaskHolder iCallback) {
+  TaskHolder holder(*group_,
+                    make_functor_task(*taskPool_, [this, iNEvents, callback=std::move(iCallback)]() {
+                        batchEventIDs_.clear();
+                        for(unsigned int i = 0; i < iNEvents; ++i) {
+                          batchEventIDs_.push_back(source_->eventIdentifier(sourceLaneIndex(i), slots_[i].eventIndex_));
+                        }
+                        outputer_->outputEventsAsync(sourceLaneIndex(0), slots_[0].eventIndex_, batchEventIDs_, std::move(callback));
+                      }));
+  for(unsigned int slot = 0; slot < iNEvents; ++slot) {
+    getDataProductsAsync(slot, holder);
+  }
+}
+
+void Lane::batchFinished(unsigned int iNEvents, TaskHolder finalTask) {
+  {
+    std::lock_guard<std::mutex> guard(*slotsMutex_);
+    auto const now = std::chrono::steady_clock::now();
+    for(unsigned int i = 0; i < iNEvents; ++i) {
+      auto& slot = slots_[i];
+      latencies_->record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - slot.readStart_).count());
+      slot.state_ = SlotState::kIdle;
+    }
+    if(Tracer::enabled()) {
+      Tracer::recordForLane(index_, "read", "lane", slots_[0].readStart_, slots_[0].readDone_);
+      Tracer::recordForLane(index_, "process", "lane", slots_[0].processStart_, now);
+    }
+  }
+  if(activeLaneLimit_) {
+    activeLaneLimit_->release();
+  }
+  issueBatchRead(finalTask);
+}
+
+TaskHolder Lane::inArena(tbb::task_arena& iArena, TaskHolder iTask) {
+  return TaskHolder(*group_, make_functor_task(*taskPool_, [&iArena, task = std::move(iTask)]() mutable {
+        //the task is spawned from within iArena
+        iArena.enqueue([task = std::move(task)]() { const_cast<TaskHolder&>(task).doneWaiting(); });
+      }));
+}
+
+void Lane::readFinished(unsigned int iSlot, TaskHolder finalTask) {
+  if(slots_.size() == 1) {
+    if(Tracer::enabled()) {
+      slots_[0].readDone_ = Tracer::Clock::now();
+    }
+    if(processArena_) {
+      //the read ran in readArena_
+      processArena_->enqueue([this, finalTask]() { processSingleEvent(finalTask); });
+      return;
+    }
+    processSingleEvent(std::move(finalTask));
+    return;
+  }
+  std::optional<TaskHolder> keepLaneRunning;
+  if(processArena_) {
+    keepLaneRunning.emplace(finalTask);
+  }
+  {
+    std::lock_guard<std::mutex> guard(*slotsMutex_);
+    auto& slot = slots_[iSlot];
+    slot.state_ = SlotState::kReady;
+    slot.finalTask_.emplace(std::move(finalTask));
+    if(Tracer::enabled()) {
+      slot.readDone_ = Tracer::Clock::now();
+    }
+    if(processing_) {
+      ++nPrefetchedEvents_;
+    }
+  }
+  if(processArena_) {
+    //the read ran in readArena_
+    processArena_->enqueue([this, keep = std::move(*keepLaneRunning)]() { tryToProcessNextEvent(); });
+    return;
+  }
+  tryToProcessNextEvent();
+}
+
+void Lane::readFailed(unsigned int iSlot) {
+  if(slots_.size() == 1) {
+    //the Source has no more events
+    endReached_ = true;
+    slots_[0].state_ = SlotState::kIdle;
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(*slotsMutex_);
+    //the Source has no more events
+    endReached_ = true;
+    slots_[iSlot].state_ = SlotState::kIdle;
+    //remove the slot from the read order
+    unsigned int nKept = 0;
+    for(unsigned int i = 0; i < readOrderSize_; ++i) {
+      auto s = readOrder_[(readOrderBegin_+i) % readOrder_.size()];
+      if(s != iSlot) {
+        readOrder_[(readOrderBegin_+nKept) % readOrder_.size()] = s;
+        ++nKept;
+      }
+    }
+    readOrderSize_ = nKept;
+  }
+  //a later event may already be waiting
+  tryToProcessNextEvent();
+}
+
+void Lane::tryToProcessNextEvent() {
+  //events are processed one at a time in the order they were claimed
+  unsigned int slotIndex;
+  std::optional<TaskHolder> finalTask;
+  {
+    std::lock_guard<std::mutex> guard(*slotsMutex_);
+    if(processing_ or readOrderSize_ == 0) {
+      return;
+    }
+    slotIndex = readOrder_[readOrderBegin_];
+    auto& slot = slots_[slotIndex];
+    if(slot.state_ != SlotState::kReady) {
+      return;
+    }
+    readOrderBegin_ = (readOrderBegin_+1) % readOrder_.size();
+    --readOrderSize_;
+    processing_ = true;
+    slot.state_ = SlotState::kProcessing;
+    if(Tracer::enabled()) {
+      slot.processStart_ = Tracer::Clock::now();
+    }
+    finalTask.emplace(std::move(*slot.finalTask_));
+    slot.finalTask_.reset();
+    ++nEventsProcessed_;
+  }
+  startProcessing(slotIndex, std::move(*finalTask));
+}
+
+void Lane::processSingleEvent(TaskHolder finalTask) {
+  auto& slot = slots_[0];
+  slot.state_ = SlotState::kProcessing;
+  if(Tracer::enabled()) {
+    slot.processStart_ = Tracer::Clock::now();
+  }
+  ++nEventsProcessed_;
+  startProcessing(0, std::move(finalTask));
+}
+
+void Lane::startProcessing(unsigned int iSlot, TaskHolder finalTask) {
+  TaskHolder eventDoneTask(*group_, make_functor_task(*taskPool_, [this, iSlot, finalTask=std::move(finalTask)]() mutable {
+        eventFinished(iSlot, std::move(finalTask));
+      }));
+  if(activeLaneLimit_) {
+    //when parked, the Lane is resumed from the thread of the Lane releasing its token
+    TaskHolder process(*group_, make_functor_task(*taskPool_, [this, iSlot, done=std::move(eventDoneTask)]() mutable {
+          processEventAsync(iSlot, std::move(done));
+        }));
+    activeLaneLimit_->acquire([process]() mutable { process.doneWaiting(); });
+    return;
+  }
+  processEventAsync(iSlot, std::move(eventDoneTask));
+}
+
+void Lane::recordEventDone(Slot& iSlot) {
+  auto const now = std::chrono::steady_clock::now();
+  latencies_->record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - iSlot.readStart_).count());
+  if(Tracer::enabled()) {
+    Tracer::recordForLane(index_, "read", "lane", iSlot.readStart_, iSlot.readDone_);
+    if(iSlot.processStart_ > iSlot.readDone_) {
+      Tracer::recordForLane(index_, "wait for lane", "lane", iSlot.readDone_, iSlot.processStart_);
+    }
+    Tracer::recordForLane(index_, "process", "lane", iSlot.processStart_, now);
+  }
+  iSlot.state_ = SlotState::kIdle;
+}
+
+void Lane::eventFinished(unsigned int iSlot, TaskHolder finalTask) {
+  if(slots_.size() == 1) {
+    recordEventDone(slots_[0]);
+    if(activeLaneLimit_) {
+      activeLaneLimit_->release();
+    }
+    issueSingleRead(finalTask);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(*slotsMutex_);
+    recordEventDone(slots_[iSlot]);
+    processing_ = false;
+  }
+  if(activeLaneLimit_) {
+    activeLaneLimit_->release();
+  }
+  issueReads(finalTask);
+  tryToProcessNextEvent();
+}
+
+#if defined(TF_ENABLE_COROUTINES)
+bool Lane::claimEvent(long& oEventIndex) {
+  std::lock_guard<std::mutex> guard(*slotsMutex_);
+  if(endReached_) {
+    return false;
+  }
+  oEventIndex = nextEventIndex();
+  if(oEventIndex >= endIndex_ or (stop_ and stop_->load(std::memory_order_relaxed)) or
+     not source_->mayBeAbleToGoToEvent(oEventIndex)) {
+    endReached_ = true;
+    return false;
+  }
+  auto& slot = slots_[0];
+  slot.state_ = SlotState::kReading;
+  slot.eventIndex_ = oEventIndex;
+  slot.readStart_ = std::chrono::steady_clock::now();
+  return true;
+}
+
+PooledCoroutine Lane::processEventsCoroutine(TaskPool& iPool, TaskHolder iFinalTask) {
+  //iFinalTask is released when the coroutine ends
+  auto& group = *group_;
+  auto const laneIndex = sourceLaneIndex(0);
+  long eventIndex = 0;
+  while(claimEvent(eventIndex)) {
+    if(verbose_) {
+      std::cout <<"event "+std::to_string(eventIndex)+"\n"<<std::flush;
+    }
+    if(outputer_->usesReadyForEventAsync()) {
+      co_await whenDone(group, iPool, [this, laneIndex](TaskHolder iDone) { outputer_->readyForEventAsync(laneIndex, std::move(iDone)); });
+    }
+    bool const read = co_await whenRun(group, iPool, [this, laneIndex, eventIndex](OptionalTaskHolder iRead) {
+        source_->gotoEventAsync(laneIndex, eventIndex, std::move(iRead));
+      });
+    if(not read) {
+      std::lock_guard<std::mutex> guard(*slotsMutex_);
+      endReached_ = true;
+      slots_[0].state_ = SlotState::kIdle;
+      break;
+    }
+    auto& slot = slots_[0];
+    slot.readDone_ = std::chrono::steady_clock::now();
+    if(activeLaneLimit_) {
+      co_await whenDone(group, iPool, [this](TaskHolder iDone) {
+          activeLaneLimit_->acquire([iDone]() mutable { iDone.doneWaiting(); });
+        });
+    }
+    slot.state_ = SlotState::kProcessing;
+    slot.processStart_ = std::chrono::steady_clock::now();
+    ++nEventsProcessed_;
+
+    co_await whenDone(group, iPool, [this](TaskHolder iDone) {
+        getDataProductsAsync(0, iDone);
+      });
+    co_await whenDone(group, iPool, [this, laneIndex, eventIndex](TaskHolder iDone) {
+        outputer_->outputAsync(laneIndex, eventIndex, source_->eventIdentifier(laneIndex, eventIndex), std::move(iDone));
+      });
+
+    auto const now = std::chrono::steady_clock::now();
+    {
+      std::lock_guard<std::mutex> guard(*slotsMutex_);
+      latencies_->record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - slot.readStart_).count());
+      if(Tracer::enabled()) {
+        Tracer::recordForLane(index_, "read", "lane", slot.readStart_, slot.readDone_);
+        Tracer::recordForLane(index_, "process", "lane", slot.processStart_, now);
+      }
+      slot.state_ = SlotState::kIdle;
+    }
+    if(activeLaneLimit_) {
+      activeLaneLimit_->release();
+    }
   }
 }
+#endif
@@ -4,41 +4,224 @@
 #include <vector>
 #include <atomic>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <limits>
+#include <chrono>
 
 #include "tbb/task_group.h"
+#include "tbb/task_arena.h"
 
 #include "SharedSourceBase.h"
 #include "OutputerBase.h"
 #include "WaiterBase.h"
+#include "TaskPool.h"
+#include "LatencyHistogram.h"
+#include "ActiveLaneLimit.h"
+#include "EventIndexClaimer.h"
+#include "PerLaneCounter.h"
+#if defined(TF_ENABLE_COROUTINES)
+#include "LaneCoroutine.h"
+#endif
 
 namespace cce::tf {
-class Lane {
+//each Lane updates its members for every event, keep them off the cache lines of other Lanes
+class alignas(kCacheLineSize) Lane {
 public:
-  Lane(unsigned int iIndex, SharedSourceBase* iSource, WaiterBase const* iWaiter);
+  //A Lane processes one event at a time. With iPrefetchDepth > 1 the Lane
+  // also asks the Source to read up to iPrefetchDepth-1 additional events
+  // while the present event is being processed. Each of those events needs
+  // its own slot in the Source, Waiter and Outputer so the Lane uses the lane
+  // indices [iIndex*iPrefetchDepth, (iIndex+1)*iPrefetchDepth) for those.
+  Lane(unsigned int iIndex, SharedSourceBase* iSource, WaiterBase const* iWaiter, unsigned int iPrefetchDepth=1);
 
+  //Can be called again once the previous call has finished, e.g. to process more events after a warm up.
   void processEventsAsync(std::atomic<long>& index, tbb::task_group& group, const OutputerBase& outputer, TaskHolder finalTask);
 
+  //no events with an index at or beyond this are started
+  void setEndIndex(long iIndex) { endIndex_ = iIndex; }
+  //once the flag is set no further events are started
+  void setStopFlag(std::atomic<bool> const* iStop) { stop_ = iStop; }
+
+  //When set, reads are started in iReadArena and the events are processed in
+  // iProcessArena. A lower priority iReadArena makes threads finish the events
+  // already read before reading more.
+  void setArenas(tbb::task_arena* iProcessArena, tbb::task_arena* iReadArena) {
+    processArena_ = iProcessArena;
+    readArena_ = iReadArena;
+  }
+
+#if defined(TF_ENABLE_COROUTINES)
+  //process the events with a coroutine. Only for a prefetch depth of 1 and without setArenas.
+  void setUseCoroutine(bool iSet) { useCoroutine_ = iSet; }
+#endif
+
+  //When set, the Lane waits for all its slots to be idle, reads their events with one
+  // request to the Source and gives them to the Outputer together once all their
+  // data products are ready.
+  void setBatchEvents(bool iSet) { batchEvents_ = iSet; }
+
+  //when set, the Lane holds one of its tokens while processing an event
+  void setActiveLaneLimit(ActiveLaneLimit* iLimit) { activeLaneLimit_ = iLimit; }
+
+  //When set, only the data products with these indices are retrieved, in this order.
+  void setNeededProducts(std::vector<unsigned int> iOrder) { neededProducts_ = std::move(iOrder); }
+
+  //forget the events processed so far
+  void resetStatistics();
+
   void setVerbose(bool iSet) { verbose_ = iSet; }
 
-  std::vector<DataProductRetriever> const& dataProducts() const { return source_->dataProducts(index_, presentEventIndex_); }
+  //number of consecutive event indices to claim from the shared index at one time
+  void setIndexChunkSize(unsigned int iSize) { indexChunkSize_ = iSize; }
+  //when set, the chunks of indices come from iClaimer instead of the index given to processEventsAsync
+  void setIndexClaimer(EventIndexClaimer* iClaimer) { indexClaimer_ = iClaimer; }
+  //the number of indices the Lane claims at one time
+  unsigned int indexChunkSize() const {
+    auto const nSlots = static_cast<unsigned int>(slots_.size());
+    return batchEvents_ ? (indexChunkSize_+nSlots-1)/nSlots*nSlots : indexChunkSize_;
+  }
+
+  unsigned int numberOfSlots() const { return slots_.size(); }
+  //the lane index to use when talking to the Source, Waiter or Outputer for the slot
+  unsigned int sourceLaneIndex(unsigned int iSlot) const { return index_*slots_.size() + iSlot; }
 
-  long presentEventIndex() const { return presentEventIndex_;}
+  std::vector<DataProductRetriever> const& dataProducts(unsigned int iSlot = 0) const {
+    return source_->dataProducts(sourceLaneIndex(iSlot), slots_[iSlot].eventIndex_); }
+
+  TaskPool const& taskPool() const { return *taskPool_; }
+
+  unsigned long long numberOfEventsProcessed() const { return nEventsProcessed_; }
+  //number of events whose read finished while the Lane was still processing an earlier event
+  unsigned long long numberOfPrefetchedEvents() const { return nPrefetchedEvents_; }
+
+  //time in ns from asking the Source for an event until the Outputer is done with it.
+  // Can be read while the Lane is running.
+  LatencyHistogram const& eventLatencies() const { return *latencies_; }
 private:
+  enum class SlotState { kIdle, kReading, kReady, kProcessing };
+  struct Slot {
+    long eventIndex_ = -1;
+    SlotState state_ = SlotState::kIdle;
+    std::chrono::steady_clock::time_point readStart_;
+    //only set when tracing
+    std::chrono::steady_clock::time_point readDone_;
+    std::chrono::steady_clock::time_point processStart_;
+    //keeps the Lane from finishing while the event waits to be processed
+    std::optional<TaskHolder> finalTask_;
+  };
+
+  //Holds what is needed to continue once the Source has read the events of
+  // iNSlots slots starting at iSlot. If the Source drops the read task without
+  // running it, the read failed.
+  class ReadRequest {
+  public:
+    ReadRequest(Lane* iLane, unsigned int iSlot, TaskHolder iFinalTask, unsigned int iNSlots = 1):
+      finalTask_{std::move(iFinalTask)}, lane_{iLane}, slot_{iSlot}, nSlots_{iNSlots} {}
+    ReadRequest(ReadRequest&& iOther):
+      finalTask_{std::move(iOther.finalTask_)}, lane_{iOther.lane_}, slot_{iOther.slot_}, nSlots_{iOther.nSlots_} { iOther.lane_ = nullptr; }
+    ReadRequest(ReadRequest const&) = delete;
+    //finalTask_ is destroyed after readFailed is called
+    ~ReadRequest() {
+      if(lane_) {
+        for(unsigned int i = 0; i < nSlots_; ++i) {
+          lane_->readFailed(slot_+i);
+        }
+      }
+    }
+
+    TaskHolder succeeded() { lane_ = nullptr; return std::move(finalTask_); }
+  private:
+    TaskHolder finalTask_;
+    Lane* lane_;
+    unsigned int slot_;
+    unsigned int nSlots_;
+  };
 
-  std::vector<DataProductRetriever>& mutableDataProducts() { return source_->dataProducts(index_, presentEventIndex_); }
-  TaskHolder makeWaiterTask(tbb::task_group& group, size_t index, TaskHolder holder) ;
+  std::vector<DataProductRetriever>& mutableDataProducts(unsigned int iSlot) {
+    return source_->dataProducts(sourceLaneIndex(iSlot), slots_[iSlot].eventIndex_); }
+  TaskHolder makeWaiterTask(unsigned int iSlot, size_t index, TaskHolder holder) ;
 
-  TaskHolder makeTaskForDataProduct(tbb::task_group& group, size_t index, DataProductRetriever& iDP, OutputerBase const& outputer, TaskHolder holder) ;
+  TaskHolder makeTaskForDataProduct(unsigned int iSlot, size_t index, DataProductRetriever& iDP, TaskHolder holder) ;
 
-  void processEventAsync(tbb::task_group& group, TaskHolder iCallback, const OutputerBase& outputer);
+  void processEventAsync(unsigned int iSlot, TaskHolder iCallback);
+  //calls getAsync for the needed data products of the slot
+  void getDataProductsAsync(unsigned int iSlot, TaskHolder const& iHolder);
 
-  void doNextEvent(std::atomic<long>& index, tbb::task_group& group,  const OutputerBase& outputer, 
-		   TaskHolder finalTask);
+  long nextEventIndex();
+
+  void issueReads(TaskHolder const& finalTask);
+  //used instead of issueReads when the Lane has only one slot, needs no lock
+  void issueSingleRead(TaskHolder const& finalTask);
+  //asks the Source for the iNEvents events starting at iEventIndex, once the Outputer is ready
+  void startRead(unsigned int iSlot, long iEventIndex, unsigned int iNEvents, OptionalTaskHolder iReadTask);
+  //used instead of issueReads when batchEvents_ is set
+  void issueBatchRead(TaskHolder const& finalTask);
+  void batchReadFinished(unsigned int iNEvents, TaskHolder finalTask);
+  void processBatchAsync(unsigned int iNEvents, TaskHolder iCallback);
+  void batchFinished(unsigned int iNEvents, TaskHolder finalTask);
+  //a task which runs iTask in iArena
+  TaskHolder inArena(tbb::task_arena& iArena, TaskHolder iTask);
+  void readFinished(unsigned int iSlot, TaskHolder finalTask);
+  void readFailed(unsigned int iSlot);
+  void tryToProcessNextEvent();
+  //used instead of tryToProcessNextEvent when the Lane has only one slot
+  void processSingleEvent(TaskHolder finalTask);
+  void startProcessing(unsigned int iSlot, TaskHolder finalTask);
+  //writes latencies_, so with more than one slot it must be called holding slotsMutex_
+  void recordEventDone(Slot& iSlot);
+  void eventFinished(unsigned int iSlot, TaskHolder finalTask);
+#if defined(TF_ENABLE_COROUTINES)
+  //the same steps as the TaskHolder based functions, for one slot
+  PooledCoroutine processEventsCoroutine(TaskPool& iPool, TaskHolder iFinalTask);
+  bool claimEvent(long& oEventIndex);
+  bool useCoroutine_ = false;
+#endif
 
   SharedSourceBase* source_;
   WaiterBase const* waiter_;
-  long presentEventIndex_ = -1;
+  std::optional<std::vector<unsigned int>> neededProducts_;
+  //tasks created by the Lane get their memory from here so the event loop
+  // does not need to go to the heap once the pool is filled
+  std::unique_ptr<TaskPool> taskPool_;
+  //Written when an event finishes and has one writer at a time. With more than one
+  // slot, --batch-events and the coroutine loop the writes are made holding slotsMutex_.
+  // With one slot no lock is held; the task finishing an event is the one which
+  // starts the next, so the writes are ordered by the tasks.
+  std::unique_ptr<LatencyHistogram> latencies_;
+
+  //set by processEventsAsync
+  std::atomic<long>* eventIndex_ = nullptr;
+  EventIndexClaimer* indexClaimer_ = nullptr;
+  tbb::task_group* group_ = nullptr;
+  OutputerBase const* outputer_ = nullptr;
+  tbb::task_arena* processArena_ = nullptr;
+  tbb::task_arena* readArena_ = nullptr;
+  ActiveLaneLimit* activeLaneLimit_ = nullptr;
+
+  //Guards slots_, readOrder_, processing_ and endReached_ when there is more
+  // than one slot. With one slot, the default, the steps of the Lane's event
+  // run one after the other so no lock is taken and readOrder_ is not used.
+  std::unique_ptr<std::mutex> slotsMutex_;
+  std::vector<Slot> slots_;
+  //slots in the order their events were claimed, used as a circular buffer
+  std::vector<unsigned int> readOrder_;
+  unsigned int readOrderBegin_ = 0;
+  unsigned int readOrderSize_ = 0;
+  bool processing_ = false;
+  bool endReached_ = false;
+  bool batchEvents_ = false;
+  //filled just before calling outputEventsAsync
+  std::vector<EventIdentifier> batchEventIDs_;
+
+  long nextIndexInChunk_ = 0;
+  long endOfChunk_ = 0;
+  long endIndex_ = std::numeric_limits<long>::max();
+  std::atomic<bool> const* stop_ = nullptr;
+  unsigned long long nEventsProcessed_ = 0;
+  unsigned long long nPrefetchedEvents_ = 0;
   unsigned int index_;
+  unsigned int indexChunkSize_ = 1;
   bool verbose_ = false;
 };
 }
@@ -0,0 +1,108 @@
+#if !defined(LaneCoroutine_h)
+#define LaneCoroutine_h
+
+//Needs C++20, only used when built with ENABLE_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+#include "tbb/task_group.h"
+
+#include "TaskPool.h"
+#include "TaskHolder.h"
+#include "OptionalTaskHolder.h"
+#include "FunctorTask.h"
+
+namespace cce::tf {
+  /**
+     A coroutine which starts running when called and which nobody waits on.
+     It must be a member function whose first argument is the TaskPool its
+     frame is taken from.
+   */
+  struct PooledCoroutine {
+    struct promise_type {
+      PooledCoroutine get_return_object() noexcept { return {}; }
+      std::suspend_never initial_suspend() noexcept { return {}; }
+      std::suspend_never final_suspend() noexcept { return {}; }
+      void return_void() noexcept {}
+      void unhandled_exception() noexcept { std::terminate(); }
+
+      template<typename T, typename... ARGS>
+      static void* operator new(std::size_t iSize, T&, TaskPool& iPool, ARGS&...) { return iPool.allocate(iSize); }
+      static void operator delete(void* iPtr) { TaskPool::deallocate(iPtr); }
+    };
+  };
+
+  /**
+     co_await on the value returned suspends the coroutine, calls iStart with
+     a TaskHolder and resumes the coroutine in a TBB task once all copies of
+     the TaskHolder were released. The coroutine may be resumed before iStart
+     returns so iStart must not use the awaiter once the TaskHolder is given away.
+   */
+  template<typename F>
+  auto whenDone(tbb::task_group& iGroup, TaskPool& iPool, F iStart) {
+    struct Awaiter {
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> iHandle) {
+        auto start = std::move(start_);
+        start(TaskHolder(*group_, make_functor_task(*pool_, [iHandle]() { iHandle.resume(); })));
+      }
+      void await_resume() const noexcept {}
+
+      tbb::task_group* group_;
+      TaskPool* pool_;
+      F start_;
+    };
+    return Awaiter{&iGroup, &iPool, std::move(iStart)};
+  }
+
+  /**
+     Like whenDone but iStart is given an OptionalTaskHolder, as used by
+     SharedSourceBase::gotoEventAsync. co_await gives false if the
+     OptionalTaskHolder was dropped without being run.
+   */
+  template<typename F>
+  auto whenRun(tbb::task_group& iGroup, TaskPool& iPool, F iStart) {
+    //resumes the coroutine when deleted, with the work not run unless ran_ was set
+    class Resumer {
+    public:
+      Resumer(tbb::task_group& iGroup, std::coroutine_handle<> iHandle, bool& oRan):
+        group_{&iGroup}, handle_{iHandle}, ran_{&oRan} {}
+      Resumer(Resumer&& iOther): group_{iOther.group_}, handle_{std::exchange(iOther.handle_, {})}, ran_{iOther.ran_} {}
+      Resumer(Resumer const&) = delete;
+      ~Resumer() {
+        if(handle_) {
+          //not resumed from within the Source
+          group_->run([h = handle_]() { h.resume(); });
+        }
+      }
+      void ran() {
+        *ran_ = true;
+        std::exchange(handle_, {}).resume();
+      }
+    private:
+      tbb::task_group* group_;
+      std::coroutine_handle<> handle_;
+      bool* ran_;
+    };
+
+    struct Awaiter {
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> iHandle) {
+        auto start = std::move(start_);
+        start(OptionalTaskHolder(*group_, make_functor_task(*pool_, [resumer = Resumer(*group_, iHandle, ran_)]() mutable {
+                resumer.ran();
+              })));
+      }
+      bool await_resume() const noexcept { return ran_; }
+
+      tbb::task_group* group_;
+      TaskPool* pool_;
+      F start_;
+      bool ran_ = false;
+    };
+    return Awaiter{&iGroup, &iPool, std::move(iStart)};
+  }
+}
+#endif
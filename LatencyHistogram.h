@@ -0,0 +1,103 @@
+#if !defined(LatencyHistogram_h)
+#define LatencyHistogram_h
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace cce::tf {
+  /**
+     Histogram of latencies with a bounded relative error, in the style of an
+     HDR histogram. Values below 2*kSubBuckets each get their own bin, above
+     that every power of two is split into kSubBuckets bins so a value is
+     known to better than 1/kSubBuckets.
+     Only one thread may call record at a time but any thread may read the
+     histogram while it is being filled.
+   */
+  class LatencyHistogram {
+  public:
+    static constexpr unsigned int kSubBucketBits = 5;
+    static constexpr unsigned int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr unsigned int kNBins = (64-kSubBucketBits+1)*kSubBuckets;
+
+    void record(std::uint64_t iValue) {
+      auto& bin = bins_[binIndex(iValue)];
+      bin.store(bin.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+      sum_.store(sum_.load(std::memory_order_relaxed)+iValue, std::memory_order_relaxed);
+      if(iValue > max_.load(std::memory_order_relaxed)) {
+        max_.store(iValue, std::memory_order_relaxed);
+      }
+      //done last so a reader never sees more entries than are in the bins
+      count_.store(count_.load(std::memory_order_relaxed)+1, std::memory_order_release);
+    }
+
+    //adds the entries of iOther, must not be called concurrently with record
+    void add(LatencyHistogram const& iOther) {
+      for(unsigned int i = 0; i < kNBins; ++i) {
+        bins_[i].fetch_add(iOther.bins_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+      }
+      sum_.fetch_add(iOther.sum(), std::memory_order_relaxed);
+      if(iOther.max() > max()) {
+        max_.store(iOther.max(), std::memory_order_relaxed);
+      }
+      count_.fetch_add(iOther.count(), std::memory_order_release);
+    }
+
+    std::uint64_t count() const { return count_.load(std::memory_order_acquire); }
+    std::uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+    std::uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    double mean() const { auto n = count(); return n == 0 ? 0. : double(sum())/n; }
+
+    //the largest value which falls in the same bin as the value at fraction iFraction of the entries
+    std::uint64_t percentile(double iFraction) const {
+      auto n = count();
+      if(n == 0) {
+        return 0;
+      }
+      std::uint64_t rank = iFraction*n;
+      if(rank < iFraction*n or rank == 0) {
+        ++rank;
+      }
+      std::uint64_t seen = 0;
+      for(unsigned int i = 0; i < kNBins; ++i) {
+        seen += bins_[i].load(std::memory_order_relaxed);
+        if(seen >= rank) {
+          auto value = highestInBin(i);
+          return value < max() ? value : max();
+        }
+      }
+      return max();
+    }
+
+    static unsigned int binIndex(std::uint64_t iValue) {
+      if(iValue < 2*kSubBuckets) {
+        return iValue;
+      }
+      unsigned int const highestBit = 63 - __builtin_clzll(iValue);
+      unsigned int const shift = highestBit - kSubBucketBits;
+      return shift*kSubBuckets + (iValue >> shift);
+    }
+
+    static std::uint64_t lowestInBin(unsigned int iBin) {
+      if(iBin < 2*kSubBuckets) {
+        return iBin;
+      }
+      unsigned int const shift = iBin/kSubBuckets - 1;
+      return std::uint64_t(iBin - shift*kSubBuckets) << shift;
+    }
+
+    static std::uint64_t highestInBin(unsigned int iBin) {
+      if(iBin+1 == kNBins) {
+        return ~std::uint64_t(0);
+      }
+      return lowestInBin(iBin+1) - 1;
+    }
+
+  private:
+    std::array<std::atomic<std::uint64_t>, kNBins> bins_{};
+    std::atomic<std::uint64_t> count_{0};
+    std::atomic<std::uint64_t> sum_{0};
+    std::atomic<std::uint64_t> max_{0};
+  };
+}
+#endif
@@ -0,0 +1,91 @@
+#include "MPIEventDistributor.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+using namespace cce::tf;
+
+MPISession::MPISession(int& argc, char**& argv) {
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &provided);
+  if(provided < MPI_THREAD_SERIALIZED) {
+    MPI_Finalize();
+    throw std::runtime_error("the MPI library does not support MPI_THREAD_SERIALIZED");
+  }
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank_);
+  MPI_Comm_size(MPI_COMM_WORLD, &size_);
+}
+
+MPISession::~MPISession() {
+  MPI_Finalize();
+}
+
+void MPISession::barrier() const {
+  MPI_Barrier(MPI_COMM_WORLD);
+}
+
+MPISession::RankTotals MPISession::gather(unsigned long long iEvents, std::chrono::microseconds iEventTime) const {
+  RankTotals totals;
+  if(rank_ == 0) {
+    totals.events_.resize(size_);
+    totals.eventTimes_us_.resize(size_);
+  }
+  double events = iEvents;
+  double time = iEventTime.count();
+  MPI_Gather(&events, 1, MPI_DOUBLE, totals.events_.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+  MPI_Gather(&time, 1, MPI_DOUBLE, totals.eventTimes_us_.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+  return totals;
+}
+
+double MPISession::RankTotals::totalEvents() const {
+  return std::accumulate(events_.begin(), events_.end(), 0.);
+}
+
+double MPISession::RankTotals::maxEventTime_us() const {
+  return eventTimes_us_.empty() ? 0. : *std::max_element(eventTimes_us_.begin(), eventTimes_us_.end());
+}
+
+double MPISession::RankTotals::aggregateEventRate() const {
+  auto time = maxEventTime_us();
+  return time == 0. ? 0. : totalEvents()*1.e6/time;
+}
+
+MPIEventDistributor::MPIEventDistributor(MPISession const& iSession, long iFirstIndex, long iBatchSize):
+  batchSize_{iBatchSize}
+{
+  MPI_Aint const size = iSession.rank() == 0 ? sizeof(long) : 0;
+  MPI_Win_allocate(size, sizeof(long), MPI_INFO_NULL, MPI_COMM_WORLD, &counter_, &window_);
+  if(iSession.rank() == 0) {
+    MPI_Win_lock(MPI_LOCK_EXCLUSIVE, 0, 0, window_);
+    *counter_ = iFirstIndex;
+    MPI_Win_unlock(0, window_);
+  }
+  //no rank takes from the counter before it is set
+  iSession.barrier();
+  MPI_Win_lock_all(0, window_);
+}
+
+MPIEventDistributor::~MPIEventDistributor() {
+  MPI_Win_unlock_all(window_);
+  MPI_Win_free(&window_);
+}
+
+long MPIEventDistributor::claim(long iN) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  if(next_ == end_) {
+    long first;
+    MPI_Fetch_and_op(&batchSize_, &first, MPI_LONG, 0, 0, MPI_SUM, window_);
+    MPI_Win_flush(0, window_);
+    next_ = first;
+    end_ = first + batchSize_;
+    ++nFetches_;
+  }
+  if(end_ - next_ < iN) {
+    throw std::logic_error("MPIEventDistributor batch size "+std::to_string(batchSize_)+" is not a multiple of "+std::to_string(iN));
+  }
+  auto first = next_;
+  next_ += iN;
+  return first;
+}
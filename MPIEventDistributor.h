@@ -0,0 +1,73 @@
+#if !defined(MPIEventDistributor_h)
+#define MPIEventDistributor_h
+
+#include <mpi.h>
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "EventIndexClaimer.h"
+
+namespace cce::tf {
+  //Initializes MPI for the job and finalizes it when destroyed. The calls into
+  // MPI are made by one thread at a time.
+  class MPISession {
+  public:
+    MPISession(int& argc, char**& argv);
+    ~MPISession();
+    MPISession(MPISession const&) = delete;
+    MPISession& operator=(MPISession const&) = delete;
+
+    int rank() const { return rank_; }
+    int size() const { return size_; }
+    void barrier() const;
+
+    //the values of each rank, only filled on rank 0
+    struct RankTotals {
+      std::vector<double> events_;
+      std::vector<double> eventTimes_us_;
+
+      double totalEvents() const;
+      double maxEventTime_us() const;
+      //events of all ranks per second of the slowest rank
+      double aggregateEventRate() const;
+    };
+    RankTotals gather(unsigned long long iEvents, std::chrono::microseconds iEventTime) const;
+
+  private:
+    int rank_ = 0;
+    int size_ = 1;
+  };
+
+  /**
+     The event counter shared by all MPI ranks. It lives in an MPI window on rank
+     0 and each rank takes a batch of indices from it with one MPI_Fetch_and_op,
+     which its Lanes then claim from without talking to the other ranks.
+   */
+  class MPIEventDistributor : public EventIndexClaimer {
+  public:
+    //the counter starts at iFirstIndex. Collective over all ranks of the session.
+    MPIEventDistributor(MPISession const&, long iFirstIndex, long iBatchSize);
+    //collective, all ranks must be done claiming
+    ~MPIEventDistributor() override;
+    MPIEventDistributor(MPIEventDistributor const&) = delete;
+    MPIEventDistributor& operator=(MPIEventDistributor const&) = delete;
+
+    //iN must divide the batch size so a claim never spans two batches
+    long claim(long iN) final;
+
+    long batchSize() const { return batchSize_; }
+    unsigned long long nFetches() const { return nFetches_; }
+
+  private:
+    MPI_Win window_;
+    long* counter_ = nullptr;
+    long const batchSize_;
+    std::mutex mutex_;
+    long next_ = 0;
+    long end_ = 0;
+    unsigned long long nFetches_ = 0;
+  };
+}
+#endif
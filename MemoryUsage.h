@@ -0,0 +1,54 @@
+#if !defined(MemoryUsage_h)
+#define MemoryUsage_h
+
+#include <atomic>
+#include <cstddef>
+#include <dlfcn.h>
+#include <fstream>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace cce::tf {
+  //resident set size of the process, 0 if it can not be found
+  inline unsigned long long residentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    unsigned long long size = 0;
+    unsigned long long resident = 0;
+    if(not (statm >> size >> resident)) {
+      return 0;
+    }
+    return resident*sysconf(_SC_PAGESIZE);
+  }
+
+  //largest resident set size the process has had
+  inline unsigned long long peakResidentBytes() {
+    rusage usage;
+    if(0 != getrusage(RUSAGE_SELF, &usage)) {
+      return 0;
+    }
+    //linux reports kilobytes
+    return static_cast<unsigned long long>(usage.ru_maxrss)*1024;
+  }
+
+  //name of the malloc implementation the process uses, found from symbols only
+  // that implementation exports. This also sees an allocator given by LD_PRELOAD.
+  inline const char* allocatorName() {
+    if(nullptr != dlsym(RTLD_DEFAULT, "mi_version")) {
+      return "mimalloc";
+    }
+    if(nullptr != dlsym(RTLD_DEFAULT, "mallctl")) {
+      return "jemalloc";
+    }
+    if(nullptr != dlsym(RTLD_DEFAULT, "scalable_malloc") and nullptr != dlsym(RTLD_DEFAULT, "__TBB_malloc_proxy")) {
+      return "tbbmalloc";
+    }
+    return "system";
+  }
+
+  template<typename T>
+  void recordMax(std::atomic<T>& ioMax, T iValue) {
+    auto seen = ioMax.load(std::memory_order_relaxed);
+    while(iValue > seen and not ioMax.compare_exchange_weak(seen, iValue, std::memory_order_relaxed)) {}
+  }
+}
+#endif
@@ -0,0 +1,281 @@
+#include "MmapPDSSource.h"
+#include "SourceFactory.h"
+#include "Deserializer.h"
+#include "UnrolledDeserializer.h"
+#include "FixedLayoutDeserializer.h"
+
+#include "TClass.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <cassert>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace cce::tf;
+
+MmapPDSSource::MmapPDSSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iName, ProductSelector const& iSelector) :
+  SharedSourceBase(iNEvents),
+  nextEventOffset_{0}
+{
+  pds::Serialization serialization;
+  std::vector<pds::ProductInfo> productInfo;
+  {
+    //the file header is only read once so using a stream is fine
+    std::ifstream file{iName, std::ios_base::binary};
+    if(not file) {
+      throw std::runtime_error("MmapPDSSource unable to open file "+iName);
+    }
+    pds::FileOptions options;
+    productInfo = readFileHeader(file, compression_, serialization, options);
+    if(not options.dictionary_.empty()) {
+      dictionary_ = std::make_unique<pds::DecompressionDictionary>(options.dictionary_);
+    }
+    perProductCompression_ = options.perProductCompression_;
+    checksum_ = options.checksum_;
+    shuffle_ = std::move(options.shuffle_);
+    productMap_ = pds::selectProducts(productInfo, iSelector);
+    std::streamoff headerSize = file.tellg();
+    if(options.repeatedProducts_) {
+      repeatedProducts_ = pds::readRepeatedProducts(file);
+    }
+    assert(headerSize % 4 == 0);
+    nextEventOffset_ = headerSize/4;
+  }
+
+  fd_ = ::open(iName.c_str(), O_RDONLY);
+  if(fd_ < 0) {
+    throw std::runtime_error("MmapPDSSource unable to open file "+iName);
+  }
+  struct stat fileStat;
+  if(0 != ::fstat(fd_, &fileStat)) {
+    ::close(fd_);
+    throw std::runtime_error("MmapPDSSource unable to stat file "+iName);
+  }
+  nWords_ = fileStat.st_size/4;
+  if(nWords_ != 0) {
+    auto address = ::mmap(nullptr, fileStat.st_size, PROT_READ, MAP_SHARED, fd_, 0);
+    if(address == MAP_FAILED) {
+      ::close(fd_);
+      throw std::runtime_error("MmapPDSSource unable to map file "+iName);
+    }
+    //events are read front to back
+    ::madvise(address, fileStat.st_size, MADV_SEQUENTIAL);
+    ::madvise(address, fileStat.st_size, MADV_WILLNEED);
+    begin_ = static_cast<uint32_t const*>(address);
+  }
+
+  laneInfos_.reserve(iNLanes);
+  for(unsigned int i = 0; i< iNLanes; ++i) {
+    DeserializeStrategy strategy;
+    switch(serialization) {
+    case pds::Serialization::kRoot: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<Deserializer>>(); break;
+    }
+    case pds::Serialization::kRootUnrolled: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<UnrolledDeserializer>>(); break;
+    }
+    case pds::Serialization::kNativeUnrolled: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<NativeUnrolledDeserializer>>(); break;
+    }
+    case pds::Serialization::kFixedLayout: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<FixedLayoutDeserializer>>(); break;
+    }
+    }
+    laneInfos_.emplace_back(productInfo, std::move(strategy));
+    laneInfos_.back().decompressionContext_.setDictionary(dictionary_.get());
+    laneInfos_.back().decompressionContext_.setShuffle(shuffle_);
+    if(not repeatedProducts_.empty()) {
+      laneInfos_.back().repeatedProductsCache_ = pds::RepeatedProductsCache(&repeatedProducts_, productInfo.size());
+    }
+  }
+}
+
+MmapPDSSource::~MmapPDSSource() {
+  if(begin_) {
+    ::munmap(const_cast<uint32_t*>(begin_), nWords_*4);
+  }
+  if(fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+MmapPDSSource::LaneInfo::LaneInfo(std::vector<pds::ProductInfo> const& productInfo, DeserializeStrategy deserialize):
+  deserializers_{std::move(deserialize)},
+  readTime_{std::chrono::microseconds::zero()},
+  decompressTime_{std::chrono::microseconds::zero()},
+  deserializeTime_{std::chrono::microseconds::zero()}
+{
+  dataProducts_.reserve(productInfo.size());
+  dataBuffers_.resize(productInfo.size(), nullptr);
+  deserializers_.reserve(productInfo.size());
+  size_t index =0;
+  for(auto const& pi : productInfo) {
+
+    TClass* cls = TClass::GetClass(pi.className().c_str());
+    assert(cls);
+    dataBuffers_[index] = cls->New();
+    dataProducts_.emplace_back(index,
+                               &dataBuffers_[index],
+                               pi.name(),
+                               cls,
+                               &delayedRetriever_);
+    deserializers_.emplace_back(cls);
+    ++index;
+  }
+}
+
+MmapPDSSource::LaneInfo::~LaneInfo() {
+  auto it = dataProducts_.begin();
+  for( void * b: dataBuffers_) {
+    it->classType()->Destructor(b);
+    ++it;
+  }
+}
+
+size_t MmapPDSSource::numberOfDataProducts() const {
+  return laneInfos_[0].dataProducts_.size();
+}
+
+std::vector<DataProductRetriever>& MmapPDSSource::dataProducts(unsigned int iLane, long iEventIndex) {
+  return laneInfos_[iLane].dataProducts_;
+}
+
+EventIdentifier MmapPDSSource::eventIdentifier(unsigned int iLane, long iEventIndex) {
+  return laneInfos_[iLane].eventID_;
+}
+
+uint32_t const* MmapPDSSource::claimNextEvent() {
+  //the record header gives the size of the record so the offset of the
+  // following record can be found without reading the rest of the record
+  auto offset = nextEventOffset_.load();
+  while(true) {
+    if(offset + pds::kEventHeaderSizeInWords + 1 > nWords_) {
+      return nullptr;
+    }
+    if(begin_[offset] == pds::kEventIndexRecord or begin_[offset] == pds::kRepeatedProductsRecord) {
+      //the index and the repeated products follow the last event
+      return nullptr;
+    }
+    uint32_t bufferSize = begin_[offset+pds::kEventHeaderSizeInWords];
+    size_t next = offset + pds::kEventHeaderSizeInWords + 1 + bufferSize + 1;
+    if(next > nWords_) {
+      //truncated record
+      return nullptr;
+    }
+    bool const isEvent = begin_[offset] == pds::kEventRecordType;
+    if(nextEventOffset_.compare_exchange_weak(offset, next)) {
+      if(isEvent) {
+        return begin_+offset;
+      }
+      //a Run or LuminosityBlock record is passed over
+      offset = next;
+    }
+  }
+}
+
+void MmapPDSSource::readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder iTask) {
+  //header structure in words
+  constexpr size_t kRunIDW=1;
+  constexpr size_t kLumiIDW=2;
+  constexpr size_t kEventIDMSW=3;
+  constexpr size_t kEventIDLSW=4;
+
+  auto& laneInfo = laneInfos_[iLane];
+  auto start = std::chrono::high_resolution_clock::now();
+  auto record = claimNextEvent();
+  if(not record) {
+    return;
+  }
+  unsigned long long eventID = record[kEventIDMSW];
+  eventID = (eventID << 32) + record[kEventIDLSW];
+  laneInfo.eventID_ = {record[kRunIDW], record[kLumiIDW], eventID};
+
+  uint32_t bufferSize = record[pds::kEventHeaderSizeInWords];
+  auto bufferBegin = record + pds::kEventHeaderSizeInWords+1;
+  assert(bufferBegin[bufferSize] == bufferSize);
+  if(checksum_) {
+    pds::checkRecordChecksum(bufferBegin, bufferBegin+bufferSize, laneInfo.eventID_);
+    --bufferSize;
+  }
+  laneInfo.readTime_ +=
+    std::chrono::duration_cast<decltype(laneInfo.readTime_)>(std::chrono::high_resolution_clock::now() - start);
+
+  if(perProductCompression_) {
+    //decompression and deserialization are interleaved so are timed together
+    start = std::chrono::high_resolution_clock::now();
+    pds::uncompressAndDeserializeProducts(compression_, bufferBegin, bufferBegin+bufferSize, laneInfo.productBuffer_, laneInfo.decompressionContext_,
+                                          laneInfo.dataProducts_, laneInfo.deserializers_, productMap_);
+    laneInfo.deserializeTime_ +=
+      std::chrono::duration_cast<decltype(laneInfo.deserializeTime_)>(std::chrono::high_resolution_clock::now() - start);
+    iTask.runNow();
+    return;
+  }
+
+  start = std::chrono::high_resolution_clock::now();
+  auto& uBuffer = laneInfo.uncompressedBuffer_;
+  pds::uncompressEventBuffer(compression_, bufferBegin, bufferBegin+bufferSize, uBuffer, laneInfo.decompressionContext_);
+  laneInfo.decompressTime_ +=
+    std::chrono::duration_cast<decltype(laneInfo.decompressTime_)>(std::chrono::high_resolution_clock::now() - start);
+
+  start = std::chrono::high_resolution_clock::now();
+  pds::deserializeDataProducts(uBuffer.begin(), uBuffer.end(), laneInfo.dataProducts_, laneInfo.deserializers_, productMap_,
+                               &laneInfo.repeatedProductsCache_);
+  laneInfo.deserializeTime_ +=
+    std::chrono::duration_cast<decltype(laneInfo.deserializeTime_)>(std::chrono::high_resolution_clock::now() - start);
+
+  iTask.runNow();
+}
+
+void MmapPDSSource::printSummary() const {
+  std::cout <<"\nSource:\n"
+    "   read time: "<<readTime().count()<<"us\n"
+    "   decompress time: "<<decompressTime().count()<<"us\n"
+    "   deserialize time: "<<deserializeTime().count()<<"us\n"<<std::endl;
+};
+
+std::chrono::microseconds MmapPDSSource::readTime() const {
+  auto time = std::chrono::microseconds::zero();
+  for(auto const& l : laneInfos_) {
+    time += l.readTime_;
+  }
+  return time;
+}
+
+std::chrono::microseconds MmapPDSSource::decompressTime() const {
+  auto time = std::chrono::microseconds::zero();
+  for(auto const& l : laneInfos_) {
+    time += l.decompressTime_;
+  }
+  return time;
+}
+
+std::chrono::microseconds MmapPDSSource::deserializeTime() const {
+  auto time = std::chrono::microseconds::zero();
+  for(auto const& l : laneInfos_) {
+    time += l.deserializeTime_;
+  }
+  return time;
+}
+
+
+namespace {
+    class Maker : public SourceMakerBase {
+  public:
+    Maker(): SourceMakerBase("MmapPDSSource") {}
+      std::unique_ptr<SharedSourceBase> create(unsigned int iNLanes, unsigned long long iNEvents, ConfigurationParameters const& params) const final {
+        auto fileName = params.get<std::string>("fileName");
+        if(not fileName) {
+          std::cout <<"no file name given\n";
+          return {};
+        }
+        ProductSelector selector{params.get<std::string>("products", "")};
+        return std::make_unique<MmapPDSSource>(iNLanes, iNEvents, *fileName, selector);
+    }
+    };
+
+  Maker s_maker;
+}
@@ -0,0 +1,99 @@
+#if !defined(MmapPDSSource_h)
+#define MmapPDSSource_h
+
+#include <string>
+#include <memory>
+#include <chrono>
+#include <atomic>
+#include <iostream>
+
+#include "SharedSourceBase.h"
+#include "DataProductRetriever.h"
+#include "DelayedProductRetriever.h"
+#include "DeserializeStrategy.h"
+#include "pds_reading.h"
+#include "PerLaneCounter.h"
+
+
+namespace cce::tf {
+  class MmapPDSDelayedRetriever : public DelayedProductRetriever {
+    void getAsync(DataProductRetriever&, int index, TaskHolder) final {}
+  };
+
+  /**
+     Reads a PDS file by mapping it into memory. Finding the next event only
+     requires looking at the record header in the mapping so Lanes claim
+     events with an atomic compare and swap rather than going through a
+     serialized read. The compressed buffer is decompressed directly from the
+     mapping.
+   */
+  class MmapPDSSource : public SharedSourceBase {
+  public:
+    MmapPDSSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iFileName, ProductSelector const& iSelector = ProductSelector());
+    MmapPDSSource(MmapPDSSource&&) = delete;
+    MmapPDSSource(MmapPDSSource const&) = delete;
+    ~MmapPDSSource();
+
+  size_t numberOfDataProducts() const final;
+  std::vector<DataProductRetriever>& dataProducts(unsigned int iLane, long iEventIndex) final;
+  EventIdentifier eventIdentifier(unsigned int iLane, long iEventIndex) final;
+
+  void printSummary() const final;
+  private:
+
+  void readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder) final;
+
+  //returns the start of the next event record or nullptr if there are no more
+  uint32_t const* claimNextEvent();
+
+  std::chrono::microseconds readTime() const;
+  std::chrono::microseconds decompressTime() const;
+  std::chrono::microseconds deserializeTime() const;
+
+  //set if the events were compressed using a ZSTD dictionary
+  std::unique_ptr<pds::DecompressionDictionary> dictionary_;
+  pds::Compression compression_;
+  bool perProductCompression_;
+  bool checksum_;
+  //the byte shuffle of each data product in the file, see kHeaderShuffleTag
+  std::vector<uint8_t> shuffle_;
+  pds::ProductMap productMap_;
+  //empty unless the file stores repeated data products at its end
+  std::vector<pds::RepeatedProduct> repeatedProducts_;
+  int fd_ = -1;
+  uint32_t const* begin_ = nullptr;
+  //number of whole words in the file
+  size_t nWords_ = 0;
+  //offset, in words, of the next event record not yet claimed
+  std::atomic<size_t> nextEventOffset_;
+
+  struct alignas(kCacheLineSize) LaneInfo {
+    LaneInfo(std::vector<pds::ProductInfo> const&, DeserializeStrategy);
+
+    LaneInfo(LaneInfo&&) = default;
+    LaneInfo(LaneInfo const&) = delete;
+
+    LaneInfo& operator=(LaneInfo&&) = default;
+    LaneInfo& operator=(LaneInfo const&) = delete;
+
+    EventIdentifier eventID_;
+    std::vector<DataProductRetriever> dataProducts_;
+    std::vector<void*> dataBuffers_;
+    DeserializeStrategy deserializers_;
+    MmapPDSDelayedRetriever delayedRetriever_;
+    pds::ReusableBuffer<uint32_t> uncompressedBuffer_;
+    //used when each data product was compressed separately
+    pds::ReusableBuffer<char> productBuffer_;
+    pds::DecompressionContext decompressionContext_;
+    pds::RepeatedProductsCache repeatedProductsCache_;
+    std::chrono::microseconds readTime_;
+    std::chrono::microseconds decompressTime_;
+    std::chrono::microseconds deserializeTime_;
+    ~LaneInfo();
+  };
+
+  std::vector<LaneInfo> laneInfos_;
+  };
+}
+
+#endif
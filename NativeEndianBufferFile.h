@@ -0,0 +1,106 @@
+#if !defined(NativeEndianBufferFile_h)
+#define NativeEndianBufferFile_h
+
+#include <cstring>
+#include "TBufferFile.h"
+
+namespace cce::tf {
+  /**
+     A TBufferFile which streams numbers in the byte order of the host rather
+     than converting them to big-endian. The streamer actions call the virtual
+     TBuffer functions so they are unchanged. Only use it for data which is
+     read back on a host with the same byte order.
+   */
+  class NativeEndianBufferFile final : public TBufferFile {
+  public:
+    explicit NativeEndianBufferFile(TBuffer::EMode iMode): TBufferFile(iMode) {}
+    NativeEndianBufferFile(TBuffer::EMode iMode, Int_t iBufferSize): TBufferFile(iMode, iBufferSize) {}
+
+    void WriteShort(Short_t i) final { write(i); }
+    void WriteUShort(UShort_t i) final { write(i); }
+    void WriteInt(Int_t i) final { write(i); }
+    void WriteUInt(UInt_t i) final { write(i); }
+    void WriteLong(Long_t i) final { write(i); }
+    void WriteULong(ULong_t i) final { write(i); }
+    void WriteLong64(Long64_t i) final { write(i); }
+    void WriteULong64(ULong64_t i) final { write(i); }
+    void WriteFloat(Float_t f) final { write(f); }
+    void WriteDouble(Double_t d) final { write(d); }
+
+    void ReadShort(Short_t& i) final { read(i); }
+    void ReadUShort(UShort_t& i) final { read(i); }
+    void ReadInt(Int_t& i) final { read(i); }
+    void ReadUInt(UInt_t& i) final { read(i); }
+    void ReadLong(Long_t& i) final { read(i); }
+    void ReadULong(ULong_t& i) final { read(i); }
+    void ReadLong64(Long64_t& i) final { read(i); }
+    void ReadULong64(ULong64_t& i) final { read(i); }
+    void ReadFloat(Float_t& f) final { read(f); }
+    void ReadDouble(Double_t& d) final { read(d); }
+
+    void WriteFastArray(const Short_t* i, Long64_t n) final { writeArray(i, n); }
+    void WriteFastArray(const UShort_t* i, Long64_t n) final { writeArray(i, n); }
+    void WriteFastArray(const Int_t* i, Long64_t n) final { writeArray(i, n); }
+    void WriteFastArray(const UInt_t* i, Long64_t n) final { writeArray(i, n); }
+    void WriteFastArray(const Long_t* i, Long64_t n) final { writeArray(i, n); }
+    void WriteFastArray(const ULong_t* i, Long64_t n) final { writeArray(i, n); }
+    void WriteFastArray(const Long64_t* i, Long64_t n) final { writeArray(i, n); }
+    void WriteFastArray(const ULong64_t* i, Long64_t n) final { writeArray(i, n); }
+    void WriteFastArray(const Float_t* f, Long64_t n) final { writeArray(f, n); }
+    void WriteFastArray(const Double_t* d, Long64_t n) final { writeArray(d, n); }
+    using TBufferFile::WriteFastArray;
+
+    void ReadFastArray(Short_t* i, Int_t n) final { readArray(i, n); }
+    void ReadFastArray(UShort_t* i, Int_t n) final { readArray(i, n); }
+    void ReadFastArray(Int_t* i, Int_t n) final { readArray(i, n); }
+    void ReadFastArray(UInt_t* i, Int_t n) final { readArray(i, n); }
+    void ReadFastArray(Long_t* i, Int_t n) final { readArray(i, n); }
+    void ReadFastArray(ULong_t* i, Int_t n) final { readArray(i, n); }
+    void ReadFastArray(Long64_t* i, Int_t n) final { readArray(i, n); }
+    void ReadFastArray(ULong64_t* i, Int_t n) final { readArray(i, n); }
+    void ReadFastArray(Float_t* f, Int_t n) final { readArray(f, n); }
+    void ReadFastArray(Double_t* d, Int_t n) final { readArray(d, n); }
+    using TBufferFile::ReadFastArray;
+
+  private:
+    template<typename T>
+    void write(T iValue) {
+      if(fBufCur + sizeof(T) > fBufMax) {
+        AutoExpand(fBufSize+sizeof(T));
+      }
+      std::memcpy(fBufCur, &iValue, sizeof(T));
+      fBufCur += sizeof(T);
+    }
+
+    template<typename T>
+    void read(T& oValue) {
+      std::memcpy(&oValue, fBufCur, sizeof(T));
+      fBufCur += sizeof(T);
+    }
+
+    template<typename T>
+    void writeArray(T const* iValues, Long64_t iN) {
+      if(iN <= 0) {
+        return;
+      }
+      auto const length = sizeof(T)*iN;
+      if(fBufCur + length > fBufMax) {
+        AutoExpand(fBufSize+length);
+      }
+      std::memcpy(fBufCur, iValues, length);
+      fBufCur += length;
+    }
+
+    template<typename T>
+    void readArray(T* oValues, Int_t iN) {
+      //same protection against corrupt sizes as TBufferFile
+      if(iN <= 0 or sizeof(T)*iN > static_cast<std::size_t>(fBufSize)) {
+        return;
+      }
+      auto const length = sizeof(T)*iN;
+      std::memcpy(oValues, fBufCur, length);
+      fBufCur += length;
+    }
+  };
+}
+#endif
@@ -2,9 +2,13 @@
 #define OutputerBase_h
 
 #include <vector>
+#include <optional>
 #include "EventIdentifier.h"
+#include "ProductNeeds.h"
 #include "SerializerWrapper.h"
 #include "TaskHolder.h"
+#include "RunReport.h"
+#include "ProductProfile.h"
 
 namespace cce::tf {
 class DataProductRetriever;
@@ -14,13 +18,49 @@ class OutputerBase {
   virtual ~OutputerBase() = default;
   
   virtual void setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const&) = 0;
+  //true if setupForLane may be called for different lanes at the same time
+  virtual bool setupForLaneIsThreadSafe() const { return false; }
   virtual void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const&, TaskHolder iCallback) const = 0;
   virtual bool usesProductReadyAsync() const = 0;
 
+  //The data products the Outputer uses, in the order it uses them, or nothing if it
+  // does not use them. Lanes only retrieve the data products some component needs.
+  // The default is for Outputers which write all data products.
+  virtual std::optional<ProductNeeds> neededProducts() const { return ProductNeeds(); }
 
-  virtual void outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const = 0;
+  // iEventIndex is the index of the event within the Source
+  virtual void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const = 0;
+
+  //The iEventIDs.size() events starting at iFirstEventIndex in the lanes starting at iFirstLaneIndex.
+  // Outputers which write events in batches can add them all in one step. iEventIDs is only
+  // valid during the call. The default calls outputAsync for each event.
+  virtual void outputEventsAsync(unsigned int iFirstLaneIndex, long iFirstEventIndex, std::vector<EventIdentifier> const& iEventIDs, TaskHolder iCallback) const {
+    for(unsigned int i = 0; i < iEventIDs.size(); ++i) {
+      outputAsync(iFirstLaneIndex+i, iFirstEventIndex+i, iEventIDs[i], iCallback);
+    }
+  }
+
+  //Called before the Lane asks the Source for its next event. Outputers which
+  // hold events after releasing their Lane can delay iCallback to bound that memory.
+  virtual void readyForEventAsync(unsigned int iLaneIndex, TaskHolder iCallback) const { iCallback.doneWaiting(); }
+  virtual bool usesReadyForEventAsync() const { return false; }
+
+  //Called before any event is given when no events with an index below iEventIndex will be,
+  // e.g. when the warm up events went to a different Outputer.
+  virtual void setFirstEventIndex(long iEventIndex) {}
+
+  //Called once all events were output and before printSummary. Does the end of job work,
+  // e.g. writing the events still held and closing files, in tasks which may run in parallel
+  // with those of other Outputers and calls iCallback once done. Outputers which are not
+  // given this call, e.g. at the end of a --scan-threads step, do that work in printSummary
+  // or when deleted.
+  virtual void finishAsync(TaskHolder iCallback) const { iCallback.doneWaiting(); }
 
   virtual void printSummary() const = 0;
+  //adds the values printed by printSummary to the job's report
+  virtual void fillReport(RunReport&) const {}
+  //adds what was measured of each data product it serialized, see --write-profile
+  virtual void fillProfile(ProductProfile&) const {}
 };
 }
 #endif
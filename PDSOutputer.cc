@@ -2,12 +2,24 @@
 #include "OutputerFactory.h"
 #include "ConfigurationParameters.h"
 #include "UnrolledSerializerWrapper.h"
+#include "FixedLayoutSerializerWrapper.h"
 #include "SerializerWrapper.h"
 #include "summarize_serializers.h"
+#include "summarize_queue.h"
+#include "PerfCounters.h"
 #include "pds_writer.h"
+#include "crc32c.h"
+#include "byte_shuffle.h"
 #include <iostream>
+#include <algorithm>
 #include <cstring>
+#include <cerrno>
 #include <set>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 using namespace cce::tf;
 using namespace cce::tf::pds;
@@ -19,52 +31,377 @@ void PDSOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataProductR
     {   s = SerializeStrategy::make<SerializeProxy<SerializerWrapper>>(); break; }
   case Serialization::kRootUnrolled:
     {   s = SerializeStrategy::make<SerializeProxy<UnrolledSerializerWrapper>>(); break; }
+  case Serialization::kNativeUnrolled:
+    {   s = SerializeStrategy::make<SerializeProxy<NativeUnrolledSerializerWrapper>>(); break; }
+  case Serialization::kFixedLayout:
+    {   s = SerializeStrategy::make<SerializeProxy<FixedLayoutSerializerWrapper>>(); break; }
   }
   s.reserve(iDPs.size());
   for(auto const& dp: iDPs) {
     s.emplace_back(dp.name(), dp.classType());
   }
+  if(chunkElements_ != 0) {
+    for(std::size_t i = 0; i < s.size(); ++i) {
+      s[i].setChunkElements(chunkElements_);
+    }
+  }
+  if(deduplicate_) {
+    for(std::size_t i = 0; i < s.size(); ++i) {
+      s[i].setHashBlobs(true);
+    }
+    std::call_once(repeatedProductsOnce_, [this, &s]() { repeatedProducts_ = std::make_unique<pds::RepeatedProducts>(s.size()); });
+  }
+  if(shuffle_) {
+    //all Lanes have the same data products
+    std::call_once(shuffleOnce_, [this, &s]() {
+        std::vector<uint8_t> typeSizes;
+        typeSizes.reserve(s.size());
+        for(auto const& w: s) {
+          typeSizes.push_back(shuffleTypeSize(w.className()));
+        }
+        if(std::any_of(typeSizes.begin(), typeSizes.end(), [](auto v) { return v != 0; })) {
+          shuffleTypeSizes_ = std::move(typeSizes);
+        }
+      });
+  }
 }
 
 void PDSOutputer::productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const {
   auto& laneSerializers = serializers_[iLaneIndex];
-  auto group = iCallback.group();
-  laneSerializers[iDataProduct.index()].doWorkAsync(*group, iDataProduct.address(), std::move(iCallback));
+  serializeOrPassThroughAsync(laneSerializers[iDataProduct.index()], iDataProduct, serialization_, std::move(iCallback), coalesceBytes_);
 }
 
-void PDSOutputer::outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+void PDSOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
   auto start = std::chrono::high_resolution_clock::now();
-  auto tempBuffer = std::make_unique<std::vector<uint32_t>>(writeDataProductsToOutputBuffer(serializers_[iLaneIndex]));
-  queue_.push(*iCallback.group(), [this, iEventID, iLaneIndex, callback=std::move(iCallback), buffer=std::move(tempBuffer)]() mutable {
-      auto start = std::chrono::high_resolution_clock::now();
-      const_cast<PDSOutputer*>(this)->output(iEventID, serializers_[iLaneIndex],*buffer);
-      buffer.reset();
+  if(eventBuffers_.empty()) {
+    serializeDeferred(serializers_[iLaneIndex]);
+  } else {
+    serializeDeferred(serializers_[iLaneIndex], eventBuffers_[iLaneIndex]);
+  }
+  //until the dictionary is trained, events are passed uncompressed to the queue
+  bool const compressed = dictionaryTrained_.load();
+  if(pipeline_) {
+    PipelineEvent event{iEventID, iLaneIndex, {}, compressed and perProductCompression_};
+    if(event.compressed_) {
+      //per data product compression needs the serializers of the Lane
+      auto& context = compressionContexts_[iLaneIndex];
+      event.buffer_ = writeDataProductsToPerProductBuffer(serializers_[iLaneIndex], context, compressionLevel_);
+    } else {
+      event.buffer_ = writeDataProductsToUncompressedBuffer(serializers_[iLaneIndex]);
+    }
+    event.heldBytes_ = hold(event.buffer_);
+    pipeline_->pushAsync(std::move(event), std::move(iCallback));
+    auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+    parallelTime_.add(iLaneIndex, time.count());
+    return;
+  }
+  //the Lane waits for the event to be written so its buffers are not touched until then
+  auto& laneBuffers = laneBuffers_[iLaneIndex];
+  if(compressed) {
+    auto& context = compressionContexts_[iLaneIndex];
+    context.setDictionary(dictionary_.get());
+    if(levelController_) {
+      auto compressStart = std::chrono::high_resolution_clock::now();
+      writeDataProductsToOutputBuffer(serializers_[iLaneIndex], context, levelController_->level(iLaneIndex), laneBuffers);
+      levelController_->compressed(iLaneIndex, laneBuffers.event_.size()*4,
+                                   std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - compressStart),
+                                   queue_.nPending());
+    } else {
+      writeDataProductsToOutputBuffer(serializers_[iLaneIndex], context, compressionLevel_, laneBuffers);
+    }
+  } else {
+    writeDataProductsToUncompressedBuffer(serializers_[iLaneIndex], laneBuffers.event_);
+  }
+  auto const heldBytes = hold(laneBuffers.event_);
+  if(fd_ >= 0 and compressed) {
+    queue_.push(*iCallback.group(), [this, iEventID, iLaneIndex, heldBytes, callback=std::move(iCallback)]() mutable {
+        auto start = std::chrono::high_resolution_clock::now();
+        auto offset = const_cast<PDSOutputer*>(this)->reserveEventRegion(iEventID, serializers_[iLaneIndex], laneBuffers_[iLaneIndex].event_);
         serialTime_ += std::chrono::duration_cast<decltype(serialTime_)>(std::chrono::high_resolution_clock::now() - start);
-      callback.doneWaiting();
+        auto group = callback.group();
+        group->run([this, offset, iEventID, iLaneIndex, heldBytes, callback=std::move(callback)]() {
+            auto start = std::chrono::high_resolution_clock::now();
+            writeEventAt(offset, iEventID, laneBuffers_[iLaneIndex].event_);
+            written(heldBytes);
+            auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+            parallelTime_.add(iLaneIndex, time.count());
+          });
+      });
+    auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+    parallelTime_.add(iLaneIndex, time.count());
+    return;
+  }
+  queue_.push(*iCallback.group(), [this, iEventIndex, iEventID, iLaneIndex, compressed, heldBytes, callback=std::move(iCallback)]() mutable {
+      auto start = std::chrono::high_resolution_clock::now();
+      auto const startPosition = filePosition();
+      auto& buffer = laneBuffers_[iLaneIndex].event_;
+      if(reorderBuffer_) {
+        //the Lane may continue before the event is written so it can not keep the buffer
+        const_cast<PDSOutputer*>(this)->outputInOrder(iEventIndex, {iEventID, iLaneIndex, std::move(buffer), compressed, {}, heldBytes}, std::move(callback));
+        auto time = std::chrono::duration_cast<decltype(serialTime_)>(std::chrono::high_resolution_clock::now() - start);
+        serialTime_ += time;
+        if(levelController_) {
+          levelController_->written(filePosition()-startPosition, time);
+        }
+        return;
+      }
+      const_cast<PDSOutputer*>(this)->output(iEventID, serializers_[iLaneIndex], buffer, compressed);
+      written(heldBytes);
+      auto time = std::chrono::duration_cast<decltype(serialTime_)>(std::chrono::high_resolution_clock::now() - start);
+      serialTime_ += time;
+      if(levelController_) {
+        levelController_->written(filePosition()-startPosition, time);
+      }
+      const_cast<PDSOutputer*>(this)->releaseLane(std::move(callback));
     });
     auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
-    parallelTime_ += time.count();
+    parallelTime_.add(iLaneIndex, time.count());
+}
+
+void PDSOutputer::setupPipeline(unsigned int iMaxEventsInFlight) {
+  pipeline_ = std::make_unique<AsyncPipeline<PipelineEvent>>(iMaxEventsInFlight);
+  pipeline_->parallelStage("compress", [this](PipelineEvent& iEvent) {
+      //while a dictionary is being trained the write stage does the compression
+      if(iEvent.compressed_ or not dictionaryTrained_.load()) {
+        return;
+      }
+      auto start = std::chrono::high_resolution_clock::now();
+      auto& context = pipelineCompressionContexts_.local();
+      context.setDictionary(dictionary_.get());
+      iEvent.buffer_ = compressEventBuffer(iEvent.buffer_, context);
+      iEvent.compressed_ = true;
+      auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+      parallelTime_.add(iEvent.laneIndex_, time.count());
+    });
+  pipeline_->serialStage("write", [this](PipelineEvent& iEvent) {
+      auto start = std::chrono::high_resolution_clock::now();
+      //only the names and types of the Lane's serializers are used
+      output(iEvent.eventID_, serializers_[iEvent.laneIndex_], iEvent.buffer_, iEvent.compressed_);
+      written(iEvent.heldBytes_);
+      serialTime_ += std::chrono::duration_cast<decltype(serialTime_)>(std::chrono::high_resolution_clock::now() - start);
+    });
+}
+
+void PDSOutputer::outputInOrder(long iEventIndex, OrderedEvent iEvent, TaskHolder iCallback) {
+  if(not reorderBuffer_->isNext(iEventIndex) and reorderBuffer_->isFull()) {
+    //iCallback is released once the event is written
+    iEvent.waitingLane_.emplace(std::move(iCallback));
+    reorderBuffer_->push(iEventIndex, std::move(iEvent), [this](OrderedEvent iEvent) { outputOrdered(iEvent); });
+    return;
+  }
+  reorderBuffer_->push(iEventIndex, std::move(iEvent), [this](OrderedEvent iEvent) { outputOrdered(iEvent); });
+  releaseLane(std::move(iCallback));
+}
+
+void PDSOutputer::outputOrdered(OrderedEvent& iEvent) {
+  output(iEvent.eventID_, serializers_[iEvent.laneIndex_], iEvent.buffer_, iEvent.compressed_);
+  written(iEvent.heldBytes_);
+  if(iEvent.waitingLane_) {
+    releaseLane(std::move(*iEvent.waitingLane_));
+    iEvent.waitingLane_.reset();
+  }
+}
+
+void PDSOutputer::releaseLane(TaskHolder iCallback) {
+  if(writeBehind_) {
+    writeBehind_->whenWritten([callback=std::move(iCallback)]() mutable { callback.doneWaiting(); });
+    return;
+  }
+  iCallback.doneWaiting();
+}
+
+void PDSOutputer::readyForEventAsync(unsigned int iLaneIndex, TaskHolder iCallback) const {
+  heldLimit_->whenRoom([callback=std::move(iCallback)]() mutable { callback.doneWaiting(); });
+}
+
+unsigned long long PDSOutputer::hold(std::vector<uint32_t> const& iBuffer) const {
+  unsigned long long bytes = iBuffer.size()*4;
+  if(heldLimit_) {
+    heldLimit_->add(bytes);
+  }
+  return bytes;
+}
+
+void PDSOutputer::written(unsigned long long iHeldBytes) const {
+  if(heldLimit_) {
+    heldLimit_->remove(iHeldBytes);
+  }
+}
+
+void PDSOutputer::setFirstEventIndex(long iEventIndex) {
+  if(reorderBuffer_) {
+    reorderBuffer_->setFirstEventIndex(iEventIndex);
+  }
 }
 
 void PDSOutputer::printSummary() const  {
+  const_cast<PDSOutputer*>(this)->finish();
   std::cout <<"PDSOutputer\n  total serial time at end event: "<<serialTime_.count()<<"us\n"
-    "  total parallel time at end event: "<<parallelTime_.load()<<"us\n";
+    "  total parallel time at end event: "<<parallelTime_.sum()<<"us\n"
+    "  end of job time: "<<endOfJobTime_.count()<<"us\n";
+  if(reorderBuffer_) {
+    std::cout <<"  most events held for ordering: "<<reorderBuffer_->maxHeldReached()<<"\n";
+  }
+  if(heldLimit_) {
+    std::cout <<"  most events waiting to be written: "<<heldLimit_->maxEventsHeld()<<" most bytes: "<<heldLimit_->maxBytesHeld()<<"\n"
+      "  reads delayed: "<<heldLimit_->nWaited()<<" delay time: "<<heldLimit_->waitTime().count()<<"us\n";
+  }
+  std::cout <<"  file writes: "<<nFileWrites_.load()<<"\n";
+  if(writeAlignment_ != 0) {
+    std::cout <<"  file writes aligned to "<<writeAlignment_<<" bytes\n";
+  }
+  if(preallocator_) {
+    summarize_preallocation(*preallocator_);
+  }
+  if(levelController_) {
+    std::cout <<"  adaptive compression level: mean "<<levelController_->meanLevel()<<" range ["<<levelController_->minLevel()<<", "
+      <<levelController_->maxLevel()<<"] changes: "<<levelController_->nChanges()<<"\n";
+  }
+  if(fd_ >= 0) {
+    std::cout <<"  event records written in parallel from the Lanes\n";
+  }
+  if(not shuffleTypeSizes_.empty()) {
+    std::cout <<"  byte shuffled data products: "<<std::count_if(shuffleTypeSizes_.begin(), shuffleTypeSizes_.end(), [](auto v) { return v != 0; })<<"\n";
+  }
+  if(coalesceBytes_ != 0) {
+    std::cout <<"  serializations done together at end of event: "<<nDeferred(serializers_)<<"\n";
+  }
+  if(not eventBuffers_.empty()) {
+    std::cout <<"  serializations written into the Lane's event buffer: "<<nInEventBuffer(serializers_)<<"\n";
+  }
+  if(chunkElements_ != 0) {
+    std::cout <<"  serializations split into chunks: "<<nChunked(serializers_)<<"\n";
+  }
+  if(auto bytes = passedThroughBytes(serializers_); bytes != 0) {
+    std::cout <<"  serialized bytes passed through from the Source: "<<bytes<<"\n";
+  }
+  if(repeatedProducts_) {
+    std::cout <<"  data products stored as repeated: "<<repeatedProducts_->nReferences()<<" bytes not stored: "<<repeatedProducts_->referencedBytes()
+             <<" kept at end of file: "<<repeatedProducts_->nEntries()<<"\n";
+  }
+  if(writeBehind_) {
+    std::cout <<"  async write time: "<<writeBehind_->writeTime().count()<<"us\n"
+      "  most bytes waiting to be written: "<<writeBehind_->maxBytesHeld()<<"\n"
+      "  events waiting for writes: "<<writeBehind_->nDelayed()<<"\n";
+  }
+  if(pipeline_) {
+    summarize_pipeline("output", *pipeline_);
+  } else {
+    summarize_queue("output", queue_);
+  }
   summarize_serializers(serializers_);
 }
 
+void PDSOutputer::fillProfile(ProductProfile& oProfile) const {
+  profile_serializers(oProfile, serializers_);
+}
 
+void PDSOutputer::fillReport(RunReport& oReport) const {
+  oReport.set("serialTime_us", serialTime_.count());
+  oReport.set("parallelTime_us", parallelTime_.sum());
+  oReport.set("endOfJobTime_us", endOfJobTime_.count());
+  oReport.set("fileWrites", nFileWrites_.load());
+  if(coalesceBytes_ != 0) {
+    oReport.set("coalescedSerializations", nDeferred(serializers_));
+  }
+  if(not eventBuffers_.empty()) {
+    oReport.set("eventBufferSerializations", nInEventBuffer(serializers_));
+  }
+  if(chunkElements_ != 0) {
+    oReport.set("chunkedSerializations", nChunked(serializers_));
+  }
+  oReport.set("bytesWritten", filePosition_);
+  auto serializedBytes = report_serializers(oReport, serializers_);
+  if(auto bytes = passedThroughBytes(serializers_); bytes != 0) {
+    oReport.set("passedThroughBytes", bytes);
+    serializedBytes += bytes;
+  }
+  if(repeatedProducts_) {
+    oReport.set("repeatedProducts", repeatedProducts_->nReferences());
+    oReport.set("repeatedProductBytes", repeatedProducts_->referencedBytes());
+  }
+  if(filePosition_ != 0) {
+    oReport.set("compressionRatio", double(serializedBytes)/filePosition_);
+  }
+  if(writeBehind_) {
+    oReport.set("asyncWriteTime_us", writeBehind_->writeTime().count());
+  }
+  if(preallocator_) {
+    report_preallocation(oReport, *preallocator_);
+  }
+  if(levelController_) {
+    oReport.set("meanCompressionLevel", levelController_->meanLevel());
+    oReport.set("compressionLevelChanges", levelController_->nChanges());
+  }
+  if(heldLimit_) {
+    oReport.set("maxHeldEvents", heldLimit_->maxEventsHeld());
+    oReport.set("maxHeldBytes", heldLimit_->maxBytesHeld());
+    oReport.set("delayedReads", heldLimit_->nWaited());
+    oReport.set("readDelay_us", heldLimit_->waitTime().count());
+  }
+  if(pipeline_) {
+    report_pipeline(oReport, "output", *pipeline_);
+  } else {
+    report_queue(oReport, "output", queue_);
+  }
+}
 
-void PDSOutputer::output(EventIdentifier const& iEventID, SerializeStrategy const& iSerializers, std::vector<uint32_t>const& iBuffer) {
+
+
+void PDSOutputer::output(EventIdentifier const& iEventID, SerializeStrategy const& iSerializers, std::vector<uint32_t>& iBuffer, bool iCompressed) {
+  if(not iCompressed) {
+    if(dictionaryTrained_.load()) {
+      //event was serialized before training finished
+      serialCompressionContext_.setDictionary(dictionary_.get());
+      writeEvent(iEventID, compressEventBuffer(iBuffer, serialCompressionContext_));
+      return;
+    }
+    headerSerializers_ = &iSerializers;
+    pendingEventIDs_.push_back(iEventID);
+    pendingEventBuffers_.push_back(std::move(iBuffer));
+    if(pendingEventBuffers_.size() == dictionaryTrainingEvents_) {
+      trainDictionaryAndWritePendingEvents();
+    }
+    return;
+  }
   if(firstTime_) {
     writeFileHeader(iSerializers);
     firstTime_ = false;
   }
+  writeEvent(iEventID, iBuffer);
+}
+
+void PDSOutputer::trainDictionaryAndWritePendingEvents() {
+  dictionaryBlob_ = pds::trainDictionary(pendingEventBuffers_, maxDictionarySize_);
+  if(not dictionaryBlob_.empty()) {
+    dictionary_ = std::make_unique<pds::CompressionDictionary>(dictionaryBlob_, compressionLevel_);
+  }
+  serialCompressionContext_.setDictionary(dictionary_.get());
+
+  writeFileHeader(*headerSerializers_);
+  firstTime_ = false;
+  for(size_t i=0; i < pendingEventBuffers_.size(); ++i) {
+    writeEvent(pendingEventIDs_[i], compressEventBuffer(pendingEventBuffers_[i], serialCompressionContext_));
+  }
+  pendingEventIDs_ = std::vector<EventIdentifier>();
+  pendingEventBuffers_ = std::vector<std::vector<uint32_t>>();
+  dictionaryTrained_ = true;
+}
+
+void PDSOutputer::writeEvent(EventIdentifier const& iEventID, std::vector<uint32_t> const& iBuffer) {
   using namespace std::string_literals;
   
   //std::cout <<"   run:"s+std::to_string(iEventID.run)+" lumi:"s+std::to_string(iEventID.lumi)+" event:"s+std::to_string(iEventID.event)+"\n"<<std::flush;
   
+  if(lumiRecords_) {
+    writeTransitionRecords(iEventID);
+  }
+  if(writeEventIndex_) {
+    //iBuffer holds the record size, the uncompressed size, the compressed data and the crosscheck
+    eventIndex_.push_back({filePosition()/4, iEventID, iBuffer[0], iBuffer[1] & ~uint32_t(3)});
+  }
   writeEventHeader(iEventID);
-  file_.write(reinterpret_cast<char const*>(iBuffer.data()), (iBuffer.size())*4);
+  writeToFile(reinterpret_cast<char const*>(iBuffer.data()), (iBuffer.size())*4);
   /*
     for(auto& s: iSerializers) {
     std::cout<<"   "s+s.name()+" size "+std::to_string(s.blob().size())+"\n" <<std::flush;
@@ -72,149 +409,372 @@ void PDSOutputer::output(EventIdentifier const& iEventID, SerializeStrategy cons
   */
 }
 
-void PDSOutputer::writeFileHeader(SerializeStrategy const& iSerializers) {
-  std::set<std::string> typeNamesSet;
-  for(auto const& w: iSerializers) {
-    std::string n(w.className());
-    n.push_back('\0');
-    auto it = typeNamesSet.insert(n);
-  }
-  std::vector<std::string> typeNames(typeNamesSet.begin(), typeNamesSet.end());
-  typeNamesSet.clear();
-  size_t nCharactersInTypeNames = 0U;
-  for(auto const& n: typeNames) {
-    nCharactersInTypeNames += n.size();
+namespace {
+  //handles partial writes, throws if the file can not be written
+  void pwriteFully(int iFileDescriptor, iovec* iIO, int iNIO, uint64_t iOffset) {
+    std::size_t size = 0;
+    for(int i = 0; i < iNIO; ++i) {
+      size += iIO[i].iov_len;
+    }
+    emulateStorageRequest(size);
+    while(iNIO != 0) {
+      auto nWritten = ::pwritev(iFileDescriptor, iIO, iNIO, iOffset);
+      if(nWritten < 0) {
+        if(errno == EINTR) {
+          continue;
+        }
+        throw std::runtime_error(std::string("PDSOutputer failed to write to file: ")+std::strerror(errno));
+      }
+      iOffset += nWritten;
+      while(iNIO != 0 and static_cast<std::size_t>(nWritten) >= iIO->iov_len) {
+        nWritten -= iIO->iov_len;
+        ++iIO;
+        --iNIO;
+      }
+      if(iNIO != 0) {
+        iIO->iov_base = static_cast<char*>(iIO->iov_base) + nWritten;
+        iIO->iov_len -= nWritten;
+      }
+    }
   }
-  
-  std::vector<std::pair<uint32_t, std::string>> dataProducts;
-  dataProducts.reserve(iSerializers.size());
+}
+
+void PDSOutputer::openForParallelWrite(std::string const& iFileName) {
+  //file_ already created the file, it is only used to hold it open
+  fd_ = ::open(iFileName.c_str(), O_WRONLY);
+  if(fd_ < 0) {
+    throw std::runtime_error("PDSOutputer unable to open file "+iFileName+": "+std::strerror(errno));
+  }
+}
+
+uint64_t PDSOutputer::reserveEventRegion(EventIdentifier const& iEventID, SerializeStrategy const& iSerializers, std::vector<uint32_t> const& iBuffer) {
+  if(firstTime_) {
+    writeFileHeader(iSerializers);
+    firstTime_ = false;
+  }
+  if(lumiRecords_) {
+    writeTransitionRecords(iEventID);
+  }
+  if(writeEventIndex_) {
+    eventIndex_.push_back({filePosition()/4, iEventID, iBuffer[0], iBuffer[1] & ~uint32_t(3)});
+  }
+  auto const offset = filePosition_;
+  filePosition_ += (kEventHeaderSizeInWords + iBuffer.size())*4;
+  if(preallocator_) {
+    preallocator_->written(filePosition_);
+  }
+  return offset;
+}
+
+void PDSOutputer::writeEventAt(uint64_t iOffset, EventIdentifier const& iEventID, std::vector<uint32_t> const& iBuffer) const {
+  auto header = eventHeader(iEventID);
+  std::array<iovec, 2> io = {{ {header.data(), header.size()*4},
+                               {const_cast<uint32_t*>(iBuffer.data()), iBuffer.size()*4} }};
+  pwriteFully(fd_, io.data(), io.size(), iOffset);
+  ++nFileWrites_;
+}
+
+PDSOutputer::~PDSOutputer() {
+  finish();
+  writeBehind_.reset();
+  if(fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+void PDSOutputer::finishAsync(TaskHolder iCallback) const {
+  auto group = iCallback.group();
+  auto nonConstThis = const_cast<PDSOutputer*>(this);
+  auto finishTask = [nonConstThis, iCallback=std::move(iCallback)]() { nonConstThis->finish(); };
+  if(pipeline_) {
+    //the harness waited for all events to leave the pipeline
+    group->run(std::move(finishTask));
+  } else {
+    queue_.push(*group, std::move(finishTask));
+  }
+}
+
+void PDSOutputer::finish() {
+  if(finished_) {
+    return;
+  }
+  finished_ = true;
+  auto start = std::chrono::high_resolution_clock::now();
+  if(reorderBuffer_) {
+    reorderBuffer_->flush([this](OrderedEvent iEvent) { outputOrdered(iEvent); });
+  }
+  if(not pendingEventBuffers_.empty()) {
+    //fewer events than requested for training
+    trainDictionaryAndWritePendingEvents();
+  }
+  if(writeEventIndex_ and not firstTime_) {
+    writeEventIndex();
+  }
+  if(repeatedProducts_ and not firstTime_) {
+    //follows the event index so readers find both from the end of the file
+    auto const record = repeatedProducts_->record(filePosition()/4);
+    writeToFile(reinterpret_cast<char const*>(record.data()), record.size()*4);
+  }
+  flushWriteBuffer();
+  if(writeBehind_) {
+    writeBehind_->waitForWrites();
+  }
+  if(preallocator_) {
+    file_.flush();
+    preallocator_->finish();
+  }
+  endOfJobTime_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+}
+
+void PDSOutputer::writeToFile(char const* iData, std::size_t iSize) {
+  if(preallocator_) {
+    preallocator_->written(filePosition_+iSize);
+  }
+  if(fd_ >= 0) {
+    //event records may still be being written into their regions before this offset
+    iovec io{const_cast<char*>(iData), iSize};
+    pwriteFully(fd_, &io, 1, filePosition_);
+    filePosition_ += iSize;
+    ++nFileWrites_;
+    return;
+  }
+  filePosition_ += iSize;
+  if(writeAlignment_ != 0) {
+    //even large records go through the buffer so every write starts at an aligned offset
+    writeBuffer_.insert(writeBuffer_.end(), iData, iData+iSize);
+    if(writeBuffer_.size() >= writeBufferSize_) {
+      flushWriteBuffer(writeAlignment_);
+    }
+    return;
+  }
+  if(writeBuffer_.size() + iSize > writeBufferSize_) {
+    flushWriteBuffer();
+    if(iSize >= writeBufferSize_) {
+      //too large to be worth copying
+      ++nFileWrites_;
+      if(writeBehind_) {
+        writeBehind_->push(std::vector<char>(iData, iData+iSize));
+        return;
+      }
+      emulateStorageRequest(iSize);
+      file_.write(iData, iSize);
+      return;
+    }
+  }
+  writeBuffer_.insert(writeBuffer_.end(), iData, iData+iSize);
+}
+
+void PDSOutputer::flushWriteBuffer(std::size_t iAlignment) {
+  auto const size = writeBuffer_.size() - writeBuffer_.size() % iAlignment;
+  if(size == 0) {
+    return;
+  }
+  ++nFileWrites_;
+  if(writeBehind_) {
+    std::vector<char> remaining;
+    remaining.reserve(writeBufferSize_);
+    remaining.insert(remaining.end(), writeBuffer_.begin()+size, writeBuffer_.end());
+    writeBuffer_.resize(size);
+    writeBehind_->push(std::move(writeBuffer_));
+    writeBuffer_ = std::move(remaining);
+    return;
+  }
+  emulateStorageRequest(size);
+  file_.write(writeBuffer_.data(), size);
+  writeBuffer_.erase(writeBuffer_.begin(), writeBuffer_.begin()+size);
+}
+
+void PDSOutputer::writeTransitionRecords(EventIdentifier const& iEventID) {
+  //events can finish in any order so a record is written the first time its run or lumi is seen
+  if(writtenRuns_.insert(iEventID.run).second) {
+    writeEmptyRecord(kRunRecordType, iEventID.run, 0);
+  }
+  if(writtenLumis_.emplace(iEventID.run, iEventID.lumi).second) {
+    writeEmptyRecord(kLuminosityBlockRecordType, iEventID.run, iEventID.lumi);
+  }
+}
+
+void PDSOutputer::writeEmptyRecord(uint32_t iRecordType, uint32_t iRun, uint32_t iLumi) {
+  //the record header, a record size of 0 and its crosscheck
+  std::array<uint32_t, 7> record = {iRecordType, iRun, iLumi, 0, 0, 0, 0};
+  writeToFile(reinterpret_cast<char const*>(record.data()), record.size()*4);
+}
+
+void PDSOutputer::writeEventIndex() {
+  std::vector<pds::LumiIndexEntry> lumis;
+  if(lumiIndex_) {
+    lumis = pds::lumiIndex(eventIndex_);
+  }
+  auto const record = pds::eventIndexRecord(eventIndex_, filePosition()/4, lumis);
+  writeToFile(reinterpret_cast<char const*>(record.data()), record.size()*4);
+}
+
+void PDSOutputer::writeFileHeader(SerializeStrategy const& iSerializers) {
+  std::vector<std::pair<std::string, std::string>> products;
+  products.reserve(iSerializers.size());
   dataProductIndices_.reserve(iSerializers.size());
-  size_t nCharactersInDataProducts = 0U;
   size_t index = 0;
   for(auto const& s: iSerializers) {
-    auto itFind = std::lower_bound(typeNames.begin(), typeNames.end(), s.className());
+    products.emplace_back(s.name(), s.className());
     std::string name{s.name()};
     name.push_back('\0');
-    dataProducts.emplace_back(itFind - typeNames.begin(), name);
     dataProductIndices_.emplace_back(name,index++);
-    //pad to 32 bit size
-    while( 0 != dataProducts.back().second.size() % 4) {
-      dataProducts.back().second.push_back('\0');
-    }
-    nCharactersInDataProducts += 4 + dataProducts.back().second.size();
   }
-  
-  std::array<char, 8> transitions = {'E','v','e','n','t','\0','\0','\0'};
-  
-  size_t bufferPosition = 0;
-  std::vector<uint32_t> buffer;
-  const auto nWordsInTypeNames = bytesToWords(nCharactersInTypeNames);
-  buffer.resize(1+transitions.size()/4+1+nWordsInTypeNames+1+1+nCharactersInDataProducts/4);
-  
-  //The different record types stored
-  buffer[bufferPosition++] = transitions.size()/4;
-  std::memcpy(reinterpret_cast<char*>(buffer.data()+bufferPosition), transitions.data(), transitions.size());
-  bufferPosition += transitions.size()/4;
-  
-  //The 'top level' types stored in the file
-  buffer[bufferPosition++] = nWordsInTypeNames;
-  
-  size_t bufferPositionInChars = bufferPosition*4;
-  for(auto const& t: typeNames) {
-    std::memcpy(reinterpret_cast<char*>(buffer.data())+bufferPositionInChars, t.data(), t.size());
-    bufferPositionInChars+=t.size();
-  }
-  //std::cout <<bufferPositionInChars<<" "<<bufferPosition*4<<" "<<bufferPositionInChars-bufferPosition*4<<" "<<nCharactersInTypeNames<<std::endl;
-  assert(bufferPositionInChars-bufferPosition*4 == nCharactersInTypeNames);
-  
-  bufferPosition += nWordsInTypeNames;
-  
-  //Information about types that are not at the 'top level' (none for now)
-  buffer[bufferPosition++] = 0;
-  
-  //The different data products to be stored
-  buffer[bufferPosition++] = dataProducts.size();
-  for(auto const& dp : dataProducts) {
-    buffer[bufferPosition++] = dp.first;
-    std::memcpy(reinterpret_cast<char*>(buffer.data()+bufferPosition), dp.second.data(), dp.second.size());
-    assert(0 == dp.second.size() % 4);
-    bufferPosition += dp.second.size()/4;
+  auto const header = pds::fileHeader(serialization_, compression_, products, dictionaryBlob_, perProductCompression_, checksum_, shuffleTypeSizes_,
+                                      false, {}, bool(repeatedProducts_));
+  writeToFile(reinterpret_cast<char const*>(header.data()), header.size()*4);
+}
+
+std::array<uint32_t, kEventHeaderSizeInWords> PDSOutputer::eventHeader(EventIdentifier const& iEventID) {
+  std::array<uint32_t, kEventHeaderSizeInWords> buffer;
+  buffer[0] = kEventRecordType;
+  buffer[1] = iEventID.run;
+  buffer[2] = iEventID.lumi;
+  buffer[3] = (iEventID.event >> 32) & 0xFFFFFFFF;
+  buffer[4] = iEventID.event & 0xFFFFFFFF;
+  return buffer;
+}
+
+void PDSOutputer::writeEventHeader(EventIdentifier const& iEventID) {
+  auto const buffer = eventHeader(iEventID);
+  writeToFile(reinterpret_cast<char const*>(buffer.data()), buffer.size()*4);
+}
+
+void PDSOutputer::writeDataProductsToOutputBuffer(SerializeStrategy const& iSerializers, pds::CompressionContext& iContext, int iCompressionLevel, LaneBuffers& ioBuffers) const{
+  if(perProductCompression_) {
+    ioBuffers.event_ = writeDataProductsToPerProductBuffer(iSerializers, iContext, iCompressionLevel);
+    return;
   }
-  
-  {
-    //The file type identifier
-    uint32_t comp = 0;
-    if(serialization_ == Serialization::kRootUnrolled) {
-      comp = 1;
+  writeDataProductsToUncompressedBuffer(iSerializers, ioBuffers.uncompressed_);
+  compressEventBuffer(ioBuffers.uncompressed_, iContext, iCompressionLevel, ioBuffers.event_);
+}
+
+std::vector<uint32_t> PDSOutputer::writeDataProductsToPerProductBuffer(SerializeStrategy const& iSerializers, pds::CompressionContext& iContext, int iCompressionLevel) const{
+  std::vector<std::vector<char>> compressed;
+  compressed.reserve(iSerializers.size());
+  //uncompressed size, number of products, 3 words per product in the table and the optional checksum
+  uint32_t recordSize = 2+3*iSerializers.size()+(checksum_ ? 1 : 0);
+  uint32_t uncompressedSize = 0;
+  std::vector<char> shuffled;
+  uint32_t index = 0;
+  for(auto const& s: iSerializers) {
+    PerfScope perf(PerfCounters::kCompress);
+    auto const typeSize = shuffleTypeSizes_.empty() ? 0U : shuffleTypeSizes_[index++];
+    if(typeSize != 0) {
+      shuffled.resize(s.blob().size());
+      byteShuffle(s.blob().data(), shuffled.data(), shuffled.size(), typeSize);
+      compressed.push_back(pds::compressBuffer(0, 0, compression_, iCompressionLevel, BlobView(shuffled), iContext));
+    } else {
+      compressed.push_back(pds::compressBuffer(0, 0, compression_, iCompressionLevel, s.blob(), iContext));
     }
-    const uint32_t id = 3141592*256+1 + comp;
-    file_.write(reinterpret_cast<char const*>(&id), 4);
+    recordSize += bytesToWords(compressed.back().size());
+    uncompressedSize += bytesToWords(s.blob().size())*4;
   }
-  {
-    //The 'unique' file id, just dummy for now
-    const uint32_t fileID = 0;
-    file_.write(reinterpret_cast<char const*>(&fileID), 4);     
+
+  //the record size is stored before the record and again after as a crosscheck
+  std::vector<uint32_t> buffer(size_t(recordSize+2), 0);
+  uint32_t bufferIndex = 0;
+  buffer[bufferIndex++] = recordSize;
+  buffer[bufferIndex++] = uncompressedSize;
+  buffer[bufferIndex++] = iSerializers.size();
+  uint32_t dataProductIndex = 0;
+  for(auto const& s: iSerializers) {
+    buffer[bufferIndex++] = dataProductIndex;
+    buffer[bufferIndex++] = compressed[dataProductIndex].size();
+    buffer[bufferIndex++] = s.blob().size();
+    ++dataProductIndex;
   }
-  {
-    //Compression type used
-    // note want exactly 4 bytes so sometimes skip trailing \0
-    file_.write(pds::name(compression_), 4);
+  for(auto const& c: compressed) {
+    std::copy(c.begin(), c.end(), reinterpret_cast<char*>(buffer.data()+bufferIndex));
+    bufferIndex += bytesToWords(c.size());
   }
-  
-  //The size of the header buffer in words (excluding first 3 words)
-  const uint32_t bufferSize = buffer.size();
-  file_.write(reinterpret_cast<char const*>(&bufferSize), 4);
-  
-  file_.write(reinterpret_cast<char const*>(buffer.data()), bufferSize*4);
-  //for(auto v: buffer) {
-  //  file_.write(reinterpret_cast<char const*>(&v), sizeof(v));
-  //}
-  
-  //The size of the header buffer in words (excluding first 3 words)
-  file_.write(reinterpret_cast<char const*>(&bufferSize), 4);
+  if(checksum_) {
+    buffer[bufferIndex] = crc32c(buffer.data()+1, (bufferIndex-1)*4);
+    ++bufferIndex;
+  }
+  buffer[bufferIndex++] = recordSize;
+  assert(buffer.size() == bufferIndex);
+  return buffer;
 }
 
-void PDSOutputer::writeEventHeader(EventIdentifier const& iEventID) {
-  constexpr unsigned int headerBufferSizeInWords = 5;
-  std::array<uint32_t,headerBufferSizeInWords> buffer;
-  buffer[0] = 0; //Record index for Event
-  buffer[1] = iEventID.run;
-  buffer[2] = iEventID.lumi;
-  buffer[3] = (iEventID.event >> 32) & 0xFFFFFFFF;
-  buffer[4] = iEventID.event & 0xFFFFFFFF;
-  file_.write(reinterpret_cast<char const*>(buffer.data()), headerBufferSizeInWords*4);
+std::vector<uint32_t> PDSOutputer::writeDataProductsToUncompressedBuffer(SerializeStrategy const& iSerializers) const{
+  std::vector<uint32_t> buffer;
+  writeDataProductsToUncompressedBuffer(iSerializers, buffer);
+  return buffer;
 }
 
-std::vector<uint32_t> PDSOutputer::writeDataProductsToOutputBuffer(SerializeStrategy const& iSerializers) const{
+void PDSOutputer::writeDataProductsToUncompressedBuffer(SerializeStrategy const& iSerializers, std::vector<uint32_t>& buffer) const{
+  //the entry of each repeated data product, see kRepeatedProductsRecord
+  std::vector<std::optional<uint32_t>> repeated;
+  if(repeatedProducts_) {
+    repeated.reserve(iSerializers.size());
+    uint32_t dataProductIndex = 0;
+    for(auto const& s: iSerializers) {
+      repeated.push_back(repeatedProducts_->entry(dataProductIndex++, s.blobHash(), s.blob()));
+    }
+  }
   //Calculate buffer size needed
   uint32_t bufferSize = 0;
+  uint32_t dataProductIndex = 0;
   for(auto const& s: iSerializers) {
     bufferSize +=1+1;
+    if(not repeated.empty() and repeated[dataProductIndex++]) {
+      bufferSize += 1;
+      continue;
+    }
     auto const blobSize = s.blob().size();
     bufferSize += bytesToWords(blobSize); //handles padding
   }
-  //initialize with 0
-  std::vector<uint32_t> buffer(size_t(bufferSize), 0);
+  //a reused buffer keeps its memory, only the padding needs to be cleared
+  buffer.resize(bufferSize);
   
   {
     uint32_t bufferIndex = 0;
     uint32_t dataProductIndex = 0;
     for(auto const& s: iSerializers) {
+      if(not repeated.empty() and repeated[dataProductIndex]) {
+        buffer[bufferIndex++] = (dataProductIndex++) | kRepeatedProductBit;
+        buffer[bufferIndex++] = 1;
+        buffer[bufferIndex++] = *repeated[dataProductIndex-1];
+        continue;
+      }
+      auto const typeSize = shuffleTypeSizes_.empty() ? 0U : shuffleTypeSizes_[dataProductIndex];
       buffer[bufferIndex++]=dataProductIndex++;
       auto const blobSize = s.blob().size();
       uint32_t sizeInWords = bytesToWords(blobSize);
       buffer[bufferIndex++]=sizeInWords;
-      std::copy(s.blob().begin(), s.blob().end(), reinterpret_cast<char*>( &(*(buffer.begin()+bufferIndex)) ) );
+      if(typeSize != 0) {
+        //the padding is shuffled along with the blob as the reader only knows the stored size
+        byteShuffle(s.blob().data(), blobSize, reinterpret_cast<char*>(buffer.data()+bufferIndex), sizeInWords*4, typeSize);
+        bufferIndex += sizeInWords;
+        continue;
+      }
+      if(sizeInWords != 0) {
+        buffer[bufferIndex+sizeInWords-1] = 0;
+      }
+      std::copy(s.blob().begin(), s.blob().end(), reinterpret_cast<char*>(buffer.data()+bufferIndex));
       bufferIndex += sizeInWords;
     }
     assert(buffer.size() == bufferIndex);
   }
+}
+
+std::vector<uint32_t> PDSOutputer::compressEventBuffer(std::vector<uint32_t> const& buffer, pds::CompressionContext& iContext) const {
+  std::vector<uint32_t> cBuffer;
+  compressEventBuffer(buffer, iContext, compressionLevel_, cBuffer);
+  return cBuffer;
+}
 
-  auto [cBuffer,cSize] = compressBuffer(2, 1, buffer);
+void PDSOutputer::compressEventBuffer(std::vector<uint32_t> const& buffer, pds::CompressionContext& iContext, int iCompressionLevel, std::vector<uint32_t>& cBuffer) const {
+  unsigned int const nChecksumWords = checksum_ ? 1 : 0;
+  auto cSize = [&]() {
+    PerfScope perf(PerfCounters::kCompress);
+    return pds::compressBuffer(2, 1+nChecksumWords, compression_, iCompressionLevel, buffer, iContext, cBuffer);
+  }();
 
   //std::cout <<"compressed "<<cSize<<" uncompressed "<<buffer.size()*4<<std::endl;
   //std::cout <<"compressed "<<(buffer.size()*4)/float(cSize)<<std::endl;
-  uint32_t const recordSize = bytesToWords(cSize)+1;
+  uint32_t const recordSize = bytesToWords(cSize)+1+nChecksumWords;
   cBuffer[0] = recordSize;
   //Record the actual number of bytes used in the last word of the compression buffer in the lowest
   // 2 bits of the word
@@ -223,12 +783,11 @@ std::vector<uint32_t> PDSOutputer::writeDataProductsToOutputBuffer(SerializeStra
     std::cout <<"BAD BUFFER SIZE: want: "<<recordSize+2<<" got "<<cBuffer.size()<<std::endl;
   }
   assert(cBuffer.size() == recordSize+2);
+  if(checksum_) {
+    //computed here so it is done in parallel with the other events
+    cBuffer[recordSize] = crc32c(cBuffer.data()+1, (recordSize-1)*4);
+  }
   cBuffer[recordSize+1]=recordSize;
-  return cBuffer;
-}
-
-std::pair<std::vector<uint32_t>,int> PDSOutputer::compressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, std::vector<uint32_t> const& iBuffer) const {
-  return pds::compressBuffer(iLeadPadding, iTrailingPadding, compression_, compressionLevel_, iBuffer);
 }
 
 namespace {
@@ -261,8 +820,96 @@ namespace {
         std::cout <<"unknown serialization "<<serializationName<<std::endl;
         return {};
       }
+
+      auto queueDrainBudget = params.get<unsigned int>("queueDrainBudget", 0);
+      bool eventIndex = params.get<bool>("eventIndex", false);
+
+      auto dictionaryTrainingEvents = params.get<unsigned int>("dictionaryTrainingEvents", 0);
+      std::size_t maxDictionarySize = params.get<unsigned int>("dictionarySize", 112640);
+      if(dictionaryTrainingEvents != 0 and not pds::isZSTD(*compression)) {
+        std::cout <<"dictionaryTrainingEvents can only be used with ZSTD compression"<<std::endl;
+        return {};
+      }
+      bool perProductCompression = params.get<bool>("perProductCompression", false);
+      if(perProductCompression and dictionaryTrainingEvents != 0) {
+        std::cout <<"perProductCompression can not be used with dictionaryTrainingEvents"<<std::endl;
+        return {};
+      }
       
-      return std::make_unique<PDSOutputer>(*fileName,iNLanes, *compression, compressionLevel, *serialization);
+      bool orderedOutput = params.get<bool>("orderedOutput", false);
+      auto orderedOutputWindow = params.get<unsigned int>("orderedOutputWindow", 64);
+      auto writeBufferSize = params.get<std::size_t>("writeBufferSize", 0);
+      auto asyncWriteBytes = params.get<std::size_t>("asyncWriteBytes", 0);
+      auto maxEventsInFlight = params.get<unsigned int>("maxEventsInFlight", 0);
+      auto maxHeldEvents = params.get<std::size_t>("maxHeldEvents", 0);
+      auto maxHeldBytes = params.get<std::size_t>("maxHeldBytes", 0);
+      auto coalesceBytes = params.get<std::size_t>("coalesceBytes", 0);
+      bool eventBuffer = params.get<bool>("eventBuffer", false);
+      if(eventBuffer and coalesceBytes == 0) {
+        std::cout <<"eventBuffer requires coalesceBytes"<<std::endl;
+        return {};
+      }
+      bool checksum = params.get<bool>("checksum", false);
+      bool lumiRecords = params.get<bool>("lumiRecords", false);
+      bool lumiIndex = params.get<bool>("lumiIndex", false);
+      if(lumiIndex and not eventIndex) {
+        std::cout <<"lumiIndex requires eventIndex"<<std::endl;
+        return {};
+      }
+      if(maxEventsInFlight != 0 and (orderedOutput or asyncWriteBytes != 0)) {
+        std::cout <<"maxEventsInFlight can not be used with orderedOutput or asyncWriteBytes"<<std::endl;
+        return {};
+      }
+      bool parallelWrite = params.get<bool>("parallelWrite", false);
+      if(parallelWrite and (orderedOutput or asyncWriteBytes != 0 or maxEventsInFlight != 0 or writeBufferSize != 0)) {
+        std::cout <<"parallelWrite can not be used with orderedOutput, asyncWriteBytes, maxEventsInFlight or writeBufferSize"<<std::endl;
+        return {};
+      }
+
+      auto preallocateBytes = params.get<std::size_t>("preallocateBytes", 0);
+      auto writeAlignment = params.get<std::size_t>("writeAlignment", 0);
+      if(writeAlignment != 0 and writeBufferSize < writeAlignment) {
+        std::cout <<"writeAlignment requires a writeBufferSize of at least writeAlignment"<<std::endl;
+        return {};
+      }
+
+      bool shuffle = params.get<bool>("shuffle", false);
+      bool deduplicate = params.get<bool>("deduplicate", false);
+      if(deduplicate and (perProductCompression or shuffle)) {
+        std::cout <<"deduplicate can not be used with perProductCompression or shuffle"<<std::endl;
+        return {};
+      }
+      auto chunkElements = params.get<unsigned int>("chunkElements", 0);
+      if(chunkElements != 0 and *serialization != pds::Serialization::kRootUnrolled and *serialization != pds::Serialization::kNativeUnrolled) {
+        std::cout <<"chunkElements can only be used with the Unrolled or NativeUnrolled serialization"<<std::endl;
+        return {};
+      }
+      bool adaptiveCompression = params.get<bool>("adaptiveCompression", false);
+      int minCompressionLevel = params.get<int>("minCompressionLevel", 1);
+      auto targetBacklog = params.get<unsigned int>("targetBacklog", 1);
+      if(adaptiveCompression) {
+        if(not pds::isZSTD(*compression)) {
+          std::cout <<"adaptiveCompression can only be used with ZSTD compression"<<std::endl;
+          return {};
+        }
+        //the dictionary fixes the level and the other modes compress or write away from the Lane
+        if(dictionaryTrainingEvents != 0 or maxEventsInFlight != 0 or parallelWrite) {
+          std::cout <<"adaptiveCompression can not be used with dictionaryTrainingEvents, maxEventsInFlight or parallelWrite"<<std::endl;
+          return {};
+        }
+        if(minCompressionLevel > compressionLevel) {
+          std::cout <<"minCompressionLevel can not be larger than compressionLevel"<<std::endl;
+          return {};
+        }
+      }
+
+      return std::make_unique<PDSOutputer>(*fileName,iNLanes, *compression, compressionLevel, *serialization, queueDrainBudget, eventIndex,
+                                           dictionaryTrainingEvents, maxDictionarySize, perProductCompression,
+                                           orderedOutput, orderedOutputWindow, writeBufferSize, asyncWriteBytes, maxEventsInFlight,
+                                           maxHeldEvents, maxHeldBytes, coalesceBytes, checksum,
+                                           lumiRecords, lumiIndex, parallelWrite,
+                                           adaptiveCompression, minCompressionLevel, targetBacklog, shuffle, deduplicate, chunkElements, eventBuffer,
+                                           preallocateBytes, writeAlignment);
     }
     
   };
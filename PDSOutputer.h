@@ -1,67 +1,273 @@
 #if !defined(PDSOutputer_h)
 #define PDSOutputer_h
 
+#include <array>
 #include <vector>
 #include <string>
 #include <cstdint>
 #include <fstream>
+#include <memory>
+#include <atomic>
+#include <optional>
+#include <set>
+#include <mutex>
 
 #include "OutputerBase.h"
 #include "EventIdentifier.h"
 #include "SerializeStrategy.h"
 #include "DataProductRetriever.h"
 #include "pds_common.h"
+#include "pds_reading.h"
+#include "pds_writer.h"
 
 #include "SerialTaskQueue.h"
+#include "PerLaneCounter.h"
+#include "EventReorderBuffer.h"
+#include "WriteBehindBuffer.h"
+#include "AsyncPipeline.h"
+#include "InFlightLimit.h"
+#include "CompressionLevelController.h"
+#include "StorageEmulator.h"
+#include "FilePreallocator.h"
+
+#include "tbb/enumerable_thread_specific.h"
 
 namespace cce::tf {
 class PDSOutputer :public OutputerBase {
  public:
  PDSOutputer(std::string const& iFileName, unsigned int iNLanes, pds::Compression iCompression, int iCompressionLevel, 
-             pds::Serialization iSerialization ): 
+             pds::Serialization iSerialization, unsigned int iQueueDrainBudget=0, bool iWriteEventIndex=false,
+             unsigned int iDictionaryTrainingEvents=0, std::size_t iMaxDictionarySize=0, bool iPerProductCompression=false,
+             bool iOrderedOutput=false, unsigned int iOrderedOutputWindow=0, std::size_t iWriteBufferSize=0,
+             std::size_t iAsyncWriteBytes=0, unsigned int iMaxEventsInFlight=0,
+             unsigned long long iMaxHeldEvents=0, unsigned long long iMaxHeldBytes=0, std::size_t iCoalesceBytes=0, bool iChecksum=false,
+             bool iLumiRecords=false, bool iLumiIndex=false, bool iParallelWrite=false,
+             bool iAdaptiveCompression=false, int iMinCompressionLevel=1, unsigned int iTargetBacklog=1, bool iShuffle=false,
+             bool iDeduplicate=false, unsigned int iChunkElements=0, bool iEventBuffer=false,
+             std::size_t iPreallocateBytes=0, std::size_t iWriteAlignment=0): 
   file_(iFileName, std::ios_base::out| std::ios_base::binary),
+  writeBufferSize_{iWriteBufferSize},
+  writeAlignment_{iWriteAlignment},
+  coalesceBytes_{iCoalesceBytes},
   serializers_{std::size_t(iNLanes)},
+  eventBuffers_{iEventBuffer ? std::size_t(iNLanes) : 0},
+  compressionContexts_{std::size_t(iNLanes)},
+  laneBuffers_{std::size_t(iNLanes)},
   compression_{iCompression},
   compressionLevel_{iCompressionLevel},
   serialization_{iSerialization},
+  writeEventIndex_{iWriteEventIndex},
+  perProductCompression_{iPerProductCompression},
+  checksum_{iChecksum},
+  shuffle_{iShuffle},
+  deduplicate_{iDeduplicate},
+  chunkElements_{iChunkElements},
+  lumiRecords_{iLumiRecords},
+  lumiIndex_{iLumiIndex},
+  dictionaryTrainingEvents_{iDictionaryTrainingEvents},
+  maxDictionarySize_{iMaxDictionarySize},
+  dictionaryTrained_{iDictionaryTrainingEvents == 0},
   serialTime_{std::chrono::microseconds::zero()},
-  parallelTime_{0}
-  {}
+  parallelTime_{iNLanes}
+  {
+    queue_.setDrainBudget(iQueueDrainBudget);
+    writeBuffer_.reserve(writeBufferSize_);
+    if(iOrderedOutput) {
+      reorderBuffer_.emplace(iOrderedOutputWindow);
+    }
+    if(iAsyncWriteBytes != 0) {
+      writeBehind_ = std::make_unique<WriteBehindBuffer>(iAsyncWriteBytes, [this](std::vector<char> const& iBuffer) {
+          emulateStorageRequest(iBuffer.size());
+          file_.write(iBuffer.data(), iBuffer.size()); });
+    }
+    if(iMaxEventsInFlight != 0) {
+      setupPipeline(iMaxEventsInFlight);
+    }
+    if(iMaxHeldEvents != 0 or iMaxHeldBytes != 0) {
+      heldLimit_ = std::make_unique<InFlightLimit>(iMaxHeldEvents, iMaxHeldBytes);
+    }
+    if(iParallelWrite) {
+      openForParallelWrite(iFileName);
+    }
+    if(iPreallocateBytes != 0) {
+      preallocator_ = std::make_unique<FilePreallocator>(iFileName, iPreallocateBytes);
+    }
+    if(iAdaptiveCompression) {
+      levelController_ = std::make_unique<CompressionLevelController>(iNLanes, iMinCompressionLevel, iCompressionLevel, iTargetBacklog);
+    }
+  }
+
+  ~PDSOutputer();
 
   void setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) final;
+  bool setupForLaneIsThreadSafe() const final { return true; }
 
   void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const final;
   bool usesProductReadyAsync() const final {return true;}
 
-  void outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+  void setFirstEventIndex(long iEventIndex) final;
+
+  void readyForEventAsync(unsigned int iLaneIndex, TaskHolder iCallback) const final;
+  bool usesReadyForEventAsync() const final { return bool(heldLimit_); }
   
+  void finishAsync(TaskHolder iCallback) const final;
   void printSummary() const final;
+  void fillReport(RunReport&) const final;
+  void fillProfile(ProductProfile&) const final;
 
  private:
   static inline size_t bytesToWords(size_t nBytes) {
     return nBytes/4 + ( (nBytes % 4) == 0 ? 0 : 1);
   }
 
-  void output(EventIdentifier const& iEventID, SerializeStrategy const& iSerializers, std::vector<uint32_t> const& iBuffer);
+  struct OrderedEvent {
+    EventIdentifier eventID_;
+    unsigned int laneIndex_;
+    std::vector<uint32_t> buffer_;
+    bool compressed_;
+    //set when the Lane must wait for the event to be written
+    std::optional<TaskHolder> waitingLane_;
+    unsigned long long heldBytes_ = 0;
+  };
+  void outputInOrder(long iEventIndex, OrderedEvent iEvent, TaskHolder iCallback);
+
+  //an Event after its Lane has been released, see maxEventsInFlight
+  struct PipelineEvent {
+    EventIdentifier eventID_;
+    unsigned int laneIndex_ = 0;
+    std::vector<uint32_t> buffer_;
+    bool compressed_ = false;
+    unsigned long long heldBytes_ = 0;
+  };
+  void setupPipeline(unsigned int iMaxEventsInFlight);
+  void outputOrdered(OrderedEvent& iEvent);
+
+  //iBuffer is not yet compressed if iCompressed is false. It is only moved from if the event must be held for dictionary training.
+  void output(EventIdentifier const& iEventID, SerializeStrategy const& iSerializers, std::vector<uint32_t>& iBuffer, bool iCompressed);
+  void writeEvent(EventIdentifier const& iEventID, std::vector<uint32_t> const& iBuffer);
+  void openForParallelWrite(std::string const& iFileName);
+  //called from the output queue, returns the file offset where the event record is to be written
+  uint64_t reserveEventRegion(EventIdentifier const& iEventID, SerializeStrategy const& iSerializers, std::vector<uint32_t> const& iBuffer);
+  //writes the event record into the region given by reserveEventRegion, can be called concurrently
+  void writeEventAt(uint64_t iOffset, EventIdentifier const& iEventID, std::vector<uint32_t> const& iBuffer) const;
+  //combines small writes into writeBuffer_ so the file sees fewer, larger writes
+  void writeToFile(char const* iData, std::size_t iSize);
+  //only writes the largest multiple of iAlignment bytes, the rest stays in writeBuffer_
+  void flushWriteBuffer(std::size_t iAlignment = 1);
+  //includes what is still in writeBuffer_ or waiting in writeBehind_
+  uint64_t filePosition() const { return filePosition_; }
+  //when writing asynchronously, the Lane may have to wait for earlier writes to finish
+  void releaseLane(TaskHolder iCallback);
+  //the event is no longer held, see heldLimit_
+  unsigned long long hold(std::vector<uint32_t> const& iBuffer) const;
+  void written(unsigned long long iHeldBytes) const;
   void writeFileHeader(SerializeStrategy const& iSerializers);
+  void trainDictionaryAndWritePendingEvents();
+  //writes the held events, the event index and the repeated data products and waits for
+  // all writes. Only the first call does anything, the file is closed when deleted.
+  void finish();
 
   void writeEventHeader(EventIdentifier const& iEventID);
-  std::vector<uint32_t> writeDataProductsToOutputBuffer(SerializeStrategy const& iSerializers) const;
+  static std::array<uint32_t, pds::kEventHeaderSizeInWords> eventHeader(EventIdentifier const& iEventID);
+  void writeEventIndex();
+  void writeTransitionRecords(EventIdentifier const& iEventID);
+  void writeEmptyRecord(uint32_t iRecordType, uint32_t iRun, uint32_t iLumi);
+  //the buffers of a Lane are reused from one event to the next
+  struct LaneBuffers {
+    std::vector<uint32_t> uncompressed_;
+    //what is handed to the output queue
+    std::vector<uint32_t> event_;
+  };
+  void writeDataProductsToOutputBuffer(SerializeStrategy const& iSerializers, pds::CompressionContext&, int iCompressionLevel, LaneBuffers&) const;
+  std::vector<uint32_t> writeDataProductsToUncompressedBuffer(SerializeStrategy const& iSerializers) const;
+  void writeDataProductsToUncompressedBuffer(SerializeStrategy const& iSerializers, std::vector<uint32_t>& oBuffer) const;
+  //each data product is compressed on its own
+  std::vector<uint32_t> writeDataProductsToPerProductBuffer(SerializeStrategy const& iSerializers, pds::CompressionContext&, int iCompressionLevel) const;
+  std::vector<uint32_t> compressEventBuffer(std::vector<uint32_t> const& iBuffer, pds::CompressionContext&) const;
+  void compressEventBuffer(std::vector<uint32_t> const& iBuffer, pds::CompressionContext&, int iCompressionLevel, std::vector<uint32_t>& oBuffer) const;
 
-  std::pair<std::vector<uint32_t>, int> compressBuffer(unsigned int iReserveFirstNWords, unsigned int iPadding, std::vector<uint32_t> const& iBuffer) const;
 
 private:
   std::ofstream file_;
+  std::vector<char> writeBuffer_;
+  std::size_t writeBufferSize_;
+  //when not 0, writes from writeBuffer_ are multiples of this many bytes
+  std::size_t writeAlignment_;
+  mutable std::atomic<unsigned long long> nFileWrites_{0};
+  uint64_t filePosition_ = 0;
+  //when opened, the output queue only reserves the region of each event
+  // record and the Lanes write the records in parallel using pwrite
+  int fd_ = -1;
+  //when set, file_ is only written from its thread
+  std::unique_ptr<WriteBehindBuffer> writeBehind_;
+  //when set, the file's blocks are allocated ahead of filePosition_
+  std::unique_ptr<FilePreallocator> preallocator_;
 
   mutable SerialTaskQueue queue_;
   std::vector<std::pair<std::string, uint32_t>> dataProductIndices_;
+  //data products which serialized to at most this many bytes are not given their own task
+  std::size_t coalesceBytes_;
   mutable std::vector<SerializeStrategy> serializers_;
+  //when not empty, the coalesced data products of a Lane's event are serialized one after the other into its buffer
+  mutable std::vector<EventSerializationBuffer> eventBuffers_;
+  //one per lane so the compression state does not need to be remade for each event
+  mutable std::vector<pds::CompressionContext> compressionContexts_;
+  //a Lane's event_ buffer is only handed over, rather than reused, when orderedOutput lets the Lane continue before its event is written
+  mutable std::vector<LaneBuffers> laneBuffers_;
   pds::Compression compression_;
   int compressionLevel_;
   pds::Serialization serialization_;
   bool firstTime_ = true;
+  bool writeEventIndex_;
+  bool perProductCompression_;
+  //each event record ends with a crc32c, see kHeaderChecksumTag
+  bool checksum_;
+  //data products of basic numeric types are byte shuffled before compression, see kHeaderShuffleTag
+  bool shuffle_;
+  std::once_flag shuffleOnce_;
+  //filled from the first Lane set up, empty if no data product is shuffled
+  std::vector<uint8_t> shuffleTypeSizes_;
+  //data products which serialized the same as in the event before are stored as a reference, see kRepeatedProductsRecord
+  bool deduplicate_;
+  std::once_flag repeatedProductsOnce_;
+  //made when the first Lane is set up
+  std::unique_ptr<pds::RepeatedProducts> repeatedProducts_;
+  //top level collections with more elements are serialized in chunks by parallel tasks, 0 for never
+  unsigned int chunkElements_;
+  //Run and LuminosityBlock records are written ahead of their first event
+  bool lumiRecords_;
+  std::set<unsigned int> writtenRuns_;
+  std::set<std::pair<unsigned int, unsigned int>> writtenLumis_;
+  //the event index is ordered by luminosity block and followed by a luminosity block index
+  bool lumiIndex_;
+  std::vector<pds::EventIndexEntry> eventIndex_;
+  //when set, events are written in the order of their event index
+  std::optional<EventReorderBuffer<OrderedEvent>> reorderBuffer_;
+  //when set, Events are compressed and written after their Lane was released
+  std::unique_ptr<AsyncPipeline<PipelineEvent>> pipeline_;
+  //when set, Lanes wait before reading another event while too many are waiting to be written
+  std::unique_ptr<InFlightLimit> heldLimit_;
+  //when set, each Lane's compression level follows how well writes keep up, with compressionLevel_ as the highest
+  std::unique_ptr<CompressionLevelController> levelController_;
+  //the Lane's context can not be used once the Lane moved on
+  mutable tbb::enumerable_thread_specific<pds::CompressionContext> pipelineCompressionContexts_;
+
+  //Used when training a ZSTD dictionary from the first events. Those events
+  // are held uncompressed until the dictionary is made.
+  unsigned int dictionaryTrainingEvents_;
+  std::size_t maxDictionarySize_;
+  std::atomic<bool> dictionaryTrained_;
+  std::vector<char> dictionaryBlob_;
+  std::unique_ptr<pds::CompressionDictionary> dictionary_;
+  pds::CompressionContext serialCompressionContext_;
+  SerializeStrategy const* headerSerializers_ = nullptr;
+  std::vector<EventIdentifier> pendingEventIDs_;
+  std::vector<std::vector<uint32_t>> pendingEventBuffers_;
   mutable std::chrono::microseconds serialTime_;
-  mutable std::atomic<std::chrono::microseconds::rep> parallelTime_;
+  mutable PerLaneCounter<std::chrono::microseconds::rep> parallelTime_;
+  bool finished_ = false;
+  std::chrono::microseconds endOfJobTime_{0};
 };
 }
 #endif
@@ -5,14 +5,22 @@
 
 #include "Deserializer.h"
 #include "UnrolledDeserializer.h"
+#include "FixedLayoutDeserializer.h"
 
 using namespace cce::tf;
 using namespace cce::tf::pds;
 
 
 bool PDSSource::readEvent(long iEventIndex) {
+  if(not eventIndex_.empty() and iEventIndex != presentEventIndex_) {
+    if(iEventIndex >= eventIndex_.size()) {
+      return false;
+    }
+    file_->seekg(eventIndex_[iEventIndex].offsetInWords_*4);
+    presentEventIndex_ = iEventIndex;
+  }
   while(iEventIndex != presentEventIndex_) {
-    auto skipped = skipToNextEvent(file_);
+    auto skipped = skipToNextEvent(*file_);
     if(not skipped) {return false;}
     ++presentEventIndex_;
   }
@@ -23,25 +31,56 @@ bool PDSSource::readEvent(long iEventIndex) {
   return false;
 }
 
+std::optional<long> PDSSource::numberOfEvents() const {
+  if(eventIndex_.empty()) {
+    return std::nullopt;
+  }
+  return eventIndex_.size();
+}
+
 bool PDSSource::readEventContent() {
   std::vector<uint32_t> buffer;
-  if(not readCompressedEventBuffer(file_, eventID_, buffer)) {
+  if(not readCompressedEventBuffer(*file_, eventID_, buffer)) {
     return false;
   }
   //last entry in buffer is a crosscheck on its size
   buffer.pop_back();
-  std::vector<uint32_t> uBuffer = uncompressEventBuffer(compression_, buffer);
-  deserializeDataProducts(uBuffer.begin(), uBuffer.end(), dataProducts_, deserializers_);
+  if(checksum_) {
+    checkRecordChecksum(buffer.data(), buffer.data()+buffer.size(), eventID_);
+    buffer.pop_back();
+  }
+  if(perProductCompression_) {
+    uncompressAndDeserializeProducts(compression_, buffer.data(), buffer.data()+buffer.size(), productBuffer_, decompressionContext_,
+                                     dataProducts_, deserializers_, productMap_);
+    return true;
+  }
+  uncompressEventBuffer(compression_, buffer.data(), buffer.data()+buffer.size(), uncompressedBuffer_, decompressionContext_);
+  deserializeDataProducts(uncompressedBuffer_.begin(), uncompressedBuffer_.end(), dataProducts_, deserializers_, productMap_, &repeatedProductsCache_);
 
   return true;
 }
 
-PDSSource::PDSSource(std::string const& iName) :
+PDSSource::PDSSource(std::string const& iName, ProductSelector const& iSelector) :
                  SourceBase(),
-  file_{iName, std::ios_base::binary}
+  file_{std::make_unique<ByteSourceStream>(openByteSource(iName))}
 {
   pds::Serialization serialization;
-  auto productInfo = readFileHeader(file_, compression_, serialization);
+  pds::FileOptions options;
+  auto productInfo = readFileHeader(*file_, compression_, serialization, options);
+  if(not options.dictionary_.empty()) {
+    dictionary_ = std::make_unique<pds::DecompressionDictionary>(options.dictionary_);
+    decompressionContext_.setDictionary(dictionary_.get());
+  }
+  perProductCompression_ = options.perProductCompression_;
+  checksum_ = options.checksum_;
+  //the buffers hold the index of the data product in the file so no mapping is needed
+  decompressionContext_.setShuffle(std::move(options.shuffle_));
+  productMap_ = selectProducts(productInfo, iSelector);
+  eventIndex_ = readEventIndex(*file_);
+  if(options.repeatedProducts_) {
+    repeatedProducts_ = std::make_unique<std::vector<pds::RepeatedProduct>>(readRepeatedProducts(*file_));
+    repeatedProductsCache_ = pds::RepeatedProductsCache(repeatedProducts_.get(), productInfo.size());
+  }
 
   switch(serialization) {
   case pds::Serialization::kRoot: { 
@@ -50,6 +89,12 @@ PDSSource::PDSSource(std::string const& iName) :
   case pds::Serialization::kRootUnrolled: {
     deserializers_ = DeserializeStrategy::make<DeserializeProxy<UnrolledDeserializer>>(); break;
   }
+  case pds::Serialization::kNativeUnrolled: {
+    deserializers_ = DeserializeStrategy::make<DeserializeProxy<NativeUnrolledDeserializer>>(); break;
+  }
+  case pds::Serialization::kFixedLayout: {
+    deserializers_ = DeserializeStrategy::make<DeserializeProxy<FixedLayoutDeserializer>>(); break;
+  }
   }
 
   dataProducts_.reserve(productInfo.size());
@@ -89,7 +134,8 @@ namespace {
           std::cout <<"no file name given\n";
           return {};
         }
-        return std::make_unique<ReplicatedSharedSource<PDSSource>>(iNLanes, iNEvents, *fileName);
+        ProductSelector selector{params.get<std::string>("products", "")};
+        return makeReplicatedSource<PDSSource>(iNLanes, iNEvents, params, *fileName, selector);
     }
     };
 
@@ -5,7 +5,6 @@
 #include <memory>
 #include <chrono>
 #include <iostream>
-#include <fstream>
 
 
 #include "SourceBase.h"
@@ -21,7 +20,7 @@ class PDSDelayedRetriever : public DelayedProductRetriever {
 
 class PDSSource : public SourceBase {
 public:
-  PDSSource(std::string const& iName);
+  PDSSource(std::string const& iName, ProductSelector const& iSelector = ProductSelector());
   PDSSource(PDSSource&&) = default;
   PDSSource(PDSSource const&) = default;
   ~PDSSource();
@@ -29,20 +28,37 @@ public:
   size_t numberOfDataProducts() const final {return dataProducts_.size();}
   std::vector<DataProductRetriever>& dataProducts() final { return dataProducts_; }
   EventIdentifier eventIdentifier() final { return eventID_;}
+  //only known if the file has an event index
+  std::optional<long> numberOfEvents() const final;
 
   using buffer_iterator = std::vector<std::uint32_t>::const_iterator;
 private:
   bool readEvent(long iEventIndex) final; //returns true if an event was read
   bool readEventContent();
 
+  //set if the events were compressed using a ZSTD dictionary
+  std::unique_ptr<pds::DecompressionDictionary> dictionary_;
   pds::Compression compression_;
-  std::ifstream file_;
+  bool perProductCompression_;
+  bool checksum_;
+  pds::ProductMap productMap_;
+  //a pointer keeps the Source movable
+  std::unique_ptr<pds::ByteSourceStream> file_;
   long presentEventIndex_ = 0;
+  //empty if the file does not have an index
+  std::vector<pds::EventIndexEntry> eventIndex_;
   EventIdentifier eventID_;
   std::vector<DataProductRetriever> dataProducts_;
   DeserializeStrategy deserializers_;
   std::vector<void*> dataBuffers_;
   PDSDelayedRetriever delayedRetriever_;
+  pds::ReusableBuffer<uint32_t> uncompressedBuffer_;
+  //used when each data product was compressed separately
+  pds::ReusableBuffer<char> productBuffer_;
+  pds::DecompressionContext decompressionContext_;
+  //held by pointer so the cache still points to it after the Source is moved
+  std::unique_ptr<std::vector<pds::RepeatedProduct>> repeatedProducts_;
+  pds::RepeatedProductsCache repeatedProductsCache_;
 };
 }
 #endif
@@ -0,0 +1,124 @@
+#include "ParallelRNTupleSource.h"
+#include "SourceFactory.h"
+
+#include "TClass.h"
+#include <RVersion.h>
+#include <ROOT/RNTupleModel.hxx>
+
+#include <algorithm>
+#include <iostream>
+
+using namespace cce::tf;
+
+namespace {
+  const std::string eventIDBranchName{"EventID"};
+
+  std::unique_ptr<ROOT::Experimental::RNTupleReader> openReader(std::string const& iName, ProductSelector const& iSelector) {
+    auto reader = ROOT::Experimental::RNTupleReader::Open("Events", iName.c_str());
+    if(iSelector.keepsAll()) {
+      return reader;
+    }
+    //LoadEntry reads every field of the model so only give it the selected ones
+    auto selectedModel = ROOT::Experimental::RNTupleModel::Create();
+    for(auto* field: reader->GetModel().GetFieldZero().GetSubFields()) {
+      if(eventIDBranchName == field->GetFieldName() or iSelector.keep(field->GetFieldName())) {
+        selectedModel->AddField(ROOT::Experimental::RFieldBase::Create(field->GetFieldName(), field->GetTypeName()).Unwrap());
+      }
+    }
+    return ROOT::Experimental::RNTupleReader::Open(std::move(selectedModel), "Events", iName.c_str());
+  }
+}
+
+ParallelRNTupleSource::LaneInfo::LaneInfo(std::string const& iName, ProductSelector const& iSelector):
+  reader_{openReader(iName, iSelector)} {
+  auto const& model = reader_->GetModel();
+  entry_ = model.CreateEntry();
+
+  auto const& subfields = model.GetFieldZero().GetSubFields();
+  ptrToDataProducts_.reserve(subfields.size());
+  dataProducts_.reserve(subfields.size());
+  for(auto* field: subfields) {
+    if(eventIDBranchName == field->GetFieldName()) {
+      continue;
+    }
+    auto index = ptrToDataProducts_.size();
+    ptrToDataProducts_.push_back(entry_->GetPtr<void>(field->GetFieldName()).get());
+    dataProducts_.emplace_back(index,
+                               &ptrToDataProducts_[index],
+                               field->GetFieldName(),
+                               TClass::GetClass(field->GetTypeName().c_str()),
+                               &promptReader_);
+  }
+}
+
+ParallelRNTupleSource::ParallelRNTupleSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iName,
+                                             ProductSelector const& iSelector):
+  SharedSourceBase(iNEvents),
+  nextCluster_{0}
+{
+  laneInfos_.reserve(iNLanes);
+  for(unsigned int i = 0; i< iNLanes; ++i) {
+    laneInfos_.emplace_back(iName, iSelector);
+  }
+
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,32,0)
+  auto const& descriptor = laneInfos_[0].reader_->GetDescriptor();
+#else
+  auto const& descriptor = *laneInfos_[0].reader_->GetDescriptor();
+#endif
+  for(auto const& cluster: descriptor.GetClusterIterable()) {
+    long begin = cluster.GetFirstEntryIndex();
+    clusters_.emplace_back(begin, begin+cluster.GetNEntries());
+  }
+  //the descriptor does not guarantee the clusters are in entry order
+  std::sort(clusters_.begin(), clusters_.end());
+}
+
+void ParallelRNTupleSource::readEventAsync(unsigned int iLane, long iEventIndex, OptionalTaskHolder iTask) {
+  auto& laneInfo = laneInfos_[iLane];
+  if(laneInfo.nextEntry_ == laneInfo.endEntry_) {
+    auto cluster = nextCluster_++;
+    if(cluster >= clusters_.size()) {
+      return;
+    }
+    std::tie(laneInfo.nextEntry_, laneInfo.endEntry_) = clusters_[cluster];
+    ++laneInfo.nClusters_;
+  }
+  auto start = std::chrono::high_resolution_clock::now();
+  laneInfo.reader_->LoadEntry(laneInfo.nextEntry_++, *laneInfo.entry_);
+  laneInfo.identifier_ = *laneInfo.entry_->GetPtr<cce::tf::EventIdentifier>(eventIDBranchName);
+  laneInfo.readTime_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+  iTask.runNow();
+}
+
+void ParallelRNTupleSource::printSummary() const {
+  std::chrono::microseconds sourceTime = std::chrono::microseconds::zero();
+  for(auto const& l: laneInfos_) {
+    sourceTime += l.readTime_ + l.promptReader_.accumulatedTime();
+  }
+  std::cout <<"\nSource time: "<<sourceTime.count()<<"us\n"
+    "   clusters: "<<clusters_.size()<<"\n"
+    "   clusters per lane:";
+  for(auto const& l: laneInfos_) {
+    std::cout <<" "<<l.nClusters_;
+  }
+  std::cout <<"\n"<<std::endl;
+}
+
+namespace {
+    class Maker : public SourceMakerBase {
+  public:
+    Maker(): SourceMakerBase("ParallelRNTupleSource") {}
+      std::unique_ptr<SharedSourceBase> create(unsigned int iNLanes, unsigned long long iNEvents, ConfigurationParameters const& params) const final {
+        auto fileName = params.get<std::string>("fileName");
+        if(not fileName) {
+          std::cout <<"no file name given\n";
+          return {};
+        }
+        ProductSelector selector{params.get<std::string>("products", "")};
+        return std::make_unique<ParallelRNTupleSource>(iNLanes, iNEvents, *fileName, selector);
+    }
+    };
+
+  Maker s_maker;
+}
@@ -0,0 +1,68 @@
+#if !defined(ParallelRNTupleSource_h)
+#define ParallelRNTupleSource_h
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <utility>
+#include <chrono>
+
+#include "DataProductRetriever.h"
+#include "ProductSelector.h"
+
+#include "SharedSourceBase.h"
+#include "SerialRNTupleSource.h"
+#include "ROOT/RNTuple.hxx"
+#include "PerLaneCounter.h"
+
+namespace cce::tf {
+  /**
+     Reads an RNTuple using one RNTupleReader per Lane. Like ClusterRootSource,
+     each Lane claims a whole cluster from the descriptor's cluster list and
+     reads its entries one after the other. Claiming a cluster is the only
+     synchronization between Lanes. The events are therefore not processed
+     in file order.
+   */
+  class ParallelRNTupleSource : public SharedSourceBase {
+  public:
+    ParallelRNTupleSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iName,
+                          ProductSelector const& iSelector = ProductSelector());
+    ParallelRNTupleSource(ParallelRNTupleSource&&) = delete;
+    ParallelRNTupleSource(ParallelRNTupleSource const&) = delete;
+
+    size_t numberOfDataProducts() const final {return laneInfos_[0].dataProducts_.size();}
+    std::vector<DataProductRetriever>& dataProducts(unsigned int iLane, long iEventIndex) final {
+      return laneInfos_[iLane].dataProducts_;
+    }
+    EventIdentifier eventIdentifier(unsigned int iLane, long iEventIndex) final {
+      return laneInfos_[iLane].identifier_;
+    }
+
+    void printSummary() const final;
+  private:
+    void readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder) final;
+
+    struct alignas(kCacheLineSize) LaneInfo {
+      LaneInfo(std::string const& iName, ProductSelector const& iSelector);
+      LaneInfo(LaneInfo&&) = default;
+
+      std::unique_ptr<ROOT::Experimental::RNTupleReader> reader_;
+      std::unique_ptr<ROOT::Experimental::REntry> entry_;
+      SerialRNTuplePromptRetriever promptReader_;
+      std::vector<void*> ptrToDataProducts_;
+      std::vector<DataProductRetriever> dataProducts_;
+      EventIdentifier identifier_;
+      std::chrono::microseconds readTime_ = std::chrono::microseconds::zero();
+
+      //remaining entries of the claimed cluster
+      long nextEntry_ = 0;
+      long endEntry_ = 0;
+      unsigned int nClusters_ = 0;
+    };
+    std::vector<LaneInfo> laneInfos_;
+    std::vector<std::pair<long, long>> clusters_;
+    std::atomic<unsigned int> nextCluster_;
+  };
+}
+#endif
@@ -0,0 +1,42 @@
+#if !defined(PerLaneCounter_h)
+#define PerLaneCounter_h
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace cce::tf {
+  //state written by different Lanes for each event is kept on separate
+  // cache lines so the Lanes do not invalidate each other's caches
+  constexpr std::size_t kCacheLineSize = 64;
+
+  /**
+     A sum each Lane adds to without touching the cache lines of the other
+     Lanes. The total is only complete once the Lanes are done adding.
+   */
+  template<typename T>
+  class PerLaneCounter {
+  public:
+    explicit PerLaneCounter(unsigned int iNLanes): counters_(std::max(iNLanes, 1U)) {}
+
+    void add(unsigned int iLaneIndex, T iValue) {
+      counters_[iLaneIndex].value_.fetch_add(iValue, std::memory_order_relaxed);
+    }
+
+    T sum() const {
+      T total{0};
+      for(auto const& counter: counters_) {
+        total += counter.value_.load(std::memory_order_relaxed);
+      }
+      return total;
+    }
+
+  private:
+    struct alignas(kCacheLineSize) Counter {
+      std::atomic<T> value_{0};
+    };
+    std::vector<Counter> counters_;
+  };
+}
+#endif
@@ -0,0 +1,135 @@
+#include "PerfCounters.h"
+#include "RunReport.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace cce::tf {
+  std::atomic<bool> PerfCounters::s_enabled{false};
+
+  namespace {
+    char const* const kStageNames[PerfCounters::kNStages] = {"read", "decompress", "deserialize", "serialize", "compress"};
+    char const* const kCounterNames[PerfCounters::kNCounters] = {"cycles", "instructions", "cacheMisses"};
+    constexpr std::uint64_t kConfigs[PerfCounters::kNCounters] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+
+    struct StageTotals {
+      std::atomic<std::uint64_t> nScopes_{0};
+      std::array<std::atomic<std::uint64_t>, PerfCounters::kNCounters> values_{};
+    };
+    StageTotals s_totals[PerfCounters::kNStages];
+
+    int openCounter(std::uint64_t iConfig, int iGroupFD) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = iConfig;
+      attr.read_format = PERF_FORMAT_GROUP;
+      //only user space so perf_event_paranoid up to 2 allows it
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      return syscall(SYS_perf_event_open, &attr, 0, -1, iGroupFD, 0);
+    }
+
+    //all the counters of a thread are in one group so one read gets them all
+    class ThreadCounters {
+    public:
+      ThreadCounters() {
+        for(unsigned int i = 0; i < PerfCounters::kNCounters; ++i) {
+          fds_[i] = openCounter(kConfigs[i], i == 0 ? -1 : fds_[0]);
+          if(fds_[i] < 0) {
+            close();
+            return;
+          }
+        }
+      }
+      ~ThreadCounters() { close(); }
+      ThreadCounters(ThreadCounters const&) = delete;
+      ThreadCounters& operator=(ThreadCounters const&) = delete;
+
+      bool read(PerfCounters::Values& oValues) const {
+        if(fds_[0] < 0) {
+          return false;
+        }
+        std::uint64_t buffer[1+PerfCounters::kNCounters];
+        if(::read(fds_[0], buffer, sizeof(buffer)) != sizeof(buffer)) {
+          return false;
+        }
+        std::copy(buffer+1, buffer+1+PerfCounters::kNCounters, oValues.begin());
+        return true;
+      }
+    private:
+      void close() {
+        for(auto& fd: fds_) {
+          if(fd >= 0) {
+            ::close(fd);
+          }
+          fd = -1;
+        }
+      }
+      int fds_[PerfCounters::kNCounters] = {-1, -1, -1};
+    };
+
+    ThreadCounters const& threadCounters() {
+      thread_local ThreadCounters counters;
+      return counters;
+    }
+  }
+
+  bool PerfCounters::enable() {
+    Values values;
+    if(not threadCounters().read(values)) {
+      return false;
+    }
+    s_enabled.store(true);
+    return true;
+  }
+
+  bool PerfCounters::read(Values& oValues) {
+    return threadCounters().read(oValues);
+  }
+
+  void PerfCounters::add(Stage iStage, Values const& iStart, Values const& iEnd) {
+    auto& totals = s_totals[iStage];
+    totals.nScopes_.fetch_add(1, std::memory_order_relaxed);
+    for(unsigned int i = 0; i < kNCounters; ++i) {
+      totals.values_[i].fetch_add(iEnd[i]-iStart[i], std::memory_order_relaxed);
+    }
+  }
+
+  void PerfCounters::printSummary(std::ostream& oStream) {
+    oStream <<"hardware counters per stage:\n";
+    for(unsigned int s = 0; s < kNStages; ++s) {
+      auto const& totals = s_totals[s];
+      auto n = totals.nScopes_.load();
+      if(n == 0) {
+        continue;
+      }
+      auto cycles = totals.values_[kCycles].load();
+      auto instructions = totals.values_[kInstructions].load();
+      auto misses = totals.values_[kCacheMisses].load();
+      oStream <<"  "<<kStageNames[s]<<": calls "<<n<<" cycles "<<cycles<<" instructions "<<instructions
+              <<" IPC "<<(cycles == 0 ? 0. : double(instructions)/cycles)
+              <<" LLC misses "<<misses<<" misses per 1k instructions "<<(instructions == 0 ? 0. : misses*1000./instructions)<<"\n";
+    }
+    oStream <<std::flush;
+  }
+
+  void PerfCounters::fillReport(RunReport& oReport) {
+    for(unsigned int s = 0; s < kNStages; ++s) {
+      auto const& totals = s_totals[s];
+      if(totals.nScopes_.load() == 0) {
+        continue;
+      }
+      auto& stage = oReport.section(kStageNames[s]);
+      stage.set("calls", totals.nScopes_.load());
+      for(unsigned int i = 0; i < kNCounters; ++i) {
+        stage.set(kCounterNames[i], totals.values_[i].load());
+      }
+    }
+  }
+}
@@ -0,0 +1,61 @@
+#if !defined(PerfCounters_h)
+#define PerfCounters_h
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+namespace cce::tf {
+  class RunReport;
+
+  /**
+     Hardware counters (cycles, instructions and last level cache misses) of
+     the calling thread summed for each stage of the pipeline. The counters
+     are read through Linux's perf_event interface when a PerfScope starts
+     and ends, so only the work done by the thread within the scope is
+     counted. Nothing is counted unless enable succeeded.
+   */
+  class PerfCounters {
+  public:
+    enum Stage { kRead, kDecompress, kDeserialize, kSerialize, kCompress, kNStages };
+    enum Counter { kCycles, kInstructions, kCacheMisses, kNCounters };
+    using Values = std::array<std::uint64_t, kNCounters>;
+
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+    //returns false if the counters can not be used on this machine
+    static bool enable();
+
+    //false if the counters of this thread could not be opened
+    static bool read(Values&);
+    static void add(Stage, Values const& iStart, Values const& iEnd);
+
+    static void printSummary(std::ostream&);
+    static void fillReport(RunReport&);
+
+  private:
+    static std::atomic<bool> s_enabled;
+  };
+
+  class PerfScope {
+  public:
+    explicit PerfScope(PerfCounters::Stage iStage): stage_{iStage} {
+      if(PerfCounters::enabled()) {
+        active_ = PerfCounters::read(start_);
+      }
+    }
+    ~PerfScope() {
+      PerfCounters::Values end;
+      if(active_ and PerfCounters::read(end)) {
+        PerfCounters::add(stage_, start_, end);
+      }
+    }
+    PerfScope(PerfScope const&) = delete;
+    PerfScope& operator=(PerfScope const&) = delete;
+  private:
+    PerfCounters::Values start_;
+    PerfCounters::Stage stage_;
+    bool active_ = false;
+  };
+}
+#endif
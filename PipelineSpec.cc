@@ -0,0 +1,59 @@
+#include "PipelineSpec.h"
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+
+namespace cce::tf {
+  std::optional<PipelineSpec> parsePipelineSpec(std::string_view iSpec) {
+    std::istringstream items{std::string(iSpec)};
+    PipelineSpec spec;
+    if(not (items >> spec.name_ >> spec.source_ >> spec.outputer_)) {
+      std::cout <<"pipeline '"<<iSpec<<"' is not '<name> <Source configuration> <Outputer configuration> [<# lanes> [<Waiter configuration>]]'"<<std::endl;
+      return {};
+    }
+    std::string lanes;
+    if(items >> lanes) {
+      std::size_t used = 0;
+      long value = 0;
+      try {
+        value = std::stol(lanes, &used);
+      } catch(std::exception const&) {}
+      if(used != lanes.size() or value <= 0) {
+        std::cout <<"pipeline "<<spec.name_<<" has an invalid number of lanes '"<<lanes<<"'"<<std::endl;
+        return {};
+      }
+      spec.lanes_ = value;
+      items >> spec.waiter_;
+    }
+    std::string extra;
+    if(items >> extra) {
+      std::cout <<"pipeline "<<spec.name_<<" has an unexpected '"<<extra<<"'"<<std::endl;
+      return {};
+    }
+    return spec;
+  }
+
+  std::vector<int> partitionThreads(int iThreads, std::vector<unsigned int> const& iLanes) {
+    std::vector<int> threads(iLanes.size(), 1);
+    unsigned long long const totalLanes = std::accumulate(iLanes.begin(), iLanes.end(), 0ULL);
+    if(iThreads <= 0 or totalLanes == 0) {
+      return threads;
+    }
+    //largest remainder, ties go to the earlier pipeline
+    std::vector<std::pair<unsigned long long, std::size_t>> remainders;
+    int given = 0;
+    for(std::size_t i = 0; i < iLanes.size(); ++i) {
+      unsigned long long const share = static_cast<unsigned long long>(iThreads)*iLanes[i];
+      threads[i] = std::max(1, static_cast<int>(share/totalLanes));
+      given += threads[i];
+      remainders.emplace_back(share % totalLanes, i);
+    }
+    std::stable_sort(remainders.begin(), remainders.end(), [](auto const& a, auto const& b) { return a.first > b.first; });
+    for(int i = 0; i < iThreads - given and i < static_cast<int>(remainders.size()); ++i) {
+      ++threads[remainders[i].second];
+    }
+    return threads;
+  }
+}
@@ -0,0 +1,33 @@
+#if !defined(PipelineSpec_h)
+#define PipelineSpec_h
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cce::tf {
+  /**
+     One of several pipelines run at the same time by one job, each with its
+     own Source, Outputer, Waiter, Lanes and event counter. Used to see how
+     I/O workloads interfere when they share the threads of a node.
+   */
+  struct PipelineSpec {
+    std::string name_;
+    std::string source_;
+    std::string outputer_;
+    //empty for no Waiter
+    std::string waiter_;
+    //0 means the number of Lanes of the job
+    unsigned int lanes_ = 0;
+  };
+
+  //Reads '<name> <Source configuration> <Outputer configuration> [<# lanes> [<Waiter configuration>]]'.
+  // Prints the problem and returns nothing if not valid.
+  std::optional<PipelineSpec> parsePipelineSpec(std::string_view);
+
+  //Splits iThreads among pipelines in proportion to their number of Lanes.
+  // Each gets at least 1 thread, so the sum is larger than iThreads if there are more pipelines than threads.
+  std::vector<int> partitionThreads(int iThreads, std::vector<unsigned int> const& iLanes);
+}
+#endif
@@ -0,0 +1,56 @@
+#include "ProductNeeds.h"
+#include "ProductSelector.h"
+
+namespace cce::tf {
+
+  ProductNeeds::ProductNeeds(std::string_view iDeclaration) {
+    std::string_view::size_type start = 0;
+    while(start < iDeclaration.size()) {
+      auto pos = iDeclaration.find(',', start);
+      auto pattern = iDeclaration.substr(start, pos == std::string_view::npos ? std::string_view::npos : pos-start);
+      start = (pos == std::string_view::npos) ? iDeclaration.size() : pos+1;
+      if(not pattern.empty()) {
+        patterns_.emplace_back(pattern);
+      }
+    }
+    all_ = patterns_.empty();
+  }
+
+  ProductNeeds ProductNeeds::none() {
+    ProductNeeds needs;
+    needs.all_ = false;
+    return needs;
+  }
+
+  void ProductNeeds::add(ProductNeeds const& iOther) {
+    if(iOther.all_) {
+      all_ = true;
+      patterns_.clear();
+    }
+    if(all_) {
+      return;
+    }
+    patterns_.insert(patterns_.end(), iOther.patterns_.begin(), iOther.patterns_.end());
+  }
+
+  std::vector<unsigned int> ProductNeeds::order(std::vector<std::string> const& iNames) const {
+    std::vector<unsigned int> indices;
+    if(all_) {
+      indices.reserve(iNames.size());
+      for(unsigned int i = 0; i < iNames.size(); ++i) {
+        indices.push_back(i);
+      }
+      return indices;
+    }
+    std::vector<bool> used(iNames.size(), false);
+    for(auto const& pattern: patterns_) {
+      for(unsigned int i = 0; i < iNames.size(); ++i) {
+        if(not used[i] and matchesPattern(pattern, iNames[i])) {
+          used[i] = true;
+          indices.push_back(i);
+        }
+      }
+    }
+    return indices;
+  }
+}
@@ -0,0 +1,39 @@
+#if !defined(ProductNeeds_h)
+#define ProductNeeds_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cce::tf {
+  /**
+     The data products a Waiter or an Outputer uses and the order in which it
+     uses them. The declaration is a comma separated list of patterns where '*'
+     matches any number of characters, e.g. "ints,vfloats" or "vec*". Data
+     products are used in the order of the first pattern they match and, for
+     the same pattern, in the order of the Source. An empty declaration, the
+     default, uses all data products in the order of the Source.
+   */
+  class ProductNeeds {
+  public:
+    ProductNeeds() = default;
+    explicit ProductNeeds(std::string_view iDeclaration);
+
+    static ProductNeeds none();
+
+    bool needsAll() const { return all_; }
+
+    //adds the data products of iOther, used after those already needed
+    void add(ProductNeeds const& iOther);
+
+    //The indices into iNames, the names of the Source's data products, of the
+    // needed data products in the order they are used.
+    std::vector<unsigned int> order(std::vector<std::string> const& iNames) const;
+
+  private:
+    std::vector<std::string> patterns_;
+    bool all_ = true;
+  };
+}
+
+#endif
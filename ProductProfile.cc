@@ -0,0 +1,73 @@
+#include "ProductProfile.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+namespace cce::tf {
+  namespace {
+    constexpr std::string_view kHeader = "# threaded_io_test product profile";
+
+    ProductProfile s_serializationProfile;
+  }
+
+  void ProductProfile::add(std::string_view iName, ProductProfileEntry const& iEntry) {
+    auto it = entries_.find(iName);
+    if(it == entries_.end()) {
+      entries_.emplace(std::string(iName), iEntry);
+      return;
+    }
+    auto& entry = it->second;
+    entry.nEntries_ += iEntry.nEntries_;
+    entry.totalBytes_ += iEntry.totalBytes_;
+    //the larger keeps at least 99% of the combined entries below it
+    entry.p99Bytes_ = std::max(entry.p99Bytes_, iEntry.p99Bytes_);
+    entry.maxBytes_ = std::max(entry.maxBytes_, iEntry.maxBytes_);
+    entry.serializeTime_us_ += iEntry.serializeTime_us_;
+  }
+
+  ProductProfileEntry const* ProductProfile::find(std::string_view iName) const {
+    auto it = entries_.find(iName);
+    return it == entries_.end() ? nullptr : &it->second;
+  }
+
+  void ProductProfile::write(std::ostream& oStream) const {
+    oStream <<kHeader<<"\n";
+    for(auto const& [name, entry]: entries_) {
+      oStream <<name<<" "<<entry.nEntries_<<" "<<entry.totalBytes_<<" "<<entry.p99Bytes_<<" "<<entry.maxBytes_<<" "<<entry.serializeTime_us_<<"\n";
+    }
+  }
+
+  std::optional<ProductProfile> ProductProfile::read(std::istream& iStream) {
+    std::string line;
+    if(not std::getline(iStream, line) or line != kHeader) {
+      std::cout <<"not a product profile, the first line is not '"<<kHeader<<"'"<<std::endl;
+      return {};
+    }
+    ProductProfile profile;
+    unsigned int lineNumber = 1;
+    while(std::getline(iStream, line)) {
+      ++lineNumber;
+      std::istringstream items(line);
+      std::string name;
+      if(not (items >> name)) {
+        continue;
+      }
+      ProductProfileEntry entry;
+      if(not (items >> entry.nEntries_ >> entry.totalBytes_ >> entry.p99Bytes_ >> entry.maxBytes_ >> entry.serializeTime_us_)) {
+        std::cout <<"product profile line "<<lineNumber<<" is not '<name> <# entries> <total bytes> <p99 bytes> <max bytes> <serialize time us>'"<<std::endl;
+        return {};
+      }
+      profile.add(name, entry);
+    }
+    return profile;
+  }
+
+  void setSerializationProfile(ProductProfile iProfile) {
+    s_serializationProfile = std::move(iProfile);
+  }
+
+  ProductProfileEntry const* serializationProfile(std::string_view iName) {
+    return s_serializationProfile.find(iName);
+  }
+}
@@ -0,0 +1,53 @@
+#if !defined(ProductProfile_h)
+#define ProductProfile_h
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace cce::tf {
+  /**
+     What a job measured of each data product, written with --write-profile
+     so a later job given it with --use-profile can size buffers and pick
+     per data product settings before it has seen any event.
+   */
+  struct ProductProfileEntry {
+    std::uint64_t nEntries_ = 0;
+    std::uint64_t totalBytes_ = 0;
+    //serialized size below which 99% of the entries were
+    std::size_t p99Bytes_ = 0;
+    std::size_t maxBytes_ = 0;
+    double serializeTime_us_ = 0;
+
+    double meanSerializeTime_us() const { return nEntries_ == 0 ? 0. : serializeTime_us_/nEntries_; }
+  };
+
+  class ProductProfile {
+  public:
+    //entries of the same data product, e.g. from different Lanes, are combined
+    void add(std::string_view iName, ProductProfileEntry const& iEntry);
+
+    //nullptr if the data product was not profiled
+    ProductProfileEntry const* find(std::string_view iName) const;
+    std::map<std::string, ProductProfileEntry, std::less<>> const& entries() const { return entries_; }
+    bool empty() const { return entries_.empty(); }
+
+    //one line per data product: '<name> <# entries> <total bytes> <p99 bytes> <max bytes> <serialize time us>'
+    void write(std::ostream&) const;
+    //reads what write wrote. Prints the problem and returns nothing if not valid.
+    static std::optional<ProductProfile> read(std::istream&);
+
+  private:
+    std::map<std::string, ProductProfileEntry, std::less<>> entries_;
+  };
+
+  //The profile the serializers made afterwards use. Must be set before any is made.
+  void setSerializationProfile(ProductProfile);
+  //nullptr if no profile was set or it does not have the data product
+  ProductProfileEntry const* serializationProfile(std::string_view iName);
+}
+#endif
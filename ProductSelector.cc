@@ -0,0 +1,62 @@
+#include "ProductSelector.h"
+
+namespace cce::tf {
+
+  ProductSelector::ProductSelector(std::string_view iSelection) {
+    std::string_view::size_type start = 0;
+    while(start < iSelection.size()) {
+      auto pos = iSelection.find(',', start);
+      auto pattern = iSelection.substr(start, pos == std::string_view::npos ? std::string_view::npos : pos-start);
+      start = (pos == std::string_view::npos) ? iSelection.size() : pos+1;
+      if(pattern.empty()) {
+        continue;
+      }
+      bool include = true;
+      if(pattern[0] == '-') {
+        include = false;
+        pattern.remove_prefix(1);
+      }
+      patterns_.push_back({std::string(pattern), include});
+    }
+  }
+
+  bool ProductSelector::keep(std::string_view iName) const {
+    if(patterns_.empty()) {
+      return true;
+    }
+    bool kept = not patterns_.front().include_;
+    for(auto const& p: patterns_) {
+      if(matchesPattern(p.pattern_, iName)) {
+        kept = p.include_;
+      }
+    }
+    return kept;
+  }
+
+  bool matchesPattern(std::string_view iPattern, std::string_view iName) {
+    //position of the last '*' seen and where in iName it started matching
+    std::string_view::size_type starPattern = std::string_view::npos;
+    std::string_view::size_type starName = 0;
+    std::string_view::size_type p = 0;
+    std::string_view::size_type n = 0;
+    while(n < iName.size()) {
+      if(p < iPattern.size() and iPattern[p] == '*') {
+        starPattern = p++;
+        starName = n;
+      } else if(p < iPattern.size() and iPattern[p] == iName[n]) {
+        ++p;
+        ++n;
+      } else if(starPattern != std::string_view::npos) {
+        //let the last '*' match one more character
+        p = starPattern+1;
+        n = ++starName;
+      } else {
+        return false;
+      }
+    }
+    while(p < iPattern.size() and iPattern[p] == '*') {
+      ++p;
+    }
+    return p == iPattern.size();
+  }
+}
@@ -0,0 +1,38 @@
+#if !defined(ProductSelector_h)
+#define ProductSelector_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cce::tf {
+  /**
+     Decides which data products a Source provides. The selection is a comma
+     separated list of patterns where '*' matches any number of characters.
+     A pattern starting with '-' removes the matching data products, any other
+     pattern adds them. The last matching pattern decides. If the first pattern
+     removes data products, all others are kept, otherwise only data products
+     matching a pattern are kept. An empty selection keeps all data products.
+       e.g. "ints,vfloats"  or  "-*Aux*"  or  "vec*,-vecDouble"
+   */
+  class ProductSelector {
+  public:
+    ProductSelector() = default;
+    explicit ProductSelector(std::string_view iSelection);
+
+    bool keep(std::string_view iName) const;
+    bool keepsAll() const { return patterns_.empty(); }
+
+  private:
+    struct Pattern {
+      std::string pattern_;
+      bool include_;
+    };
+    std::vector<Pattern> patterns_;
+  };
+
+  //true if iName matches iPattern where '*' matches any number of characters
+  bool matchesPattern(std::string_view iPattern, std::string_view iName);
+}
+
+#endif
@@ -0,0 +1,83 @@
+#include "ProductView.h"
+#include "UnrolledSerializer.h"
+
+#include "TClass.h"
+
+#include <tuple>
+
+using namespace cce::tf;
+
+namespace {
+  using ViewableTypes = std::tuple<char, unsigned char, short, unsigned short, int, unsigned int,
+                                   long, unsigned long, float, double>;
+
+  template<typename T>
+  std::optional<std::size_t> headerBytes() {
+    auto cls = TClass::GetClass(typeid(std::vector<T>));
+    if(nullptr == cls) {
+      return {};
+    }
+    std::vector<T> const probe = {T(1), T(2), T(3)};
+    NativeUnrolledSerializer serializer(cls);
+    auto blob = serializer.serializeToView(&probe);
+    std::size_t const elementBytes = probe.size()*sizeof(T);
+    if(blob.size() < sizeof(int32_t) + elementBytes) {
+      return {};
+    }
+    std::size_t const header = blob.size() - sizeof(int32_t) - elementBytes;
+    int32_t size;
+    std::memcpy(&size, blob.data()+header, sizeof(size));
+    if(size != int32_t(probe.size()) or
+       0 != std::memcmp(blob.data()+header+sizeof(size), probe.data(), elementBytes)) {
+      return {};
+    }
+    return header;
+  }
+
+  template<std::size_t I = 0>
+  std::optional<std::size_t> headerBytesFor(std::type_info const& iType) {
+    if constexpr (I == std::tuple_size_v<ViewableTypes>) {
+      return {};
+    } else {
+      using T = std::tuple_element_t<I, ViewableTypes>;
+      if(iType == typeid(T)) {
+        return headerBytes<T>();
+      }
+      return headerBytesFor<I+1>(iType);
+    }
+  }
+
+  template<std::size_t I = 0>
+  bool canViewVector(std::type_info const& iVectorType) {
+    if constexpr (I == std::tuple_size_v<ViewableTypes>) {
+      return false;
+    } else {
+      using T = std::tuple_element_t<I, ViewableTypes>;
+      if(iVectorType == typeid(std::vector<T>)) {
+        static std::optional<std::size_t> const s_headerBytes = headerBytes<T>();
+        return s_headerBytes.has_value();
+      }
+      return canViewVector<I+1>(iVectorType);
+    }
+  }
+}
+
+namespace cce::tf::productview {
+  std::optional<std::size_t> nativeVectorHeaderBytes(std::type_info const& iElementType) {
+    return headerBytesFor(iElementType);
+  }
+
+  bool canView(TClass& iClass) {
+    auto typeInfo = iClass.GetTypeInfo();
+    return typeInfo and canViewVector(*typeInfo);
+  }
+
+  bool isVectorOf(DataProductRetriever const& iProduct, std::type_info const& iVectorType) {
+    auto cls = iProduct.classType();
+    if(nullptr == cls) {
+      return false;
+    }
+    auto typeInfo = cls->GetTypeInfo();
+    return typeInfo and *typeInfo == iVectorType;
+  }
+}
@@ -0,0 +1,97 @@
+#if !defined(ProductView_h)
+#define ProductView_h
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+#include "DataProductRetriever.h"
+
+class TClass;
+
+namespace cce::tf {
+  /**
+     Read only access to the elements of a std::vector<T> data product read in
+     place from the buffer the Source decompressed into. It is only valid until
+     the Lane's next event.
+   */
+  template<typename T>
+  class ProductView {
+  public:
+    ProductView(T const* iData, std::size_t iSize): data_{iData}, size_{iSize} {}
+
+    T const* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    T const& operator[](std::size_t iIndex) const { return data_[iIndex]; }
+    T const* begin() const { return data_; }
+    T const* end() const { return data_+size_; }
+  private:
+    T const* data_;
+    std::size_t size_;
+  };
+
+  namespace productview {
+    //The kNativeUnrolled serialization of a std::vector of a fundamental type is
+    // a fixed number of header bytes, the number of elements and then the elements.
+    // Returns the number of header bytes, found by serializing a known vector, or
+    // nothing if the serialization does not have that layout.
+    std::optional<std::size_t> nativeVectorHeaderBytes(std::type_info const& iElementType);
+
+    //true if iClass is a std::vector whose kNativeUnrolled serialization can be read in place
+    bool canView(TClass& iClass);
+
+    bool isVectorOf(DataProductRetriever const&, std::type_info const& iVectorType);
+
+    //the number of elements and where they start, nothing if the serialized bytes are not for T
+    template<typename T>
+    std::optional<std::pair<std::size_t, char const*>> nativeVectorElements(DataProductRetriever const& iProduct) {
+      static_assert(std::is_arithmetic_v<T>);
+      static std::optional<std::size_t> const s_headerBytes = nativeVectorHeaderBytes(typeid(T));
+      if(not s_headerBytes or iProduct.serialization() != pds::Serialization::kNativeUnrolled or
+         not isVectorOf(iProduct, typeid(std::vector<T>))) {
+        return {};
+      }
+      auto blob = iProduct.serialized();
+      if(blob.size() < *s_headerBytes + sizeof(int32_t)) {
+        return {};
+      }
+      int32_t size;
+      std::memcpy(&size, blob.data()+*s_headerBytes, sizeof(size));
+      char const* elements = blob.data()+*s_headerBytes+sizeof(size);
+      if(size < 0 or elements+size*sizeof(T) > blob.end()) {
+        return {};
+      }
+      return std::make_pair(std::size_t(size), elements);
+    }
+  }
+
+  //The elements of a std::vector<T> data product which the Source gave as its
+  // serialized bytes, see SharedPDSSource's views parameter. Returns nothing if the
+  // object at iProduct.address() holds the data product or the elements are not
+  // aligned for T in the buffer, in which case materialize<T> gives the object.
+  template<typename T>
+  std::optional<ProductView<T>> viewOf(DataProductRetriever const& iProduct) {
+    auto elements = productview::nativeVectorElements<T>(iProduct);
+    if(not elements or reinterpret_cast<std::uintptr_t>(elements->second) % alignof(T) != 0) {
+      return {};
+    }
+    return ProductView<T>(reinterpret_cast<T const*>(elements->second), elements->first);
+  }
+
+  //The std::vector<T> at iProduct.address(). When the Source only gave the serialized
+  // bytes the object is first filled from them, so call it once per event.
+  template<typename T>
+  std::vector<T> const& materialize(DataProductRetriever const& iProduct) {
+    auto& object = *static_cast<std::vector<T>*>(*iProduct.address());
+    if(auto elements = productview::nativeVectorElements<T>(iProduct)) {
+      object.resize(elements->first);
+      std::memcpy(object.data(), elements->second, elements->first*sizeof(T));
+    }
+    return object;
+  }
+}
+#endif
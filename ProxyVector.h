@@ -36,6 +36,11 @@ class ProxyVectorImpBase {
  virtual P const& operator[](std::size_t index) const = 0;
  virtual P& operator[](std::size_t index) = 0;
 
+ //address of the first element, or nullptr if empty, and the distance in bytes between elements
+ virtual P const* first() const = 0;
+ virtual P* first() = 0;
+ virtual std::size_t stride() const = 0;
+
  struct ConstIter {
    ProxyVectorImpBase<P, ARGS...> const* container_ = nullptr;
    std::size_t index_ = 0;
@@ -84,6 +89,10 @@ template<typename T, typename PROXY, typename... ARGS>
  T& operator[](std::size_t index) {
    return storage_[index];
  }
+
+ PROXY const* first() const { return storage_.empty() ? nullptr : &storage_.front(); }
+ PROXY* first() { return storage_.empty() ? nullptr : &storage_.front(); }
+ std::size_t stride() const { return sizeof(T); }
  private:
  std::vector<T> storage_;
 };
@@ -111,12 +120,38 @@ class ProxyVector {
    return imp_->operator[](index);
  }
 
+ /*
+   A View finds the elements with one virtual call for the whole container
+   rather than one per element. It is invalidated by changing the container's size.
+  */
+ template<typename Q, typename BYTE>
+ class ViewT {
+ public:
+   ViewT(Q* iFirst, std::size_t iStride, std::size_t iSize):
+     first_{reinterpret_cast<BYTE*>(iFirst)}, stride_{iStride}, size_{iSize} {}
+
+   Q& operator[](std::size_t index) const {
+     return *reinterpret_cast<Q*>(first_+index*stride_);
+   }
+   std::size_t size() const { return size_;}
+ private:
+   BYTE* first_;
+   std::size_t stride_;
+   std::size_t size_;
+ };
+ using View = ViewT<P, char>;
+ using ConstView = ViewT<P const, char const>;
+
+ View view() { return View(imp_->first(), imp_->stride(), imp_->size()); }
+ ConstView view() const { return ConstView(imp_->first(), imp_->stride(), imp_->size()); }
+
+ //iterating uses a view so a range based for loop does only one virtual call for the whole loop
  struct ConstIter {
-   ProxyVector<P, ARGS...> const* container_ = nullptr;
+   ConstView view_;
    std::size_t index_ = 0;
 
    P const& operator*() const {
-     return container_->operator[](index_);
+     return view_[index_];
    }
 
    ConstIter& operator++() { ++index_; return *this;}
@@ -131,8 +166,23 @@ class ProxyVector {
 
  };
 
- ConstIter begin() const { return {this, 0}; }
- ConstIter end() const {return {this, size()}; }
+ ConstIter begin() const { return {view(), 0}; }
+ ConstIter end() const {return {view(), size()}; }
+
+ template<typename F>
+ void for_each(F&& iFunc) {
+   auto v = view();
+   for(std::size_t i=0; i< v.size(); ++i) {
+     iFunc(v[i]);
+   }
+ }
+ template<typename F>
+ void for_each(F&& iFunc) const {
+   auto v = view();
+   for(std::size_t i=0; i< v.size(); ++i) {
+     iFunc(v[i]);
+   }
+ }
 
  template<typename T>
  static ProxyVector<P, ARGS...> make() {
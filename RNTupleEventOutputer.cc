@@ -0,0 +1,208 @@
+#include "RNTupleEventOutputer.h"
+#include "OutputerFactory.h"
+#include "ConfigurationParameters.h"
+#include "UnrolledSerializerWrapper.h"
+#include "FixedLayoutSerializerWrapper.h"
+#include "SerializerWrapper.h"
+#include "summarize_serializers.h"
+#include "summarize_queue.h"
+#include "TTree.h"
+#include <ROOT/RNTupleModel.hxx>
+#include <iostream>
+#include <algorithm>
+
+using namespace cce::tf;
+using namespace cce::tf::pds;
+
+RNTupleEventOutputer::RNTupleEventOutputer(std::string const& iFileName, unsigned int iNLanes, Compression iCompression, int iCompressionLevel,
+                                           Serialization iSerialization, std::size_t iApproxUnzippedPageSize, std::size_t iApproxZippedClusterSize):
+  file_(iFileName.c_str(), "recreate", "", 0),
+  serializers_{std::size_t(iNLanes)},
+  compressionContexts_{std::size_t(iNLanes)},
+  compression_{iCompression},
+  compressionLevel_{iCompressionLevel},
+  serialization_{iSerialization},
+  approxUnzippedPageSize_{iApproxUnzippedPageSize},
+  approxZippedClusterSize_{iApproxZippedClusterSize},
+  serialTime_{std::chrono::microseconds::zero()},
+  parallelTime_{iNLanes}
+{
+  auto model = ROOT::Experimental::RNTupleModel::Create();
+  offsets_ = model->MakeField<std::vector<uint32_t>>("offsets");
+  blob_ = model->MakeField<std::vector<char>>("blob");
+  eventID_ = model->MakeField<EventIdentifier>("EventID");
+
+  auto writeOptions = ROOT::Experimental::RNTupleWriteOptions();
+  //the blob is already compressed
+  writeOptions.SetCompression(0);
+  writeOptions.SetApproxUnzippedPageSize(approxUnzippedPageSize_);
+  writeOptions.SetApproxZippedClusterSize(approxZippedClusterSize_);
+  writer_ = ROOT::Experimental::RNTupleWriter::Append(std::move(model), "Events", file_, writeOptions);
+}
+
+RNTupleEventOutputer::~RNTupleEventOutputer() {
+  finish();
+}
+
+void RNTupleEventOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) {
+  auto& s = serializers_[iLaneIndex];
+  switch(serialization_) {
+  case Serialization::kRoot:
+    {   s = SerializeStrategy::make<SerializeProxy<SerializerWrapper>>(); break; }
+  case Serialization::kRootUnrolled:
+    {   s = SerializeStrategy::make<SerializeProxy<UnrolledSerializerWrapper>>(); break; }
+  case Serialization::kNativeUnrolled:
+    {   s = SerializeStrategy::make<SerializeProxy<NativeUnrolledSerializerWrapper>>(); break; }
+  case Serialization::kFixedLayout:
+    {   s = SerializeStrategy::make<SerializeProxy<FixedLayoutSerializerWrapper>>(); break; }
+  }
+  s.reserve(iDPs.size());
+  for(auto const& dp: iDPs) {
+    s.emplace_back(dp.name(), dp.classType());
+  }
+
+  if(iLaneIndex == 0) {
+    writeMetaData(s);
+  }
+}
+
+void RNTupleEventOutputer::productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const {
+  auto& laneSerializers = serializers_[iLaneIndex];
+  serializeOrPassThroughAsync(laneSerializers[iDataProduct.index()], iDataProduct, serialization_, std::move(iCallback), 0);
+}
+
+void RNTupleEventOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+  auto start = std::chrono::high_resolution_clock::now();
+  auto [offsets, buffer] = writeDataProductsToOutputBuffer(serializers_[iLaneIndex]);
+  auto cBuffer = pds::compressBuffer(0, 0, compression_, compressionLevel_, buffer, compressionContexts_[iLaneIndex]);
+  auto group = iCallback.group();
+  queue_.push(*group, [this, iEventID, callback=std::move(iCallback), buffer = std::move(cBuffer), offsets = std::move(offsets)]() mutable {
+      auto start = std::chrono::high_resolution_clock::now();
+      const_cast<RNTupleEventOutputer*>(this)->output(iEventID, std::move(buffer), std::move(offsets));
+      serialTime_ += std::chrono::duration_cast<decltype(serialTime_)>(std::chrono::high_resolution_clock::now() - start);
+      callback.doneWaiting();
+    });
+  auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+  parallelTime_.add(iLaneIndex, time.count());
+}
+
+void RNTupleEventOutputer::finishAsync(TaskHolder iCallback) const {
+  auto group = iCallback.group();
+  queue_.push(*group, [this, iCallback=std::move(iCallback)]() { finish(); });
+}
+
+void RNTupleEventOutputer::finish() const {
+  if(finished_) {
+    return;
+  }
+  finished_ = true;
+  auto start = std::chrono::high_resolution_clock::now();
+  //commits the last cluster and writes the RNTuple's footer
+  writer_.reset();
+  file_.Write();
+  file_.Close();
+  closeTime_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+}
+
+void RNTupleEventOutputer::printSummary() const  {
+  finish();
+  std::cout <<"RNTupleEventOutputer\n  total serial time at end event: "<<serialTime_.count()<<"us\n"
+    "  total parallel time at end event: "<<parallelTime_.sum()<<"us\n";
+  if(auto bytes = passedThroughBytes(serializers_); bytes != 0) {
+    std::cout <<"  serialized bytes passed through from the Source: "<<bytes<<"\n";
+  }
+  std::cout << "  end of job RNTupleWriter shutdown and file close time: "<<closeTime_.count()<<"us\n";
+
+  summarize_queue("write", queue_);
+  summarize_serializers(serializers_);
+}
+
+void RNTupleEventOutputer::fillProfile(ProductProfile& oProfile) const {
+  profile_serializers(oProfile, serializers_);
+}
+
+void RNTupleEventOutputer::output(EventIdentifier const& iEventID, std::vector<char> iBuffer, std::vector<uint32_t> iOffsets) {
+  *eventID_ = iEventID;
+  *offsets_ = std::move(iOffsets);
+  *blob_ = std::move(iBuffer);
+  writer_->Fill();
+}
+
+void RNTupleEventOutputer::writeMetaData(SerializeStrategy const& iSerializers) {
+  std::vector<std::pair<std::string, std::string>> typeAndNames;
+  for(auto const& s: iSerializers) {
+    typeAndNames.emplace_back(std::string(s.className()), std::string(s.name()));
+  }
+
+  int objectSerializationUsed = static_cast<std::underlying_type_t<Serialization>>(serialization_);
+  std::string compression = pds::name(compression_);
+
+  //same as RootEventOutputer so the files describe their data products the same way
+  TTree* meta = new TTree("Meta", "File meta data", 0, &file_);
+  meta->Branch("DataProducts",&typeAndNames, 0, 0);
+  meta->Branch("objectSerializationUsed",&objectSerializationUsed);
+  meta->Branch("compressionAlgorithm",&compression,0,0);
+
+  meta->Fill();
+}
+
+std::pair<std::vector<uint32_t>, std::vector<char>> RNTupleEventOutputer::writeDataProductsToOutputBuffer(SerializeStrategy const& iSerializers) const{
+  uint32_t bufferSize = 0;
+  std::vector<uint32_t> offsets;
+  offsets.reserve(iSerializers.size()+1);
+  for(auto const& s: iSerializers) {
+    offsets.push_back(bufferSize);
+    bufferSize += s.blob().size();
+  }
+  offsets.push_back(bufferSize);
+
+  std::vector<char> buffer(bufferSize, 0);
+  uint32_t index = 0;
+  for(auto const& s: iSerializers) {
+    std::copy(s.blob().begin(), s.blob().end(), buffer.begin()+offsets[index++]);
+  }
+  return {std::move(offsets), std::move(buffer)};
+}
+
+namespace {
+
+  class Maker : public OutputerMakerBase {
+  public:
+    Maker(): OutputerMakerBase("RNTupleEventOutputer") {}
+
+    std::unique_ptr<OutputerBase> create(unsigned int iNLanes, ConfigurationParameters const& params) const final {
+
+      auto fileName = params.get<std::string>("fileName");
+      if(not fileName) {
+        std::cout <<"no file name given for RNTupleEventOutputer\n";
+        return {};
+      }
+
+      int compressionLevel = params.get<int>("compressionLevel", 18);
+
+      auto compressionName = params.get<std::string>("compressionAlgorithm", "ZSTD");
+      auto serializationName = params.get<std::string>("serializationAlgorithm", "ROOT");
+
+      auto compression = pds::toCompression(compressionName);
+      if(not compression) {
+        std::cout <<"unknown compression "<<compressionName<<std::endl;
+        return {};
+      }
+
+      auto serialization = pds::toSerialization(serializationName);
+      if(not serialization) {
+        std::cout <<"unknown serialization "<<serializationName<<std::endl;
+        return {};
+      }
+
+      auto approxUnzippedPageSize = params.get<std::size_t>("approxUnzippedPageSize", 64 * 1024);
+      auto approxZippedClusterSize = params.get<std::size_t>("approxZippedClusterSize", 50 * 1000 * 1000);
+
+      return std::make_unique<RNTupleEventOutputer>(*fileName, iNLanes, *compression, compressionLevel, *serialization,
+                                                    approxUnzippedPageSize, approxZippedClusterSize);
+    }
+
+  };
+
+  Maker s_maker;
+}
@@ -0,0 +1,80 @@
+#if !defined(RNTupleEventOutputer_h)
+#define RNTupleEventOutputer_h
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <chrono>
+#include <memory>
+#include "TFile.h"
+
+#include "OutputerBase.h"
+#include "EventIdentifier.h"
+#include "SerializeStrategy.h"
+#include "DataProductRetriever.h"
+#include "pds_writer.h"
+
+#include "SerialTaskQueue.h"
+#include "PerLaneCounter.h"
+#include <ROOT/RNTuple.hxx>
+
+namespace cce::tf {
+/**
+   The RNTuple version of RootEventOutputer. Each _event_ is one entry of the
+   `Events` RNTuple holding the compressed blob of all its serialized data
+   products, the offsets of each data product in the uncompressed blob and
+   the EventIdentifier. The pages are not compressed by ROOT so the payload
+   is exactly that of RootEventOutputer, which isolates the cost of the
+   container. The `Meta` TTree is the same as that of RootEventOutputer.
+ */
+class RNTupleEventOutputer :public OutputerBase {
+ public:
+  RNTupleEventOutputer(std::string const& iFileName, unsigned int iNLanes, pds::Compression iCompression, int iCompressionLevel,
+                       pds::Serialization iSerialization, std::size_t iApproxUnzippedPageSize, std::size_t iApproxZippedClusterSize);
+ ~RNTupleEventOutputer();
+
+  void setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) final;
+
+  void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const final;
+  bool usesProductReadyAsync() const final {return true;}
+
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+
+  void finishAsync(TaskHolder iCallback) const final;
+  void printSummary() const final;
+  void fillProfile(ProductProfile&) const final;
+
+ private:
+  void output(EventIdentifier const& iEventID, std::vector<char> iBuffer, std::vector<uint32_t> iOffsets);
+  void writeMetaData(SerializeStrategy const& iSerializers);
+  //writes the Meta TTree, commits the RNTuple and closes the file. Only the first call does anything
+  void finish() const;
+
+  //the returned buffer is not yet compressed
+  std::pair<std::vector<uint32_t>,std::vector<char>> writeDataProductsToOutputBuffer(SerializeStrategy const& iSerializers) const;
+
+ private:
+  mutable TFile file_;
+  //appended to file_ so must be deleted before file_ is closed
+  mutable std::unique_ptr<ROOT::Experimental::RNTupleWriter> writer_;
+  //the values of the writer's default entry
+  std::shared_ptr<std::vector<uint32_t>> offsets_;
+  std::shared_ptr<std::vector<char>> blob_;
+  std::shared_ptr<EventIdentifier> eventID_;
+
+  mutable SerialTaskQueue queue_;
+  mutable std::vector<SerializeStrategy> serializers_;
+  //one per lane so the compression state does not need to be remade for each event
+  mutable std::vector<pds::CompressionContext> compressionContexts_;
+  pds::Compression compression_;
+  int compressionLevel_;
+  pds::Serialization serialization_;
+  std::size_t approxUnzippedPageSize_;
+  std::size_t approxZippedClusterSize_;
+  mutable std::chrono::microseconds serialTime_;
+  mutable PerLaneCounter<std::chrono::microseconds::rep> parallelTime_;
+  mutable bool finished_ = false;
+  mutable std::chrono::microseconds closeTime_{0};
+};
+}
+#endif
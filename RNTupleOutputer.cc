@@ -1,8 +1,10 @@
 #include <iostream>
+#include <sstream>
 #include "RNTupleOutputer.h"
 #include "OutputerFactory.h"
 #include "FunctorTask.h"
 #include "RNTupleOutputerConfig.h"
+#include "summarize_queue.h"
 
 #include <ROOT/RNTupleModel.hxx>
 #include <ROOT/RField.hxx>
@@ -15,7 +17,7 @@ RNTupleOutputer::RNTupleOutputer(std::string const& fileName, unsigned int iNLan
     entries_(iNLanes),
     config_(iConfig),
     collateTime_{std::chrono::microseconds::zero()},
-    parallelTime_{0}
+    parallelTime_{iNLanes}
   { }
 
 void RNTupleOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) {
@@ -23,7 +25,8 @@ void RNTupleOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataProd
     const std::string eventAuxiliaryBranchName{"EventAuxiliary"}; 
     bool hasEventAuxiliaryBranch = false;
     
-    auto model = ROOT::Experimental::RNTupleModel::Create();
+    //the parallel writer's fill contexts make their own entries
+    auto model = config_.parallelWriter_ ? ROOT::Experimental::RNTupleModel::CreateBare() : ROOT::Experimental::RNTupleModel::Create();
     fieldIDs_.reserve(iDPs.size());
     for(auto const& dp: iDPs) {
       // chop last . if present
@@ -46,7 +49,7 @@ void RNTupleOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataProd
       }
     }
     if(not hasEventAuxiliaryBranch) {
-      id_ = std::make_shared<EventIdentifier>();
+      hasEventIDField_ = true;
       auto field = ROOT::Experimental::RFieldBase::Create("EventID", "cce::tf::EventIdentifier").Unwrap();
       if ( config_.verbose_ > 1 ) ROOT::Experimental::RPrintSchemaVisitor(std::cout, '*', 1000, 10).VisitField(*field);
       assert(field);
@@ -62,11 +65,44 @@ void RNTupleOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataProd
     writeOptions.SetHasSmallClusters(config_.hasSmallClusters_);
     writeOptions.SetUseBufferedWrite(config_.useBufferedWrite_);
     
-    ntuple_ = ROOT::Experimental::RNTupleWriter::Recreate(std::move(model), "Events", fileName_, writeOptions);
+#if defined(RNTUPLE_PARALLEL_WRITER)
+    if(config_.parallelWriter_) {
+      parallelWriter_ = ROOT::Experimental::RNTupleParallelWriter::Recreate(std::move(model), "Events", fileName_, writeOptions);
+      if(config_.printMetrics_) {
+        parallelWriter_->EnableMetrics();
+      }
+    }
+#endif
+    if(not config_.parallelWriter_) {
+      ntuple_ = ROOT::Experimental::RNTupleWriter::Recreate(std::move(model), "Events", fileName_, writeOptions);
+      if(config_.printMetrics_) {
+        ntuple_->EnableMetrics();
+      }
+    }
   }
-  else if ( not ntuple_ ) {
+  else if ( not ntuple_ 
+#if defined(RNTUPLE_PARALLEL_WRITER)
+            and not parallelWriter_
+#endif
+            ) {
     throw std::logic_error("setupForLane should be sequential");
   }
+  auto& lane = entries_[iLaneIndex];
+#if defined(RNTUPLE_PARALLEL_WRITER)
+  if(parallelWriter_) {
+    lane.fillContext = parallelWriter_->CreateFillContext();
+    lane.entry = lane.fillContext->CreateEntry();
+  }
+#endif
+  if(ntuple_) {
+    lane.entry = ntuple_->CreateEntry();
+  }
+#if defined(RNTUPLE_FIELD_TOKENS)
+  lane.tokens.reserve(fieldIDs_.size());
+  for(auto const& id: fieldIDs_) {
+    lane.tokens.push_back(lane.entry->GetToken(id));
+  }
+#endif
   // would be nice to have ntuple_->CreateEntry(field_map) or such
   for(auto const& dp: iDPs) {
     entries_[iLaneIndex].ptrs.push_back(dp.address());
@@ -77,32 +113,80 @@ void RNTupleOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataProd
 void RNTupleOutputer::productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const {
 }
 
-void RNTupleOutputer::outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+void RNTupleOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
   auto start = std::chrono::high_resolution_clock::now();
+  if(config_.parallelWriter_) {
+    //only the cluster commits of the fill contexts are serialized, inside ROOT
+    fillLane(iEventID, entries_[iLaneIndex]);
+    return;
+  }
   auto group = iCallback.group();
   collateQueue_.push(*group, [this, iEventID, iLaneIndex, callback=std::move(iCallback)]() mutable {
       collateProducts(iEventID, entries_[iLaneIndex], std::move(callback));
     });
   auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
-  parallelTime_ += time.count();
+  parallelTime_.add(iLaneIndex, time.count());
 }
 
-void RNTupleOutputer::printSummary() const {
+void RNTupleOutputer::finishAsync(TaskHolder iCallback) const {
+  auto group = iCallback.group();
+  //the events still in the queue are collated first
+  collateQueue_.push(*group, [this, iCallback=std::move(iCallback)]() { finish(); });
+}
+
+void RNTupleOutputer::finish() const {
+  if(finished_) {
+    return;
+  }
+  finished_ = true;
   auto start = std::chrono::high_resolution_clock::now();
+  std::ostringstream metrics;
+  if(ntuple_ and config_.printMetrics_) {
+    //the last cluster would otherwise only be committed when the writer is deleted
+    ntuple_->CommitCluster();
+    ntuple_->GetMetrics().Print(metrics, "  ");
+  }
   ntuple_.reset();
-  auto deleteTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+#if defined(RNTUPLE_PARALLEL_WRITER)
+  //the contexts commit their last clusters before the writer writes the footer
+  for(auto& e: entries_) {
+    e.entry.reset();
+    e.fillContext.reset();
+  }
+  if(parallelWriter_ and config_.printMetrics_) {
+    parallelWriter_->GetMetrics().Print(metrics, "  ");
+  }
+  parallelWriter_.reset();
+#endif
+  deleteTime_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+  metrics_ = metrics.str();
+}
 
-  start = std::chrono::high_resolution_clock::now();
+void RNTupleOutputer::printSummary() const {
+  finish();
 
   std::cout <<"RNTupleOutputer\n"
     "  total serial collate time at end event: "<<collateTime_.count()<<"us\n"
-    "  total non-serializer parallel time at end event: "<<parallelTime_.load()<<"us\n"
-    "  end of job RNTupleWriter shutdown time: "<<deleteTime.count()<<"us\n";
+    "  total non-serializer parallel time at end event: "<<parallelTime_.sum()<<"us\n"
+    "  end of job RNTupleWriter shutdown time: "<<deleteTime_.count()<<"us\n";
+  if(config_.parallelWriter_) {
+    std::cout <<"  per lane fill time:";
+    for(auto const& e: entries_) {
+      std::cout <<" "<<e.fillTime.count()<<"us";
+    }
+    std::cout <<"\n";
+  }
+  summarize_queue("collate", collateQueue_);
+  if(config_.printMetrics_) {
+    std::cout <<"  RNTuple write metrics:\n"<<metrics_;
+    //gives the compressed and uncompressed sizes of each field's columns
+    ROOT::Experimental::RNTupleReader::Open("Events", fileName_)->PrintInfo(ROOT::Experimental::ENTupleInfo::kStorageDetails, std::cout);
+  }
 }
 
 void RNTupleOutputer::collateProducts(
     EventIdentifier const& iEventID,
-    RNTupleOutputer::EntryContainer const& entry,
+    RNTupleOutputer::EntryContainer& entry,
     TaskHolder iCallback
     ) const
 {
@@ -110,18 +194,41 @@ void RNTupleOutputer::collateProducts(
   auto thisOffset = eventGlobalOffset_++;
   if ( config_.verbose_ > 0 ) std::cout << thisOffset << " event id " << iEventID.run << ", "<< iEventID.lumi<<", "<<iEventID.event<<"\n";
 
-  auto rentry = ntuple_->CreateEntry();
+  bindEntry(iEventID, entry);
+  ntuple_->Fill(*entry.entry);
+
+  collateTime_ += std::chrono::duration_cast<decltype(collateTime_)>(std::chrono::high_resolution_clock::now() - start);
+}
+
+void RNTupleOutputer::bindEntry(EventIdentifier const& iEventID, RNTupleOutputer::EntryContainer& entry) const {
+  //the data products may have been moved to a new address since the last event
   for(size_t i=0; i < entry.ptrs.size(); ++i) {
-    void** ptr = entry.ptrs[i];
-    rentry->BindRawPtr(fieldIDs_[i], *ptr);
+#if defined(RNTUPLE_FIELD_TOKENS)
+    entry.entry->BindRawPtr(entry.tokens[i], *entry.ptrs[i]);
+#else
+    entry.entry->BindRawPtr(fieldIDs_[i], *entry.ptrs[i]);
+#endif
   }
-  if(id_) {
-    *id_ = iEventID;
-    rentry->BindRawPtr("EventID", id_.get());
+  if(hasEventIDField_) {
+    entry.id = iEventID;
+#if defined(RNTUPLE_FIELD_TOKENS)
+    entry.entry->BindRawPtr(entry.tokens.back(), &entry.id);
+#else
+    entry.entry->BindRawPtr("EventID", &entry.id);
+#endif
   }
-  ntuple_->Fill(*rentry);
+}
 
-  collateTime_ += std::chrono::duration_cast<decltype(collateTime_)>(std::chrono::high_resolution_clock::now() - start);
+void RNTupleOutputer::fillLane(EventIdentifier const& iEventID, RNTupleOutputer::EntryContainer& entry) const {
+#if defined(RNTUPLE_PARALLEL_WRITER)
+  auto start = std::chrono::high_resolution_clock::now();
+  if ( config_.verbose_ > 0 ) std::cout << "event id " << iEventID.run << ", "<< iEventID.lumi<<", "<<iEventID.event<<"\n";
+
+  bindEntry(iEventID, entry);
+  entry.fillContext->Fill(*entry.entry);
+
+  entry.fillTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+#endif
 }
 
 
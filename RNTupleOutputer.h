@@ -14,8 +14,16 @@
 #include "DataProductRetriever.h"
 #include "summarize_serializers.h"
 #include "SerialTaskQueue.h"
+#include "PerLaneCounter.h"
 #include "RNTupleOutputerConfig.h"
 #include <ROOT/RNTuple.hxx>
+#include <RVersion.h>
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,32,0)
+#include <ROOT/RNTupleParallelWriter.hxx>
+#include <ROOT/RNTupleFillContext.hxx>
+#define RNTUPLE_PARALLEL_WRITER
+#define RNTUPLE_FIELD_TOKENS
+#endif
 
 namespace cce::tf {
 
@@ -27,20 +35,38 @@ class RNTupleOutputer : public OutputerBase {
   void setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) final;
   bool usesProductReadyAsync() const final {return true;}
   void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const final;
-  void outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+  void finishAsync(TaskHolder iCallback) const final;
   void printSummary() const final;
 
 private:
   struct EntryContainer {
     // std::unique_ptr<ROOT::Experimental::REntry> entry;
     std::vector<void**> ptrs;
+    //made once per lane, only the raw pointers are rebound for each event
+    std::unique_ptr<ROOT::Experimental::REntry> entry;
+#if defined(RNTUPLE_FIELD_TOKENS)
+    //same order as fieldIDs_
+    std::vector<ROOT::Experimental::REntry::RFieldToken> tokens;
+#endif
+    EventIdentifier id;
+#if defined(RNTUPLE_PARALLEL_WRITER)
+    //only used with the parallel writer
+    std::shared_ptr<ROOT::Experimental::RNTupleFillContext> fillContext;
+#endif
+    std::chrono::microseconds fillTime{std::chrono::microseconds::zero()};
   };
 
   // Plan:
   // productReadyAsync() is threadsafe because entries_ is one per lane (also doesn't do anything right now)
   // outputAsync puts collateProducts() in collateQueue_
   // collateProducts() appends a new event to the RNTuple
-  void collateProducts(EventIdentifier const& iEventID, EntryContainer const& entry, TaskHolder iCallback) const;
+  void collateProducts(EventIdentifier const& iEventID, EntryContainer& entry, TaskHolder iCallback) const;
+  void bindEntry(EventIdentifier const& iEventID, EntryContainer& entry) const;
+  //used with the parallel writer, fills the lane's own context without a queue
+  void fillLane(EventIdentifier const& iEventID, EntryContainer& entry) const;
+  //commits the last clusters and deletes the writer, only the first call does anything
+  void finish() const;
 
   // configuration options
   const std::string fileName_;
@@ -48,21 +74,29 @@ private:
 
   // initialized in lane 0 setupForLane(), modified only in collateProducts()
   mutable std::unique_ptr<ROOT::Experimental::RNTupleWriter> ntuple_;
+#if defined(RNTUPLE_PARALLEL_WRITER)
+  mutable std::unique_ptr<ROOT::Experimental::RNTupleParallelWriter> parallelWriter_;
+#endif
 
   //identifiers used to specify which field to use
   std::vector<std::string> fieldIDs_;
   
-  std::vector<EntryContainer> entries_;
+  mutable std::vector<EntryContainer> entries_;
 
   mutable SerialTaskQueue collateQueue_;
   
   // only modified in collateProducts()
   mutable size_t eventGlobalOffset_{0};
   mutable std::chrono::microseconds collateTime_;
-  mutable std::shared_ptr<EventIdentifier> id_;
+  //set when the products have no EventAuxiliary so the EventID field is written
+  bool hasEventIDField_ = false;
 
-  mutable std::atomic<std::chrono::microseconds::rep> parallelTime_;
+  mutable PerLaneCounter<std::chrono::microseconds::rep> parallelTime_;
 
+  mutable bool finished_ = false;
+  mutable std::chrono::microseconds deleteTime_{0};
+  //the metrics are owned by the writer so are printed to here before it is deleted
+  mutable std::string metrics_;
 
 };
 }
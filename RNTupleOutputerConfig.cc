@@ -2,6 +2,7 @@
 
 #include "ConfigurationParameters.h"
 #include <iostream>
+#include <RVersion.h>
 
 namespace cce::tf {
   std::optional<std::pair<std::string, RNTupleOutputerConfig>> parseRNTupleConfig(ConfigurationParameters const& params) {
@@ -33,6 +34,18 @@ namespace cce::tf {
     config.maxUnzippedClusterSize_ = params.get<std::size_t>("maxUnzippedClusterSize", config.maxUnzippedClusterSize_);
     config.hasSmallClusters_ =  params.get<bool>("hasSmallClusters", config.hasSmallClusters_);
     config.useBufferedWrite_ = params.get<bool>("useBufferedWrite", config.useBufferedWrite_);
+    config.parallelWriter_ = params.get<bool>("parallelWriter", config.parallelWriter_);
+    config.printMetrics_ = params.get<bool>("printMetrics", config.printMetrics_);
+#if ROOT_VERSION_CODE < ROOT_VERSION(6,32,0)
+    if(config.parallelWriter_) {
+      std::cout <<"parallelWriter requires ROOT 6.32 or later"<<std::endl;
+      return std::nullopt;
+    }
+#endif
+    if(config.parallelWriter_ and not config.useBufferedWrite_) {
+      std::cout <<"parallelWriter requires useBufferedWrite"<<std::endl;
+      return std::nullopt;
+    }
     return std::make_pair(*fileName,config);
   }
 }
@@ -16,6 +16,10 @@ namespace cce::tf {
     std::size_t maxUnzippedClusterSize_ = 512 * 1024 * 1024;
     bool hasSmallClusters_=false;
     bool useBufferedWrite_=true;
+    //each lane fills its own RNTupleFillContext of a RNTupleParallelWriter
+    bool parallelWriter_=false;
+    //print RNTuple's write metrics and the storage details of the file at the end of the job
+    bool printMetrics_=false;
   };
 
 
@@ -0,0 +1,125 @@
+#if !defined(ReadAheadBuffer_h)
+#define ReadAheadBuffer_h
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "CPUAffinity.h"
+
+namespace cce::tf {
+  /**
+     Uses a dedicated thread to read entries ahead of when they are requested.
+     The thread stops reading once either iMaxEntries entries or iMaxBytes bytes
+     (if non 0) are being held and resumes once entries have been taken.
+
+     next() is expected to be called serially, e.g. from a SerialTaskQueue.
+   */
+  template<typename T>
+  class ReadAheadBuffer {
+  public:
+    // iRead fills the passed object and returns false once there is nothing more to read.
+    // iSize returns the number of bytes held by an entry.
+    ReadAheadBuffer(std::size_t iMaxEntries, std::size_t iMaxBytes,
+                    std::function<bool(T&)> iRead, std::function<std::size_t(T const&)> iSize):
+      read_{std::move(iRead)}, size_{std::move(iSize)},
+      maxEntries_{iMaxEntries == 0 ? 1 : iMaxEntries}, maxBytes_{iMaxBytes},
+      thread_{[this]() { pinDedicatedThread(); run(); }} {}
+
+    ~ReadAheadBuffer() {
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        stop_ = true;
+      }
+      cv_.notify_all();
+      thread_.join();
+    }
+
+    ReadAheadBuffer(ReadAheadBuffer const&) = delete;
+    ReadAheadBuffer& operator=(ReadAheadBuffer const&) = delete;
+
+    //returns false if there are no more entries
+    bool next(T& oEntry) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if(entries_.empty() and not done_) {
+        ++nMisses_;
+        auto start = std::chrono::high_resolution_clock::now();
+        cv_.wait(lock, [this]() { return not entries_.empty() or done_;});
+        waitTime_ += std::chrono::duration_cast<decltype(waitTime_)>(std::chrono::high_resolution_clock::now() - start);
+      } else {
+        ++nHits_;
+      }
+      if(entries_.empty()) {
+        return false;
+      }
+      oEntry = std::move(entries_.front());
+      entries_.pop_front();
+      bytes_ -= size_(oEntry);
+      lock.unlock();
+      cv_.notify_all();
+      return true;
+    }
+
+    ///number of requests where the entry was already read
+    unsigned long long nHits() const { return nHits_; }
+    ///number of requests which had to wait for the read
+    unsigned long long nMisses() const { return nMisses_; }
+    ///time spent waiting in next()
+    std::chrono::microseconds waitTime() const { return waitTime_; }
+
+  private:
+    void run() {
+      while(true) {
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          cv_.wait(lock, [this]() { return stop_ or not full(); });
+          if(stop_) {
+            return;
+          }
+        }
+        T entry;
+        bool more = read_(entry);
+        {
+          std::lock_guard<std::mutex> guard(mutex_);
+          if(more) {
+            bytes_ += size_(entry);
+            entries_.emplace_back(std::move(entry));
+          } else {
+            done_ = true;
+          }
+        }
+        cv_.notify_all();
+        if(not more) {
+          return;
+        }
+      }
+    }
+
+    bool full() const {
+      return entries_.size() >= maxEntries_ or (maxBytes_ != 0 and bytes_ >= maxBytes_);
+    }
+
+    std::function<bool(T&)> read_;
+    std::function<std::size_t(T const&)> size_;
+    std::size_t const maxEntries_;
+    std::size_t const maxBytes_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<T> entries_;
+    std::size_t bytes_ = 0;
+    bool done_ = false;
+    bool stop_ = false;
+
+    unsigned long long nHits_ = 0;
+    unsigned long long nMisses_ = 0;
+    std::chrono::microseconds waitTime_ = std::chrono::microseconds::zero();
+
+    //must be last so all other members are initialized before the thread starts
+    std::thread thread_;
+  };
+}
+#endif
@@ -5,20 +5,29 @@
 #include "TTree.h"
 #include "TFile.h"
 #include "TClass.h"
+#include "RootIMT.h"
+#include "Serializer.h"
+#include "pds_writer.h"
 #include <unordered_set>
 
 using namespace cce::tf;
 
-RepeatingRootSource::RepeatingRootSource(std::string const& iName, unsigned int iNUniqueEvents, unsigned int iNLanes, unsigned long long iNEvents, std::string const& iBranchToRead, bool iDumpBranches) :
+RepeatingRootSource::RepeatingRootSource(std::string const& iName, unsigned int iNUniqueEvents, unsigned int iNLanes, unsigned long long iNEvents, std::string const& iBranchToRead, bool iDumpBranches,
+                                         ReplayMode iMode, pds::Compression iCompression, int iCompressionLevel) :
   SharedSourceBase(iNEvents),
+  mode_(iMode),
+  compression_(iCompression),
   nUniqueEvents_(iNUniqueEvents),
   dataProductsPerLane_(iNLanes),
   identifierPerEvent_(iNUniqueEvents),
   dataBuffersPerEvent_(iNUniqueEvents),
-  accumulatedTime_(0)
+  accumulatedTime_(0),
+  decompressTime_(0),
+  deserializeTime_(0)
 {
   auto file_ = std::unique_ptr<TFile>(TFile::Open(iName.c_str()));
   auto events = file_->Get<TTree>("Events");
+  events->SetImplicitMT(rootIMTForSources());
   auto l = events->GetListOfBranches();
 
   if(nUniqueEvents_ > events->GetEntries()) {
@@ -86,7 +95,29 @@ RepeatingRootSource::RepeatingRootSource(std::string const& iName, unsigned int
     } else {
       identifierPerEvent_[i] = {1,1,static_cast<unsigned long long>(i)};
     }
-  }  
+  }
+
+  if(mode_ == ReplayMode::kSerialized) {
+    serializedPerEvent_.reserve(nUniqueEvents_);
+    for(auto& buffers: dataBuffersPerEvent_) {
+      serializeBuffer(buffers, iCompressionLevel);
+    }
+    replayLanes_.resize(iNLanes);
+    for(unsigned int lane = 0; lane < iNLanes; ++lane) {
+      auto& objects = replayLanes_[lane].objects_;
+      auto& deserializers = replayLanes_[lane].deserializers_;
+      auto& dataProducts = dataProductsPerLane_[lane];
+      objects.reserve(dataProducts.size());
+      deserializers.reserve(dataProducts.size());
+      for(auto& d: dataProducts) {
+        objects.push_back(d.classType()->New());
+        deserializers.emplace_back(d.classType());
+      }
+      for(size_t index = 0; index < dataProducts.size(); ++index) {
+        dataProducts[index].setAddress(&objects[index]);
+      }
+    }
+  }
 }
 
 RepeatingRootSource::~RepeatingRootSource() {
@@ -98,16 +129,71 @@ RepeatingRootSource::~RepeatingRootSource() {
   for(auto& buffers: dataBuffersPerEvent_) {
     auto it = buffers.begin();
     for(auto& d: dataProductsPerLane_[0]) {
+      if(it == buffers.end()) {
+        break;
+      }
       d.classType()->Destructor(it->address_);
       ++it;
     }
   }
+  for(auto& lane: replayLanes_) {
+    auto it = lane.objects_.begin();
+    for(auto& d: dataProductsPerLane_[0]) {
+      d.classType()->Destructor(*it);
+      ++it;
+    }
+  }
+}
+
+void RepeatingRootSource::serializeBuffer(std::vector<BufferInfo>& ioBuffers, int iCompressionLevel) {
+  Serializer serializer;
+  std::vector<SerializedProduct> serialized;
+  serialized.reserve(ioBuffers.size());
+  auto it = ioBuffers.begin();
+  for(auto& d: dataProductsPerLane_[0]) {
+    auto blob = serializer.serialize(it->address_, d.classType());
+    uint32_t size = blob.size();
+    if(compression_ != pds::Compression::kNone) {
+      blob = pds::compressBuffer(0, 0, compression_, iCompressionLevel, blob);
+    }
+    serialized.push_back({std::move(blob), size});
+    //the objects are no longer needed
+    d.classType()->Destructor(it->address_);
+    ++it;
+  }
+  ioBuffers.clear();
+  serializedPerEvent_.push_back(std::move(serialized));
 }
 
 
 void RepeatingRootSource::readEventAsync(unsigned int iLane, long iEventIndex, OptionalTaskHolder iTask) {
   auto start = std::chrono::high_resolution_clock::now();
   auto presentEventIndex = iEventIndex % nUniqueEvents_;
+  if(mode_ == ReplayMode::kSerialized) {
+    auto& lane = replayLanes_[iLane];
+    auto& dataProducts = dataProductsPerLane_[iLane];
+    auto itObject = lane.objects_.begin();
+    auto itDeserializer = lane.deserializers_.begin();
+    auto itDataProduct = dataProducts.begin();
+    for(auto const& product: serializedPerEvent_[presentEventIndex]) {
+      char const* buffer = product.blob_.data();
+      if(compression_ != pds::Compression::kNone) {
+        auto decompressStart = std::chrono::high_resolution_clock::now();
+        pds::uncompressBuffer(compression_, product.blob_, product.uncompressedSize_, lane.uncompressedBuffer_, lane.decompressionContext_);
+        decompressTime_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - decompressStart).count();
+        buffer = lane.uncompressedBuffer_.data();
+      }
+      auto deserializeStart = std::chrono::high_resolution_clock::now();
+      itDataProduct->setSize((itDeserializer++)->deserialize(buffer, product.uncompressedSize_, *itObject));
+      deserializeTime_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - deserializeStart).count();
+      ++itObject;
+      ++itDataProduct;
+    }
+    auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+    accumulatedTime_ += time.count();
+    iTask.runNow();
+    return;
+  }
   auto it = dataBuffersPerEvent_[presentEventIndex].begin();
   auto& dataProducts = dataProductsPerLane_[iLane];
   for(auto& d: dataProducts) {
@@ -135,7 +221,19 @@ void RepeatingRootSource::fillBuffer(int iEntry, std::vector<BufferInfo>& bi, st
 
 void RepeatingRootSource::printSummary() const {
       std::chrono::microseconds sourceTime = accumulatedTime();
-      std::cout <<"\nSource time: "<<sourceTime.count()<<"us\n"<<std::endl;
+      std::cout <<"\nSource time: "<<sourceTime.count()<<"us\n";
+      if(mode_ == ReplayMode::kSerialized) {
+        size_t storedBytes = 0;
+        for(auto const& event: serializedPerEvent_) {
+          for(auto const& product: event) {
+            storedBytes += product.blob_.size();
+          }
+        }
+        std::cout <<"   replayed bytes held: "<<storedBytes<<"\n"
+          "   decompress time: "<<decompressTime_.load()<<"us\n"
+          "   deserialize time: "<<deserializeTime_.load()<<"us\n";
+      }
+      std::cout<<std::endl;
 }
 
 namespace {
@@ -151,7 +249,29 @@ namespace {
         unsigned int nUniqueEvents=params.get<unsigned int>("repeat",10);
         std::string branchToRead = params.get<std::string>("branchToRead","");
         bool dumpBranches = params.get<bool>("dumpBranches", false);
-        return std::make_unique<RepeatingRootSource>(*fileName, nUniqueEvents, iNLanes, iNEvents, branchToRead, dumpBranches);
+        auto replayName = params.get<std::string>("replay", "objects");
+        RepeatingRootSource::ReplayMode mode;
+        if(replayName == "objects") {
+          mode = RepeatingRootSource::ReplayMode::kObjects;
+        } else if(replayName == "serialized") {
+          mode = RepeatingRootSource::ReplayMode::kSerialized;
+        } else {
+          std::cout <<"unknown replay mode "<<replayName<<std::endl;
+          return {};
+        }
+        auto compressionName = params.get<std::string>("compressionAlgorithm", "None");
+        auto compression = pds::toCompression(compressionName);
+        if(not compression) {
+          std::cout <<"unknown compression "<<compressionName<<std::endl;
+          return {};
+        }
+        if(*compression != pds::Compression::kNone and mode != RepeatingRootSource::ReplayMode::kSerialized) {
+          std::cout <<"compressionAlgorithm can only be used with replay=serialized"<<std::endl;
+          return {};
+        }
+        int compressionLevel = params.get<int>("compressionLevel", 18);
+        return std::make_unique<RepeatingRootSource>(*fileName, nUniqueEvents, iNLanes, iNEvents, branchToRead, dumpBranches,
+                                                     mode, *compression, compressionLevel);
     }
     };
 
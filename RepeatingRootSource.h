@@ -9,6 +9,8 @@
 #include "DataProductRetriever.h"
 #include "DelayedProductRetriever.h"
 #include "EventAuxReader.h"
+#include "Deserializer.h"
+#include "pds_reading.h"
 
 #include "SharedSourceBase.h"
 #include "TFile.h"
@@ -23,8 +25,16 @@ class RepeatingRootDelayedRetriever : public DelayedProductRetriever {
 
 class RepeatingRootSource : public SharedSourceBase {
 public:
+  enum class ReplayMode {
+    //the deserialized objects are shared, read-only, by all Lanes
+    kObjects,
+    //the serialized, and possibly compressed, data products are shared by all
+    // Lanes and each Lane deserializes them into its own objects
+    kSerialized };
+
   RepeatingRootSource(std::string const& iName, unsigned int iNUniqueEvents, unsigned int iNLanes, unsigned long long iNEvents,
-                      std::string const& iBranchToRead, bool iDumpBranches);
+                      std::string const& iBranchToRead, bool iDumpBranches,
+                      ReplayMode iMode = ReplayMode::kObjects, pds::Compression iCompression = pds::Compression::kNone, int iCompressionLevel = 0);
   RepeatingRootSource(RepeatingRootSource&&) = default;
   RepeatingRootSource(RepeatingRootSource const&) = default;
   ~RepeatingRootSource() final;
@@ -46,12 +56,33 @@ public:
 
 private:
   void fillBuffer(int iEntry, std::vector<BufferInfo>& , std::vector<TBranch*>&);
+  //replaces the objects of the event by their serialized form
+  void serializeBuffer(std::vector<BufferInfo>&, int iCompressionLevel);
+
+  struct SerializedProduct {
+    std::vector<char> blob_;
+    uint32_t uncompressedSize_;
+  };
+  struct ReplayLane {
+    std::vector<void*> objects_;
+    std::vector<Deserializer> deserializers_;
+    pds::ReusableBuffer<char> uncompressedBuffer_;
+    pds::DecompressionContext decompressionContext_;
+  };
+
+  ReplayMode mode_;
+  pds::Compression compression_;
 
   unsigned int nUniqueEvents_;
   RepeatingRootDelayedRetriever delayedReader_;
   std::vector<std::vector<DataProductRetriever>> dataProductsPerLane_;
   std::vector<std::vector<BufferInfo>> dataBuffersPerEvent_;
   std::vector<EventIdentifier> identifierPerEvent_;
+  //used for ReplayMode::kSerialized
+  std::vector<std::vector<SerializedProduct>> serializedPerEvent_;
+  std::vector<ReplayLane> replayLanes_;
+  std::atomic<std::chrono::microseconds::rep> decompressTime_;
+  std::atomic<std::chrono::microseconds::rep> deserializeTime_;
   std::atomic<std::chrono::microseconds::rep> accumulatedTime_;
 };
 }
@@ -0,0 +1,200 @@
+#include "ReplaySource.h"
+#include "SourceFactory.h"
+#include "Serializer.h"
+#include "FunctorTask.h"
+
+#include "TClass.h"
+#include "tbb/task_group.h"
+
+#include <iostream>
+#include <stdexcept>
+
+using namespace cce::tf;
+
+ReplaySource::ReplaySource(unsigned int iNLanes, unsigned long long iNEvents, SharedSourceBase& iRecordFrom, unsigned int iNEventsToRecord,
+                           ReplayMode iMode):
+  SharedSourceBase(iNEvents),
+  mode_(iMode),
+  dataProductsPerLane_(iNLanes)
+{
+  record(iRecordFrom, iNEventsToRecord);
+
+  if(mode_ == ReplayMode::kObjects) {
+    objectsPerEvent_.reserve(recordedEvents_.size());
+    for(auto const& event: recordedEvents_) {
+      objectsPerEvent_.emplace_back();
+      auto& objects = objectsPerEvent_.back();
+      objects.reserve(event.size());
+      auto itProduct = dataProductsPerLane_[0].begin();
+      for(auto const& product: event) {
+        auto cls = itProduct->classType();
+        objects.push_back(cls->New());
+        Deserializer(cls).deserialize(arena_.data()+product.offset_, product.size_, objects.back());
+        ++itProduct;
+      }
+    }
+    //only the objects are replayed
+    arena_ = std::vector<char>();
+  } else {
+    replayLanes_.resize(iNLanes);
+    for(unsigned int lane = 0; lane < iNLanes; ++lane) {
+      auto& objects = replayLanes_[lane].objects_;
+      auto& deserializers = replayLanes_[lane].deserializers_;
+      auto& dataProducts = dataProductsPerLane_[lane];
+      objects.reserve(dataProducts.size());
+      deserializers.reserve(dataProducts.size());
+      for(auto& d: dataProducts) {
+        objects.push_back(d.classType()->New());
+        deserializers.emplace_back(d.classType());
+      }
+      for(size_t index = 0; index < dataProducts.size(); ++index) {
+        dataProducts[index].setAddress(&objects[index]);
+      }
+    }
+  }
+}
+
+ReplaySource::~ReplaySource() {
+  auto const& dataProducts = dataProductsPerLane_[0];
+  for(auto& objects: objectsPerEvent_) {
+    for(size_t index = 0; index < objects.size(); ++index) {
+      dataProducts[index].classType()->Destructor(objects[index]);
+    }
+  }
+  for(auto& lane: replayLanes_) {
+    for(size_t index = 0; index < lane.objects_.size(); ++index) {
+      dataProducts[index].classType()->Destructor(lane.objects_[index]);
+    }
+  }
+}
+
+void ReplaySource::record(SharedSourceBase& iRecordFrom, unsigned int iNEventsToRecord) {
+  auto start = std::chrono::high_resolution_clock::now();
+  Serializer serializer;
+  tbb::task_group group;
+  for(unsigned int i = 0; i < iNEventsToRecord and iRecordFrom.mayBeAbleToGoToEvent(i); ++i) {
+    bool wasRead = false;
+    iRecordFrom.gotoEventAsync(0, i, OptionalTaskHolder(group, make_functor_task([&wasRead]() { wasRead = true; })));
+    group.wait();
+    if(not wasRead) {
+      break;
+    }
+    auto& products = iRecordFrom.dataProducts(0, i);
+    {
+      TaskHolder allRetrieved(group, make_functor_task([]() {}));
+      for(auto& p: products) {
+        p.getAsync(allRetrieved);
+      }
+    }
+    group.wait();
+
+    if(recordedEvents_.empty()) {
+      for(auto& dataProducts: dataProductsPerLane_) {
+        dataProducts.reserve(products.size());
+        int index = 0;
+        for(auto const& p: products) {
+          dataProducts.emplace_back(index++, nullptr, p.name(), p.classType(), &delayedReader_);
+        }
+      }
+    }
+    recordedEvents_.emplace_back();
+    auto& event = recordedEvents_.back();
+    event.reserve(products.size());
+    for(auto const& p: products) {
+      BlobView blob;
+      if(auto serialization = p.serialization()) {
+        //the Source passed the bytes through without filling the object
+        if(*serialization != pds::Serialization::kRoot) {
+          throw std::runtime_error("ReplaySource can only record serialized data products which use the ROOT serialization");
+        }
+        blob = p.serialized();
+      } else {
+        blob = serializer.serializeToView(*p.address(), p.classType());
+      }
+      event.push_back({arena_.size(), blob.size()});
+      arena_.insert(arena_.end(), blob.begin(), blob.end());
+    }
+  }
+  if(recordedEvents_.empty()) {
+    throw std::runtime_error("ReplaySource could not record any events");
+  }
+  arena_.shrink_to_fit();
+  recordTime_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+}
+
+void ReplaySource::readEventAsync(unsigned int iLane, long iEventIndex, OptionalTaskHolder iTask) {
+  auto start = std::chrono::high_resolution_clock::now();
+  auto recordedIndex = iEventIndex % recordedEvents_.size();
+  auto& dataProducts = dataProductsPerLane_[iLane];
+  auto itRecorded = recordedEvents_[recordedIndex].begin();
+  if(mode_ == ReplayMode::kSerialized) {
+    auto& lane = replayLanes_[iLane];
+    auto itObject = lane.objects_.begin();
+    auto itDeserializer = lane.deserializers_.begin();
+    for(auto& d: dataProducts) {
+      d.setSize((itDeserializer++)->deserialize(arena_.data()+itRecorded->offset_, itRecorded->size_, *(itObject++)));
+      ++itRecorded;
+    }
+  } else {
+    auto itObject = objectsPerEvent_[recordedIndex].begin();
+    for(auto& d: dataProducts) {
+      d.setAddress(&*(itObject++));
+      d.setSize((itRecorded++)->size_);
+    }
+  }
+  accumulatedTime_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+  iTask.runNow();
+}
+
+void ReplaySource::printSummary() const {
+  std::cout <<"\nSource time: "<<accumulatedTime_.load()<<"us\n"
+            <<"   recorded events: "<<recordedEvents_.size()<<" record time: "<<recordTime_.count()<<"us\n";
+  if(mode_ == ReplayMode::kSerialized) {
+    std::cout <<"   replayed bytes held: "<<arena_.size()<<"\n";
+  }
+  std::cout<<std::endl;
+}
+
+namespace {
+  class Maker : public SourceMakerBase {
+  public:
+    Maker(): SourceMakerBase("ReplaySource") {}
+    std::unique_ptr<SharedSourceBase> create(unsigned int iNLanes, unsigned long long iNEvents, ConfigurationParameters const& params) const final {
+      auto sourceType = params.get<std::string>("source");
+      if(not sourceType) {
+        std::cout <<"no source given for ReplaySource\n";
+        return {};
+      }
+      unsigned int nEventsToRecord = params.get<unsigned int>("repeat", 10);
+      auto replayName = params.get<std::string>("replay", "objects");
+      ReplaySource::ReplayMode mode;
+      if(replayName == "objects") {
+        mode = ReplaySource::ReplayMode::kObjects;
+      } else if(replayName == "serialized") {
+        mode = ReplaySource::ReplayMode::kSerialized;
+      } else {
+        std::cout <<"unknown replay mode "<<replayName<<std::endl;
+        return {};
+      }
+
+      //all other parameters, e.g. the file name, are for the recorded Source
+      ConfigurationParameters recordParams(params.takeUnusedKeyValues());
+      auto recordFrom = SourceFactory::get()->create(*sourceType, 1, nEventsToRecord, recordParams);
+      if(not recordFrom) {
+        return {};
+      }
+      auto unusedOptions = recordParams.unusedKeys();
+      if(not unusedOptions.empty()) {
+        std::cout <<"Unused options in "<<*sourceType<<"\n";
+        for(auto const& key: unusedOptions) {
+          std::cout <<"  '"<<key<<"'"<<std::endl;
+        }
+        return {};
+      }
+      //the recorded Source is no longer needed once its events are held
+      return std::make_unique<ReplaySource>(iNLanes, iNEvents, *recordFrom, nEventsToRecord, mode);
+    }
+  };
+
+  Maker s_maker;
+}
@@ -0,0 +1,75 @@
+#if !defined(ReplaySource_h)
+#define ReplaySource_h
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "DataProductRetriever.h"
+#include "DelayedProductRetriever.h"
+#include "Deserializer.h"
+#include "SharedSourceBase.h"
+
+namespace cce::tf {
+class ReplayDelayedRetriever : public DelayedProductRetriever {
+  void getAsync(DataProductRetriever&, int index, TaskHolder) override {}
+};
+
+  /**
+     Records the first events of any other Source when it is made and then
+     replays them for as many events as asked for. The data products of all
+     recorded events are serialized one after the other into one buffer
+     shared by all Lanes, so the replay only touches memory. Each replayed
+     event gets the identifier run 1, luminosity block 1 and event
+     iEventIndex+1, so they stay unique however often the events repeat.
+   */
+class ReplaySource : public SharedSourceBase {
+public:
+  enum class ReplayMode {
+    //the recorded events are deserialized once and the objects are shared, read-only, by all Lanes
+    kObjects,
+    //each Lane deserializes the recorded bytes into its own objects
+    kSerialized };
+
+  ReplaySource(unsigned int iNLanes, unsigned long long iNEvents, SharedSourceBase& iRecordFrom, unsigned int iNEventsToRecord,
+               ReplayMode iMode);
+  ~ReplaySource() final;
+
+  size_t numberOfDataProducts() const final { return dataProductsPerLane_[0].size(); }
+  std::vector<DataProductRetriever>& dataProducts(unsigned int iLane, long iEventIndex) final { return dataProductsPerLane_[iLane]; }
+  EventIdentifier eventIdentifier(unsigned int iLane, long iEventIndex) final {
+    return {1, 1, static_cast<unsigned long long>(iEventIndex+1)};
+  }
+
+  void printSummary() const final;
+
+private:
+  void readEventAsync(unsigned int iLane, long iEventIndex, OptionalTaskHolder) final;
+
+  //where a data product of a recorded event is in arena_
+  struct RecordedProduct {
+    std::size_t offset_;
+    std::size_t size_;
+  };
+  struct ReplayLane {
+    std::vector<void*> objects_;
+    std::vector<Deserializer> deserializers_;
+  };
+
+  void record(SharedSourceBase& iRecordFrom, unsigned int iNEventsToRecord);
+
+  ReplayMode mode_;
+  ReplayDelayedRetriever delayedReader_;
+  std::vector<std::vector<DataProductRetriever>> dataProductsPerLane_;
+  std::vector<char> arena_;
+  std::vector<std::vector<RecordedProduct>> recordedEvents_;
+  //used for ReplayMode::kObjects
+  std::vector<std::vector<void*>> objectsPerEvent_;
+  //used for ReplayMode::kSerialized
+  std::vector<ReplayLane> replayLanes_;
+  std::atomic<std::chrono::microseconds::rep> accumulatedTime_{0};
+  std::chrono::microseconds recordTime_ = std::chrono::microseconds::zero();
+};
+}
+#endif
@@ -3,19 +3,59 @@
 
 #include <vector>
 #include <iostream>
+#include <optional>
+#include <string>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
 #include "SharedSourceBase.h"
+#include "ConfigurationParameters.h"
 
 namespace cce::tf {
+  //How the events of the file are shared among the replicas. With kNone every
+  // replica reads the event index the Lane asks for, skipping the events read by
+  // the other replicas. With kRange each replica reads its own contiguous block of
+  // events and with kStride replica i reads events i, i+N, i+2N, ... for N replicas.
+  enum class ReplicaPartition { kNone, kRange, kStride };
+
+  inline std::optional<ReplicaPartition> parseReplicaPartition(std::string const& iName) {
+    if(iName == "none") { return ReplicaPartition::kNone; }
+    if(iName == "range") { return ReplicaPartition::kRange; }
+    if(iName == "stride") { return ReplicaPartition::kStride; }
+    return {};
+  }
+
   template<typename S>
     class ReplicatedSharedSource : public SharedSourceBase {
   public:
     template<typename... Args>
       ReplicatedSharedSource(unsigned iNLanes, unsigned long long iNEvents, Args&&... iArgs):
-    SharedSourceBase(iNEvents) {
+    ReplicatedSharedSource(ReplicaPartition::kNone, iNLanes, iNEvents, std::forward<Args>(iArgs)...) {}
+
+    //With a partition a replica which has read all of its events drops further requests.
+    // Such a request would still count against the job's number of events so the
+    // replicas themselves stop at iNEvents.
+    template<typename... Args>
+      ReplicatedSharedSource(ReplicaPartition iPartition, unsigned iNLanes, unsigned long long iNEvents, Args&&... iArgs):
+    SharedSourceBase(iPartition == ReplicaPartition::kNone ? iNEvents : std::numeric_limits<unsigned long long>::max()),
+      nEvents_{iNEvents}, partition_{iPartition}, replicaStates_(iNLanes) {
       sources_.reserve(iNLanes);
       for(int i=0; i< iNLanes; ++i) {
         sources_.emplace_back(std::forward<Args>(iArgs)...);
       }
+      if(partition_ == ReplicaPartition::kRange) {
+        auto nInFile = sources_[0].numberOfEvents();
+        if(not nInFile) {
+          throw std::runtime_error("partition=range requires the number of events to be known from the file, e.g. a PDS file with an event index");
+        }
+        long const nEvents = std::min<unsigned long long>(*nInFile, nEvents_);
+        long const nReplicas = sources_.size();
+        for(long i = 0; i < nReplicas; ++i) {
+          replicaStates_[i].next_ = nEvents*i/nReplicas;
+          replicaStates_[i].end_ = nEvents*(i+1)/nReplicas;
+        }
+      }
     }
 
     size_t numberOfDataProducts() const {return sources_[0].numberOfDataProducts();}
@@ -29,7 +69,11 @@ namespace cce::tf {
 
     void printSummary() const {
       std::chrono::microseconds sourceTime = accumulatedTime();
-      std::cout <<"\nSource time: "<<sourceTime.count()<<"us\n"<<std::endl;
+      std::cout <<"\nSource time: "<<sourceTime.count()<<"us\n";
+      if(partition_ != ReplicaPartition::kNone) {
+        std::cout <<" events partitioned among the replicas by "<<(partition_ == ReplicaPartition::kRange ? "range" : "stride")<<"\n";
+      }
+      std::cout<<std::endl;
     }
 
     std::chrono::microseconds accumulatedTime() const {
@@ -42,12 +86,56 @@ namespace cce::tf {
 
   private:
     void readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder iTask) final {
-      if(sources_[iLane].gotoEvent(iEventIndex)) {
+      auto& state = replicaStates_[iLane];
+      long index = iEventIndex;
+      if(partition_ == ReplicaPartition::kRange) {
+        if(state.next_ >= state.end_) {
+          return;
+        }
+        index = state.next_++;
+      } else if(partition_ == ReplicaPartition::kStride) {
+        index = iLane + state.next_*static_cast<long>(sources_.size());
+        if(static_cast<unsigned long long>(index) >= nEvents_) {
+          return;
+        }
+        ++state.next_;
+      }
+      if(sources_[iLane].gotoEvent(index)) {
         iTask.runNow();
       }
     }
+
+    //only changed by the replica's own Lane
+    struct ReplicaState {
+      //kRange: the next event to read, kStride: the number of events read
+      long next_ = 0;
+      long end_ = 0;
+    };
+
+    unsigned long long const nEvents_;
+    ReplicaPartition const partition_;
+    std::vector<ReplicaState> replicaStates_;
     std::vector<S> sources_;
   };
+
+  //Makes the Source using its 'partition' parameter. Returns nothing, after printing
+  // why, if the parameter can not be used.
+  template<typename S, typename... Args>
+    std::unique_ptr<SharedSourceBase> makeReplicatedSource(unsigned int iNLanes, unsigned long long iNEvents,
+                                                           ConfigurationParameters const& iParams, Args&&... iArgs) {
+    auto name = iParams.get<std::string>("partition", "none");
+    auto partition = parseReplicaPartition(name);
+    if(not partition) {
+      std::cout <<"unknown partition '"<<name<<"', must be none, range or stride"<<std::endl;
+      return {};
+    }
+    try {
+      return std::make_unique<ReplicatedSharedSource<S>>(*partition, iNLanes, iNEvents, std::forward<Args>(iArgs)...);
+    } catch(std::runtime_error const& iError) {
+      std::cout <<iError.what()<<std::endl;
+      return {};
+    }
+  }
 }
 
 #endif
@@ -2,14 +2,23 @@
 #include "OutputerFactory.h"
 #include "ConfigurationParameters.h"
 #include "UnrolledSerializerWrapper.h"
+#include "FixedLayoutSerializerWrapper.h"
 #include "SerializerWrapper.h"
 #include "summarize_serializers.h"
+#include "summarize_queue.h"
+#include "summarize_batches.h"
+#include "MemoryUsage.h"
 #include "FunctorTask.h"
+#include "RootIMT.h"
+#include "tbb/task_arena.h"
+#include "BlobView.h"
+#include "compact_index.h"
 #include "lz4.h"
 #include "zstd.h"
 #include <iostream>
 #include <cstring>
 #include <set>
+#include <thread>
 
 using namespace cce::tf;
 using namespace cce::tf::pds;
@@ -17,24 +26,34 @@ using namespace cce::tf::pds;
 RootBatchEventsOutputer::RootBatchEventsOutputer(std::string const& iFileName, unsigned int iNLanes, Compression iCompression, int iCompressionLevel, 
                                                  Serialization iSerialization, int autoFlush, int maxVirtualSize,
                                                  std::string const& iTFileCompression, int iTFileCompressionLevel,
-                                                 uint32_t iBatchSize): 
+                                                 uint32_t iBatchSize, bool iProductMajor, std::size_t iBatchBytes,
+                                                 std::size_t iCompressionChunkSize, std::size_t iCoalesceBytes, bool iCompactIndex,
+                                                 bool iEventBuffer, std::size_t iPreallocateBytes): 
   file_(iFileName.c_str(), "recreate", "", iTFileCompressionLevel),
   serializers_{iNLanes},
-  eventBatches_{iNLanes},
-  waitingEventsInBatch_(iNLanes),
+  eventBuffers_{iEventBuffer ? iNLanes : 0},
+  compressionContexts_{iNLanes},
+  chunkCompressionContexts_{iNLanes},
   presentEventEntry_(0),
   batchSize_(iBatchSize),
+  productMajor_(iProductMajor),
+  compactIndex_(iCompactIndex),
+  compressionChunkSize_(iCompressionChunkSize),
+  coalesceBytes_(iCoalesceBytes),
   compression_{iCompression},
   compressionLevel_{iCompressionLevel},
   serialization_{iSerialization},
   serialTime_{std::chrono::microseconds::zero()},
-  parallelTime_{0}
+  parallelTime_{iNLanes}
   {
-    for(auto& v: waitingEventsInBatch_) {
-      v.store(0);
-    }
-    for(auto& v:eventBatches_) {
-      v.store(nullptr);
+    if(iBatchBytes != 0) {
+      sizeBatcher_.emplace(iBatchBytes, batchSize_);
+    } else {
+      //twice the number of lanes lets a full batch be compressed while the next ones fill
+      batchSlots_.reserve(2*iNLanes);
+      for(unsigned int i=0; i<2*iNLanes; ++i) {
+        batchSlots_.push_back(std::make_unique<BatchSlot>(batchSize_, i));
+      }
     }
 
     if(not iTFileCompression.empty()) {
@@ -53,14 +72,24 @@ RootBatchEventsOutputer::RootBatchEventsOutputer(std::string const& iFileName, u
     }
 
 
+    if(iPreallocateBytes != 0) {
+      preallocator_ = std::make_unique<FilePreallocator>(iFileName, iPreallocateBytes);
+    }
+
     //gDebug = 3;
     eventsTree_ = new TTree("Events", "", 0, &file_);
 
     eventsTree_->Branch("offsetsAndBlob", &offsetsAndBlob_);
-    eventsTree_->Branch("EventIDs", &eventIDs_);
+    if(compactIndex_) {
+      //the offsets in offsetsAndBlob are left empty
+      eventsTree_->Branch("compactIndex", &compactIndexBytes_);
+    } else {
+      eventsTree_->Branch("EventIDs", &eventIDs_);
+    }
 
     //Turn off auto save
     eventsTree_->SetAutoSave(std::numeric_limits<Long64_t>::max());
+    eventsTree_->SetImplicitMT(rootIMTForOutputers());
     if(-1 != autoFlush) {
       eventsTree_->SetAutoFlush(autoFlush);
     }
@@ -80,6 +109,10 @@ void RootBatchEventsOutputer::setupForLane(unsigned int iLaneIndex, std::vector<
     {   s = SerializeStrategy::make<SerializeProxy<SerializerWrapper>>(); break; }
   case Serialization::kRootUnrolled:
     {   s = SerializeStrategy::make<SerializeProxy<UnrolledSerializerWrapper>>(); break; }
+  case Serialization::kNativeUnrolled:
+    {   s = SerializeStrategy::make<SerializeProxy<NativeUnrolledSerializerWrapper>>(); break; }
+  case Serialization::kFixedLayout:
+    {   s = SerializeStrategy::make<SerializeProxy<FixedLayoutSerializerWrapper>>(); break; }
   }
   s.reserve(iDPs.size());
   offsetsAndBlob_.first.resize(iDPs.size()+1,0);
@@ -95,135 +128,316 @@ void RootBatchEventsOutputer::setupForLane(unsigned int iLaneIndex, std::vector<
 
 void RootBatchEventsOutputer::productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const {
   auto& laneSerializers = serializers_[iLaneIndex];
-  auto group = iCallback.group();
-  laneSerializers[iDataProduct.index()].doWorkAsync(*group, iDataProduct.address(), std::move(iCallback));
+  serializeAsync(laneSerializers[iDataProduct.index()], iDataProduct.address(), std::move(iCallback), coalesceBytes_);
 }
 
-void RootBatchEventsOutputer::outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+void RootBatchEventsOutputer::serializeDeferredOfLane(unsigned int iLaneIndex) const {
+  if(eventBuffers_.empty()) {
+    serializeDeferred(serializers_[iLaneIndex]);
+  } else {
+    serializeDeferred(serializers_[iLaneIndex], eventBuffers_[iLaneIndex]);
+  }
+}
+
+void RootBatchEventsOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
   auto start = std::chrono::high_resolution_clock::now();
+  serializeDeferredOfLane(iLaneIndex);
   auto [offsets, buffer] = writeDataProductsToOutputBuffer(serializers_[iLaneIndex]);
 
-  auto eventIndex = presentEventEntry_++;
+  if(sizeBatcher_) {
+    auto const bytes = buffer.size();
+    auto batch = sizeBatcher_->add({iEventID, std::move(offsets), std::move(buffer)}, bytes);
+    if(not batch.empty()) {
+      const_cast<RootBatchEventsOutputer*>(this)->writeBatchAsync(collectBatch(batch.data(), batch.data()+batch.size()), iLaneIndex, std::move(iCallback));
+    }
+    auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+    parallelTime_.add(iLaneIndex, time.count());
+    return;
+  }
 
-  auto batchIndex = (eventIndex/batchSize_) % eventBatches_.size();
-  //std::cout <<"eventIndex "<<eventIndex <<"  batchIndex "<< batchIndex<<std::endl;
+  auto eventIndex = presentEventEntry_++;
+  auto const slotIndex = placeEvent(eventIndex, {iEventID, std::move(offsets), std::move(buffer)});
+  filledSlot(slotIndex, 1, iLaneIndex, std::move(iCallback));
 
+  auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+  parallelTime_.add(iLaneIndex, time.count());
+}
 
-  auto& batchContainerPtr = eventBatches_[batchIndex];
-  auto batchContainer = batchContainerPtr.load();
-  if( nullptr == batchContainer ) {
-    auto newContainer = std::make_unique<std::vector<EventInfo>>(batchSize_);
-    if(batchContainerPtr.compare_exchange_strong(batchContainer, newContainer.get())) {
-      newContainer.release();
-      batchContainer = batchContainerPtr.load();
+void RootBatchEventsOutputer::outputEventsAsync(unsigned int iFirstLaneIndex, long iFirstEventIndex, std::vector<EventIdentifier> const& iEventIDs, TaskHolder iCallback) const {
+  if(sizeBatcher_ or iEventIDs.empty()) {
+    OutputerBase::outputEventsAsync(iFirstLaneIndex, iFirstEventIndex, iEventIDs, std::move(iCallback));
+    return;
+  }
+  auto start = std::chrono::high_resolution_clock::now();
+  //the events get consecutive entries with one update of the shared counter
+  auto const firstEntry = presentEventEntry_.fetch_add(iEventIDs.size());
+  unsigned int slotIndex = 0;
+  uint32_t nInSlot = 0;
+  for(unsigned int i = 0; i < iEventIDs.size(); ++i) {
+    auto& serializers = serializers_[iFirstLaneIndex+i];
+    serializeDeferredOfLane(iFirstLaneIndex+i);
+    auto [offsets, buffer] = writeDataProductsToOutputBuffer(serializers);
+    auto const entry = firstEntry+i;
+    if(nInSlot != 0 and entry % batchSize_ == 0) {
+      //count the events of the previous batch before waiting for the slot of the next
+      filledSlot(slotIndex, nInSlot, iFirstLaneIndex, iCallback);
+      nInSlot = 0;
     }
+    slotIndex = placeEvent(entry, {iEventIDs[i], std::move(offsets), std::move(buffer)});
+    ++nInSlot;
   }
-  //std::cout <<"batchContainer "<<batchContainer<<std::endl;
-
-  auto indexInBatch = eventIndex % (batchSize_);
-  //std::cout <<"indexInBatch "<<indexInBatch<<std::endl;
-  std::get<0>((*batchContainer)[indexInBatch]) = iEventID;
-  std::get<1>((*batchContainer)[indexInBatch]) = std::move(offsets);
-  std::get<2>((*batchContainer)[indexInBatch]) = std::move(buffer);
+  filledSlot(slotIndex, nInSlot, iFirstLaneIndex, std::move(iCallback));
 
-  assert(waitingEventsInBatch_[batchIndex].load() < batchSize_);
+  auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+  parallelTime_.add(iFirstLaneIndex, time.count());
+}
 
-  auto waitingEvents = ++waitingEventsInBatch_[batchIndex];
+unsigned int RootBatchEventsOutputer::placeEvent(uint64_t iEntry, EventInfo iEvent) const {
+  auto const batchNumber = iEntry/batchSize_;
+  auto const slotIndex = batchNumber % batchSlots_.size();
+  auto& slot = *batchSlots_[slotIndex];
+  while(slot.batchNumber_.load() != batchNumber) {
+    //an earlier batch is still being taken out of the slot
+    std::this_thread::yield();
+  }
+  slot.events_[iEntry % batchSize_] = std::move(iEvent);
+  return slotIndex;
+}
 
-  if(waitingEvents == batchSize_ ) {
-    const_cast<RootBatchEventsOutputer*>(this)->finishBatchAsync(batchIndex, std::move(iCallback));
+void RootBatchEventsOutputer::filledSlot(unsigned int iSlotIndex, uint32_t iNAdded, unsigned int iLaneIndex, TaskHolder iCallback) const {
+  auto& slot = *batchSlots_[iSlotIndex];
+  assert(slot.nFilled_.load() + iNAdded <= batchSize_);
+  if((slot.nFilled_ += iNAdded) == batchSize_ ) {
+    const_cast<RootBatchEventsOutputer*>(this)->finishBatchAsync(iSlotIndex, iLaneIndex, std::move(iCallback));
   }
-  auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
-  parallelTime_ += time.count();
 }
 
-void RootBatchEventsOutputer::printSummary() const  {
-  //make sure last batches are out
+void RootBatchEventsOutputer::finishRemainingBatchesAsync(TaskHolder iCallback) const {
+  finishStart_ = std::chrono::high_resolution_clock::now();
+  for( int index=0; index < batchSlots_.size();++index) {
+    if(0 != batchSlots_[index]->nFilled_.load()) {
+      //all lanes are done so their contexts are free to use
+      const_cast<RootBatchEventsOutputer*>(this)->finishBatchAsync(index, 0, iCallback);
+    }
+  }
+  if(sizeBatcher_) {
+    auto batch = sizeBatcher_->takeRemaining();
+    if(not batch.empty()) {
+      const_cast<RootBatchEventsOutputer*>(this)->writeBatchAsync(collectBatch(batch.data(), batch.data()+batch.size()), 0, iCallback);
+    }
+  }
+}
 
+void RootBatchEventsOutputer::writeAndCloseFile() const {
+  if(finished_) {
+    return;
+  }
+  finished_ = true;
   auto start = std::chrono::high_resolution_clock::now();
-  {
+  file_.Write();
+  writeTime_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+
+  start = std::chrono::high_resolution_clock::now();
+  file_.Close();
+  if(preallocator_) {
+    preallocator_->finish();
+  }
+  auto const end = std::chrono::high_resolution_clock::now();
+  closeTime_ = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+  endOfJobTime_ = std::chrono::duration_cast<std::chrono::microseconds>(end - finishStart_);
+}
+
+void RootBatchEventsOutputer::finishAsync(TaskHolder iCallback) const {
+  auto group = iCallback.group();
+  TaskHolder batchesWritten(*group, make_functor_task([this, group, iCallback=std::move(iCallback)]() {
+        queue_.push(*group, [this, iCallback]() { writeAndCloseFile(); });
+      }));
+  finishRemainingBatchesAsync(std::move(batchesWritten));
+}
+
+void RootBatchEventsOutputer::printSummary() const  {
+  if(not finished_) {
+    //make sure last batches are out
     tbb::task_group group;
-    
     {
       TaskHolder th(group, make_functor_task([](){}));
-      for( int index=0; index < waitingEventsInBatch_.size();++index) {
-        if(0 != waitingEventsInBatch_[index].load()) {
-          const_cast<RootBatchEventsOutputer*>(this)->finishBatchAsync(index, th);
-        }
-      }
+      finishRemainingBatchesAsync(std::move(th));
     }
-    
     group.wait();
+    writeAndCloseFile();
   }
-  file_.Write();
-  auto writeTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
-
 
   std::cout <<"RootBatchEventsOutputer\n  total serial time at end event: "<<serialTime_.count()<<"us\n"
-    "  total parallel time at end event: "<<parallelTime_.load()<<"us\n";
+    "  total parallel time at end event: "<<parallelTime_.sum()<<"us\n";
 
-
-  start = std::chrono::high_resolution_clock::now();
-  file_.Close();
-  auto closeTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
-
-  std::cout << "  end of job file write time: "<<writeTime.count()<<"us\n";
-  std::cout << "  end of job file close time: "<<closeTime.count()<<"us\n";
+  std::cout << "  end of job time: "<<endOfJobTime_.count()<<"us\n";
+  std::cout << "  end of job file write time: "<<writeTime_.count()<<"us\n";
+  std::cout << "  end of job file close time: "<<closeTime_.count()<<"us\n";
+  if(sizeBatcher_) {
+    summarize_batches(*sizeBatcher_);
+  }
                                                                                          
+  std::cout <<"  largest batch buffer: "<<maxBatchBytes_.load()<<" bytes\n";
+  std::cout <<"  event identifiers and offsets: "<<indexBytes_<<" bytes"<<(compactIndex_ ? " compact\n" : "\n");
+  if(preallocator_) {
+    summarize_preallocation(*preallocator_);
+  }
+  if(coalesceBytes_ != 0) {
+    std::cout <<"  serializations done together at end of event: "<<nDeferred(serializers_)<<"\n";
+  }
+  if(not eventBuffers_.empty()) {
+    std::cout <<"  serializations written into the Lane's event buffer: "<<nInEventBuffer(serializers_)<<"\n";
+  }
+  summarize_queue("write", queue_);
   summarize_serializers(serializers_);
 }
 
-void RootBatchEventsOutputer::finishBatchAsync(unsigned int iBatchIndex, TaskHolder iCallback) {
+void RootBatchEventsOutputer::fillProfile(ProductProfile& oProfile) const {
+  profile_serializers(oProfile, serializers_);
+}
 
-  std::unique_ptr<std::vector<EventInfo>> batch(eventBatches_[iBatchIndex].exchange(nullptr));
-  auto eventsInBatch = waitingEventsInBatch_[iBatchIndex].load();
-  waitingEventsInBatch_[iBatchIndex] = 0;
+void RootBatchEventsOutputer::fillReport(RunReport& oReport) const {
+  oReport.set("endOfJobTime_us", endOfJobTime_.count());
+  oReport.set("maxBatchBytes", maxBatchBytes_.load());
+  oReport.set("indexBytes", indexBytes_);
+  if(coalesceBytes_ != 0) {
+    oReport.set("coalescedSerializations", nDeferred(serializers_));
+  }
+  if(not eventBuffers_.empty()) {
+    oReport.set("eventBufferSerializations", nInEventBuffer(serializers_));
+  }
+  if(preallocator_) {
+    report_preallocation(oReport, *preallocator_);
+  }
+  report_serializers(oReport, serializers_);
+  report_queue(oReport, "write", queue_);
+}
 
-  std::vector<EventIdentifier> batchEventIDs;
-  batchEventIDs.reserve(batch->size());
+void RootBatchEventsOutputer::finishBatchAsync(unsigned int iSlotIndex, unsigned int iLaneIndex, TaskHolder iCallback) {
+  auto& slot = *batchSlots_[iSlotIndex];
+  //batch can be smaller than usual at end of job
+  auto eventsInBatch = slot.nFilled_.load();
+  auto batch = collectBatch(slot.events_.data(), slot.events_.data()+eventsInBatch);
 
-  std::vector<uint32_t> batchOffsets;
-  batchOffsets.reserve(batch->size() * (serializers_.size()+1));
+  //the slot can now be used by the next batch assigned to it
+  slot.nFilled_ = 0;
+  slot.batchNumber_ += batchSlots_.size();
 
-  std::vector<char> batchBlob;
+  writeBatchAsync(std::move(batch), iLaneIndex, std::move(iCallback));
+}
 
-  int index = 0;
-  for(auto& event: *batch) {
-    if(index++ == eventsInBatch) {
-      //batch was smaller than usual. Can happen at end of job
-      break;
+RootBatchEventsOutputer::CollectedBatch RootBatchEventsOutputer::collectBatch(EventInfo* iBegin, EventInfo* iEnd) const {
+  CollectedBatch batch;
+  batch.eventIDs_.reserve(iEnd-iBegin);
+  batch.offsets_.reserve((iEnd-iBegin) * (serializers_.size()+1));
+
+  for(auto event = iBegin; event != iEnd; ++event) {
+    batch.eventIDs_.push_back(std::get<0>(*event));
+
+    auto& offsets = std::get<1>(*event);
+    std::copy(offsets.begin(), offsets.end(), std::back_inserter(batch.offsets_));
+
+    if(not productMajor_) {
+      auto& blob = std::get<2>(*event);
+      std::copy(blob.begin(), blob.end(), std::back_inserter(batch.blob_));
+
+      //release memory
+      blob = std::vector<char>();
+    }
+  }
+  if(productMajor_ and iBegin != iEnd) {
+    //the offsets are unchanged so the reader can restore the event by event order
+    auto const nProducts = std::get<1>(*iBegin).size()-1;
+    for(size_t product = 0; product < nProducts; ++product) {
+      for(auto event = iBegin; event != iEnd; ++event) {
+        auto const& offsets = std::get<1>(*event);
+        auto const& blob = std::get<2>(*event);
+        std::copy(blob.begin()+offsets[product], blob.begin()+offsets[product+1], std::back_inserter(batch.blob_));
+      }
+    }
+    for(auto event = iBegin; event != iEnd; ++event) {
+      std::get<2>(*event) = std::vector<char>();
     }
-    batchEventIDs.push_back(std::get<0>(event));
+  }
+  recordMax(maxBatchBytes_, batch.blob_.size());
+  return batch;
+}
 
-    auto& offsets = std::get<1>(event);
-    std::copy(offsets.begin(), offsets.end(), std::back_inserter(batchOffsets));
+void RootBatchEventsOutputer::writeBatchAsync(CollectedBatch iBatch, unsigned int iLaneIndex, TaskHolder iCallback) {
+  if(compressionChunkSize_ != 0 and iBatch.blob_.size() > compressionChunkSize_) {
+    compressChunksAsync(std::move(iBatch), iLaneIndex, std::move(iCallback));
+    return;
+  }
+  auto compressedBlob = compressBuffer(iBatch.blob_, compressionContexts_[iLaneIndex]);
+  iBatch.blob_ = std::vector<char>();
 
-    auto& blob = std::get<2>(event);
-    std::copy(blob.begin(), blob.end(), std::back_inserter(batchBlob));
+  queueOutput(std::move(iBatch.eventIDs_), std::move(iBatch.offsets_), std::move(compressedBlob), std::move(iCallback));
+}
 
-    //release memory
-    blob = std::vector<char>();
+void RootBatchEventsOutputer::compressChunksAsync(CollectedBatch iBatch, unsigned int iLaneIndex, TaskHolder iCallback) {
+  auto const nChunks = (iBatch.blob_.size() + compressionChunkSize_ - 1)/compressionChunkSize_;
+  //the lane's callback is only released once the chunks are done so no other batch uses the contexts
+  auto& contexts = chunkCompressionContexts_[iLaneIndex];
+  if(contexts.size() < nChunks) {
+    contexts.resize(nChunks);
   }
+  auto blob = std::make_shared<std::vector<char>>(std::move(iBatch.blob_));
+  auto chunks = std::make_shared<std::vector<std::vector<char>>>(nChunks);
 
-  auto compressedBlob = compressBuffer(batchBlob);
-  batchBlob = std::vector<char>();
+  auto group = iCallback.group();
+  //ZSTD decompresses concatenated frames as one buffer so older readers still work
+  TaskHolder chunksDone(*group, make_functor_task([this, chunks, eventIDs = std::move(iBatch.eventIDs_), offsets = std::move(iBatch.offsets_), callback = std::move(iCallback)]() mutable {
+        std::size_t size = 0;
+        for(auto const& c: *chunks) {
+          size += c.size();
+        }
+        std::vector<char> cBuffer;
+        cBuffer.reserve(size);
+        for(auto const& c: *chunks) {
+          cBuffer.insert(cBuffer.end(), c.begin(), c.end());
+        }
+        queueOutput(std::move(eventIDs), std::move(offsets), std::move(cBuffer), std::move(callback));
+      }));
 
-  
-  queue_.push(*iCallback.group(), [this, eventIDs=std::move(batchEventIDs), offsets = std::move(batchOffsets), buffer = std::move(compressedBlob),  callback=std::move(iCallback)]() mutable {
+  auto compressChunk = [this, blob, chunks, &contexts](std::size_t iChunk) {
+    auto const begin = iChunk*compressionChunkSize_;
+    auto const size = std::min(compressionChunkSize_, blob->size() - begin);
+    (*chunks)[iChunk] = pds::compressBuffer(0, 0, compression_, compressionLevel_, BlobView(blob->data()+begin, size), contexts[iChunk]);
+  };
+  for(std::size_t i = 1; i < nChunks; ++i) {
+    group->run([compressChunk, i, holder = chunksDone]() { compressChunk(i); });
+  }
+  compressChunk(0);
+}
+
+void RootBatchEventsOutputer::queueOutput(std::vector<EventIdentifier> iEventIDs, std::vector<uint32_t> iOffsets, std::vector<char> iBuffer, TaskHolder iCallback) {
+  queue_.push(*iCallback.group(), [this, eventIDs=std::move(iEventIDs), offsets = std::move(iOffsets), buffer = std::move(iBuffer),  callback=std::move(iCallback)]() mutable {
       auto start = std::chrono::high_resolution_clock::now();
       const_cast<RootBatchEventsOutputer*>(this)->output(std::move(eventIDs), std::move(buffer), std::move(offsets));
         serialTime_ += std::chrono::duration_cast<decltype(serialTime_)>(std::chrono::high_resolution_clock::now() - start);
       callback.doneWaiting();
     });
-  
 }
 
 void RootBatchEventsOutputer::output(std::vector<EventIdentifier> iEventIDs, std::vector<char>  iBuffer, std::vector<uint32_t> iOffsets) {
 
-  eventIDs_ = std::move(iEventIDs);
-  offsetsAndBlob_ = {std::move(iOffsets), std::move(iBuffer)};
+  if(compactIndex_) {
+    compactIndexBytes_.clear();
+    encodeBatchIndex(iEventIDs, iOffsets, serializers_[0].size()+1, compactIndexBytes_);
+    indexBytes_ += compactIndexBytes_.size();
+    offsetsAndBlob_ = {{}, std::move(iBuffer)};
+  } else {
+    indexBytes_ += iEventIDs.size()*sizeof(EventIdentifier) + iOffsets.size()*sizeof(uint32_t);
+    eventIDs_ = std::move(iEventIDs);
+    offsetsAndBlob_ = {std::move(iOffsets), std::move(iBuffer)};
+  }
 
-  eventsTree_->Fill();
+  TaskHolder::WaitScope waitScope;
+  //isolated so a thread waiting on ROOT's IMT tasks does not take up a Lane's task
+  tbb::this_task_arena::isolate([this] { eventsTree_->Fill(); });
+  if(preallocator_) {
+    preallocator_->written();
+  }
 
   offsetsAndBlob_ = {};
 }
@@ -244,6 +458,8 @@ void RootBatchEventsOutputer::writeMetaData(SerializeStrategy const& iSerializer
   meta->Branch("DataProducts",&typeAndNames, 0, 0);
   meta->Branch("objectSerializationUsed",&objectSerializationUsed);
   meta->Branch("compressionAlgorithm",&compression,0,0);
+  meta->Branch("productMajor",&productMajor_);
+  meta->Branch("compactIndex",&compactIndex_);
 
   meta->Fill();
 
@@ -279,8 +495,8 @@ std::pair<std::vector<uint32_t>, std::vector<char>> RootBatchEventsOutputer::wri
   return {offsets,buffer};
 }
 
-std::vector<char> RootBatchEventsOutputer::compressBuffer(std::vector<char> const& iBuffer) const {
-  return pds::compressBuffer(0, 0, compression_, compressionLevel_, iBuffer);
+std::vector<char> RootBatchEventsOutputer::compressBuffer(std::vector<char> const& iBuffer, pds::CompressionContext& iContext) const {
+  return pds::compressBuffer(0, 0, compression_, compressionLevel_, iBuffer, iContext);
 }
 
 namespace {
@@ -320,9 +536,25 @@ namespace {
       auto fileLevelCompression = params.get<std::string>("tfileCompressionAlgorithm", "");
       auto fileLevelCompressionLevel = params.get<int>("tfileCompressionLevel",0);
 
-      auto batchSize = params.get<int>("batchSize",1);
+      auto batchBytes = params.get<std::size_t>("batchBytes", 0);
+      //with batchBytes only an explicit batchSize limits the number of events
+      auto batchSize = params.get<int>("batchSize", batchBytes == 0 ? 1 : 0);
+      auto productMajor = params.get<bool>("productMajor", false);
+      auto compressionChunkSize = params.get<std::size_t>("compressionChunkSize", 0);
+      auto coalesceBytes = params.get<std::size_t>("coalesceBytes", 0);
+      auto compactIndex = params.get<bool>("compactIndex", false);
+      auto preallocateBytes = params.get<std::size_t>("preallocateBytes", 0);
+      bool eventBuffer = params.get<bool>("eventBuffer", false);
+      if(eventBuffer and coalesceBytes == 0) {
+        std::cout <<"eventBuffer requires coalesceBytes"<<std::endl;
+        return {};
+      }
+      if(compressionChunkSize != 0 and not pds::isZSTD(*compression)) {
+        std::cout <<"compressionChunkSize can only be used with ZSTD compression"<<std::endl;
+        return {};
+      }
       
-      return std::make_unique<RootBatchEventsOutputer>(*fileName,iNLanes, *compression, compressionLevel, *serialization, autoFlush, treeMaxVirtualSize, fileLevelCompression, fileLevelCompressionLevel, batchSize);
+      return std::make_unique<RootBatchEventsOutputer>(*fileName,iNLanes, *compression, compressionLevel, *serialization, autoFlush, treeMaxVirtualSize, fileLevelCompression, fileLevelCompressionLevel, batchSize, productMajor, batchBytes, compressionChunkSize, coalesceBytes, compactIndex, eventBuffer, preallocateBytes);
     }
     
   };
@@ -6,6 +6,8 @@
 #include <cstdint>
 #include <tuple>
 #include <atomic>
+#include <memory>
+#include <optional>
 #include "TFile.h"
 #include "TTree.h"
 #include "TBranch.h"
@@ -17,6 +19,9 @@
 #include "pds_writer.h"
 
 #include "SerialTaskQueue.h"
+#include "PerLaneCounter.h"
+#include "SizeTargetBatcher.h"
+#include "FilePreallocator.h"
 
 namespace cce::tf {
 class RootBatchEventsOutputer :public OutputerBase {
@@ -24,7 +29,9 @@ class RootBatchEventsOutputer :public OutputerBase {
   RootBatchEventsOutputer(std::string const& iFileName, unsigned int iNLanes, pds::Compression iCompression, int iCompressionLevel, 
                           pds::Serialization iSerialization, int autoFlush, int maxVirtualSize,
                           std::string const& iTFileCompression, int iTFileCompressionLevel,
-                          uint32_t iBatchSize);
+                          uint32_t iBatchSize, bool iProductMajor = false, std::size_t iBatchBytes = 0,
+                          std::size_t iCompressionChunkSize = 0, std::size_t iCoalesceBytes = 0, bool iCompactIndex = false,
+                          bool iEventBuffer = false, std::size_t iPreallocateBytes = 0);
  ~RootBatchEventsOutputer();
 
   void setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) final;
@@ -32,45 +39,110 @@ class RootBatchEventsOutputer :public OutputerBase {
   void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const final;
   bool usesProductReadyAsync() const final {return true;}
 
-  void outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+  //the events of a Lane are given consecutive entries
+  void outputEventsAsync(unsigned int iFirstLaneIndex, long iFirstEventIndex, std::vector<EventIdentifier> const& iEventIDs, TaskHolder iCallback) const final;
   
+  //the last batches are compressed in parallel before the file is closed
+  void finishAsync(TaskHolder iCallback) const final;
   void printSummary() const final;
+  void fillReport(RunReport&) const final;
+  void fillProfile(ProductProfile&) const final;
 
  private:
-  void finishBatchAsync(unsigned int iBatchIndex, TaskHolder iCallback);
+  void serializeDeferredOfLane(unsigned int iLaneIndex) const;
+
+  using EventInfo = std::tuple<EventIdentifier, std::vector<uint32_t>, std::vector<char>>;
+  //The batches are filled in a ring of slots. The events of batch number N go to slot N % (number of slots)
+  // and may only be added once the slot's batchNumber_ is N, i.e. once batch N - (number of slots)
+  // has been taken out of the slot.
+  struct BatchSlot {
+    explicit BatchSlot(uint32_t iBatchSize, uint64_t iFirstBatchNumber):
+      events_(iBatchSize), nFilled_{0}, batchNumber_{iFirstBatchNumber} {}
+    std::vector<EventInfo> events_;
+    std::atomic<uint32_t> nFilled_;
+    std::atomic<uint64_t> batchNumber_;
+  };
+  struct CollectedBatch {
+    std::vector<EventIdentifier> eventIDs_;
+    std::vector<uint32_t> offsets_;
+    std::vector<char> blob_;
+  };
+  //moves the event into the slot of entry iEntry once the slot holds its batch, returns the slot index
+  unsigned int placeEvent(uint64_t iEntry, EventInfo iEvent) const;
+  //finishes the batch in the slot once iNAdded more events made it full
+  void filledSlot(unsigned int iSlotIndex, uint32_t iNAdded, unsigned int iLaneIndex, TaskHolder iCallback) const;
+  //iLaneIndex selects the compression contexts to use
+  void finishBatchAsync(unsigned int iSlotIndex, unsigned int iLaneIndex, TaskHolder iCallback);
+  CollectedBatch collectBatch(EventInfo* iBegin, EventInfo* iEnd) const;
+  void writeBatchAsync(CollectedBatch iBatch, unsigned int iLaneIndex, TaskHolder iCallback);
+  //writes the batches not yet full, only called once all lanes are done
+  void finishRemainingBatchesAsync(TaskHolder iCallback) const;
+  //only the first call does anything
+  void writeAndCloseFile() const;
+  //compresses pieces of the batch blob in parallel tasks
+  void compressChunksAsync(CollectedBatch iBatch, unsigned int iLaneIndex, TaskHolder iCallback);
+  void queueOutput(std::vector<EventIdentifier> iEventIDs, std::vector<uint32_t> iOffsets, std::vector<char> iBuffer, TaskHolder iCallback);
 
   void output(std::vector<EventIdentifier> iEventIDs, std::vector<char>  iBuffer, std::vector<uint32_t> iOffset);
   void writeMetaData(SerializeStrategy const& iSerializers);
 
   std::pair<std::vector<uint32_t>,std::vector<char>> writeDataProductsToOutputBuffer(SerializeStrategy const& iSerializers) const;
 
-  std::vector<char> compressBuffer(std::vector<char> const& iBuffer) const;
+  std::vector<char> compressBuffer(std::vector<char> const& iBuffer, pds::CompressionContext&) const;
 
 private:
   mutable TFile file_;
+  //when set, the file's blocks are allocated ahead of what TFile has written
+  std::unique_ptr<FilePreallocator> preallocator_;
 
   TTree* eventsTree_;
 
   mutable SerialTaskQueue queue_;
   mutable std::vector<SerializeStrategy> serializers_;
+  //when not empty, the coalesced data products of a Lane's event are serialized one after the other into its buffer
+  mutable std::vector<EventSerializationBuffer> eventBuffers_;
+  //one per lane so the compression state does not need to be remade for each event
+  mutable std::vector<pds::CompressionContext> compressionContexts_;
+  //per lane, one for each chunk of a batch compressed in parallel
+  mutable std::vector<std::vector<pds::CompressionContext>> chunkCompressionContexts_;
 
   //objects used by the TBranches
   mutable std::pair<std::vector<uint32_t>, std::vector<char>> offsetsAndBlob_;
   mutable std::vector<EventIdentifier> eventIDs_;
+  //used instead of eventIDs_ and the offsets when compactIndex_ is set
+  mutable std::vector<char> compactIndexBytes_;
 
-  //This is used as a circular buffer of length nLanes but only entries being used exist
-  using EventInfo = std::tuple<EventIdentifier, std::vector<uint32_t>, std::vector<char>>;
-  mutable std::vector<std::atomic<std::vector<EventInfo>*>> eventBatches_;
-  mutable std::vector<std::atomic<uint32_t>> waitingEventsInBatch_;
+  //allocated once so filling a batch only moves the event's buffers into place
+  mutable std::vector<std::unique_ptr<BatchSlot>> batchSlots_;
 
   mutable std::atomic<uint64_t> presentEventEntry_;
+  //when set, batches are closed by their size in bytes instead of batchSlots_ being used
+  mutable std::optional<SizeTargetBatcher<EventInfo>> sizeBatcher_;
 
   uint32_t batchSize_;
+  //within a batch, the blobs of one data product for all events are stored next to each other
+  bool productMajor_;
+  //the event identifiers and offsets of a batch are stored with encodeBatchIndex
+  bool compactIndex_;
+  //if not 0, batch blobs larger than this are compressed as separate ZSTD frames in parallel
+  std::size_t compressionChunkSize_;
+  //data products which serialized to at most this many bytes are not given their own task
+  std::size_t coalesceBytes_;
   pds::Compression compression_;
   int compressionLevel_;
   pds::Serialization serialization_;
   mutable std::chrono::microseconds serialTime_;
-  mutable std::atomic<std::chrono::microseconds::rep> parallelTime_;
+  mutable PerLaneCounter<std::chrono::microseconds::rep> parallelTime_;
+  //largest buffer holding all the events of one batch
+  mutable std::atomic<std::size_t> maxBatchBytes_{0};
+  //only used from queue_
+  unsigned long long indexBytes_ = 0;
+  mutable bool finished_ = false;
+  mutable std::chrono::high_resolution_clock::time_point finishStart_;
+  mutable std::chrono::microseconds endOfJobTime_{0};
+  mutable std::chrono::microseconds writeTime_{0};
+  mutable std::chrono::microseconds closeTime_{0};
 };
 }
 #endif
@@ -0,0 +1,70 @@
+#include "RootCacheOptions.h"
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TBranch.h"
+#include "TTreeCache.h"
+#include "TTreeCacheUnzip.h"
+#include "TEnv.h"
+
+#include <iostream>
+
+namespace cce::tf {
+  TFile* openFileForCache(std::string const& iName, RootCacheOptions const& iOptions) {
+    if(iOptions.prefetch_) {
+      //only takes effect for files opened afterwards
+      gEnv->SetValue("TFile.AsyncPrefetching", 1);
+    }
+    return TFile::Open(iName.c_str());
+  }
+
+  void configureCache(TTree& iTree, std::vector<TBranch*> const& iBranches, RootCacheOptions const& iOptions) {
+    if(iOptions.parallelUnzip_) {
+      //The cache is then a TTreeCacheUnzip. Once the serialized read has filled
+      // the cache the baskets are decompressed in ROOT IMT tasks so the later
+      // GetEntry calls in the queue mostly only stream the objects.
+      iTree.SetParallelUnzip(true);
+    }
+    if(iOptions.cacheSize_ != 0) {
+      iTree.SetCacheSize(iOptions.cacheSize_);
+    } else if(iOptions.parallelUnzip_) {
+      //make sure the cache is created with parallel unzipping
+      iTree.SetCacheSize();
+    }
+    if(iOptions.learnEntries_ != 0) {
+      iTree.SetCacheLearnEntries(iOptions.learnEntries_);
+    } else {
+      //the branches to be read are already known so no learning is needed
+      for(auto b: iBranches) {
+        iTree.AddBranchToCache(b, true);
+      }
+      iTree.StopCacheLearningPhase();
+    }
+  }
+
+  void restrictCache(TTree& iTree, std::vector<TBranch*> const& iBranches, RootCacheOptions const& iOptions) {
+    if(not iOptions.configured() or iOptions.learnEntries_ != 0) {
+      return;
+    }
+    //each fill of the cache is then one vectored read of only the baskets of iBranches
+    iTree.DropBranchFromCache("*", true);
+    for(auto b: iBranches) {
+      iTree.AddBranchToCache(b, true);
+    }
+    iTree.StopCacheLearningPhase();
+  }
+
+  void printCacheSummary(TFile& iFile, TTree* iTree) {
+    std::cout <<"   bytes read: "<<iFile.GetBytesRead()<<" in "<<iFile.GetReadCalls()<<" reads\n";
+    auto cache = dynamic_cast<TTreeCache*>(iFile.GetCacheRead(iTree));
+    if(cache) {
+      std::cout <<"   TTreeCache size: "<<cache->GetBufferSize()<<" bytes"
+        " efficiency: "<<100.*cache->GetEfficiency()<<"%\n"
+        "   reads not served by the cache: "<<cache->GetNoCacheReadCalls()<<" ("<<cache->GetNoCacheBytesRead()<<" bytes)\n";
+      auto unzip = dynamic_cast<TTreeCacheUnzip*>(cache);
+      if(unzip) {
+        std::cout <<"   baskets unzipped in parallel: "<<unzip->GetNUnzip()<<" found: "<<unzip->GetNFound()<<" missed: "<<unzip->GetNMissed()<<"\n";
+      }
+    }
+  }
+}
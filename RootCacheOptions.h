@@ -0,0 +1,40 @@
+#if !defined(RootCacheOptions_h)
+#define RootCacheOptions_h
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+class TBranch;
+class TFile;
+class TTree;
+
+namespace cce::tf {
+  struct RootCacheOptions {
+    //size of the TTreeCache in bytes, 0 keeps ROOT's default
+    std::size_t cacheSize_ = 0;
+    //number of entries used to learn which branches are read,
+    // 0 means all the read branches are added to the cache up front
+    unsigned int learnEntries_ = 0;
+    //use ROOT's asynchronous prefetching of the cache
+    bool prefetch_ = false;
+    //decompress the baskets held by the cache in ROOT IMT tasks
+    bool parallelUnzip_ = false;
+
+    bool configured() const { return cacheSize_ != 0 or learnEntries_ != 0 or parallelUnzip_; }
+  };
+
+  //prefetching only takes effect if set before the file is opened
+  TFile* openFileForCache(std::string const& iName, RootCacheOptions const&);
+
+  //iBranches are added to the cache unless the cache is to learn which branches are read
+  void configureCache(TTree&, std::vector<TBranch*> const& iBranches, RootCacheOptions const&);
+
+  //Limits an already configured cache to iBranches, e.g. once the branches the job uses are
+  // known. A cache which learns the branches read is left as is.
+  void restrictCache(TTree&, std::vector<TBranch*> const& iBranches, RootCacheOptions const&);
+
+  //prints the bytes read from the file and how well the TTreeCache of the TTree did
+  void printCacheSummary(TFile&, TTree*);
+}
+#endif
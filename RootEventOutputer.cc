@@ -2,28 +2,42 @@
 #include "OutputerFactory.h"
 #include "ConfigurationParameters.h"
 #include "UnrolledSerializerWrapper.h"
+#include "FixedLayoutSerializerWrapper.h"
 #include "SerializerWrapper.h"
 #include "summarize_serializers.h"
+#include "summarize_queue.h"
+#include "FunctorTask.h"
+#include "RootIMT.h"
+#include "tbb/task_arena.h"
 #include "lz4.h"
 #include "zstd.h"
 #include <iostream>
 #include <cstring>
 #include <set>
+#include <memory>
+#include <algorithm>
 
 using namespace cce::tf;
 using namespace cce::tf::pds;
 
 RootEventOutputer::RootEventOutputer(std::string const& iFileName, unsigned int iNLanes, Compression iCompression, int iCompressionLevel, 
                                      Serialization iSerialization, int autoFlush, int maxVirtualSize,
-                                     std::string const& iTFileCompression, int iTFileCompressionLevel): 
+                                     std::string const& iTFileCompression, int iTFileCompressionLevel, std::size_t iCompressionChunkSize,
+                                     bool iOrderedOutput, unsigned int iOrderedOutputWindow): 
   file_(iFileName.c_str(), "recreate", "", iTFileCompressionLevel),
   serializers_{std::size_t(iNLanes)},
+  compressionContexts_{std::size_t(iNLanes)},
+  chunkCompressionContexts_{std::size_t(iNLanes)},
   compression_{iCompression},
   compressionLevel_{iCompressionLevel},
+  compressionChunkSize_{iCompressionChunkSize},
   serialization_{iSerialization},
   serialTime_{std::chrono::microseconds::zero()},
-  parallelTime_{0}
+  parallelTime_{iNLanes}
   {
+  if(iOrderedOutput) {
+    reorderBuffer_.emplace(iOrderedOutputWindow);
+  }
 
   if(not iTFileCompression.empty()) {
     if(iTFileCompression == "ZLIB") {
@@ -49,6 +63,7 @@ RootEventOutputer::RootEventOutputer(std::string const& iFileName, unsigned int
 
     //Turn off auto save
     eventsTree_->SetAutoSave(std::numeric_limits<Long64_t>::max());
+    eventsTree_->SetImplicitMT(rootIMTForOutputers());
     if(-1 != autoFlush) {
       eventsTree_->SetAutoFlush(autoFlush);
     }
@@ -69,6 +84,10 @@ void RootEventOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataPr
     {   s = SerializeStrategy::make<SerializeProxy<SerializerWrapper>>(); break; }
   case Serialization::kRootUnrolled:
     {   s = SerializeStrategy::make<SerializeProxy<UnrolledSerializerWrapper>>(); break; }
+  case Serialization::kNativeUnrolled:
+    {   s = SerializeStrategy::make<SerializeProxy<NativeUnrolledSerializerWrapper>>(); break; }
+  case Serialization::kFixedLayout:
+    {   s = SerializeStrategy::make<SerializeProxy<FixedLayoutSerializerWrapper>>(); break; }
   }
   s.reserve(iDPs.size());
   offsetsAndBlob_.first.resize(iDPs.size()+1,0);
@@ -84,41 +103,140 @@ void RootEventOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataPr
 
 void RootEventOutputer::productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const {
   auto& laneSerializers = serializers_[iLaneIndex];
-  auto group = iCallback.group();
-  laneSerializers[iDataProduct.index()].doWorkAsync(*group, iDataProduct.address(), std::move(iCallback));
+  serializeOrPassThroughAsync(laneSerializers[iDataProduct.index()], iDataProduct, serialization_, std::move(iCallback), 0);
 }
 
-void RootEventOutputer::outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+void RootEventOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
   auto start = std::chrono::high_resolution_clock::now();
   auto [offsets, buffer] = writeDataProductsToOutputBuffer(serializers_[iLaneIndex]);
-  queue_.push(*iCallback.group(), [this, iEventID, iLaneIndex, callback=std::move(iCallback), buffer = std::move(buffer), offsets = std::move(offsets)]() mutable {
+  if(compressionChunkSize_ != 0 and buffer.size() > compressionChunkSize_) {
+    compressChunksAsync(iLaneIndex, iEventIndex, iEventID, std::move(offsets), std::move(buffer), std::move(iCallback));
+  } else {
+    auto cBuffer = compressBuffer(buffer, compressionContexts_[iLaneIndex]);
+    queueOutput(iLaneIndex, iEventIndex, iEventID, std::move(offsets), std::move(cBuffer), std::move(iCallback));
+  }
+  auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+  parallelTime_.add(iLaneIndex, time.count());
+}
+
+void RootEventOutputer::queueOutput(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, std::vector<uint32_t> iOffsets, std::vector<char> iBuffer, TaskHolder iCallback) const {
+  auto group = iCallback.group();
+  queue_.push(*group, [this, iEventIndex, iEventID, iLaneIndex, callback=std::move(iCallback), buffer = std::move(iBuffer), offsets = std::move(iOffsets)]() mutable {
       auto start = std::chrono::high_resolution_clock::now();
+      if(reorderBuffer_) {
+        const_cast<RootEventOutputer*>(this)->outputInOrder(iEventIndex, {iEventID, iLaneIndex, std::move(buffer), std::move(offsets), {}}, std::move(callback));
+        serialTime_ += std::chrono::duration_cast<decltype(serialTime_)>(std::chrono::high_resolution_clock::now() - start);
+        return;
+      }
       const_cast<RootEventOutputer*>(this)->output(iEventID, serializers_[iLaneIndex],std::move(buffer), std::move(offsets));
         serialTime_ += std::chrono::duration_cast<decltype(serialTime_)>(std::chrono::high_resolution_clock::now() - start);
       callback.doneWaiting();
     });
-    auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
-    parallelTime_ += time.count();
 }
 
-void RootEventOutputer::printSummary() const  {
-  std::cout <<"RootEventOutputer\n  total serial time at end event: "<<serialTime_.count()<<"us\n"
-    "  total parallel time at end event: "<<parallelTime_.load()<<"us\n";
+void RootEventOutputer::compressChunksAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, std::vector<uint32_t> iOffsets, std::vector<char> iBuffer, TaskHolder iCallback) const {
+  auto const nChunks = (iBuffer.size() + compressionChunkSize_ - 1)/compressionChunkSize_;
+  //a lane only has one event being output at a time
+  auto& contexts = chunkCompressionContexts_[iLaneIndex];
+  if(contexts.size() < nChunks) {
+    contexts.resize(nChunks);
+  }
+  auto buffer = std::make_shared<std::vector<char>>(std::move(iBuffer));
+  auto chunks = std::make_shared<std::vector<std::vector<char>>>(nChunks);
 
+  auto group = iCallback.group();
+  //ZSTD decompresses concatenated frames as one buffer so the reader is unchanged
+  TaskHolder chunksDone(*group, make_functor_task([this, iLaneIndex, iEventIndex, iEventID, chunks, offsets = std::move(iOffsets), callback = std::move(iCallback)]() mutable {
+        std::size_t size = 0;
+        for(auto const& c: *chunks) {
+          size += c.size();
+        }
+        std::vector<char> cBuffer;
+        cBuffer.reserve(size);
+        for(auto const& c: *chunks) {
+          cBuffer.insert(cBuffer.end(), c.begin(), c.end());
+        }
+        queueOutput(iLaneIndex, iEventIndex, iEventID, std::move(offsets), std::move(cBuffer), std::move(callback));
+      }));
+
+  auto compressChunk = [this, buffer, chunks, &contexts](std::size_t iChunk) {
+    auto const begin = iChunk*compressionChunkSize_;
+    auto const size = std::min(compressionChunkSize_, buffer->size() - begin);
+    (*chunks)[iChunk] = pds::compressBuffer(0, 0, compression_, compressionLevel_, BlobView(buffer->data()+begin, size), contexts[iChunk]);
+  };
+  for(std::size_t i = 1; i < nChunks; ++i) {
+    group->run([compressChunk, i, holder = chunksDone]() { compressChunk(i); });
+  }
+  compressChunk(0);
+}
+
+void RootEventOutputer::outputInOrder(long iEventIndex, OrderedEvent iEvent, TaskHolder iCallback) {
+  if(not reorderBuffer_->isNext(iEventIndex) and reorderBuffer_->isFull()) {
+    //iCallback is released once the event is written
+    iEvent.waitingLane_.emplace(std::move(iCallback));
+  }
+  reorderBuffer_->push(iEventIndex, std::move(iEvent), [this](OrderedEvent iEvent) { outputOrdered(iEvent); });
+}
+
+void RootEventOutputer::outputOrdered(OrderedEvent& iEvent) {
+  output(iEvent.eventID_, serializers_[iEvent.laneIndex_], std::move(iEvent.buffer_), std::move(iEvent.offsets_));
+}
+
+void RootEventOutputer::setFirstEventIndex(long iEventIndex) {
+  if(reorderBuffer_) {
+    reorderBuffer_->setFirstEventIndex(iEventIndex);
+  }
+}
+
+void RootEventOutputer::finishAsync(TaskHolder iCallback) const {
+  auto group = iCallback.group();
+  queue_.push(*group, [this, iCallback=std::move(iCallback)]() { finish(); });
+}
+
+void RootEventOutputer::finish() const {
+  if(finished_) {
+    return;
+  }
+  finished_ = true;
   auto start = std::chrono::high_resolution_clock::now();
+  if(reorderBuffer_) {
+    //all lanes are done so any events still held can be written
+    auto nonConstThis = const_cast<RootEventOutputer*>(this);
+    nonConstThis->reorderBuffer_->flush([nonConstThis](OrderedEvent iEvent) { nonConstThis->outputOrdered(iEvent); });
+  }
+  heldEventsTime_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+
+  start = std::chrono::high_resolution_clock::now();
   file_.Write();
-  auto writeTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+  writeTime_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
 
   start = std::chrono::high_resolution_clock::now();
   file_.Close();
-  auto closeTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+  closeTime_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+}
 
-  std::cout << "  end of job file write time: "<<writeTime.count()<<"us\n";
-  std::cout << "  end of job file close time: "<<closeTime.count()<<"us\n";
+void RootEventOutputer::printSummary() const  {
+  finish();
+  std::cout <<"RootEventOutputer\n  total serial time at end event: "<<serialTime_.count()<<"us\n"
+    "  total parallel time at end event: "<<parallelTime_.sum()<<"us\n";
+  if(reorderBuffer_) {
+    std::cout <<"  most events held for ordering: "<<reorderBuffer_->maxHeldReached()<<"\n";
+    std::cout <<"  end of job time writing held events: "<<heldEventsTime_.count()<<"us\n";
+  }
+  if(auto bytes = passedThroughBytes(serializers_); bytes != 0) {
+    std::cout <<"  serialized bytes passed through from the Source: "<<bytes<<"\n";
+  }
+  std::cout << "  end of job file write time: "<<writeTime_.count()<<"us\n";
+  std::cout << "  end of job file close time: "<<closeTime_.count()<<"us\n";
                                                                                          
+  summarize_queue("write", queue_);
   summarize_serializers(serializers_);
 }
 
+void RootEventOutputer::fillProfile(ProductProfile& oProfile) const {
+  profile_serializers(oProfile, serializers_);
+}
+
 
 
 void RootEventOutputer::output(EventIdentifier const& iEventID, SerializeStrategy const& iSerializers, std::vector<char> iBuffer, std::vector<uint32_t> iOffsets) {
@@ -134,7 +252,9 @@ void RootEventOutputer::output(EventIdentifier const& iEventID, SerializeStrateg
   //for(auto b: eventBlob_) {
   //  std::cout <<"   "<<b<<std::endl;
   //}
-  eventsTree_->Fill();
+  TaskHolder::WaitScope waitScope;
+  //isolated so a thread waiting on ROOT's IMT tasks does not take up a Lane's task
+  tbb::this_task_arena::isolate([this] { eventsTree_->Fill(); });
   /*
     for(auto& s: iSerializers) {
     std::cout<<"   "s+s.name()+" size "+std::to_string(s.blob().size())+"\n" <<std::flush;
@@ -190,15 +310,11 @@ std::pair<std::vector<uint32_t>, std::vector<char>> RootEventOutputer::writeData
     assert(buffer.size() == offsets[index]);
   }
 
-  auto cBuffer  = compressBuffer(buffer);
-
-  //std::cout <<"compressed "<<cSize<<" uncompressed "<<buffer.size()<<std::endl;
-  //std::cout <<"compressed "<<(buffer.size())/float(cSize)<<std::endl;
-  return {offsets,cBuffer};
+  return {std::move(offsets), std::move(buffer)};
 }
 
-std::vector<char> RootEventOutputer::compressBuffer(std::vector<char> const& iBuffer) const {
-  return pds::compressBuffer(0, 0, compression_, compressionLevel_, iBuffer);
+std::vector<char> RootEventOutputer::compressBuffer(std::vector<char> const& iBuffer, pds::CompressionContext& iContext) const {
+  return pds::compressBuffer(0, 0, compression_, compressionLevel_, iBuffer, iContext);
 }
 
 namespace {
@@ -237,8 +353,18 @@ namespace {
 
       auto fileLevelCompression = params.get<std::string>("tfileCompressionAlgorithm", "");
       auto fileLevelCompressionLevel = params.get<int>("tfileCompressionLevel",0);
+
+      auto compressionChunkSize = params.get<std::size_t>("compressionChunkSize", 0);
+      if(compressionChunkSize != 0 and not pds::isZSTD(*compression)) {
+        std::cout <<"compressionChunkSize can only be used with ZSTD compression"<<std::endl;
+        return {};
+      }
+      
+      bool orderedOutput = params.get<bool>("orderedOutput", false);
+      auto orderedOutputWindow = params.get<unsigned int>("orderedOutputWindow", 64);
       
-      return std::make_unique<RootEventOutputer>(*fileName,iNLanes, *compression, compressionLevel, *serialization, autoFlush, treeMaxVirtualSize, fileLevelCompression, fileLevelCompressionLevel);
+      return std::make_unique<RootEventOutputer>(*fileName,iNLanes, *compression, compressionLevel, *serialization, autoFlush, treeMaxVirtualSize, fileLevelCompression, fileLevelCompressionLevel, compressionChunkSize,
+                                                 orderedOutput, orderedOutputWindow);
     }
     
   };
@@ -4,6 +4,7 @@
 #include <vector>
 #include <string>
 #include <cstdint>
+#include <optional>
 #include "TFile.h"
 #include "TTree.h"
 #include "TBranch.h"
@@ -15,13 +16,16 @@
 #include "pds_writer.h"
 
 #include "SerialTaskQueue.h"
+#include "PerLaneCounter.h"
+#include "EventReorderBuffer.h"
 
 namespace cce::tf {
 class RootEventOutputer :public OutputerBase {
  public:
   RootEventOutputer(std::string const& iFileName, unsigned int iNLanes, pds::Compression iCompression, int iCompressionLevel, 
                     pds::Serialization iSerialization, int autoFlush, int maxVirtualSize,
-                    std::string const& iTFileCompression, int iTFileCompressionLevel);
+                    std::string const& iTFileCompression, int iTFileCompressionLevel, std::size_t iCompressionChunkSize = 0,
+                    bool iOrderedOutput = false, unsigned int iOrderedOutputWindow = 0);
  ~RootEventOutputer();
 
   void setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) final;
@@ -29,17 +33,37 @@ class RootEventOutputer :public OutputerBase {
   void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const final;
   bool usesProductReadyAsync() const final {return true;}
 
-  void outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+  void setFirstEventIndex(long iEventIndex) final;
   
+  void finishAsync(TaskHolder iCallback) const final;
   void printSummary() const final;
+  void fillProfile(ProductProfile&) const final;
 
  private:
+  struct OrderedEvent {
+    EventIdentifier eventID_;
+    unsigned int laneIndex_;
+    std::vector<char> buffer_;
+    std::vector<uint32_t> offsets_;
+    //set when the Lane must wait for the event to be written
+    std::optional<TaskHolder> waitingLane_;
+  };
+  void outputInOrder(long iEventIndex, OrderedEvent iEvent, TaskHolder iCallback);
+  void outputOrdered(OrderedEvent& iEvent);
+  //writes the events still held, then writes and closes the file. Only the first call does anything
+  void finish() const;
+
   void output(EventIdentifier const& iEventID, SerializeStrategy const& iSerializers, std::vector<char>  iBuffer, std::vector<uint32_t> iOffset);
   void writeMetaData(SerializeStrategy const& iSerializers);
 
+  //the returned buffer is not yet compressed
   std::pair<std::vector<uint32_t>,std::vector<char>> writeDataProductsToOutputBuffer(SerializeStrategy const& iSerializers) const;
 
-  std::vector<char> compressBuffer(std::vector<char> const& iBuffer) const;
+  std::vector<char> compressBuffer(std::vector<char> const& iBuffer, pds::CompressionContext&) const;
+  //compresses pieces of iBuffer as separate ZSTD frames in parallel tasks before calling queueOutput
+  void compressChunksAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, std::vector<uint32_t> iOffsets, std::vector<char> iBuffer, TaskHolder iCallback) const;
+  void queueOutput(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, std::vector<uint32_t> iOffsets, std::vector<char> iBuffer, TaskHolder iCallback) const;
 
 private:
   mutable TFile file_;
@@ -48,13 +72,24 @@ private:
 
   mutable SerialTaskQueue queue_;
   mutable std::vector<SerializeStrategy> serializers_;
+  //one per lane so the compression state does not need to be remade for each event
+  mutable std::vector<pds::CompressionContext> compressionContexts_;
+  //per lane, one for each chunk of an event compressed in parallel
+  mutable std::vector<std::vector<pds::CompressionContext>> chunkCompressionContexts_;
   mutable std::pair<std::vector<uint32_t>, std::vector<char>> offsetsAndBlob_;
+  //when set, events are written in the order of their event index
+  std::optional<EventReorderBuffer<OrderedEvent>> reorderBuffer_;
   EventIdentifier eventID_;
   pds::Compression compression_;
   int compressionLevel_;
+  std::size_t compressionChunkSize_;
   pds::Serialization serialization_;
   mutable std::chrono::microseconds serialTime_;
-  mutable std::atomic<std::chrono::microseconds::rep> parallelTime_;
+  mutable PerLaneCounter<std::chrono::microseconds::rep> parallelTime_;
+  mutable bool finished_ = false;
+  mutable std::chrono::microseconds heldEventsTime_{0};
+  mutable std::chrono::microseconds writeTime_{0};
+  mutable std::chrono::microseconds closeTime_{0};
 };
 }
 #endif
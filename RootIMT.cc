@@ -0,0 +1,47 @@
+#include "RootIMT.h"
+
+#include "TROOT.h"
+
+namespace cce::tf {
+  namespace {
+    IMTScope s_scope = IMTScope::kAll;
+  }
+
+  std::optional<IMTScope> toIMTScope(std::string const& iName) {
+    if(iName == "all") {
+      return IMTScope::kAll;
+    }
+    if(iName == "sources") {
+      return IMTScope::kSources;
+    }
+    if(iName == "outputers") {
+      return IMTScope::kOutputers;
+    }
+    return {};
+  }
+
+  std::string name(IMTScope iScope) {
+    switch(iScope) {
+    case IMTScope::kAll:
+      return "all";
+    case IMTScope::kSources:
+      return "sources";
+    case IMTScope::kOutputers:
+      return "outputers";
+    }
+    return "";
+  }
+
+  void enableRootIMT(int iParallelism, IMTScope iScope) {
+    s_scope = iScope;
+    ROOT::EnableImplicitMT(iParallelism);
+  }
+
+  bool rootIMTForSources() {
+    return ROOT::IsImplicitMTEnabled() and s_scope != IMTScope::kOutputers;
+  }
+
+  bool rootIMTForOutputers() {
+    return ROOT::IsImplicitMTEnabled() and s_scope != IMTScope::kSources;
+  }
+}
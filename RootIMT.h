@@ -0,0 +1,57 @@
+#if !defined(RootIMT_h)
+#define RootIMT_h
+
+#include <atomic>
+#include <optional>
+#include <string>
+
+#include "tbb/task_arena.h"
+#include "tbb/task_scheduler_observer.h"
+
+namespace cce::tf {
+  //which components have ROOT use its implicit multi-threading (IMT)
+  enum class IMTScope {
+    kAll,
+    //only the Sources, e.g. for parallel unzipping of baskets
+    kSources,
+    //only the Outputers, e.g. for compressing the baskets of the branches in parallel
+    kOutputers
+  };
+  std::optional<IMTScope> toIMTScope(std::string const& iName);
+  std::string name(IMTScope);
+
+  //Turns on ROOT's IMT with iParallelism threads. ROOT runs its tasks in a
+  // task arena of its own but takes the threads from the same TBB pool as the
+  // task arenas of the Lanes so the job never uses more than the
+  // max_allowed_parallelism threads.
+  void enableRootIMT(int iParallelism, IMTScope iScope);
+
+  //if IMT is enabled and the Sources, or Outputers, are to use it. Components
+  // call TTree::SetImplicitMT or set the RNTuple options with these.
+  bool rootIMTForSources();
+  bool rootIMTForOutputers();
+
+  /**
+     Counts the TBB worker threads which join a task arena. Made without an
+     arena it sees all the arenas of the job, made with one only that arena.
+     The joins seen by the one without an arena less those of the harness
+     arenas are the times a worker went to run the tasks of ROOT's IMT arena.
+   */
+  class ArenaJoinCounter : public tbb::task_scheduler_observer {
+  public:
+    ArenaJoinCounter() { observe(true); }
+    explicit ArenaJoinCounter(tbb::task_arena& iArena): tbb::task_scheduler_observer(iArena) { observe(true); }
+    ~ArenaJoinCounter() { observe(false); }
+
+    void on_scheduler_entry(bool iIsWorker) final {
+      if(iIsWorker) {
+        joins_.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    unsigned long long joins() const { return joins_.load(); }
+
+  private:
+    std::atomic<unsigned long long> joins_{0};
+  };
+}
+#endif
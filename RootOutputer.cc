@@ -2,13 +2,17 @@
 
 #include "RootOutputer.h"
 #include "RootOutputerConfig.h"
+#include "TBufferMergerRootOutputer.h"
 #include "OutputerFactory.h"
+#include "summarize_queue.h"
 
 #include "TTree.h"
 #include "TBranch.h"
+#include "TLeaf.h"
 #include "TROOT.h"
 #include "TFileCacheWrite.h"
 
+#include "RootIMT.h"
 #include "tbb/task_arena.h"
 
 using namespace cce::tf;
@@ -19,7 +23,8 @@ RootOutputer::RootOutputer(std::string const& iFileName, unsigned int iNLanes, C
   retrievers_{std::size_t(iNLanes)},
   accumulatedTime_(std::chrono::microseconds::zero()),
   basketSize_{iConfig.basketSize_},
-  splitLevel_{iConfig.splitLevel_}
+  splitLevel_{iConfig.splitLevel_},
+  basketMemoryLimit_{iConfig.basketMemoryLimit_}
 {
   if(iConfig.cacheSize_ > 0 ) { 
      new TFileCacheWrite(&file_, iConfig.cacheSize_);
@@ -41,6 +46,7 @@ RootOutputer::RootOutputer(std::string const& iFileName, unsigned int iNLanes, C
 
   //Turn off auto save
   eventTree_->SetAutoSave(std::numeric_limits<Long64_t>::max());
+  eventTree_->SetImplicitMT(rootIMTForOutputers());
   if(-1 != iConfig.autoFlush_) {
     eventTree_->SetAutoFlush(iConfig.autoFlush_);
   }
@@ -74,7 +80,7 @@ void RootOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataProduct
 void RootOutputer::productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const {
 }
 
-void RootOutputer::outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+void RootOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
   auto group = iCallback.group();
   queue_.push(*group, [this, iLaneIndex, callback=std::move(iCallback), iEventID]() mutable {
       const_cast<RootOutputer*>(this)->write(iLaneIndex, iEventID);
@@ -95,25 +101,105 @@ void RootOutputer::write(unsigned int iLaneIndex, EventIdentifier const& iEventI
   }
   id_ = iEventID;
 
+  TaskHolder::WaitScope waitScope;
   // Isolate the fill operation so that IMT doesn't grab other large tasks
   // that could lead to stalling
   tbb::this_task_arena::isolate([&] { eventTree_->Fill(); });
 
+  //ROOT sets the number of entries of a cluster once the first one was written
+  if(basketMemoryLimit_ != 0 and not basketsOptimized_ and eventTree_->GetAutoFlush() > 0
+     and eventTree_->GetEntries() >= eventTree_->GetAutoFlush()) {
+    optimizeBaskets();
+  }
+
   accumulatedTime_ += std::chrono::duration_cast<decltype(accumulatedTime_)>(std::chrono::high_resolution_clock::now() - start);
 }
   
-void RootOutputer::printSummary() const {
+void RootOutputer::optimizeBaskets() {
+  basketsOptimized_ = true;
+  auto leaves = eventTree_->GetListOfLeaves();
+  branchBaskets_.reserve(leaves->GetEntriesFast());
+  for(int i=0; i< leaves->GetEntriesFast(); ++i) {
+    auto branch = static_cast<TLeaf*>((*leaves)[i])->GetBranch();
+    branchBaskets_.push_back({branch->GetName(), branch->GetBasketSize(), 0});
+  }
+  //the sizes are based on the bytes each branch used in the first cluster
+  eventTree_->OptimizeBaskets(basketMemoryLimit_, 1.1, "");
+  for(int i=0; i< leaves->GetEntriesFast(); ++i) {
+    branchBaskets_[i].optimizedSize_ = static_cast<TLeaf*>((*leaves)[i])->GetBranch()->GetBasketSize();
+  }
+}
+
+void RootOutputer::finishAsync(TaskHolder iCallback) const {
+  auto group = iCallback.group();
+  queue_.push(*group, [this, iCallback=std::move(iCallback)]() { finish(); });
+}
+
+void RootOutputer::finish() const {
+  if(finished_) {
+    return;
+  }
+  finished_ = true;
+  //each branch holding data fills its own basket
+  auto leaves = eventTree_->GetListOfLeaves();
+  for(int i=0; i< leaves->GetEntriesFast(); ++i) {
+    basketBytes_ += static_cast<TLeaf*>((*leaves)[i])->GetBranch()->GetBasketSize();
+  }
+
   auto start = std::chrono::high_resolution_clock::now();
   file_.Write();
-  auto writeTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+  writeTime_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+  //a reader needs one read per basket of each branch it reads
+  for(std::size_t i=0; i< branchBaskets_.size(); ++i) {
+    auto branch = static_cast<TLeaf*>((*leaves)[i])->GetBranch();
+    branchBaskets_[i].nBaskets_ = branch->GetWriteBasket();
+    branchBaskets_[i].zipBytes_ = branch->GetZipBytes();
+  }
 
   start = std::chrono::high_resolution_clock::now();
   file_.Close();
-  auto closeTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+  closeTime_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+}
+
+void RootOutputer::printSummary() const {
+  finish();
 
   std::cout <<"RootOutputer total time: "<<accumulatedTime_.count()<<"us\n";
-  std::cout << "  end of job file write time: "<<writeTime.count()<<"us\n";
-  std::cout << "  end of job file close time: "<<closeTime.count()<<"us\n";
+  std::cout << "  end of job file write time: "<<writeTime_.count()<<"us\n";
+  std::cout << "  end of job file close time: "<<closeTime_.count()<<"us\n";
+  std::cout << "  basket buffers: "<<basketBytes_<<" bytes\n";
+  if(basketMemoryLimit_ != 0) {
+    if(not basketsOptimized_) {
+      std::cout << "  baskets not optimized, the first cluster was not finished\n";
+    } else {
+      std::cout << "  optimized baskets with a memory limit of "<<basketMemoryLimit_<<" bytes\n"
+        "   branch: basket size before -> after, # baskets written, mean compressed basket bytes\n";
+      for(auto const& b: branchBaskets_) {
+        std::cout <<"   "<<b.name_<<": "<<b.initialSize_<<" -> "<<b.optimizedSize_<<", "<<b.nBaskets_<<", "
+                  <<(b.nBaskets_ == 0 ? 0 : b.zipBytes_/b.nBaskets_)<<"\n";
+      }
+    }
+  }
+  summarize_queue("write", queue_);
+}
+
+void RootOutputer::fillReport(RunReport& oReport) const {
+  oReport.set("time_us", accumulatedTime_.count());
+  oReport.set("endOfJobTime_us", (writeTime_+closeTime_).count());
+  oReport.set("basketBytes", basketBytes_);
+  if(basketsOptimized_) {
+    Long64_t nBaskets = 0;
+    for(auto const& b: branchBaskets_) {
+      nBaskets += b.nBaskets_;
+      auto& branch = oReport.section("branches").section(b.name_);
+      branch.set("initialBasketSize", b.initialSize_);
+      branch.set("optimizedBasketSize", b.optimizedSize_);
+      branch.set("basketsWritten", b.nBaskets_);
+      branch.set("zipBytes", b.zipBytes_);
+    }
+    oReport.set("basketsWritten", nBaskets);
+  }
+  report_queue(oReport, "write", queue_);
 }
 
 namespace {
@@ -125,7 +211,20 @@ namespace {
       if(not result) {
         return {};
       }
-      return std::make_unique<RootOutputer>(result->first,iNLanes, outputerConfig<RootOutputer::Config>(result->second));
+      if(params.get<bool>("concurrentFill", false)) {
+        if(result->second.basketMemoryLimit_ != 0) {
+          std::cout <<"basketMemoryLimit can not be used with concurrentFill"<<std::endl;
+          return {};
+        }
+        //Each lane streams and compresses its events into its own in-memory TTree. Only merging
+        // the finished baskets into the file is serialized.
+        auto config = outputerConfig<TBufferMergerRootOutputer::Config>(result->second);
+        config.concurrentWrite = true;
+        return std::make_unique<TBufferMergerRootOutputer>(result->first, iNLanes, config);
+      }
+      auto config = outputerConfig<RootOutputer::Config>(result->second);
+      config.basketMemoryLimit_ = result->second.basketMemoryLimit_;
+      return std::make_unique<RootOutputer>(result->first,iNLanes, config);
     }
     };
 
@@ -27,6 +27,7 @@ class RootOutputer :public OutputerBase {
     int treeMaxVirtualSize_=-1;
     int autoFlush_=-1;
     int cacheSize_=0;
+    std::size_t basketMemoryLimit_=0;
   };
 
   RootOutputer(std::string const& iFileName, unsigned int iNLanes, Config const&);
@@ -37,13 +38,19 @@ class RootOutputer :public OutputerBase {
   void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const final;
   bool usesProductReadyAsync() const final {return false;}
 
-  void outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
   
+  void finishAsync(TaskHolder iCallback) const final;
   void printSummary() const final;
+  void fillReport(RunReport&) const final;
 
 
 private:
   void write(unsigned int iLaneIndex, EventIdentifier const&);
+  //writes and closes the file, only the first call does anything
+  void finish() const;
+  //called once the first cluster is written
+  void optimizeBaskets();
   mutable TFile file_;
   TTree* eventTree_;
   std::vector<TBranch*> branches_;
@@ -54,6 +61,24 @@ private:
   std::chrono::microseconds accumulatedTime_;
   int basketSize_;
   int splitLevel_;
+  //found before the file is closed
+  mutable std::size_t basketBytes_ = 0;
+  mutable bool finished_ = false;
+  mutable std::chrono::microseconds writeTime_{0};
+  mutable std::chrono::microseconds closeTime_{0};
+
+  std::size_t basketMemoryLimit_;
+  bool basketsOptimized_ = false;
+  //for each branch holding data, filled when the baskets are optimized
+  struct BranchBaskets {
+    std::string name_;
+    int initialSize_;
+    int optimizedSize_;
+    //found before the file is closed
+    Long64_t nBaskets_ = 0;
+    Long64_t zipBytes_ = 0;
+  };
+  mutable std::vector<BranchBaskets> branchBaskets_;
 };
 }
 #endif
@@ -19,6 +19,7 @@ namespace cce::tf {
     config.treeMaxVirtualSize_ =  params.get<int>("treeMaxVirtualSize", config.treeMaxVirtualSize_);
     config.autoFlush_ = params.get<int>("autoFlush", config.autoFlush_);
     config.cacheSize_= params.get<int>("cacheSize", config.cacheSize_);
+    config.basketMemoryLimit_ = params.get<std::size_t>("basketMemoryLimit", config.basketMemoryLimit_);
     return std::make_pair(*fileName,config);
   }
 }
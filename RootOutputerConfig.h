@@ -3,6 +3,7 @@
 
 #include <string>
 #include <optional>
+#include <cstddef>
 #include <utility>
 
 namespace cce::tf {
@@ -14,6 +15,9 @@ namespace cce::tf {
     int treeMaxVirtualSize_=-1;
     int autoFlush_=-1;
     int cacheSize_=0;
+    //if not 0, the basket sizes are chosen by TTree::OptimizeBaskets with this memory limit
+    // in bytes once the first cluster was written
+    std::size_t basketMemoryLimit_=0;
   };
 
   template<typename T>
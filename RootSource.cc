@@ -7,14 +7,16 @@
 #include "TTree.h"
 #include "TFile.h"
 #include "TClass.h"
+#include "RootIMT.h"
 
 using namespace cce::tf;
 
-RootSource::RootSource(std::string const& iName) :
+RootSource::RootSource(std::string const& iName, ProductSelector const& iSelector) :
   file_{TFile::Open(iName.c_str())},
   eventAuxReader_{*file_}
 {
   events_ = file_->Get<TTree>("Events");
+  events_->SetImplicitMT(rootIMTForSources());
   auto l = events_->GetListOfBranches();
 
   const std::string eventAuxiliaryBranchName{"EventAuxiliary"}; 
@@ -33,6 +35,14 @@ RootSource::RootSource(std::string const& iName) :
       continue;
     }
     b->SetupAddresses();
+    if(not iSelector.keep(b->GetName())) {
+      if(eventAuxiliaryBranchName == b->GetName()) {
+        //still needed for the event identifier
+        eventAuxBranch_ = b;
+        readEventAuxSeparately_ = true;
+      }
+      continue;
+    }
     TClass* class_ptr=nullptr;
     EDataType type;
     b->GetExpectedType(class_ptr,type);
@@ -56,15 +66,32 @@ EventIdentifier RootSource::eventIdentifier() {
   return eventAuxReader_.doWork(eventAuxBranch_);
 }
 
-long RootSource::numberOfEvents() { 
+std::optional<long> RootSource::numberOfEvents() const {
   return events_->GetEntriesFast();
 }
 
+std::vector<std::pair<long, long>> RootSource::clusters() const {
+  std::vector<std::pair<long, long>> ranges;
+  auto const nEntries = events_->GetEntries();
+  auto it = events_->GetClusterIterator(0);
+  Long64_t first;
+  while( (first = it.Next()) < nEntries) {
+    ranges.emplace_back(first, it.GetNextEntry());
+  }
+  return ranges;
+}
+
+void RootSource::setCacheEntryRange(long iFirst, long iEnd) {
+  events_->SetCacheEntryRange(iFirst, iEnd-1);
+}
+
 bool RootSource::readEvent(long iEventIndex) {
-  if(iEventIndex<numberOfEvents()) {
+  if(iEventIndex<*numberOfEvents()) {
     if(eventIDBranch_) {
       eventIDBranch_->SetAddress(&id_);
       eventIDBranch_->GetEntry(iEventIndex);
+    } else if(readEventAuxSeparately_) {
+      eventAuxBranch_->GetEntry(iEventIndex);
     }
 
     auto it = dataProducts_.begin();
@@ -86,7 +113,8 @@ namespace {
           std::cout <<"no file name given\n";
           return {};
         }
-        return std::make_unique<ReplicatedSharedSource<RootSource>>(iNLanes, iNEvents, *fileName);
+        ProductSelector selector{params.get<std::string>("products", "")};
+        return makeReplicatedSource<RootSource>(iNLanes, iNEvents, params, *fileName, selector);
     }
     };
 
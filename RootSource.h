@@ -5,10 +5,12 @@
 #include <memory>
 #include <optional>
 #include <vector>
+#include <utility>
 
 #include "DataProductRetriever.h"
 #include "DelayedProductRetriever.h"
 #include "EventAuxReader.h"
+#include "ProductSelector.h"
 
 #include "SourceBase.h"
 #include "TFile.h"
@@ -23,7 +25,7 @@ class RootDelayedRetriever : public DelayedProductRetriever {
 
 class RootSource : public SourceBase {
 public:
-  RootSource(std::string const& iName);
+  RootSource(std::string const& iName, ProductSelector const& iSelector = ProductSelector());
   RootSource(RootSource&&) = default;
   RootSource(RootSource const&) = default;
 
@@ -33,15 +35,22 @@ public:
 
   bool readEvent(long iEventIndex) final;
 
-private:
-  long numberOfEvents();
+  //[first, end) of the entries in each cluster of the Events TTree
+  std::vector<std::pair<long, long>> clusters() const;
+  //the TTreeCache only reads entries in [iFirst, iEnd)
+  void setCacheEntryRange(long iFirst, long iEnd);
+
+  std::optional<long> numberOfEvents() const final;
 
+private:
   std::unique_ptr<TFile> file_;
   TTree* events_;
   RootDelayedRetriever delayedReader_;
   EventAuxReader eventAuxReader_;
   TBranch* eventIDBranch_ = nullptr;
   TBranch* eventAuxBranch_ = nullptr;
+  //set if EventAuxiliary is not one of the selected data products
+  bool readEventAuxSeparately_ = false;
   EventIdentifier id_;
   std::vector<DataProductRetriever> dataProducts_;
   std::vector<TBranch*> branches_;
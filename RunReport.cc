@@ -0,0 +1,138 @@
+#include "RunReport.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+namespace cce::tf {
+
+  RunReport::Entry& RunReport::entry(std::string_view iKey) {
+    for(auto& e: entries_) {
+      if(e.key_ == iKey) {
+        return e;
+      }
+    }
+    entries_.push_back({std::string(iKey), std::string(), {}});
+    return entries_.back();
+  }
+
+  RunReport& RunReport::section(std::string_view iKey) {
+    auto& e = entry(iKey);
+    if(not e.section_) {
+      e.literal_.clear();
+      e.section_ = std::make_unique<RunReport>();
+    }
+    return *e.section_;
+  }
+
+  void RunReport::setLiteral(std::string_view iKey, std::string iLiteral) {
+    auto& e = entry(iKey);
+    e.section_.reset();
+    e.literal_ = std::move(iLiteral);
+  }
+
+  namespace {
+    void writeNumber(std::ostream& oStream, double iValue) {
+      //JSON has no representation for these
+      if(not std::isfinite(iValue)) {
+        oStream <<"null";
+        return;
+      }
+      oStream << iValue;
+    }
+  }
+
+  void RunReport::setNumber(std::string_view iKey, double iValue) {
+    std::ostringstream s;
+    s.precision(15);
+    writeNumber(s, iValue);
+    setLiteral(iKey, s.str());
+  }
+
+  void RunReport::set(std::string_view iKey, std::vector<double> const& iValues) {
+    std::ostringstream s;
+    s.precision(15);
+    s <<"[";
+    for(std::size_t i = 0; i < iValues.size(); ++i) {
+      if(i != 0) {
+        s <<", ";
+      }
+      writeNumber(s, iValues[i]);
+    }
+    s <<"]";
+    setLiteral(iKey, s.str());
+  }
+
+  void RunReport::setString(std::string_view iKey, std::string_view iValue) {
+    setLiteral(iKey, jsonString(iValue));
+  }
+
+  std::vector<std::pair<std::string, double>> RunReport::numbers() const {
+    std::vector<std::pair<std::string, double>> values;
+    for(auto const& e: entries_) {
+      if(e.section_) {
+        for(auto& [key, value]: e.section_->numbers()) {
+          values.emplace_back(e.key_+"."+key, value);
+        }
+        continue;
+      }
+      char const* begin = e.literal_.c_str();
+      char* end = nullptr;
+      double value = std::strtod(begin, &end);
+      //strings, arrays, booleans and null are skipped
+      if(end != begin and *end == '\0' and begin[0] != '"') {
+        values.emplace_back(e.key_, value);
+      }
+    }
+    return values;
+  }
+
+  void RunReport::write(std::ostream& oStream, unsigned int iIndent) const {
+    if(entries_.empty()) {
+      oStream <<"{}";
+      return;
+    }
+    std::string const indent(iIndent+2, ' ');
+    oStream <<"{\n";
+    bool first = true;
+    for(auto const& e: entries_) {
+      if(not first) {
+        oStream <<",\n";
+      }
+      first = false;
+      oStream <<indent<<jsonString(e.key_)<<": ";
+      if(e.section_) {
+        e.section_->write(oStream, iIndent+2);
+      } else {
+        oStream <<e.literal_;
+      }
+    }
+    oStream <<"\n"<<std::string(iIndent, ' ')<<"}";
+  }
+
+  std::string jsonString(std::string_view iValue) {
+    std::string quoted;
+    quoted.reserve(iValue.size()+2);
+    quoted.push_back('"');
+    for(char c: iValue) {
+      switch(c) {
+      case '"': quoted += "\\\""; break;
+      case '\\': quoted += "\\\\"; break;
+      case '\n': quoted += "\\n"; break;
+      case '\t': quoted += "\\t"; break;
+      case '\r': quoted += "\\r"; break;
+      default:
+        if(static_cast<unsigned char>(c) < 0x20) {
+          char buffer[8];
+          std::snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned int>(static_cast<unsigned char>(c)));
+          quoted += buffer;
+        } else {
+          quoted.push_back(c);
+        }
+      }
+    }
+    quoted.push_back('"');
+    return quoted;
+  }
+}
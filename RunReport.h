@@ -0,0 +1,66 @@
+#if !defined(RunReport_h)
+#define RunReport_h
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cce::tf {
+  /**
+     Machine readable summary of a job, written as a JSON object. Values are
+     kept in the order they were first set and setting a key again replaces
+     its value. A section is a nested RunReport.
+       e.g. report.section("source").set("readTime_us", 1234);
+   */
+  class RunReport {
+  public:
+    template<typename T>
+    void set(std::string_view iKey, T iValue) {
+      if constexpr (std::is_same_v<T, bool>) {
+        setLiteral(iKey, iValue ? "true" : "false");
+      } else if constexpr (std::is_integral_v<T>) {
+        setLiteral(iKey, std::to_string(iValue));
+      } else if constexpr (std::is_floating_point_v<T>) {
+        setNumber(iKey, iValue);
+      } else {
+        setString(iKey, iValue);
+      }
+    }
+
+    //written as a JSON array
+    void set(std::string_view iKey, std::vector<double> const& iValues);
+
+    //returns the already existing section if there is one
+    RunReport& section(std::string_view iKey);
+
+    bool empty() const { return entries_.empty(); }
+
+    //the entries holding one number, including those of the sections whose
+    // keys are prefixed by the section keys and '.', e.g. "source.readTime_us"
+    std::vector<std::pair<std::string, double>> numbers() const;
+
+    void write(std::ostream&, unsigned int iIndent = 0) const;
+
+  private:
+    struct Entry {
+      std::string key_;
+      //JSON text of the value, unused for a section
+      std::string literal_;
+      std::unique_ptr<RunReport> section_;
+    };
+    Entry& entry(std::string_view iKey);
+    void setLiteral(std::string_view iKey, std::string iLiteral);
+    void setNumber(std::string_view iKey, double iValue);
+    void setString(std::string_view iKey, std::string_view iValue);
+
+    std::vector<Entry> entries_;
+  };
+
+  //quotes and escapes iValue as a JSON string
+  std::string jsonString(std::string_view iValue);
+}
+#endif
@@ -1,23 +1,34 @@
 
 #include <vector>
 #include <thread>
+#include <memory>
 #include "EventIdentifier.h"
 #include "DataProductRetriever.h"
 #include "TaskHolder.h"
 #include "WaiterBase.h"
 #include "WaiterFactory.h"
+#include "WaiterTimer.h"
 
 
 namespace cce::tf {
   class ScaleWaiter : public WaiterBase {
  public:
 
- ScaleWaiter(double iScaleFactor):
-  scale_{iScaleFactor} {}
+ ScaleWaiter(double iScaleFactor, bool iAsyncSleep):
+  scale_{iScaleFactor} {
+    if(iAsyncSleep) {
+      timer_ = std::make_unique<WaiterTimer>();
+    }
+  }
 
     void waitAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, long iEventIndex,
                    std::vector<DataProductRetriever> const& iRetrievers, unsigned int index, 
                    TaskHolder iCallback) const final {
+      using namespace std::chrono_literals;
+      if(timer_) {
+        timer_->callAfter(scale_*iRetrievers[index].size()*1us, [callback=std::move(iCallback)]() mutable { callback.doneWaiting(); });
+        return;
+      }
       iCallback.group()->run([iCallback, &iRetrievers, scale=scale_, index]() {
 	  using namespace std::chrono_literals;
 	  auto sleep = scale*iRetrievers[index].size()*1us;
@@ -29,6 +40,8 @@ namespace cce::tf {
 
  private:
   double scale_;
+  //only used for asyncSleep
+  std::unique_ptr<WaiterTimer> timer_;
 };
 }
 
@@ -43,7 +56,7 @@ namespace {
 
       auto scale = params.get<float>("scale", 0);
 
-      return std::make_unique<ScaleWaiter>(scale);
+      return std::make_unique<ScaleWaiter>(scale, params.get<bool>("asyncSleep", false));
     }
     
   };
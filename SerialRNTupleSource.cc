@@ -4,15 +4,42 @@
 #include "TTree.h"
 #include "TBranch.h"
 
+#include <ROOT/RNTupleModel.hxx>
+
+#include "TROOT.h"
+
+#include "summarize_queue.h"
+#include "RootIMT.h"
+
+#include <algorithm>
 #include <iostream>
 
 using namespace cce::tf;
 
-SerialRNTupleSource::SerialRNTupleSource(unsigned iNLanes, unsigned long long iNEvents, std::string const& iName, bool iDelayReading):
+namespace {
+  //each load of a (partial) cluster is a miss of the cluster cache
+  unsigned long long clusterLoads(ROOT::Experimental::RNTupleReader& iReader) {
+    auto counter = iReader.GetMetrics().GetCounter("RNTupleReader.RPageSourceFile.nClusterLoaded");
+    if(not counter) {
+      return 0;
+    }
+    return counter->GetValueAsInt();
+  }
+}
+
+SerialRNTupleSource::SerialRNTupleSource(unsigned iNLanes, unsigned long long iNEvents, std::string const& iName, bool iDelayReading,
+                                         bool iParallelRead,
+                                         ROOT::Experimental::RNTupleReadOptions const& iReadOptions,
+                                         unsigned int iBulkReadSize,
+                                         ProductSelector const& iSelector):
   SharedSourceBase(iNEvents),
-  events_{ROOT::Experimental::RNTupleReader::Open("Events", iName.c_str())},
+  fileName_{iName},
+  readOptions_{iReadOptions},
+  events_{ROOT::Experimental::RNTupleReader::Open("Events", iName.c_str(), iReadOptions)},
   accumulatedTime_{std::chrono::microseconds::zero()},
-  delayReading_{iDelayReading}
+  delayReading_{iDelayReading},
+  parallelRead_{iParallelRead},
+  bulkReadSize_{iBulkReadSize}
  {
   if(not delayReading_) {
      promptReaders_.reserve(iNLanes);
@@ -26,13 +53,16 @@ SerialRNTupleSource::SerialRNTupleSource(unsigned iNLanes, unsigned long long iN
 
   nEvents_ = events_->GetNEntries();
   if (iNEvents < nEvents_ ) nEvents_ = iNEvents;
+  for(auto const& cluster: events_->GetDescriptor().GetClusterIterable()) {
+    clusterEnds_.push_back(cluster.GetFirstEntryIndex()+cluster.GetNEntries());
+  }
+  std::sort(clusterEnds_.begin(), clusterEnds_.end());
   
   const std::string eventIDBranchName{"EventID"}; 
 
   bool hasEventID = false;
   bool hasEventAux = false;
-  auto const& model = events_->GetModel();
-  auto const& subfields = model.GetFieldZero().GetSubFields();
+  auto const& subfields = events_->GetModel().GetFieldZero().GetSubFields();
   std::vector<std::string> fieldIDs;
   fieldIDs.reserve(subfields.size());
   std::vector<std::string> fieldType;
@@ -42,10 +72,57 @@ SerialRNTupleSource::SerialRNTupleSource(unsigned iNLanes, unsigned long long iN
       hasEventID = true;
       continue;
     }
+    if(not iSelector.keep(field->GetFieldName())) {
+      continue;
+    }
+    readFields_.push_back(fieldIDs.size());
     fieldIDs.emplace_back(field->GetFieldName());
     fieldType.emplace_back(field->GetTypeName());
   }
 
+  if(not iSelector.keepsAll() and not delayReading_ and not parallelRead_) {
+    //LoadEntry reads every field of the model so only give it the selected ones
+    auto selectedModel = ROOT::Experimental::RNTupleModel::Create();
+    for(int i=0; i< fieldIDs.size(); ++i) {
+      selectedModel->AddField(ROOT::Experimental::RFieldBase::Create(fieldIDs[i], fieldType[i]).Unwrap());
+    }
+    selectedModel->AddField(ROOT::Experimental::RFieldBase::Create(eventIDBranchName, "cce::tf::EventIdentifier").Unwrap());
+    events_ = ROOT::Experimental::RNTupleReader::Open(std::move(selectedModel), "Events", iName.c_str(), iReadOptions);
+  }
+  events_->EnableMetrics();
+
+  if(parallelRead_) {
+    //a reader is not thread safe so each field gets its own, used only from its queue
+    fieldReaders_.reserve(fieldIDs.size());
+    for(int i=0; i< fieldIDs.size(); ++i) {
+      fieldReaders_.emplace_back(ROOT::Experimental::RNTupleReader::Open("Events", iName.c_str(), iReadOptions));
+      fieldReaders_.back()->EnableMetrics();
+    }
+    fieldQueues_.resize(fieldIDs.size());
+    fieldReadTimes_.resize(fieldIDs.size(), std::chrono::microseconds::zero());
+    fieldViews_.resize(iNLanes);
+  }
+
+#if defined(RNTUPLE_BULK_READ)
+  if(bulkReadSize_ != 0) {
+    bulkFieldNames_ = fieldIDs;
+    bulkFieldNames_.push_back(eventIDBranchName);
+    for(auto const& name: bulkFieldNames_) {
+      bulkValueSizes_.push_back(events_->GetModel().GetField(name).GetValueSize());
+    }
+    //a bulk read can not cross a cluster boundary
+    for(auto const& cluster: events_->GetDescriptor().GetClusterIterable()) {
+      long begin = cluster.GetFirstEntryIndex();
+      clusters_.emplace_back(begin, begin+cluster.GetNEntries(), cluster.GetId());
+    }
+    std::sort(clusters_.begin(), clusters_.end());
+    bulkMask_ = std::make_unique<bool[]>(bulkReadSize_);
+    std::fill(bulkMask_.get(), bulkMask_.get()+bulkReadSize_, true);
+    laneBlocks_.resize(iNLanes);
+  }
+#endif
+  auto const& model = events_->GetModel();
+
   for(int laneId=0; laneId < iNLanes; ++laneId) {
     entries_.emplace_back(model.CreateEntry());
     dataProductsPerLane_.emplace_back();
@@ -53,6 +130,13 @@ SerialRNTupleSource::SerialRNTupleSource(unsigned iNLanes, unsigned long long iN
     
     dataProducts.reserve(fieldIDs.size());
     DelayedProductRetriever* delayedReader = nullptr;
+    if(parallelRead_) {
+      auto& views = fieldViews_[laneId];
+      views.reserve(fieldIDs.size());
+      for(int i=0; i< fieldIDs.size(); ++i) {
+        views.push_back(fieldReaders_[i]->GetView<void>(fieldIDs[i]));
+      }
+    }
     if(not delayReading_) {
       promptReaders_.emplace_back();
       delayedReader = &promptReaders_.back();
@@ -81,30 +165,180 @@ void SerialRNTupleSource::readEventAsync(unsigned int iLane, long iEventIndex, O
     auto group = temptask.group();
     queue_.push(*group, [task=std::move(temptask), this, iLane, iEventIndex]() mutable {
         auto start = std::chrono::high_resolution_clock::now();
-        if (delayReading_) {
+#if defined(RNTUPLE_BULK_READ)
+        if(bulkReadSize_ != 0) {
+          auto& block = laneBlocks_[iLane];
+          block = blockFor(iEventIndex);
+          auto offset = iEventIndex - block->firstEntry_;
+          auto& addresses = ptrToDataProducts_[iLane];
+          for(auto i: readFields_) {
+            addresses[i] = block->values_[i] + offset*bulkValueSizes_[i];
+          }
+          identifiers_[iLane] = *reinterpret_cast<cce::tf::EventIdentifier const*>(block->values_.back() + offset*bulkValueSizes_.back());
+          ++nEventsRead_;
+          accumulatedTime_ += std::chrono::duration_cast<decltype(accumulatedTime_)>(std::chrono::high_resolution_clock::now() - start);
+          task.doneWaiting();
+          return;
+        }
+#endif
+        if (delayReading_ or parallelRead_) {
           identifiers_[iLane] = events_->GetView<cce::tf::EventIdentifier>("EventID")(iEventIndex);
-          delayedReaders_[iLane].setEventIndex(iEventIndex);
+          if(delayReading_) {
+            delayedReaders_[iLane].setEventIndex(iEventIndex);
+          }
         } else {
           events_->LoadEntry(iEventIndex, *entries_[iLane]);
           identifiers_[iLane] = *entries_[iLane]->GetPtr<cce::tf::EventIdentifier>("EventID");
         }
+        ++nEventsRead_;
         accumulatedTime_ += std::chrono::duration_cast<decltype(accumulatedTime_)>(std::chrono::high_resolution_clock::now() - start);
+        if(parallelRead_) {
+          //the event is ready once each field's queue has read its value
+          auto group = task.group();
+          for(auto i: readFields_) {
+            fieldQueues_[i].push(*group, [fieldTask=task, this, iLane, i, iEventIndex]() mutable {
+                readField(iLane, i, iEventIndex);
+                fieldTask.doneWaiting();
+              });
+          }
+        }
         task.doneWaiting();
       });
   }
 }
 
+#if defined(RNTUPLE_BULK_READ)
+std::shared_ptr<SerialRNTupleSource::Block const> SerialRNTupleSource::blockFor(long iEventIndex) {
+  if(block_ and iEventIndex >= block_->firstEntry_ and iEventIndex < block_->endEntry_) {
+    return block_;
+  }
+  auto itCluster = std::upper_bound(clusters_.begin(), clusters_.end(), iEventIndex,
+                                    [](long iIndex, auto const& iCluster) { return iIndex < std::get<0>(iCluster); });
+  --itCluster;
+  auto const [clusterBegin, clusterEnd, clusterId] = *itCluster;
+
+  auto block = std::make_shared<Block>();
+  block->firstEntry_ = iEventIndex;
+  block->endEntry_ = std::min<long>({iEventIndex + bulkReadSize_, clusterEnd, nEvents_});
+  auto const size = block->endEntry_ - block->firstEntry_;
+  ROOT::Experimental::RClusterIndex const firstIndex(clusterId, iEventIndex - clusterBegin);
+  //the fields not read keep a null value
+  block->bulks_.reserve(readFields_.size()+1);
+  block->values_.assign(bulkFieldNames_.size(), nullptr);
+  auto readBulk = [&](std::size_t iField) {
+    block->bulks_.push_back(events_->GetModel().GetField(bulkFieldNames_[iField]).CreateBulk());
+    block->values_[iField] = static_cast<char*>(block->bulks_.back().ReadBulk(firstIndex, bulkMask_.get(), size));
+  };
+  for(auto i: readFields_) {
+    readBulk(i);
+  }
+  //the EventID
+  readBulk(bulkFieldNames_.size()-1);
+  ++nBulkReads_;
+  block_ = std::move(block);
+  return block_;
+}
+#endif
+
+void SerialRNTupleSource::setNeededProducts(std::vector<unsigned int> const& iOrder) {
+  readFields_ = iOrder;
+  readsAllFields_ = false;
+  if(parallelRead_) {
+    //only the queues of the needed fields are used
+    return;
+  }
+#if defined(RNTUPLE_BULK_READ)
+  if(bulkReadSize_ != 0) {
+    return;
+  }
+#endif
+  std::vector<std::string> fieldIDs;
+  fieldIDs.reserve(dataProductsPerLane_[0].size());
+  for(auto const& dp: dataProductsPerLane_[0]) {
+    fieldIDs.push_back(dp.name());
+  }
+  //A reader loads the pages of all the fields of its model, or of its views, for
+  // each cluster. Giving it only the needed fields makes each cluster load one
+  // vectored read of just those.
+  auto neededModel = ROOT::Experimental::RNTupleModel::Create();
+  for(auto i: readFields_) {
+    neededModel->AddField(ROOT::Experimental::RFieldBase::Create(fieldIDs[i], events_->GetModel().GetField(fieldIDs[i]).GetTypeName()).Unwrap());
+  }
+  neededModel->AddField(ROOT::Experimental::RFieldBase::Create("EventID", "cce::tf::EventIdentifier").Unwrap());
+  //the entries and views must go before the reader they came from
+  for(auto& delayedReader: delayedReaders_) {
+    delayedReader.clearViews();
+  }
+  for(auto& entry: entries_) {
+    entry.reset();
+  }
+  events_ = ROOT::Experimental::RNTupleReader::Open(std::move(neededModel), "Events", fileName_.c_str(), readOptions_);
+  events_->EnableMetrics();
+
+  for(unsigned int laneId = 0; laneId < entries_.size(); ++laneId) {
+    entries_[laneId] = events_->GetModel().CreateEntry();
+    auto& addresses = ptrToDataProducts_[laneId];
+    std::fill(addresses.begin(), addresses.end(), nullptr);
+    if(delayReading_) {
+      delayedReaders_[laneId].setNeededProducts(*events_, fieldIDs, &readFields_, &dataProductsPerLane_[laneId]);
+    } else {
+      for(auto i: readFields_) {
+        addresses[i] = entries_[laneId]->GetPtr<void>(fieldIDs[i]).get();
+      }
+    }
+  }
+}
+
+void SerialRNTupleSource::readField(unsigned int iLane, unsigned int iField, long iEventIndex) {
+  auto start = std::chrono::high_resolution_clock::now();
+  auto& view = fieldViews_[iLane][iField];
+  view(iEventIndex);
+  ptrToDataProducts_[iLane][iField] = view.GetValue().GetPtr<void>().get();
+  fieldReadTimes_[iField] += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+}
+
 std::chrono::microseconds SerialRNTupleSource::accumulatedTime() const {
   auto fullTime = accumulatedTime_;
   for(auto& delayedReader: promptReaders_) {
     fullTime += delayedReader.accumulatedTime();
   }
+  for(auto t: fieldReadTimes_) {
+    fullTime += t;
+  }
   return fullTime;
 }
 
 void SerialRNTupleSource::printSummary() const {
   std::chrono::microseconds sourceTime = accumulatedTime();
   std::cout <<"\nSource time: "<<sourceTime.count()<<"us\n"<<std::endl;
+  if(not readsAllFields_) {
+    std::cout <<"data products read: "<<readFields_.size()<<" of "<<dataProductsPerLane_[0].size()<<std::endl;
+  }
+
+  //every reader reads each event once
+  unsigned long long loads = clusterLoads(*events_);
+  for(auto const& reader: fieldReaders_) {
+    loads += clusterLoads(*reader);
+  }
+  unsigned long long entryReads = nEventsRead_*(1+fieldReaders_.size());
+  std::cout <<"cluster loads: "<<loads<<"\n"
+            <<"cluster cache hit rate: "<<(entryReads==0 ? 0. : 1.- double(loads)/entryReads)<<std::endl;
+#if defined(RNTUPLE_BULK_READ)
+  if(bulkReadSize_ != 0) {
+    std::cout <<"bulk reads: "<<nBulkReads_<<std::endl;
+  }
+#endif
+  if(parallelRead_) {
+    std::chrono::microseconds fieldTime = std::chrono::microseconds::zero();
+    for(auto t: fieldReadTimes_) {
+      fieldTime += t;
+    }
+    std::cout <<"field read time: "<<fieldTime.count()<<"us"<<std::endl;
+  }
+  summarize_queue("source", queue_);
+  for(unsigned int i = 0; i < fieldQueues_.size(); ++i) {
+    summarize_queue("field "+dataProductsPerLane_[0][i].name(), fieldQueues_[i]);
+  }
 }
 
 void SerialRNTuplePromptRetriever::getAsync(DataProductRetriever& dataProduct, int index, TaskHolder iTask) {
@@ -121,8 +355,35 @@ void SerialRNTupleDelayedRetriever::fillViews(ROOT::Experimental::RNTupleReader&
   }
 }
 
+void SerialRNTupleDelayedRetriever::setNeededProducts(ROOT::Experimental::RNTupleReader& iReader, std::vector<std::string> const& iFieldIDs,
+                                                      std::vector<unsigned int> const* iOrder, std::vector<DataProductRetriever>* iDataProducts) {
+  neededOrder_ = iOrder;
+  dataProducts_ = iDataProducts;
+  views_.clear();
+  views_.reserve(iOrder->size());
+  for(auto i: *iOrder) {
+    views_.push_back(iReader.GetView<void>(iFieldIDs[i]));
+  }
+}
+
 void SerialRNTupleDelayedRetriever::getAsync(DataProductRetriever& dataProduct, int index, TaskHolder iTask) {
   auto group = iTask.group();
+  if(neededOrder_) {
+    std::unique_lock<std::mutex> guard(pendingMutex_);
+    if(entryState_ == EntryState::kRead) {
+      guard.unlock();
+      iTask.doneWaiting();
+      return;
+    }
+    pending_.push_back(std::move(iTask));
+    if(entryState_ == EntryState::kReading) {
+      return;
+    }
+    entryState_ = EntryState::kReading;
+    guard.unlock();
+    queue_->push(*group, [this]() { readNeeded(); });
+    return;
+  }
   queue_->push(*group, [&dataProduct, index,this, task = std::move(iTask)]() mutable { 
       auto start = std::chrono::high_resolution_clock::now();
       views_[index](eventIndex_);
@@ -133,6 +394,26 @@ void SerialRNTupleDelayedRetriever::getAsync(DataProductRetriever& dataProduct,
     });
 };
 
+void SerialRNTupleDelayedRetriever::readNeeded() {
+  auto start = std::chrono::high_resolution_clock::now();
+  for(std::size_t v = 0; v < views_.size(); ++v) {
+    auto const index = (*neededOrder_)[v];
+    views_[v](eventIndex_);
+    (*addresses_)[index] = views_[v].GetValue().GetPtr<void>().get();
+    (*dataProducts_)[index].setSize(0);
+  }
+  accumulatedTime_ += std::chrono::duration_cast<decltype(accumulatedTime_)>(std::chrono::high_resolution_clock::now() - start);
+  std::vector<TaskHolder> tasks;
+  {
+    std::lock_guard<std::mutex> guard(pendingMutex_);
+    entryState_ = EntryState::kRead;
+    tasks.swap(pending_);
+  }
+  for(auto& task: tasks) {
+    task.doneWaiting();
+  }
+}
+
 namespace {
     class Maker : public SourceMakerBase {
   public:
@@ -143,7 +424,39 @@ namespace {
           std::cout <<"no file name given\n";
           return {};
         }
-        return std::make_unique<SerialRNTupleSource>(iNLanes, iNEvents, *fileName, params.get<bool>("delayReading",false));
+        bool delayReading = params.get<bool>("delayReading",false);
+        bool parallelRead = params.get<bool>("parallelRead",false);
+        if(delayReading and parallelRead) {
+          std::cout <<"delayReading and parallelRead can not be used together"<<std::endl;
+          return {};
+        }
+        using ROOT::Experimental::RNTupleReadOptions;
+        RNTupleReadOptions readOptions;
+        readOptions.SetClusterCache(params.get<bool>("prefetch", true) ? RNTupleReadOptions::EClusterCache::kOn : RNTupleReadOptions::EClusterCache::kOff);
+        auto clusterBunchSize = params.get<unsigned int>("clusterBunchSize", 0);
+        if(clusterBunchSize != 0) {
+          readOptions.SetClusterBunchSize(clusterBunchSize);
+        }
+        bool parallelUnzip = params.get<bool>("parallelUnzip", false);
+        if(parallelUnzip and not rootIMTForSources()) {
+          std::cout <<"parallelUnzip requires --use-IMT with --IMT-scope all or sources"<<std::endl;
+          return {};
+        }
+        readOptions.SetUseImplicitMT(parallelUnzip ? RNTupleReadOptions::EImplicitMT::kDefault : RNTupleReadOptions::EImplicitMT::kOff);
+        auto bulkReadSize = params.get<unsigned int>("bulkReadSize", 0);
+#if defined(RNTUPLE_BULK_READ)
+        if(bulkReadSize != 0 and (delayReading or parallelRead)) {
+          std::cout <<"bulkReadSize can not be combined with delayReading or parallelRead"<<std::endl;
+          return {};
+        }
+#else
+        if(bulkReadSize != 0) {
+          std::cout <<"bulkReadSize requires ROOT 6.32 or later"<<std::endl;
+          return {};
+        }
+#endif
+        ProductSelector selector{params.get<std::string>("products", "")};
+        return std::make_unique<SerialRNTupleSource>(iNLanes, iNEvents, *fileName, delayReading, parallelRead, readOptions, bulkReadSize, selector);
     }
     };
 
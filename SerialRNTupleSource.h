@@ -6,13 +6,21 @@
 #include <optional>
 #include <vector>
 #include <atomic>
+#include <tuple>
+#include <chrono>
+#include <mutex>
 
 #include "DataProductRetriever.h"
 #include "DelayedProductRetriever.h"
+#include "ProductSelector.h"
 
 #include "SharedSourceBase.h"
 #include "SerialTaskQueue.h"
 #include "ROOT/RNTuple.hxx"
+#include <RVersion.h>
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,32,0)
+#define RNTUPLE_BULK_READ
+#endif
 
 namespace cce::tf {
   class SerialRNTuplePromptRetriever : public DelayedProductRetriever {
@@ -38,23 +46,49 @@ namespace cce::tf {
       queue_(iQueue), addresses_(iProductPtrs), accumulatedTime_{std::chrono::microseconds::zero()}{
       fillViews(iReader, iFieldIDs);
     }
+    SerialRNTupleDelayedRetriever(SerialRNTupleDelayedRetriever&& iOther):
+      queue_(iOther.queue_), views_(std::move(iOther.views_)), addresses_(iOther.addresses_),
+      accumulatedTime_{iOther.accumulatedTime_}, eventIndex_{iOther.eventIndex_},
+      neededOrder_{iOther.neededOrder_}, dataProducts_{iOther.dataProducts_} {}
 
-    void setEventIndex(std::uint64_t iIndex) { eventIndex_ = iIndex;}
+    void setEventIndex(std::uint64_t iIndex) { eventIndex_ = iIndex; entryState_ = EntryState::kNotRead; }
     void getAsync(DataProductRetriever&, int index, TaskHolder) final;
     std::chrono::microseconds accumulatedTime() const { return accumulatedTime_;}
 
+    //must be called before the reader the views were made from goes away
+    void clearViews() { views_.clear(); }
+    //Only views of the iOrder fields are made from iReader. The first getAsync of an
+    // event then reads all of them, in that order, in one task of the queue.
+    void setNeededProducts(ROOT::Experimental::RNTupleReader& iReader, std::vector<std::string> const& iFieldIDs,
+                           std::vector<unsigned int> const* iOrder, std::vector<DataProductRetriever>* iDataProducts);
+
   private:
     void fillViews(ROOT::Experimental::RNTupleReader& iReader, std::vector<std::string> const& iFieldIDs);
+    //must be called from queue_
+    void readNeeded();
     SerialTaskQueue* queue_;
+    //with neededOrder_ these are in that order
     std::vector<ROOT::Experimental::RNTupleView<void>> views_;
     std::vector<void*>* addresses_;
     std::chrono::microseconds accumulatedTime_;
     std::uint64_t eventIndex_ = 0;
+
+    std::vector<unsigned int> const* neededOrder_ = nullptr;
+    std::vector<DataProductRetriever>* dataProducts_ = nullptr;
+    enum class EntryState { kNotRead, kReading, kRead };
+    std::mutex pendingMutex_;
+    //guarded by pendingMutex_
+    EntryState entryState_ = EntryState::kNotRead;
+    std::vector<TaskHolder> pending_;
   };
 
   class SerialRNTupleSource : public SharedSourceBase {
   public:
-    SerialRNTupleSource(unsigned iNLanes, unsigned long long iNEvents, std::string const& iName, bool iDelayReading);
+    SerialRNTupleSource(unsigned iNLanes, unsigned long long iNEvents, std::string const& iName, bool iDelayReading,
+                        bool iParallelRead = false,
+                        ROOT::Experimental::RNTupleReadOptions const& iReadOptions = ROOT::Experimental::RNTupleReadOptions(),
+                        unsigned int iBulkReadSize = 0,
+                        ProductSelector const& iSelector = ProductSelector());
     size_t numberOfDataProducts() const final {return dataProductsPerLane_[0].size();}
 
     std::vector<DataProductRetriever>& dataProducts(unsigned int iLane, long iEventIndex) final {
@@ -64,16 +98,45 @@ namespace cce::tf {
       return identifiers_[iLane];
     }
     
+    //only the fields of those data products are read
+    void setNeededProducts(std::vector<unsigned int> const& iOrder) final;
+    //the end of the RNTuple cluster holding the event
+    long clusterEnd(long iEventIndex) const final { return clusterEndFrom(clusterEnds_, iEventIndex); }
+
     void printSummary() const final;
     std::chrono::microseconds accumulatedTime() const;
   private:
     void readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder) final;
+    void readField(unsigned int iLane, unsigned int iField, long iEventIndex);
+#if defined(RNTUPLE_BULK_READ)
+    struct Block {
+      long firstEntry_;
+      long endEntry_;
+      //one per field read
+      std::vector<ROOT::Experimental::RFieldBase::RBulk> bulks_;
+      //one per field with the EventID last, null for the fields not read
+      std::vector<char*> values_;
+    };
+    std::shared_ptr<Block const> blockFor(long iEventIndex);
+#endif
 
     
     SerialTaskQueue queue_;
+    std::string fileName_;
+    ROOT::Experimental::RNTupleReadOptions readOptions_;
     std::unique_ptr<ROOT::Experimental::RNTupleReader> events_;
     long nEvents_;
+    std::vector<long> clusterEnds_;
+    //the indices of the fields read, in the order they are used
+    std::vector<unsigned int> readFields_;
+    bool readsAllFields_ = true;
     std::chrono::microseconds accumulatedTime_;
+    unsigned long long nEventsRead_ = 0;
+
+    //used by parallelRead, each field has its own reader so fields are read concurrently
+    std::vector<std::unique_ptr<ROOT::Experimental::RNTupleReader>> fieldReaders_;
+    std::vector<SerialTaskQueue> fieldQueues_;
+    std::vector<std::chrono::microseconds> fieldReadTimes_;
 
     //per lane items
     std::vector<std::unique_ptr<ROOT::Experimental::REntry>> entries_;
@@ -82,8 +145,23 @@ namespace cce::tf {
     std::vector<EventIdentifier> identifiers_;
     std::vector<std::vector<void*>> ptrToDataProducts_;
     std::vector<std::vector<DataProductRetriever>> dataProductsPerLane_;
+    std::vector<std::vector<ROOT::Experimental::RNTupleView<void>>> fieldViews_;
+
+    //used by bulk reading
+    unsigned int bulkReadSize_;
+#if defined(RNTUPLE_BULK_READ)
+    std::vector<std::string> bulkFieldNames_;
+    std::vector<std::size_t> bulkValueSizes_;
+    //first entry, end entry and id of each cluster in entry order
+    std::vector<std::tuple<long, long, ROOT::Experimental::DescriptorId_t>> clusters_;
+    std::unique_ptr<bool[]> bulkMask_;
+    std::shared_ptr<Block const> block_;
+    std::vector<std::shared_ptr<Block const>> laneBlocks_;
+    unsigned long long nBulkReads_ = 0;
+#endif
 
     bool delayReading_;
+    bool parallelRead_;
   };
 }
 
@@ -1,25 +1,45 @@
 #include "SerialRootSource.h"
 #include "SourceFactory.h"
+#include "Tracer.h"
+#include "summarize_queue.h"
 
 #include "TTree.h"
 #include "TBranch.h"
+#include "TROOT.h"
+#include "RootIMT.h"
 
+#include <algorithm>
 #include <iostream>
 
 using namespace cce::tf;
 
-SerialRootSource::SerialRootSource(unsigned iNLanes, unsigned long long iNEvents, std::string const& iName):
+SerialRootSource::SerialRootSource(unsigned iNLanes, unsigned long long iNEvents, std::string const& iName,
+                                   RootCacheOptions const& iCacheOptions,
+                                   ProductSelector const& iSelector,
+                                   bool iIDsByCluster,
+                                   bool iCoalesceReads):
   SharedSourceBase(iNEvents),
-  file_{TFile::Open(iName.c_str())},
+  file_{openFileForCache(iName, iCacheOptions)},
   eventAuxReader_{*file_},
-  accumulatedTime_{std::chrono::microseconds::zero()}
+  accumulatedTime_{std::chrono::microseconds::zero()},
+  idsByCluster_{iIDsByCluster},
+  coalesceReads_{iCoalesceReads},
+  cacheOptions_{iCacheOptions}
  {
   delayedReaders_.reserve(iNLanes);
   dataProductsPerLane_.reserve(iNLanes);
   identifiers_.resize(iNLanes);
 
   events_ = file_->Get<TTree>("Events");
+  events_->SetImplicitMT(rootIMTForSources());
   nEvents_ = events_->GetEntries();
+  {
+    //found once as clusterEnd is called by the Lanes while events are being read
+    auto clusterIterator = events_->GetClusterIterator(0);
+    while(clusterIterator() < nEvents_) {
+      clusterEnds_.push_back(std::min<long>(clusterIterator.GetNextEntry(), nEvents_));
+    }
+  }
   auto l = events_->GetListOfBranches();
 
   const std::string eventAuxiliaryBranchName{"EventAuxiliary"}; 
@@ -35,17 +55,28 @@ SerialRootSource::SerialRootSource(unsigned iNLanes, unsigned long long iNEvents
       continue;
     }
     b->SetupAddresses();
-    branches_.emplace_back(b);
     if(eventAuxiliaryBranchName == b->GetName()) {
+      //always read for the event identifier
       eventAuxBranch_ = b;
     }
+    if(iSelector.keep(b->GetName())) {
+      branches_.emplace_back(b);
+    }
+  }
+
+  if(iCacheOptions.configured()) {
+    std::vector<TBranch*> cachedBranches = branches_;
+    if(eventIDBranch_) {
+      cachedBranches.push_back(eventIDBranch_);
+    }
+    configureCache(*events_, cachedBranches, iCacheOptions);
   }
 
   for(int laneId=0; laneId < iNLanes; ++laneId) {
     dataProductsPerLane_.emplace_back();
     auto& dataProducts = dataProductsPerLane_.back();
     dataProducts.reserve(branches_.size());
-    delayedReaders_.emplace_back(&queue_, &branches_);
+    delayedReaders_.emplace_back(&queue_, &branches_, iCoalesceReads);
     auto& delayedReader = delayedReaders_.back();
 
     for(int i=0; i< branches_.size(); ++i) {
@@ -70,13 +101,12 @@ void SerialRootSource::readEventAsync(unsigned int iLane, long iEventIndex, Opti
     auto temptask = iTask.releaseToTaskHolder();
     auto group = temptask.group();
     queue_.push(*group, [task=std::move(temptask), this, iLane, iEventIndex]() mutable {
+        TraceScope scope("read", "source");
         auto start = std::chrono::high_resolution_clock::now();
-        if(eventAuxBranch_) {
-          eventAuxBranch_->GetEntry(iEventIndex);
-          identifiers_[iLane] = eventAuxReader_.doWork(eventAuxBranch_);
-        } else if(eventIDBranch_) {
-          eventIDBranch_->SetAddress(&identifiers_[iLane]);
-          eventIDBranch_->GetEntry(iEventIndex);
+        if(idsByCluster_) {
+          identifiers_[iLane] = identifierFromCluster(iEventIndex);
+        } else {
+          identifiers_[iLane] = readIdentifier(iEventIndex);
         }
         accumulatedTime_ += std::chrono::duration_cast<decltype(accumulatedTime_)>(std::chrono::high_resolution_clock::now() - start);
         task.doneWaiting();
@@ -84,6 +114,56 @@ void SerialRootSource::readEventAsync(unsigned int iLane, long iEventIndex, Opti
   }
 }
 
+void SerialRootSource::setNeededProducts(std::vector<unsigned int> const& iOrder) {
+  neededOrder_ = iOrder;
+  std::vector<TBranch*> cachedBranches;
+  cachedBranches.reserve(iOrder.size()+1);
+  for(auto index: iOrder) {
+    cachedBranches.push_back(branches_[index]);
+  }
+  if(eventIDBranch_) {
+    cachedBranches.push_back(eventIDBranch_);
+  }
+  restrictCache(*events_, cachedBranches, cacheOptions_);
+  for(unsigned int lane = 0; lane < delayedReaders_.size(); ++lane) {
+    delayedReaders_[lane].setNeededProducts(&*neededOrder_, &dataProductsPerLane_[lane]);
+  }
+}
+
+EventIdentifier SerialRootSource::readIdentifier(long iEventIndex) {
+  EventIdentifier id;
+  if(eventAuxBranch_) {
+    eventAuxBranch_->GetEntry(iEventIndex);
+    id = eventAuxReader_.doWork(eventAuxBranch_);
+  } else if(eventIDBranch_) {
+    eventIDBranch_->SetAddress(&id);
+    eventIDBranch_->GetEntry(iEventIndex);
+  }
+  return id;
+}
+
+EventIdentifier const& SerialRootSource::identifierFromCluster(long iEventIndex) {
+  for(auto const& cluster: idClusters_) {
+    if(iEventIndex >= cluster.begin_ and iEventIndex < cluster.end_) {
+      return cluster.ids_[iEventIndex - cluster.begin_];
+    }
+  }
+  //read the identifiers of the whole cluster while its baskets are at hand
+  // so the following events only need a look up
+  auto& cluster = idClusters_[nextIDCluster_];
+  nextIDCluster_ = (nextIDCluster_+1) % idClusters_.size();
+  auto clusterIterator = events_->GetClusterIterator(iEventIndex);
+  cluster.begin_ = clusterIterator();
+  cluster.end_ = std::min<long>(clusterIterator.GetNextEntry(), nEvents_);
+  cluster.ids_.clear();
+  cluster.ids_.reserve(cluster.end_ - cluster.begin_);
+  for(long entry = cluster.begin_; entry < cluster.end_; ++entry) {
+    cluster.ids_.push_back(readIdentifier(entry));
+  }
+  ++nIDClustersRead_;
+  return cluster.ids_[iEventIndex - cluster.begin_];
+}
+
 std::chrono::microseconds SerialRootSource::accumulatedTime() const {
   auto fullTime = accumulatedTime_;
   for(auto& delayedReader: delayedReaders_) {
@@ -94,19 +174,106 @@ std::chrono::microseconds SerialRootSource::accumulatedTime() const {
 
 void SerialRootSource::printSummary() const {
   std::chrono::microseconds sourceTime = accumulatedTime();
-  std::cout <<"\nSource time: "<<sourceTime.count()<<"us\n"<<std::endl;
+  std::cout <<"\nSource time: "<<sourceTime.count()<<"us\n";
+  if(idsByCluster_) {
+    std::cout <<"  event identifiers read for "<<nIDClustersRead_<<" clusters\n";
+  }
+  if(neededOrder_) {
+    std::cout <<"  data products read: "<<neededOrder_->size()<<" of "<<branches_.size()<<"\n";
+  }
+  if(coalesceReads_ or neededOrder_) {
+    unsigned long long nReads = 0;
+    unsigned long long nReadTasks = 0;
+    for(auto const& delayedReader: delayedReaders_) {
+      nReads += delayedReader.nReads();
+      nReadTasks += delayedReader.nReadTasks();
+    }
+    std::cout <<"  "<<nReads<<" data product reads done by "<<nReadTasks<<" queue tasks\n";
+  }
+  printCacheSummary(*file_, events_);
+  summarize_queue("read", queue_);
+  std::cout<<std::endl;
 }
 
 void SerialRootDelayedRetriever::getAsync(DataProductRetriever& dataProduct, int index, TaskHolder iTask) {
   auto group = iTask.group();
+  if(neededOrder_) {
+    std::unique_lock<std::mutex> guard(pendingMutex_);
+    if(entryState_ == EntryState::kRead) {
+      guard.unlock();
+      iTask.doneWaiting();
+      return;
+    }
+    pending_.push_back({&dataProduct, index, std::move(iTask)});
+    if(entryState_ == EntryState::kReading) {
+      return;
+    }
+    entryState_ = EntryState::kReading;
+    guard.unlock();
+    queue_->push(*group, [this]() { readNeeded(); });
+    return;
+  }
+  if(coalesce_) {
+    {
+      std::lock_guard<std::mutex> guard(pendingMutex_);
+      pending_.push_back({&dataProduct, index, std::move(iTask)});
+      if(pending_.size() > 1) {
+        //the task already in the queue will also read this one
+        return;
+      }
+    }
+    queue_->push(*group, [this]() { readPending(); });
+    return;
+  }
   queue_->push(*group, [&dataProduct, index,this, task = std::move(iTask)]() mutable { 
-      auto start = std::chrono::high_resolution_clock::now();
-      dataProduct.setSize( (*branches_)[index]->GetEntry(entry_) );
-      accumulatedTime_ += std::chrono::duration_cast<decltype(accumulatedTime_)>(std::chrono::high_resolution_clock::now() - start);
+      ++nReadTasks_;
+      read(dataProduct, index);
       task.doneWaiting();
     });
 };
 
+void SerialRootDelayedRetriever::read(DataProductRetriever& dataProduct, int index) {
+  TraceScope scope(dataProduct.name(), "read");
+  auto start = std::chrono::high_resolution_clock::now();
+  dataProduct.setSize( (*branches_)[index]->GetEntry(entry_) );
+  accumulatedTime_ += std::chrono::duration_cast<decltype(accumulatedTime_)>(std::chrono::high_resolution_clock::now() - start);
+  ++nReads_;
+}
+
+void SerialRootDelayedRetriever::readPending() {
+  std::vector<PendingRead> reads;
+  {
+    std::lock_guard<std::mutex> guard(pendingMutex_);
+    reads.swap(pending_);
+  }
+  ++nReadTasks_;
+  //the baskets of a cluster are written in the order of the branches so reading
+  // in branch order moves forward through the file
+  std::sort(reads.begin(), reads.end(), [](auto const& iLHS, auto const& iRHS) { return iLHS.index_ < iRHS.index_; });
+  for(auto& pending: reads) {
+    read(*pending.dataProduct_, pending.index_);
+    pending.task_.doneWaiting();
+  }
+}
+
+void SerialRootDelayedRetriever::readNeeded() {
+  ++nReadTasks_;
+  //the cache only holds the baskets of the needed branches so this is one pass
+  // through them in the order the job uses them
+  for(auto index: *neededOrder_) {
+    read((*dataProducts_)[index], index);
+  }
+  std::vector<PendingRead> reads;
+  {
+    std::lock_guard<std::mutex> guard(pendingMutex_);
+    entryState_ = EntryState::kRead;
+    reads.swap(pending_);
+  }
+  for(auto& pending: reads) {
+    pending.task_.doneWaiting();
+  }
+}
+
 namespace {
     class Maker : public SourceMakerBase {
   public:
@@ -117,7 +284,19 @@ namespace {
           std::cout <<"no file name given\n";
           return {};
         }
-        return std::make_unique<SerialRootSource>(iNLanes, iNEvents, *fileName);
+        RootCacheOptions cacheOptions;
+        cacheOptions.cacheSize_ = params.get<std::size_t>("cacheSize", 0);
+        cacheOptions.learnEntries_ = params.get<unsigned int>("cacheLearnEntries", 0);
+        cacheOptions.prefetch_ = params.get<bool>("prefetch", false);
+        cacheOptions.parallelUnzip_ = params.get<bool>("parallelUnzip", false);
+        if(cacheOptions.parallelUnzip_ and not rootIMTForSources()) {
+          std::cout <<"parallelUnzip requires --use-IMT with --IMT-scope all or sources"<<std::endl;
+          return {};
+        }
+        ProductSelector selector{params.get<std::string>("products", "")};
+        bool idsByCluster = params.get<bool>("idsByCluster", false);
+        bool coalesceReads = params.get<bool>("coalesceReads", false);
+        return std::make_unique<SerialRootSource>(iNLanes, iNEvents, *fileName, cacheOptions, selector, idsByCluster, coalesceReads);
     }
     };
 
@@ -1,6 +1,9 @@
 #if !defined(SerialRootSource_h)
 #define SerialRootSource_h
 
+#include <array>
+#include <cassert>
+#include <mutex>
 #include <string>
 #include <memory>
 #include <optional>
@@ -9,10 +12,12 @@
 #include "DataProductRetriever.h"
 #include "DelayedProductRetriever.h"
 #include "EventAuxReader.h"
+#include "ProductSelector.h"
 
 #include "SharedSourceBase.h"
 #include "SerialTaskQueue.h"
 #include "TFile.h"
+#include "RootCacheOptions.h"
 
 class TBranch;
 class TTree;
@@ -20,24 +25,67 @@ class TTree;
 namespace cce::tf {
   class SerialRootDelayedRetriever : public DelayedProductRetriever {
   public:
+    //with iCoalesce the data products asked for while a read is waiting in the queue
+    // are all read by one task of the queue
     SerialRootDelayedRetriever(SerialTaskQueue* iQueue,
-                               std::vector<TBranch*>* iBranches):
+                               std::vector<TBranch*>* iBranches,
+                               bool iCoalesce = false):
     queue_(iQueue), branches_(iBranches),
-      accumulatedTime_{std::chrono::microseconds::zero()}{}
+      accumulatedTime_{std::chrono::microseconds::zero()}, coalesce_{iCoalesce}{}
+    SerialRootDelayedRetriever(SerialRootDelayedRetriever&& iOther):
+      queue_(iOther.queue_), branches_(iOther.branches_),
+      accumulatedTime_{iOther.accumulatedTime_}, entry_{iOther.entry_}, coalesce_{iOther.coalesce_},
+      neededOrder_{iOther.neededOrder_}, dataProducts_{iOther.dataProducts_} {
+      assert(iOther.pending_.empty());
+    }
     void getAsync(DataProductRetriever&, int index, TaskHolder) final;
-    void setEntry(long iEntry) { entry_ = iEntry; }
+    void setEntry(long iEntry) { entry_ = iEntry; entryState_ = EntryState::kNotRead; }
+    //Once set, the first getAsync of an entry reads all the iOrder data products of
+    // iDataProducts, in that order, in one task of the queue.
+    void setNeededProducts(std::vector<unsigned int> const* iOrder, std::vector<DataProductRetriever>* iDataProducts) {
+      neededOrder_ = iOrder;
+      dataProducts_ = iDataProducts;
+    }
     std::chrono::microseconds accumulatedTime() const { return accumulatedTime_;}
+    //number of tasks the reads of the data products needed
+    unsigned long long nReadTasks() const { return nReadTasks_; }
+    unsigned long long nReads() const { return nReads_; }
 
   private:
+    struct PendingRead {
+      DataProductRetriever* dataProduct_;
+      int index_;
+      TaskHolder task_;
+    };
+    void read(DataProductRetriever&, int index);
+    //must be called from queue_
+    void readPending();
+    //must be called from queue_
+    void readNeeded();
+
     SerialTaskQueue* queue_;
     std::vector<TBranch*>* branches_;
     std::chrono::microseconds accumulatedTime_;
     long entry_ = -1;
+    bool coalesce_;
+    std::mutex pendingMutex_;
+    std::vector<PendingRead> pending_;
+    std::vector<unsigned int> const* neededOrder_ = nullptr;
+    std::vector<DataProductRetriever>* dataProducts_ = nullptr;
+    enum class EntryState { kNotRead, kReading, kRead };
+    //guarded by pendingMutex_
+    EntryState entryState_ = EntryState::kNotRead;
+    unsigned long long nReadTasks_ = 0;
+    unsigned long long nReads_ = 0;
   };
 
   class SerialRootSource : public SharedSourceBase {
   public:
-    SerialRootSource(unsigned iNLanes, unsigned long long iNEvents, std::string const& iName);
+    SerialRootSource(unsigned iNLanes, unsigned long long iNEvents, std::string const& iName,
+                     RootCacheOptions const& iCacheOptions = RootCacheOptions(),
+                     ProductSelector const& iSelector = ProductSelector(),
+                     bool iIDsByCluster = false,
+                     bool iCoalesceReads = false);
     size_t numberOfDataProducts() const final {return dataProductsPerLane_[0].size();}
 
     std::vector<DataProductRetriever>& dataProducts(unsigned int iLane, long iEventIndex) final {
@@ -47,10 +95,25 @@ namespace cce::tf {
       return identifiers_[iLane];
     }
     
+    //only the branches of those data products are read and cached
+    void setNeededProducts(std::vector<unsigned int> const& iOrder) final;
+    //the end of the TTree cluster holding the event
+    long clusterEnd(long iEventIndex) const final { return clusterEndFrom(clusterEnds_, iEventIndex); }
+
     void printSummary() const final;
     std::chrono::microseconds accumulatedTime() const;
   private:
     void readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder) final;
+    //must be called from queue_
+    EventIdentifier readIdentifier(long iEventIndex);
+    EventIdentifier const& identifierFromCluster(long iEventIndex);
+
+    //the identifiers of all entries of one TTree cluster
+    struct IDCluster {
+      long begin_ = 0;
+      long end_ = 0;
+      std::vector<EventIdentifier> ids_;
+    };
 
     
     std::unique_ptr<TFile> file_;
@@ -58,10 +121,19 @@ namespace cce::tf {
     TTree* events_;
     std::vector<TBranch*> branches_;
     long nEvents_;
+    std::vector<long> clusterEnds_;
     TBranch* eventAuxBranch_=nullptr;
     TBranch* eventIDBranch_=nullptr;
     EventAuxReader eventAuxReader_;
     std::chrono::microseconds accumulatedTime_;
+    //Lanes near the start of a cluster may still ask for events of the one before
+    std::array<IDCluster, 2> idClusters_;
+    unsigned int nextIDCluster_ = 0;
+    unsigned long long nIDClustersRead_ = 0;
+    bool idsByCluster_;
+    bool coalesceReads_;
+    RootCacheOptions cacheOptions_;
+    std::optional<std::vector<unsigned int>> neededOrder_;
 
     //per lane items
     std::vector<SerialRootDelayedRetriever> delayedReaders_;
@@ -15,6 +15,7 @@
 
 // user include files
 #include "SerialTaskQueue.h"
+#include "Tracer.h"
 
 //
 // member functions
@@ -34,14 +35,32 @@ SerialTaskQueue::~SerialTaskQueue() {
 
 void SerialTaskQueue::spawn(TaskBase& iTask) {
   auto pTask = &iTask;
+  ++m_stats.nSpawns;
   iTask.group()->run([pTask, this]() {
       TaskBase* t = pTask;
       auto g = pTask->group();
+      unsigned int nRun = 0;
       do {
-      	t->execute();
+        startingTask();
+        if(timingEnabled()) {
+          auto start = waitFinished(*t);
+          {
+            TraceScope scope("queued task", "queue");
+            t->execute();
+          }
+          finishedRunning(start);
+        } else {
+          t->execute();
+        }
 	delete t;
-	t = finishedTask();
-	if(t and t->group() != g) {
+        ++nRun;
+	t = nextTaskWhileRunning();
+	//a task from a different group must run in its own group else
+	// that group's wait() could return before the task has run
+	if(t and (t->group() != g or (m_drainBudget != 0 and nRun >= m_drainBudget)  )) {
+	  if(t->group() != g) {
+	    ++m_stats.nGroupHops;
+	  }
 	  spawn(*t);
 	  t=nullptr;
 	}
@@ -49,6 +68,39 @@ void SerialTaskQueue::spawn(TaskBase& iTask) {
     });
 }
 
+void SerialTaskQueue::startingTask() {
+  auto depth = m_nPending--;
+  ++m_stats.nTasks;
+  if(depth > m_stats.maxDepth) {
+    m_stats.maxDepth = depth;
+  }
+}
+
+std::chrono::high_resolution_clock::time_point SerialTaskQueue::waitFinished(TaskBase& iTask) {
+  auto now = std::chrono::high_resolution_clock::now();
+  if(iTask.m_pushTime == std::chrono::high_resolution_clock::time_point()) {
+    //pushed before timing was enabled
+    return now;
+  }
+  auto wait = std::chrono::duration_cast<std::chrono::microseconds>(now - iTask.m_pushTime);
+  if(wait.count() > 0) {
+    ++m_stats.nWaited;
+    m_stats.waitTime += wait;
+    if(wait > m_stats.maxWaitTime) {
+      m_stats.maxWaitTime = wait;
+    }
+  }
+  return now;
+}
+
+void SerialTaskQueue::finishedRunning(std::chrono::high_resolution_clock::time_point iStart) {
+  auto run = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - iStart);
+  m_stats.runTime += run;
+  if(run > m_stats.maxRunTime) {
+    m_stats.maxRunTime = run;
+  }
+}
+
 bool SerialTaskQueue::resume() {
   if (0 == --m_pauseCount) {
     auto* t = pickNextTask();
@@ -70,12 +122,23 @@ void SerialTaskQueue::pushTask(TaskBase* iTask) {
 SerialTaskQueue::TaskBase* SerialTaskQueue::pushAndGetNextTask(TaskBase* iTask) {
   TaskBase* returnValue{nullptr};
   if(nullptr != iTask) {
+      ++m_nPending;
       m_tasks.push(iTask);
       returnValue = pickNextTask();
     }
   return returnValue;
 }
 
+SerialTaskQueue::TaskBase* SerialTaskQueue::nextTaskWhileRunning() {
+  //We still hold m_taskChosen so we can take the next task directly. Only if
+  // the queue looks empty, or was paused, do we have to give up m_taskChosen.
+  if(0 == m_pauseCount) {
+    TaskBase* t = nullptr;
+    if(m_tasks.try_pop(t)) { return t; }
+  }
+  return finishedTask();
+}
+
 SerialTaskQueue::TaskBase* SerialTaskQueue::finishedTask() {
   m_taskChosen.store(false);
   return pickNextTask();
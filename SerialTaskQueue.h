@@ -55,10 +55,13 @@
 // system include files
 #include <atomic>
 #include <cassert>
+#include <chrono>
 
 #include "tbb/task_group.h"
 #include "tbb/concurrent_queue.h"
 
+#include "TaskPool.h"
+
 // user include files
 
 // forward declarations
@@ -114,12 +117,56 @@ class SerialTaskQueue {
     template <typename T>
     void push(tbb::task_group& iGroup, T&& iAction);
 
+    /// pool used for the memory of the queued tasks
+    TaskPool const& taskPool() const { return m_pool; }
+
+    /// Sets the maximum number of tasks run back to back before yielding
+    /**
+       * Once a task finishes, the next pending task for the same tbb::task_group
+       * is run immediately without going back to the TBB scheduler. The budget
+       * bounds how many tasks are run that way before the next one is spawned
+       * as a new TBB task. 0, the default, means no limit.
+       */
+    void setDrainBudget(unsigned int iBudget) { m_drainBudget = iBudget; }
+
+    /// Turns on measuring the wait and run time of each task, and tracing the tasks
+    /**
+       * Without it the queue only counts its tasks and spawns, no clock is read.
+       * Must be called before tasks are pushed to the queues being measured.
+       */
+    static void enableTiming() { s_timingEnabled = true; }
+    static bool timingEnabled() { return s_timingEnabled.load(std::memory_order_relaxed); }
+
+    /// number of pushed tasks which have not yet started
+    unsigned long long nPending() const { return m_nPending.load(); }
+
+    struct Statistics {
+      ///number of tasks which have been run
+      unsigned long long nTasks = 0;
+      ///number of TBB tasks spawned to run the queued tasks
+      unsigned long long nSpawns = 0;
+      ///number of those spawns needed since the next task was for a different tbb::task_group
+      unsigned long long nGroupHops = 0;
+      ///number of tasks which had to wait for other tasks in the queue
+      unsigned long long nWaited = 0;
+      ///largest number of pending tasks seen when a task was started
+      unsigned long long maxDepth = 0;
+      ///sum of time between a push and the start of the task, only with timingEnabled()
+      std::chrono::microseconds waitTime = std::chrono::microseconds::zero();
+      std::chrono::microseconds maxWaitTime = std::chrono::microseconds::zero();
+      ///sum of time spent running the tasks, only with timingEnabled()
+      std::chrono::microseconds runTime = std::chrono::microseconds::zero();
+      std::chrono::microseconds maxRunTime = std::chrono::microseconds::zero();
+    };
+    /// only meaningful once all pushed tasks have finished
+    Statistics const& statistics() const { return m_stats; }
+
   private:
     SerialTaskQueue(const SerialTaskQueue&) = delete;
     const SerialTaskQueue& operator=(const SerialTaskQueue&) = delete;
 
     /** Base class for all tasks held by the SerialTaskQueue */
-    class TaskBase {
+    class TaskBase : public TaskPoolAllocated {
       friend class SerialTaskQueue;
 
       virtual ~TaskBase() = default;
@@ -127,10 +174,15 @@ class SerialTaskQueue {
       tbb::task_group* group() { return m_group;}
       virtual void execute() = 0 ;
     protected:
-      explicit TaskBase(tbb::task_group* iGroup) : m_group(iGroup)  {}
+      explicit TaskBase(tbb::task_group* iGroup) : m_group(iGroup) {
+        if(timingEnabled()) {
+          m_pushTime = std::chrono::high_resolution_clock::now();
+        }
+      }
 
     private:
       tbb::task_group* m_group;
+      std::chrono::high_resolution_clock::time_point m_pushTime;
     };
 
     template <typename T>
@@ -149,20 +201,32 @@ class SerialTaskQueue {
     void pushTask(TaskBase*);
     TaskBase* pushAndGetNextTask(TaskBase*);
     TaskBase* finishedTask();
+    //called while this thread is the one running tasks from the queue
+    TaskBase* nextTaskWhileRunning();
+    void startingTask();
+    //returns the time the task is started
+    std::chrono::high_resolution_clock::time_point waitFinished(TaskBase&);
+    void finishedRunning(std::chrono::high_resolution_clock::time_point iStart);
     //returns nullptr if a task is already being processed
     TaskBase* pickNextTask();
 
     void spawn(TaskBase&) ;
 
     // ---------- member data --------------------------------
+    TaskPool m_pool;
     tbb::concurrent_queue<TaskBase*> m_tasks;
     std::atomic<bool> m_taskChosen;
     std::atomic<unsigned long> m_pauseCount;
+    std::atomic<unsigned long long> m_nPending{0};
+    unsigned int m_drainBudget = 0;
+    //only modified by the thread running tasks from the queue
+    Statistics m_stats;
+    static inline std::atomic<bool> s_timingEnabled{false};
 };
 
 template <typename T>
 void SerialTaskQueue::push(tbb::task_group& iGroup, T&& iAction) {
-  QueuedTask<T>* pTask{new QueuedTask<T>{iGroup, std::forward<T>(iAction)}};
+  QueuedTask<T>* pTask{new (m_pool) QueuedTask<T>{iGroup, std::forward<T>(iAction)}};
   pushTask(pTask);
 }
 
@@ -1,15 +1,188 @@
 #include "SerializeOutputer.h"
 #include "OutputerFactory.h"
+#include "FunctorTask.h"
 #include <iostream>
+#include <sstream>
 
 namespace cce::tf {
+
+void SerializeOutputer::compressAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+  //a lane only has one event being output at a time
+  auto const& laneSerializers = serializers_[iLaneIndex];
+  auto& lane = compressionLanes_[iLaneIndex];
+  for(std::size_t i = 0; i < laneSerializers.size(); ++i) {
+    lane.productBytes_[i] += laneSerializers[i].blob().size();
+  }
+  if(compressEvent_) {
+    lane.eventBuffer_.clear();
+    for(auto const& s: laneSerializers) {
+      auto blob = s.blob();
+      lane.eventBuffer_.insert(lane.eventBuffer_.end(), blob.begin(), blob.end());
+    }
+    lane.eventBytes_ += lane.eventBuffer_.size();
+  }
+
+  auto group = iCallback.group();
+  TaskHolder compressionsDone(*group, make_functor_task([this, iLaneIndex, iEventID, callback = std::move(iCallback)]() mutable {
+        queueOutput(iLaneIndex, iEventID, std::move(callback));
+      }));
+  //each codec has its own statistics and context in the Lane so they can run concurrently
+  for(std::size_t i = 1; i < compressions_.size(); ++i) {
+    group->run([this, &laneSerializers, &lane, i, holder = compressionsDone]() {
+        compress(laneSerializers, lane, compressions_[i], lane.codecs_[i]);
+      });
+  }
+  compress(laneSerializers, lane, compressions_[0], lane.codecs_[0]);
+}
+
+void SerializeOutputer::compress(std::vector<SerializerWrapper> const& iSerializers, CompressionLane const& iLane, CompressionSpec const& iSpec, CodecStatistics& iCodec) const {
+  for(std::size_t i = 0; i < iSerializers.size(); ++i) {
+    auto start = std::chrono::high_resolution_clock::now();
+    auto compressed = pds::compressBuffer(0, 0, iSpec.algorithm_, iSpec.level_, iSerializers[i].blob(), iCodec.context_);
+    iCodec.productTime_[i] += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+    iCodec.productBytes_[i] += compressed.size();
+  }
+  if(compressEvent_) {
+    auto start = std::chrono::high_resolution_clock::now();
+    auto compressed = pds::compressBuffer(0, 0, iSpec.algorithm_, iSpec.level_, iLane.eventBuffer_, iCodec.context_);
+    iCodec.eventTime_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+    iCodec.eventBytes_ += compressed.size();
+  }
+}
+
+namespace {
+  std::string codecName(SerializeOutputer::CompressionSpec const& iSpec) {
+    return std::string(pds::name(iSpec.algorithm_))+"/"+std::to_string(iSpec.level_);
+  }
+
+  //MB/s, i.e. bytes per microsecond
+  double throughput(unsigned long long iBytes, std::chrono::microseconds iTime) {
+    return iTime.count() == 0 ? 0. : double(iBytes)/iTime.count();
+  }
+}
+
+void SerializeOutputer::summarizeCompressions() const {
+  auto const nProducts = compressionLanes_[0].productBytes_.size();
+  std::vector<unsigned long long> productBytes(nProducts, 0);
+  unsigned long long eventBytes = 0;
+  for(auto const& lane: compressionLanes_) {
+    for(std::size_t p = 0; p < nProducts; ++p) {
+      productBytes[p] += lane.productBytes_[p];
+    }
+    eventBytes += lane.eventBytes_;
+  }
+  unsigned long long totalBytes = 0;
+  for(auto b: productBytes) {
+    totalBytes += b;
+  }
+
+  std::cout <<"Compression estimates\n";
+  for(std::size_t c = 0; c < compressions_.size(); ++c) {
+    std::vector<unsigned long long> compressedBytes(nProducts, 0);
+    std::vector<std::chrono::microseconds> times(nProducts, std::chrono::microseconds::zero());
+    unsigned long long eventCompressedBytes = 0;
+    std::chrono::microseconds eventTime = std::chrono::microseconds::zero();
+    for(auto const& lane: compressionLanes_) {
+      auto const& codec = lane.codecs_[c];
+      for(std::size_t p = 0; p < nProducts; ++p) {
+        compressedBytes[p] += codec.productBytes_[p];
+        times[p] += codec.productTime_[p];
+      }
+      eventCompressedBytes += codec.eventBytes_;
+      eventTime += codec.eventTime_;
+    }
+    unsigned long long totalCompressed = 0;
+    std::chrono::microseconds totalTime = std::chrono::microseconds::zero();
+    for(std::size_t p = 0; p < nProducts; ++p) {
+      totalCompressed += compressedBytes[p];
+      totalTime += times[p];
+    }
+    std::cout <<codecName(compressions_[c])<<" per product: ratio "<<double(totalBytes)/std::max(totalCompressed, 1ULL)
+              <<" time "<<totalTime.count()<<"us "<<throughput(totalBytes, totalTime)<<" MB/s\n";
+    if(compressEvent_) {
+      std::cout <<codecName(compressions_[c])<<" per event: ratio "<<double(eventBytes)/std::max(eventCompressedBytes, 1ULL)
+                <<" time "<<eventTime.count()<<"us "<<throughput(eventBytes, eventTime)<<" MB/s\n";
+    }
+    for(std::size_t p = 0; p < nProducts; ++p) {
+      std::cout <<"  ratio: "<<double(productBytes[p])/std::max(compressedBytes[p], 1ULL)
+                <<"\t"<<throughput(productBytes[p], times[p])<<" MB/s\tname: "<<serializers_[0][p].name()<<"\n";
+    }
+  }
+}
+
+void SerializeOutputer::fillReport(RunReport& oReport) const {
+  if(compressions_.empty()) {
+    return;
+  }
+  auto const nProducts = compressionLanes_[0].productBytes_.size();
+  auto& section = oReport.section("compressions");
+  for(std::size_t c = 0; c < compressions_.size(); ++c) {
+    auto& codec = section.section(codecName(compressions_[c]));
+    unsigned long long uncompressed = 0;
+    unsigned long long compressed = 0;
+    std::chrono::microseconds time = std::chrono::microseconds::zero();
+    unsigned long long eventUncompressed = 0;
+    unsigned long long eventCompressed = 0;
+    std::chrono::microseconds eventTime = std::chrono::microseconds::zero();
+    for(auto const& lane: compressionLanes_) {
+      for(std::size_t p = 0; p < nProducts; ++p) {
+        uncompressed += lane.productBytes_[p];
+        compressed += lane.codecs_[c].productBytes_[p];
+        time += lane.codecs_[c].productTime_[p];
+      }
+      eventUncompressed += lane.eventBytes_;
+      eventCompressed += lane.codecs_[c].eventBytes_;
+      eventTime += lane.codecs_[c].eventTime_;
+    }
+    codec.set("uncompressedBytes", uncompressed);
+    codec.set("compressedBytes", compressed);
+    codec.set("compressTime_us", time.count());
+    if(compressEvent_) {
+      codec.set("eventCompressedBytes", eventCompressed);
+      codec.set("eventCompressTime_us", eventTime.count());
+    }
+  }
+}
+
 namespace {
     class Maker : public OutputerMakerBase {
   public:
     Maker(): OutputerMakerBase("SerializeOutputer") {}
     std::unique_ptr<OutputerBase> create(unsigned int iNLanes, ConfigurationParameters const& params) const final {
       bool verbose = params.get<bool>("verbose",false);
-      return std::make_unique<SerializeOutputer>(iNLanes, verbose);
+      //a comma separated list of algorithm names, each optionally followed by /<level>
+      auto compressionNames = params.get<std::string>("compressions", "");
+      bool compressEvent = params.get<bool>("compressEvent", false);
+      std::vector<SerializeOutputer::CompressionSpec> compressions;
+      std::istringstream stream(compressionNames);
+      std::string item;
+      while(std::getline(stream, item, ',')) {
+        if(item.empty()) {
+          continue;
+        }
+        int level = 18;
+        auto slash = item.find('/');
+        if(slash != std::string::npos) {
+          try {
+            level = std::stoi(item.substr(slash+1));
+          } catch(std::exception const&) {
+            std::cout <<"unknown compression level in "<<item<<std::endl;
+            return {};
+          }
+          item.resize(slash);
+        }
+        auto algorithm = pds::toCompression(item);
+        if(not algorithm) {
+          std::cout <<"unknown compression "<<item<<std::endl;
+          return {};
+        }
+        compressions.push_back({*algorithm, level});
+      }
+      if(compressEvent and compressions.empty()) {
+        std::cout <<"compressEvent requires compressions"<<std::endl;
+        return {};
+      }
+      return std::make_unique<SerializeOutputer>(iNLanes, verbose, std::move(compressions), compressEvent);
     }
     };
 
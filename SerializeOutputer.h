@@ -5,27 +5,48 @@
 #include <string>
 #include <iostream>
 #include <cassert>
+#include <chrono>
 
 #include "OutputerBase.h"
 #include "EventIdentifier.h"
 #include "SerializerWrapper.h"
 #include "DataProductRetriever.h"
 #include "summarize_serializers.h"
+#include "summarize_queue.h"
+#include "pds_writer.h"
 
 #include "SerialTaskQueue.h"
+#include "PerLaneCounter.h"
 
 namespace cce::tf {
 class SerializeOutputer :public OutputerBase {
  public:
- SerializeOutputer(unsigned int iLaneIndex, bool iVerbose): serializers_(iLaneIndex), verbose_(iVerbose) {}
+ //a compression algorithm and level to measure the compressed sizes with
+  struct CompressionSpec {
+    pds::Compression algorithm_;
+    int level_;
+  };
+
+ SerializeOutputer(unsigned int iLaneIndex, bool iVerbose, std::vector<CompressionSpec> iCompressions = {}, bool iCompressEvent = false):
+  serializers_(iLaneIndex), compressionLanes_(iLaneIndex), compressions_(std::move(iCompressions)), verbose_(iVerbose),
+  compressEvent_(iCompressEvent) {}
   void setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) final {
     auto& s = serializers_[iLaneIndex];
     s.reserve(iDPs.size());
     for(auto const& dp: iDPs) {
       s.emplace_back(dp.name(), dp.classType());
     }
+    auto& lane = compressionLanes_[iLaneIndex];
+    lane.productBytes_.resize(iDPs.size(), 0);
+    lane.codecs_.resize(compressions_.size());
+    for(auto& codec: lane.codecs_) {
+      codec.productBytes_.resize(iDPs.size(), 0);
+      codec.productTime_.resize(iDPs.size(), std::chrono::microseconds::zero());
+    }
   }
 
+  bool setupForLaneIsThreadSafe() const final { return true; }
+
   void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const final {
     assert(iLaneIndex < serializers_.size());
     auto& laneSerializers = serializers_[iLaneIndex];
@@ -36,18 +57,54 @@ class SerializeOutputer :public OutputerBase {
 
   bool usesProductReadyAsync() const final {return true; }
 
-  void outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final {
-    queue_.push(*iCallback.group(), [this, iEventID, iLaneIndex, callback=std::move(iCallback)]() mutable {
-	output(iEventID, serializers_[iLaneIndex]);
-	callback.doneWaiting();
-      });
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final {
+    if(not compressions_.empty()) {
+      compressAsync(iLaneIndex, iEventID, std::move(iCallback));
+      return;
+    }
+    queueOutput(iLaneIndex, iEventID, std::move(iCallback));
   }
   
   void printSummary() const final {
+    summarize_queue("output", queue_);
     summarize_serializers(serializers_);
+    if(not compressions_.empty()) {
+      summarizeCompressions();
+    }
   }
 
+  void fillReport(RunReport& oReport) const final;
+  void fillProfile(ProductProfile& oProfile) const final { profile_serializers(oProfile, serializers_); }
+
  private:
+  //what one Lane measured for one CompressionSpec
+  struct CodecStatistics {
+    //only used by the task compressing for this codec
+    pds::CompressionContext context_;
+    std::vector<unsigned long long> productBytes_;
+    std::vector<std::chrono::microseconds> productTime_;
+    unsigned long long eventBytes_ = 0;
+    std::chrono::microseconds eventTime_ = std::chrono::microseconds::zero();
+  };
+  struct alignas(kCacheLineSize) CompressionLane {
+    std::vector<unsigned long long> productBytes_;
+    unsigned long long eventBytes_ = 0;
+    //the serialized products of the event, one after the other
+    std::vector<char> eventBuffer_;
+    std::vector<CodecStatistics> codecs_;
+  };
+
+  void compressAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const;
+  void compress(std::vector<SerializerWrapper> const& iSerializers, CompressionLane const& iLane, CompressionSpec const& iSpec, CodecStatistics& iCodec) const;
+  void summarizeCompressions() const;
+
+  void queueOutput(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+    queue_.push(*iCallback.group(), [this, iEventID, iLaneIndex, callback=std::move(iCallback)]() mutable {
+	output(iEventID, serializers_[iLaneIndex]);
+	callback.doneWaiting();
+      });
+  }
+
   void output(EventIdentifier const& iEventID, std::vector<SerializerWrapper> const& iSerializers) const {
     using namespace std::string_literals;
     if(verbose_) {
@@ -61,8 +118,11 @@ class SerializeOutputer :public OutputerBase {
   }
 private:
   mutable std::vector<std::vector<SerializerWrapper>> serializers_;
+  mutable std::vector<CompressionLane> compressionLanes_;
   mutable SerialTaskQueue queue_;
+  std::vector<CompressionSpec> compressions_;
   bool verbose_;
+  bool compressEvent_;
 };
 }
 #endif
@@ -1,3 +1,10 @@
 #include "SerializeStrategy.h"
 
+#include <functional>
+#include <string_view>
+
 cce::tf::SerializeProxyBase::~SerializeProxyBase() = default;
+
+uint64_t cce::tf::SerializeProxyBase::hashBlob(BlobView iBlob) {
+  return std::hash<std::string_view>{}(std::string_view(iBlob.data(), iBlob.size()));
+}
@@ -4,14 +4,38 @@
 
 #include <vector>
 #include <chrono>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+#include <utility>
 #include "TClass.h"
 
 #include "tbb/task_group.h"
 
 #include "TaskHolder.h"
 #include "ProxyVector.h"
+#include "BlobView.h"
+#include "SerializedSizeStats.h"
+#include "DataProductRetriever.h"
+#include "EventSerializationBuffer.h"
+#include "ProductProfile.h"
 
 namespace cce::tf {
+namespace serialize_detail {
+  //if the wrapper can split the serialization of large collections into chunks
+  template<typename WRAPPER, typename = void>
+  struct HasChunks : std::false_type {};
+  template<typename WRAPPER>
+  struct HasChunks<WRAPPER, std::void_t<decltype(std::declval<WRAPPER&>().setChunkElements(0U))>> : std::true_type {};
+
+  //if the wrapper can append its data product to an EventSerializationBuffer
+  template<typename WRAPPER, typename = void>
+  struct HasSerializeInto : std::false_type {};
+  template<typename WRAPPER>
+  struct HasSerializeInto<WRAPPER, std::void_t<decltype(std::declval<WRAPPER&>().serializeInto(std::declval<TBufferFile&>(), std::declval<void**>(),
+                                                                                                 std::declval<int&>(), std::declval<int&>()))>> : std::true_type {};
+}
+
 class SerializeProxyBase {
  public:
  SerializeProxyBase() = default;
@@ -19,11 +43,136 @@ class SerializeProxyBase {
  virtual ~SerializeProxyBase();
 
  virtual void doWorkAsync(tbb::task_group& iGroup, void** iAddress, TaskHolder iCallback) = 0;
- virtual std::vector<char> const& blob() const = 0;
+ virtual void doWork(void** iAddress) = 0;
+
+ //Data products whose serialized size was at most iCoalesceBytes in earlier
+ // events, or in the profile, are only remembered and iCallback is released
+ // at once. Those are then serialized one after the other by serializeDeferred.
+ void doWorkAsyncOrDefer(tbb::task_group& iGroup, void** iAddress, TaskHolder iCallback, std::size_t iCoalesceBytes) {
+   if(knowsExpectedSize() and expectedSize() <= iCoalesceBytes) {
+     usesSerialized_ = false;
+     usesEventBuffer_ = false;
+     deferredAddress_ = iAddress;
+     ++nDeferred_;
+     iCallback.doneWaiting();
+     return;
+   }
+   doWorkAsync(iGroup, iAddress, std::move(iCallback));
+ }
+ void serializeDeferred() {
+   if(deferredAddress_) {
+     doWork(deferredAddress_);
+     deferredAddress_ = nullptr;
+   }
+ }
+ //number of times the serialization was deferred
+ unsigned long long nDeferred() const { return nDeferred_; }
+
+ //The p99 serialized size of the earlier events of the Lane. Before the
+ // first, the one of the profile given to setSerializationProfile.
+ bool knowsExpectedSize() const { return sizeStats().nEntries() != 0 or profiledSize_; }
+ std::size_t expectedSize() const {
+   auto const& stats = sizeStats();
+   return stats.nEntries() != 0 ? stats.p99() : profiledSize_.value_or(0);
+ }
+ bool deferred() const { return deferredAddress_ != nullptr; }
+
+ //As serializeDeferred but the data product is appended to iBuffer, which is shared by
+ // the deferred data products of the Lane. The blob is only set by useEventBuffer.
+ // Data products which can not be appended are serialized into their own buffer.
+ void serializeDeferred(EventSerializationBuffer& iBuffer) {
+   if(not deferredAddress_) {
+     return;
+   }
+   if(not eventBufferUnusable_ and doWorkInto(iBuffer.buffer(), deferredAddress_, eventBlobStart_, eventBlobLength_)) {
+     usesEventBuffer_ = true;
+   } else {
+     //not tried again for later events
+     eventBufferUnusable_ = true;
+     doWork(deferredAddress_);
+   }
+   deferredAddress_ = nullptr;
+ }
+ //called once all the deferred data products of the Lane were added to iBuffer
+ void useEventBuffer(EventSerializationBuffer const& iBuffer) {
+   if(usesEventBuffer_) {
+     eventBlob_ = iBuffer.view(eventBlobStart_, eventBlobLength_);
+     if(hashBlobs_) {
+       blobHash_ = hashBlob(eventBlob_);
+     }
+     ++nInEventBuffer_;
+   }
+ }
+ //number of times the data product was serialized into an EventSerializationBuffer
+ unsigned long long nInEventBuffer() const { return nInEventBuffer_; }
+
+ //Until the next serialization, blob() gives iBlob which was serialized
+ // earlier with the same serialization, e.g. by the Source's file.
+ void useSerialized(BlobView iBlob) {
+   serialized_ = iBlob;
+   usesSerialized_ = true;
+   usesEventBuffer_ = false;
+   ++nPassedThrough_;
+   passedThroughBytes_ += iBlob.size();
+ }
+ unsigned long long nPassedThrough() const { return nPassedThrough_; }
+ unsigned long long passedThroughBytes() const { return passedThroughBytes_; }
+
+ BlobView blob() const { return usesSerialized_ ? serialized_ : (usesEventBuffer_ ? eventBlob_ : serializedBlob()); }
+
+ //When set, each serialization also computes the hash of its blob in the
+ // same task so blobHash does not add work to whoever writes the blob.
+ void setHashBlobs(bool iHash) { hashBlobs_ = iHash; }
+ bool hashBlobs() const { return hashBlobs_; }
+ //the hash of blob(), computed here for bytes given by useSerialized
+ uint64_t blobHash() const { return usesSerialized_ ? hashBlob(serialized_) : blobHash_; }
+ static uint64_t hashBlob(BlobView);
+
+ //Top level collections with more than iElements elements are serialized
+ // in chunks by parallel tasks. Ignored by serializations which can not.
+ virtual void setChunkElements(unsigned int iElements) = 0;
+ //number of serializations which were split into chunks
+ virtual unsigned long long nChunked() const = 0;
 
  virtual std::string_view  name() const = 0;
  virtual char const* className() const = 0;
  virtual std::chrono::microseconds accumulatedTime() const = 0;
+ virtual unsigned int nExpansions() const = 0;
+ virtual std::size_t bufferCapacity() const = 0;
+ virtual SerializedSizeStats const& sizeStats() const = 0;
+ protected:
+ void clearSerialized() {
+   usesSerialized_ = false;
+   usesEventBuffer_ = false;
+ }
+ void setProfiledSize(std::size_t iSize) { profiledSize_ = iSize; }
+ //called after each serialization
+ void serialized() {
+   if(hashBlobs_) {
+     blobHash_ = hashBlob(serializedBlob());
+   }
+ }
+ private:
+ virtual BlobView serializedBlob() const = 0;
+ //appends the data product to iBuffer, false if it was not
+ virtual bool doWorkInto(TBufferFile& iBuffer, void** iAddress, int& oStart, int& oLength) = 0;
+
+ void** deferredAddress_ = nullptr;
+ unsigned long long nDeferred_ = 0;
+ BlobView serialized_;
+ bool usesSerialized_ = false;
+ unsigned long long nPassedThrough_ = 0;
+ unsigned long long passedThroughBytes_ = 0;
+ bool hashBlobs_ = false;
+ uint64_t blobHash_ = 0;
+ //where the blob is in the EventSerializationBuffer
+ BlobView eventBlob_;
+ int eventBlobStart_ = 0;
+ int eventBlobLength_ = 0;
+ bool usesEventBuffer_ = false;
+ bool eventBufferUnusable_ = false;
+ unsigned long long nInEventBuffer_ = 0;
+ std::optional<std::size_t> profiledSize_;
 };
 
 
@@ -31,22 +180,149 @@ template<typename WRAPPER>
 class SerializeProxy final : public SerializeProxyBase {
  public:
  SerializeProxy(std::string_view iName,  TClass* tClass):
-  wrapper_{iName, tClass} {}
+  wrapper_{iName, tClass} {
+    if(auto profile = serializationProfile(iName)) {
+      setProfiledSize(profile->p99Bytes_);
+    }
+  }
 
   void doWorkAsync(tbb::task_group& iGroup, void** iAddress, TaskHolder iCallback) {
+    if(hashBlobs()) {
+      //the hash is computed in the serialization task
+      iGroup.run([this, iAddress, callback=std::move(iCallback)] () {
+          doWork(iAddress);
+          const_cast<TaskHolder&>(callback).doneWaiting();
+        });
+      return;
+    }
+    clearSerialized();
     wrapper_.doWorkAsync(iGroup, iAddress, iCallback);
   }
-  std::vector<char> const& blob() const { return wrapper_.blob(); }
+  void doWork(void** iAddress) {
+    clearSerialized();
+    wrapper_.doWork(iAddress);
+    serialized();
+  }
+
+  void setChunkElements(unsigned int iElements) final {
+    if constexpr(serialize_detail::HasChunks<WRAPPER>::value) {
+      wrapper_.setChunkElements(iElements);
+    }
+  }
+  unsigned long long nChunked() const final {
+    if constexpr(serialize_detail::HasChunks<WRAPPER>::value) {
+      return wrapper_.nChunked();
+    } else {
+      return 0;
+    }
+  }
 
   std::string_view  name() const { return wrapper_.name();}
   char const* className() const { return wrapper_.className();}
   std::chrono::microseconds accumulatedTime() const {return wrapper_.accumulatedTime();}
+  unsigned int nExpansions() const { return wrapper_.nExpansions();}
+  std::size_t bufferCapacity() const { return wrapper_.bufferCapacity();}
+  SerializedSizeStats const& sizeStats() const { return wrapper_.sizeStats();}
  private:
+  BlobView serializedBlob() const { return wrapper_.blob(); }
+  bool doWorkInto(TBufferFile& iBuffer, void** iAddress, int& oStart, int& oLength) final {
+    if constexpr(serialize_detail::HasSerializeInto<WRAPPER>::value) {
+      return wrapper_.serializeInto(iBuffer, iAddress, oStart, oLength);
+    } else {
+      return false;
+    }
+  }
   WRAPPER wrapper_;
 };
  
 
  using SerializeStrategy = ProxyVector<SerializeProxyBase, std::string_view, TClass*>;
 
+ //the data product's serialization is given its own task unless iCoalesceBytes is not 0, see doWorkAsyncOrDefer
+ inline void serializeAsync(SerializeProxyBase& iSerializer, void** iAddress, TaskHolder iCallback, std::size_t iCoalesceBytes) {
+   auto group = iCallback.group();
+   if(iCoalesceBytes == 0) {
+     iSerializer.doWorkAsync(*group, iAddress, std::move(iCallback));
+     return;
+   }
+   iSerializer.doWorkAsyncOrDefer(*group, iAddress, std::move(iCallback), iCoalesceBytes);
+ }
+
+ //uses the bytes the Source passed through if they were serialized with iSerialization, else as serializeAsync
+ inline void serializeOrPassThroughAsync(SerializeProxyBase& iSerializer, DataProductRetriever const& iDataProduct, pds::Serialization iSerialization,
+                                         TaskHolder iCallback, std::size_t iCoalesceBytes) {
+   if(iDataProduct.serialization() == iSerialization) {
+     iSerializer.useSerialized(iDataProduct.serialized());
+     return;
+   }
+   serializeAsync(iSerializer, iDataProduct.address(), std::move(iCallback), iCoalesceBytes);
+ }
+
+ //serializes the data products of a Lane which were deferred by doWorkAsyncOrDefer
+ inline void serializeDeferred(SerializeStrategy& iSerializers) {
+   for(std::size_t i = 0; i < iSerializers.size(); ++i) {
+     iSerializers[i].serializeDeferred();
+   }
+ }
+
+ //serializes the deferred data products of a Lane one after the other into iBuffer
+ inline void serializeDeferred(SerializeStrategy& iSerializers, EventSerializationBuffer& iBuffer) {
+   std::size_t expected = 0;
+   for(std::size_t i = 0; i < iSerializers.size(); ++i) {
+     if(iSerializers[i].deferred()) {
+       expected += iSerializers[i].expectedSize();
+     }
+   }
+   iBuffer.reset(expected);
+   for(std::size_t i = 0; i < iSerializers.size(); ++i) {
+     iSerializers[i].serializeDeferred(iBuffer);
+   }
+   //the buffer no longer grows
+   for(std::size_t i = 0; i < iSerializers.size(); ++i) {
+     iSerializers[i].useEventBuffer(iBuffer);
+   }
+ }
+
+ inline unsigned long long nInEventBuffer(std::vector<SerializeStrategy> const& iSerializersPerLane) {
+   unsigned long long n = 0;
+   for(auto const& serializers: iSerializersPerLane) {
+     for(auto const& s: serializers) {
+       n += s.nInEventBuffer();
+     }
+   }
+   return n;
+ }
+
+ inline unsigned long long nDeferred(std::vector<SerializeStrategy> const& iSerializersPerLane) {
+   unsigned long long n = 0;
+   for(auto const& serializers: iSerializersPerLane) {
+     for(auto const& s: serializers) {
+       n += s.nDeferred();
+     }
+   }
+   return n;
+ }
+
+ inline unsigned long long nChunked(std::vector<SerializeStrategy> const& iSerializersPerLane) {
+   unsigned long long n = 0;
+   for(auto const& serializers: iSerializersPerLane) {
+     for(auto const& s: serializers) {
+       n += s.nChunked();
+     }
+   }
+   return n;
+ }
+
+ //bytes of the data products passed through from the Source, see useSerialized
+ inline unsigned long long passedThroughBytes(std::vector<SerializeStrategy> const& iSerializersPerLane) {
+   unsigned long long n = 0;
+   for(auto const& serializers: iSerializersPerLane) {
+     for(auto const& s: serializers) {
+       n += s.passedThroughBytes();
+     }
+   }
+   return n;
+ }
+
 }
 #endif
@@ -0,0 +1,62 @@
+#if !defined(SerializedSizeStats_h)
+#define SerializedSizeStats_h
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace cce::tf {
+  /**
+     Running statistics of the serialized sizes of one data product. The sizes
+     are kept in a histogram with power of 2 bins so the percentile used to
+     pre-size the serialization buffer can be found without storing the sizes.
+   */
+  class SerializedSizeStats {
+  public:
+    void fill(std::size_t iSize) {
+      ++bins_[bin(iSize)];
+      ++nEntries_;
+      total_ += iSize;
+      if(iSize > max_) {
+        max_ = iSize;
+      }
+    }
+
+    //upper edge of the bin holding the 99th percentile size, never more than the largest size seen
+    std::size_t p99() const {
+      if(nEntries_ == 0) {
+        return 0;
+      }
+      auto const limit = nEntries_ - nEntries_/100;
+      std::uint64_t sum = 0;
+      for(unsigned int i=0; i< kNBins; ++i) {
+        sum += bins_[i];
+        if(sum >= limit) {
+          std::size_t edge = std::size_t(1) << i;
+          return edge < max_ ? edge : max_;
+        }
+      }
+      return max_;
+    }
+
+    std::size_t max() const { return max_;}
+    std::uint64_t nEntries() const { return nEntries_;}
+    std::uint64_t total() const { return total_;}
+  private:
+    static constexpr unsigned int kNBins = 8*sizeof(std::size_t);
+    static unsigned int bin(std::size_t iSize) {
+      //smallest i such that iSize <= 2^i
+      unsigned int i=0;
+      while(i < kNBins-1 and (std::size_t(1) << i) < iSize) {
+        ++i;
+      }
+      return i;
+    }
+
+    std::array<std::uint64_t, kNBins> bins_ = {};
+    std::uint64_t nEntries_ = 0;
+    std::uint64_t total_ = 0;
+    std::size_t max_ = 0;
+  };
+}
+#endif
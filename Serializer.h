@@ -4,17 +4,19 @@
 #include <vector>
 #include "TBufferFile.h"
 #include "TClass.h"
+#include "BlobView.h"
 
 namespace cce::tf {
 class Serializer {
 public:
   Serializer() : bufferFile_{TBuffer::kWrite} {}
 
-  Serializer(Serializer&& ):
-    bufferFile_{TBuffer::kWrite} {}
+  //keep any capacity the buffer has already grown to
+  Serializer(Serializer&& iOther):
+    bufferFile_{TBuffer::kWrite, iOther.bufferFile_.BufferSize()} {}
 
-  Serializer(Serializer const&):
-    bufferFile_{TBuffer::kWrite} {}
+  Serializer(Serializer const& iOther):
+    bufferFile_{TBuffer::kWrite, iOther.bufferFile_.BufferSize()} {}
 
   std::vector<char> serialize(void const* address, TClass* tClass) {
     bufferFile_.Reset();
@@ -24,6 +26,21 @@ public:
     return blob;
   }
 
+  //Avoids copying the serialized data product. The view is valid until the next call.
+  BlobView serializeToView(void const* address, TClass* tClass) {
+    bufferFile_.Reset();
+    tClass->WriteBuffer(bufferFile_, const_cast<void*>(address));
+    return BlobView(bufferFile_.Buffer(), bufferFile_.Length());
+  }
+
+  int capacity() const { return bufferFile_.BufferSize(); }
+  //grows the buffer once up front rather than through repeated expansions while writing
+  void reserve(int iSize) {
+    if(iSize > bufferFile_.BufferSize()) {
+      bufferFile_.Expand(iSize, false);
+    }
+  }
+
 private:
   TBufferFile bufferFile_;
 };
@@ -4,10 +4,14 @@
 #include <vector>
 #include <chrono>
 #include "TClass.h"
+#include "SerializedSizeStats.h"
 
 #include "tbb/task_group.h"
 #include "Serializer.h"
 #include "TaskHolder.h"
+#include "Tracer.h"
+#include "PerfCounters.h"
+#include "ProductProfile.h"
 
 
 namespace cce::tf {
@@ -15,29 +19,70 @@ class SerializerWrapper {
 public:
  SerializerWrapper(std::string_view iName,  TClass* tClass):
   name_{iName}, class_(tClass), serializer_{},
-  accumulatedTime_{std::chrono::microseconds::zero()} {}
+  accumulatedTime_{std::chrono::microseconds::zero()} {
+    if(auto profile = serializationProfile(iName)) {
+      serializer_.reserve(profile->p99Bytes_);
+    }
+  }
 
   void doWorkAsync(tbb::task_group& iGroup, void** iAddress, TaskHolder iCallback) {
     iGroup.run([this, iAddress, callback=std::move(iCallback)] () {
-	{
-	  auto start = std::chrono::high_resolution_clock::now();
-	  blob_ = serializer_.serialize(*iAddress, class_);
-	  accumulatedTime_ += std::chrono::duration_cast<decltype(accumulatedTime_)>(std::chrono::high_resolution_clock::now() - start);
-	}
+	doWork(iAddress);
 	const_cast<TaskHolder&>(callback).doneWaiting();
       });
   }
-  std::vector<char> const& blob() const {return blob_;}
+  //serializes in the calling task
+  void doWork(void** iAddress) {
+    TraceScope scope(name_, "serialize");
+    PerfScope perf(PerfCounters::kSerialize);
+    auto start = std::chrono::high_resolution_clock::now();
+    serializer_.reserve(sizeStats_.p99());
+    auto const capacity = serializer_.capacity();
+    blob_ = serializer_.serializeToView(*iAddress, class_);
+    if(serializer_.capacity() > capacity) {
+      ++nExpansions_;
+    }
+    sizeStats_.fill(blob_.size());
+    accumulatedTime_ += std::chrono::duration_cast<decltype(accumulatedTime_)>(std::chrono::high_resolution_clock::now() - start);
+  }
+  //Appends the data product to iBuffer, see EventSerializationBuffer. Returns false, leaving
+  // iBuffer as it was, if the bytes refer to positions in the buffer, e.g. for pointers, as
+  // those could not be read without the bytes before the data product.
+  bool serializeInto(TBufferFile& iBuffer, void** iAddress, int& oStart, int& oLength) {
+    TraceScope scope(name_, "serialize");
+    PerfScope perf(PerfCounters::kSerialize);
+    auto start = std::chrono::high_resolution_clock::now();
+    oStart = iBuffer.Length();
+    iBuffer.ResetMap();
+    class_->WriteBuffer(iBuffer, *iAddress);
+    if(iBuffer.GetMapCount() != 0) {
+      iBuffer.SetBufferOffset(oStart);
+      iBuffer.ResetMap();
+      return false;
+    }
+    oLength = iBuffer.Length() - oStart;
+    sizeStats_.fill(oLength);
+    accumulatedTime_ += std::chrono::duration_cast<decltype(accumulatedTime_)>(std::chrono::high_resolution_clock::now() - start);
+    return true;
+  }
+  BlobView blob() const {return blob_;}
 
   std::string_view  name() const {return name_;}
   char const* className() const { return class_->GetName(); }
   std::chrono::microseconds accumulatedTime() const { return accumulatedTime_;}
+  //number of times the buffer had to grow while serializing
+  unsigned int nExpansions() const { return nExpansions_;}
+  //bytes held by the serialization buffer
+  std::size_t bufferCapacity() const { return serializer_.capacity();}
+  SerializedSizeStats const& sizeStats() const { return sizeStats_;}
 private:
-  std::vector<char> blob_;
+  BlobView blob_;
   std::string_view name_;
   TClass* class_;
   Serializer serializer_;
   std::chrono::microseconds accumulatedTime_;
+  SerializedSizeStats sizeStats_;
+  unsigned int nExpansions_ = 0;
 };
 }
 #endif
@@ -0,0 +1,145 @@
+#include "ShardedOutputer.h"
+#include "OutputerFactory.h"
+#include "ConfigurationParameters.h"
+#include <iostream>
+#include <fstream>
+
+using namespace cce::tf;
+
+ShardedOutputer::ShardedOutputer(std::string iManifestName, std::string iOutputerType,
+                                 std::vector<std::string> iShardFileNames, std::vector<std::unique_ptr<OutputerBase>> iShards):
+  manifestName_{std::move(iManifestName)},
+  outputerType_{std::move(iOutputerType)},
+  shardFileNames_{std::move(iShardFileNames)},
+  shards_{std::move(iShards)},
+  nEventsInShards_(shards_.size())
+{}
+
+ShardedOutputer::~ShardedOutputer() {
+  //the shards finish their files when they are deleted
+  shards_.clear();
+  writeManifest();
+}
+
+void ShardedOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) {
+  shards_[shardIndex(iLaneIndex)]->setupForLane(laneInShard(iLaneIndex), iDPs);
+}
+
+void ShardedOutputer::productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const {
+  shards_[shardIndex(iLaneIndex)]->productReadyAsync(laneInShard(iLaneIndex), iDataProduct, std::move(iCallback));
+}
+
+bool ShardedOutputer::usesProductReadyAsync() const {
+  return shards_[0]->usesProductReadyAsync();
+}
+
+void ShardedOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+  auto const shard = shardIndex(iLaneIndex);
+  ++nEventsInShards_[shard];
+  shards_[shard]->outputAsync(laneInShard(iLaneIndex), iEventIndex, iEventID, std::move(iCallback));
+}
+
+void ShardedOutputer::readyForEventAsync(unsigned int iLaneIndex, TaskHolder iCallback) const {
+  shards_[shardIndex(iLaneIndex)]->readyForEventAsync(laneInShard(iLaneIndex), std::move(iCallback));
+}
+
+bool ShardedOutputer::usesReadyForEventAsync() const {
+  return shards_[0]->usesReadyForEventAsync();
+}
+
+void ShardedOutputer::finishAsync(TaskHolder iCallback) const {
+  for(auto const& shard: shards_) {
+    iCallback.group()->run([shard = shard.get(), iCallback]() { shard->finishAsync(iCallback); });
+  }
+}
+
+void ShardedOutputer::printSummary() const {
+  std::cout <<"ShardedOutputer\n";
+  for(unsigned int i=0; i<shards_.size(); ++i) {
+    std::cout <<" shard "<<i<<" "<<shardFileNames_[i]<<" events: "<<nEventsInShards_[i].load()<<"\n";
+    shards_[i]->printSummary();
+  }
+}
+
+void ShardedOutputer::fillProfile(ProductProfile& oProfile) const {
+  for(auto const& shard: shards_) {
+    shard->fillProfile(oProfile);
+  }
+}
+
+std::string ShardedOutputer::shardFileName(std::string const& iFileName, unsigned int iIndex) {
+  auto const suffix = "_"+std::to_string(iIndex);
+  auto const dot = iFileName.rfind('.');
+  auto const slash = iFileName.rfind('/');
+  if(dot == std::string::npos or (slash != std::string::npos and dot < slash)) {
+    return iFileName+suffix;
+  }
+  return iFileName.substr(0,dot)+suffix+iFileName.substr(dot);
+}
+
+void ShardedOutputer::writeManifest() const {
+  //first line is the Outputer used, then one line per shard with the number of events and the file name
+  std::ofstream manifest(manifestName_);
+  manifest <<outputerType_<<"\n";
+  for(unsigned int i=0; i<shardFileNames_.size(); ++i) {
+    manifest <<nEventsInShards_[i].load()<<" "<<shardFileNames_[i]<<"\n";
+  }
+}
+
+namespace {
+  class Maker : public OutputerMakerBase {
+  public:
+    Maker(): OutputerMakerBase("ShardedOutputer") {}
+
+    std::unique_ptr<OutputerBase> create(unsigned int iNLanes, ConfigurationParameters const& params) const final {
+      auto fileName = params.get<std::string>("fileName");
+      if(not fileName) {
+        std::cout <<"no file name given for ShardedOutputer\n";
+        return {};
+      }
+      auto outputerType = params.get<std::string>("outputer");
+      if(not outputerType) {
+        std::cout <<"no outputer given for ShardedOutputer\n";
+        return {};
+      }
+      auto nShards = params.get<unsigned int>("shards", 2);
+      if(nShards == 0 or nShards > iNLanes) {
+        std::cout <<"ShardedOutputer shards must be between 1 and the number of lanes "<<iNLanes<<std::endl;
+        return {};
+      }
+
+      //all other parameters are for the shards
+      auto keyValues = params.takeUnusedKeyValues();
+      if(keyValues.find("orderedOutput") != keyValues.end()) {
+        //a shard only sees some of the event indices
+        std::cout <<"orderedOutput can not be used with ShardedOutputer"<<std::endl;
+        return {};
+      }
+      std::vector<std::string> shardFileNames;
+      std::vector<std::unique_ptr<OutputerBase>> shards;
+      shardFileNames.reserve(nShards);
+      shards.reserve(nShards);
+      for(unsigned int i=0; i<nShards; ++i) {
+        shardFileNames.push_back(ShardedOutputer::shardFileName(*fileName, i));
+        keyValues["fileName"] = shardFileNames.back();
+        ConfigurationParameters shardParams(keyValues);
+        auto shard = OutputerFactory::get()->create(*outputerType, ShardedOutputer::nLanesInShard(iNLanes, nShards, i), shardParams);
+        if(not shard) {
+          return {};
+        }
+        auto unusedOptions = shardParams.unusedKeys();
+        if(not unusedOptions.empty()) {
+          std::cout <<"Unused options in "<<*outputerType<<"\n";
+          for(auto const& key: unusedOptions) {
+            std::cout <<"  '"<<key<<"'"<<std::endl;
+          }
+          return {};
+        }
+        shards.push_back(std::move(shard));
+      }
+      return std::make_unique<ShardedOutputer>(*fileName+".manifest", *outputerType, std::move(shardFileNames), std::move(shards));
+    }
+  };
+
+  Maker s_maker;
+}
@@ -0,0 +1,61 @@
+#if !defined(ShardedOutputer_h)
+#define ShardedOutputer_h
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+
+#include "OutputerBase.h"
+
+namespace cce::tf {
+  /**
+     Spreads the Lanes over several Outputers, each writing its own file, so
+     there is no single output queue all Lanes must go through. Lane i goes to
+     shard i % (number of shards). At the end a manifest is written listing the
+     files and the number of events in each so ShardedSource can read them back
+     as one dataset.
+   */
+class ShardedOutputer : public OutputerBase {
+ public:
+  ShardedOutputer(std::string iManifestName, std::string iOutputerType,
+                  std::vector<std::string> iShardFileNames, std::vector<std::unique_ptr<OutputerBase>> iShards);
+
+  ~ShardedOutputer() final;
+
+  void setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) final;
+
+  void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const final;
+  bool usesProductReadyAsync() const final;
+
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+
+  void readyForEventAsync(unsigned int iLaneIndex, TaskHolder iCallback) const final;
+  bool usesReadyForEventAsync() const final;
+
+  //the shards finish their files in parallel
+  void finishAsync(TaskHolder iCallback) const final;
+
+  void printSummary() const final;
+  void fillProfile(ProductProfile&) const final;
+
+  //inserts _<index> before the extension of iFileName
+  static std::string shardFileName(std::string const& iFileName, unsigned int iIndex);
+  //the number of the iNLanes Lanes which go to shard iIndex
+  static unsigned int nLanesInShard(unsigned int iNLanes, unsigned int iNShards, unsigned int iIndex) {
+    return iNLanes/iNShards + (iIndex < iNLanes % iNShards ? 1 : 0);
+  }
+ private:
+  unsigned int shardIndex(unsigned int iLaneIndex) const { return iLaneIndex % shards_.size(); }
+  unsigned int laneInShard(unsigned int iLaneIndex) const { return iLaneIndex / shards_.size(); }
+
+  void writeManifest() const;
+
+  std::string manifestName_;
+  std::string outputerType_;
+  std::vector<std::string> shardFileNames_;
+  std::vector<std::unique_ptr<OutputerBase>> shards_;
+  mutable std::vector<std::atomic<unsigned long long>> nEventsInShards_;
+};
+}
+#endif
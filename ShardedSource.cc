@@ -0,0 +1,111 @@
+#include "ShardedSource.h"
+#include "SourceFactory.h"
+
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+
+using namespace cce::tf;
+
+ShardedSource::ShardedSource(unsigned long long iNEvents, std::vector<std::unique_ptr<SharedSourceBase>> iShards,
+                             std::vector<unsigned long long> const& iNEventsInShards):
+  SharedSourceBase(iNEvents),
+  shards_{std::move(iShards)}
+{
+  firstEventInShards_.reserve(iNEventsInShards.size()+1);
+  long first = 0;
+  for(auto n: iNEventsInShards) {
+    firstEventInShards_.push_back(first);
+    first += n;
+  }
+  firstEventInShards_.push_back(first);
+}
+
+std::pair<unsigned int, long> ShardedSource::locate(long iEventIndex) const {
+  //the last shard whose first event is not after iEventIndex
+  auto it = std::upper_bound(firstEventInShards_.begin(), firstEventInShards_.end()-1, iEventIndex) - 1;
+  return {static_cast<unsigned int>(it - firstEventInShards_.begin()), iEventIndex - *it};
+}
+
+std::vector<DataProductRetriever>& ShardedSource::dataProducts(unsigned int iLane, long iEventIndex) {
+  auto [shard, index] = locate(iEventIndex);
+  return shards_[shard]->dataProducts(iLane, index);
+}
+
+EventIdentifier ShardedSource::eventIdentifier(unsigned int iLane, long iEventIndex) {
+  auto [shard, index] = locate(iEventIndex);
+  return shards_[shard]->eventIdentifier(iLane, index);
+}
+
+void ShardedSource::readEventAsync(unsigned int iLane, long iEventIndex, OptionalTaskHolder iTask) {
+  if(iEventIndex >= firstEventInShards_.back()) {
+    return;
+  }
+  auto [shard, index] = locate(iEventIndex);
+  shards_[shard]->gotoEventAsync(iLane, index, std::move(iTask));
+}
+
+void ShardedSource::printSummary() const {
+  std::cout <<"\nShardedSource\n";
+  for(unsigned int i=0; i<shards_.size(); ++i) {
+    std::cout <<" shard "<<i<<" events: "<<firstEventInShards_[i+1]-firstEventInShards_[i];
+    shards_[i]->printSummary();
+  }
+}
+
+namespace {
+  class Maker : public SourceMakerBase {
+  public:
+    Maker(): SourceMakerBase("ShardedSource") {}
+    std::unique_ptr<SharedSourceBase> create(unsigned int iNLanes, unsigned long long iNEvents, ConfigurationParameters const& params) const final {
+      auto fileName = params.get<std::string>("fileName");
+      if(not fileName) {
+        std::cout <<"no manifest file name given for ShardedSource\n";
+        return {};
+      }
+      auto sourceType = params.get<std::string>("source");
+      if(not sourceType) {
+        std::cout <<"no source given for ShardedSource\n";
+        return {};
+      }
+      std::ifstream manifest(*fileName);
+      std::string outputerType;
+      if(not (manifest >> outputerType)) {
+        std::cout <<"unable to read manifest "<<*fileName<<std::endl;
+        return {};
+      }
+
+      //all other parameters are for the shards
+      auto keyValues = params.takeUnusedKeyValues();
+      std::vector<std::unique_ptr<SharedSourceBase>> shards;
+      std::vector<unsigned long long> nEventsInShards;
+      unsigned long long nEvents;
+      std::string shardFileName;
+      while(manifest >> nEvents >> shardFileName) {
+        keyValues["fileName"] = shardFileName;
+        ConfigurationParameters shardParams(keyValues);
+        auto shard = SourceFactory::get()->create(*sourceType, iNLanes, nEvents, shardParams);
+        if(not shard) {
+          return {};
+        }
+        auto unusedOptions = shardParams.unusedKeys();
+        if(not unusedOptions.empty()) {
+          std::cout <<"Unused options in "<<*sourceType<<"\n";
+          for(auto const& key: unusedOptions) {
+            std::cout <<"  '"<<key<<"'"<<std::endl;
+          }
+          return {};
+        }
+        shards.push_back(std::move(shard));
+        nEventsInShards.push_back(nEvents);
+      }
+      if(shards.empty()) {
+        std::cout <<"no shards listed in manifest "<<*fileName<<std::endl;
+        return {};
+      }
+      return std::make_unique<ShardedSource>(iNEvents, std::move(shards), nEventsInShards);
+    }
+  };
+
+  Maker s_maker;
+}
@@ -0,0 +1,39 @@
+#if !defined(ShardedSource_h)
+#define ShardedSource_h
+
+#include <vector>
+#include <memory>
+#include <utility>
+
+#include "SharedSourceBase.h"
+
+namespace cce::tf {
+  /**
+     Reads the files written by ShardedOutputer as one dataset. Each file is
+     read by its own Source and the event indices run over the files in the
+     order given in the manifest. Every shard Source is made for all the Lanes
+     since any Lane may read from any file.
+   */
+class ShardedSource : public SharedSourceBase {
+ public:
+  ShardedSource(unsigned long long iNEvents, std::vector<std::unique_ptr<SharedSourceBase>> iShards,
+                std::vector<unsigned long long> const& iNEventsInShards);
+
+  size_t numberOfDataProducts() const final { return shards_[0]->numberOfDataProducts(); }
+  std::vector<DataProductRetriever>& dataProducts(unsigned int iLane, long iEventIndex) final;
+  EventIdentifier eventIdentifier(unsigned int iLane, long iEventIndex) final;
+
+  void printSummary() const final;
+
+ private:
+  void readEventAsync(unsigned int iLane, long iEventIndex, OptionalTaskHolder iTask) final;
+
+  //the shard holding iEventIndex and the index of the event within that shard
+  std::pair<unsigned int, long> locate(long iEventIndex) const;
+
+  std::vector<std::unique_ptr<SharedSourceBase>> shards_;
+  //index of the first event of each shard followed by the total number of events
+  std::vector<long> firstEventInShards_;
+};
+}
+#endif
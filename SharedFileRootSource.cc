@@ -0,0 +1,137 @@
+#include "SharedFileRootSource.h"
+#include "SourceFactory.h"
+#include "summarize_queue.h"
+
+#include <iostream>
+#include <stdexcept>
+#include "TBranch.h"
+#include "TTree.h"
+#include "TFile.h"
+#include "TKey.h"
+#include "TClass.h"
+#include "RootIMT.h"
+
+using namespace cce::tf;
+
+SharedFileRootSource::SharedFileRootSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iName,
+                                           std::size_t iCacheSize, ProductSelector const& iSelector):
+  SharedSourceBase(iNEvents),
+  file_{TFile::Open(iName.c_str())},
+  eventAuxReader_{*file_},
+  readTime_{std::chrono::microseconds::zero()}
+{
+  auto key = file_->GetKey("Events");
+  if(not key) {
+    std::cout <<"no Events TTree in file "<<iName<<std::endl;
+    throw std::runtime_error("no Events TTree");
+  }
+  laneInfos_.reserve(iNLanes);
+  for(unsigned int i = 0; i< iNLanes; ++i) {
+    //reading from the key, rather than using Get, gives a new TTree each time
+    auto events = dynamic_cast<TTree*>(key->ReadObj());
+    //by default each TTree would have its own TTreeCache
+    events->SetCacheSize(iCacheSize);
+    events->SetImplicitMT(rootIMTForSources());
+    laneInfos_.emplace_back(events, iSelector);
+  }
+  nEvents_ = laneInfos_[0].events_->GetEntries();
+}
+
+SharedFileRootSource::~SharedFileRootSource() {
+  //the TTrees must go away before the TFile
+  laneInfos_.clear();
+}
+
+SharedFileRootSource::LaneInfo::LaneInfo(TTree* iEvents, ProductSelector const& iSelector):
+  events_{iEvents}
+{
+  auto l = events_->GetListOfBranches();
+
+  const std::string eventAuxiliaryBranchName{"EventAuxiliary"};
+  const std::string eventIDBranchName{"EventID"};
+
+  dataProducts_.reserve(l->GetEntriesFast());
+  branches_.reserve(l->GetEntriesFast());
+
+  for( int i=0; i< l->GetEntriesFast(); ++i) {
+    auto b = dynamic_cast<TBranch*>((*l)[i]);
+    if(eventIDBranchName == b->GetName()) {
+      eventIDBranch_ = b;
+      continue;
+    }
+    b->SetupAddresses();
+    if(not iSelector.keep(b->GetName())) {
+      if(eventAuxiliaryBranchName == b->GetName()) {
+        //still needed for the event identifier
+        eventAuxBranch_ = b;
+        readEventAuxSeparately_ = true;
+      }
+      continue;
+    }
+    TClass* class_ptr=nullptr;
+    EDataType type;
+    b->GetExpectedType(class_ptr,type);
+
+    dataProducts_.emplace_back(dataProducts_.size(),
+                               reinterpret_cast<void**>(b->GetAddress()),
+                               b->GetName(),
+                               class_ptr,
+                               &delayedReader_);
+    branches_.emplace_back(b);
+    if(eventAuxiliaryBranchName == dataProducts_.back().name()) {
+      eventAuxBranch_ = b;
+    }
+  }
+}
+
+void SharedFileRootSource::readEventAsync(unsigned int iLane, long iEventIndex, OptionalTaskHolder iTask) {
+  if(iEventIndex >= nEvents_) {
+    return;
+  }
+  auto temptask = iTask.releaseToTaskHolder();
+  auto group = temptask.group();
+  queue_.push(*group, [task=std::move(temptask), this, iLane, iEventIndex]() mutable {
+      auto start = std::chrono::high_resolution_clock::now();
+      auto& laneInfo = laneInfos_[iLane];
+      if(laneInfo.eventIDBranch_) {
+        laneInfo.eventIDBranch_->SetAddress(&laneInfo.id_);
+        laneInfo.eventIDBranch_->GetEntry(iEventIndex);
+      } else if(laneInfo.readEventAuxSeparately_) {
+        laneInfo.eventAuxBranch_->GetEntry(iEventIndex);
+      }
+      auto it = laneInfo.dataProducts_.begin();
+      for(auto b: laneInfo.branches_) {
+        (it++)->setSize( b->GetEntry(iEventIndex) );
+      }
+      if(not laneInfo.eventIDBranch_) {
+        laneInfo.id_ = eventAuxReader_.doWork(laneInfo.eventAuxBranch_);
+      }
+      readTime_ += std::chrono::duration_cast<decltype(readTime_)>(std::chrono::high_resolution_clock::now() - start);
+      task.doneWaiting();
+    });
+}
+
+void SharedFileRootSource::printSummary() const {
+  std::cout <<"\nSource time: "<<readTime_.count()<<"us\n"
+    "   bytes read: "<<file_->GetBytesRead()<<"\n";
+  summarize_queue("read", queue_);
+  std::cout<<std::endl;
+}
+
+namespace {
+    class Maker : public SourceMakerBase {
+  public:
+    Maker(): SourceMakerBase("SharedFileRootSource") {}
+      std::unique_ptr<SharedSourceBase> create(unsigned int iNLanes, unsigned long long iNEvents, ConfigurationParameters const& params) const final {
+        auto fileName = params.get<std::string>("fileName");
+        if(not fileName) {
+          std::cout <<"no file name given\n";
+          return {};
+        }
+        ProductSelector selector{params.get<std::string>("products", "")};
+        return std::make_unique<SharedFileRootSource>(iNLanes, iNEvents, *fileName, params.get<std::size_t>("cacheSize", 0), selector);
+    }
+    };
+
+  Maker s_maker;
+}
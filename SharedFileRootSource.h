@@ -0,0 +1,82 @@
+#if !defined(SharedFileRootSource_h)
+#define SharedFileRootSource_h
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <chrono>
+
+#include "DataProductRetriever.h"
+#include "DelayedProductRetriever.h"
+#include "EventAuxReader.h"
+#include "ProductSelector.h"
+
+#include "SharedSourceBase.h"
+#include "SerialTaskQueue.h"
+#include "TFile.h"
+#include "PerLaneCounter.h"
+
+class TBranch;
+class TTree;
+
+namespace cce::tf {
+  class SharedFileRootDelayedRetriever : public DelayedProductRetriever {
+    void getAsync(DataProductRetriever&, int index, TaskHolder) final {}
+  };
+
+  /**
+     Reads a standard ROOT file which is opened only once. Each Lane reads the
+     `Events` TTree into its own TTree object so it owns its branch buffers
+     while the TFile, its metadata and the streamer information are shared.
+     Reads from the file are serialized for thread-safety.
+   */
+  class SharedFileRootSource : public SharedSourceBase {
+  public:
+    SharedFileRootSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iName,
+                         std::size_t iCacheSize = 0, ProductSelector const& iSelector = ProductSelector());
+    SharedFileRootSource(SharedFileRootSource&&) = delete;
+    SharedFileRootSource(SharedFileRootSource const&) = delete;
+    ~SharedFileRootSource();
+
+    size_t numberOfDataProducts() const final {return laneInfos_[0].dataProducts_.size();}
+    std::vector<DataProductRetriever>& dataProducts(unsigned int iLane, long iEventIndex) final {
+      return laneInfos_[iLane].dataProducts_;
+    }
+    EventIdentifier eventIdentifier(unsigned int iLane, long iEventIndex) final {
+      return laneInfos_[iLane].id_;
+    }
+
+    void printSummary() const final;
+  private:
+    void readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder) final;
+
+    std::unique_ptr<TFile> file_;
+    EventAuxReader eventAuxReader_;
+    long nEvents_;
+    SerialTaskQueue queue_;
+    std::chrono::microseconds readTime_;
+
+    struct alignas(kCacheLineSize) LaneInfo {
+      LaneInfo(TTree* iEvents, ProductSelector const&);
+
+      LaneInfo(LaneInfo&&) = default;
+      LaneInfo(LaneInfo const&) = delete;
+
+      LaneInfo& operator=(LaneInfo&&) = default;
+      LaneInfo& operator=(LaneInfo const&) = delete;
+
+      //owned by the Lane, not by the TFile
+      std::unique_ptr<TTree> events_;
+      SharedFileRootDelayedRetriever delayedReader_;
+      TBranch* eventIDBranch_ = nullptr;
+      TBranch* eventAuxBranch_ = nullptr;
+      //set if EventAuxiliary is not one of the selected data products
+      bool readEventAuxSeparately_ = false;
+      EventIdentifier id_;
+      std::vector<DataProductRetriever> dataProducts_;
+      std::vector<TBranch*> branches_;
+    };
+    std::vector<LaneInfo> laneInfos_;
+  };
+}
+#endif
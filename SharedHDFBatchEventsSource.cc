@@ -0,0 +1,357 @@
+#include "SharedHDFBatchEventsSource.h"
+#include "SourceFactory.h"
+#include "summarize_queue.h"
+#include "Deserializer.h"
+#include "UnrolledDeserializer.h"
+#include "FixedLayoutDeserializer.h"
+#include "FunctorTask.h"
+
+#include "TClass.h"
+#include "tbb/parallel_for.h"
+
+#include <cassert>
+#include <iostream>
+#include <sstream>
+
+using namespace cce::tf;
+
+namespace {
+  //the values of HDFBatchEventsOutputer::CompressionChoice
+  constexpr int kCompressEvents = 1;
+  constexpr int kCompressBatch = 2;
+  constexpr int kCompressBoth = 3;
+
+  template<typename T>
+  std::vector<T> readAll(hid_t iGroup, const char* iName, hid_t iMemType) {
+    auto dset = hdf5::Dataset::open(iGroup, iName);
+    auto space = hdf5::Dataspace::get_space(dset);
+    hsize_t dims[1];
+    H5Sget_simple_extent_dims(space, dims, nullptr);
+    std::vector<T> values(dims[0]);
+    if(not values.empty()) {
+      H5Dread(dset, iMemType, H5S_ALL, H5S_ALL, H5P_DEFAULT, values.data());
+    }
+    return values;
+  }
+
+  std::string readString(hid_t iGroup, const char* iName) {
+    auto aid = hdf5::Attribute::open(iGroup, iName);
+    auto tid = H5Aget_type(aid);
+    char* value;
+    H5Aread(aid, tid, &value);
+    H5Tclose(tid);
+    std::string s(value);
+    free(value);
+    return s;
+  }
+
+  int readInt(hid_t iGroup, const char* iName) {
+    int value = 0;
+    auto aid = hdf5::Attribute::open(iGroup, iName);
+    H5Aread(aid, H5T_NATIVE_INT, &value);
+    return value;
+  }
+}
+
+SharedHDFBatchEventsSource::SharedHDFBatchEventsSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iName,
+                                                       ProductSelector const& iSelector) :
+  SharedSourceBase(iNEvents),
+  file_(hdf5::File::open(iName.c_str())),
+  lumi_(hdf5::Group::open(file_, "/Lumi")),
+  products_(hdf5::Dataset::open(lumi_, "Products")),
+  readTime_{std::chrono::microseconds::zero()}
+{
+  if(H5Lexists(lumi_, "BatchSizes", H5P_DEFAULT) <= 0 or H5Aexists(lumi_, "ProductNames") <= 0) {
+    std::cout <<"file "<<iName<<" was written by an HDFBatchEventsOutputer which did not store its batch sizes"<<std::endl;
+    throw std::runtime_error("no 'BatchSizes' dataset");
+  }
+  if(auto c = pds::toCompression(readString(lumi_, "Compression"))) {
+    compression_ = *c;
+  } else {
+    throw std::runtime_error("unknown compression algorithm");
+  }
+  auto const choice = readInt(lumi_, "CompressionChoice");
+  batchCompressed_ = choice == kCompressBatch or choice == kCompressBoth;
+  eventsCompressed_ = choice == kCompressEvents or choice == kCompressBoth;
+  pds::Serialization serialization{readInt(lumi_, "Serialization")};
+  auto attr_r = hdf5::Attribute::open(lumi_, "run");
+  H5Aread(attr_r, H5T_NATIVE_UINT, &run_);
+  auto attr_l = hdf5::Attribute::open(lumi_, "lumisec");
+  H5Aread(attr_l, H5T_NATIVE_UINT, &lumi_num_);
+
+  std::vector<pds::ProductInfo> productInfo;
+  {
+    std::istringstream names(readString(lumi_, "ProductNames"));
+    std::string name;
+    unsigned int index = 0;
+    while(std::getline(names, name)) {
+      productInfo.emplace_back(name, index++, readString(lumi_, name.c_str()));
+    }
+  }
+  nFileProducts_ = productInfo.size();
+  productMap_ = pds::selectProducts(productInfo, iSelector);
+
+  //the index of the file is small compared to the data products so is read once
+  eventIDs_ = readAll<unsigned long long>(lumi_, "EventIDs", H5T_NATIVE_ULLONG);
+  offsets_ = readAll<uint32_t>(lumi_, "Offsets", H5T_NATIVE_UINT);
+  auto const batchSizes = readAll<unsigned long long>(lumi_, "BatchSizes", H5T_NATIVE_ULLONG);
+  unsigned long long event = 0;
+  unsigned long long bytes = 0;
+  batches_.reserve(batchSizes.size()/2);
+  for(std::size_t i = 0; i+1 < batchSizes.size(); i += 2) {
+    batches_.push_back({event, batchSizes[i], bytes, batchSizes[i+1]});
+    event += batchSizes[i];
+    bytes += batchSizes[i+1];
+  }
+  if(event > eventIDs_.size() or event*(nFileProducts_+2) > offsets_.size()) {
+    throw std::runtime_error("the BatchSizes dataset of "+iName+" holds more events than the file");
+  }
+
+  laneInfos_.reserve(iNLanes);
+  for(unsigned int i = 0; i< iNLanes; ++i) {
+    DeserializeStrategy strategy;
+    switch(serialization) {
+    case pds::Serialization::kRoot: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<Deserializer>>(); break;
+    }
+    case pds::Serialization::kRootUnrolled: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<UnrolledDeserializer>>(); break;
+    }
+    case pds::Serialization::kNativeUnrolled: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<NativeUnrolledDeserializer>>(); break;
+    }
+    case pds::Serialization::kFixedLayout: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<FixedLayoutDeserializer>>(); break;
+    }
+    }
+    laneInfos_.emplace_back(productInfo, std::move(strategy));
+  }
+}
+
+SharedHDFBatchEventsSource::LaneInfo::LaneInfo(std::vector<pds::ProductInfo> const& productInfo, DeserializeStrategy deserialize):
+  deserializers_{std::move(deserialize)},
+  deserializeTime_{std::chrono::microseconds::zero()}
+{
+  dataProducts_.reserve(productInfo.size());
+  dataBuffers_.resize(productInfo.size(), nullptr);
+  deserializers_.reserve(productInfo.size());
+  size_t index =0;
+  for(auto const& pi : productInfo) {
+    TClass* cls = TClass::GetClass(pi.className().c_str());
+    assert(cls);
+    dataBuffers_[index] = cls->New();
+    dataProducts_.emplace_back(index,
+                               &dataBuffers_[index],
+                               pi.name(),
+                               cls,
+                               &delayedRetriever_);
+    deserializers_.emplace_back(cls);
+    ++index;
+  }
+}
+
+SharedHDFBatchEventsSource::LaneInfo::~LaneInfo() {
+  auto it = dataProducts_.begin();
+  for( void * b: dataBuffers_) {
+    it->classType()->Destructor(b);
+    ++it;
+  }
+}
+
+size_t SharedHDFBatchEventsSource::numberOfDataProducts() const {
+  return laneInfos_[0].dataProducts_.size();
+}
+
+std::vector<DataProductRetriever>& SharedHDFBatchEventsSource::dataProducts(unsigned int iLane, long iEventIndex) {
+  return laneInfos_[iLane].dataProducts_;
+}
+
+EventIdentifier SharedHDFBatchEventsSource::eventIdentifier(unsigned int iLane, long iEventIndex) {
+  return laneInfos_[iLane].eventID_;
+}
+
+void SharedHDFBatchEventsSource::readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder iTask) {
+  //only reading from the file and handing out events is done in the queue. Decompression of a batch
+  // happens in its own task and each lane deserializes its event directly from the shared batch.
+  queue_.push(*iTask.group(), [iLane, optTask = std::move(iTask), this]() mutable {
+      auto start = std::chrono::high_resolution_clock::now();
+      unsigned long long eventIndex;
+      if(nextEvent(iLane, *optTask.group(), eventIndex)) {
+        deserializeAsync(iLane, eventIndex, optTask.releaseToTaskHolder());
+      }
+      readTime_ +=std::chrono::duration_cast<decltype(readTime_)>(std::chrono::high_resolution_clock::now() - start);
+    });
+}
+
+bool SharedHDFBatchEventsSource::nextEvent(unsigned int iLane, tbb::task_group& iGroup, unsigned long long& oEventIndex) {
+  if(not currentBatch_ or nextEventInBatch_ == currentBatch_->nEvents_) {
+    currentBatch_ = readAheadBatch_ ? std::move(readAheadBatch_) : readBatch(iGroup);
+    nextEventInBatch_ = 0;
+    if(currentBatch_ and nextBatch_ < batches_.size()) {
+      //read the next batch while the events of this one are being processed
+      queue_.push(iGroup, [this, &iGroup]() {
+          auto start = std::chrono::high_resolution_clock::now();
+          readAheadBatch_ = readBatch(iGroup);
+          readTime_ +=std::chrono::duration_cast<decltype(readTime_)>(std::chrono::high_resolution_clock::now() - start);
+        });
+    }
+  }
+  if(not currentBatch_) {
+    return false;
+  }
+  oEventIndex = currentBatch_->firstEvent_ + nextEventInBatch_;
+  auto& laneInfo = laneInfos_[iLane];
+  laneInfo.eventID_ = {run_, lumi_num_, eventIDs_[oEventIndex]};
+  //the lane's previous event has finished so its batch was already released
+  laneInfo.batch_ = currentBatch_;
+  ++nextEventInBatch_;
+  return true;
+}
+
+void SharedHDFBatchEventsSource::deserializeAsync(unsigned int iLane, unsigned long long iEventIndex, TaskHolder iTask) {
+  auto& group = *iTask.group();
+  auto batch = laneInfos_[iLane].batch_;
+  TaskHolder deserializeTask(group, make_functor_task([this, iEventIndex, task = std::move(iTask), iLane]() {
+      auto& laneInfo = this->laneInfos_[iLane];
+      auto const& batch = *laneInfo.batch_;
+      auto const* eventBegin = batch.uncompressed_.data()+batch.eventStarts_[iEventIndex - batch.firstEvent_];
+      std::vector<uint32_t> offsets(eventOffsets(iEventIndex), eventOffsets(iEventIndex)+nFileProducts_+1);
+
+      auto start = std::chrono::high_resolution_clock::now();
+      pds::deserializeDataProducts(eventBegin, eventBegin+offsets.back(),
+                                   offsets.begin(), offsets.end(),
+                                   laneInfo.dataProducts_, laneInfo.deserializers_, productMap_);
+      laneInfo.deserializeTime_ +=
+        std::chrono::duration_cast<decltype(laneInfo.deserializeTime_)>(std::chrono::high_resolution_clock::now() - start);
+      laneInfo.batch_.reset();
+    }));
+  if(batch->whenUncompressed(std::move(deserializeTask))) {
+    ++nWaitedForDecompression_;
+  }
+}
+
+std::shared_ptr<SharedHDFBatchEventsSource::Batch> SharedHDFBatchEventsSource::readBatch(tbb::task_group& iGroup) {
+  if(nextBatch_ >= batches_.size()) {
+    return {};
+  }
+  auto const& location = batches_[nextBatch_++];
+  auto batch = std::make_shared<Batch>();
+  batch->firstEvent_ = location.firstEvent_;
+  batch->nEvents_ = location.nEvents_;
+  batch->stored_.resize(location.productsSize_);
+  if(not batch->stored_.empty()) {
+    hsize_t start[1] = {location.productsBegin_};
+    hsize_t count[1] = {location.productsSize_};
+    auto fspace = hdf5::Dataspace::get_space(products_);
+    fspace.select_hyperslab(start, count);
+    auto mspace = hdf5::Dataspace::create_simple(1, count, NULL);
+    H5Dread(products_, H5T_NATIVE_CHAR, mspace, fspace, H5P_DEFAULT, batch->stored_.data());
+  }
+
+  batch->eventStarts_.reserve(batch->nEvents_+1);
+  unsigned long long summedSizes = 0;
+  batch->eventStarts_.push_back(summedSizes);
+  for(auto event = batch->firstEvent_; event < batch->firstEvent_+batch->nEvents_; ++event) {
+    summedSizes += uncompressedSize(event);
+    batch->eventStarts_.push_back(summedSizes);
+  }
+
+  iGroup.run([this, batch]() {
+      uncompressBatch(*batch);
+      batch->doneUncompressing();
+    });
+  return batch;
+}
+
+void SharedHDFBatchEventsSource::uncompressBatch(Batch& iBatch) {
+  auto start = std::chrono::high_resolution_clock::now();
+  //the stored events one after the other, each still compressed if the events were compressed
+  std::vector<char> events;
+  if(batchCompressed_) {
+    std::size_t size = 0;
+    for(auto event = iBatch.firstEvent_; event < iBatch.firstEvent_+iBatch.nEvents_; ++event) {
+      size += storedSize(event);
+    }
+    events.resize(size);
+    pds::uncompressBuffer(compression_, iBatch.stored_.data(), iBatch.stored_.size(), size, events.data(), decompressionContexts_.local());
+  } else {
+    events.swap(iBatch.stored_);
+  }
+  std::vector<char>().swap(iBatch.stored_); //free memory
+
+  if(eventsCompressed_) {
+    iBatch.uncompressed_.resize(iBatch.eventStarts_.back());
+    std::vector<std::size_t> storedStarts;
+    storedStarts.reserve(iBatch.nEvents_);
+    std::size_t begin = 0;
+    for(auto event = iBatch.firstEvent_; event < iBatch.firstEvent_+iBatch.nEvents_; ++event) {
+      storedStarts.push_back(begin);
+      begin += storedSize(event);
+    }
+    TaskHolder::WaitScope waitScope;
+    tbb::parallel_for(std::size_t(0), std::size_t(iBatch.nEvents_), [this, &iBatch, &events, &storedStarts](std::size_t i) {
+        auto const event = iBatch.firstEvent_+i;
+        pds::uncompressBuffer(compression_, events.data()+storedStarts[i], storedSize(event), uncompressedSize(event),
+                              iBatch.uncompressed_.data()+iBatch.eventStarts_[i], decompressionContexts_.local());
+      });
+  } else {
+    iBatch.uncompressed_.swap(events);
+  }
+  decompressTime_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool SharedHDFBatchEventsSource::Batch::whenUncompressed(TaskHolder iTask) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  if(uncompressedDone_) {
+    return false;
+  }
+  waiting_.push_back(std::move(iTask));
+  return true;
+}
+
+void SharedHDFBatchEventsSource::Batch::doneUncompressing() {
+  std::vector<TaskHolder> waiting;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    uncompressedDone_ = true;
+    waiting.swap(waiting_);
+  }
+  //destroying the holders starts the waiting tasks
+}
+
+void SharedHDFBatchEventsSource::printSummary() const {
+  std::cout <<"\nSource:\n"
+    "   read time: "<<readTime_.count()<<"us\n"
+    "   decompress time: "<<decompressTime_.load()<<"us\n"
+    "   deserialize time: "<<deserializeTime().count()<<"us\n"
+    "   batches read: "<<nextBatch_<<"\n"
+    "   events waiting for their batch to be decompressed: "<<nWaitedForDecompression_<<"\n";
+  summarize_queue("read", queue_);
+  std::cout<<std::endl;
+}
+
+std::chrono::microseconds SharedHDFBatchEventsSource::deserializeTime() const {
+  auto time = std::chrono::microseconds::zero();
+  for(auto const& l : laneInfos_) {
+    time += l.deserializeTime_;
+  }
+  return time;
+}
+
+namespace {
+    class Maker : public SourceMakerBase {
+  public:
+    Maker(): SourceMakerBase("SharedHDFBatchEventsSource") {}
+      std::unique_ptr<SharedSourceBase> create(unsigned int iNLanes, unsigned long long iNEvents, ConfigurationParameters const& params) const final {
+        auto fileName = params.get<std::string>("fileName");
+        if(not fileName) {
+          std::cout <<"no file name given\n";
+          return {};
+        }
+        ProductSelector selector{params.get<std::string>("products", "")};
+        return std::make_unique<SharedHDFBatchEventsSource>(iNLanes, iNEvents, *fileName, selector);
+    }
+    };
+
+  Maker s_maker;
+}
@@ -0,0 +1,146 @@
+#if !defined(SharedHDFBatchEventsSource_h)
+#define SharedHDFBatchEventsSource_h
+
+#include <string>
+#include <memory>
+#include <chrono>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+#include "SharedSourceBase.h"
+#include "DataProductRetriever.h"
+#include "DelayedProductRetriever.h"
+#include "SerialTaskQueue.h"
+#include "DeserializeStrategy.h"
+#include "ProductSelector.h"
+#include "pds_reading.h"
+#include "TaskHolder.h"
+#include "tbb/enumerable_thread_specific.h"
+#include "PerLaneCounter.h"
+
+#include "HDFCxx.h"
+
+namespace cce::tf {
+  class SharedHDFBatchEventsDelayedRetriever : public DelayedProductRetriever {
+    void getAsync(DataProductRetriever&, int index, TaskHolder) final {}
+  };
+
+  /**
+     Reads a file written by HDFBatchEventsOutputer one batch at a time. Only
+     reading the bytes of a batch from the Products dataset is done in the
+     serial queue. The batch is decompressed once in its own task, with the
+     events of a batch compressed one by one decompressed in parallel, and is
+     shared by the Lanes deserializing its events until the last of them is
+     done. The next batch is read while the events of the present one are
+     processed, as done by SharedRootBatchEventsSource.
+   */
+  class SharedHDFBatchEventsSource : public SharedSourceBase {
+  public:
+    SharedHDFBatchEventsSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iFileName,
+                               ProductSelector const& iSelector = ProductSelector());
+    SharedHDFBatchEventsSource(SharedHDFBatchEventsSource&&) = delete;
+    SharedHDFBatchEventsSource(SharedHDFBatchEventsSource const&) = delete;
+
+  size_t numberOfDataProducts() const final;
+  std::vector<DataProductRetriever>& dataProducts(unsigned int iLane, long iEventIndex) final;
+  EventIdentifier eventIdentifier(unsigned int iLane, long iEventIndex) final;
+
+  void printSummary() const final;
+  private:
+
+  void readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder) final;
+
+  //where a batch is in the file, found from the BatchSizes dataset when the file is opened
+  struct BatchLocation {
+    unsigned long long firstEvent_;
+    unsigned long long nEvents_;
+    unsigned long long productsBegin_;
+    unsigned long long productsSize_;
+  };
+
+  //The events of one batch, freed once the last of them has been deserialized
+  struct Batch {
+    unsigned long long firstEvent_ = 0;
+    unsigned long long nEvents_ = 0;
+    std::vector<char> stored_;
+    std::vector<char> uncompressed_;
+    //where each event begins in uncompressed_, the last entry is the total size
+    std::vector<unsigned long long> eventStarts_;
+
+    //iTask is released once the batch has been uncompressed. Returns true if it had to wait.
+    bool whenUncompressed(TaskHolder iTask);
+    void doneUncompressing();
+  private:
+    std::mutex mutex_;
+    bool uncompressedDone_ = false;
+    std::vector<TaskHolder> waiting_;
+  };
+
+  //must be called from queue_. Gives the lane the next event of the present batch, false if there are none left
+  bool nextEvent(unsigned int iLane, tbb::task_group& iGroup, unsigned long long& oEventIndex);
+  //iTask is released once the lane's event was deserialized
+  void deserializeAsync(unsigned int iLane, unsigned long long iEventIndex, TaskHolder iTask);
+  //must be called from queue_, starts the decompression of the batch in iGroup
+  std::shared_ptr<Batch> readBatch(tbb::task_group& iGroup);
+  void uncompressBatch(Batch&);
+
+  //offsets of event iEventIndex, the sizes of the stored and uncompressed event follow those of the data products
+  uint32_t const* eventOffsets(unsigned long long iEventIndex) const { return offsets_.data()+iEventIndex*(nFileProducts_+2); }
+  uint32_t storedSize(unsigned long long iEventIndex) const { return eventOffsets(iEventIndex)[nFileProducts_+1]; }
+  uint32_t uncompressedSize(unsigned long long iEventIndex) const { return eventOffsets(iEventIndex)[nFileProducts_]; }
+
+  std::chrono::microseconds deserializeTime() const;
+
+  hdf5::File file_;
+  hdf5::Group lumi_;
+  hdf5::Dataset products_;
+  pds::Compression compression_;
+  bool batchCompressed_ = false;
+  bool eventsCompressed_ = false;
+  pds::ProductMap productMap_;
+  //the offsets stored for each event include the data products which are not read
+  size_t nFileProducts_;
+  unsigned int run_ = 0;
+  unsigned int lumi_num_ = 0;
+  std::vector<unsigned long long> eventIDs_;
+  std::vector<uint32_t> offsets_;
+  std::vector<BatchLocation> batches_;
+  SerialTaskQueue queue_;
+
+  struct alignas(kCacheLineSize) LaneInfo {
+    LaneInfo(std::vector<pds::ProductInfo> const&, DeserializeStrategy);
+
+    LaneInfo(LaneInfo&&) = default;
+    LaneInfo(LaneInfo const&) = delete;
+
+    LaneInfo& operator=(LaneInfo&&) = default;
+    LaneInfo& operator=(LaneInfo const&) = delete;
+
+    EventIdentifier eventID_;
+    std::vector<DataProductRetriever> dataProducts_;
+    std::vector<void*> dataBuffers_;
+    DeserializeStrategy deserializers_;
+    SharedHDFBatchEventsDelayedRetriever delayedRetriever_;
+    //the batch holding the event being processed by the lane
+    std::shared_ptr<Batch> batch_;
+    std::chrono::microseconds deserializeTime_;
+    ~LaneInfo();
+  };
+
+  std::size_t nextBatch_ = 0;
+  unsigned long long nextEventInBatch_ = 0;
+  //the batch whose events are being handed to lanes and the one read ahead of it
+  std::shared_ptr<Batch> currentBatch_;
+  std::shared_ptr<Batch> readAheadBatch_;
+  //batches are decompressed concurrently
+  tbb::enumerable_thread_specific<pds::DecompressionContext> decompressionContexts_;
+  unsigned long long nWaitedForDecompression_ = 0;
+  std::atomic<std::chrono::microseconds::rep> decompressTime_ = 0;
+
+  std::vector<LaneInfo> laneInfos_;
+  std::chrono::microseconds readTime_;
+  };
+}
+
+#endif
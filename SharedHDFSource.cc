@@ -0,0 +1,314 @@
+#include "SharedHDFSource.h"
+#include "SourceFactory.h"
+#include "summarize_queue.h"
+
+#include "TClass.h"
+#include "TBufferFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+using namespace cce::tf;
+
+namespace {
+  herr_t
+  addProductName(hid_t loc_id, const char *name, const H5L_info_t *info, void *opdata) {
+    H5O_info_t infobuf;
+    H5Oget_info_by_name (loc_id, name, &infobuf, H5O_INFO_BASIC, H5P_DEFAULT);
+    if(infobuf.type == H5O_TYPE_DATASET and strstr(name,"_sz") == nullptr and strcmp(name, "Event_IDs") != 0) {
+      reinterpret_cast<std::vector<std::string>*>(opdata)->emplace_back(name);
+    }
+    return 0;
+  }
+
+  hsize_t length(hid_t iDataset) {
+    auto space = hdf5::Dataspace::get_space(iDataset);
+    hsize_t dims[1];
+    H5Sget_simple_extent_dims(space, dims, nullptr);
+    return dims[0];
+  }
+
+  //appends the entries beyond those in oValues
+  template<typename T>
+  void readFrom(hid_t iDataset, hid_t iMemType, std::vector<T>& oValues) {
+    hsize_t start[1] = {oValues.size()};
+    auto const end = length(iDataset);
+    if(end <= start[0]) {
+      return;
+    }
+    hsize_t count[1] = {end - start[0]};
+    oValues.resize(end);
+    auto fspace = hdf5::Dataspace::get_space(iDataset);
+    fspace.select_hyperslab(start, count);
+    auto mspace = hdf5::Dataspace::create_simple(1, count, NULL);
+    H5Dread(iDataset, iMemType, mspace, fspace, H5P_DEFAULT, oValues.data()+start[0]);
+  }
+
+  hdf5::File openFile(std::string const& iFileName, bool iTail) {
+    if(iTail) {
+      return hdf5::File::open_swmr_read(iFileName.c_str());
+    }
+    return hdf5::File::open(iFileName.c_str());
+  }
+
+  std::string readClassName(hid_t iDataset) {
+    auto aid = hdf5::Attribute::open(iDataset, "classname");
+    auto tid = H5Aget_type(aid);
+    char* attribute_name;
+    H5Aread(aid, tid, &attribute_name);
+    H5Tclose(tid);
+    std::string s(attribute_name);
+    free(attribute_name);
+    return s;
+  }
+}
+
+SharedHDFSource::ProductDataset::ProductDataset(hid_t iGroup, std::string const& iName):
+  products_(hdf5::Dataset::open(iGroup, iName.c_str())),
+  sizes_(hdf5::Dataset::open(iGroup, (iName+"_sz").c_str())) {
+  readFrom(sizes_, H5T_NATIVE_ULLONG, ends_);
+}
+
+SharedHDFSource::SharedHDFSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iFileName, unsigned int iEventsPerRead,
+                                 ProductSelector const& iSelector, std::optional<TailConfig> iTail):
+  SharedSourceBase(iNEvents),
+  file_(openFile(iFileName, iTail.has_value())),
+  lumi_(hdf5::Group::open(file_, "/Lumi")),
+  eventIDsDataset_(hdf5::Dataset::open(lumi_, "Event_IDs")),
+  nEvents_{0},
+  tail_{iTail},
+  eventsPerRead_{iEventsPerRead == 0 ? 1 : iEventsPerRead},
+  readTime_{std::chrono::microseconds::zero()}
+{
+  std::vector<std::string> names;
+  H5Literate (lumi_, H5_INDEX_NAME, H5_ITER_NATIVE, NULL, addProductName, &names);
+  if(not iSelector.keepsAll()) {
+    names.erase(std::remove_if(names.begin(), names.end(), [&iSelector](auto const& n) { return not iSelector.keep(n); }), names.end());
+  }
+  std::vector<std::string> classNames;
+  productDatasets_.reserve(names.size());
+  classNames.reserve(names.size());
+  for(auto const& n: names) {
+    productDatasets_.emplace_back(lumi_, n);
+    classNames.push_back(readClassName(productDatasets_.back().products_));
+  }
+  readFrom(eventIDsDataset_, H5T_NATIVE_UINT, eventIDs_);
+  nEvents_ = availableEvents();
+  auto attr_r = hdf5::Attribute::open(lumi_, "run");
+  H5Aread(attr_r, H5T_NATIVE_UINT, &run_);
+  auto attr_l = hdf5::Attribute::open(lumi_, "lumisec");
+  H5Aread(attr_l, H5T_NATIVE_UINT, &lumi_num_);
+
+  laneInfos_.reserve(iNLanes);
+  for(unsigned int i = 0; i< iNLanes; ++i) {
+    laneInfos_.emplace_back(names, classNames);
+  }
+}
+
+SharedHDFSource::LaneInfo::LaneInfo(std::vector<std::string> const& iNames, std::vector<std::string> const& iClassNames):
+  deserializeTime_{std::chrono::microseconds::zero()}
+{
+  dataProducts_.reserve(iNames.size());
+  dataBuffers_.resize(iNames.size(), nullptr);
+  for(size_t index = 0; index < iNames.size(); ++index) {
+    TClass* cls = TClass::GetClass(iClassNames[index].c_str());
+    assert(cls);
+    dataBuffers_[index] = cls->New();
+    dataProducts_.emplace_back(index, &dataBuffers_[index], iNames[index], cls, &delayedRetriever_);
+  }
+}
+
+SharedHDFSource::LaneInfo::~LaneInfo() {
+  auto it = dataProducts_.begin();
+  for( void * b: dataBuffers_) {
+    it->classType()->Destructor(b);
+    ++it;
+  }
+}
+
+size_t SharedHDFSource::numberOfDataProducts() const {
+  return productDatasets_.size();
+}
+
+std::vector<DataProductRetriever>& SharedHDFSource::dataProducts(unsigned int iLane, long iEventIndex) {
+  return laneInfos_[iLane].dataProducts_;
+}
+
+EventIdentifier SharedHDFSource::eventIdentifier(unsigned int iLane, long iEventIndex) {
+  return laneInfos_[iLane].eventID_;
+}
+
+void SharedHDFSource::readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder iTask) {
+  if(not tail_ and iEventIndex >= nEvents_.load()) {
+    return;
+  }
+  queue_.push(*iTask.group(), [iLane, iEventIndex, optTask = std::move(iTask), this]() mutable {
+      auto start = std::chrono::high_resolution_clock::now();
+      if(not waitForEvent(iEventIndex)) {
+        //dropping the task tells the Lane there are no more events
+        return;
+      }
+      auto& laneInfo = laneInfos_[iLane];
+      laneInfo.block_ = blockFor(iEventIndex);
+      laneInfo.eventID_ = {run_, lumi_num_, eventIDs_[iEventIndex]};
+      readTime_ +=std::chrono::duration_cast<decltype(readTime_)>(std::chrono::high_resolution_clock::now() - start);
+
+      auto group = optTask.group();
+      group->run([this, task = optTask.releaseToTaskHolder(), iLane, iEventIndex]() {
+          deserialize(iLane, iEventIndex);
+        });
+    });
+}
+
+std::shared_ptr<SharedHDFSource::Block const> SharedHDFSource::blockFor(long iEventIndex) {
+  if(block_ and iEventIndex >= block_->firstEvent_ and iEventIndex < block_->firstEvent_ + block_->nEvents_) {
+    return block_;
+  }
+  auto block = std::make_shared<Block>();
+  block->firstEvent_ = iEventIndex;
+  block->nEvents_ = std::min<long>(eventsPerRead_, nEvents_.load() - iEventIndex);
+  block->products_.resize(productDatasets_.size());
+  block->begins_.resize(productDatasets_.size());
+  long const lastEvent = iEventIndex + block->nEvents_ - 1;
+  for(size_t index = 0; index < productDatasets_.size(); ++index) {
+    auto const& pd = productDatasets_[index];
+    hsize_t start[1] = {pd.begin(iEventIndex)};
+    hsize_t count[1] = {pd.ends_[lastEvent] - start[0]};
+    auto& begins = block->begins_[index];
+    begins.reserve(block->nEvents_+1);
+    for(long event = iEventIndex; event <= lastEvent; ++event) {
+      begins.push_back(pd.begin(event) - start[0]);
+    }
+    begins.push_back(count[0]);
+    auto& bytes = block->products_[index];
+    bytes.resize(count[0]);
+    if(count[0] == 0) {
+      continue;
+    }
+    auto fspace = hdf5::Dataspace::get_space(pd.products_);
+    fspace.select_hyperslab(start, count);
+    auto mspace = hdf5::Dataspace::create_simple(1, count, NULL);
+    H5Dread(pd.products_, H5T_NATIVE_CHAR, mspace, fspace, H5P_DEFAULT, bytes.data());
+  }
+  ++nBlockReads_;
+  block_ = std::move(block);
+  return block_;
+}
+
+bool SharedHDFSource::waitForEvent(long iEventIndex) {
+  if(iEventIndex < nEvents_.load()) {
+    return true;
+  }
+  if(not tail_ or tailEnded_) {
+    return false;
+  }
+  auto const deadline = std::chrono::steady_clock::now() + tail_->timeout_;
+  while(true) {
+    refresh();
+    if(iEventIndex < nEvents_.load()) {
+      return true;
+    }
+    if(std::chrono::steady_clock::now() >= deadline) {
+      //the writer is taken to be done, later events are not waited for
+      tailEnded_ = true;
+      return false;
+    }
+    std::this_thread::sleep_for(tail_->pollInterval_);
+  }
+}
+
+void SharedHDFSource::refresh() {
+  ++nRefreshes_;
+  //the writer adds the events after their data products
+  eventIDsDataset_.refresh();
+  readFrom(eventIDsDataset_, H5T_NATIVE_UINT, eventIDs_);
+  for(auto& pd: productDatasets_) {
+    pd.sizes_.refresh();
+    readFrom(pd.sizes_, H5T_NATIVE_ULLONG, pd.ends_);
+    pd.products_.refresh();
+  }
+  nEvents_ = availableEvents();
+}
+
+long SharedHDFSource::availableEvents() const {
+  long n = eventIDs_.size();
+  for(auto const& pd: productDatasets_) {
+    n = std::min<long>(n, pd.ends_.size());
+    //the flushes of different datasets may become visible in any order
+    auto const bytes = length(pd.products_);
+    while(n > 0 and pd.ends_[n-1] > bytes) {
+      --n;
+    }
+  }
+  return n;
+}
+
+void SharedHDFSource::deserialize(unsigned int iLane, long iEventIndex) {
+  auto start = std::chrono::high_resolution_clock::now();
+  auto& laneInfo = laneInfos_[iLane];
+  auto const& block = *laneInfo.block_;
+  TBufferFile bufferFile{TBuffer::kRead};
+  auto const eventInBlock = iEventIndex - block.firstEvent_;
+  for(size_t index = 0; index < productDatasets_.size(); ++index) {
+    auto const& begins = block.begins_[index];
+    auto const offset = begins[eventInBlock];
+    auto const size = begins[eventInBlock+1] - offset;
+    bufferFile.SetBuffer(const_cast<char*>(block.products_[index].data()+offset), size, kFALSE);
+    laneInfo.dataProducts_[index].classType()->ReadBuffer(bufferFile, laneInfo.dataBuffers_[index]);
+    laneInfo.dataProducts_[index].setSize(bufferFile.Length());
+    bufferFile.Reset();
+  }
+  //other lanes may still use the block
+  laneInfo.block_.reset();
+  laneInfo.deserializeTime_ += std::chrono::duration_cast<decltype(laneInfo.deserializeTime_)>(std::chrono::high_resolution_clock::now() - start);
+}
+
+void SharedHDFSource::printSummary() const {
+  auto deserializeTime = std::chrono::microseconds::zero();
+  for(auto const& l : laneInfos_) {
+    deserializeTime += l.deserializeTime_;
+  }
+  std::cout <<"\nSource:\n"
+    "   read time: "<<readTime_.count()<<"us\n"
+    "   deserialize time: "<<deserializeTime.count()<<"us\n"
+    "   block reads: "<<nBlockReads_<<"\n";
+  if(tail_) {
+    std::cout <<"   tail refreshes: "<<nRefreshes_<<"\n";
+  }
+  summarize_queue("read", queue_);
+  std::cout<<std::endl;
+}
+
+namespace {
+    class Maker : public SourceMakerBase {
+  public:
+    Maker(): SourceMakerBase("SharedHDFSource") {}
+      std::unique_ptr<SharedSourceBase> create(unsigned int iNLanes, unsigned long long iNEvents, ConfigurationParameters const& params) const final {
+        auto fileName = params.get<std::string>("fileName");
+        if(not fileName) {
+          std::cout <<"no file name given\n";
+          return {};
+        }
+        auto eventsPerRead = params.get<int>("eventsPerRead", iNLanes);
+        if(eventsPerRead < 1) {
+          std::cout <<"eventsPerRead for SharedHDFSource must be at least 1\n";
+          return {};
+        }
+        ProductSelector selector{params.get<std::string>("products", "")};
+        std::optional<SharedHDFSource::TailConfig> tail;
+        if(params.get<bool>("tail", false)) {
+          auto poll = params.get<int>("tailPoll_ms", 100);
+          auto timeout = params.get<int>("tailTimeout_s", 10);
+          if(poll < 1 or timeout < 0) {
+            std::cout <<"tailPoll_ms for SharedHDFSource must be at least 1 and tailTimeout_s can not be negative\n";
+            return {};
+          }
+          tail = SharedHDFSource::TailConfig{std::chrono::milliseconds(poll), std::chrono::seconds(timeout)};
+        }
+        return std::make_unique<SharedHDFSource>(iNLanes, iNEvents, *fileName, eventsPerRead, selector, tail);
+    }
+    };
+
+  Maker s_maker;
+}
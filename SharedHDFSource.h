@@ -0,0 +1,119 @@
+#if !defined(SharedHDFSource_h)
+#define SharedHDFSource_h
+
+#include <string>
+#include <memory>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <optional>
+
+#include "SharedSourceBase.h"
+#include "DataProductRetriever.h"
+#include "SerialTaskQueue.h"
+#include "ProductSelector.h"
+#include "HDFSource.h"
+
+#include "HDFCxx.h"
+#include "PerLaneCounter.h"
+
+namespace cce::tf {
+  /**
+     Reads a file written by HDFOutputer with one set of open datasets shared by
+     all Lanes. The libhdf5 calls are done in a serial queue which reads the bytes
+     of a block of consecutive events with one hyperslab read per data product.
+     The Lanes then deserialize their events from the shared block concurrently.
+     With tailing, the file may still be written with single-writer/multiple-reader
+     access. An event beyond those seen so far waits in the queue while the datasets
+     are polled for new entries, up to a timeout after which there are no more events.
+   */
+  class SharedHDFSource : public SharedSourceBase {
+  public:
+    struct TailConfig {
+      std::chrono::milliseconds pollInterval_;
+      std::chrono::milliseconds timeout_;
+    };
+    SharedHDFSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iFileName, unsigned int iEventsPerRead = 1,
+                    ProductSelector const& iSelector = ProductSelector(), std::optional<TailConfig> iTail = {});
+    SharedHDFSource(SharedHDFSource&&) = delete;
+    SharedHDFSource(SharedHDFSource const&) = delete;
+
+  size_t numberOfDataProducts() const final;
+  std::vector<DataProductRetriever>& dataProducts(unsigned int iLane, long iEventIndex) final;
+  EventIdentifier eventIdentifier(unsigned int iLane, long iEventIndex) final;
+
+  void printSummary() const final;
+
+  private:
+  void readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder) final;
+
+  struct ProductDataset {
+    ProductDataset(hid_t iGroup, std::string const& iName);
+    hdf5::Dataset products_;
+    hdf5::Dataset sizes_;
+    //end of the bytes of each event
+    std::vector<unsigned long long> ends_;
+    unsigned long long begin(long iEventIndex) const { return iEventIndex == 0 ? 0 : ends_[iEventIndex-1]; }
+  };
+
+  //bytes of each data product for the events [firstEvent_, firstEvent_+nEvents_)
+  struct Block {
+    long firstEvent_ = 0;
+    long nEvents_ = 0;
+    std::vector<std::vector<char>> products_;
+    //per data product, where each event starts in products_ followed by the end of the last.
+    // Kept with the block as a tailing read may grow the ends_ while Lanes deserialize.
+    std::vector<std::vector<unsigned long long>> begins_;
+  };
+  //only called from queue_
+  std::shared_ptr<Block const> blockFor(long iEventIndex);
+  void deserialize(unsigned int iLane, long iEventIndex);
+  //only called from queue_, false if the event is not in the file
+  bool waitForEvent(long iEventIndex);
+  //reads the entries added to the datasets since the last call
+  void refresh();
+  //the events whose data products are all in the file
+  long availableEvents() const;
+
+  hdf5::File file_;
+  hdf5::Group lumi_;
+  hdf5::Dataset eventIDsDataset_;
+  std::vector<ProductDataset> productDatasets_;
+  std::vector<unsigned int> eventIDs_;
+  //events which can be read, only changed in queue_ when tailing
+  std::atomic<long> nEvents_;
+  std::optional<TailConfig> tail_;
+  bool tailEnded_ = false;
+  unsigned long long nRefreshes_ = 0;
+  unsigned int run_ = 0;
+  unsigned int lumi_num_ = 0;
+  unsigned int eventsPerRead_;
+  SerialTaskQueue queue_;
+  std::shared_ptr<Block const> block_;
+  unsigned long long nBlockReads_ = 0;
+
+  struct alignas(kCacheLineSize) LaneInfo {
+    LaneInfo(std::vector<std::string> const& iNames, std::vector<std::string> const& iClassNames);
+
+    LaneInfo(LaneInfo&&) = default;
+    LaneInfo(LaneInfo const&) = delete;
+
+    LaneInfo& operator=(LaneInfo&&) = default;
+    LaneInfo& operator=(LaneInfo const&) = delete;
+
+    EventIdentifier eventID_;
+    std::vector<DataProductRetriever> dataProducts_;
+    std::vector<void*> dataBuffers_;
+    HDFDelayedRetriever delayedRetriever_;
+    //held until the event is deserialized
+    std::shared_ptr<Block const> block_;
+    std::chrono::microseconds deserializeTime_;
+    ~LaneInfo();
+  };
+
+  std::vector<LaneInfo> laneInfos_;
+  std::chrono::microseconds readTime_;
+  };
+}
+
+#endif
@@ -2,18 +2,100 @@
 #include "SourceFactory.h"
 #include "Deserializer.h"
 #include "UnrolledDeserializer.h"
+#include "FixedLayoutDeserializer.h"
+#include "summarize_queue.h"
+#include "Tracer.h"
+#include "PerfCounters.h"
+#include "EventList.h"
+#include "ProductView.h"
 
 #include "TClass.h"
+#include "tbb/parallel_for.h"
+
+#include <limits>
+#include <algorithm>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
 
 using namespace cce::tf;
 
-SharedPDSSource::SharedPDSSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iName) :
+SharedPDSSource::SharedPDSSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iName, unsigned int iQueueDrainBudget,
+                                 std::size_t iReadAheadEvents, std::size_t iReadAheadBytes, std::size_t iVectorReadEvents,
+                                 std::size_t iDeserializeTaskBytes, bool iLazy,
+                                 ProductSelector const& iSelector, std::vector<std::pair<uint32_t, uint32_t>> const& iLumis,
+                                 std::optional<std::vector<EventIdentifier>> const& iEvents,
+                                 bool iViews,
+                                 EventSelection const& iSelection) :
                  SharedSourceBase(iNEvents),
-                 file_{iName, std::ios_base::binary},
-  readTime_{std::chrono::microseconds::zero()}
+                 deserializeTaskBytes_{iDeserializeTaskBytes},
+                 lazy_{iLazy},
+                 productDecompressionContexts_{[this]() {
+                     //the product indices were already mapped to the data products read
+                     pds::DecompressionContext context;
+                     context.setShuffle(productShuffle_);
+                     return context; }},
+                 file_{pds::openByteSource(iName)},
+  readTime_{std::chrono::microseconds::zero()},
+  vectorReadEvents_{iVectorReadEvents},
+  selection_{iSelection}
 {
+  queue_.setDrainBudget(iQueueDrainBudget);
   pds::Serialization serialization;
-  auto productInfo = readFileHeader(file_, compression_, serialization);
+  pds::FileOptions options;
+  auto productInfo = readFileHeader(file_, compression_, serialization, options);
+  if(not options.dictionary_.empty()) {
+    dictionary_ = std::make_unique<pds::DecompressionDictionary>(options.dictionary_);
+  }
+  perProductCompression_ = options.perProductCompression_;
+  checksum_ = options.checksum_;
+  if(options.repeatedProducts_) {
+    if(lazy_) {
+      throw std::runtime_error("SharedPDSSource lazy can not be used with a file storing repeated data products");
+    }
+    repeatedProducts_ = pds::readRepeatedProducts(file_);
+  }
+  productMap_ = pds::selectProducts(productInfo, iSelector);
+  shuffle_ = std::move(options.shuffle_);
+  productShuffle_ = pds::selectShuffle(shuffle_, productMap_, productInfo.size());
+  bool const readAhead = iReadAheadEvents != 0 or iReadAheadBytes != 0;
+  if(not readAhead or vectorReadEvents_ != 0) {
+    eventIndex_ = pds::readEventIndex(file_);
+    if(eventIndex_.empty() and (not iLumis.empty() or iEvents)) {
+      throw std::runtime_error("SharedPDSSource can only select lumis or events of a file with an event index");
+    }
+    if(eventIndex_.empty()) {
+      //the read ahead thread reads the events one after the other
+      vectorReadEvents_ = 0;
+    } else {
+      readIndexed_ = not readAhead;
+    }
+    //the selections may leave no events, the index is still used
+    if(not iLumis.empty()) {
+      eventIndex_ = pds::selectLumis(eventIndex_, pds::readLumiIndex(file_), iLumis);
+    }
+    if(iEvents) {
+      std::vector<EventIdentifier> ids;
+      ids.reserve(eventIndex_.size());
+      for(auto const& e: eventIndex_) {
+        ids.push_back(e.eventID_);
+      }
+      std::vector<pds::EventIndexEntry> selected;
+      for(auto i: selectEvents(ids, *iEvents)) {
+        selected.push_back(eventIndex_[i]);
+      }
+      eventIndex_ = std::move(selected);
+    }
+    if(not selection_.selectsAll()) {
+      //the events not selected are never read
+      auto const nEvents = eventIndex_.size();
+      eventIndex_.erase(std::remove_if(eventIndex_.begin(), eventIndex_.end(),
+                                       [this](auto const& iEntry) { return not selection_(iEntry.eventID_); }),
+                        eventIndex_.end());
+      nNotSelected_ = nEvents - eventIndex_.size();
+    }
+  }
 
   laneInfos_.reserve(iNLanes);
   for(unsigned int i = 0; i< iNLanes; ++i) {
@@ -25,25 +107,134 @@ SharedPDSSource::SharedPDSSource(unsigned int iNLanes, unsigned long long iNEven
     case pds::Serialization::kRootUnrolled: {
       strategy = DeserializeStrategy::make<DeserializeProxy<UnrolledDeserializer>>(); break;
     }
+    case pds::Serialization::kNativeUnrolled: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<NativeUnrolledDeserializer>>(); break;
+    }
+    case pds::Serialization::kFixedLayout: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<FixedLayoutDeserializer>>(); break;
+    }
     }
     laneInfos_.emplace_back(productInfo, std::move(strategy));
+    laneInfos_.back().decompressionContext_.setDictionary(dictionary_.get());
+    laneInfos_.back().decompressionContext_.setShuffle(shuffle_);
+    if(not repeatedProducts_.empty()) {
+      laneInfos_.back().repeatedProductsCache_ = pds::RepeatedProductsCache(&repeatedProducts_, productInfo.size());
+    }
+    if(lazy_) {
+      laneInfos_.back().delayedRetriever_.setSource(this, i);
+    }
+  }
+  //the classes are looked up once and the data products of the lanes are made in parallel
+  std::vector<TClass*> classes;
+  classes.reserve(productInfo.size());
+  for(auto const& pi: productInfo) {
+    classes.push_back(TClass::GetClass(pi.className().c_str()));
+    assert(classes.back());
+  }
+  tbb::parallel_for(0U, iNLanes, [this, &productInfo, &classes](unsigned int iLane) {
+      laneInfos_[iLane].makeDataProducts(productInfo, classes);
+    });
+  if(iViews) {
+    if(serialization != pds::Serialization::kNativeUnrolled) {
+      throw std::runtime_error("SharedPDSSource views needs a file written with the NativeUnrolled serialization");
+    }
+    for(std::size_t index = 0; index < classes.size(); ++index) {
+      if(not productview::canView(*classes[index])) {
+        continue;
+      }
+      //the serialization tells pds::deserializeDataProducts to give the bytes instead of deserializing
+      for(auto& laneInfo: laneInfos_) {
+        laneInfo.dataProducts_[index].setSerialized(BlobView(), pds::Serialization::kNativeUnrolled);
+      }
+      ++nViewedProducts_;
+    }
+  }
+
+  if(readAhead) {
+    readAhead_ = std::make_unique<ReadAheadBuffer<CompressedEvent>>(iReadAheadEvents == 0 ? std::numeric_limits<std::size_t>::max() : iReadAheadEvents,
+                                                                     iReadAheadBytes,
+                                                                     [this](CompressedEvent& oEvent) {
+                                                                       return readAheadEvent(oEvent);
+                                                                     },
+                                                                     [](CompressedEvent const& iEvent) {
+                                                                       return iEvent.buffer_.size()*4;
+                                                                     });
+  }
+}
+
+SharedPDSSource::~SharedPDSSource() {
+  //stop the read ahead thread before file_ goes away
+  readAhead_.reset();
+}
+
+bool SharedPDSSource::readSelectedEvent(EventIdentifier& oEventID, std::vector<uint32_t>& oBuffer) {
+  while(pds::readCompressedEventBuffer(file_, oEventID, oBuffer)) {
+    if(selection_(oEventID)) {
+      return true;
+    }
+    ++nNotSelected_;
+  }
+  return false;
+}
+
+bool SharedPDSSource::readAheadEvent(CompressedEvent& oEvent) {
+  if(vectorReadEvents_ == 0) {
+    return readSelectedEvent(oEvent.eventID_, oEvent.buffer_);
+  }
+  if(vectorReadBuffer_.empty()) {
+    if(nextVectorReadIndex_ == eventIndex_.size()) {
+      return false;
+    }
+    //one request for many events hides the latency of remote storage
+    auto const begin = nextVectorReadIndex_;
+    auto const end = std::min(begin+vectorReadEvents_, eventIndex_.size());
+    std::vector<std::vector<uint32_t>> buffers;
+    pds::readCompressedEventBuffers(file_.source(), eventIndex_.data()+begin, eventIndex_.data()+end, buffers);
+    ++nVectorReads_;
+    for(auto i = begin; i != end; ++i) {
+      vectorReadBuffer_.push_back({eventIndex_[i].eventID_, std::move(buffers[i-begin])});
+    }
+    nextVectorReadIndex_ = end;
   }
+  oEvent = std::move(vectorReadBuffer_.front());
+  vectorReadBuffer_.pop_front();
+  return true;
+}
+
+bool SharedPDSSource::nextCompressedEvent(EventIdentifier& oEventID, std::vector<uint32_t>& oBuffer) {
+  if(not readAhead_) {
+    return readSelectedEvent(oEventID, oBuffer);
+  }
+  CompressedEvent event;
+  if(not readAhead_->next(event)) {
+    return false;
+  }
+  oEventID = event.eventID_;
+  oBuffer = std::move(event.buffer_);
+  return true;
 }
 
 SharedPDSSource::LaneInfo::LaneInfo(std::vector<pds::ProductInfo> const& productInfo, DeserializeStrategy deserialize):
   deserializers_{std::move(deserialize)},
+  uncompressedProductBuffers_(productInfo.size()),
+  storedProducts_(productInfo.size(), {nullptr, 0}),
+  productRequested_{std::make_unique<std::atomic<bool>[]>(productInfo.size())},
+  productDecompressTimes_(productInfo.size(), std::chrono::microseconds::zero()),
+  productDeserializeTimes_(productInfo.size(), std::chrono::microseconds::zero()),
+  readTime_{std::chrono::microseconds::zero()},
   decompressTime_{std::chrono::microseconds::zero()},
   deserializeTime_{std::chrono::microseconds::zero()}
 {
+}
+
+void SharedPDSSource::LaneInfo::makeDataProducts(std::vector<pds::ProductInfo> const& productInfo, std::vector<TClass*> const& iClasses) {
   dataProducts_.reserve(productInfo.size());
   dataBuffers_.resize(productInfo.size(), nullptr);
   deserializers_.reserve(productInfo.size());
   size_t index =0;
   for(auto const& pi : productInfo) {
-    
-    TClass* cls = TClass::GetClass(pi.className().c_str());
+    TClass* cls = iClasses[index];
     dataBuffers_[index] = cls->New();
-    assert(cls);
     dataProducts_.emplace_back(index,
 			       &dataBuffers_[index],
                                pi.name(),
@@ -62,6 +253,14 @@ SharedPDSSource::LaneInfo::~LaneInfo() {
   }
 }
 
+std::size_t SharedPDSSource::LaneInfo::bufferBytes() const {
+  std::size_t bytes = uncompressedBuffer_.capacity()*sizeof(uint32_t) + compressedBuffer_.capacity()*sizeof(uint32_t);
+  for(auto const& b: uncompressedProductBuffers_) {
+    bytes += b.capacity();
+  }
+  return bytes;
+}
+
 size_t SharedPDSSource::numberOfDataProducts() const {
   return laneInfos_[0].dataProducts_.size();
 }
@@ -75,48 +274,374 @@ EventIdentifier SharedPDSSource::eventIdentifier(unsigned int iLane, long iEvent
 }
 
 void SharedPDSSource::readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder iTask) {
+  if(readIndexed_) {
+    readIndexedEvent(iLane, iEventIndex, std::move(iTask));
+    return;
+  }
   queue_.push(*iTask.group(), [iLane, optTask = std::move(iTask), this]() mutable {
-
+      TraceScope scope("read", "source");
+      PerfScope perf(PerfCounters::kRead);
       auto start = std::chrono::high_resolution_clock::now();
       std::vector<uint32_t> buffer;
       
-      if(pds::readCompressedEventBuffer(file_, this->laneInfos_[iLane].eventID_, buffer)) {
+      if(nextCompressedEvent(this->laneInfos_[iLane].eventID_, buffer)) {
         //last entry in buffer is just a crosscheck on its size
         buffer.pop_back();
         auto group = optTask.group();
-        group->run([this, buffer=std::move(buffer), task = optTask.releaseToTaskHolder(), iLane]() {
-            auto& laneInfo = this->laneInfos_[iLane];
-
-            auto start = std::chrono::high_resolution_clock::now();
-            std::vector<uint32_t> uBuffer = pds::uncompressEventBuffer(this->compression_, buffer);
-            laneInfo.decompressTime_ += 
-              std::chrono::duration_cast<decltype(laneInfo.decompressTime_)>(std::chrono::high_resolution_clock::now() - start);
-            
-            start = std::chrono::high_resolution_clock::now();
-            pds::deserializeDataProducts(uBuffer.begin(), uBuffer.end(), laneInfo.dataProducts_, laneInfo.deserializers_);
-            laneInfo.deserializeTime_ += 
-              std::chrono::duration_cast<decltype(laneInfo.deserializeTime_)>(std::chrono::high_resolution_clock::now() - start);
-          });
+        if(lazy_) {
+          //the Lane is done with the previous event so the buffer can be replaced
+          laneInfos_[iLane].compressedBuffer_ = std::move(buffer);
+          group->run([this, task = optTask.releaseToTaskHolder(), iLane]() {
+              prepareLazyProducts(iLane);
+            });
+        } else if(perProductCompression_) {
+          //only spawns the per product tasks so is cheap enough to do in the queue
+          decompressAndDeserializeProductsAsync(iLane, std::move(buffer), optTask.releaseToTaskHolder());
+        } else {
+          group->run([this, buffer=std::move(buffer), task = optTask.releaseToTaskHolder(), iLane]() {
+              decompress(iLane, buffer);
+              deserializeAsync(iLane, task);
+            });
+        }
       }
       readTime_ +=std::chrono::duration_cast<decltype(readTime_)>(std::chrono::high_resolution_clock::now() - start);
     });
 }
 
+void SharedPDSSource::readIndexedEvent(unsigned int iLane, long iEventIndex, OptionalTaskHolder iTask) {
+  if(iEventIndex >= eventIndex_.size()) {
+    return;
+  }
+  auto& laneInfo = laneInfos_[iLane];
+  auto const& entry = eventIndex_[iEventIndex];
+
+  std::vector<uint32_t> buffer;
+  {
+    TraceScope scope("read", "source");
+    PerfScope perf(PerfCounters::kRead);
+    auto start = std::chrono::high_resolution_clock::now();
+    pds::readCompressedEventBuffer(file_.source(), entry, lazy_ ? laneInfo.compressedBuffer_ : buffer);
+    //last entry in buffer is just a crosscheck on its size
+    (lazy_ ? laneInfo.compressedBuffer_ : buffer).pop_back();
+    laneInfo.eventID_ = entry.eventID_;
+    laneInfo.readTime_ +=
+      std::chrono::duration_cast<decltype(laneInfo.readTime_)>(std::chrono::high_resolution_clock::now() - start);
+  }
+
+  if(lazy_) {
+    prepareLazyProducts(iLane);
+    iTask.runNow();
+    return;
+  }
+
+  if(perProductCompression_) {
+    decompressAndDeserializeProductsAsync(iLane, std::move(buffer), iTask.releaseToTaskHolder());
+    return;
+  }
+  decompress(iLane, buffer);
+  if(deserializeTaskBytes_ == 0) {
+    deserialize(iLane);
+    iTask.runNow();
+    return;
+  }
+  deserializeAsync(iLane, iTask.releaseToTaskHolder());
+}
+
+void SharedPDSSource::decompress(unsigned int iLane, std::vector<uint32_t> const& iBuffer) {
+  auto& laneInfo = laneInfos_[iLane];
+
+  TraceScope scope("decompress", "source");
+  PerfScope perf(PerfCounters::kDecompress);
+  auto start = std::chrono::high_resolution_clock::now();
+  auto& uBuffer = laneInfo.uncompressedBuffer_;
+  auto end = iBuffer.data()+iBuffer.size();
+  if(checksum_) {
+    pds::checkRecordChecksum(iBuffer.data(), end, laneInfo.eventID_);
+    --end;
+  }
+  pds::uncompressEventBuffer(compression_, iBuffer.data(), end, uBuffer, laneInfo.decompressionContext_);
+  laneInfo.decompressTime_ += 
+    std::chrono::duration_cast<decltype(laneInfo.decompressTime_)>(std::chrono::high_resolution_clock::now() - start);
+}
+
+void SharedPDSSource::deserialize(unsigned int iLane) {
+  auto& laneInfo = laneInfos_[iLane];
+  auto& uBuffer = laneInfo.uncompressedBuffer_;
+
+  TraceScope scope("deserialize", "source");
+  PerfScope perf(PerfCounters::kDeserialize);
+  auto start = std::chrono::high_resolution_clock::now();
+  pds::deserializeDataProducts(uBuffer.begin(), uBuffer.end(), laneInfo.dataProducts_, laneInfo.deserializers_, productMap_,
+                               &laneInfo.repeatedProductsCache_);
+  laneInfo.deserializeTime_ += 
+    std::chrono::duration_cast<decltype(laneInfo.deserializeTime_)>(std::chrono::high_resolution_clock::now() - start);
+}
+
+void SharedPDSSource::deserializeAsync(unsigned int iLane, TaskHolder iTask) {
+  if(deserializeTaskBytes_ == 0) {
+    deserialize(iLane);
+    return;
+  }
+  auto& laneInfo = laneInfos_[iLane];
+  auto& uBuffer = laneInfo.uncompressedBuffer_;
+
+  //Consecutive data products are put in the same task until their stored
+  // size reaches deserializeTaskBytes_ so small products do not each pay
+  // the cost of a task.
+  auto& groups = laneInfo.deserializeGroups_;
+  groups.clear();
+  auto it = uBuffer.begin();
+  auto itEnd = uBuffer.end();
+  auto groupBegin = it;
+  size_t groupBytes = 0;
+  while(it < itEnd) {
+    //each product is stored as its index, its size in words and then the data
+    auto storedSize = it[1];
+    auto productBegin = it;
+    it += 2+storedSize;
+    if(productMap_(*productBegin & ~pds::kRepeatedProductBit) == pds::ProductMap::kNotRead) {
+      //a group never starts with a data product which is not read
+      if(groupBegin == productBegin) {
+        groupBegin = it;
+      }
+      continue;
+    }
+    groupBytes += storedSize*4;
+    if(groupBytes >= deserializeTaskBytes_) {
+      groups.emplace_back(groupBegin, it);
+      groupBegin = it;
+      groupBytes = 0;
+    }
+  }
+  assert(it == itEnd);
+  if(groupBegin != itEnd) {
+    groups.emplace_back(groupBegin, itEnd);
+  }
+
+  auto group = iTask.group();
+  for(auto const& g: groups) {
+    group->run([this, iLane, begin = g.first, end = g.second, iTask]() {
+        auto& laneInfo = laneInfos_[iLane];
+        //the first product of the group is only in this group
+        auto const index = productMap_(*begin & ~pds::kRepeatedProductBit);
+        TraceScope scope("deserialize", "source");
+        PerfScope perf(PerfCounters::kDeserialize);
+        auto start = std::chrono::high_resolution_clock::now();
+        pds::deserializeDataProducts(begin, end, laneInfo.dataProducts_, laneInfo.deserializers_, productMap_,
+                                     &laneInfo.repeatedProductsCache_);
+        laneInfo.productDeserializeTimes_[index] +=
+          std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+      });
+  }
+}
+
+void SharedPDSSource::decompressAndDeserializeProductsAsync(unsigned int iLane, std::vector<uint32_t> iBuffer, TaskHolder iTask) {
+  auto& laneInfo = laneInfos_[iLane];
+  //the product buffers point into the event buffer so it must live until all the tasks finish
+  auto buffer = std::make_shared<std::vector<uint32_t>>(std::move(iBuffer));
+  auto group = iTask.group();
+  auto end = buffer->data()+buffer->size();
+  if(checksum_) {
+    --end;
+    //verified alongside the decompression of the data products
+    group->run([this, iLane, buffer, iTask]() {
+        pds::checkRecordChecksum(buffer->data(), buffer->data()+buffer->size(), laneInfos_[iLane].eventID_);
+      });
+  }
+  pds::productBuffers(buffer->data(), end, laneInfo.productBuffers_);
+  selectProductBuffers(laneInfo.productBuffers_);
+
+  for(auto const& product: laneInfo.productBuffers_) {
+    group->run([this, iLane, &product, buffer, iTask]() {
+        decompressAndDeserializeProduct(iLane, product);
+      });
+  }
+}
+
+void SharedPDSSource::selectProductBuffers(std::vector<pds::ProductBuffer>& ioBuffers) const {
+  if(productMap_.readsAll()) {
+    return;
+  }
+  auto itKept = ioBuffers.begin();
+  for(auto& b: ioBuffers) {
+    auto index = productMap_(b.productIndex_);
+    if(index != pds::ProductMap::kNotRead) {
+      b.productIndex_ = index;
+      *(itKept++) = b;
+    }
+  }
+  ioBuffers.erase(itKept, ioBuffers.end());
+}
+
+void SharedPDSSource::decompressAndDeserializeProduct(unsigned int iLane, pds::ProductBuffer const& iProduct) {
+  auto& laneInfo = laneInfos_[iLane];
+  auto const index = iProduct.productIndex_;
+
+  auto& uBuffer = laneInfo.uncompressedProductBuffers_[index];
+  {
+    TraceScope scope("decompress", "source");
+    PerfScope perf(PerfCounters::kDecompress);
+    auto start = std::chrono::high_resolution_clock::now();
+    pds::uncompressProductBuffer(compression_, iProduct, uBuffer, productDecompressionContexts_.local());
+    laneInfo.productDecompressTimes_[index] +=
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+  }
+
+  TraceScope scope("deserialize", "source");
+  PerfScope perf(PerfCounters::kDeserialize);
+  auto start = std::chrono::high_resolution_clock::now();
+  pds::deserializeDataProduct(uBuffer.data(), uBuffer.size(), index, laneInfo.dataProducts_, laneInfo.deserializers_);
+  laneInfo.productDeserializeTimes_[index] +=
+    std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+}
+
+void SharedPDSSource::prepareLazyProducts(unsigned int iLane) {
+  auto& laneInfo = laneInfos_[iLane];
+  auto const& buffer = laneInfo.compressedBuffer_;
+  auto const nProducts = laneInfo.dataProducts_.size();
+  for(size_t i = 0; i < nProducts; ++i) {
+    laneInfo.productRequested_[i] = false;
+  }
+
+  if(perProductCompression_) {
+    //decompression is also deferred
+    auto end = buffer.data()+buffer.size();
+    if(checksum_) {
+      pds::checkRecordChecksum(buffer.data(), end, laneInfo.eventID_);
+      --end;
+    }
+    pds::productBuffers(buffer.data(), end, laneInfo.productBuffers_);
+    selectProductBuffers(laneInfo.productBuffers_);
+    std::sort(laneInfo.productBuffers_.begin(), laneInfo.productBuffers_.end(),
+              [](auto const& iLHS, auto const& iRHS) { return iLHS.productIndex_ < iRHS.productIndex_; });
+    assert(laneInfo.productBuffers_.size() == nProducts);
+    return;
+  }
+
+  decompress(iLane, buffer);
+  auto it = laneInfo.uncompressedBuffer_.begin();
+  auto itEnd = laneInfo.uncompressedBuffer_.end();
+  while(it < itEnd) {
+    //each product is stored as its index, its size in words and then the data
+    auto index = productMap_(it[0]);
+    if(index != pds::ProductMap::kNotRead) {
+      laneInfo.storedProducts_[index] = {it+2, it[1]};
+    }
+    it += 2+it[1];
+  }
+  assert(it == itEnd);
+}
+
+void SharedPDSSource::getProductAsync(unsigned int iLane, int iIndex, TaskHolder iCallback) {
+  auto& laneInfo = laneInfos_[iLane];
+  //NOTE: a second request made while the first is still deserializing does not wait for it.
+  // The Lane only makes one request per data product per event.
+  if(laneInfo.productRequested_[iIndex].exchange(true)) {
+    return;
+  }
+  auto group = iCallback.group();
+  group->run([this, iLane, iIndex, callback = std::move(iCallback)]() {
+      auto& laneInfo = laneInfos_[iLane];
+      if(perProductCompression_) {
+        decompressAndDeserializeProduct(iLane, laneInfo.productBuffers_[iIndex]);
+        return;
+      }
+      auto start = std::chrono::high_resolution_clock::now();
+      auto const& stored = laneInfo.storedProducts_[iIndex];
+      pds::deserializeDataProduct(reinterpret_cast<char const*>(stored.first), stored.second*4, iIndex,
+                                  laneInfo.dataProducts_, laneInfo.deserializers_);
+      laneInfo.productDeserializeTimes_[iIndex] +=
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+    });
+}
+
+void SharedPDSDelayedRetriever::getAsync(DataProductRetriever&, int index, TaskHolder iCallback) {
+  if(source_) {
+    source_->getProductAsync(lane_, index, std::move(iCallback));
+  }
+}
+
 void SharedPDSSource::printSummary() const {
   std::cout <<"\nSource:\n"
     "   read time: "<<readTime().count()<<"us\n"
     "   decompress time: "<<decompressTime().count()<<"us\n"
-    "   deserialize time: "<<deserializeTime().count()<<"us\n"<<std::endl;
+    "   deserialize time: "<<deserializeTime().count()<<"us\n";
+  auto [bufferBytes, maxLaneBufferBytes] = laneBufferBytes();
+  std::cout <<"   lane buffers: "<<bufferBytes<<" bytes, largest for a lane: "<<maxLaneBufferBytes<<" bytes\n";
+  if(nViewedProducts_ != 0) {
+    std::cout <<"   data products given as views: "<<nViewedProducts_<<"\n";
+  }
+  if(not selection_.selectsAll()) {
+    std::cout <<"   events not selected: "<<nNotSelected_<<"\n";
+  }
+  if(readIndexed_) {
+    std::cout <<"   events read concurrently using the file's event index\n";
+  } else {
+    summarize_queue("read", queue_);
+  }
+  if(readAhead_) {
+    auto nRequests = readAhead_->nHits() + readAhead_->nMisses();
+    std::cout <<"   read ahead hits: "<<readAhead_->nHits()<<" misses: "<<readAhead_->nMisses();
+    if(nRequests != 0) {
+      std::cout <<" hit rate: "<<100.*readAhead_->nHits()/nRequests<<"%";
+    }
+    std::cout <<"\n   read ahead wait time: "<<readAhead_->waitTime().count()<<"us\n";
+    if(vectorReadEvents_ != 0) {
+      std::cout <<"   vector reads: "<<nVectorReads_<<"\n";
+    }
+  }
+  std::cout<<std::endl;
 };
 
+void SharedPDSSource::fillReport(RunReport& oReport) const {
+  oReport.set("readTime_us", readTime().count());
+  oReport.set("decompressTime_us", decompressTime().count());
+  oReport.set("deserializeTime_us", deserializeTime().count());
+  auto [bufferBytes, maxLaneBufferBytes] = laneBufferBytes();
+  oReport.set("laneBufferBytes", bufferBytes);
+  oReport.set("maxLaneBufferBytes", maxLaneBufferBytes);
+  if(not readIndexed_) {
+    report_queue(oReport, "read", queue_);
+  }
+  if(not selection_.selectsAll()) {
+    oReport.set("eventsNotSelected", nNotSelected_);
+  }
+  if(readAhead_) {
+    oReport.set("readAheadHits", readAhead_->nHits());
+    oReport.set("readAheadMisses", readAhead_->nMisses());
+    oReport.set("readAheadWaitTime_us", readAhead_->waitTime().count());
+    if(vectorReadEvents_ != 0) {
+      oReport.set("vectorReads", nVectorReads_);
+    }
+  }
+}
+
+std::pair<std::size_t, std::size_t> SharedPDSSource::laneBufferBytes() const {
+  std::size_t total = 0;
+  std::size_t largest = 0;
+  for(auto const& l : laneInfos_) {
+    auto bytes = l.bufferBytes();
+    total += bytes;
+    largest = std::max(largest, bytes);
+  }
+  return {total, largest};
+}
+
 std::chrono::microseconds SharedPDSSource::readTime() const {
-  return readTime_;
+  auto time = readTime_;
+  for(auto const& l : laneInfos_) {
+    time += l.readTime_;
+  }
+  return time;
 }
 
 std::chrono::microseconds SharedPDSSource::decompressTime() const {
   auto time = std::chrono::microseconds::zero();
   for(auto const& l : laneInfos_) {
     time += l.decompressTime_;
+    for(auto t: l.productDecompressTimes_) {
+      time += t;
+    }
   }
   return time;
 }
@@ -125,12 +650,34 @@ std::chrono::microseconds SharedPDSSource::deserializeTime() const {
   auto time = std::chrono::microseconds::zero();
   for(auto const& l : laneInfos_) {
     time += l.deserializeTime_;
+    for(auto t: l.productDeserializeTimes_) {
+      time += t;
+    }
   }
   return time;
 }
 
 
 namespace {
+  //e.g. "1.3,1.4" selects the lumis 3 and 4 of run 1
+  std::optional<std::vector<std::pair<uint32_t, uint32_t>>> parseLumis(std::string const& iLumis) {
+    std::vector<std::pair<uint32_t, uint32_t>> lumis;
+    std::istringstream stream(iLumis);
+    std::string item;
+    while(std::getline(stream, item, ',')) {
+      auto dot = item.find('.');
+      if(dot == std::string::npos) {
+        return {};
+      }
+      try {
+        lumis.emplace_back(std::stoul(item.substr(0, dot)), std::stoul(item.substr(dot+1)));
+      } catch(std::exception const&) {
+        return {};
+      }
+    }
+    return lumis;
+  }
+
     class Maker : public SourceMakerBase {
   public:
     Maker(): SourceMakerBase("SharedPDSSource") {}
@@ -140,7 +687,50 @@ namespace {
           std::cout <<"no file name given\n";
           return {};
         }
-        return std::make_unique<SharedPDSSource>(iNLanes, iNEvents, *fileName);
+        auto queueDrainBudget = params.get<unsigned int>("queueDrainBudget", 0);
+        std::size_t readAheadEvents = params.get<unsigned int>("readAheadEvents", 0);
+        std::size_t readAheadBytes = params.get<unsigned int>("readAheadMB", 0)*std::size_t(1024*1024);
+        std::size_t vectorReadEvents = params.get<unsigned int>("vectorReadEvents", 0);
+        if(vectorReadEvents != 0 and readAheadEvents == 0 and readAheadBytes == 0) {
+          //the vector reads are done by the read ahead thread, one can be in flight while the previous is used
+          readAheadEvents = 2*vectorReadEvents;
+        }
+        std::size_t deserializeTaskBytes = params.get<unsigned int>("deserializeTaskBytes", 0);
+        bool lazy = params.get<bool>("lazy", false);
+        if(lazy and deserializeTaskBytes != 0) {
+          std::cout <<"lazy can not be used with deserializeTaskBytes"<<std::endl;
+          return {};
+        }
+        ProductSelector selector{params.get<std::string>("products", "")};
+        auto lumis = parseLumis(params.get<std::string>("lumis", ""));
+        if(not lumis) {
+          std::cout <<"lumis must be a comma separated list of run.lumi"<<std::endl;
+          return {};
+        }
+        auto eventsFile = params.get<std::string>("events");
+        if((not lumis->empty() or eventsFile) and (readAheadEvents != 0 or readAheadBytes != 0) and vectorReadEvents == 0) {
+          std::cout <<"lumis and events can only be used with readAheadEvents or readAheadMB if vectorReadEvents is set"<<std::endl;
+          return {};
+        }
+        std::optional<std::vector<EventIdentifier>> events;
+        if(eventsFile) {
+          std::ifstream list(*eventsFile);
+          if(not list) {
+            std::cout <<"unable to open event list "<<*eventsFile<<std::endl;
+            return {};
+          }
+          events = readEventList(list);
+        }
+        bool views = params.get<bool>("views", false);
+        std::optional<EventSelection> selection;
+        try {
+          selection.emplace(params.get<std::string>("select", ""));
+        } catch(std::runtime_error const& iError) {
+          std::cout <<iError.what()<<std::endl;
+          return {};
+        }
+        return std::make_unique<SharedPDSSource>(iNLanes, iNEvents, *fileName, queueDrainBudget, readAheadEvents, readAheadBytes,
+                                                 vectorReadEvents, deserializeTaskBytes, lazy, selector, *lumis, events, views, *selection);
     }
     };
 
@@ -5,7 +5,9 @@
 #include <memory>
 #include <chrono>
 #include <iostream>
-#include <fstream>
+#include <atomic>
+#include <deque>
+#include <optional>
 
 #include "SharedSourceBase.h"
 #include "DataProductRetriever.h"
@@ -13,39 +15,110 @@
 #include "SerialTaskQueue.h"
 #include "DeserializeStrategy.h"
 #include "pds_reading.h"
+#include "ReadAheadBuffer.h"
+#include "EventList.h"
+
+#include "tbb/enumerable_thread_specific.h"
+#include "PerLaneCounter.h"
 
 
 namespace cce::tf {
+  class SharedPDSSource;
+
+  //Only does work when the Source defers deserialization until a data product is requested
   class SharedPDSDelayedRetriever : public DelayedProductRetriever {
-    void getAsync(DataProductRetriever&, int index, TaskHolder) final {}
+  public:
+    void setSource(SharedPDSSource* iSource, unsigned int iLane) { source_ = iSource; lane_ = iLane; }
+    void getAsync(DataProductRetriever&, int index, TaskHolder) final;
+  private:
+    SharedPDSSource* source_ = nullptr;
+    unsigned int lane_ = 0;
   };
   
   class SharedPDSSource : public SharedSourceBase {
   public:
-    SharedPDSSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iFileName);
+    SharedPDSSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iFileName, unsigned int iQueueDrainBudget=0,
+                    std::size_t iReadAheadEvents=0, std::size_t iReadAheadBytes=0, std::size_t iVectorReadEvents=0,
+                    std::size_t iDeserializeTaskBytes=0, bool iLazy=false,
+                    ProductSelector const& iSelector = ProductSelector(),
+                    std::vector<std::pair<uint32_t, uint32_t>> const& iLumis = {},
+                    std::optional<std::vector<EventIdentifier>> const& iEvents = {},
+                    bool iViews = false,
+                    EventSelection const& iSelection = EventSelection());
     SharedPDSSource(SharedPDSSource&&) = delete;
     SharedPDSSource(SharedPDSSource const&) = delete;
-    ~SharedPDSSource() = default;
+    ~SharedPDSSource();
 
   size_t numberOfDataProducts() const final;
   std::vector<DataProductRetriever>& dataProducts(unsigned int iLane, long iEventIndex) final;
   EventIdentifier eventIdentifier(unsigned int iLane, long iEventIndex) final;
 
   void printSummary() const final;
+  void fillReport(RunReport&) const final;
+
+  //used in lazy mode, the data product is deserialized the first time it is requested in an event
+  void getProductAsync(unsigned int iLane, int iIndex, TaskHolder iCallback);
   private:
   
   void readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder) final;
 
+  struct CompressedEvent {
+    EventIdentifier eventID_;
+    std::vector<uint32_t> buffer_;
+  };
+  bool nextCompressedEvent(EventIdentifier&, std::vector<uint32_t>&);
+  //reads the next event of file_ passing selection_
+  bool readSelectedEvent(EventIdentifier&, std::vector<uint32_t>&);
+  //called by the read ahead thread
+  bool readAheadEvent(CompressedEvent&);
+  //reads the event directly using the file's event index
+  void readIndexedEvent(unsigned int iLane, long iEventIndex, OptionalTaskHolder);
+  void decompress(unsigned int iLane, std::vector<uint32_t> const& iBuffer);
+  void deserialize(unsigned int iLane);
+  //if deserializeTaskBytes_ is not 0, the data products are deserialized in
+  // separate tasks which hold iTask
+  void deserializeAsync(unsigned int iLane, TaskHolder iTask);
+  //used when each data product was compressed separately. Each data product
+  // is decompressed and deserialized in its own task.
+  void decompressAndDeserializeProductsAsync(unsigned int iLane, std::vector<uint32_t> iBuffer, TaskHolder iTask);
+  void decompressAndDeserializeProduct(unsigned int iLane, pds::ProductBuffer const&);
+  //removes the data products which are not read and changes the others to use the index of their DataProductRetriever
+  void selectProductBuffers(std::vector<pds::ProductBuffer>&) const;
+  //in lazy mode, readies compressedBuffer_ of the lane so data products can be found by getProductAsync
+  void prepareLazyProducts(unsigned int iLane);
+
   std::chrono::microseconds readTime() const;
   std::chrono::microseconds decompressTime() const;
   std::chrono::microseconds deserializeTime() const;
+  //summed over Lanes and the largest for one Lane
+  std::pair<std::size_t, std::size_t> laneBufferBytes() const;
 
+  //set if the events were compressed using a ZSTD dictionary
+  std::unique_ptr<pds::DecompressionDictionary> dictionary_;
+  //0 means all data products of an event are deserialized in one task
+  std::size_t deserializeTaskBytes_;
+  bool lazy_;
+  //number of data products given as their serialized bytes, to be read in place, see ProductView.h
+  unsigned int nViewedProducts_ = 0;
   pds::Compression compression_;
-  std::ifstream file_;
+  bool perProductCompression_;
+  //each event record ends with a checksum which is verified before decompressing
+  bool checksum_;
+  pds::ProductMap productMap_;
+  //empty unless the file stores repeated data products at its end
+  std::vector<pds::RepeatedProduct> repeatedProducts_;
+  //the byte shuffle of each data product in the file, see kHeaderShuffleTag, and of each data product read
+  std::vector<uint8_t> shuffle_;
+  std::vector<uint8_t> productShuffle_;
+  //the per product tasks of any Lane can run on any thread
+  tbb::enumerable_thread_specific<pds::DecompressionContext> productDecompressionContexts_;
+  pds::ByteSourceStream file_;
   SerialTaskQueue queue_;
 
-  struct LaneInfo {
+  struct alignas(kCacheLineSize) LaneInfo {
     LaneInfo(std::vector<pds::ProductInfo> const&, DeserializeStrategy);
+    //iClasses holds the class of each entry of productInfo. Lanes can do this in parallel.
+    void makeDataProducts(std::vector<pds::ProductInfo> const& productInfo, std::vector<TClass*> const& iClasses);
 
     LaneInfo(LaneInfo&&) = default;
     LaneInfo(LaneInfo const&) = delete;
@@ -56,15 +129,49 @@ namespace cce::tf {
     EventIdentifier eventID_;
     std::vector<DataProductRetriever> dataProducts_;
     std::vector<void*> dataBuffers_;
-    DeserializeStrategy deserializers_; //NOTE: could be shared between lanes?
+    DeserializeStrategy deserializers_; //unrolled action sequences are shared between lanes
     SharedPDSDelayedRetriever delayedRetriever_;
+    pds::ReusableBuffer<uint32_t> uncompressedBuffer_;
+    pds::DecompressionContext decompressionContext_;
+    pds::RepeatedProductsCache repeatedProductsCache_;
+    //used when each data product was compressed separately, all indexed by product
+    std::vector<pds::ProductBuffer> productBuffers_;
+    std::vector<pds::ReusableBuffer<char>> uncompressedProductBuffers_;
+    std::vector<std::chrono::microseconds> productDecompressTimes_;
+    std::vector<std::chrono::microseconds> productDeserializeTimes_;
+    //[begin, end) of the data products deserialized by each task
+    std::vector<std::pair<uint32_t const*, uint32_t const*>> deserializeGroups_;
+    //used in lazy mode, the event is held until the Lane is done with it
+    std::vector<uint32_t> compressedBuffer_;
+    //start and stored size in words of each data product in uncompressedBuffer_, indexed by product
+    std::vector<std::pair<uint32_t const*, uint32_t>> storedProducts_;
+    //set once a data product has been requested in the present event
+    std::unique_ptr<std::atomic<bool>[]> productRequested_;
+    std::chrono::microseconds readTime_;
     std::chrono::microseconds decompressTime_;
     std::chrono::microseconds deserializeTime_;
+    //bytes held by the buffers reused from one event to the next
+    std::size_t bufferBytes() const;
     ~LaneInfo();
   };
 
   std::vector<LaneInfo> laneInfos_;
   std::chrono::microseconds readTime_;
+  //when the file has an index, events are read concurrently from file_.source().
+  // Only holds the selected events when lumis, events or select were given.
+  std::vector<pds::EventIndexEntry> eventIndex_;
+  bool readIndexed_ = false;
+  //when used, only the read ahead thread reads from file_
+  std::unique_ptr<ReadAheadBuffer<CompressedEvent>> readAhead_;
+  //if non 0, the read ahead thread uses eventIndex_ to read this many events with one vector read
+  std::size_t vectorReadEvents_;
+  //only used by the read ahead thread
+  std::deque<CompressedEvent> vectorReadBuffer_;
+  std::size_t nextVectorReadIndex_ = 0;
+  unsigned long long nVectorReads_ = 0;
+  //events whose identifier is not selected are skipped before being decompressed
+  EventSelection selection_;
+  unsigned long long nNotSelected_ = 0;
   };
 }
 
@@ -0,0 +1,228 @@
+#include "SharedRNTupleEventSource.h"
+#include "SourceFactory.h"
+#include "summarize_queue.h"
+#include "Deserializer.h"
+#include "UnrolledDeserializer.h"
+#include "FixedLayoutDeserializer.h"
+
+#include "TClass.h"
+#include "TFile.h"
+#include "TTree.h"
+#include "TBranch.h"
+
+#include <cassert>
+#include <iostream>
+
+using namespace cce::tf;
+
+SharedRNTupleEventSource::SharedRNTupleEventSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iName,
+                                                   ProductSelector const& iSelector,
+                                                   bool iPassThrough) :
+  SharedSourceBase(iNEvents),
+  passThrough_{iPassThrough},
+  events_{ROOT::Experimental::RNTupleReader::Open("Events", iName)},
+  readTime_{std::chrono::microseconds::zero()}
+{
+  offsetsView_.emplace(events_->GetView<std::vector<uint32_t>>("offsets"));
+  blobView_.emplace(events_->GetView<std::vector<char>>("blob"));
+  idView_.emplace(events_->GetView<EventIdentifier>("EventID"));
+
+  //the meta data is kept in the same TTree as written by RootEventOutputer
+  std::unique_ptr<TFile> file{TFile::Open(iName.c_str())};
+  if(not file) {
+    std::cout <<"unknown file "<<iName<<std::endl;
+    throw std::runtime_error("uknown file");
+  }
+  auto meta = file->Get<TTree>("Meta");
+  if(not meta) {
+    std::cout <<"no 'Meta' TTree in file "<<iName<<std::endl;
+    throw std::runtime_error("no 'Meta' TTree");
+  }
+
+  std::vector<std::pair<std::string, std::string>> typeAndNames;
+  int objectSerializationUsed;
+  std::string compression;
+  {
+    auto typeAndNamesBranch = meta->GetBranch("DataProducts");
+    auto pTemp = &typeAndNames;
+    typeAndNamesBranch->SetAddress(&pTemp);
+    typeAndNamesBranch->GetEntry(0);
+  }
+  {
+    auto serializerBranch = meta->GetBranch("objectSerializationUsed");
+    serializerBranch->SetAddress(&objectSerializationUsed);
+    serializerBranch->GetEntry(0);
+  }
+  {
+    auto compressionBranch = meta->GetBranch("compressionAlgorithm");
+    auto pTemp = &compression;
+    compressionBranch->SetAddress(&pTemp);
+    compressionBranch->GetEntry(0);
+  }
+
+  serialization_ = pds::Serialization{objectSerializationUsed};
+
+  if(auto c = pds::toCompression(compression)) {
+    compression_ = *c;
+  } else {
+    std::cout <<"Unknown compression algorithm '"<<compression<<"'"<<std::endl;
+    throw std::runtime_error("unknown compression algorithm");
+  }
+
+  std::vector<pds::ProductInfo> productInfo;
+  productInfo.reserve(typeAndNames.size());
+  {
+    unsigned int index = 0;
+    for( auto const& [type, name]: typeAndNames) {
+      productInfo.emplace_back(name, index++, type);
+    }
+  }
+  productMap_ = pds::selectProducts(productInfo, iSelector);
+
+  laneInfos_.reserve(iNLanes);
+  for(unsigned int i = 0; i< iNLanes; ++i) {
+    DeserializeStrategy strategy;
+    switch(serialization_) {
+    case pds::Serialization::kRoot: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<Deserializer>>(); break;
+    }
+    case pds::Serialization::kRootUnrolled: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<UnrolledDeserializer>>(); break;
+    }
+    case pds::Serialization::kNativeUnrolled: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<NativeUnrolledDeserializer>>(); break;
+    }
+    case pds::Serialization::kFixedLayout: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<FixedLayoutDeserializer>>(); break;
+    }
+    }
+    laneInfos_.emplace_back(productInfo, std::move(strategy));
+  }
+}
+
+SharedRNTupleEventSource::LaneInfo::LaneInfo(std::vector<pds::ProductInfo> const& productInfo, DeserializeStrategy deserialize):
+  deserializers_{std::move(deserialize)},
+  decompressTime_{std::chrono::microseconds::zero()},
+  deserializeTime_{std::chrono::microseconds::zero()}
+{
+  dataProducts_.reserve(productInfo.size());
+  dataBuffers_.resize(productInfo.size(), nullptr);
+  deserializers_.reserve(productInfo.size());
+  size_t index =0;
+  for(auto const& pi : productInfo) {
+    TClass* cls = TClass::GetClass(pi.className().c_str());
+    assert(cls);
+    dataBuffers_[index] = cls->New();
+    dataProducts_.emplace_back(index,
+                               &dataBuffers_[index],
+                               pi.name(),
+                               cls,
+                               &delayedRetriever_);
+    deserializers_.emplace_back(cls);
+    ++index;
+  }
+}
+
+SharedRNTupleEventSource::LaneInfo::~LaneInfo() {
+  auto it = dataProducts_.begin();
+  for( void * b: dataBuffers_) {
+    it->classType()->Destructor(b);
+    ++it;
+  }
+}
+
+size_t SharedRNTupleEventSource::numberOfDataProducts() const {
+  return laneInfos_[0].dataProducts_.size();
+}
+
+std::vector<DataProductRetriever>& SharedRNTupleEventSource::dataProducts(unsigned int iLane, long iEventIndex) {
+  return laneInfos_[iLane].dataProducts_;
+}
+
+EventIdentifier SharedRNTupleEventSource::eventIdentifier(unsigned int iLane, long iEventIndex) {
+  return laneInfos_[iLane].eventID_;
+}
+
+void SharedRNTupleEventSource::readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder iTask) {
+  queue_.push(*iTask.group(), [iLane, optTask = std::move(iTask), this, iEventIndex]() mutable {
+      auto start = std::chrono::high_resolution_clock::now();
+      if(iEventIndex < static_cast<long>(events_->GetNEntries())) {
+        laneInfos_[iLane].eventID_ = (*idView_)(iEventIndex);
+        std::pair<std::vector<uint32_t>, std::vector<char>> offsetsAndBuffer{(*offsetsView_)(iEventIndex), (*blobView_)(iEventIndex)};
+
+        auto group = optTask.group();
+        group->run([this, offsetsAndBuffer=std::move(offsetsAndBuffer), task = optTask.releaseToTaskHolder(), iLane]() {
+            auto& laneInfo = this->laneInfos_[iLane];
+
+            auto start = std::chrono::high_resolution_clock::now();
+            auto& uBuffer = laneInfo.uncompressedBuffer_;
+            pds::uncompressBuffer(this->compression_, offsetsAndBuffer.second, offsetsAndBuffer.first.back(), uBuffer, laneInfo.decompressionContext_);
+            laneInfo.decompressTime_ +=
+              std::chrono::duration_cast<decltype(laneInfo.decompressTime_)>(std::chrono::high_resolution_clock::now() - start);
+
+            if(passThrough_) {
+              //the Lane's uncompressed buffer is kept until its next event
+              pds::passThroughDataProducts(uBuffer.data(), uBuffer.data()+uBuffer.size(),
+                                           offsetsAndBuffer.first.begin(), offsetsAndBuffer.first.end(),
+                                           laneInfo.dataProducts_, serialization_, productMap_);
+              return;
+            }
+            start = std::chrono::high_resolution_clock::now();
+            pds::deserializeDataProducts(uBuffer.data(), uBuffer.data()+uBuffer.size(),
+                                         offsetsAndBuffer.first.begin(), offsetsAndBuffer.first.end(),
+                                         laneInfo.dataProducts_, laneInfo.deserializers_, productMap_);
+            laneInfo.deserializeTime_ +=
+              std::chrono::duration_cast<decltype(laneInfo.deserializeTime_)>(std::chrono::high_resolution_clock::now() - start);
+          });
+      }
+      readTime_ +=std::chrono::duration_cast<decltype(readTime_)>(std::chrono::high_resolution_clock::now() - start);
+    });
+}
+
+void SharedRNTupleEventSource::printSummary() const {
+  std::cout <<"\nSource:\n"
+    "   read time: "<<readTime_.count()<<"us\n"
+    "   decompress time: "<<decompressTime().count()<<"us\n"
+    "   deserialize time: "<<deserializeTime().count()<<"us\n";
+  if(passThrough_) {
+    std::cout <<"   data products passed through serialized\n";
+  }
+  summarize_queue("read", queue_);
+  std::cout<<std::endl;
+}
+
+std::chrono::microseconds SharedRNTupleEventSource::decompressTime() const {
+  auto time = std::chrono::microseconds::zero();
+  for(auto const& l : laneInfos_) {
+    time += l.decompressTime_;
+  }
+  return time;
+}
+
+std::chrono::microseconds SharedRNTupleEventSource::deserializeTime() const {
+  auto time = std::chrono::microseconds::zero();
+  for(auto const& l : laneInfos_) {
+    time += l.deserializeTime_;
+  }
+  return time;
+}
+
+
+namespace {
+    class Maker : public SourceMakerBase {
+  public:
+    Maker(): SourceMakerBase("SharedRNTupleEventSource") {}
+      std::unique_ptr<SharedSourceBase> create(unsigned int iNLanes, unsigned long long iNEvents, ConfigurationParameters const& params) const final {
+        auto fileName = params.get<std::string>("fileName");
+        if(not fileName) {
+          std::cout <<"no file name given\n";
+          return {};
+        }
+        ProductSelector selector{params.get<std::string>("products", "")};
+        bool passThrough = params.get<bool>("passThrough", false);
+        return std::make_unique<SharedRNTupleEventSource>(iNLanes, iNEvents, *fileName, selector, passThrough);
+    }
+    };
+
+  Maker s_maker;
+}
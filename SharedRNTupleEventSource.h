@@ -0,0 +1,93 @@
+#if !defined(SharedRNTupleEventSource_h)
+#define SharedRNTupleEventSource_h
+
+#include <string>
+#include <memory>
+#include <chrono>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "SharedSourceBase.h"
+#include "DataProductRetriever.h"
+#include "DelayedProductRetriever.h"
+#include "SerialTaskQueue.h"
+#include "DeserializeStrategy.h"
+#include "ProductSelector.h"
+#include "pds_reading.h"
+#include <ROOT/RNTuple.hxx>
+
+
+namespace cce::tf {
+  class SharedRNTupleEventDelayedRetriever : public DelayedProductRetriever {
+    void getAsync(DataProductRetriever&, int index, TaskHolder) final {}
+  };
+
+  /**
+     Reads the files of RNTupleEventOutputer. Like SharedRootEventSource,
+     reading the offsets and the compressed blob of an _event_ is serialized
+     while its decompression and deserialization run in a task of their own,
+     concurrently with those of the other Events.
+   */
+  class SharedRNTupleEventSource : public SharedSourceBase {
+  public:
+    SharedRNTupleEventSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iFileName,
+                             ProductSelector const& iSelector = ProductSelector(),
+                             bool iPassThrough = false);
+    SharedRNTupleEventSource(SharedRNTupleEventSource&&) = delete;
+    SharedRNTupleEventSource(SharedRNTupleEventSource const&) = delete;
+    ~SharedRNTupleEventSource() = default;
+
+  size_t numberOfDataProducts() const final;
+  std::vector<DataProductRetriever>& dataProducts(unsigned int iLane, long iEventIndex) final;
+  EventIdentifier eventIdentifier(unsigned int iLane, long iEventIndex) final;
+
+  void printSummary() const final;
+  private:
+
+  void readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder) final;
+
+  std::chrono::microseconds decompressTime() const;
+  std::chrono::microseconds deserializeTime() const;
+
+  pds::Compression compression_;
+  pds::Serialization serialization_;
+  //the data products are given to the Outputers still serialized, see DataProductRetriever::setSerialized
+  bool passThrough_;
+  pds::ProductMap productMap_;
+  std::unique_ptr<ROOT::Experimental::RNTupleReader> events_;
+  template<typename T>
+  using View = decltype(std::declval<ROOT::Experimental::RNTupleReader&>().template GetView<T>(""));
+  //made once so reading an entry does not look up the fields
+  std::optional<View<std::vector<uint32_t>>> offsetsView_;
+  std::optional<View<std::vector<char>>> blobView_;
+  std::optional<View<EventIdentifier>> idView_;
+  SerialTaskQueue queue_;
+
+  struct alignas(kCacheLineSize) LaneInfo {
+    LaneInfo(std::vector<pds::ProductInfo> const&, DeserializeStrategy);
+
+    LaneInfo(LaneInfo&&) = default;
+    LaneInfo(LaneInfo const&) = delete;
+
+    LaneInfo& operator=(LaneInfo&&) = default;
+    LaneInfo& operator=(LaneInfo const&) = delete;
+
+    EventIdentifier eventID_;
+    std::vector<DataProductRetriever> dataProducts_;
+    std::vector<void*> dataBuffers_;
+    DeserializeStrategy deserializers_;
+    SharedRNTupleEventDelayedRetriever delayedRetriever_;
+    pds::ReusableBuffer<char> uncompressedBuffer_;
+    pds::DecompressionContext decompressionContext_;
+    std::chrono::microseconds decompressTime_;
+    std::chrono::microseconds deserializeTime_;
+    ~LaneInfo();
+  };
+
+  std::vector<LaneInfo> laneInfos_;
+  std::chrono::microseconds readTime_;
+  };
+}
+
+#endif
@@ -1,17 +1,49 @@
 #include "SharedRootBatchEventsSource.h"
 #include "SourceFactory.h"
+#include "summarize_queue.h"
 #include "Deserializer.h"
 #include "UnrolledDeserializer.h"
+#include "FixedLayoutDeserializer.h"
+#include "FunctorTask.h"
+#include "compact_index.h"
 
 #include "TClass.h"
+#include "RootIMT.h"
+#include "tbb/parallel_for.h"
 
 using namespace cce::tf;
 
-SharedRootBatchEventsSource::SharedRootBatchEventsSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iName) :
+namespace {
+  //puts the data products of each event next to each other, as they were before being stored one data product after another
+  void toEventMajor(pds::ReusableBuffer<char> const& iProductMajor, std::vector<uint32_t> const& iOffsets, size_t iNEvents,
+                    size_t iEntriesInOffset, pds::ReusableBuffer<char>& oEventMajor) {
+    oEventMajor.resize(iProductMajor.size());
+    std::vector<uint32_t> eventStarts;
+    eventStarts.reserve(iNEvents);
+    uint32_t start = 0;
+    for(size_t event = 0; event < iNEvents; ++event) {
+      eventStarts.push_back(start);
+      start += iOffsets[(event+1)*iEntriesInOffset-1];
+    }
+    auto source = iProductMajor.begin();
+    for(size_t product = 0; product+1 < iEntriesInOffset; ++product) {
+      for(size_t event = 0; event < iNEvents; ++event) {
+        auto const begin = iOffsets[event*iEntriesInOffset+product];
+        auto const size = iOffsets[event*iEntriesInOffset+product+1] - begin;
+        std::copy(source, source+size, oEventMajor.begin()+eventStarts[event]+begin);
+        source += size;
+      }
+    }
+  }
+}
+
+SharedRootBatchEventsSource::SharedRootBatchEventsSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iName,
+                                                         ProductSelector const& iSelector, bool iGPUDecompression) :
   SharedSourceBase(iNEvents),
   file_{TFile::Open(iName.c_str())},
   pEventIDs_(&eventIDs_),
   pOffsetsAndBuffer_(&offsetsAndBuffer_),
+  pCompactIndex_(&compactIndexBytes_),
   readTime_{std::chrono::microseconds::zero()}
 {
 
@@ -27,6 +59,7 @@ SharedRootBatchEventsSource::SharedRootBatchEventsSource(unsigned int iNLanes, u
     std::cout <<"no Events TTree in file "<<iName<<std::endl;
     throw std::runtime_error("no Events TTree");
   }
+  eventsTree_->SetImplicitMT(rootIMTForSources());
   eventsBranch_ = eventsTree_->GetBranch("offsetsAndBlob");
   eventsBranch_->SetAddress(&pOffsetsAndBuffer_);
   if( not eventsBranch_) {
@@ -34,12 +67,6 @@ SharedRootBatchEventsSource::SharedRootBatchEventsSource(unsigned int iNLanes, u
     throw std::runtime_error("no 'offsetsAndBlob' TBranch");
   }
 
-  idBranch_ = eventsTree_->GetBranch("EventIDs");
-  idBranch_->SetAddress(&pEventIDs_);
-  if(not idBranch_) {
-    std::cout <<"no 'EventIDs' TBranch in 'Events' TTree in file "<<iName<<std::endl;
-    throw std::runtime_error("no 'EventIDs' TBranch");
-  }
    
   auto meta = file_->Get<TTree>("Meta");
   if(not meta) {
@@ -77,21 +104,50 @@ SharedRootBatchEventsSource::SharedRootBatchEventsSource(unsigned int iNLanes, u
     compressionBranch->GetEntry(0);
     //std::cout <<"compressionAlgorithm "<<compression<<std::endl;
   }
+  if(auto productMajorBranch = meta->GetBranch("productMajor")) {
+    //files written before the option was added do not have the branch
+    productMajorBranch->SetAddress(&productMajor_);
+    productMajorBranch->GetEntry(0);
+  }
+  if(auto compactIndexBranch = meta->GetBranch("compactIndex")) {
+    compactIndexBranch->SetAddress(&compactIndex_);
+    compactIndexBranch->GetEntry(0);
+  }
+
+  if(compactIndex_) {
+    idBranch_ = eventsTree_->GetBranch("compactIndex");
+    if(not idBranch_) {
+      std::cout <<"no 'compactIndex' TBranch in 'Events' TTree in file "<<iName<<std::endl;
+      throw std::runtime_error("no 'compactIndex' TBranch");
+    }
+    idBranch_->SetAddress(&pCompactIndex_);
+  } else {
+    idBranch_ = eventsTree_->GetBranch("EventIDs");
+    if(not idBranch_) {
+      std::cout <<"no 'EventIDs' TBranch in 'Events' TTree in file "<<iName<<std::endl;
+      throw std::runtime_error("no 'EventIDs' TBranch");
+    }
+    idBranch_->SetAddress(&pEventIDs_);
+  }
 
   assert(objectSerializationUsed == static_cast<int>(pds::Serialization::kRoot) or 
-         objectSerializationUsed == static_cast<int>(pds::Serialization::kRootUnrolled));
+         objectSerializationUsed == static_cast<int>(pds::Serialization::kRootUnrolled) or
+         objectSerializationUsed == static_cast<int>(pds::Serialization::kFixedLayout) or
+         objectSerializationUsed == static_cast<int>(pds::Serialization::kNativeUnrolled));
   pds::Serialization serialization{objectSerializationUsed};
 
-  if (compression == "None") {
-    compression_ = pds::Compression::kNone;
-  }else if (compression == "LZ4") {
-    compression_ = pds::Compression::kLZ4;
-  }else if (compression == "ZSTD") {
-    compression_ = pds::Compression::kZSTD;
+  if(auto c = pds::toCompression(compression)) {
+    compression_ = *c;
   } else {
     std::cout <<"Unknown compression algorithm '"<<compression<<"'"<<std::endl;
     throw std::runtime_error("unknown compression algorithm");
   }
+  if(iGPUDecompression) {
+    batchDecompressor_ = std::make_unique<BatchDecompressor>(compression_, true);
+    if(not batchDecompressor_->usesGPU()) {
+      std::cout <<"no GPU decompression available for "<<compression<<", decompressing on the CPU"<<std::endl;
+    }
+  }
 
   std::vector<pds::ProductInfo> productInfo;
   productInfo.reserve(typeAndNames.size());
@@ -101,6 +157,8 @@ SharedRootBatchEventsSource::SharedRootBatchEventsSource(unsigned int iNLanes, u
       productInfo.emplace_back(name, index++, type);
     }
   }
+  nFileProducts_ = productInfo.size();
+  productMap_ = pds::selectProducts(productInfo, iSelector);
 
   laneInfos_.reserve(iNLanes);
   for(unsigned int i = 0; i< iNLanes; ++i) {
@@ -112,6 +170,12 @@ SharedRootBatchEventsSource::SharedRootBatchEventsSource(unsigned int iNLanes, u
     case pds::Serialization::kRootUnrolled: {
       strategy = DeserializeStrategy::make<DeserializeProxy<UnrolledDeserializer>>(); break;
     }
+    case pds::Serialization::kNativeUnrolled: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<NativeUnrolledDeserializer>>(); break;
+    }
+    case pds::Serialization::kFixedLayout: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<FixedLayoutDeserializer>>(); break;
+    }
     }
     laneInfos_.emplace_back(productInfo, std::move(strategy));
   }
@@ -121,7 +185,6 @@ SharedRootBatchEventsSource::SharedRootBatchEventsSource(unsigned int iNLanes, u
 
 SharedRootBatchEventsSource::LaneInfo::LaneInfo(std::vector<pds::ProductInfo> const& productInfo, DeserializeStrategy deserialize):
   deserializers_{std::move(deserialize)},
-  decompressTime_{std::chrono::microseconds::zero()},
   deserializeTime_{std::chrono::microseconds::zero()}
 {
   dataProducts_.reserve(productInfo.size());
@@ -164,82 +227,205 @@ EventIdentifier SharedRootBatchEventsSource::eventIdentifier(unsigned int iLane,
 }
 
 void SharedRootBatchEventsSource::readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder iTask) {
-  //NOTE: if need future scaling performance, could move decompression out of the queue
-  // and then have multiple buffers for data read from ROOT.
+  //only reading from the file and handing out events is done in the queue. Decompression of a batch
+  // happens in its own task and each lane deserializes its event directly from the shared batch.
   queue_.push(*iTask.group(), [iLane, optTask = std::move(iTask), this]() mutable {
       auto start = std::chrono::high_resolution_clock::now();
-      if(nextEntry_ < eventsTree_->GetEntries() or (cachedEventIndex_ < eventIDs_.size())) {
-        if(cachedEventIndex_ == eventIDs_.size()) {
-          //need to read ahead
-          eventsTree_->GetEntry(nextEntry_++);
+      auto& group = *optTask.group();
+      std::vector<uint32_t> offsets;
+      uint32_t beginOffsetInBuffer;
+      if(nextEvent(iLane, group, offsets, beginOffsetInBuffer)) {
+        deserializeAsync(iLane, std::move(offsets), beginOffsetInBuffer, optTask.releaseToTaskHolder());
+      }
+      readTime_ +=std::chrono::duration_cast<decltype(readTime_)>(std::chrono::high_resolution_clock::now() - start);
+    });
+}
 
-          auto start = std::chrono::high_resolution_clock::now();
-          //determine uncompressed size
-          const auto entriesInOffset = laneInfos_[iLane].dataProducts_.size()+1;
-          unsigned int summedSizes=0;
-          for(int index = 0; index < eventIDs_.size(); ++index) {
-            //the last entry in the offsets is the uncompressed size for that event
-            summedSizes += offsetsAndBuffer_.first[(index+1)*entriesInOffset-1];
-          }
-          uncompressedBuffer_ = pds::uncompressBuffer(this->compression_, offsetsAndBuffer_.second, summedSizes);
-          //std::cout <<"compressed buffer size "<<offsetsAndBuffer_.second.size() <<std::endl;
-          //std::cout <<"uncompressed buffer size "<<uncompressedBuffer_.size() <<std::endl;
-          offsetsAndBuffer_.second = std::vector<char>(); //free memory
-          laneInfos_[iLane].decompressTime_ += 
-            std::chrono::duration_cast<decltype(laneInfos_[iLane].decompressTime_)>(std::chrono::high_resolution_clock::now() - start);
-
-          cachedEventIndex_ = 0;
+void SharedRootBatchEventsSource::readEventsAsync(unsigned int iFirstLane, long iFirstEventIndex, unsigned int iNEvents, OptionalTaskHolder iTask) {
+  //all the events are handed out in one step of the queue
+  queue_.push(*iTask.group(), [iFirstLane, iNEvents, optTask = std::move(iTask), this]() mutable {
+      auto start = std::chrono::high_resolution_clock::now();
+      auto& group = *optTask.group();
+      std::vector<std::pair<std::vector<uint32_t>, uint32_t>> events(iNEvents);
+      bool allRead = true;
+      for(unsigned int i = 0; i < iNEvents and allRead; ++i) {
+        allRead = nextEvent(iFirstLane+i, group, events[i].first, events[i].second);
+      }
+      if(allRead) {
+        auto task = optTask.releaseToTaskHolder();
+        for(unsigned int i = 0; i < iNEvents; ++i) {
+          deserializeAsync(iFirstLane+i, std::move(events[i].first), events[i].second, task);
         }
-        laneInfos_[iLane].eventID_ = eventIDs_[cachedEventIndex_];
-        
-        const auto entriesInOffset = laneInfos_[iLane].dataProducts_.size()+1;
-        const unsigned int indexIntoOffsets = cachedEventIndex_*entriesInOffset;
-        std::vector<uint32_t> offsets(offsetsAndBuffer_.first.begin()+indexIntoOffsets,
-                                      offsetsAndBuffer_.first.begin()+indexIntoOffsets+entriesInOffset);
-
-        unsigned int beginOffsetInBuffer = 0;
-        for(int index = 1; index <= cachedEventIndex_; ++index) {
-          beginOffsetInBuffer += offsetsAndBuffer_.first[index*entriesInOffset-1];
+      } else {
+        for(unsigned int i = 0; i < iNEvents; ++i) {
+          laneInfos_[iFirstLane+i].batch_.reset();
         }
-        unsigned int endOffsetInBuffer = beginOffsetInBuffer + offsets.back();
-
-        std::vector<char> uBuffer(uncompressedBuffer_.begin()+beginOffsetInBuffer,
-                                  uncompressedBuffer_.begin()+endOffsetInBuffer);
-
-        ++cachedEventIndex_;
-        /*{
-           auto const& id = this->laneInfos_[iLane].eventID_;
-          std::cout <<"event entry "<<nextEntry_-1<<" cache index "<<cachedEventIndex_-1<<std::endl;
-          std::cout <<"ID "<<id.run<<" "<<id.lumi<<" "<<id.event<<std::endl;
-          std::cout <<"ubuffer size "<<uBuffer.size()<<std::endl;
-          std::cout <<"offset size "<<offsets.size()<<std::endl;
-          //for(auto b: buffer) {
-          //  std::cout <<"  "<<b<<std::endl;
-          //}
-          }*/
-
-        auto group = optTask.group();
-        group->run([this, offsets=std::move(offsets), uBuffer = std::move(uBuffer), task = optTask.releaseToTaskHolder(), iLane]() {
-            auto& laneInfo = this->laneInfos_[iLane];
-
-            auto start = std::chrono::high_resolution_clock::now();
-            //uBuffer.pop_back();
-            pds::deserializeDataProducts(uBuffer.data(), uBuffer.data()+uBuffer.size(), 
-                                         offsets.begin(), offsets.end(),
-                                         laneInfo.dataProducts_, laneInfo.deserializers_);
-            laneInfo.deserializeTime_ += 
-              std::chrono::duration_cast<decltype(laneInfo.deserializeTime_)>(std::chrono::high_resolution_clock::now() - start);
-          });
       }
       readTime_ +=std::chrono::duration_cast<decltype(readTime_)>(std::chrono::high_resolution_clock::now() - start);
     });
 }
 
+bool SharedRootBatchEventsSource::nextEvent(unsigned int iLane, tbb::task_group& iGroup, std::vector<uint32_t>& oOffsets, uint32_t& oBeginOffsetInBuffer) {
+  if(not currentBatch_ or cachedEventIndex_ == currentBatch_->eventIDs_.size()) {
+    currentBatch_ = nextBatch_ ? std::move(nextBatch_) : readBatch(iGroup);
+    cachedEventIndex_ = 0;
+    if(currentBatch_ and nextEntry_ < eventsTree_->GetEntries()) {
+      //read the next batch while the events of this one are being processed
+      queue_.push(iGroup, [this, &iGroup]() {
+          auto start = std::chrono::high_resolution_clock::now();
+          nextBatch_ = readBatch(iGroup);
+          readTime_ +=std::chrono::duration_cast<decltype(readTime_)>(std::chrono::high_resolution_clock::now() - start);
+        });
+    }
+  }
+  if(not currentBatch_) {
+    return false;
+  }
+  auto& laneInfo = laneInfos_[iLane];
+  laneInfo.eventID_ = currentBatch_->eventIDs_[cachedEventIndex_];
+  //the lane's previous event has finished so its batch was already released
+  laneInfo.batch_ = currentBatch_;
+
+  const auto entriesInOffset = nFileProducts_+1;
+  const unsigned int indexIntoOffsets = cachedEventIndex_*entriesInOffset;
+  oOffsets.assign(currentBatch_->offsets_.begin()+indexIntoOffsets,
+                  currentBatch_->offsets_.begin()+indexIntoOffsets+entriesInOffset);
+  oBeginOffsetInBuffer = currentBatch_->eventStarts_[cachedEventIndex_];
+  ++cachedEventIndex_;
+  return true;
+}
+
+void SharedRootBatchEventsSource::deserializeAsync(unsigned int iLane, std::vector<uint32_t> iOffsets, uint32_t iBeginOffsetInBuffer, TaskHolder iTask) {
+  auto& group = *iTask.group();
+  auto batch = laneInfos_[iLane].batch_;
+  TaskHolder deserializeTask(group, make_functor_task([this, offsets=std::move(iOffsets), iBeginOffsetInBuffer,
+                                                       task = std::move(iTask), iLane]() {
+      auto& laneInfo = this->laneInfos_[iLane];
+      auto const* eventBegin = laneInfo.batch_->uncompressed_.data()+iBeginOffsetInBuffer;
+
+      auto start = std::chrono::high_resolution_clock::now();
+      pds::deserializeDataProducts(eventBegin, eventBegin+offsets.back(),
+                                   offsets.begin(), offsets.end(),
+                                   laneInfo.dataProducts_, laneInfo.deserializers_, productMap_);
+      laneInfo.deserializeTime_ += 
+        std::chrono::duration_cast<decltype(laneInfo.deserializeTime_)>(std::chrono::high_resolution_clock::now() - start);
+      laneInfo.batch_.reset();
+    }));
+  if(batch->whenUncompressed(std::move(deserializeTask))) {
+    ++nWaitedForDecompression_;
+  }
+}
+
+std::shared_ptr<SharedRootBatchEventsSource::Batch> SharedRootBatchEventsSource::readBatch(tbb::task_group& iGroup) {
+  if(nextEntry_ >= eventsTree_->GetEntries()) {
+    return {};
+  }
+  eventsTree_->GetEntry(nextEntry_++);
+
+  auto batch = std::make_shared<Batch>();
+  //swapping keeps the memory of the batch objects separate from the ones ROOT reads into
+  const auto entriesInOffset = nFileProducts_+1;
+  if(compactIndex_) {
+    decodeBatchIndex(compactIndexBytes_.data(), compactIndexBytes_.size(), entriesInOffset, batch->eventIDs_, batch->offsets_);
+  } else {
+    batch->eventIDs_.swap(eventIDs_);
+    batch->offsets_.swap(offsetsAndBuffer_.first);
+  }
+  batch->compressed_.swap(offsetsAndBuffer_.second);
+
+  batch->eventStarts_.reserve(batch->eventIDs_.size()+1);
+  uint32_t summedSizes = 0;
+  batch->eventStarts_.push_back(summedSizes);
+  for(size_t index = 0; index < batch->eventIDs_.size(); ++index) {
+    //the last entry in the offsets is the uncompressed size for that event
+    summedSizes += batch->offsets_[(index+1)*entriesInOffset-1];
+    batch->eventStarts_.push_back(summedSizes);
+  }
+
+  iGroup.run([this, batch]() {
+      uncompressBatch(*batch);
+      batch->doneUncompressing();
+    });
+  return batch;
+}
+
+void SharedRootBatchEventsSource::uncompressBatch(Batch& iBatch) {
+  auto start = std::chrono::high_resolution_clock::now();
+  auto const& buffer = iBatch.compressed_;
+  auto const uncompressedSize = iBatch.eventStarts_.back();
+
+  pds::ReusableBuffer<char> productMajorBuffer;
+  //the decompressed product major batch is put back in event order afterwards
+  auto& oBuffer = productMajor_ ? productMajorBuffer : iBatch.uncompressed_;
+
+  std::vector<pds::CompressedFrame> frames;
+  if(pds::isZSTD(compression_)) {
+    pds::zstdFrames(buffer, frames);
+  }
+  if(batchDecompressor_ and batchDecompressor_->usesGPU() and compression_ != pds::Compression::kNone) {
+    oBuffer.resize(uncompressedSize);
+    std::vector<BatchDecompressor::Request> requests;
+    if(frames.empty()) {
+      requests.push_back({buffer.data(), buffer.size(), oBuffer.data(), uncompressedSize});
+    } else {
+      ++nParallelDecompressions_;
+      requests.reserve(frames.size());
+      for(auto const& frame: frames) {
+        requests.push_back({buffer.data()+frame.compressedBegin_, frame.compressedSize_,
+                            oBuffer.data()+frame.uncompressedBegin_, frame.uncompressedSize_});
+      }
+    }
+    batchDecompressor_->decompress(requests);
+  } else if(frames.empty()) {
+    pds::uncompressBuffer(compression_, buffer, uncompressedSize, oBuffer, decompressionContexts_.local());
+  } else {
+    ++nParallelDecompressions_;
+    oBuffer.resize(uncompressedSize);
+    TaskHolder::WaitScope waitScope;
+    tbb::parallel_for(std::size_t(0), frames.size(), [this, &buffer, &frames, &oBuffer](std::size_t iFrame) {
+        auto const& frame = frames[iFrame];
+        pds::uncompressFrame(buffer, frame, oBuffer.data()+frame.uncompressedBegin_, decompressionContexts_.local());
+      });
+  }
+  if(productMajor_) {
+    toEventMajor(productMajorBuffer, iBatch.offsets_, iBatch.eventIDs_.size(), nFileProducts_+1, iBatch.uncompressed_);
+  }
+  std::vector<char>().swap(iBatch.compressed_); //free memory
+  decompressTime_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool SharedRootBatchEventsSource::Batch::whenUncompressed(TaskHolder iTask) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  if(uncompressedDone_) {
+    return false;
+  }
+  waiting_.push_back(std::move(iTask));
+  return true;
+}
+
+void SharedRootBatchEventsSource::Batch::doneUncompressing() {
+  std::vector<TaskHolder> waiting;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    uncompressedDone_ = true;
+    waiting.swap(waiting_);
+  }
+  //destroying the holders starts the waiting tasks
+}
+
 void SharedRootBatchEventsSource::printSummary() const {
   std::cout <<"\nSource:\n"
     "   read time: "<<readTime().count()<<"us\n"
     "   decompress time: "<<decompressTime().count()<<"us\n"
-    "   deserialize time: "<<deserializeTime().count()<<"us\n"<<std::endl;
+    "   deserialize time: "<<deserializeTime().count()<<"us\n"
+    "   batches decompressed in parallel: "<<nParallelDecompressions_<<"\n"
+    "   events waiting for their batch to be decompressed: "<<nWaitedForDecompression_<<"\n";
+  if(batchDecompressor_ and batchDecompressor_->usesGPU()) {
+    std::cout <<"   GPU decompression launches: "<<batchDecompressor_->nLaunches()<<"\n"
+      "   buffers decompressed on the GPU: "<<batchDecompressor_->nBuffers()<<"\n";
+  }
+  summarize_queue("read", queue_);
+  std::cout<<std::endl;
 };
 
 std::chrono::microseconds SharedRootBatchEventsSource::readTime() const {
@@ -247,11 +433,7 @@ std::chrono::microseconds SharedRootBatchEventsSource::readTime() const {
 }
 
 std::chrono::microseconds SharedRootBatchEventsSource::decompressTime() const {
-  auto time = std::chrono::microseconds::zero();
-  for(auto const& l : laneInfos_) {
-    time += l.decompressTime_;
-  }
-  return time;
+  return std::chrono::microseconds(decompressTime_.load());
 }
 
 std::chrono::microseconds SharedRootBatchEventsSource::deserializeTime() const {
@@ -273,7 +455,8 @@ namespace {
           std::cout <<"no file name given\n";
           return {};
         }
-        return std::make_unique<SharedRootBatchEventsSource>(iNLanes, iNEvents, *fileName);
+        ProductSelector selector{params.get<std::string>("products", "")};
+        return std::make_unique<SharedRootBatchEventsSource>(iNLanes, iNEvents, *fileName, selector, params.get<bool>("gpuDecompression", false));
     }
     };
 
@@ -6,6 +6,9 @@
 #include <chrono>
 #include <iostream>
 #include <utility>
+#include <vector>
+#include <mutex>
+#include <atomic>
 
 #include "TFile.h"
 #include "TTree.h"
@@ -17,6 +20,10 @@
 #include "SerialTaskQueue.h"
 #include "DeserializeStrategy.h"
 #include "pds_reading.h"
+#include "TaskHolder.h"
+#include "tbb/enumerable_thread_specific.h"
+#include "PerLaneCounter.h"
+#include "BatchDecompressor.h"
 
 
 namespace cce::tf {
@@ -26,7 +33,8 @@ namespace cce::tf {
   
   class SharedRootBatchEventsSource : public SharedSourceBase {
   public:
-    SharedRootBatchEventsSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iFileName);
+    SharedRootBatchEventsSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iFileName,
+                                ProductSelector const& iSelector = ProductSelector(), bool iGPUDecompression = false);
     SharedRootBatchEventsSource(SharedRootBatchEventsSource&&) = delete;
     SharedRootBatchEventsSource(SharedRootBatchEventsSource const&) = delete;
     ~SharedRootBatchEventsSource() = default;
@@ -39,19 +47,57 @@ namespace cce::tf {
   private:
   
   void readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder) final;
+  //a Lane's events are handed out together so they come from the same batch when possible
+  void readEventsAsync(unsigned int iFirstLane, long iFirstEventIndex, unsigned int iNEvents, OptionalTaskHolder) final;
+
+  //The events of one entry of the Events TTree. The batch is shared by the lanes processing its
+  // events and is freed once the last of them has been deserialized.
+  struct Batch {
+    std::vector<EventIdentifier> eventIDs_;
+    std::vector<uint32_t> offsets_;
+    std::vector<char> compressed_;
+    pds::ReusableBuffer<char> uncompressed_;
+    //where each event begins in uncompressed_, the last entry is the total size
+    std::vector<uint32_t> eventStarts_;
+
+    //iTask is released once the batch has been uncompressed. Returns true if it had to wait.
+    bool whenUncompressed(TaskHolder iTask);
+    void doneUncompressing();
+  private:
+    std::mutex mutex_;
+    bool uncompressedDone_ = false;
+    std::vector<TaskHolder> waiting_;
+  };
+
+  //must be called from queue_. Gives the lane the next event of the present batch, false if there are none left
+  bool nextEvent(unsigned int iLane, tbb::task_group& iGroup, std::vector<uint32_t>& oOffsets, uint32_t& oBeginOffsetInBuffer);
+  //iTask is released once the lane's event was deserialized
+  void deserializeAsync(unsigned int iLane, std::vector<uint32_t> iOffsets, uint32_t iBeginOffsetInBuffer, TaskHolder iTask);
+  //must be called from queue_, starts the decompression of the batch in iGroup
+  std::shared_ptr<Batch> readBatch(tbb::task_group& iGroup);
+  //a batch compressed as several ZSTD frames has its frames decompressed in parallel, or on the GPU
+  // together with the frames of the batches other threads are decompressing
+  void uncompressBatch(Batch&);
 
   std::chrono::microseconds readTime() const;
   std::chrono::microseconds decompressTime() const;
   std::chrono::microseconds deserializeTime() const;
 
   pds::Compression compression_;
+  //set if the batch blob holds the data products of all events one data product after another
+  bool productMajor_ = false;
+  //set if the event identifiers and offsets of a batch were stored with encodeBatchIndex
+  bool compactIndex_ = false;
+  pds::ProductMap productMap_;
+  //the offsets stored for each event include the data products which are not read
+  size_t nFileProducts_;
   std::unique_ptr<TFile> file_;
   TTree* eventsTree_;
   TBranch* eventsBranch_;
   TBranch* idBranch_;
   SerialTaskQueue queue_;
 
-  struct LaneInfo {
+  struct alignas(kCacheLineSize) LaneInfo {
     LaneInfo(std::vector<pds::ProductInfo> const&, DeserializeStrategy);
 
     LaneInfo(LaneInfo&&) = default;
@@ -63,20 +109,34 @@ namespace cce::tf {
     EventIdentifier eventID_;
     std::vector<DataProductRetriever> dataProducts_;
     std::vector<void*> dataBuffers_;
-    DeserializeStrategy deserializers_; //NOTE: could be shared between lanes?
+    DeserializeStrategy deserializers_; //unrolled action sequences are shared between lanes
     SharedRootBatchEventsDelayedRetriever delayedRetriever_;
-    std::chrono::microseconds decompressTime_;
+    //the batch holding the event being processed by the lane
+    std::shared_ptr<Batch> batch_;
     std::chrono::microseconds deserializeTime_;
     ~LaneInfo();
   };
 
   unsigned long long int nextEntry_ = 0;
   unsigned int cachedEventIndex_ = 0;
+  //the batch whose events are being handed to lanes and the one read ahead of it
+  std::shared_ptr<Batch> currentBatch_;
+  std::shared_ptr<Batch> nextBatch_;
   std::vector<EventIdentifier> eventIDs_;
   std::vector<EventIdentifier>* pEventIDs_;
   std::pair<std::vector<uint32_t>, std::vector<char>> offsetsAndBuffer_;
   std::pair<std::vector<uint32_t>, std::vector<char>>* pOffsetsAndBuffer_;
-  std::vector<char> uncompressedBuffer_;
+  //read instead of eventIDs_ and the offsets when the file was written with compactIndex
+  std::vector<char> compactIndexBytes_;
+  std::vector<char>* pCompactIndex_;
+  //batches are decompressed concurrently
+  tbb::enumerable_thread_specific<pds::DecompressionContext> decompressionContexts_;
+  std::atomic<unsigned long long> nParallelDecompressions_ = 0;
+  //only set when asked for GPU decompression
+  std::unique_ptr<BatchDecompressor> batchDecompressor_;
+  //events whose batch was not yet decompressed when handed to a lane
+  unsigned long long nWaitedForDecompression_ = 0;
+  std::atomic<std::chrono::microseconds::rep> decompressTime_ = 0;
 
   std::vector<LaneInfo> laneInfos_;
   std::chrono::microseconds readTime_;
@@ -1,15 +1,30 @@
 #include "SharedRootEventSource.h"
 #include "SourceFactory.h"
+#include "summarize_queue.h"
 #include "Deserializer.h"
 #include "UnrolledDeserializer.h"
+#include "FixedLayoutDeserializer.h"
+#include "EventList.h"
+
+#include <fstream>
+#include <numeric>
+#include <algorithm>
 
 #include "TClass.h"
+#include "TROOT.h"
+#include "RootIMT.h"
 
 using namespace cce::tf;
 
-SharedRootEventSource::SharedRootEventSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iName) :
+SharedRootEventSource::SharedRootEventSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iName,
+                                             RootCacheOptions const& iCacheOptions,
+                                             ProductSelector const& iSelector,
+                                             std::optional<std::vector<EventIdentifier>> const& iEvents,
+                                             bool iPassThrough,
+                                             EventSelection const& iSelection) :
                  SharedSourceBase(iNEvents),
-                 file_{TFile::Open(iName.c_str())},
+                 passThrough_{iPassThrough},
+                 file_{openFileForCache(iName, iCacheOptions)},
   readTime_{std::chrono::microseconds::zero()}
 {
 
@@ -25,6 +40,7 @@ SharedRootEventSource::SharedRootEventSource(unsigned int iNLanes, unsigned long
     std::cout <<"no Events TTree in file "<<iName<<std::endl;
     throw std::runtime_error("no Events TTree");
   }
+  eventsTree_->SetImplicitMT(rootIMTForSources());
   eventsBranch_ = eventsTree_->GetBranch("offsetsAndBlob");
   if( not eventsBranch_) {
     std::cout <<"no 'offsetsAndBlob' TBranch in 'Events' TTree in file "<<iName<<std::endl;
@@ -36,6 +52,31 @@ SharedRootEventSource::SharedRootEventSource(unsigned int iNLanes, unsigned long
     std::cout <<"no 'EventID' TBranch in 'Events' TTree in file "<<iName<<std::endl;
     throw std::runtime_error("no 'EventID' TBranch");
   }
+  //Every entry of both branches is read in order so the cache reads ahead the baskets of
+  // many events at once. The serialized part of reading an event then mostly only
+  // streams the objects out of baskets already in memory.
+  configureCache(*eventsTree_, {eventsBranch_, idBranch_}, iCacheOptions);
+
+  if(iEvents or not iSelection.selectsAll()) {
+    //the EventID branch is small so reading all of it is cheap compared to reading the blobs of unwanted events
+    std::vector<EventIdentifier> ids(eventsTree_->GetEntries());
+    EventIdentifier id;
+    idBranch_->SetAddress(&id);
+    for(long entry = 0; entry < static_cast<long>(ids.size()); ++entry) {
+      idBranch_->GetEntry(entry);
+      ids[entry] = id;
+    }
+    std::vector<long> entries;
+    if(iEvents) {
+      entries = selectEvents(ids, *iEvents);
+    } else {
+      entries.resize(ids.size());
+      std::iota(entries.begin(), entries.end(), 0L);
+    }
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [&](long iEntry) { return not iSelection(ids[iEntry]); }),
+                  entries.end());
+    selectedEntries_ = std::move(entries);
+  }
    
   auto meta = file_->Get<TTree>("Meta");
   if(not meta) {
@@ -75,15 +116,14 @@ SharedRootEventSource::SharedRootEventSource(unsigned int iNLanes, unsigned long
   }
 
   assert(objectSerializationUsed == static_cast<int>(pds::Serialization::kRoot) or 
-         objectSerializationUsed == static_cast<int>(pds::Serialization::kRootUnrolled));
+         objectSerializationUsed == static_cast<int>(pds::Serialization::kRootUnrolled) or
+         objectSerializationUsed == static_cast<int>(pds::Serialization::kFixedLayout) or
+         objectSerializationUsed == static_cast<int>(pds::Serialization::kNativeUnrolled));
   pds::Serialization serialization{objectSerializationUsed};
+  serialization_ = serialization;
 
-  if (compression == "None") {
-    compression_ = pds::Compression::kNone;
-  }else if (compression == "LZ4") {
-    compression_ = pds::Compression::kLZ4;
-  }else if (compression == "ZSTD") {
-    compression_ = pds::Compression::kZSTD;
+  if(auto c = pds::toCompression(compression)) {
+    compression_ = *c;
   } else {
     std::cout <<"Unknown compression algorithm '"<<compression<<"'"<<std::endl;
     throw std::runtime_error("unknown compression algorithm");
@@ -97,6 +137,7 @@ SharedRootEventSource::SharedRootEventSource(unsigned int iNLanes, unsigned long
       productInfo.emplace_back(name, index++, type);
     }
   }
+  productMap_ = pds::selectProducts(productInfo, iSelector);
 
   laneInfos_.reserve(iNLanes);
   for(unsigned int i = 0; i< iNLanes; ++i) {
@@ -108,6 +149,12 @@ SharedRootEventSource::SharedRootEventSource(unsigned int iNLanes, unsigned long
     case pds::Serialization::kRootUnrolled: {
       strategy = DeserializeStrategy::make<DeserializeProxy<UnrolledDeserializer>>(); break;
     }
+    case pds::Serialization::kNativeUnrolled: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<NativeUnrolledDeserializer>>(); break;
+    }
+    case pds::Serialization::kFixedLayout: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<FixedLayoutDeserializer>>(); break;
+    }
     }
     laneInfos_.emplace_back(productInfo, std::move(strategy));
   }
@@ -160,15 +207,22 @@ EventIdentifier SharedRootEventSource::eventIdentifier(unsigned int iLane, long
 }
 
 void SharedRootEventSource::readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder iTask) {
-  queue_.push(*iTask.group(), [iLane, optTask = std::move(iTask), this, iEventIndex]() mutable {
+  long entry = iEventIndex;
+  if(selectedEntries_) {
+    if(iEventIndex >= static_cast<long>(selectedEntries_->size())) {
+      return;
+    }
+    entry = (*selectedEntries_)[iEventIndex];
+  }
+  queue_.push(*iTask.group(), [iLane, optTask = std::move(iTask), this, entry]() mutable {
       auto start = std::chrono::high_resolution_clock::now();
-      if(iEventIndex < eventsTree_->GetEntries()) {
+      if(entry < eventsTree_->GetEntries()) {
         std::pair<std::vector<uint32_t>, std::vector<char>> offsetsAndBuffer;
         auto pBuffer = &offsetsAndBuffer;
         eventsBranch_->SetAddress(&pBuffer);
 
         idBranch_->SetAddress(&this->laneInfos_[iLane].eventID_);
-        eventsTree_->GetEntry(iEventIndex);
+        eventsTree_->GetEntry(entry);
         {
           //auto const& id = this->laneInfos_[iLane].eventID_;
           //std::cout <<"event entry "<<iEventIndex<<std::endl;
@@ -185,16 +239,24 @@ void SharedRootEventSource::readEventAsync(unsigned int iLane, long iEventIndex,
             auto& laneInfo = this->laneInfos_[iLane];
 
             auto start = std::chrono::high_resolution_clock::now();
-            std::vector<char> uBuffer = pds::uncompressBuffer(this->compression_, offsetsAndBuffer.second, offsetsAndBuffer.first.back());
-            std::cout <<"uncompressed buffer size "<<uBuffer.size() <<std::endl;
+            auto& uBuffer = laneInfo.uncompressedBuffer_;
+            pds::uncompressBuffer(this->compression_, offsetsAndBuffer.second, offsetsAndBuffer.first.back(), uBuffer, laneInfo.decompressionContext_);
+            //std::cout <<"uncompressed buffer size "<<uBuffer.size() <<std::endl;
             laneInfo.decompressTime_ += 
               std::chrono::duration_cast<decltype(laneInfo.decompressTime_)>(std::chrono::high_resolution_clock::now() - start);
             
+            if(passThrough_) {
+              //the Lane's uncompressed buffer is kept until its next event
+              pds::passThroughDataProducts(uBuffer.data(), uBuffer.data()+uBuffer.size(),
+                                           offsetsAndBuffer.first.begin(), offsetsAndBuffer.first.end(),
+                                           laneInfo.dataProducts_, serialization_, productMap_);
+              return;
+            }
             start = std::chrono::high_resolution_clock::now();
             //uBuffer.pop_back();
             pds::deserializeDataProducts(uBuffer.data(), uBuffer.data()+uBuffer.size(), 
                                          offsetsAndBuffer.first.begin(), offsetsAndBuffer.first.end(),
-                                         laneInfo.dataProducts_, laneInfo.deserializers_);
+                                         laneInfo.dataProducts_, laneInfo.deserializers_, productMap_);
             laneInfo.deserializeTime_ += 
               std::chrono::duration_cast<decltype(laneInfo.deserializeTime_)>(std::chrono::high_resolution_clock::now() - start);
           });
@@ -207,7 +269,13 @@ void SharedRootEventSource::printSummary() const {
   std::cout <<"\nSource:\n"
     "   read time: "<<readTime().count()<<"us\n"
     "   decompress time: "<<decompressTime().count()<<"us\n"
-    "   deserialize time: "<<deserializeTime().count()<<"us\n"<<std::endl;
+    "   deserialize time: "<<deserializeTime().count()<<"us\n";
+  if(passThrough_) {
+    std::cout <<"   data products passed through serialized\n";
+  }
+  printCacheSummary(*file_, eventsTree_);
+  summarize_queue("read", queue_);
+  std::cout<<std::endl;
 };
 
 std::chrono::microseconds SharedRootEventSource::readTime() const {
@@ -241,7 +309,33 @@ namespace {
           std::cout <<"no file name given\n";
           return {};
         }
-        return std::make_unique<SharedRootEventSource>(iNLanes, iNEvents, *fileName);
+        RootCacheOptions cacheOptions;
+        cacheOptions.cacheSize_ = params.get<std::size_t>("cacheSize", 0);
+        cacheOptions.prefetch_ = params.get<bool>("prefetch", false);
+        cacheOptions.parallelUnzip_ = params.get<bool>("parallelUnzip", false);
+        if(cacheOptions.parallelUnzip_ and not rootIMTForSources()) {
+          std::cout <<"parallelUnzip requires --use-IMT with --IMT-scope all or sources"<<std::endl;
+          return {};
+        }
+        ProductSelector selector{params.get<std::string>("products", "")};
+        std::optional<std::vector<EventIdentifier>> events;
+        if(auto eventsFile = params.get<std::string>("events")) {
+          std::ifstream list(*eventsFile);
+          if(not list) {
+            std::cout <<"unable to open event list "<<*eventsFile<<std::endl;
+            return {};
+          }
+          events = readEventList(list);
+        }
+        bool passThrough = params.get<bool>("passThrough", false);
+        std::optional<EventSelection> selection;
+        try {
+          selection.emplace(params.get<std::string>("select", ""));
+        } catch(std::runtime_error const& iError) {
+          std::cout <<iError.what()<<std::endl;
+          return {};
+        }
+        return std::make_unique<SharedRootEventSource>(iNLanes, iNEvents, *fileName, cacheOptions, selector, events, passThrough, *selection);
     }
     };
 
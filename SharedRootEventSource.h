@@ -5,7 +5,9 @@
 #include <memory>
 #include <chrono>
 #include <iostream>
+#include <optional>
 #include <utility>
+#include <vector>
 
 #include "TFile.h"
 #include "TTree.h"
@@ -17,6 +19,9 @@
 #include "SerialTaskQueue.h"
 #include "DeserializeStrategy.h"
 #include "pds_reading.h"
+#include "RootCacheOptions.h"
+#include "PerLaneCounter.h"
+#include "EventList.h"
 
 
 namespace cce::tf {
@@ -26,7 +31,12 @@ namespace cce::tf {
   
   class SharedRootEventSource : public SharedSourceBase {
   public:
-    SharedRootEventSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iFileName);
+    SharedRootEventSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iFileName,
+                          RootCacheOptions const& iCacheOptions = RootCacheOptions(),
+                          ProductSelector const& iSelector = ProductSelector(),
+                          std::optional<std::vector<EventIdentifier>> const& iEvents = {},
+                          bool iPassThrough = false,
+                          EventSelection const& iSelection = EventSelection());
     SharedRootEventSource(SharedRootEventSource&&) = delete;
     SharedRootEventSource(SharedRootEventSource const&) = delete;
     ~SharedRootEventSource() = default;
@@ -45,13 +55,17 @@ namespace cce::tf {
   std::chrono::microseconds deserializeTime() const;
 
   pds::Compression compression_;
+  pds::Serialization serialization_;
+  //the data products are given to the Outputers still serialized, see DataProductRetriever::setSerialized
+  bool passThrough_;
+  pds::ProductMap productMap_;
   std::unique_ptr<TFile> file_;
   TTree* eventsTree_;
   TBranch* eventsBranch_;
   TBranch* idBranch_;
   SerialTaskQueue queue_;
 
-  struct LaneInfo {
+  struct alignas(kCacheLineSize) LaneInfo {
     LaneInfo(std::vector<pds::ProductInfo> const&, DeserializeStrategy);
 
     LaneInfo(LaneInfo&&) = default;
@@ -63,8 +77,10 @@ namespace cce::tf {
     EventIdentifier eventID_;
     std::vector<DataProductRetriever> dataProducts_;
     std::vector<void*> dataBuffers_;
-    DeserializeStrategy deserializers_; //NOTE: could be shared between lanes?
+    DeserializeStrategy deserializers_; //unrolled action sequences are shared between lanes
     SharedRootEventDelayedRetriever delayedRetriever_;
+    pds::ReusableBuffer<char> uncompressedBuffer_;
+    pds::DecompressionContext decompressionContext_;
     std::chrono::microseconds decompressTime_;
     std::chrono::microseconds deserializeTime_;
     ~LaneInfo();
@@ -72,6 +88,8 @@ namespace cce::tf {
 
   std::vector<LaneInfo> laneInfos_;
   std::chrono::microseconds readTime_;
+  //when only some events are read, the TTree entry of each
+  std::optional<std::vector<long>> selectedEntries_;
   };
 }
 
@@ -4,9 +4,14 @@
 #include "DataProductRetriever.h"
 #include "EventIdentifier.h"
 #include "OptionalTaskHolder.h"
+#include "RunReport.h"
+#include "FunctorTask.h"
 
 #include <vector>
+#include <algorithm>
 #include <chrono>
+#include <memory>
+#include <atomic>
 
 namespace cce::tf {
 class SharedSourceBase {
@@ -24,13 +29,36 @@ class SharedSourceBase {
 
   //returns false if can immediately tell that can not continue processing
   void gotoEventAsync(unsigned int iLane, long iEventIndex, OptionalTaskHolder);
+  //Reads the iNEvents events starting at iFirstEventIndex into the lanes iFirstLane to
+  // iFirstLane+iNEvents-1. The OptionalTaskHolder is run once all were read and is dropped
+  // if any of them could not be read.
+  void gotoEventsAsync(unsigned int iFirstLane, long iFirstEventIndex, unsigned int iNEvents, OptionalTaskHolder);
+
+  //Called before any event is read when the job only uses some of the data products.
+  // iOrder holds the indices of those, in the order the Lanes retrieve them. Sources
+  // can then read and deserialize only those data products.
+  virtual void setNeededProducts(std::vector<unsigned int> const& iOrder) {}
+
+  //Returns one past the last event of the cluster holding iEventIndex. Sources whose events
+  // are stored in clusters (e.g. the baskets of a TTree) override this so a Lane can keep
+  // taking events from the cluster it is reading. The default treats each event as its own cluster.
+  virtual long clusterEnd(long iEventIndex) const { return iEventIndex+1; }
 
   virtual void printSummary() const = 0;
+  //adds the values printed by printSummary to the job's report
+  virtual void fillReport(RunReport&) const {}
+
+ protected:
+  //for clusterEnd, iClusterEnds holds one past the last event of each cluster in increasing order
+  static long clusterEndFrom(std::vector<long> const& iClusterEnds, long iEventIndex);
 
  private:
   //NOTE: fully reentrant sources can do their work during this call without needing to create a new Task. 
   // If can not process the event, do not convert the OptionalTaskHolder to a TaskHolder
   virtual void readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder) =0;
+  //Sources which read their events in batches can hand out all the events in one step.
+  // The default asks readEventAsync for each event.
+  virtual void readEventsAsync(unsigned int iFirstLane, long iFirstEventIndex, unsigned int iNEvents, OptionalTaskHolder);
 
   const unsigned long long maxNEvents_;
 };
@@ -39,8 +67,42 @@ class SharedSourceBase {
    return iEventIndex < maxNEvents_;
  }
 
+ inline long SharedSourceBase::clusterEndFrom(std::vector<long> const& iClusterEnds, long iEventIndex) {
+   auto it = std::upper_bound(iClusterEnds.begin(), iClusterEnds.end(), iEventIndex);
+   return it == iClusterEnds.end() ? iEventIndex+1 : *it;
+ }
+
  inline void SharedSourceBase::gotoEventAsync(unsigned int iLane, long iEventIndex, OptionalTaskHolder iTask) {
    return readEventAsync(iLane, iEventIndex, std::move(iTask));
  }
+
+ inline void SharedSourceBase::gotoEventsAsync(unsigned int iFirstLane, long iFirstEventIndex, unsigned int iNEvents, OptionalTaskHolder iTask) {
+   return readEventsAsync(iFirstLane, iFirstEventIndex, iNEvents, std::move(iTask));
+ }
+
+ inline void SharedSourceBase::readEventsAsync(unsigned int iFirstLane, long iFirstEventIndex, unsigned int iNEvents, OptionalTaskHolder iTask) {
+   //iTask is run when the last of the reads is released unless one of them was dropped
+   struct Reads {
+     explicit Reads(OptionalTaskHolder iTask): task_{std::move(iTask)} {}
+     ~Reads() { if(not failed_.load()) { task_.releaseToTaskHolder().doneWaiting(); } }
+     OptionalTaskHolder task_;
+     std::atomic<bool> failed_{false};
+   };
+   class Read {
+   public:
+     explicit Read(std::shared_ptr<Reads> iReads): reads_{std::move(iReads)} {}
+     Read(Read&&) = default;
+     ~Read() { if(reads_) { reads_->failed_ = true; } }
+     void succeeded() { reads_.reset(); }
+   private:
+     std::shared_ptr<Reads> reads_;
+   };
+   auto& group = *iTask.group();
+   auto reads = std::make_shared<Reads>(std::move(iTask));
+   for(unsigned int i = 0; i < iNEvents; ++i) {
+     readEventAsync(iFirstLane+i, iFirstEventIndex+i,
+                    OptionalTaskHolder(group, make_functor_task([read = Read(reads)]() mutable { read.succeeded(); })));
+   }
+ }
 }
 #endif
@@ -0,0 +1,289 @@
+#include "ShmEventRing.h"
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace cce::tf;
+
+namespace {
+  constexpr uint32_t kMagic = 0x53484d52; //"SHMR"
+  constexpr std::size_t kAlignment = 64;
+
+  //where the header starts, after the Control
+  constexpr std::size_t kHeaderOffset = 256;
+
+  constexpr std::size_t roundUp(std::size_t iBytes) {
+    return (iBytes + kAlignment - 1)/kAlignment*kAlignment;
+  }
+
+  std::size_t slotsOffset(uint32_t iHeaderWords) {
+    return roundUp(kHeaderOffset + iHeaderWords*4);
+  }
+
+  //shm_open names start with a '/'
+  std::string shmName(std::string const& iName) {
+    if(not iName.empty() and iName[0] == '/') {
+      return iName;
+    }
+    return "/"+iName;
+  }
+
+  //spins briefly before sleeping so a record published soon after is seen quickly.
+  // Returns false if iDone was still false after iTimeout.
+  template<typename F>
+  bool waitFor(F iDone, std::chrono::milliseconds iTimeout) {
+    for(int i = 0; i < 1000; ++i) {
+      if(iDone()) {
+        return true;
+      }
+      std::this_thread::yield();
+    }
+    auto const deadline = std::chrono::steady_clock::now() + iTimeout;
+    while(not iDone()) {
+      if(std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(20));
+    }
+    return true;
+  }
+}
+
+//the start of the shared memory, followed by the header and then the slots
+struct alignas(kAlignment) ShmEventRing::Control {
+  //set last by the feeder once the ring is ready
+  std::atomic<uint32_t> magic_{0};
+  uint32_t nSlots_ = 0;
+  uint64_t slotBytes_ = 0;
+  uint32_t nConsumers_ = 0;
+  uint32_t headerWords_ = 0;
+  std::atomic<uint32_t> nAttached_{0};
+  std::atomic<uint32_t> finished_{0};
+  alignas(kAlignment) std::atomic<uint64_t> published_{0};
+};
+
+//record n is in slot n % nSlots, its data follows the SlotControl
+struct alignas(kAlignment) ShmEventRing::SlotControl {
+  //one more than the number of the record in the slot, 0 if none yet
+  std::atomic<uint64_t> sequence_{0};
+  //consumers which have not released the record
+  std::atomic<uint32_t> readers_{0};
+  uint32_t nWords_ = 0;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free and std::atomic<uint64_t>::is_always_lock_free,
+              "atomics shared between processes must be lock free");
+
+ShmEventRing::ShmEventRing(std::string iName, void* iAddress, std::size_t iSize, bool iOwner, std::chrono::milliseconds iTimeout):
+  name_{std::move(iName)}, address_{iAddress}, size_{iSize}, owner_{iOwner}, timeout_{iTimeout} {}
+
+ShmEventRing::ShmEventRing(ShmEventRing&& iOther):
+  name_{std::move(iOther.name_)}, address_{iOther.address_}, size_{iOther.size_}, owner_{iOther.owner_}, timeout_{iOther.timeout_},
+  consumerIndex_{iOther.consumerIndex_}, nextRecord_{iOther.nextRecord_.load()}, nRecordWaits_{iOther.nRecordWaits_.load()},
+  nSlotWaits_{iOther.nSlotWaits_}
+{
+  iOther.address_ = nullptr;
+  iOther.owner_ = false;
+}
+
+ShmEventRing::~ShmEventRing() {
+  if(address_) {
+    ::munmap(address_, size_);
+  }
+  if(owner_) {
+    //consumers which already mapped the ring keep it until they unmap it
+    ::shm_unlink(name_.c_str());
+  }
+}
+
+ShmEventRing ShmEventRing::create(std::string const& iName, std::vector<uint32_t> const& iHeader, uint32_t iNSlots,
+                                  std::size_t iSlotBytes, uint32_t iNConsumers, std::chrono::milliseconds iTimeout) {
+  if(iNSlots == 0 or iSlotBytes == 0 or iNConsumers == 0) {
+    throw std::runtime_error("ShmEventRing needs at least one slot, slot byte and consumer");
+  }
+  static_assert(sizeof(Control) <= kHeaderOffset);
+  auto name = shmName(iName);
+  //a ring left by a feeder which did not end cleanly
+  ::shm_unlink(name.c_str());
+  int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if(fd < 0) {
+    throw std::runtime_error("ShmEventRing unable to create shared memory "+name+": "+std::strerror(errno));
+  }
+  std::size_t const slotBytes = roundUp(iSlotBytes);
+  std::size_t const size = slotsOffset(iHeader.size()) + iNSlots*(sizeof(SlotControl)+slotBytes);
+  if(0 != ::ftruncate(fd, size)) {
+    auto error = errno;
+    ::close(fd);
+    ::shm_unlink(name.c_str());
+    throw std::runtime_error("ShmEventRing unable to size shared memory "+name+" to "+std::to_string(size)+" bytes: "+std::strerror(error));
+  }
+  auto address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if(address == MAP_FAILED) {
+    ::shm_unlink(name.c_str());
+    throw std::runtime_error("ShmEventRing unable to map shared memory "+name);
+  }
+  ShmEventRing ring(name, address, size, true, iTimeout);
+  auto control = new (address) Control();
+  control->nSlots_ = iNSlots;
+  control->slotBytes_ = slotBytes;
+  control->nConsumers_ = iNConsumers;
+  control->headerWords_ = iHeader.size();
+  std::memcpy(static_cast<char*>(address)+kHeaderOffset, iHeader.data(), iHeader.size()*4);
+  for(uint32_t i = 0; i < iNSlots; ++i) {
+    new (&ring.slot(i)) SlotControl();
+  }
+  control->magic_.store(kMagic, std::memory_order_release);
+  return ring;
+}
+
+ShmEventRing ShmEventRing::attach(std::string const& iName, std::chrono::milliseconds iTimeout) {
+  auto name = shmName(iName);
+  void* address = nullptr;
+  std::size_t size = 0;
+  bool const ready = waitFor([&]() {
+      int fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+      if(fd < 0) {
+        return false;
+      }
+      struct stat fileStat;
+      if(0 != ::fstat(fd, &fileStat) or static_cast<std::size_t>(fileStat.st_size) < sizeof(Control)) {
+        //the feeder has not yet sized the memory
+        ::close(fd);
+        return false;
+      }
+      size = fileStat.st_size;
+      address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if(address == MAP_FAILED) {
+        address = nullptr;
+        return false;
+      }
+      if(static_cast<Control*>(address)->magic_.load(std::memory_order_acquire) != kMagic) {
+        ::munmap(address, size);
+        address = nullptr;
+        return false;
+      }
+      return true;
+    }, iTimeout);
+  if(not ready) {
+    throw std::runtime_error("ShmEventRing "+name+" was not made within "+std::to_string(iTimeout.count())+"ms");
+  }
+  ShmEventRing ring(name, address, size, false, iTimeout);
+  auto& control = ring.control();
+  ring.consumerIndex_ = control.nAttached_.fetch_add(1);
+  if(ring.consumerIndex_ >= control.nConsumers_) {
+    throw std::runtime_error("ShmEventRing "+name+" already has all of its "+std::to_string(control.nConsumers_)+" consumers");
+  }
+  return ring;
+}
+
+ShmEventRing::Control& ShmEventRing::control() const {
+  return *static_cast<Control*>(address_);
+}
+
+ShmEventRing::SlotControl& ShmEventRing::slot(unsigned long long iRecord) const {
+  auto const& c = control();
+  auto const index = iRecord % c.nSlots_;
+  auto begin = static_cast<char*>(address_) + slotsOffset(c.headerWords_);
+  return *reinterpret_cast<SlotControl*>(begin + index*(sizeof(SlotControl)+c.slotBytes_));
+}
+
+uint32_t* ShmEventRing::slotData(unsigned long long iRecord) const {
+  return reinterpret_cast<uint32_t*>(reinterpret_cast<char*>(&slot(iRecord)) + sizeof(SlotControl));
+}
+
+std::vector<uint32_t> ShmEventRing::header() const {
+  auto begin = reinterpret_cast<uint32_t const*>(static_cast<char const*>(address_)+kHeaderOffset);
+  return std::vector<uint32_t>(begin, begin+control().headerWords_);
+}
+
+uint32_t ShmEventRing::nConsumers() const {
+  return control().nConsumers_;
+}
+
+std::size_t ShmEventRing::slotBytes() const {
+  return control().slotBytes_;
+}
+
+void ShmEventRing::publish(uint32_t const* iBegin, uint32_t const* iEnd) {
+  auto& c = control();
+  std::size_t const nWords = iEnd - iBegin;
+  if(nWords*4 > c.slotBytes_) {
+    throw std::runtime_error("ShmEventRing record of "+std::to_string(nWords*4)+" bytes does not fit in a slot of "+
+                             std::to_string(c.slotBytes_)+" bytes");
+  }
+  //only the feeder changes published_
+  auto const n = c.published_.load(std::memory_order_relaxed);
+  auto& s = slot(n);
+  auto released = [&s]() { return s.readers_.load(std::memory_order_acquire) == 0; };
+  if(not released()) {
+    ++nSlotWaits_;
+    if(not waitFor(released, timeout_)) {
+      throw std::runtime_error("ShmEventRing "+name_+" consumers did not release a slot within "+std::to_string(timeout_.count())+"ms");
+    }
+  }
+  std::memcpy(slotData(n), iBegin, nWords*4);
+  s.nWords_ = nWords;
+  s.readers_.store(c.nConsumers_, std::memory_order_relaxed);
+  s.sequence_.store(n+1, std::memory_order_release);
+  c.published_.store(n+1, std::memory_order_release);
+}
+
+void ShmEventRing::finish() {
+  control().finished_.store(1, std::memory_order_release);
+}
+
+bool ShmEventRing::waitUntilReleased() {
+  auto const& c = control();
+  for(uint32_t i = 0; i < c.nSlots_; ++i) {
+    auto& s = slot(i);
+    if(not waitFor([&s]() { return s.readers_.load(std::memory_order_acquire) == 0; }, timeout_)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+unsigned long long ShmEventRing::nPublished() const {
+  return control().published_.load(std::memory_order_acquire);
+}
+
+std::optional<unsigned long long> ShmEventRing::claim() {
+  auto const n = nextRecord_++;
+  auto const& c = control();
+  auto& s = slot(n);
+  //the slot can not be reused for a later record before this consumer releases record n
+  auto published = [&]() { return s.sequence_.load(std::memory_order_acquire) == n+1; };
+  auto ended = [&]() {
+    return c.finished_.load(std::memory_order_acquire) != 0 and c.published_.load(std::memory_order_acquire) <= n;
+  };
+  if(published()) {
+    return n;
+  }
+  ++nRecordWaits_;
+  if(not waitFor([&]() { return published() or ended(); }, timeout_)) {
+    throw std::runtime_error("ShmEventRing "+name_+" feeder did not publish a record within "+std::to_string(timeout_.count())+"ms");
+  }
+  if(published()) {
+    return n;
+  }
+  return {};
+}
+
+ShmEventRing::Record ShmEventRing::record(unsigned long long iRecord) const {
+  auto data = slotData(iRecord);
+  return {data, data+slot(iRecord).nWords_};
+}
+
+void ShmEventRing::release(unsigned long long iRecord) {
+  slot(iRecord).readers_.fetch_sub(1, std::memory_order_release);
+}
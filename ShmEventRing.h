@@ -0,0 +1,96 @@
+#if !defined(ShmEventRing_h)
+#define ShmEventRing_h
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cce::tf {
+  /**
+     A ring of fixed size slots in POSIX shared memory through which one feeder
+     process hands records, made of 32 bit words, to consumer processes. Every
+     consumer sees every record. A slot is only reused once all consumers
+     released the record it holds, so the feeder waits for the slowest consumer.
+     Consumers read a record in place in the shared memory.
+
+     The ring also holds a header, given when it is made, which the consumers
+     read before the first record, e.g. the header of a PDS file.
+
+     Within a consumer process the records are claimed in order, possibly by
+     several threads, and may be released in any order.
+   */
+  class ShmEventRing {
+  public:
+    struct Record {
+      uint32_t const* begin_;
+      uint32_t const* end_;
+    };
+
+    //Made by the feeder, replacing a ring left with the same name. The name is
+    // removed when the feeder's ring is destroyed. Throws if the memory can not be had.
+    static ShmEventRing create(std::string const& iName, std::vector<uint32_t> const& iHeader, uint32_t iNSlots,
+                               std::size_t iSlotBytes, uint32_t iNConsumers, std::chrono::milliseconds iTimeout);
+    //Attaches as the next consumer, waiting up to iTimeout for the feeder to make the ring.
+    // Throws if it was not made in time or all its consumers are already attached.
+    static ShmEventRing attach(std::string const& iName, std::chrono::milliseconds iTimeout);
+
+    ShmEventRing(ShmEventRing&&);
+    ShmEventRing(ShmEventRing const&) = delete;
+    ShmEventRing& operator=(ShmEventRing&&) = delete;
+    ShmEventRing& operator=(ShmEventRing const&) = delete;
+    ~ShmEventRing();
+
+    std::vector<uint32_t> header() const;
+    uint32_t nConsumers() const;
+    std::size_t slotBytes() const;
+
+    //feeder: copies the record into the next slot once all consumers released the
+    // slot. Throws if the record does not fit in a slot or the wait exceeded the timeout.
+    // Must not be called concurrently.
+    void publish(uint32_t const* iBegin, uint32_t const* iEnd);
+    //feeder: no more records will be published
+    void finish();
+    //feeder: waits for the consumers to release all records, false if the timeout was exceeded
+    bool waitUntilReleased();
+    unsigned long long nPublished() const;
+    //number of times publish had to wait for a slot
+    unsigned long long nSlotWaits() const { return nSlotWaits_; }
+
+    //consumer: the number of the next record, waiting for the feeder to publish it.
+    // Empty once the feeder finished without publishing it. Throws if the wait exceeded the timeout.
+    std::optional<unsigned long long> claim();
+    Record record(unsigned long long iRecord) const;
+    //consumer: the record's slot may be reused once all consumers released it
+    void release(unsigned long long iRecord);
+    //the index of this consumer among the consumers of the ring
+    uint32_t consumerIndex() const { return consumerIndex_; }
+    //number of times claim had to wait for the feeder
+    unsigned long long nRecordWaits() const { return nRecordWaits_.load(); }
+
+  private:
+    struct Control;
+    struct SlotControl;
+
+    ShmEventRing(std::string iName, void* iAddress, std::size_t iSize, bool iOwner, std::chrono::milliseconds iTimeout);
+    Control& control() const;
+    SlotControl& slot(unsigned long long iRecord) const;
+    uint32_t* slotData(unsigned long long iRecord) const;
+
+    std::string name_;
+    void* address_;
+    std::size_t size_;
+    bool owner_;
+    std::chrono::milliseconds timeout_;
+    uint32_t consumerIndex_ = 0;
+    //the next record claimed by this consumer process
+    std::atomic<unsigned long long> nextRecord_{0};
+    std::atomic<unsigned long long> nRecordWaits_{0};
+    unsigned long long nSlotWaits_ = 0;
+  };
+}
+#endif
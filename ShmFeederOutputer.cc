@@ -0,0 +1,179 @@
+#include "ShmFeederOutputer.h"
+#include "OutputerFactory.h"
+#include "ConfigurationParameters.h"
+#include "UnrolledSerializerWrapper.h"
+#include "FixedLayoutSerializerWrapper.h"
+#include "SerializerWrapper.h"
+#include "summarize_serializers.h"
+#include "summarize_queue.h"
+#include "PerfCounters.h"
+#include <iostream>
+#include <stdexcept>
+
+using namespace cce::tf;
+using namespace cce::tf::pds;
+
+ShmFeederOutputer::ShmFeederOutputer(std::string iRingName, unsigned int iNLanes, pds::Compression iCompression, int iCompressionLevel,
+                                     pds::Serialization iSerialization, uint32_t iNSlots, std::size_t iSlotBytes, uint32_t iNConsumers,
+                                     std::chrono::milliseconds iTimeout):
+  ringName_{std::move(iRingName)},
+  nSlots_{iNSlots},
+  slotBytes_{iSlotBytes},
+  nConsumers_{iNConsumers},
+  timeout_{iTimeout},
+  serializers_{std::size_t(iNLanes)},
+  compressionContexts_{std::size_t(iNLanes)},
+  laneBuffers_{std::size_t(iNLanes)},
+  compression_{iCompression},
+  compressionLevel_{iCompressionLevel},
+  serialization_{iSerialization},
+  serialTime_{std::chrono::microseconds::zero()},
+  parallelTime_{iNLanes}
+{}
+
+ShmFeederOutputer::~ShmFeederOutputer() {
+  //consumers waiting for more events must be told even if the job ended early
+  if(ring_ and not finished_) {
+    ring_->finish();
+  }
+}
+
+void ShmFeederOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) {
+  auto& s = serializers_[iLaneIndex];
+  switch(serialization_) {
+  case Serialization::kRoot:
+    {   s = SerializeStrategy::make<SerializeProxy<SerializerWrapper>>(); break; }
+  case Serialization::kRootUnrolled:
+    {   s = SerializeStrategy::make<SerializeProxy<UnrolledSerializerWrapper>>(); break; }
+  case Serialization::kNativeUnrolled:
+    {   s = SerializeStrategy::make<SerializeProxy<NativeUnrolledSerializerWrapper>>(); break; }
+  case Serialization::kFixedLayout:
+    {   s = SerializeStrategy::make<SerializeProxy<FixedLayoutSerializerWrapper>>(); break; }
+  }
+  s.reserve(iDPs.size());
+  for(auto const& dp: iDPs) {
+    s.emplace_back(dp.name(), dp.classType());
+  }
+  if(iLaneIndex == 0) {
+    //the consumers need the data products before the first event
+    std::vector<std::pair<std::string, std::string>> products;
+    products.reserve(s.size());
+    for(auto const& w: s) {
+      products.emplace_back(w.name(), w.className());
+    }
+    ring_.emplace(ShmEventRing::create(ringName_, pds::fileHeader(serialization_, compression_, products),
+                                       nSlots_, slotBytes_, nConsumers_, timeout_));
+  }
+}
+
+void ShmFeederOutputer::productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const {
+  auto& laneSerializers = serializers_[iLaneIndex];
+  serializeOrPassThroughAsync(laneSerializers[iDataProduct.index()], iDataProduct, serialization_, std::move(iCallback), 0);
+}
+
+void ShmFeederOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+  auto start = std::chrono::high_resolution_clock::now();
+  serializeDeferred(serializers_[iLaneIndex]);
+  auto& buffers = laneBuffers_[iLaneIndex];
+  writeRecord(iEventID, serializers_[iLaneIndex], compressionContexts_[iLaneIndex], buffers.uncompressed_, buffers.record_);
+  //the Lane waits for its record to be published so its buffers are not touched until then
+  queue_.push(*iCallback.group(), [this, iLaneIndex, callback=std::move(iCallback)]() {
+      auto start = std::chrono::high_resolution_clock::now();
+      auto const& record = laneBuffers_[iLaneIndex].record_;
+      ring_->publish(record.data(), record.data()+record.size());
+      bytesPublished_ += record.size()*4;
+      serialTime_ += std::chrono::duration_cast<decltype(serialTime_)>(std::chrono::high_resolution_clock::now() - start);
+    });
+  auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+  parallelTime_.add(iLaneIndex, time.count());
+}
+
+void ShmFeederOutputer::writeRecord(EventIdentifier const& iEventID, SerializeStrategy const& iSerializers, pds::CompressionContext& iContext,
+                                    std::vector<uint32_t>& ioUncompressed, std::vector<uint32_t>& oRecord) const {
+  //the same layout as the event record of a PDS file
+  pds::uncompressedEventBuffer(iSerializers, ioUncompressed);
+  PerfScope perf(PerfCounters::kCompress);
+  pds::eventRecord(iEventID, ioUncompressed, compression_, compressionLevel_, iContext, oRecord);
+}
+
+void ShmFeederOutputer::finish() const {
+  if(finished_ or not ring_) {
+    return;
+  }
+  finished_ = true;
+  ring_->finish();
+  released_ = ring_->waitUntilReleased();
+}
+
+void ShmFeederOutputer::printSummary() const {
+  finish();
+  std::cout <<"ShmFeederOutputer\n  total serial time at end event: "<<serialTime_.count()<<"us\n"
+    "  total parallel time at end event: "<<parallelTime_.sum()<<"us\n";
+  if(ring_) {
+    std::cout <<"  events published: "<<ring_->nPublished()<<" bytes: "<<bytesPublished_<<" consumers: "<<nConsumers_<<"\n"
+      "  waits for a free slot: "<<ring_->nSlotWaits()<<"\n";
+  }
+  if(not released_) {
+    std::cout <<"  the consumers did not read all the events within "<<timeout_.count()<<"ms\n";
+  }
+  summarize_queue("publish", queue_);
+  summarize_serializers(serializers_);
+}
+
+void ShmFeederOutputer::fillProfile(ProductProfile& oProfile) const {
+  profile_serializers(oProfile, serializers_);
+}
+
+void ShmFeederOutputer::fillReport(RunReport& oReport) const {
+  oReport.set("serialTime_us", serialTime_.count());
+  oReport.set("parallelTime_us", parallelTime_.sum());
+  if(ring_) {
+    oReport.set("eventsPublished", ring_->nPublished());
+    oReport.set("slotWaits", ring_->nSlotWaits());
+  }
+  oReport.set("bytesPublished", bytesPublished_);
+  oReport.set("consumers", nConsumers_);
+  report_serializers(oReport, serializers_);
+  report_queue(oReport, "publish", queue_);
+}
+
+namespace {
+  class Maker : public OutputerMakerBase {
+  public:
+    Maker(): OutputerMakerBase("ShmFeederOutputer") {}
+
+    std::unique_ptr<OutputerBase> create(unsigned int iNLanes, ConfigurationParameters const& params) const final {
+      auto ringName = params.get<std::string>("fileName");
+      if(not ringName) {
+        std::cout <<"no shared memory name given for ShmFeederOutputer\n";
+        return {};
+      }
+      int compressionLevel = params.get<int>("compressionLevel", 18);
+      auto compressionName = params.get<std::string>("compressionAlgorithm", "ZSTD");
+      auto serializationName = params.get<std::string>("serializationAlgorithm", "ROOT");
+
+      auto compression = pds::toCompression(compressionName);
+      if(not compression) {
+        std::cout <<"unknown compression "<<compressionName<<std::endl;
+        return {};
+      }
+      auto serialization = pds::toSerialization(serializationName);
+      if(not serialization) {
+        std::cout <<"unknown serialization "<<serializationName<<std::endl;
+        return {};
+      }
+      auto nSlots = params.get<unsigned int>("slots", 4*iNLanes);
+      auto slotBytes = params.get<std::size_t>("slotBytes", 8*1024*1024);
+      auto nConsumers = params.get<unsigned int>("consumers", 1);
+      auto timeout = params.get<unsigned int>("timeout", 60);
+      if(nSlots == 0 or slotBytes == 0 or nConsumers == 0) {
+        std::cout <<"slots, slotBytes and consumers of ShmFeederOutputer must be at least 1"<<std::endl;
+        return {};
+      }
+      return std::make_unique<ShmFeederOutputer>(*ringName, iNLanes, *compression, compressionLevel, *serialization,
+                                                 nSlots, slotBytes, nConsumers, std::chrono::seconds(timeout));
+    }
+  };
+
+  Maker s_maker;
+}
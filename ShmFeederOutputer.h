@@ -0,0 +1,79 @@
+#if !defined(ShmFeederOutputer_h)
+#define ShmFeederOutputer_h
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <chrono>
+#include <optional>
+
+#include "OutputerBase.h"
+#include "EventIdentifier.h"
+#include "SerializeStrategy.h"
+#include "DataProductRetriever.h"
+#include "pds_common.h"
+#include "pds_writer.h"
+#include "ShmEventRing.h"
+
+#include "SerialTaskQueue.h"
+#include "PerLaneCounter.h"
+
+namespace cce::tf {
+  /**
+     Publishes each event as a compressed PDS event record into a ShmEventRing
+     so ShmSources in other processes can read the events of this job's Source
+     without each opening and decoding the input themselves. The ring's header
+     is the PDS file header of the events.
+   */
+class ShmFeederOutputer :public OutputerBase {
+ public:
+  ShmFeederOutputer(std::string iRingName, unsigned int iNLanes, pds::Compression iCompression, int iCompressionLevel,
+                    pds::Serialization iSerialization, uint32_t iNSlots, std::size_t iSlotBytes, uint32_t iNConsumers,
+                    std::chrono::milliseconds iTimeout);
+  ~ShmFeederOutputer();
+
+  void setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) final;
+
+  void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const final;
+  bool usesProductReadyAsync() const final {return true;}
+
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+
+  void printSummary() const final;
+  void fillReport(RunReport&) const final;
+  void fillProfile(ProductProfile&) const final;
+
+ private:
+  void writeRecord(EventIdentifier const& iEventID, SerializeStrategy const& iSerializers, pds::CompressionContext&,
+                   std::vector<uint32_t>& ioUncompressed, std::vector<uint32_t>& oRecord) const;
+  //tells the consumers no more events will come and waits for them to release the last ones
+  void finish() const;
+
+  std::string ringName_;
+  mutable std::optional<ShmEventRing> ring_;
+  uint32_t nSlots_;
+  std::size_t slotBytes_;
+  uint32_t nConsumers_;
+  std::chrono::milliseconds timeout_;
+  mutable bool finished_ = false;
+  mutable bool released_ = true;
+
+  mutable SerialTaskQueue queue_;
+  mutable std::vector<SerializeStrategy> serializers_;
+  //one per lane so the compression state does not need to be remade for each event
+  mutable std::vector<pds::CompressionContext> compressionContexts_;
+  //the buffers of a Lane are reused from one event to the next
+  struct LaneBuffers {
+    std::vector<uint32_t> uncompressed_;
+    std::vector<uint32_t> record_;
+  };
+  mutable std::vector<LaneBuffers> laneBuffers_;
+  pds::Compression compression_;
+  int compressionLevel_;
+  pds::Serialization serialization_;
+  mutable unsigned long long bytesPublished_ = 0;
+  mutable std::chrono::microseconds serialTime_;
+  mutable PerLaneCounter<std::chrono::microseconds::rep> parallelTime_;
+};
+}
+#endif
@@ -0,0 +1,220 @@
+#include "ShmSource.h"
+#include "SourceFactory.h"
+#include "Deserializer.h"
+#include "UnrolledDeserializer.h"
+#include "FixedLayoutDeserializer.h"
+
+#include "TClass.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <cassert>
+
+using namespace cce::tf;
+
+ShmSource::ShmSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iRingName, std::chrono::milliseconds iTimeout,
+                     ProductSelector const& iSelector) :
+  SharedSourceBase(iNEvents),
+  ring_{ShmEventRing::attach(iRingName, iTimeout)}
+{
+  pds::Serialization serialization;
+  std::vector<pds::ProductInfo> productInfo;
+  {
+    //the ring's header is the header of a PDS file
+    auto header = ring_.header();
+    std::istringstream stream(std::string(reinterpret_cast<char const*>(header.data()), header.size()*4));
+    pds::FileOptions options;
+    productInfo = readFileHeader(stream, compression_, serialization, options);
+    if(not options.dictionary_.empty()) {
+      dictionary_ = std::make_unique<pds::DecompressionDictionary>(options.dictionary_);
+    }
+    perProductCompression_ = options.perProductCompression_;
+    checksum_ = options.checksum_;
+    shuffle_ = std::move(options.shuffle_);
+    productMap_ = pds::selectProducts(productInfo, iSelector);
+  }
+
+  laneInfos_.reserve(iNLanes);
+  for(unsigned int i = 0; i< iNLanes; ++i) {
+    DeserializeStrategy strategy;
+    switch(serialization) {
+    case pds::Serialization::kRoot: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<Deserializer>>(); break;
+    }
+    case pds::Serialization::kRootUnrolled: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<UnrolledDeserializer>>(); break;
+    }
+    case pds::Serialization::kNativeUnrolled: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<NativeUnrolledDeserializer>>(); break;
+    }
+    case pds::Serialization::kFixedLayout: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<FixedLayoutDeserializer>>(); break;
+    }
+    }
+    laneInfos_.emplace_back(productInfo, std::move(strategy));
+    laneInfos_.back().decompressionContext_.setDictionary(dictionary_.get());
+    laneInfos_.back().decompressionContext_.setShuffle(shuffle_);
+  }
+}
+
+ShmSource::LaneInfo::LaneInfo(std::vector<pds::ProductInfo> const& productInfo, DeserializeStrategy deserialize):
+  deserializers_{std::move(deserialize)},
+  readTime_{std::chrono::microseconds::zero()},
+  decompressTime_{std::chrono::microseconds::zero()},
+  deserializeTime_{std::chrono::microseconds::zero()}
+{
+  dataProducts_.reserve(productInfo.size());
+  dataBuffers_.resize(productInfo.size(), nullptr);
+  deserializers_.reserve(productInfo.size());
+  size_t index =0;
+  for(auto const& pi : productInfo) {
+
+    TClass* cls = TClass::GetClass(pi.className().c_str());
+    assert(cls);
+    dataBuffers_[index] = cls->New();
+    dataProducts_.emplace_back(index,
+                               &dataBuffers_[index],
+                               pi.name(),
+                               cls,
+                               &delayedRetriever_);
+    deserializers_.emplace_back(cls);
+    ++index;
+  }
+}
+
+ShmSource::LaneInfo::~LaneInfo() {
+  auto it = dataProducts_.begin();
+  for( void * b: dataBuffers_) {
+    it->classType()->Destructor(b);
+    ++it;
+  }
+}
+
+size_t ShmSource::numberOfDataProducts() const {
+  return laneInfos_[0].dataProducts_.size();
+}
+
+std::vector<DataProductRetriever>& ShmSource::dataProducts(unsigned int iLane, long iEventIndex) {
+  return laneInfos_[iLane].dataProducts_;
+}
+
+EventIdentifier ShmSource::eventIdentifier(unsigned int iLane, long iEventIndex) {
+  return laneInfos_[iLane].eventID_;
+}
+
+void ShmSource::readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder iTask) {
+  //header structure in words
+  constexpr size_t kRunIDW=1;
+  constexpr size_t kLumiIDW=2;
+  constexpr size_t kEventIDMSW=3;
+  constexpr size_t kEventIDLSW=4;
+
+  auto& laneInfo = laneInfos_[iLane];
+  auto start = std::chrono::high_resolution_clock::now();
+  auto recordNumber = ring_.claim();
+  if(not recordNumber) {
+    return;
+  }
+  auto record = ring_.record(*recordNumber).begin_;
+  assert(record[0] == pds::kEventRecordType);
+  unsigned long long eventID = record[kEventIDMSW];
+  eventID = (eventID << 32) + record[kEventIDLSW];
+  laneInfo.eventID_ = {record[kRunIDW], record[kLumiIDW], eventID};
+
+  uint32_t bufferSize = record[pds::kEventHeaderSizeInWords];
+  auto bufferBegin = record + pds::kEventHeaderSizeInWords+1;
+  assert(bufferBegin[bufferSize] == bufferSize);
+  if(checksum_) {
+    pds::checkRecordChecksum(bufferBegin, bufferBegin+bufferSize, laneInfo.eventID_);
+    --bufferSize;
+  }
+  laneInfo.readTime_ +=
+    std::chrono::duration_cast<decltype(laneInfo.readTime_)>(std::chrono::high_resolution_clock::now() - start);
+
+  if(perProductCompression_) {
+    //decompression and deserialization are interleaved so are timed together
+    start = std::chrono::high_resolution_clock::now();
+    pds::uncompressAndDeserializeProducts(compression_, bufferBegin, bufferBegin+bufferSize, laneInfo.productBuffer_, laneInfo.decompressionContext_,
+                                          laneInfo.dataProducts_, laneInfo.deserializers_, productMap_);
+    ring_.release(*recordNumber);
+    laneInfo.deserializeTime_ +=
+      std::chrono::duration_cast<decltype(laneInfo.deserializeTime_)>(std::chrono::high_resolution_clock::now() - start);
+    iTask.runNow();
+    return;
+  }
+
+  start = std::chrono::high_resolution_clock::now();
+  auto& uBuffer = laneInfo.uncompressedBuffer_;
+  pds::uncompressEventBuffer(compression_, bufferBegin, bufferBegin+bufferSize, uBuffer, laneInfo.decompressionContext_);
+  //the uncompressed buffer no longer needs the shared memory
+  ring_.release(*recordNumber);
+  laneInfo.decompressTime_ +=
+    std::chrono::duration_cast<decltype(laneInfo.decompressTime_)>(std::chrono::high_resolution_clock::now() - start);
+
+  start = std::chrono::high_resolution_clock::now();
+  pds::deserializeDataProducts(uBuffer.begin(), uBuffer.end(), laneInfo.dataProducts_, laneInfo.deserializers_, productMap_);
+  laneInfo.deserializeTime_ +=
+    std::chrono::duration_cast<decltype(laneInfo.deserializeTime_)>(std::chrono::high_resolution_clock::now() - start);
+
+  iTask.runNow();
+}
+
+void ShmSource::printSummary() const {
+  std::cout <<"\nSource:\n"
+    "   consumer: "<<ring_.consumerIndex()<<" of "<<ring_.nConsumers()<<"\n"
+    "   waits for the feeder: "<<ring_.nRecordWaits()<<"\n"
+    "   read time: "<<readTime().count()<<"us\n"
+    "   decompress time: "<<decompressTime().count()<<"us\n"
+    "   deserialize time: "<<deserializeTime().count()<<"us\n"<<std::endl;
+};
+
+void ShmSource::fillReport(RunReport& oReport) const {
+  oReport.set("readTime_us", readTime().count());
+  oReport.set("decompressTime_us", decompressTime().count());
+  oReport.set("deserializeTime_us", deserializeTime().count());
+  oReport.set("feederWaits", ring_.nRecordWaits());
+}
+
+std::chrono::microseconds ShmSource::readTime() const {
+  auto time = std::chrono::microseconds::zero();
+  for(auto const& l : laneInfos_) {
+    time += l.readTime_;
+  }
+  return time;
+}
+
+std::chrono::microseconds ShmSource::decompressTime() const {
+  auto time = std::chrono::microseconds::zero();
+  for(auto const& l : laneInfos_) {
+    time += l.decompressTime_;
+  }
+  return time;
+}
+
+std::chrono::microseconds ShmSource::deserializeTime() const {
+  auto time = std::chrono::microseconds::zero();
+  for(auto const& l : laneInfos_) {
+    time += l.deserializeTime_;
+  }
+  return time;
+}
+
+
+namespace {
+    class Maker : public SourceMakerBase {
+  public:
+    Maker(): SourceMakerBase("ShmSource") {}
+      std::unique_ptr<SharedSourceBase> create(unsigned int iNLanes, unsigned long long iNEvents, ConfigurationParameters const& params) const final {
+        auto ringName = params.get<std::string>("fileName");
+        if(not ringName) {
+          std::cout <<"no shared memory name given\n";
+          return {};
+        }
+        auto timeout = params.get<unsigned int>("timeout", 60);
+        ProductSelector selector{params.get<std::string>("products", "")};
+        return std::make_unique<ShmSource>(iNLanes, iNEvents, *ringName, std::chrono::seconds(timeout), selector);
+    }
+    };
+
+  Maker s_maker;
+}
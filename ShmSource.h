@@ -0,0 +1,86 @@
+#if !defined(ShmSource_h)
+#define ShmSource_h
+
+#include <string>
+#include <memory>
+#include <chrono>
+#include <iostream>
+
+#include "SharedSourceBase.h"
+#include "DataProductRetriever.h"
+#include "DelayedProductRetriever.h"
+#include "DeserializeStrategy.h"
+#include "ShmEventRing.h"
+#include "pds_reading.h"
+#include "PerLaneCounter.h"
+
+
+namespace cce::tf {
+  class ShmDelayedRetriever : public DelayedProductRetriever {
+    void getAsync(DataProductRetriever&, int index, TaskHolder) final {}
+  };
+
+  /**
+     Reads the events a ShmFeederOutputer in another process publishes into
+     a ShmEventRing. Each event record is decompressed directly from the
+     shared memory and its slot is released as soon as the data products are
+     deserialized.
+   */
+  class ShmSource : public SharedSourceBase {
+  public:
+    ShmSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iRingName, std::chrono::milliseconds iTimeout,
+              ProductSelector const& iSelector = ProductSelector());
+    ShmSource(ShmSource&&) = delete;
+    ShmSource(ShmSource const&) = delete;
+
+  size_t numberOfDataProducts() const final;
+  std::vector<DataProductRetriever>& dataProducts(unsigned int iLane, long iEventIndex) final;
+  EventIdentifier eventIdentifier(unsigned int iLane, long iEventIndex) final;
+
+  void printSummary() const final;
+  void fillReport(RunReport&) const final;
+  private:
+
+  void readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder) final;
+
+  std::chrono::microseconds readTime() const;
+  std::chrono::microseconds decompressTime() const;
+  std::chrono::microseconds deserializeTime() const;
+
+  ShmEventRing ring_;
+  std::unique_ptr<pds::DecompressionDictionary> dictionary_;
+  pds::Compression compression_;
+  bool perProductCompression_;
+  bool checksum_;
+  std::vector<uint8_t> shuffle_;
+  pds::ProductMap productMap_;
+
+  struct alignas(kCacheLineSize) LaneInfo {
+    LaneInfo(std::vector<pds::ProductInfo> const&, DeserializeStrategy);
+
+    LaneInfo(LaneInfo&&) = default;
+    LaneInfo(LaneInfo const&) = delete;
+
+    LaneInfo& operator=(LaneInfo&&) = default;
+    LaneInfo& operator=(LaneInfo const&) = delete;
+
+    EventIdentifier eventID_;
+    std::vector<DataProductRetriever> dataProducts_;
+    std::vector<void*> dataBuffers_;
+    DeserializeStrategy deserializers_;
+    ShmDelayedRetriever delayedRetriever_;
+    pds::ReusableBuffer<uint32_t> uncompressedBuffer_;
+    //used when each data product was compressed separately
+    pds::ReusableBuffer<char> productBuffer_;
+    pds::DecompressionContext decompressionContext_;
+    std::chrono::microseconds readTime_;
+    std::chrono::microseconds decompressTime_;
+    std::chrono::microseconds deserializeTime_;
+    ~LaneInfo();
+  };
+
+  std::vector<LaneInfo> laneInfos_;
+  };
+}
+
+#endif
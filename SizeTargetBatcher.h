@@ -0,0 +1,86 @@
+#if !defined(SizeTargetBatcher_h)
+#define SizeTargetBatcher_h
+
+#include <vector>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace cce::tf {
+  /**
+     Collects entries into a batch which is closed once the bytes of its
+     entries reach iTargetBytes or it holds iMaxEntries entries (if non 0).
+     The entry limit keeps slowly filling batches from holding events for
+     too long. add() can be called concurrently.
+   */
+  template<typename T>
+  class SizeTargetBatcher {
+  public:
+    SizeTargetBatcher(std::size_t iTargetBytes, std::uint32_t iMaxEntries):
+      targetBytes_{iTargetBytes}, maxEntries_{iMaxEntries} {}
+
+    //returns the closed batch if iEntry completed it, else an empty vector
+    std::vector<T> add(T iEntry, std::size_t iBytes) {
+      std::lock_guard<std::mutex> guard(mutex_);
+      batch_.push_back(std::move(iEntry));
+      bytes_ += iBytes;
+      if(bytes_ >= targetBytes_ or (maxEntries_ != 0 and batch_.size() >= maxEntries_)) {
+        return close();
+      }
+      return {};
+    }
+
+    //returns the partially filled batch, used at the end of the job
+    std::vector<T> takeRemaining() {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if(batch_.empty()) {
+        return {};
+      }
+      return close();
+    }
+
+    struct Stats {
+      std::uint64_t nBatches_ = 0;
+      std::uint64_t nEntries_ = 0;
+      std::size_t minEntries_ = std::numeric_limits<std::size_t>::max();
+      std::size_t maxEntries_ = 0;
+      std::uint64_t bytes_ = 0;
+      std::size_t maxBytes_ = 0;
+      //batches closed by the entry limit rather than the byte target
+      std::uint64_t nClosedByEntryLimit_ = 0;
+    };
+    Stats const& stats() const { return stats_; }
+
+  private:
+    std::vector<T> close() {
+      stats_.nBatches_ += 1;
+      stats_.nEntries_ += batch_.size();
+      if(batch_.size() < stats_.minEntries_) {
+        stats_.minEntries_ = batch_.size();
+      }
+      if(batch_.size() > stats_.maxEntries_) {
+        stats_.maxEntries_ = batch_.size();
+      }
+      stats_.bytes_ += bytes_;
+      if(bytes_ > stats_.maxBytes_) {
+        stats_.maxBytes_ = bytes_;
+      }
+      if(bytes_ < targetBytes_ and maxEntries_ != 0 and batch_.size() >= maxEntries_) {
+        ++stats_.nClosedByEntryLimit_;
+      }
+      bytes_ = 0;
+      std::vector<T> closed;
+      closed.swap(batch_);
+      return closed;
+    }
+
+    std::size_t const targetBytes_;
+    std::uint32_t const maxEntries_;
+    std::mutex mutex_;
+    std::vector<T> batch_;
+    std::size_t bytes_ = 0;
+    Stats stats_;
+  };
+}
+#endif
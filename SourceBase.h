@@ -6,6 +6,7 @@
 
 #include <vector>
 #include <chrono>
+#include <optional>
 
 namespace cce::tf {
 class SourceBase {
@@ -21,6 +22,9 @@ class SourceBase {
 
   bool gotoEvent(long iEventIndex);
 
+  //the number of events in the file, if known without reading them
+  virtual std::optional<long> numberOfEvents() const { return std::nullopt; }
+
   std::chrono::microseconds accumulatedTime() const { return accumulatedTime_;}
 
  private:
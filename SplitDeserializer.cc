@@ -0,0 +1,99 @@
+#include "SplitDeserializer.h"
+#include "SplitSerializer.h"
+
+#include "TVirtualCollectionProxy.h"
+
+#include <stdexcept>
+#include <string>
+
+using namespace cce::tf;
+using namespace cce::tf::unrolling;
+
+SplitDeserializer::SplitDeserializer(TClass* iClass, bool iNativeEndian):
+  offsetAndSequences_{buildReadActionSequence(*iClass)}
+{
+  auto const nStreams = numberOfSplitStreams(offsetAndSequences_);
+  streams_.reserve(nStreams);
+  for(std::size_t i = 0; i < nStreams; ++i) {
+    streams_.push_back(makeSplitStreamBuffer(TBuffer::kRead, iNativeEndian));
+  }
+  reads_.resize(nStreams, true);
+}
+
+void SplitDeserializer::select(std::vector<bool> const& iRead) {
+  if(iRead.size() != streams_.size()) {
+    throw std::runtime_error("SplitDeserializer given a selection of "+std::to_string(iRead.size())+" streams but has "
+                             +std::to_string(streams_.size()));
+  }
+  reads_ = iRead;
+  std::size_t stream = 0;
+  selectSizes(offsetAndSequences_.m_objects, offsetAndSequences_.m_collections, stream);
+}
+
+bool SplitDeserializer::selectSizes(OffsetAndSequences const& offsetAndSequences, SequencesForCollections const& seq4Collections,
+                                    std::size_t& ioStream) {
+  bool readsAny = false;
+  for(std::size_t i = 0; i < offsetAndSequences.size(); ++i) {
+    readsAny = reads_[ioStream++] or readsAny;
+  }
+  for(auto const& coll: seq4Collections) {
+    auto const sizeStream = ioStream++;
+    bool readsElements;
+    if(coll.m_builtinType != kNoType_t) {
+      readsElements = reads_[ioStream++];
+    } else {
+      readsElements = selectSizes(coll.m_offsetAndSequences, coll.m_collections, ioStream);
+    }
+    reads_[sizeStream] = reads_[sizeStream] or readsElements;
+    readsAny = reads_[sizeStream] or readsAny;
+  }
+  return readsAny;
+}
+
+void SplitDeserializer::deserialize(BlobView const* iStreams, void* iWriteTo) {
+  //a stream with no bytes is never asked for any
+  static char s_empty = 0;
+  for(std::size_t i = 0; i < streams_.size(); ++i) {
+    if(reads_[i]) {
+      auto data = iStreams[i].empty() ? &s_empty : iStreams[i].data();
+      streams_[i]->SetBuffer(const_cast<char*>(data), iStreams[i].size(), kFALSE);
+    }
+  }
+  std::size_t stream = 0;
+  deserialize(iWriteTo, offsetAndSequences_.m_objects, offsetAndSequences_.m_collections, stream);
+}
+
+void SplitDeserializer::deserialize(void* address, OffsetAndSequences const& offsetAndSequences, SequencesForCollections const& seq4Collections,
+                                    std::size_t& ioStream) {
+  for(auto& offNSeq: offsetAndSequences) {
+    auto const stream = ioStream++;
+    if(reads_[stream]) {
+      streams_[stream]->ApplySequence(*(offNSeq.second), static_cast<char*>(address)+offNSeq.first);
+    }
+  }
+
+  for(auto& coll: seq4Collections) {
+    auto const sizeStream = ioStream;
+    ioStream += numberOfSplitStreams(coll);
+    if(not reads_[sizeStream]) {
+      continue;
+    }
+    auto collAddress = static_cast<char const*>(address) + coll.m_offset;
+
+    TVirtualCollectionProxy::TPushPop helper(coll.m_collProxy.get(), const_cast<char*>(collAddress));
+    Int_t size;
+    *streams_[sizeStream] >> size;
+    coll.m_collProxy->Allocate(size, true);
+
+    if(coll.m_builtinType != kNoType_t) {
+      if(reads_[sizeStream+1]) {
+        readBuiltins(*streams_[sizeStream+1], coll.m_builtinType, size ? (*coll.m_collProxy)[0] : nullptr, size);
+      }
+      continue;
+    }
+    for(Int_t item=0; item<size; ++item) {
+      std::size_t elementStream = sizeStream+1;
+      deserialize((*coll.m_collProxy)[item], coll.m_offsetAndSequences, coll.m_collections, elementStream);
+    }
+  }
+}
@@ -0,0 +1,48 @@
+#if !defined(SplitDeserializer_h)
+#define SplitDeserializer_h
+
+#include <memory>
+#include <vector>
+#include "TBufferFile.h"
+#include "TClass.h"
+#include "common_unrolling.h"
+#include "BlobView.h"
+
+namespace cce::tf {
+  /**
+     Reads the streams written by SplitSerializer. Only the selected streams
+     are read, the members they hold for the other streams keep their
+     values. The sizes of a collection are read if any of its streams is.
+     The buffers are reused for each call so an instance must only be used
+     by one lane.
+   */
+  class SplitDeserializer {
+  public:
+    //iNativeEndian must match the SplitSerializer which wrote the data
+    SplitDeserializer(TClass*, bool iNativeEndian);
+
+    SplitDeserializer(SplitDeserializer&&) = default;
+    SplitDeserializer(SplitDeserializer const&) = delete;
+
+    std::size_t numberOfStreams() const { return streams_.size(); }
+
+    //iRead has one entry per stream, by default all streams are read
+    void select(std::vector<bool> const& iRead);
+    bool reads(std::size_t iStream) const { return reads_[iStream]; }
+
+    //iStreams holds the bytes of the object in each stream, those not read may be empty
+    void deserialize(BlobView const* iStreams, void* iWriteTo);
+
+  private:
+    void deserialize(void* address, unrolling::OffsetAndSequences const& offsetAndSequences, unrolling::SequencesForCollections const& seq4Collections,
+                     std::size_t& ioStream);
+    //marks the size streams of the collections holding a read stream, returns true if any stream was read
+    bool selectSizes(unrolling::OffsetAndSequences const& offsetAndSequences, unrolling::SequencesForCollections const& seq4Collections,
+                     std::size_t& ioStream);
+
+    unrolling::ObjectAndCollectionsSequences offsetAndSequences_;
+    std::vector<std::unique_ptr<TBufferFile>> streams_;
+    std::vector<bool> reads_;
+  };
+}
+#endif
@@ -0,0 +1,262 @@
+#include "SplitPDSOutputer.h"
+#include "OutputerFactory.h"
+#include "ConfigurationParameters.h"
+#include "FunctorTask.h"
+#include "summarize_queue.h"
+#include "StorageEmulator.h"
+
+#include "TClass.h"
+
+#include "tbb/task_group.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+using namespace cce::tf;
+
+namespace {
+  uint32_t bytesToWords(std::size_t nBytes) {
+    return nBytes/4 + ( (nBytes % 4) == 0 ? 0 : 1);
+  }
+}
+
+SplitPDSOutputer::SplitPDSOutputer(std::string const& iFileName, unsigned int iNLanes, pds::Compression iCompression, int iCompressionLevel,
+                                   pds::Serialization iSerialization, unsigned int iBatchSize):
+  file_{iFileName, std::ios_base::out | std::ios_base::binary},
+  compression_{iCompression},
+  compressionLevel_{iCompressionLevel},
+  nativeEndian_{iSerialization == pds::Serialization::kNativeUnrolled},
+  batchSize_{std::max(iBatchSize, 1U)},
+  serializers_{std::size_t(iNLanes)},
+  serialTime_{std::chrono::microseconds::zero()},
+  parallelTime_{iNLanes}
+{
+  if(iSerialization != pds::Serialization::kRootUnrolled and iSerialization != pds::Serialization::kNativeUnrolled) {
+    throw std::runtime_error("SplitPDSOutputer only supports the Unrolled and NativeUnrolled serializations");
+  }
+  if(not file_) {
+    throw std::runtime_error("SplitPDSOutputer unable to open file "+iFileName);
+  }
+}
+
+void SplitPDSOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) {
+  auto& s = serializers_[iLaneIndex];
+  s.reserve(iDPs.size());
+  for(auto const& dp: iDPs) {
+    s.emplace_back(dp.classType(), nativeEndian_);
+  }
+  if(not firstStreams_.empty()) {
+    return;
+  }
+  //all Lanes have the same data products
+  std::vector<std::pair<std::string, std::string>> products;
+  std::vector<uint32_t> nStreams;
+  products.reserve(iDPs.size());
+  nStreams.reserve(iDPs.size());
+  firstStreams_.push_back(0);
+  for(std::size_t index = 0; index < iDPs.size(); ++index) {
+    products.emplace_back(iDPs[index].name(), iDPs[index].classType()->GetName());
+    productNames_.push_back(iDPs[index].name());
+    nStreams.push_back(s[index].numberOfStreams());
+    firstStreams_.push_back(firstStreams_.back()+nStreams.back());
+  }
+  uncompressedBytes_.resize(firstStreams_.back(), 0);
+  compressedBytes_.resize(firstStreams_.back(), 0);
+  batch_ = emptyBatch();
+
+  auto const serialization = nativeEndian_ ? pds::Serialization::kNativeUnrolled : pds::Serialization::kRootUnrolled;
+  auto const header = pds::fileHeader(serialization, compression_, products, {}, false, false, {}, true, nStreams);
+  file_.write(reinterpret_cast<char const*>(header.data()), header.size()*4);
+}
+
+SplitPDSOutputer::Batch SplitPDSOutputer::emptyBatch() const {
+  Batch batch;
+  batch.eventIDs_.reserve(batchSize_);
+  batch.streams_.resize(firstStreams_.back());
+  for(auto& stream: batch.streams_) {
+    stream.ends_.reserve(batchSize_);
+  }
+  return batch;
+}
+
+void SplitPDSOutputer::productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const {
+  if(iDataProduct.serialization()) {
+    throw std::runtime_error("SplitPDSOutputer needs the object of data product "+iDataProduct.name()+", the Source only passed its serialized bytes");
+  }
+  auto group = iCallback.group();
+  group->run([this, iLaneIndex, &iDataProduct, callback=std::move(iCallback)]() {
+      auto start = std::chrono::high_resolution_clock::now();
+      serializers_[iLaneIndex][iDataProduct.index()].serialize(*iDataProduct.address());
+      auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+      parallelTime_.add(iLaneIndex, time.count());
+      const_cast<TaskHolder&>(callback).doneWaiting();
+    });
+}
+
+void SplitPDSOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+  queue_.push(*iCallback.group(), [this, iEventID, iLaneIndex, callback=std::move(iCallback)]() mutable {
+      auto start = std::chrono::high_resolution_clock::now();
+      const_cast<SplitPDSOutputer*>(this)->output(iLaneIndex, iEventID, std::move(callback));
+      serialTime_ += std::chrono::duration_cast<decltype(serialTime_)>(std::chrono::high_resolution_clock::now() - start);
+    });
+}
+
+void SplitPDSOutputer::output(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) {
+  batch_.eventIDs_.push_back(iEventID);
+  auto const& serializers = serializers_[iLaneIndex];
+  for(std::size_t product = 0; product < serializers.size(); ++product) {
+    auto const& serializer = serializers[product];
+    for(std::size_t index = 0; index < serializer.numberOfStreams(); ++index) {
+      auto& stream = batch_.streams_[firstStreams_[product]+index];
+      auto blob = serializer.stream(index);
+      stream.bytes_.insert(stream.bytes_.end(), blob.begin(), blob.end());
+      if(stream.bytes_.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("SplitPDSOutputer stream of data product "+productNames_[product]+" is larger than 4GB, use a smaller batchSize");
+      }
+      stream.ends_.push_back(stream.bytes_.size());
+    }
+  }
+  if(batch_.eventIDs_.size() == batchSize_) {
+    //the Lane waits until its batch is written
+    compressAsync(std::make_shared<Batch>(std::exchange(batch_, emptyBatch())), std::move(iCallback));
+  }
+}
+
+void SplitPDSOutputer::compressAsync(std::shared_ptr<Batch> iBatch, TaskHolder iCallback) const {
+  auto group = iCallback.group();
+  auto compressed = std::make_shared<std::vector<std::vector<char>>>(iBatch->streams_.size());
+  TaskHolder streamsDone(*group, make_functor_task([this, iBatch, compressed, callback = std::move(iCallback)]() mutable {
+        auto group = callback.group();
+        queue_.push(*group, [this, batch = std::move(iBatch), compressed = std::move(compressed), callback = std::move(callback)]() mutable {
+            auto start = std::chrono::high_resolution_clock::now();
+            const_cast<SplitPDSOutputer*>(this)->writeRecord(*batch, *compressed);
+            serialTime_ += std::chrono::duration_cast<decltype(serialTime_)>(std::chrono::high_resolution_clock::now() - start);
+            callback.doneWaiting();
+          });
+      }));
+
+  auto compressStream = [this, iBatch, compressed](std::size_t iStream) {
+    auto start = std::chrono::high_resolution_clock::now();
+    auto const& stream = iBatch->streams_[iStream];
+    std::vector<char> uncompressed(stream.ends_.size()*4+stream.bytes_.size());
+    std::memcpy(uncompressed.data(), stream.ends_.data(), stream.ends_.size()*4);
+    if(not stream.bytes_.empty()) {
+      std::memcpy(uncompressed.data()+stream.ends_.size()*4, stream.bytes_.data(), stream.bytes_.size());
+    }
+    (*compressed)[iStream] = pds::compressBuffer(0, 0, compression_, compressionLevel_, uncompressed, compressionContexts_.local());
+    compressionTime_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+  };
+  for(std::size_t i = 0; i < iBatch->streams_.size(); ++i) {
+    group->run([compressStream, i, holder = streamsDone]() { compressStream(i); });
+  }
+}
+
+void SplitPDSOutputer::writeRecord(Batch const& iBatch, std::vector<std::vector<char>> const& iCompressed) {
+  auto const nEvents = iBatch.eventIDs_.size();
+  std::size_t bufferSize = 1 + 4*nEvents + 2*iCompressed.size();
+  for(auto const& c: iCompressed) {
+    bufferSize += bytesToWords(c.size());
+  }
+  if(bufferSize > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("SplitPDSOutputer batch record is too large, use a smaller batchSize");
+  }
+  std::vector<uint32_t> record(pds::kEventHeaderSizeInWords+1+bufferSize+1, 0);
+  auto const& first = iBatch.eventIDs_.front();
+  record[0] = pds::kEventRecordType;
+  record[1] = first.run;
+  record[2] = first.lumi;
+  record[3] = (first.event >> 32) & 0xFFFFFFFF;
+  record[4] = first.event & 0xFFFFFFFF;
+  record[5] = bufferSize;
+  auto buffer = record.data()+pds::kEventHeaderSizeInWords+1;
+  *(buffer++) = nEvents;
+  for(auto const& id: iBatch.eventIDs_) {
+    *(buffer++) = id.run;
+    *(buffer++) = id.lumi;
+    *(buffer++) = (id.event >> 32) & 0xFFFFFFFF;
+    *(buffer++) = id.event & 0xFFFFFFFF;
+  }
+  for(std::size_t i = 0; i < iCompressed.size(); ++i) {
+    auto const uncompressedSize = iBatch.streams_[i].ends_.size()*4+iBatch.streams_[i].bytes_.size();
+    *(buffer++) = iCompressed[i].size();
+    *(buffer++) = uncompressedSize;
+    uncompressedBytes_[i] += uncompressedSize;
+    compressedBytes_[i] += iCompressed[i].size();
+  }
+  for(auto const& c: iCompressed) {
+    std::memcpy(buffer, c.data(), c.size());
+    buffer += bytesToWords(c.size());
+  }
+  record.back() = bufferSize;
+  emulateStorageRequest(record.size()*4);
+  file_.write(reinterpret_cast<char const*>(record.data()), record.size()*4);
+  ++nBatches_;
+}
+
+void SplitPDSOutputer::printSummary() const {
+  if(not batch_.eventIDs_.empty()) {
+    //all lanes are done so the last batch can be written
+    tbb::task_group group;
+    {
+      TaskHolder th(group, make_functor_task([](){}));
+      auto nonConstThis = const_cast<SplitPDSOutputer*>(this);
+      compressAsync(std::make_shared<Batch>(std::exchange(nonConstThis->batch_, Batch())), th);
+    }
+    group.wait();
+  }
+  const_cast<std::ofstream&>(file_).flush();
+
+  std::cout <<"SplitPDSOutputer\n  total serial time at end event: "<<serialTime_.count()<<"us\n"
+    "  total parallel time at end event: "<<parallelTime_.sum()<<"us\n"
+    "  total compression time: "<<compressionTime_.load()<<"us\n"
+    "  batches written: "<<nBatches_<<"\n"
+    "  streams (index: uncompressed bytes -> compressed bytes)\n";
+  for(std::size_t product = 0; product < productNames_.size(); ++product) {
+    std::cout <<"   "<<productNames_[product]<<"\n";
+    for(auto i = firstStreams_[product]; i < firstStreams_[product+1]; ++i) {
+      std::cout <<"    "<<i-firstStreams_[product]<<": "<<uncompressedBytes_[i]<<" -> "<<compressedBytes_[i]<<"\n";
+    }
+  }
+  summarize_queue("write", queue_);
+}
+
+namespace {
+  class Maker : public OutputerMakerBase {
+  public:
+    Maker(): OutputerMakerBase("SplitPDSOutputer") {}
+
+    std::unique_ptr<OutputerBase> create(unsigned int iNLanes, ConfigurationParameters const& params) const final {
+      auto fileName = params.get<std::string>("fileName");
+      if(not fileName) {
+        std::cout<<" no file name given for SplitPDSOutputer\n";
+        return {};
+      }
+      int compressionLevel = params.get<int>("compressionLevel", 18);
+      auto compressionName = params.get<std::string>("compressionAlgorithm", "ZSTD");
+      auto compression = pds::toCompression(compressionName);
+      if(not compression) {
+        std::cout <<"unknown compression "<<compressionName<<std::endl;
+        return {};
+      }
+      auto serializationName = params.get<std::string>("serializationAlgorithm", "Unrolled");
+      auto serialization = pds::toSerialization(serializationName);
+      if(not serialization or (*serialization != pds::Serialization::kRootUnrolled and *serialization != pds::Serialization::kNativeUnrolled)) {
+        std::cout <<"serialization "<<serializationName<<" not supported by SplitPDSOutputer, allowed values are Unrolled or NativeUnrolled"<<std::endl;
+        return {};
+      }
+      auto batchSize = params.get<int>("batchSize", 100);
+      if(batchSize < 1) {
+        std::cout <<"batchSize for SplitPDSOutputer must be at least 1"<<std::endl;
+        return {};
+      }
+      return std::make_unique<SplitPDSOutputer>(*fileName, iNLanes, *compression, compressionLevel, *serialization,
+                                                static_cast<unsigned int>(batchSize));
+    }
+  };
+
+  Maker s_maker;
+}
@@ -0,0 +1,90 @@
+#if !defined(SplitPDSOutputer_h)
+#define SplitPDSOutputer_h
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "OutputerBase.h"
+#include "EventIdentifier.h"
+#include "DataProductRetriever.h"
+#include "SerialTaskQueue.h"
+#include "PerLaneCounter.h"
+#include "SplitSerializer.h"
+#include "pds_writer.h"
+
+#include "tbb/enumerable_thread_specific.h"
+
+namespace cce::tf {
+  /**
+     Writes a PDS file where each Event record holds a batch of events. The
+     data products are serialized with the unrolled algorithm split into one
+     stream per member (see SplitSerializer) and, within a batch, each stream
+     is compressed on its own. A compressor then sees the values of one member
+     next to each other and SplitPDSSource only decompresses the streams of
+     the members it reads. See kHeaderSplitTag for the layout.
+   */
+  class SplitPDSOutputer : public OutputerBase {
+  public:
+    SplitPDSOutputer(std::string const& iFileName, unsigned int iNLanes, pds::Compression iCompression, int iCompressionLevel,
+                     pds::Serialization iSerialization, unsigned int iBatchSize);
+
+    void setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) final;
+
+    void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const final;
+    bool usesProductReadyAsync() const final {return true;}
+
+    void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+
+    void printSummary() const final;
+
+  private:
+    //The bytes of one stream for the events of a batch
+    struct Stream {
+      //the end of each event's bytes
+      std::vector<uint32_t> ends_;
+      std::vector<char> bytes_;
+    };
+    struct Batch {
+      std::vector<EventIdentifier> eventIDs_;
+      //the streams of all data products one after the other
+      std::vector<Stream> streams_;
+    };
+
+    //must be called from queue_
+    void output(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback);
+    //compresses the streams in parallel and then queues the write of the record
+    void compressAsync(std::shared_ptr<Batch> iBatch, TaskHolder iCallback) const;
+    //must be called from queue_
+    void writeRecord(Batch const& iBatch, std::vector<std::vector<char>> const& iCompressed);
+    Batch emptyBatch() const;
+
+    std::ofstream file_;
+    pds::Compression compression_;
+    int compressionLevel_;
+    bool nativeEndian_;
+    unsigned int batchSize_;
+
+    mutable SerialTaskQueue queue_;
+    //per lane, one for each data product
+    mutable std::vector<std::vector<SplitSerializer>> serializers_;
+    std::vector<std::string> productNames_;
+    //the index of the first stream of each data product, the last entry is the number of streams
+    std::vector<std::size_t> firstStreams_;
+    //only used from queue_
+    Batch batch_;
+    mutable tbb::enumerable_thread_specific<pds::CompressionContext> compressionContexts_;
+
+    //per stream, summed over all batches
+    std::vector<unsigned long long> uncompressedBytes_;
+    std::vector<unsigned long long> compressedBytes_;
+    unsigned long long nBatches_ = 0;
+    mutable std::chrono::microseconds serialTime_;
+    mutable PerLaneCounter<std::chrono::microseconds::rep> parallelTime_;
+    mutable std::atomic<std::chrono::microseconds::rep> compressionTime_{0};
+  };
+}
+#endif
@@ -0,0 +1,225 @@
+#include "SplitPDSSource.h"
+#include "SourceFactory.h"
+#include "ReplicatedSharedSource.h"
+
+#include "TClass.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+using namespace cce::tf;
+using namespace cce::tf::pds;
+
+namespace {
+  //for each data product named in iMembers, which of its streams are read
+  std::map<std::string, std::vector<std::size_t>> parseMembers(std::string const& iMembers) {
+    std::map<std::string, std::vector<std::size_t>> members;
+    std::string::size_type start = 0;
+    while(start < iMembers.size()) {
+      auto end = iMembers.find(',', start);
+      if(end == std::string::npos) {
+        end = iMembers.size();
+      }
+      auto entry = iMembers.substr(start, end-start);
+      auto dot = entry.rfind('.');
+      if(dot == std::string::npos or dot == 0 or dot+1 == entry.size() or
+         entry.find_first_not_of("0123456789", dot+1) != std::string::npos) {
+        throw std::runtime_error("SplitPDSSource members entry '"+entry+"' is not of the form product.stream");
+      }
+      members[entry.substr(0, dot)].push_back(std::stoul(entry.substr(dot+1)));
+      start = end+1;
+    }
+    return members;
+  }
+}
+
+SplitPDSSource::SplitPDSSource(std::string const& iName, ProductSelector const& iSelector, std::string const& iMembers):
+  file_{iName, std::ios_base::binary}
+{
+  if(not file_) {
+    throw std::runtime_error("SplitPDSSource unable to open file "+iName);
+  }
+  Serialization serialization;
+  FileOptions options;
+  auto productInfo = readFileHeader(file_, compression_, serialization, options, true);
+  if(not options.split_) {
+    throw std::runtime_error("SplitPDSSource file "+iName+" was not written by SplitPDSOutputer");
+  }
+  if(serialization != Serialization::kRootUnrolled and serialization != Serialization::kNativeUnrolled) {
+    throw std::runtime_error("SplitPDSSource file "+iName+" does not use an unrolled serialization");
+  }
+  bool const nativeEndian = serialization == Serialization::kNativeUnrolled;
+
+  //the first stream and number of streams of each data product, the records also hold those not kept
+  std::map<std::string, std::pair<std::size_t, uint32_t>> fileStreams;
+  for(std::size_t index = 0; index < productInfo.size(); ++index) {
+    fileStreams[productInfo[index].name()] = {nFileStreams_, options.splitStreams_[index]};
+    nFileStreams_ += options.splitStreams_[index];
+  }
+  (void) selectProducts(productInfo, iSelector);
+
+  auto members = parseMembers(iMembers);
+  dataProducts_.reserve(productInfo.size());
+  dataBuffers_.resize(productInfo.size(), nullptr);
+  products_.reserve(productInfo.size());
+  streams_.resize(productInfo.size());
+  for(std::size_t index = 0; index < productInfo.size(); ++index) {
+    auto const& pi = productInfo[index];
+    TClass* cls = TClass::GetClass(pi.className().c_str());
+    if(not cls) {
+      throw std::runtime_error("SplitPDSSource unknown class "+pi.className()+" of data product "+pi.name());
+    }
+    auto const [firstStream, nFileStreams] = fileStreams[pi.name()];
+    products_.emplace_back(cls, nativeEndian, firstStream);
+    auto& deserializer = products_.back().deserializer_;
+    if(deserializer.numberOfStreams() != nFileStreams) {
+      throw std::runtime_error("SplitPDSSource data product "+pi.name()+" has "+std::to_string(nFileStreams)+" streams in the file but class "
+                               +pi.className()+" splits into "+std::to_string(deserializer.numberOfStreams()));
+    }
+    auto itMembers = members.find(pi.name());
+    if(itMembers != members.end()) {
+      std::vector<bool> reads(deserializer.numberOfStreams(), false);
+      for(auto stream: itMembers->second) {
+        if(stream >= reads.size()) {
+          throw std::runtime_error("SplitPDSSource data product "+pi.name()+" has no stream "+std::to_string(stream));
+        }
+        reads[stream] = true;
+      }
+      deserializer.select(reads);
+      members.erase(itMembers);
+    }
+    streams_[index].resize(deserializer.numberOfStreams());
+    dataBuffers_[index] = cls->New();
+    dataProducts_.emplace_back(index, &dataBuffers_[index], pi.name(), cls, &delayedRetriever_);
+  }
+  if(not members.empty()) {
+    throw std::runtime_error("SplitPDSSource members names data product "+members.begin()->first+" which is not read");
+  }
+
+  //find the batch records
+  batchStarts_.push_back(0);
+  std::array<uint32_t, kEventHeaderSizeInWords+2> header;
+  while(true) {
+    auto const offset = file_.tellg();
+    //the record header, its size and the number of events in the batch
+    file_.read(reinterpret_cast<char*>(header.data()), header.size()*4);
+    if(file_.gcount() < std::streamsize(kEventHeaderSizeInWords+1)*4 or header[0] == kEventIndexRecord) {
+      break;
+    }
+    auto const bufferSize = header[kEventHeaderSizeInWords];
+    if(header[0] == kEventRecordType) {
+      batchOffsets_.push_back(offset);
+      batchStarts_.push_back(batchStarts_.back()+header[kEventHeaderSizeInWords+1]);
+    }
+    file_.seekg(offset+std::streamoff(kEventHeaderSizeInWords+1+bufferSize+1)*4);
+  }
+  file_.clear();
+}
+
+SplitPDSSource::~SplitPDSSource() {
+  auto it = dataProducts_.begin();
+  for( void * b: dataBuffers_) {
+    it->classType()->Destructor(b);
+    ++it;
+  }
+}
+
+void SplitPDSSource::readBatch(long iBatch) {
+  file_.seekg(batchOffsets_[iBatch]);
+  std::array<uint32_t, kEventHeaderSizeInWords+1> header;
+  file_.read(reinterpret_cast<char*>(header.data()), header.size()*4);
+  auto const bufferSize = header[kEventHeaderSizeInWords];
+  //the buffer and the crosscheck word
+  record_.resize(bufferSize+1);
+  file_.read(reinterpret_cast<char*>(record_.data()), record_.size()*4);
+  if(not file_ or record_.back() != bufferSize) {
+    throw std::runtime_error("SplitPDSSource failed to read batch "+std::to_string(iBatch));
+  }
+
+  auto it = record_.data();
+  auto const nEvents = *(it++);
+  batchEventIDs_.clear();
+  batchEventIDs_.reserve(nEvents);
+  for(uint32_t i = 0; i < nEvents; ++i) {
+    unsigned long long event = it[2];
+    event = (event << 32) + it[3];
+    batchEventIDs_.push_back({it[0], it[1], event});
+    it += 4;
+  }
+  //the sizes of the streams and where each starts in the record
+  auto const sizes = it;
+  std::vector<char const*> compressed(nFileStreams_);
+  auto data = reinterpret_cast<char const*>(sizes+2*nFileStreams_);
+  for(std::size_t i = 0; i < nFileStreams_; ++i) {
+    compressed[i] = data;
+    data += (sizes[2*i]+3)/4*4;
+  }
+
+  for(std::size_t index = 0; index < products_.size(); ++index) {
+    auto& product = products_[index];
+    for(std::size_t stream = 0; stream < streams_[index].size(); ++stream) {
+      if(not product.deserializer_.reads(stream)) {
+        continue;
+      }
+      auto const fileStream = product.firstStream_+stream;
+      auto& buffer = streams_[index][stream];
+      buffer.resize(sizes[2*fileStream+1]);
+      uncompressBuffer(compression_, compressed[fileStream], sizes[2*fileStream], buffer.size(), buffer.data(), decompressionContext_);
+    }
+  }
+  currentBatch_ = iBatch;
+}
+
+bool SplitPDSSource::readEvent(long iEventIndex) {
+  if(iEventIndex >= batchStarts_.back()) {
+    return false;
+  }
+  if(currentBatch_ < 0 or iEventIndex < batchStarts_[currentBatch_] or iEventIndex >= batchStarts_[currentBatch_+1]) {
+    auto batch = std::upper_bound(batchStarts_.begin(), batchStarts_.end(), iEventIndex) - batchStarts_.begin() - 1;
+    readBatch(batch);
+  }
+  auto const row = iEventIndex - batchStarts_[currentBatch_];
+  auto const nEvents = batchEventIDs_.size();
+  eventID_ = batchEventIDs_[row];
+  for(std::size_t index = 0; index < products_.size(); ++index) {
+    auto& product = products_[index];
+    std::size_t size = 0;
+    for(std::size_t stream = 0; stream < product.views_.size(); ++stream) {
+      if(not product.deserializer_.reads(stream)) {
+        continue;
+      }
+      //the stream starts with the end of each event's bytes
+      auto const& buffer = streams_[index][stream];
+      auto ends = reinterpret_cast<uint32_t const*>(buffer.data());
+      auto const begin = row == 0 ? 0 : ends[row-1];
+      product.views_[stream] = BlobView(buffer.data()+nEvents*4+begin, ends[row]-begin);
+      size += ends[row]-begin;
+    }
+    product.deserializer_.deserialize(product.views_.data(), dataBuffers_[index]);
+    dataProducts_[index].setSize(size);
+  }
+  return true;
+}
+
+namespace {
+    class Maker : public SourceMakerBase {
+  public:
+    Maker(): SourceMakerBase("SplitPDSSource") {}
+      std::unique_ptr<SharedSourceBase> create(unsigned int iNLanes, unsigned long long iNEvents, ConfigurationParameters const& params) const final {
+        auto fileName = params.get<std::string>("fileName");
+        if(not fileName) {
+          std::cout <<"no file name given\n";
+          return {};
+        }
+        ProductSelector selector{params.get<std::string>("products", "")};
+        auto members = params.get<std::string>("members", "");
+        return makeReplicatedSource<SplitPDSSource>(iNLanes, iNEvents, params, *fileName, selector, members);
+    }
+    };
+
+  Maker s_maker;
+}
@@ -0,0 +1,71 @@
+#if !defined(SplitPDSSource_h)
+#define SplitPDSSource_h
+
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "SourceBase.h"
+#include "DataProductRetriever.h"
+#include "DelayedProductRetriever.h"
+#include "SplitDeserializer.h"
+#include "pds_reading.h"
+
+namespace cce::tf {
+class SplitPDSDelayedRetriever : public DelayedProductRetriever {
+  void getAsync(DataProductRetriever&, int index, TaskHolder) override {}
+};
+
+//Reads the files written by SplitPDSOutputer
+class SplitPDSSource : public SourceBase {
+public:
+  //iMembers is a comma separated list of 'product.stream' entries, see the README. For a data product
+  // with no entry all its streams are read.
+  SplitPDSSource(std::string const& iName, ProductSelector const& iSelector = ProductSelector(), std::string const& iMembers = "");
+  SplitPDSSource(SplitPDSSource&&) = default;
+  SplitPDSSource(SplitPDSSource const&) = delete;
+  ~SplitPDSSource();
+
+  size_t numberOfDataProducts() const final {return dataProducts_.size();}
+  std::vector<DataProductRetriever>& dataProducts() final { return dataProducts_; }
+  EventIdentifier eventIdentifier() final { return eventID_;}
+  std::optional<long> numberOfEvents() const final { return batchStarts_.back(); }
+
+private:
+  //a data product kept by the selector
+  struct Product {
+    Product(TClass* iClass, bool iNativeEndian, std::size_t iFirstStream):
+      deserializer_{iClass, iNativeEndian}, firstStream_{iFirstStream}, views_(deserializer_.numberOfStreams()) {}
+    SplitDeserializer deserializer_;
+    //index of its first stream among the streams of all data products in the file
+    std::size_t firstStream_;
+    //the bytes of the present event in each stream
+    std::vector<BlobView> views_;
+  };
+
+  bool readEvent(long iEventIndex) final; //returns true if an event was read
+  //decompresses only the streams which are read
+  void readBatch(long iBatch);
+
+  std::ifstream file_;
+  pds::Compression compression_;
+  //the position of each batch record in the file
+  std::vector<std::streamoff> batchOffsets_;
+  //the first event of each batch, the last entry is the number of events in the file
+  std::vector<long> batchStarts_;
+  long currentBatch_ = -1;
+  std::vector<EventIdentifier> batchEventIDs_;
+  std::vector<uint32_t> record_;
+  std::size_t nFileStreams_ = 0;
+  std::vector<Product> products_;
+  //the uncompressed streams of the present batch, per kept data product one for each of its streams
+  std::vector<std::vector<pds::ReusableBuffer<char>>> streams_;
+  pds::DecompressionContext decompressionContext_;
+  EventIdentifier eventID_;
+  std::vector<DataProductRetriever> dataProducts_;
+  std::vector<void*> dataBuffers_;
+  SplitPDSDelayedRetriever delayedRetriever_;
+};
+}
+#endif
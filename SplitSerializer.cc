@@ -0,0 +1,68 @@
+#include "SplitSerializer.h"
+#include "NativeEndianBufferFile.h"
+
+#include "TVirtualCollectionProxy.h"
+
+using namespace cce::tf;
+using namespace cce::tf::unrolling;
+
+std::unique_ptr<TBufferFile> cce::tf::makeSplitStreamBuffer(TBuffer::EMode iMode, bool iNativeEndian) {
+  if(iNativeEndian) {
+    return std::make_unique<NativeEndianBufferFile>(iMode);
+  }
+  return std::make_unique<TBufferFile>(iMode);
+}
+
+SplitSerializer::SplitSerializer(TClass* iClass, bool iNativeEndian):
+  offsetAndSequences_{buildWriteActionSequence(*iClass)}
+{
+  auto const nStreams = numberOfSplitStreams(offsetAndSequences_);
+  streams_.reserve(nStreams);
+  for(std::size_t i = 0; i < nStreams; ++i) {
+    streams_.push_back(makeSplitStreamBuffer(TBuffer::kWrite, iNativeEndian));
+  }
+}
+
+void SplitSerializer::serialize(void const* address) {
+  for(auto& s: streams_) {
+    s->Reset();
+  }
+  std::size_t stream = 0;
+  serialize(address, offsetAndSequences_.m_objects, offsetAndSequences_.m_collections, stream);
+}
+
+std::size_t SplitSerializer::size() const {
+  std::size_t size = 0;
+  for(auto const& s: streams_) {
+    size += s->Length();
+  }
+  return size;
+}
+
+void SplitSerializer::serialize(void const* address, OffsetAndSequences& offsetAndSequences, SequencesForCollections& seq4Collections,
+                                std::size_t& ioStream) {
+  for(auto& offAndSeq: offsetAndSequences) {
+    streams_[ioStream++]->ApplySequence(*(offAndSeq.second), const_cast<char*>(static_cast<char const*>(address)+offAndSeq.first));
+  }
+
+  for(auto& coll: seq4Collections) {
+    auto collAddress = static_cast<char const*>(address) + coll.m_offset;
+    auto const sizeStream = ioStream;
+    //the streams after the collection do not depend on its size
+    ioStream += numberOfSplitStreams(coll);
+
+    TVirtualCollectionProxy::TPushPop helper(coll.m_collProxy.get(), const_cast<char*>(collAddress));
+    Int_t size = coll.m_collProxy->Size();
+    *streams_[sizeStream] << size;
+
+    if(coll.m_builtinType != kNoType_t) {
+      writeBuiltins(*streams_[sizeStream+1], coll.m_builtinType, size ? (*coll.m_collProxy)[0] : nullptr, size);
+      continue;
+    }
+    for(Int_t item=0; item<size; ++item) {
+      //each element appends to the same streams
+      std::size_t elementStream = sizeStream+1;
+      serialize((*coll.m_collProxy)[item], coll.m_offsetAndSequences, coll.m_collections, elementStream);
+    }
+  }
+}
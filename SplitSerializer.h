@@ -0,0 +1,48 @@
+#if !defined(SplitSerializer_h)
+#define SplitSerializer_h
+
+#include <memory>
+#include <vector>
+#include "TBufferFile.h"
+#include "TClass.h"
+#include "common_unrolling.h"
+#include "BlobView.h"
+
+namespace cce::tf {
+  //a NativeEndianBufferFile if iNativeEndian, else a TBufferFile
+  std::unique_ptr<TBufferFile> makeSplitStreamBuffer(TBuffer::EMode, bool iNativeEndian);
+
+  /**
+     Serializes an object the same way as UnrolledSerializer but each action
+     sequence writes to its own stream, so the values of one member for all
+     the elements of a collection are next to each other. A collection writes
+     its sizes to a stream of their own. The streams are numbered depth first
+     in the order of the sequences, see unrolling::numberOfSplitStreams.
+   */
+  class SplitSerializer {
+  public:
+    SplitSerializer(TClass*, bool iNativeEndian);
+
+    SplitSerializer(SplitSerializer&&) = default;
+    SplitSerializer(SplitSerializer const&) = delete;
+
+    std::size_t numberOfStreams() const { return streams_.size(); }
+
+    //replaces what the streams hold by the object
+    void serialize(void const* address);
+
+    //valid until the next call to serialize
+    BlobView stream(std::size_t iIndex) const { return BlobView(streams_[iIndex]->Buffer(), streams_[iIndex]->Length()); }
+    //summed over all streams
+    std::size_t size() const;
+
+  private:
+    void serialize(void const* address, unrolling::OffsetAndSequences& offsetAndSequences, unrolling::SequencesForCollections& seq4Collections,
+                   std::size_t& ioStream);
+
+    unrolling::ObjectAndCollectionsSequences offsetAndSequences_;
+    //a pointer keeps the serializer movable
+    std::vector<std::unique_ptr<TBufferFile>> streams_;
+  };
+}
+#endif
@@ -0,0 +1,102 @@
+#include "StorageEmulator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "RunReport.h"
+#include "configKeyValuePairs.h"
+
+namespace cce::tf {
+  namespace {
+    std::unique_ptr<StorageEmulator> s_emulator;
+  }
+
+  void StorageEmulator::request(std::size_t iBytes) {
+    auto const start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point done;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if(config_.maxConcurrent_ != 0 and inFlight_ == config_.maxConcurrent_) {
+        ++nWaitedForSlot_;
+        slotFreed_.wait(lock, [this]() { return inFlight_ < config_.maxConcurrent_; });
+        slotWait_us_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+      }
+      ++inFlight_;
+      //the bytes are sent once the request reached the server and the link is done with earlier requests
+      done = std::chrono::steady_clock::now() + config_.latency_;
+      if(config_.bandwidth_ > 0) {
+        auto const transfer = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(iBytes/config_.bandwidth_));
+        linkFree_ = std::max(done, linkFree_) + transfer;
+        done = linkFree_;
+      }
+    }
+    std::this_thread::sleep_until(done);
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      --inFlight_;
+    }
+    slotFreed_.notify_one();
+
+    ++nRequests_;
+    bytes_ += iBytes;
+    delay_us_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  void StorageEmulator::printSummary() const {
+    std::cout <<"Storage emulation latency: "<<config_.latency_.count()<<"us bandwidth: "<<config_.bandwidth_/1.e6<<"MB/s"
+              <<" concurrency: "<<config_.maxConcurrent_<<"\n"
+              <<"  requests: "<<nRequests()<<" bytes: "<<bytes()<<" delay time: "<<delayTime().count()<<"us\n"
+              <<"  requests waiting for a slot: "<<nWaitedForSlot()<<" wait time: "<<slotWaitTime().count()<<"us\n";
+  }
+
+  void StorageEmulator::fillReport(RunReport& oReport) const {
+    oReport.set("latency_us", config_.latency_.count());
+    oReport.set("bandwidth_Bps", config_.bandwidth_);
+    oReport.set("concurrency", config_.maxConcurrent_);
+    oReport.set("requests", nRequests());
+    oReport.set("bytes", bytes());
+    oReport.set("delayTime_us", delayTime().count());
+    oReport.set("waitedForSlot", nWaitedForSlot());
+    oReport.set("slotWaitTime_us", slotWaitTime().count());
+  }
+
+  std::optional<StorageEmulator::Config> parseStorageEmulatorConfig(std::string_view iConfig) {
+    StorageEmulator::Config config;
+    for(auto const& [key, value]: configKeyValuePairs(iConfig)) {
+      try {
+        std::size_t used = 0;
+        if(key == "latency_us") {
+          config.latency_ = std::chrono::microseconds(std::stoul(value, &used));
+        } else if(key == "bandwidth_MBps") {
+          config.bandwidth_ = std::stod(value, &used)*1.e6;
+          if(config.bandwidth_ < 0) {
+            throw std::invalid_argument(value);
+          }
+        } else if(key == "concurrency") {
+          config.maxConcurrent_ = std::stoul(value, &used);
+        } else {
+          std::cout <<"Unknown storage emulation parameter '"<<key<<"', allowed are latency_us, bandwidth_MBps and concurrency"<<std::endl;
+          return {};
+        }
+        if(used != value.size()) {
+          throw std::invalid_argument(value);
+        }
+      } catch(std::logic_error const&) {
+        std::cout <<"storage emulation parameter "<<key<<" has the invalid value '"<<value<<"'"<<std::endl;
+        return {};
+      }
+    }
+    return config;
+  }
+
+  StorageEmulator* storageEmulator() {
+    return s_emulator.get();
+  }
+
+  void setStorageEmulator(std::unique_ptr<StorageEmulator> iEmulator) {
+    s_emulator = std::move(iEmulator);
+  }
+}
@@ -0,0 +1,84 @@
+#if !defined(StorageEmulator_h)
+#define StorageEmulator_h
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+
+namespace cce::tf {
+  class RunReport;
+
+  /**
+     Makes local I/O behave like remote storage. Each request first waits for
+     one of the maxConcurrent_ slots, then for the latency_ and then for its
+     bytes to pass through a link of bandwidth_ bytes per second which all
+     requests share. Requests of different threads overlap their latencies the
+     way they would against a remote server.
+
+     The readers and writers call emulateStorageRequest before each request
+     they make to the file system, which blocks the calling thread.
+   */
+  class StorageEmulator {
+  public:
+    struct Config {
+      std::chrono::microseconds latency_{0};
+      //bytes per second, 0 means no limit
+      double bandwidth_ = 0;
+      //most requests being served at one time, 0 means no limit
+      unsigned int maxConcurrent_ = 0;
+    };
+    explicit StorageEmulator(Config const& iConfig): config_{iConfig} {}
+
+    StorageEmulator(StorageEmulator const&) = delete;
+    StorageEmulator& operator=(StorageEmulator const&) = delete;
+
+    //returns once a request for iBytes would have been served
+    void request(std::size_t iBytes);
+
+    Config const& config() const { return config_; }
+    unsigned long long nRequests() const { return nRequests_.load(); }
+    unsigned long long bytes() const { return bytes_.load(); }
+    //summed time the requests were held
+    std::chrono::microseconds delayTime() const { return std::chrono::microseconds(delay_us_.load()); }
+    //number of requests which had to wait for a slot and the summed time they waited
+    unsigned long long nWaitedForSlot() const { return nWaitedForSlot_.load(); }
+    std::chrono::microseconds slotWaitTime() const { return std::chrono::microseconds(slotWait_us_.load()); }
+
+    void printSummary() const;
+    void fillReport(RunReport&) const;
+
+  private:
+    Config const config_;
+
+    std::mutex mutex_;
+    std::condition_variable slotFreed_;
+    unsigned int inFlight_ = 0;
+    //when the shared link has sent all the bytes asked for so far
+    std::chrono::steady_clock::time_point linkFree_;
+
+    std::atomic<unsigned long long> nRequests_{0};
+    std::atomic<unsigned long long> bytes_{0};
+    std::atomic<unsigned long long> delay_us_{0};
+    std::atomic<unsigned long long> nWaitedForSlot_{0};
+    std::atomic<unsigned long long> slotWait_us_{0};
+  };
+
+  //parses e.g. 'latency_us=2000:bandwidth_MBps=100:concurrency=8'. Prints the problem and returns nothing if not valid.
+  std::optional<StorageEmulator::Config> parseStorageEmulatorConfig(std::string_view iConfig);
+
+  //the emulator used by all readers and writers, nullptr unless one was set
+  StorageEmulator* storageEmulator();
+  void setStorageEmulator(std::unique_ptr<StorageEmulator>);
+
+  inline void emulateStorageRequest(std::size_t iBytes) {
+    if(auto emulator = storageEmulator()) {
+      emulator->request(iBytes);
+    }
+  }
+}
+#endif
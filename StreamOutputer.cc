@@ -0,0 +1,196 @@
+#include "StreamOutputer.h"
+#include "OutputerFactory.h"
+#include "ConfigurationParameters.h"
+#include "UnrolledSerializerWrapper.h"
+#include "FixedLayoutSerializerWrapper.h"
+#include "SerializerWrapper.h"
+#include "summarize_serializers.h"
+#include "PerfCounters.h"
+#include <iostream>
+
+using namespace cce::tf;
+using namespace cce::tf::pds;
+
+StreamOutputer::StreamOutputer(std::string iAddress, unsigned int iNLanes, pds::Compression iCompression, int iCompressionLevel,
+                               pds::Serialization iSerialization, unsigned int iNConnections, std::size_t iBatchBytes,
+                               std::chrono::milliseconds iTimeout):
+  address_{std::move(iAddress)},
+  nConnections_{iNConnections},
+  batchBytes_{iBatchBytes},
+  timeout_{iTimeout},
+  connections_{std::size_t(iNConnections)},
+  serializers_{std::size_t(iNLanes)},
+  compressionContexts_{std::size_t(iNLanes)},
+  laneBuffers_{std::size_t(iNLanes)},
+  compression_{iCompression},
+  compressionLevel_{iCompressionLevel},
+  serialization_{iSerialization},
+  parallelTime_{iNLanes}
+{}
+
+StreamOutputer::~StreamOutputer() {
+  try {
+    finish();
+  } catch(std::exception const& iE) {
+    std::cout <<"StreamOutputer "<<iE.what()<<std::endl;
+  }
+}
+
+void StreamOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) {
+  auto& s = serializers_[iLaneIndex];
+  switch(serialization_) {
+  case Serialization::kRoot:
+    {   s = SerializeStrategy::make<SerializeProxy<SerializerWrapper>>(); break; }
+  case Serialization::kRootUnrolled:
+    {   s = SerializeStrategy::make<SerializeProxy<UnrolledSerializerWrapper>>(); break; }
+  case Serialization::kNativeUnrolled:
+    {   s = SerializeStrategy::make<SerializeProxy<NativeUnrolledSerializerWrapper>>(); break; }
+  case Serialization::kFixedLayout:
+    {   s = SerializeStrategy::make<SerializeProxy<FixedLayoutSerializerWrapper>>(); break; }
+  }
+  s.reserve(iDPs.size());
+  for(auto const& dp: iDPs) {
+    s.emplace_back(dp.name(), dp.classType());
+  }
+  if(iLaneIndex == 0) {
+    std::vector<std::pair<std::string, std::string>> products;
+    products.reserve(s.size());
+    for(auto const& w: s) {
+      products.emplace_back(w.name(), w.className());
+    }
+    //each stream starts with the header, as a PDS file does
+    auto header = pds::fileHeader(serialization_, compression_, products);
+    for(auto& c: connections_) {
+      c.socket_.emplace(StreamSocket::connect(address_, timeout_));
+      c.batch_ = header;
+    }
+  }
+}
+
+void StreamOutputer::productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const {
+  auto& laneSerializers = serializers_[iLaneIndex];
+  serializeOrPassThroughAsync(laneSerializers[iDataProduct.index()], iDataProduct, serialization_, std::move(iCallback), 0);
+}
+
+void StreamOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+  auto start = std::chrono::high_resolution_clock::now();
+  serializeDeferred(serializers_[iLaneIndex]);
+  auto& buffers = laneBuffers_[iLaneIndex];
+  pds::uncompressedEventBuffer(serializers_[iLaneIndex], buffers.uncompressed_);
+  {
+    PerfScope perf(PerfCounters::kCompress);
+    pds::eventRecord(iEventID, buffers.uncompressed_, compression_, compressionLevel_, compressionContexts_[iLaneIndex], buffers.record_);
+  }
+  auto& connection = connections_[iLaneIndex % nConnections_];
+  //the Lane waits for its record to be added to the batch so its buffers are not touched until then
+  connection.queue_.push(*iCallback.group(), [this, iLaneIndex, &connection, callback=std::move(iCallback)]() {
+      auto const& record = laneBuffers_[iLaneIndex].record_;
+      connection.batch_.insert(connection.batch_.end(), record.begin(), record.end());
+      ++connection.nEvents_;
+      if(connection.batch_.size()*4 >= batchBytes_) {
+        sendBatch(connection);
+      }
+    });
+  auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+  parallelTime_.add(iLaneIndex, time.count());
+}
+
+void StreamOutputer::sendBatch(Connection& iConnection) const {
+  if(iConnection.batch_.empty()) {
+    return;
+  }
+  auto start = std::chrono::high_resolution_clock::now();
+  iConnection.socket_->sendAll(iConnection.batch_.data(), iConnection.batch_.size()*4);
+  iConnection.sendTime_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+  iConnection.bytesSent_ += iConnection.batch_.size()*4;
+  ++iConnection.nSends_;
+  iConnection.batch_.clear();
+}
+
+void StreamOutputer::finish() const {
+  if(finished_) {
+    return;
+  }
+  finished_ = true;
+  //all Lanes are done so the queues are idle
+  for(auto& c: connections_) {
+    if(c.socket_) {
+      sendBatch(c);
+      c.socket_->shutdownSend();
+    }
+  }
+}
+
+void StreamOutputer::printSummary() const {
+  finish();
+  std::cout <<"StreamOutputer\n  total parallel time at end event: "<<parallelTime_.sum()<<"us\n";
+  for(std::size_t i = 0; i < connections_.size(); ++i) {
+    auto const& c = connections_[i];
+    std::cout <<"  connection "<<i<<": events "<<c.nEvents_<<" bytes "<<c.bytesSent_<<" sends "<<c.nSends_
+              <<" send time "<<c.sendTime_.count()<<"us\n";
+  }
+  summarize_serializers(serializers_);
+}
+
+void StreamOutputer::fillProfile(ProductProfile& oProfile) const {
+  profile_serializers(oProfile, serializers_);
+}
+
+void StreamOutputer::fillReport(RunReport& oReport) const {
+  oReport.set("parallelTime_us", parallelTime_.sum());
+  unsigned long long bytesSent = 0;
+  unsigned long long nSends = 0;
+  std::chrono::microseconds sendTime{0};
+  for(auto const& c: connections_) {
+    bytesSent += c.bytesSent_;
+    nSends += c.nSends_;
+    sendTime += c.sendTime_;
+  }
+  oReport.set("connections", nConnections_);
+  oReport.set("bytesSent", bytesSent);
+  oReport.set("sends", nSends);
+  oReport.set("sendTime_us", sendTime.count());
+  report_serializers(oReport, serializers_);
+}
+
+namespace {
+  class Maker : public OutputerMakerBase {
+  public:
+    Maker(): OutputerMakerBase("StreamOutputer") {}
+
+    std::unique_ptr<OutputerBase> create(unsigned int iNLanes, ConfigurationParameters const& params) const final {
+      //a ':' separates the parameters so the port and host are given separately
+      auto port = params.get<std::string>("fileName");
+      if(not port) {
+        std::cout <<"no port given for StreamOutputer\n";
+        return {};
+      }
+      auto host = params.get<std::string>("host", "localhost");
+      int compressionLevel = params.get<int>("compressionLevel", 18);
+      auto compressionName = params.get<std::string>("compressionAlgorithm", "ZSTD");
+      auto serializationName = params.get<std::string>("serializationAlgorithm", "ROOT");
+
+      auto compression = pds::toCompression(compressionName);
+      if(not compression) {
+        std::cout <<"unknown compression "<<compressionName<<std::endl;
+        return {};
+      }
+      auto serialization = pds::toSerialization(serializationName);
+      if(not serialization) {
+        std::cout <<"unknown serialization "<<serializationName<<std::endl;
+        return {};
+      }
+      auto nConnections = params.get<unsigned int>("connections", 1);
+      if(nConnections == 0 or nConnections > iNLanes) {
+        std::cout <<"StreamOutputer connections must be between 1 and the number of Lanes"<<std::endl;
+        return {};
+      }
+      auto batchBytes = params.get<std::size_t>("batchBytes", 1024*1024);
+      auto timeout = params.get<unsigned int>("timeout", 60);
+      return std::make_unique<StreamOutputer>(host+":"+*port, iNLanes, *compression, compressionLevel, *serialization,
+                                              nConnections, batchBytes, std::chrono::seconds(timeout));
+    }
+  };
+
+  Maker s_maker;
+}
@@ -0,0 +1,91 @@
+#if !defined(StreamOutputer_h)
+#define StreamOutputer_h
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <chrono>
+#include <optional>
+
+#include "OutputerBase.h"
+#include "EventIdentifier.h"
+#include "SerializeStrategy.h"
+#include "DataProductRetriever.h"
+#include "pds_common.h"
+#include "pds_writer.h"
+#include "StreamSocket.h"
+
+#include "SerialTaskQueue.h"
+#include "PerLaneCounter.h"
+
+namespace cce::tf {
+  /**
+     Sends each event as a compressed PDS event record over TCP to a
+     StreamSource, possibly on another node. Each connection of the pool
+     carries the PDS file header followed by the event records so what is
+     received on one connection is a valid PDS file. Lane i sends through
+     connection i modulo the number of connections, each connection has its
+     own serialized queue in which records are gathered into batches before
+     being sent. A send blocks once the receiver's TCP window is full which
+     holds the Lanes waiting on that queue, so a slow receiver slows the job
+     down rather than letting unsent events pile up.
+   */
+class StreamOutputer :public OutputerBase {
+ public:
+  StreamOutputer(std::string iAddress, unsigned int iNLanes, pds::Compression iCompression, int iCompressionLevel,
+                 pds::Serialization iSerialization, unsigned int iNConnections, std::size_t iBatchBytes,
+                 std::chrono::milliseconds iTimeout);
+  ~StreamOutputer();
+
+  void setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) final;
+
+  void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const final;
+  bool usesProductReadyAsync() const final {return true;}
+
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+
+  void printSummary() const final;
+  void fillReport(RunReport&) const final;
+  void fillProfile(ProductProfile&) const final;
+
+ private:
+  struct Connection {
+    std::optional<StreamSocket> socket_;
+    SerialTaskQueue queue_;
+    //records not yet sent
+    std::vector<uint32_t> batch_;
+    unsigned long long nEvents_ = 0;
+    unsigned long long bytesSent_ = 0;
+    unsigned long long nSends_ = 0;
+    //time spent in send, which includes waiting for the receiver
+    std::chrono::microseconds sendTime_{0};
+  };
+
+  //called from the queue of the connection
+  void sendBatch(Connection&) const;
+  //sends what is left in the batches and ends the streams
+  void finish() const;
+
+  std::string address_;
+  unsigned int nConnections_;
+  std::size_t batchBytes_;
+  std::chrono::milliseconds timeout_;
+  mutable bool finished_ = false;
+
+  mutable std::vector<Connection> connections_;
+  mutable std::vector<SerializeStrategy> serializers_;
+  //one per lane so the compression state does not need to be remade for each event
+  mutable std::vector<pds::CompressionContext> compressionContexts_;
+  //the buffers of a Lane are reused from one event to the next
+  struct LaneBuffers {
+    std::vector<uint32_t> uncompressed_;
+    std::vector<uint32_t> record_;
+  };
+  mutable std::vector<LaneBuffers> laneBuffers_;
+  pds::Compression compression_;
+  int compressionLevel_;
+  pds::Serialization serialization_;
+  mutable PerLaneCounter<std::chrono::microseconds::rep> parallelTime_;
+};
+}
+#endif
@@ -0,0 +1,234 @@
+#include "StreamSocket.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+using namespace cce::tf;
+
+namespace {
+  std::pair<std::string, std::string> splitAddress(std::string const& iAddress) {
+    auto colon = iAddress.rfind(':');
+    if(colon == std::string::npos) {
+      return {std::string(), iAddress};
+    }
+    return {iAddress.substr(0, colon), iAddress.substr(colon+1)};
+  }
+
+  struct AddrInfoDeleter {
+    void operator()(addrinfo* iInfo) const { ::freeaddrinfo(iInfo); }
+  };
+
+  std::unique_ptr<addrinfo, AddrInfoDeleter> resolve(std::string const& iAddress, bool iPassive) {
+    auto [host, port] = splitAddress(iAddress);
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = iPassive ? AI_PASSIVE : 0;
+    addrinfo* info = nullptr;
+    int error = ::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &info);
+    if(error != 0) {
+      throw std::runtime_error("StreamSocket unable to resolve "+iAddress+": "+::gai_strerror(error));
+    }
+    return std::unique_ptr<addrinfo, AddrInfoDeleter>(info);
+  }
+
+  std::string errorMessage(std::string const& iWhat) {
+    return "StreamSocket "+iWhat+": "+std::strerror(errno);
+  }
+}
+
+StreamSocket StreamSocket::connect(std::string const& iAddress, std::chrono::milliseconds iTimeout) {
+  auto const deadline = std::chrono::steady_clock::now() + iTimeout;
+  while(true) {
+    auto info = resolve(iAddress, false);
+    for(auto i = info.get(); i != nullptr; i = i->ai_next) {
+      int fd = ::socket(i->ai_family, i->ai_socktype, i->ai_protocol);
+      if(fd < 0) {
+        continue;
+      }
+      if(0 == ::connect(fd, i->ai_addr, i->ai_addrlen)) {
+        //the senders batch the records themselves
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return StreamSocket(fd);
+      }
+      ::close(fd);
+    }
+    if(std::chrono::steady_clock::now() > deadline) {
+      throw std::runtime_error("StreamSocket unable to connect to "+iAddress+" within "+std::to_string(iTimeout.count())+"ms");
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+}
+
+StreamSocket StreamSocket::listen(std::string const& iAddress, int iBacklog) {
+  auto info = resolve(iAddress, true);
+  for(auto i = info.get(); i != nullptr; i = i->ai_next) {
+    int fd = ::socket(i->ai_family, i->ai_socktype, i->ai_protocol);
+    if(fd < 0) {
+      continue;
+    }
+    //a port left in TIME_WAIT by an earlier job can be reused at once
+    int one = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if(0 == ::bind(fd, i->ai_addr, i->ai_addrlen) and 0 == ::listen(fd, iBacklog)) {
+      return StreamSocket(fd);
+    }
+    ::close(fd);
+  }
+  throw std::runtime_error(errorMessage("unable to listen on "+iAddress));
+}
+
+StreamSocket::StreamSocket(StreamSocket&& iOther): fd_{iOther.fd_} {
+  iOther.fd_ = -1;
+}
+
+StreamSocket& StreamSocket::operator=(StreamSocket&& iOther) {
+  std::swap(fd_, iOther.fd_);
+  return *this;
+}
+
+StreamSocket::~StreamSocket() {
+  if(fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+StreamSocket StreamSocket::accept(std::chrono::milliseconds iTimeout) const {
+  if(-1 == waitForReadable({fd_}, 0, iTimeout)) {
+    throw std::runtime_error("StreamSocket no connection within "+std::to_string(iTimeout.count())+"ms");
+  }
+  int fd = ::accept(fd_, nullptr, nullptr);
+  if(fd < 0) {
+    throw std::runtime_error(errorMessage("unable to accept a connection"));
+  }
+  return StreamSocket(fd);
+}
+
+unsigned short StreamSocket::port() const {
+  sockaddr_storage address;
+  socklen_t size = sizeof(address);
+  if(0 != ::getsockname(fd_, reinterpret_cast<sockaddr*>(&address), &size)) {
+    throw std::runtime_error(errorMessage("unable to get the local address"));
+  }
+  if(address.ss_family == AF_INET6) {
+    return ntohs(reinterpret_cast<sockaddr_in6*>(&address)->sin6_port);
+  }
+  return ntohs(reinterpret_cast<sockaddr_in*>(&address)->sin_port);
+}
+
+void StreamSocket::sendAll(void const* iData, std::size_t iSize) {
+  auto data = static_cast<char const*>(iData);
+  while(iSize != 0) {
+    //a receiver which went away is reported as an error rather than a SIGPIPE
+    auto sent = ::send(fd_, data, iSize, MSG_NOSIGNAL);
+    if(sent < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error(errorMessage("send failed"));
+    }
+    data += sent;
+    iSize -= sent;
+  }
+}
+
+void StreamSocket::shutdownSend() {
+  ::shutdown(fd_, SHUT_WR);
+}
+
+std::size_t StreamSocket::receive(void* oData, std::size_t iSize) {
+  while(true) {
+    auto received = ::recv(fd_, oData, iSize, 0);
+    if(received >= 0) {
+      return received;
+    }
+    if(errno != EINTR) {
+      throw std::runtime_error(errorMessage("receive failed"));
+    }
+  }
+}
+
+StreamSocketBuf::StreamSocketBuf(StreamSocket& iSocket, std::size_t iBufferSize):
+  socket_{iSocket}, buffer_(iBufferSize) {
+  setg(buffer_.data(), buffer_.data(), buffer_.data());
+}
+
+StreamSocketBuf::int_type StreamSocketBuf::underflow() {
+  if(gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+  auto n = socket_.receive(buffer_.data(), buffer_.size());
+  setg(buffer_.data(), buffer_.data(), buffer_.data()+n);
+  if(n == 0) {
+    return traits_type::eof();
+  }
+  return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize StreamSocketBuf::xsgetn(char_type* oData, std::streamsize iSize) {
+  std::streamsize nRead = 0;
+  while(nRead < iSize) {
+    std::streamsize available = egptr()-gptr();
+    if(available == 0) {
+      if(iSize - nRead >= static_cast<std::streamsize>(buffer_.size())) {
+        //large event records skip the copy through the buffer
+        auto n = socket_.receive(oData+nRead, iSize-nRead);
+        if(n == 0) {
+          break;
+        }
+        nRead += n;
+        continue;
+      }
+      if(traits_type::eq_int_type(underflow(), traits_type::eof())) {
+        break;
+      }
+      available = egptr()-gptr();
+    }
+    auto n = std::min(available, iSize-nRead);
+    std::memcpy(oData+nRead, gptr(), n);
+    gbump(n);
+    nRead += n;
+  }
+  return nRead;
+}
+
+int cce::tf::waitForReadable(std::vector<int> const& iFDs, std::size_t iFirst, std::chrono::milliseconds iTimeout) {
+  std::vector<pollfd> polls;
+  polls.reserve(iFDs.size());
+  for(auto fd: iFDs) {
+    polls.push_back({fd, POLLIN, 0});
+  }
+  while(true) {
+    int n = ::poll(polls.data(), polls.size(), iTimeout.count());
+    if(n < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error(errorMessage("poll failed"));
+    }
+    if(n == 0) {
+      return -1;
+    }
+    break;
+  }
+  for(std::size_t i = 0; i < polls.size(); ++i) {
+    auto index = (iFirst+i) % polls.size();
+    if(polls[index].fd >= 0 and (polls[index].revents & (POLLIN | POLLHUP | POLLERR))) {
+      return index;
+    }
+  }
+  return -1;
+}
@@ -0,0 +1,67 @@
+#if !defined(StreamSocket_h)
+#define StreamSocket_h
+
+#include <chrono>
+#include <cstddef>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace cce::tf {
+  /**
+     A TCP socket. Addresses are given as `host:port` or just `port`, in which
+     case the host is the local host when connecting and any interface when
+     listening. All calls block and throw std::runtime_error on failure.
+   */
+  class StreamSocket {
+  public:
+    //retries until iTimeout passed so the receiver may be started after the sender
+    static StreamSocket connect(std::string const& iAddress, std::chrono::milliseconds iTimeout);
+    //port 0 picks a free port, see port()
+    static StreamSocket listen(std::string const& iAddress, int iBacklog);
+
+    StreamSocket(StreamSocket&&);
+    StreamSocket(StreamSocket const&) = delete;
+    StreamSocket& operator=(StreamSocket&&);
+    StreamSocket& operator=(StreamSocket const&) = delete;
+    ~StreamSocket();
+
+    //for a listening socket, waits up to iTimeout for the next connection
+    StreamSocket accept(std::chrono::milliseconds iTimeout) const;
+    //the local port
+    unsigned short port() const;
+
+    //returns once all bytes were handed to the kernel, so blocks while the receiver's window is full
+    void sendAll(void const* iData, std::size_t iSize);
+    //the receiver sees the end of the stream once it read all bytes sent
+    void shutdownSend();
+    //returns the number of bytes read, 0 at the end of the stream
+    std::size_t receive(void* oData, std::size_t iSize);
+
+    int fd() const { return fd_; }
+
+  private:
+    explicit StreamSocket(int iFD): fd_{iFD} {}
+    int fd_;
+  };
+
+  //Lets the std::istream based readers read from a StreamSocket
+  class StreamSocketBuf : public std::streambuf {
+  public:
+    StreamSocketBuf(StreamSocket& iSocket, std::size_t iBufferSize);
+
+  protected:
+    int_type underflow() final;
+    std::streamsize xsgetn(char_type* oData, std::streamsize iSize) final;
+
+  private:
+    StreamSocket& socket_;
+    std::vector<char> buffer_;
+  };
+
+  //waits up to iTimeout for one of the sockets to have bytes to read, or to be at the end
+  // of its stream, and returns its index, starting the search at iFirst. Negative file
+  // descriptors in iFDs are skipped. Returns -1 after the timeout.
+  int waitForReadable(std::vector<int> const& iFDs, std::size_t iFirst, std::chrono::milliseconds iTimeout);
+}
+#endif
@@ -0,0 +1,275 @@
+#include "StreamSource.h"
+#include "SourceFactory.h"
+#include "Deserializer.h"
+#include "UnrolledDeserializer.h"
+#include "FixedLayoutDeserializer.h"
+#include "Tracer.h"
+#include "PerfCounters.h"
+
+#include "TClass.h"
+
+#include <stdexcept>
+#include <cassert>
+
+using namespace cce::tf;
+
+StreamSource::Connection::Connection(StreamSocket iSocket):
+  socket_{std::move(iSocket)},
+  buffer_{socket_, 64*1024},
+  stream_{&buffer_} {}
+
+StreamSource::StreamSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iAddress, unsigned int iNConnections,
+                           std::chrono::milliseconds iTimeout, ProductSelector const& iSelector) :
+  SharedSourceBase(iNEvents),
+  timeout_{iTimeout},
+  readTime_{std::chrono::microseconds::zero()},
+  waitTime_{std::chrono::microseconds::zero()}
+{
+  pds::Serialization serialization;
+  std::vector<pds::ProductInfo> productInfo;
+  {
+    auto listener = StreamSocket::listen(iAddress, iNConnections);
+    connections_.reserve(iNConnections);
+    for(unsigned int i = 0; i < iNConnections; ++i) {
+      connections_.push_back(std::make_unique<Connection>(listener.accept(iTimeout)));
+    }
+    //every stream starts with the same header
+    pds::FileOptions options;
+    productInfo = readFileHeader(connections_[0]->stream_, compression_, serialization, options);
+    for(unsigned int i = 1; i < iNConnections; ++i) {
+      pds::Compression compression;
+      pds::Serialization otherSerialization;
+      pds::FileOptions otherOptions;
+      auto info = readFileHeader(connections_[i]->stream_, compression, otherSerialization, otherOptions);
+      if(info.size() != productInfo.size() or compression != compression_ or otherSerialization != serialization) {
+        throw std::runtime_error("StreamSource connection "+std::to_string(i)+" does not have the same header as the first connection");
+      }
+    }
+    if(not options.dictionary_.empty()) {
+      dictionary_ = std::make_unique<pds::DecompressionDictionary>(options.dictionary_);
+    }
+    perProductCompression_ = options.perProductCompression_;
+    checksum_ = options.checksum_;
+    shuffle_ = std::move(options.shuffle_);
+    productMap_ = pds::selectProducts(productInfo, iSelector);
+  }
+
+  laneInfos_.reserve(iNLanes);
+  for(unsigned int i = 0; i< iNLanes; ++i) {
+    DeserializeStrategy strategy;
+    switch(serialization) {
+    case pds::Serialization::kRoot: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<Deserializer>>(); break;
+    }
+    case pds::Serialization::kRootUnrolled: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<UnrolledDeserializer>>(); break;
+    }
+    case pds::Serialization::kNativeUnrolled: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<NativeUnrolledDeserializer>>(); break;
+    }
+    case pds::Serialization::kFixedLayout: {
+      strategy = DeserializeStrategy::make<DeserializeProxy<FixedLayoutDeserializer>>(); break;
+    }
+    }
+    laneInfos_.emplace_back(productInfo, std::move(strategy));
+    laneInfos_.back().decompressionContext_.setDictionary(dictionary_.get());
+    laneInfos_.back().decompressionContext_.setShuffle(shuffle_);
+  }
+}
+
+StreamSource::LaneInfo::LaneInfo(std::vector<pds::ProductInfo> const& productInfo, DeserializeStrategy deserialize):
+  deserializers_{std::move(deserialize)},
+  decompressTime_{std::chrono::microseconds::zero()},
+  deserializeTime_{std::chrono::microseconds::zero()}
+{
+  dataProducts_.reserve(productInfo.size());
+  dataBuffers_.resize(productInfo.size(), nullptr);
+  deserializers_.reserve(productInfo.size());
+  size_t index =0;
+  for(auto const& pi : productInfo) {
+
+    TClass* cls = TClass::GetClass(pi.className().c_str());
+    assert(cls);
+    dataBuffers_[index] = cls->New();
+    dataProducts_.emplace_back(index,
+                               &dataBuffers_[index],
+                               pi.name(),
+                               cls,
+                               &delayedRetriever_);
+    deserializers_.emplace_back(cls);
+    ++index;
+  }
+}
+
+StreamSource::LaneInfo::~LaneInfo() {
+  auto it = dataProducts_.begin();
+  for( void * b: dataBuffers_) {
+    it->classType()->Destructor(b);
+    ++it;
+  }
+}
+
+size_t StreamSource::numberOfDataProducts() const {
+  return laneInfos_[0].dataProducts_.size();
+}
+
+std::vector<DataProductRetriever>& StreamSource::dataProducts(unsigned int iLane, long iEventIndex) {
+  return laneInfos_[iLane].dataProducts_;
+}
+
+EventIdentifier StreamSource::eventIdentifier(unsigned int iLane, long iEventIndex) {
+  return laneInfos_[iLane].eventID_;
+}
+
+bool StreamSource::readNextRecord(EventIdentifier& oEventID, std::vector<uint32_t>& oBuffer) {
+  auto const nConnections = connections_.size();
+  while(true) {
+    //bytes already received are used first as poll does not know about them
+    int index = -1;
+    for(std::size_t i = 0; i < nConnections; ++i) {
+      auto const& c = *connections_[(nextConnection_+i) % nConnections];
+      if(not c.ended_ and c.stream_.rdbuf()->in_avail() > 0) {
+        index = (nextConnection_+i) % nConnections;
+        break;
+      }
+    }
+    if(index == -1) {
+      std::vector<int> fds;
+      fds.reserve(nConnections);
+      bool anyOpen = false;
+      for(auto const& c: connections_) {
+        fds.push_back(c->ended_ ? -1 : c->socket_.fd());
+        anyOpen = anyOpen or not c->ended_;
+      }
+      if(not anyOpen) {
+        return false;
+      }
+      auto start = std::chrono::high_resolution_clock::now();
+      index = waitForReadable(fds, nextConnection_, timeout_);
+      waitTime_ += std::chrono::duration_cast<decltype(waitTime_)>(std::chrono::high_resolution_clock::now() - start);
+      if(index == -1) {
+        throw std::runtime_error("StreamSource received no event within "+std::to_string(timeout_.count())+"ms");
+      }
+    }
+    nextConnection_ = (index+1) % nConnections;
+    auto& c = *connections_[index];
+    if(pds::readCompressedEventBuffer(c.stream_, oEventID, oBuffer)) {
+      ++c.nEvents_;
+      return true;
+    }
+    c.ended_ = true;
+  }
+}
+
+void StreamSource::readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder iTask) {
+  queue_.push(*iTask.group(), [iLane, optTask = std::move(iTask), this]() mutable {
+      TraceScope scope("read", "source");
+      PerfScope perf(PerfCounters::kRead);
+      auto start = std::chrono::high_resolution_clock::now();
+      auto& laneInfo = laneInfos_[iLane];
+      //the Lane is done with the previous event so its buffer can be reused
+      if(readNextRecord(laneInfo.eventID_, laneInfo.compressedBuffer_)) {
+        //last entry in buffer is just a crosscheck on its size
+        laneInfo.compressedBuffer_.pop_back();
+        auto group = optTask.group();
+        group->run([this, task = optTask.releaseToTaskHolder(), iLane]() {
+            decompressAndDeserialize(iLane);
+          });
+      }
+      readTime_ +=std::chrono::duration_cast<decltype(readTime_)>(std::chrono::high_resolution_clock::now() - start);
+    });
+}
+
+void StreamSource::decompressAndDeserialize(unsigned int iLane) {
+  auto& laneInfo = laneInfos_[iLane];
+  auto const& buffer = laneInfo.compressedBuffer_;
+  auto bufferBegin = buffer.data();
+  auto bufferEnd = buffer.data()+buffer.size();
+  if(checksum_) {
+    pds::checkRecordChecksum(bufferBegin, bufferEnd, laneInfo.eventID_);
+    --bufferEnd;
+  }
+  if(perProductCompression_) {
+    //decompression and deserialization are interleaved so are timed together
+    auto start = std::chrono::high_resolution_clock::now();
+    pds::uncompressAndDeserializeProducts(compression_, bufferBegin, bufferEnd, laneInfo.productBuffer_, laneInfo.decompressionContext_,
+                                          laneInfo.dataProducts_, laneInfo.deserializers_, productMap_);
+    laneInfo.deserializeTime_ +=
+      std::chrono::duration_cast<decltype(laneInfo.deserializeTime_)>(std::chrono::high_resolution_clock::now() - start);
+    return;
+  }
+
+  auto start = std::chrono::high_resolution_clock::now();
+  auto& uBuffer = laneInfo.uncompressedBuffer_;
+  pds::uncompressEventBuffer(compression_, bufferBegin, bufferEnd, uBuffer, laneInfo.decompressionContext_);
+  laneInfo.decompressTime_ +=
+    std::chrono::duration_cast<decltype(laneInfo.decompressTime_)>(std::chrono::high_resolution_clock::now() - start);
+
+  start = std::chrono::high_resolution_clock::now();
+  pds::deserializeDataProducts(uBuffer.begin(), uBuffer.end(), laneInfo.dataProducts_, laneInfo.deserializers_, productMap_);
+  laneInfo.deserializeTime_ +=
+    std::chrono::duration_cast<decltype(laneInfo.deserializeTime_)>(std::chrono::high_resolution_clock::now() - start);
+}
+
+void StreamSource::printSummary() const {
+  std::cout <<"\nSource:\n"
+    "   read time: "<<readTime_.count()<<"us\n"
+    "   wait for data time: "<<waitTime_.count()<<"us\n"
+    "   decompress time: "<<decompressTime().count()<<"us\n"
+    "   deserialize time: "<<deserializeTime().count()<<"us\n";
+  for(std::size_t i = 0; i < connections_.size(); ++i) {
+    std::cout <<"   connection "<<i<<" events: "<<connections_[i]->nEvents_<<"\n";
+  }
+  std::cout<<std::endl;
+};
+
+void StreamSource::fillReport(RunReport& oReport) const {
+  oReport.set("readTime_us", readTime_.count());
+  oReport.set("waitTime_us", waitTime_.count());
+  oReport.set("decompressTime_us", decompressTime().count());
+  oReport.set("deserializeTime_us", deserializeTime().count());
+  oReport.set("connections", connections_.size());
+}
+
+std::chrono::microseconds StreamSource::decompressTime() const {
+  auto time = std::chrono::microseconds::zero();
+  for(auto const& l : laneInfos_) {
+    time += l.decompressTime_;
+  }
+  return time;
+}
+
+std::chrono::microseconds StreamSource::deserializeTime() const {
+  auto time = std::chrono::microseconds::zero();
+  for(auto const& l : laneInfos_) {
+    time += l.deserializeTime_;
+  }
+  return time;
+}
+
+
+namespace {
+    class Maker : public SourceMakerBase {
+  public:
+    Maker(): SourceMakerBase("StreamSource") {}
+      std::unique_ptr<SharedSourceBase> create(unsigned int iNLanes, unsigned long long iNEvents, ConfigurationParameters const& params) const final {
+        auto port = params.get<std::string>("fileName");
+        if(not port) {
+          std::cout <<"no port given to listen on\n";
+          return {};
+        }
+        //by default listens on all interfaces
+        auto host = params.get<std::string>("host", "");
+        auto nConnections = params.get<unsigned int>("connections", 1);
+        if(nConnections == 0) {
+          std::cout <<"StreamSource needs at least one connection\n";
+          return {};
+        }
+        auto timeout = params.get<unsigned int>("timeout", 60);
+        ProductSelector selector{params.get<std::string>("products", "")};
+        return std::make_unique<StreamSource>(iNLanes, iNEvents, host.empty() ? *port : host+":"+*port, nConnections, std::chrono::seconds(timeout), selector);
+    }
+    };
+
+  Maker s_maker;
+}
@@ -0,0 +1,109 @@
+#if !defined(StreamSource_h)
+#define StreamSource_h
+
+#include <string>
+#include <memory>
+#include <chrono>
+#include <istream>
+#include <iostream>
+
+#include "SharedSourceBase.h"
+#include "DataProductRetriever.h"
+#include "DelayedProductRetriever.h"
+#include "DeserializeStrategy.h"
+#include "SerialTaskQueue.h"
+#include "StreamSocket.h"
+#include "pds_reading.h"
+#include "PerLaneCounter.h"
+
+
+namespace cce::tf {
+  class StreamDelayedRetriever : public DelayedProductRetriever {
+    void getAsync(DataProductRetriever&, int index, TaskHolder) final {}
+  };
+
+  /**
+     Receives the events sent by a StreamOutputer over TCP. It listens on the
+     given address and accepts one connection per connection of the
+     StreamOutputer. Each connection carries a PDS file header followed by the
+     event records. The records are read in a serialized queue from whichever
+     connection has data and are then decompressed and deserialized in
+     parallel by the Lanes.
+   */
+  class StreamSource : public SharedSourceBase {
+  public:
+    StreamSource(unsigned int iNLanes, unsigned long long iNEvents, std::string const& iAddress, unsigned int iNConnections,
+                 std::chrono::milliseconds iTimeout, ProductSelector const& iSelector = ProductSelector());
+    StreamSource(StreamSource&&) = delete;
+    StreamSource(StreamSource const&) = delete;
+
+  size_t numberOfDataProducts() const final;
+  std::vector<DataProductRetriever>& dataProducts(unsigned int iLane, long iEventIndex) final;
+  EventIdentifier eventIdentifier(unsigned int iLane, long iEventIndex) final;
+
+  void printSummary() const final;
+  void fillReport(RunReport&) const final;
+  private:
+
+  void readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder) final;
+
+  //called from queue_. Returns false once all connections ended
+  bool readNextRecord(EventIdentifier&, std::vector<uint32_t>&);
+  void decompressAndDeserialize(unsigned int iLane);
+
+  std::chrono::microseconds decompressTime() const;
+  std::chrono::microseconds deserializeTime() const;
+
+  struct Connection {
+    explicit Connection(StreamSocket iSocket);
+    StreamSocket socket_;
+    StreamSocketBuf buffer_;
+    std::istream stream_;
+    bool ended_ = false;
+    unsigned long long nEvents_ = 0;
+  };
+  std::vector<std::unique_ptr<Connection>> connections_;
+  //the connection looked at first for the next record, so all are served in turn
+  std::size_t nextConnection_ = 0;
+  std::chrono::milliseconds timeout_;
+  SerialTaskQueue queue_;
+
+  std::unique_ptr<pds::DecompressionDictionary> dictionary_;
+  pds::Compression compression_;
+  bool perProductCompression_;
+  bool checksum_;
+  std::vector<uint8_t> shuffle_;
+  pds::ProductMap productMap_;
+
+  struct alignas(kCacheLineSize) LaneInfo {
+    LaneInfo(std::vector<pds::ProductInfo> const&, DeserializeStrategy);
+
+    LaneInfo(LaneInfo&&) = default;
+    LaneInfo(LaneInfo const&) = delete;
+
+    LaneInfo& operator=(LaneInfo&&) = default;
+    LaneInfo& operator=(LaneInfo const&) = delete;
+
+    EventIdentifier eventID_;
+    std::vector<DataProductRetriever> dataProducts_;
+    std::vector<void*> dataBuffers_;
+    DeserializeStrategy deserializers_;
+    StreamDelayedRetriever delayedRetriever_;
+    std::vector<uint32_t> compressedBuffer_;
+    pds::ReusableBuffer<uint32_t> uncompressedBuffer_;
+    //used when each data product was compressed separately
+    pds::ReusableBuffer<char> productBuffer_;
+    pds::DecompressionContext decompressionContext_;
+    std::chrono::microseconds decompressTime_;
+    std::chrono::microseconds deserializeTime_;
+    ~LaneInfo();
+  };
+
+  std::vector<LaneInfo> laneInfos_;
+  std::chrono::microseconds readTime_;
+  //time the queue waited for a record to arrive
+  std::chrono::microseconds waitTime_;
+  };
+}
+
+#endif
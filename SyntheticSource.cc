@@ -0,0 +1,299 @@
+#include "SyntheticSource.h"
+#include "SourceFactory.h"
+#include "TClass.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <random>
+
+using namespace cce::tf;
+
+namespace {
+  //the number of values in each of the inner vectors of a kNestedFloats product
+  constexpr std::size_t kInnerSize = 8;
+
+  //cheap to seed so each event and data product can have its own sequence
+  class SplitMix64 {
+  public:
+    using result_type = std::uint64_t;
+    explicit SplitMix64(std::uint64_t iSeed): state_{iSeed} {}
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()() {
+      std::uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      return z ^ (z >> 31);
+    }
+
+    //in [0,1)
+    double uniform() { return ((*this)() >> 11) * 0x1.0p-53; }
+  private:
+    std::uint64_t state_;
+  };
+
+  SplitMix64 generator(long iEventIndex, unsigned int iProductIndex, unsigned int iNProducts, std::uint64_t iSalt) {
+    return SplitMix64((static_cast<std::uint64_t>(iEventIndex)*iNProducts + iProductIndex) ^ iSalt);
+  }
+
+  //values are 0 with probability iCompressibility else random
+  template<typename F>
+  void fill(std::size_t iN, float iCompressibility, SplitMix64& iRandom, F&& iSet) {
+    for(std::size_t i = 0; i < iN; ++i) {
+      if(iRandom.uniform() < iCompressibility) {
+        iSet(i, 0);
+      } else {
+        iSet(i, iRandom());
+      }
+    }
+  }
+
+  float toFloat(std::uint64_t iRandom) {
+    return (iRandom >> 40) * 0x1.0p-24f;
+  }
+}
+
+SyntheticSizes SyntheticSizes::fixed(double iBytes) {
+  return SyntheticSizes(Kind::kFixed, iBytes, 0.);
+}
+
+SyntheticSizes SyntheticSizes::lognormal(double iBytes, double iSigma) {
+  return SyntheticSizes(Kind::kLognormal, iBytes, iSigma);
+}
+
+SyntheticSizes SyntheticSizes::histogram(std::vector<double> iBytes, std::vector<double> const& iWeights) {
+  SyntheticSizes sizes(Kind::kHistogram, 0., 0.);
+  sizes.binBytes_ = std::move(iBytes);
+  sizes.cumulativeWeights_.reserve(iWeights.size());
+  double sum = 0.;
+  for(auto w: iWeights) {
+    sum += w;
+    sizes.cumulativeWeights_.push_back(sum);
+  }
+  return sizes;
+}
+
+std::size_t SyntheticSizes::size(long iEventIndex, unsigned int iProductIndex, unsigned int iNProducts) const {
+  switch(kind_) {
+  case Kind::kFixed:
+    return bytes_;
+  case Kind::kLognormal:
+    {
+      auto random = generator(iEventIndex, iProductIndex, iNProducts, 0x5A5A5A5A5A5A5A5AULL);
+      //chosen so the mean is bytes_
+      std::lognormal_distribution<double> dist(std::log(bytes_) - sigma_*sigma_/2., sigma_);
+      return dist(random);
+    }
+  case Kind::kHistogram:
+    {
+      auto random = generator(iEventIndex, iProductIndex, iNProducts, 0x5A5A5A5A5A5A5A5AULL);
+      auto value = random.uniform()*cumulativeWeights_.back();
+      auto it = std::upper_bound(cumulativeWeights_.begin(), cumulativeWeights_.end(), value);
+      if(it == cumulativeWeights_.end()) {
+        --it;
+      }
+      return binBytes_[it - cumulativeWeights_.begin()];
+    }
+  }
+  return 0;
+}
+
+SyntheticDelayedProductRetriever::SyntheticDelayedProductRetriever(std::vector<SyntheticType> const& iTypes, SyntheticSizes const& iSizes,
+                                                                   float iCompressibility, std::atomic<unsigned long long>& iBytesGenerated,
+                                                                   unsigned int iNConstant):
+  products_(iTypes.size()),
+  types_(&iTypes),
+  sizes_(&iSizes),
+  compressibility_(iCompressibility),
+  bytesGenerated_(&iBytesGenerated),
+  nConstant_(iNConstant)
+{
+  for(unsigned int i = 0; i < products_.size(); ++i) {
+    auto& p = products_[i];
+    switch(iTypes[i]) {
+    case SyntheticType::kFloats: p.address_ = &p.floats_; break;
+    case SyntheticType::kNestedFloats: p.address_ = &p.nested_; break;
+    case SyntheticType::kPODs: p.address_ = &p.pods_; break;
+    }
+  }
+}
+
+void SyntheticDelayedProductRetriever::getAsync(DataProductRetriever& iRetriever, int index, TaskHolder iCallback) {
+  auto& p = products_[index];
+  unsigned int const nProducts = products_.size();
+  //a constant data product is always made as in the first event
+  long const eventIndex = index + nConstant_ >= nProducts ? 0 : eventIndex_;
+  auto bytes = sizes_->size(eventIndex, index, nProducts);
+  auto random = generator(eventIndex, index, nProducts, 0);
+  switch((*types_)[index]) {
+  case SyntheticType::kFloats:
+    {
+      p.floats_.resize(bytes/sizeof(float));
+      fill(p.floats_.size(), compressibility_, random, [&p](std::size_t i, std::uint64_t v) { p.floats_[i] = toFloat(v); });
+      bytes = p.floats_.size()*sizeof(float);
+      break;
+    }
+  case SyntheticType::kNestedFloats:
+    {
+      p.nested_.resize(bytes/(sizeof(float)*kInnerSize));
+      for(auto& inner: p.nested_) {
+        inner.resize(kInnerSize);
+        fill(kInnerSize, compressibility_, random, [&inner](std::size_t i, std::uint64_t v) { inner[i] = toFloat(v); });
+      }
+      bytes = p.nested_.size()*sizeof(float)*kInnerSize;
+      break;
+    }
+  case SyntheticType::kPODs:
+    {
+      p.pods_.resize(bytes/sizeof(EventIdentifier));
+      fill(p.pods_.size(), compressibility_, random, [&p](std::size_t i, std::uint64_t v) {
+          p.pods_[i] = {static_cast<unsigned int>(v), static_cast<unsigned int>(v >> 32), v};
+        });
+      bytes = p.pods_.size()*sizeof(EventIdentifier);
+      break;
+    }
+  }
+  bytesGenerated_->fetch_add(bytes, std::memory_order_relaxed);
+  iRetriever.setSize(bytes);
+  iCallback.doneWaiting();
+}
+
+SyntheticSource::SyntheticSource(unsigned int iNLanes, unsigned long long iNEvents, std::vector<SyntheticType> iTypes,
+                                 SyntheticSizes iSizes, float iCompressibility, unsigned int iNConstant):
+  SharedSourceBase(iNEvents),
+  types_(std::move(iTypes)),
+  sizes_(std::move(iSizes))
+{
+  auto className = [](SyntheticType iType) {
+    switch(iType) {
+    case SyntheticType::kFloats: return "std::vector<float>";
+    case SyntheticType::kNestedFloats: return "std::vector<std::vector<float>>";
+    case SyntheticType::kPODs: return "std::vector<cce::tf::EventIdentifier>";
+    }
+    return "";
+  };
+  std::vector<TClass*> classes;
+  classes.reserve(types_.size());
+  for(auto t: types_) {
+    classes.push_back(TClass::GetClass(className(t)));
+  }
+
+  delayedPerLane_.reserve(iNLanes);
+  retrieverPerLane_.reserve(iNLanes);
+  for(unsigned int lane = 0; lane<iNLanes; ++lane) {
+    delayedPerLane_.emplace_back(types_, sizes_, iCompressibility, bytesGenerated_, iNConstant);
+    std::vector<DataProductRetriever> r;
+    r.reserve(types_.size());
+    for(unsigned int i = 0; i < types_.size(); ++i) {
+      r.emplace_back(i, delayedPerLane_[lane].address(i), "synthetic"+std::to_string(i), classes[i], &delayedPerLane_[lane]);
+    }
+    retrieverPerLane_.emplace_back(std::move(r));
+  }
+}
+
+size_t SyntheticSource::numberOfDataProducts() const {
+  return types_.size();
+}
+
+std::vector<DataProductRetriever>& SyntheticSource::dataProducts(unsigned int iLane, long iEventIndex) {
+  return retrieverPerLane_[iLane];
+}
+
+EventIdentifier SyntheticSource::eventIdentifier(unsigned int iLane, long iEventIndex) {
+  return {1, 1, static_cast<unsigned long long>(iEventIndex+1)};
+}
+
+void SyntheticSource::printSummary() const {
+  std::cout <<"\nSource generated "<<bytesGenerated_.load()<<" bytes"<<std::endl;
+}
+
+void SyntheticSource::fillReport(RunReport& oReport) const {
+  oReport.set("bytesGenerated", bytesGenerated_.load());
+}
+
+void SyntheticSource::readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder iTask) {
+  delayedPerLane_[iLane].setEventIndex(iEventIndex);
+  iTask.runNow();
+}
+
+namespace {
+    class Maker : public SourceMakerBase {
+  public:
+    Maker(): SourceMakerBase("SyntheticSource") {}
+      std::unique_ptr<SharedSourceBase> create(unsigned int iNLanes, unsigned long long iNEvents, ConfigurationParameters const& params) const final {
+        auto nProducts = params.get<unsigned int>("products", 10);
+
+        std::vector<SyntheticType> typeMix;
+        auto typeNames = params.get<std::string>("types", "floats");
+        std::string::size_type start = 0;
+        while(start <= typeNames.size()) {
+          auto end = std::min(typeNames.find(',', start), typeNames.size());
+          auto name = typeNames.substr(start, end-start);
+          if(name == "floats") {
+            typeMix.push_back(SyntheticType::kFloats);
+          } else if(name == "nested") {
+            typeMix.push_back(SyntheticType::kNestedFloats);
+          } else if(name == "pods") {
+            typeMix.push_back(SyntheticType::kPODs);
+          } else {
+            std::cout <<"unknown type '"<<name<<"' given to SyntheticSource, allowed are floats, nested and pods"<<std::endl;
+            return {};
+          }
+          start = end+1;
+        }
+        std::vector<SyntheticType> types;
+        types.reserve(nProducts);
+        for(unsigned int i = 0; i < nProducts; ++i) {
+          types.push_back(typeMix[i % typeMix.size()]);
+        }
+
+        auto bytes = params.get<float>("size", 1000.);
+        auto distribution = params.get<std::string>("sizeDistribution", "fixed");
+        std::optional<SyntheticSizes> sizes;
+        if(distribution == "fixed") {
+          sizes = SyntheticSizes::fixed(bytes);
+        } else if(distribution == "lognormal") {
+          sizes = SyntheticSizes::lognormal(bytes, params.get<float>("sigma", 1.));
+        } else {
+          std::ifstream file(distribution);
+          if(not file.is_open()) {
+            std::cout <<"unable to open file "<<distribution<<" with the data product size histogram"<<std::endl;
+            return {};
+          }
+          std::vector<double> binBytes;
+          std::vector<double> weights;
+          double b, w;
+          while(file >> b >> w) {
+            binBytes.push_back(b);
+            weights.push_back(w);
+          }
+          if(binBytes.empty() or std::accumulate(weights.begin(), weights.end(), 0.) <= 0.) {
+            std::cout <<"file "<<distribution<<" contained no data product sizes"<<std::endl;
+            return {};
+          }
+          sizes = SyntheticSizes::histogram(std::move(binBytes), weights);
+        }
+
+        auto compressibility = params.get<float>("compressibility", 0.);
+        if(compressibility < 0. or compressibility > 1.) {
+          std::cout <<"SyntheticSource compressibility must be between 0 and 1"<<std::endl;
+          return {};
+        }
+        auto nConstant = params.get<unsigned int>("constant", 0);
+        if(nConstant > nProducts) {
+          std::cout <<"SyntheticSource constant can not be larger than products"<<std::endl;
+          return {};
+        }
+        return std::make_unique<SyntheticSource>(iNLanes, iNEvents, std::move(types), std::move(*sizes), compressibility, nConstant);
+    }
+    };
+
+  Maker s_maker;
+}
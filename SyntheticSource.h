@@ -0,0 +1,93 @@
+#if !defined(SyntheticSource_h)
+#define SyntheticSource_h
+#include "SharedSourceBase.h"
+#include "DataProductRetriever.h"
+#include "DelayedProductRetriever.h"
+#include "EventIdentifier.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cce::tf {
+  //How the data of one synthetic data product is laid out
+  enum class SyntheticType {kFloats, kNestedFloats, kPODs};
+
+  //Chooses the number of bytes each synthetic data product has in an event
+  class SyntheticSizes {
+  public:
+    //every data product has iBytes
+    static SyntheticSizes fixed(double iBytes);
+    //log-normal with mean iBytes and iSigma the standard deviation of the log
+    static SyntheticSizes lognormal(double iBytes, double iSigma);
+    //the bin values with their relative weights
+    static SyntheticSizes histogram(std::vector<double> iBytes, std::vector<double> const& iWeights);
+
+    //the same event and data product always get the same size
+    std::size_t size(long iEventIndex, unsigned int iProductIndex, unsigned int iNProducts) const;
+
+  private:
+    enum class Kind {kFixed, kLognormal, kHistogram};
+    SyntheticSizes(Kind iKind, double iBytes, double iSigma): kind_{iKind}, bytes_{iBytes}, sigma_{iSigma} {}
+
+    Kind kind_;
+    double bytes_;
+    double sigma_;
+    std::vector<double> binBytes_;
+    std::vector<double> cumulativeWeights_;
+  };
+
+  class SyntheticDelayedProductRetriever : public DelayedProductRetriever {
+  public:
+    //the last iNConstant data products are the same in every event
+    SyntheticDelayedProductRetriever(std::vector<SyntheticType> const& iTypes, SyntheticSizes const& iSizes,
+                                     float iCompressibility, std::atomic<unsigned long long>& iBytesGenerated,
+                                     unsigned int iNConstant = 0);
+
+    void getAsync(DataProductRetriever&, int index, TaskHolder iCallback) final;
+
+    void setEventIndex(long iIndex) { eventIndex_ = iIndex; }
+
+    void** address(unsigned int iIndex) { return &products_[iIndex].address_; }
+
+  private:
+    struct Product {
+      std::vector<float> floats_;
+      std::vector<std::vector<float>> nested_;
+      std::vector<EventIdentifier> pods_;
+      void* address_ = nullptr;
+    };
+    std::vector<Product> products_;
+    std::vector<SyntheticType> const* types_;
+    SyntheticSizes const* sizes_;
+    float compressibility_;
+    std::atomic<unsigned long long>* bytesGenerated_;
+    unsigned int nConstant_;
+    long eventIndex_ = -1;
+  };
+
+  class SyntheticSource : public SharedSourceBase {
+  public:
+    SyntheticSource(unsigned int iNLanes, unsigned long long iNEvents, std::vector<SyntheticType> iTypes,
+                    SyntheticSizes iSizes, float iCompressibility, unsigned int iNConstant = 0);
+
+    size_t numberOfDataProducts() const final;
+    std::vector<DataProductRetriever>& dataProducts(unsigned int iLane, long iEventIndex) final;
+    EventIdentifier eventIdentifier(unsigned int iLane, long iEventIndex) final;
+
+    void printSummary() const final;
+    void fillReport(RunReport&) const final;
+
+  private:
+    void readEventAsync(unsigned int iLane, long iEventIndex,  OptionalTaskHolder) final;
+
+    std::vector<SyntheticType> types_;
+    SyntheticSizes sizes_;
+    std::atomic<unsigned long long> bytesGenerated_{0};
+    std::vector<SyntheticDelayedProductRetriever> delayedPerLane_;
+    std::vector<std::vector<DataProductRetriever>> retrieverPerLane_;
+  };
+}
+
+#endif
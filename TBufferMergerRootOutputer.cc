@@ -1,15 +1,19 @@
 
 #include <iostream>
+#include <algorithm>
 
 #include "TBufferMergerRootOutputer.h"
 #include "OutputerFactory.h"
 #include "RootOutputerConfig.h"
+#include "summarize_queue.h"
+#include "FunctorTask.h"
 
 #include "TTree.h"
 #include "TBranch.h"
 #include "TROOT.h"
 #include "TFileCacheWrite.h"
 
+#include "RootIMT.h"
 #include "tbb/task_arena.h"
 #include "tbb/task_group.h"
 
@@ -24,6 +28,8 @@ namespace {
         return ROOT::kLZMA;
       } else if(iName == "LZ4") {
         return ROOT::kLZ4;
+      } else if(iName == "ZSTD") {
+        return ROOT::kZSTD;
       } else {
         std::cout <<"unknown compression algorithm "<<iName<<std::endl;
         abort();
@@ -40,7 +46,11 @@ TBufferMergerRootOutputer::TBufferMergerRootOutputer(std::string const& iFileNam
                     splitLevel_{iConfig.splitLevel_},
                     treeMaxVirtualSize_{iConfig.treeMaxVirtualSize_},
                     autoFlush_{iConfig.autoFlush_ != -1 ? iConfig.autoFlush_ : Config::kDefaultAutoFlush },
-                    concurrentWrite_{iConfig.concurrentWrite}
+                    concurrentWrite_{iConfig.concurrentWrite},
+                    staggerFlushes_{iConfig.staggerFlushes_},
+                    maxBufferedBytes_{iConfig.maxBufferedBytes_},
+                    laneMaxBytes_{iConfig.laneMaxBytes_},
+                    fillOnProductReady_{iConfig.fillOnProductReady_}
 {
 }
 
@@ -61,54 +71,130 @@ void TBufferMergerRootOutputer::setupForLane(unsigned int iLaneIndex, std::vecto
   lane.eventTree_ = new TTree("Events","", splitLevel_, lane.file_.get());
   //Turn off auto save
   lane.eventTree_->SetAutoSave(std::numeric_limits<Long64_t>::max());
+  lane.eventTree_->SetImplicitMT(rootIMTForOutputers());
 
   if (treeMaxVirtualSize_ >= 0) {
     lane.eventTree_->SetMaxVirtualSize(static_cast<Long64_t>(treeMaxVirtualSize_));
   }
   lane.retrievers_ = &iDPs;
   lane.branches_.reserve(iDPs.size());
+  const std::string eventAuxiliaryBranchName{"EventAuxiliary"}; 
+  bool hasEventAuxiliaryBranch = false;
   for(auto& dp : iDPs) {
-    lane.branches_.push_back( lane.eventTree_->Branch(dp.name().c_str(), dp.classType()->GetName(), dp.address(), basketSize_) );
+    lane.branches_.push_back( lane.eventTree_->Branch(dp.name().c_str(), dp.classType()->GetName(), dp.address(), basketSize_, splitLevel_) );
+    if(dp.name() == eventAuxiliaryBranchName) {
+      hasEventAuxiliaryBranch = true;
+    }
+  }
+  //same layout as RootOutputer so the files can be read by the same Sources
+  if(not hasEventAuxiliaryBranch) {
+    lane.eventIDBranch_ = lane.eventTree_->Branch("EventID", &lane.id_, "run/i:lumi/i:event/l");
   }
   lane.accumulatedFillTime_ = std::chrono::microseconds::zero();
   lane.accumulatedWriteTime_ = std::chrono::microseconds::zero();
+  if(autoFlush_ < 0) {
+    lane.flushThreshold_ = -1*autoFlush_;
+    if(staggerFlushes_) {
+      //later writes stay spread out since each lane then restarts from a different point
+      lane.flushThreshold_ = static_cast<int>(static_cast<long long>(lane.flushThreshold_)*(iLaneIndex+1)/lanes_.size());
+    }
+  }
 
 }
 
 void TBufferMergerRootOutputer::productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const {
+  if(not fillOnProductReady_) {
+    return;
+  }
+  auto group = iCallback.group();
+  auto& lane = const_cast<TBufferMergerRootOutputer*>(this)->lanes_[iLaneIndex];
+  lane.fillQueue_.push(*group, [this, iLaneIndex, &iDataProduct, callback=std::move(iCallback)]() mutable {
+      const_cast<TBufferMergerRootOutputer*>(this)->fillBranch(iLaneIndex, iDataProduct);
+      callback.doneWaiting();
+    });
 }
 
-void TBufferMergerRootOutputer::outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+void TBufferMergerRootOutputer::fillBranch(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct) {
+  auto start = std::chrono::high_resolution_clock::now();
+  auto& lane = lanes_[iLaneIndex];
+  auto branch = lane.branches_[iDataProduct.index()];
+  branch->SetAddress(iDataProduct.address());
+  lane.nBytesFilled_ += branch->Fill();
+  lane.accumulatedFillTime_ += std::chrono::duration_cast<decltype(lane.accumulatedFillTime_)>(std::chrono::high_resolution_clock::now() - start);
+}
+
+int TBufferMergerRootOutputer::finishEntry(PerLane& iLane) {
+  auto nBytes = iLane.nBytesFilled_;
+  iLane.nBytesFilled_ = 0;
+  if(iLane.eventIDBranch_) {
+    nBytes += iLane.eventIDBranch_->Fill();
+  }
+  //all branches now have one more entry
+  iLane.eventTree_->SetEntries(-1);
+  return nBytes;
+}
+
+void TBufferMergerRootOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
   
   auto group = iCallback.group();
 
-  group->run([this, iLaneIndex, callback=std::move(iCallback)]()  {
-      const_cast<TBufferMergerRootOutputer*>(this)->write(iLaneIndex, std::move(callback));
+  group->run([this, iLaneIndex, iEventID, callback=std::move(iCallback)]()  {
+      const_cast<TBufferMergerRootOutputer*>(this)->write(iLaneIndex, iEventID, std::move(callback));
     });
 }
 
-void TBufferMergerRootOutputer::write(unsigned int iLaneIndex, TaskHolder iCallback) {
+void TBufferMergerRootOutputer::write(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) {
 
   auto start = std::chrono::high_resolution_clock::now();
 
   auto& lane = lanes_[iLaneIndex];
   auto* retrievers = lane.retrievers_;
 
-  auto it = lane.branches_.begin();
-  for(auto const& retriever: *retrievers) {
-    (*it)->SetAddress(retriever.address());
-    ++it;
+  if(not fillOnProductReady_) {
+    auto it = lane.branches_.begin();
+    for(auto const& retriever: *retrievers) {
+      (*it)->SetAddress(retriever.address());
+      ++it;
+    }
   }
+  lane.id_ = iEventID;
 
+  TaskHolder::WaitScope waitScope;
   // Isolate the fill operation so that IMT doesn't grab other large tasks
   // that could lead to stalling
   tbb::this_task_arena::isolate([&] { 
       assert(lane.eventTree_);
-      lane.nBytesWrittenSinceLastWrite_ +=lane.eventTree_->Fill();
+      auto const nBytes = fillOnProductReady_ ? finishEntry(lane) : lane.eventTree_->Fill();
+      lane.nBytesWrittenSinceLastWrite_ += nBytes;
       ++lane.nEventsSinceWrite_;
+      auto const buffered = bufferedBytes_ += nBytes;
+      auto maxSeen = maxBufferedBytesSeen_.load();
+      while(buffered > maxSeen and not maxBufferedBytesSeen_.compare_exchange_weak(maxSeen, buffered)) {}
+      //only a lane holding at least its share of the bytes writes, so the written buffers are not tiny
+      bool const overByteLimit = maxBufferedBytes_ != 0 and buffered > maxBufferedBytes_ and
+        static_cast<std::size_t>(lane.nBytesWrittenSinceLastWrite_)*lanes_.size() >= buffered;
+      bool overLaneLimit = false;
+      if(laneMaxBytes_ != 0) {
+        auto const resident = residentBytes(lane);
+        auto maxResident = maxLaneResidentBytes_.load();
+        while(resident > maxResident and not maxLaneResidentBytes_.compare_exchange_weak(maxResident, resident)) {}
+        overLaneLimit = resident > laneMaxBytes_;
+      }
+      //call only if the autoFlush setting would not have written
+      auto countForcedWrite = [&]() {
+        if(overByteLimit) {
+          ++nWritesFromByteLimit_;
+        } else {
+          ++nWritesFromLaneLimit_;
+        }
+      };
       if(autoFlush_ <0) {
 	//Flush based on number of bytes written to this buffer
-	if(lane.nBytesWrittenSinceLastWrite_ > -1*autoFlush_) {
+	bool const full = lane.nBytesWrittenSinceLastWrite_ > lane.flushThreshold_;
+	if(full or overByteLimit or overLaneLimit) {
+          if(not full) {
+            countForcedWrite();
+          }
           if(concurrentWrite_) {
             writeWhenBytesFull(iLaneIndex);
           } else {
@@ -130,6 +216,10 @@ void TBufferMergerRootOutputer::write(unsigned int iLaneIndex, TaskHolder iCallb
 	    lane.shouldWrite_ = true;
 	  }
 	}
+	if(not lane.shouldWrite_ and (overByteLimit or overLaneLimit)) {
+          countForcedWrite();
+          lane.shouldWrite_ = true;
+        }
 	if(lane.shouldWrite_) {
           if(concurrentWrite_) {
             writeWhenEnoughEvents(iLaneIndex);
@@ -150,47 +240,83 @@ void TBufferMergerRootOutputer::writeWhenBytesFull(unsigned int iLaneIndex) {
   auto start = std::chrono::high_resolution_clock::now();
   auto& lane = lanes_[iLaneIndex];
   //std::cout <<"lane "<< iLaneIndex<<" events since write "<<lane.nEventsSinceWrite_<<" "<<lane.nBytesWrittenSinceLastWrite_ << std::endl;
-  lane.nBytesWrittenSinceLastWrite_ = 0;
-  lane.nEventsSinceWrite_ = 0;
-  lane.file_->Write();
+  lane.flushThreshold_ = -1*autoFlush_;
+  writeLane(lane);
   lane.accumulatedWriteTime_ += std::chrono::duration_cast<decltype(lane.accumulatedWriteTime_)>(std::chrono::high_resolution_clock::now() - start);
 }
 void TBufferMergerRootOutputer::writeWhenEnoughEvents(unsigned int iLaneIndex) {
   auto start = std::chrono::high_resolution_clock::now();
   auto& lane = lanes_[iLaneIndex];
   lane.shouldWrite_=false;
-  lane.file_->Write();
+  writeLane(lane);
   lane.accumulatedWriteTime_ += std::chrono::duration_cast<decltype(lane.accumulatedWriteTime_)>(std::chrono::high_resolution_clock::now() - start);
 }
 
-  
-void TBufferMergerRootOutputer::printSummary() const {
+void TBufferMergerRootOutputer::writeLane(PerLane& iLane) {
+  bufferedBytes_ -= iLane.nBytesWrittenSinceLastWrite_;
+  iLane.nBytesWrittenSinceLastWrite_ = 0;
+  iLane.nEventsSinceWrite_ = 0;
+  ++nWrites_;
+  iLane.file_->Write();
+  iLane.totBytesAtWrite_ = iLane.eventTree_->GetTotBytes();
+}
 
-  std::cout <<"end write"<<std::endl;
+std::size_t TBufferMergerRootOutputer::residentBytes(PerLane const& iLane) {
+  //The baskets the TTree wrote since the lane's last write are compressed in the in-memory file.
+  // The remaining filled bytes are still in the uncompressed open baskets.
+  auto const writtenBaskets = iLane.eventTree_->GetTotBytes() - iLane.totBytesAtWrite_;
+  auto const openBaskets = std::max(Long64_t(0), iLane.nBytesWrittenSinceLastWrite_ - writtenBaskets);
+  return iLane.file_->GetEND() + openBaskets;
+}
+
+void TBufferMergerRootOutputer::finishLane(PerLane const& iLane) {
   auto start = std::chrono::high_resolution_clock::now();
+  iLane.file_->Write();
+  iLane.endWriteTime_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+
+  start = std::chrono::high_resolution_clock::now();
+  iLane.file_->Close();
+  iLane.endCloseTime_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start);
+}
 
+void TBufferMergerRootOutputer::finishAsync(TaskHolder iCallback) const {
+  if(finished_) {
+    return;
+  }
+  finished_ = true;
+  finishStart_ = std::chrono::high_resolution_clock::now();
+  auto group = iCallback.group();
+  TaskHolder lanesDone(*group, make_functor_task([this, iCallback=std::move(iCallback)]() {
+        endOfJobTime_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - finishStart_);
+      }));
   if(concurrentWrite_) {
-    tbb::task_group group;
     for(auto& lane: lanes_) {
-      group.run([&lane]() {
-          lane.file_->Write();
-        });
-      group.wait();
+      group->run([&lane, lanesDone]() { finishLane(lane); });
     }
   } else {
-    for(auto& lane: lanes_) {
-      lane.file_->Write();
+    group->run([this, lanesDone=std::move(lanesDone)]() {
+        for(auto& lane: lanes_) {
+          finishLane(lane);
+        }
+      });
+  }
+}
+  
+void TBufferMergerRootOutputer::printSummary() const {
+  if(not finished_) {
+    tbb::task_group group;
+    {
+      TaskHolder th(group, make_functor_task([](){}));
+      finishAsync(std::move(th));
     }
+    group.wait();
   }
-  auto writeTime = std::chrono::duration_cast<decltype(lanes_[0].accumulatedWriteTime_)>(std::chrono::high_resolution_clock::now() - start);
-
-  std::cout <<"file close"<<std::endl;
-  start = std::chrono::high_resolution_clock::now();
-  for(auto& lane: lanes_) {
-    //std::cout <<" start next lane"<<std::endl;
-    lane.file_->Close();
+  decltype(lanes_[0].accumulatedWriteTime_.count()) writeTime = 0;
+  decltype(lanes_[0].accumulatedWriteTime_.count()) closeTime = 0;
+  for(auto& l: lanes_) {
+    writeTime += l.endWriteTime_.count();
+    closeTime += l.endCloseTime_.count();
   }
-  auto closeTime = std::chrono::duration_cast<decltype(lanes_[0].accumulatedWriteTime_)>(std::chrono::high_resolution_clock::now() - start);
 
   decltype(lanes_[0].accumulatedFillTime_.count()) fillSum = 0;
   for(auto& l: lanes_) {
@@ -205,9 +331,21 @@ void TBufferMergerRootOutputer::printSummary() const {
 
   std::cout <<"TBufferMergerRootOutputer fill time: "<<fillSum<<"us\n";
   std::cout <<"TBufferMergerRootOutputer write time: "<<writeSum<<"us\n";
-  std::cout <<"TBufferMergerRootOutputer end write time: "<<writeTime.count()<<"us\n";
-  std::cout <<"TBufferMergerRootOutputer end close time: "<<closeTime.count()<<"us\n";
-  std::cout <<"TBufferMergerRootOutputer total time: "<<fillSum+writeSum+writeTime.count()<<"us\n";
+  std::cout <<"TBufferMergerRootOutputer end write time: "<<writeTime<<"us\n";
+  std::cout <<"TBufferMergerRootOutputer end close time: "<<closeTime<<"us\n";
+  std::cout <<"TBufferMergerRootOutputer end of job time: "<<endOfJobTime_.count()<<"us\n";
+  std::cout <<"TBufferMergerRootOutputer total time: "<<fillSum+writeSum+writeTime<<"us\n";
+  if(fillOnProductReady_) {
+    std::cout <<"  data products filled into their branches when ready\n";
+  }
+  std::cout <<"  lane writes: "<<nWrites_<<" from byte limit: "<<nWritesFromByteLimit_<<" from lane limit: "<<nWritesFromLaneLimit_<<"\n";
+  if(laneMaxBytes_ != 0) {
+    std::cout <<"  max bytes held by a lane: "<<maxLaneResidentBytes_<<"\n";
+  }
+  std::cout <<"  max bytes buffered by all lanes: "<<maxBufferedBytesSeen_<<"\n";
+  if(not concurrentWrite_) {
+    summarize_queue("write", queue_);
+  }
 
 }
 
@@ -225,6 +363,10 @@ namespace {
       }
       auto config = outputerConfig<TBufferMergerRootOutputer::Config>(result->second);
       config.concurrentWrite = concurrentWrite;
+      config.maxBufferedBytes_ = params.get<std::size_t>("maxBufferedBytes", 0);
+      config.staggerFlushes_ = params.get<bool>("staggerFlushes", false);
+      config.laneMaxBytes_ = params.get<std::size_t>("laneMaxBytes", 0);
+      config.fillOnProductReady_ = params.get<bool>("fillOnProductReady", false);
 
       return std::make_unique<TBufferMergerRootOutputer>(result->first,iNLanes, config);
     }
@@ -30,6 +30,15 @@ class TBufferMergerRootOutputer :public OutputerBase {
     int treeMaxVirtualSize_=-1;
     int autoFlush_=kDefaultAutoFlush; //This is ROOT's default value
     bool concurrentWrite = false;
+    //if not 0, a lane holding at least its share of the bytes buffered by all lanes
+    // writes once the total is above this
+    std::size_t maxBufferedBytes_ = 0;
+    //spread the first byte based writes of the lanes so they do not all happen together
+    bool staggerFlushes_ = false;
+    //if not 0, a lane writes once its in-memory file and unwritten baskets hold more bytes than this
+    std::size_t laneMaxBytes_ = 0;
+    //stream each data product into its branch as soon as it is ready instead of in TTree::Fill
+    bool fillOnProductReady_ = false;
   };
 
   TBufferMergerRootOutputer(std::string const& iFileName, unsigned int iNLanes, Config const&);
@@ -38,10 +47,12 @@ class TBufferMergerRootOutputer :public OutputerBase {
   void setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) final;
 
   void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const final;
-  bool usesProductReadyAsync() const final {return false;}
+  bool usesProductReadyAsync() const final {return fillOnProductReady_;}
 
-  void outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
   
+  //with concurrentWrite the lanes write and close their files in parallel
+  void finishAsync(TaskHolder iCallback) const final;
   void printSummary() const final;
 
 
@@ -50,17 +61,37 @@ private:
     std::shared_ptr<ROOT::TBufferMergerFile> file_;
     TTree* eventTree_;
     std::vector<TBranch*> branches_;
+    TBranch* eventIDBranch_ = nullptr;
+    EventIdentifier id_;
     std::vector<DataProductRetriever> const* retrievers_;
     std::chrono::microseconds accumulatedFillTime_;
     std::chrono::microseconds accumulatedWriteTime_;
     int nBytesWrittenSinceLastWrite_ = 0;
     int nEventsSinceWrite_ = 0;
+    //number of bytes at which the lane writes when using byte based autoFlush
+    int flushThreshold_ = 0;
+    //uncompressed size of the baskets the TTree had written at the lane's last write
+    Long64_t totBytesAtWrite_ = 0;
     std::atomic<bool> shouldWrite_ = false;
+    //with fillOnProductReady the branches of the lane are filled one at a time
+    // since a full basket is written to the lane's file
+    SerialTaskQueue fillQueue_;
+    //bytes filled into the branches for the present event
+    int nBytesFilled_ = 0;
+    //spent in the last write and close at end of job
+    mutable std::chrono::microseconds endWriteTime_{0};
+    mutable std::chrono::microseconds endCloseTime_{0};
   };
   
-  void write(unsigned int iLaneIndex, TaskHolder iCallback);
+  void write(unsigned int iLaneIndex, EventIdentifier const&, TaskHolder iCallback);
+  void fillBranch(unsigned int iLaneIndex, DataProductRetriever const&);
+  //the branches were already filled, fills the EventID and counts the entry. Returns the bytes filled.
+  static int finishEntry(PerLane&);
   void writeWhenBytesFull(unsigned int iLaneIndex);
   void writeWhenEnoughEvents(unsigned int iLaneIndex);
+  void writeLane(PerLane&);
+  static std::size_t residentBytes(PerLane const&);
+  static void finishLane(PerLane const&);
   static std::unique_ptr<TFile> createFile(const char *filename, const char *option, Config const&);
   ROOT::TBufferMerger buffer_;
   SerialTaskQueue queue_;
@@ -71,6 +102,20 @@ private:
   const int autoFlush_;
   std::atomic<int> numberEventsSinceLastWrite_;
   bool concurrentWrite_;
+  const bool staggerFlushes_;
+  const std::size_t maxBufferedBytes_;
+  const std::size_t laneMaxBytes_;
+  const bool fillOnProductReady_;
+  //bytes filled by all lanes which have not yet been written
+  std::atomic<std::size_t> bufferedBytes_ = 0;
+  std::atomic<std::size_t> maxBufferedBytesSeen_ = 0;
+  std::atomic<unsigned long long> nWrites_ = 0;
+  std::atomic<unsigned long long> nWritesFromByteLimit_ = 0;
+  std::atomic<unsigned long long> nWritesFromLaneLimit_ = 0;
+  std::atomic<std::size_t> maxLaneResidentBytes_ = 0;
+  mutable bool finished_ = false;
+  mutable std::chrono::high_resolution_clock::time_point finishStart_;
+  mutable std::chrono::microseconds endOfJobTime_{0};
 };
 }
 #endif
@@ -3,8 +3,10 @@
 
 #include <atomic>
 
+#include "TaskPool.h"
+
 namespace cce::tf {
-class TaskBase {
+class TaskBase : public TaskPoolAllocated {
 public:
   TaskBase() = default;
   virtual ~TaskBase() {
@@ -2,10 +2,19 @@
 #define TaskHolder_h
 
 #include <memory>
+#include <atomic>
 #include "tbb/task_group.h"
 #include "TaskBase.h"
 
 namespace cce::tf {
+namespace taskholder_detail {
+  //the group of the task being run by a thread and the task to run after it
+  struct Running {
+    tbb::task_group* group_ = nullptr;
+    TaskBase* next_ = nullptr;
+  };
+}
+
 class TaskHolder {
 public:
   TaskHolder(): group_{nullptr}, task_{nullptr} {}
@@ -58,16 +67,94 @@ public:
     task_ = nullptr;
     if(t->decrement_ref_count()) {
       //std::cout <<"Task "<<t<<std::endl;
-      group_->run([t]() {
-	  t->execute();
-	  //std::cout <<"delete "<<t<<std::endl;
-	  delete t;
+      if(s_inlineContinuations) {
+        auto& running = t_running;
+        //a task from a different group must run in its own group else
+        // that group's wait() could return before the task has run
+        if(running.group_ == group_ and not running.next_) {
+          //run by this thread once the present task returns
+          running.next_ = t;
+          return;
+        }
+      }
+      auto group = group_;
+      group_->run([t, group]() {
+          runChain(*group, t);
 	});
     }
   }
+
+  //When set, the first task made ready by a task started from a TaskHolder is run
+  // on the same thread right after that task returns, instead of being given to
+  // the scheduler, as long as both are in the same task_group. Set before any task is run.
+  // The kept task is invisible to TBB until the present task returns, so a task
+  // which blocks, e.g. in task_group::wait, tbb::this_task_arena::isolate or
+  // tbb::parallel_for, must do so within a WaitScope.
+  static void setInlineContinuations(bool iSet) { s_inlineContinuations = iSet; }
+  //the number of tasks which were run that way
+  static unsigned long long inlineContinuations() { return s_nInlineContinuations.load(); }
+
+  //Hands a task kept to be run inline to the scheduler and keeps none while it
+  // exists, so what the present task waits for can not depend on a task only
+  // this thread would run once the wait is over.
+  class WaitScope {
+  public:
+    WaitScope(): outer_{t_running} {
+      t_running = taskholder_detail::Running{};
+      if(outer_.next_) {
+        auto group = outer_.group_;
+        group->run([t = outer_.next_, group]() { runChain(*group, t); });
+        outer_.next_ = nullptr;
+      }
+    }
+    ~WaitScope() { t_running = outer_; }
+    WaitScope(WaitScope const&) = delete;
+    WaitScope& operator=(WaitScope const&) = delete;
+  private:
+    taskholder_detail::Running outer_;
+  };
+
 private:
+  //after this many tasks in a row the next one is given to the scheduler so others get a turn
+  static constexpr unsigned int kMaxInlineContinuations = 16;
+
+  static void runChain(tbb::task_group& iGroup, TaskBase* iTask) {
+    if(not s_inlineContinuations) {
+      iTask->execute();
+      //std::cout <<"delete "<<t<<std::endl;
+      delete iTask;
+      return;
+    }
+    auto& running = t_running;
+    //a task waiting on a task_group can have other tasks run on this thread meanwhile
+    taskholder_detail::Running const outer = running;
+    running = taskholder_detail::Running{&iGroup, nullptr};
+    unsigned int nInline = 0;
+    TaskBase* t = iTask;
+    do {
+      t->execute();
+      delete t;
+      t = running.next_;
+      running.next_ = nullptr;
+      if(t and nInline == kMaxInlineContinuations) {
+        iGroup.run([t, group = &iGroup]() { runChain(*group, t); });
+        t = nullptr;
+      } else if(t) {
+        ++nInline;
+      }
+    } while(t);
+    running = outer;
+    if(nInline != 0) {
+      s_nInlineContinuations += nInline;
+    }
+  }
+
   tbb::task_group* group_;
   TaskBase* task_;
+
+  static inline bool s_inlineContinuations = false;
+  static inline std::atomic<unsigned long long> s_nInlineContinuations{0};
+  static inline thread_local taskholder_detail::Running t_running;
 };
 }
 #endif
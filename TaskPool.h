@@ -0,0 +1,198 @@
+#if !defined(TaskPool_h)
+#define TaskPool_h
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace cce::tf {
+  /**
+     A TaskPool keeps memory blocks used for tasks so they can be reused
+     instead of going back to the heap. Blocks are grouped in power of 2 size
+     classes. Each block is preceded by a header which records which pool
+     (if any) it came from so that the block can be returned to that pool from
+     any thread.
+
+     Each size class keeps its free blocks in a lock-free stack. Taking or
+     returning a block costs one compare-and-swap on the head of that stack,
+     which only contends with threads using the same pool and size class at
+     the same moment; no thread ever waits for another. The head carries a
+     counter, changed by every pop, so a block popped and pushed again by
+     other threads between the read of the head and the swap is noticed.
+     Blocks stay with the pool until it is destroyed, so reading the next
+     pointer of a block another thread just took is still safe.
+
+     Requests too large for the biggest size class, or made without a pool,
+     go directly to the heap but still carry the header so the deallocation
+     path is the same. Those are counted by each thread on its own and only
+     summed when the count is asked for.
+   */
+  class TaskPool {
+  public:
+    TaskPool() = default;
+    ~TaskPool() {
+      for(auto& c: classes_) {
+        auto b = pointer(c.free_.load());
+        while(b) {
+          auto next = b->next_.load();
+          ::operator delete(b);
+          b = next;
+        }
+      }
+    }
+
+    TaskPool(TaskPool const&) = delete;
+    TaskPool& operator=(TaskPool const&) = delete;
+
+    void* allocate(std::size_t iSize) {
+      auto sizeClass = sizeClassFor(iSize);
+      if(sizeClass == kNSizeClasses) {
+        return allocate(nullptr, iSize);
+      }
+      auto& c = classes_[sizeClass];
+      auto head = c.free_.load(std::memory_order_acquire);
+      while(auto b = pointer(head)) {
+        auto next = pack(b->next_.load(std::memory_order_relaxed), tag(head)+1);
+        if(c.free_.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire)) {
+          c.reused_.fetch_add(1, std::memory_order_relaxed);
+          return b+1;
+        }
+      }
+      heapAllocations_.fetch_add(1, std::memory_order_relaxed);
+      auto b = new (::operator new(sizeof(BlockHeader)+ (kSmallestBlock << sizeClass))) BlockHeader{this,sizeClass,nullptr};
+      return b+1;
+    }
+
+    //Allocation not associated with any pool
+    static void* allocate(std::nullptr_t, std::size_t iSize) {
+      auto& n = t_unpooledAllocations.n_;
+      n.store(n.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+      auto b = new (::operator new(sizeof(BlockHeader)+iSize)) BlockHeader{nullptr,kNSizeClasses,nullptr};
+      return b+1;
+    }
+
+    static void deallocate(void* iPtr) {
+      if(nullptr == iPtr) { return; }
+      auto b = reinterpret_cast<BlockHeader*>(iPtr)-1;
+      if(not b->pool_) {
+        ::operator delete(b);
+        return;
+      }
+      auto& c = b->pool_->classes_[b->sizeClass_];
+      auto head = c.free_.load(std::memory_order_relaxed);
+      do {
+        b->next_.store(pointer(head), std::memory_order_relaxed);
+      } while(not c.free_.compare_exchange_weak(head, pack(b, tag(head)), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    ///number of times the pool had to go to the heap
+    unsigned long long heapAllocations() const { return heapAllocations_.load(); }
+    ///number of times a block was reused rather than coming from the heap
+    unsigned long long reusedAllocations() const {
+      unsigned long long sum = 0;
+      for(auto& c: classes_) {
+        sum += c.reused_.load();
+      }
+      return sum;
+    }
+
+    ///number of heap allocations done by tasks not using a pool
+    static unsigned long long unpooledAllocations() {
+      auto& r = unpooledRegistry();
+      std::lock_guard<std::mutex> guard(r.mutex_);
+      auto sum = r.ofEndedThreads_;
+      for(auto c: r.counters_) {
+        sum += c->n_.load(std::memory_order_relaxed);
+      }
+      return sum;
+    }
+
+  private:
+    static constexpr std::size_t kSmallestBlock = 64;
+    static constexpr unsigned int kNSizeClasses = 6;
+
+    static unsigned int sizeClassFor(std::size_t iSize) {
+      unsigned int sizeClass = 0;
+      std::size_t blockSize = kSmallestBlock;
+      while(sizeClass < kNSizeClasses and blockSize < iSize) {
+        blockSize <<=1;
+        ++sizeClass;
+      }
+      return sizeClass;
+    }
+
+    struct alignas(alignof(std::max_align_t)) BlockHeader {
+      TaskPool* pool_;
+      unsigned int sizeClass_;
+      std::atomic<BlockHeader*> next_;
+    };
+
+    //The head of a free list is the address of its first block in the low
+    // 48 bits, the most user space addresses use on x86-64 and aarch64, and
+    // the counter in the high 16 bits.
+    static_assert(sizeof(std::uintptr_t) == 8, "TaskPool needs 64 bit pointers");
+    static constexpr unsigned int kTagShift = 48;
+    static constexpr std::uintptr_t kPointerMask = (std::uintptr_t(1) << kTagShift) - 1;
+
+    static BlockHeader* pointer(std::uintptr_t iHead) { return reinterpret_cast<BlockHeader*>(iHead & kPointerMask); }
+    static std::uintptr_t tag(std::uintptr_t iHead) { return iHead >> kTagShift; }
+    static std::uintptr_t pack(BlockHeader* iBlock, std::uintptr_t iTag) {
+      return reinterpret_cast<std::uintptr_t>(iBlock) | (iTag << kTagShift);
+    }
+
+    //each on its own cache line so threads using different sizes do not contend
+    struct alignas(64) SizeClass {
+      std::atomic<std::uintptr_t> free_{0};
+      std::atomic<unsigned long long> reused_{0};
+    };
+
+    std::array<SizeClass, kNSizeClasses> classes_;
+    std::atomic<unsigned long long> heapAllocations_{0};
+
+    //only changed by its own thread, so counting does not share a cache line between threads
+    struct UnpooledCounter {
+      UnpooledCounter() {
+        auto& r = unpooledRegistry();
+        std::lock_guard<std::mutex> guard(r.mutex_);
+        r.counters_.push_back(this);
+      }
+      ~UnpooledCounter() {
+        auto& r = unpooledRegistry();
+        std::lock_guard<std::mutex> guard(r.mutex_);
+        r.ofEndedThreads_ += n_.load(std::memory_order_relaxed);
+        r.counters_.erase(std::find(r.counters_.begin(), r.counters_.end(), this));
+      }
+      std::atomic<unsigned long long> n_{0};
+    };
+    struct UnpooledRegistry {
+      std::mutex mutex_;
+      std::vector<UnpooledCounter*> counters_;
+      unsigned long long ofEndedThreads_ = 0;
+    };
+    //never deleted so threads ending after main returns can still use it
+    static UnpooledRegistry& unpooledRegistry() {
+      static auto* s_registry = new UnpooledRegistry;
+      return *s_registry;
+    }
+    static inline thread_local UnpooledCounter t_unpooledAllocations;
+  };
+
+  /**
+     Inheriting from TaskPoolAllocated makes all new/delete calls for the
+     class go through a TaskPool. Use `new (pool) T(...)` to take memory from
+     a specific pool.
+   */
+  class TaskPoolAllocated {
+  public:
+    static void* operator new(std::size_t iSize) { return TaskPool::allocate(nullptr, iSize); }
+    static void* operator new(std::size_t iSize, TaskPool& iPool) { return iPool.allocate(iSize); }
+    static void operator delete(void* iPtr) { TaskPool::deallocate(iPtr); }
+    static void operator delete(void* iPtr, TaskPool&) { TaskPool::deallocate(iPtr); }
+  };
+}
+#endif
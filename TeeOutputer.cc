@@ -0,0 +1,118 @@
+#include "TeeOutputer.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace cce::tf;
+
+TeeOutputer::TeeOutputer(std::vector<std::string> iNames, std::vector<std::unique_ptr<OutputerBase>> iOutputers):
+  names_{std::move(iNames)},
+  outputers_{std::move(iOutputers)},
+  usesProductReady_{false}
+{
+  for(auto const& out: outputers_) {
+    allOutputers_.push_back(out.get());
+    if(out->usesProductReadyAsync()) {
+      productReadyOutputers_.push_back(out.get());
+      usesProductReady_ = true;
+    }
+    if(out->usesReadyForEventAsync()) {
+      readyForEventOutputers_.push_back(out.get());
+    }
+  }
+}
+
+void TeeOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) {
+  for(auto& out: outputers_) {
+    out->setupForLane(iLaneIndex, iDPs);
+  }
+}
+
+bool TeeOutputer::setupForLaneIsThreadSafe() const {
+  return std::all_of(outputers_.begin(), outputers_.end(), [](auto const& iOut) { return iOut->setupForLaneIsThreadSafe(); });
+}
+
+std::optional<ProductNeeds> TeeOutputer::neededProducts() const {
+  std::optional<ProductNeeds> needs;
+  for(auto const& out: outputers_) {
+    if(auto outNeeds = out->neededProducts()) {
+      if(needs) {
+        needs->add(*outNeeds);
+      } else {
+        needs = std::move(outNeeds);
+      }
+    }
+  }
+  return needs;
+}
+
+template<typename F>
+void TeeOutputer::forEachAsync(std::vector<OutputerBase const*> const& iOutputers, TaskHolder iCallback, F iFunc) const {
+  if(iOutputers.empty()) {
+    return;
+  }
+  auto last = iOutputers.end()-1;
+  for(auto it = iOutputers.begin(); it != last; ++it) {
+    iCallback.group()->run([out = *it, iFunc, iCallback]() { iFunc(*out, iCallback); });
+  }
+  iFunc(**last, std::move(iCallback));
+}
+
+void TeeOutputer::productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const {
+  forEachAsync(productReadyOutputers_, std::move(iCallback), [iLaneIndex, &iDataProduct](OutputerBase const& iOut, TaskHolder iCallback) {
+      iOut.productReadyAsync(iLaneIndex, iDataProduct, std::move(iCallback));
+    });
+}
+
+void TeeOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+  //iEventID may be a temporary so the tasks get a copy
+  forEachAsync(allOutputers_, std::move(iCallback), [iLaneIndex, iEventIndex, id = iEventID](OutputerBase const& iOut, TaskHolder iCallback) {
+      iOut.outputAsync(iLaneIndex, iEventIndex, id, std::move(iCallback));
+    });
+}
+
+void TeeOutputer::outputEventsAsync(unsigned int iFirstLaneIndex, long iFirstEventIndex, std::vector<EventIdentifier> const& iEventIDs, TaskHolder iCallback) const {
+  forEachAsync(allOutputers_, std::move(iCallback), [iFirstLaneIndex, iFirstEventIndex, ids = iEventIDs](OutputerBase const& iOut, TaskHolder iCallback) {
+      iOut.outputEventsAsync(iFirstLaneIndex, iFirstEventIndex, ids, std::move(iCallback));
+    });
+}
+
+void TeeOutputer::readyForEventAsync(unsigned int iLaneIndex, TaskHolder iCallback) const {
+  //the Lane waits for the fullest of the Outputers
+  forEachAsync(readyForEventOutputers_, std::move(iCallback), [iLaneIndex](OutputerBase const& iOut, TaskHolder iCallback) {
+      iOut.readyForEventAsync(iLaneIndex, std::move(iCallback));
+    });
+}
+
+void TeeOutputer::setFirstEventIndex(long iEventIndex) {
+  for(auto& out: outputers_) {
+    out->setFirstEventIndex(iEventIndex);
+  }
+}
+
+void TeeOutputer::finishAsync(TaskHolder iCallback) const {
+  forEachAsync(allOutputers_, std::move(iCallback), [](OutputerBase const& iOut, TaskHolder iCallback) {
+      iOut.finishAsync(std::move(iCallback));
+    });
+}
+
+void TeeOutputer::printSummary() const {
+  for(unsigned int i=0; i<outputers_.size(); ++i) {
+    std::cout <<"TeeOutputer "<<i<<" "<<names_[i]<<"\n";
+    outputers_[i]->printSummary();
+  }
+}
+
+void TeeOutputer::fillReport(RunReport& oReport) const {
+  for(unsigned int i=0; i<outputers_.size(); ++i) {
+    auto& section = oReport.section(std::to_string(i));
+    section.set("outputer", names_[i]);
+    outputers_[i]->fillReport(section);
+  }
+}
+
+void TeeOutputer::fillProfile(ProductProfile& oProfile) const {
+  for(auto const& outputer: outputers_) {
+    outputer->fillProfile(oProfile);
+  }
+}
@@ -0,0 +1,55 @@
+#if !defined(TeeOutputer_h)
+#define TeeOutputer_h
+
+#include <vector>
+#include <string>
+#include <memory>
+
+#include "OutputerBase.h"
+
+namespace cce::tf {
+  /**
+     Hands every event to several Outputers so the same events can be written
+     with different formats or settings in one job. Each Outputer sees all the
+     Lanes. The per data product and end of event work of the Outputers run as
+     separate tasks and the Lane continues once all of them are done.
+   */
+class TeeOutputer : public OutputerBase {
+ public:
+  TeeOutputer(std::vector<std::string> iNames, std::vector<std::unique_ptr<OutputerBase>> iOutputers);
+
+  void setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iDPs) final;
+  bool setupForLaneIsThreadSafe() const final;
+
+  void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iDataProduct, TaskHolder iCallback) const final;
+  bool usesProductReadyAsync() const final { return usesProductReady_; }
+  std::optional<ProductNeeds> neededProducts() const final;
+
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+  void setFirstEventIndex(long iEventIndex) final;
+  void outputEventsAsync(unsigned int iFirstLaneIndex, long iFirstEventIndex, std::vector<EventIdentifier> const& iEventIDs, TaskHolder iCallback) const final;
+
+  void readyForEventAsync(unsigned int iLaneIndex, TaskHolder iCallback) const final;
+  bool usesReadyForEventAsync() const final { return not readyForEventOutputers_.empty(); }
+
+  void finishAsync(TaskHolder iCallback) const final;
+
+  void printSummary() const final;
+  void fillReport(RunReport&) const final;
+  void fillProfile(ProductProfile&) const final;
+
+ private:
+  //runs iFunc for each Outputer, all but the last in a new task
+  template<typename F>
+  void forEachAsync(std::vector<OutputerBase const*> const& iOutputers, TaskHolder iCallback, F iFunc) const;
+
+  std::vector<std::string> names_;
+  std::vector<std::unique_ptr<OutputerBase>> outputers_;
+  //the Outputers which need productReadyAsync
+  std::vector<OutputerBase const*> productReadyOutputers_;
+  std::vector<OutputerBase const*> allOutputers_;
+  std::vector<OutputerBase const*> readyForEventOutputers_;
+  bool usesProductReady_;
+};
+}
+#endif
@@ -1,5 +1,6 @@
 #include "TestProductsOutputer.h"
 #include "DataProductRetriever.h"
+#include "ProductView.h"
 #include "OutputerFactory.h"
 
 #include <vector>
@@ -8,6 +9,18 @@
 
 using namespace cce::tf;
 
+namespace {
+  //works both for data products read in place and for deserialized ones
+  template<typename T>
+  ProductView<T> elements(DataProductRetriever const& iProduct) {
+    if(auto view = viewOf<T>(iProduct)) {
+      return *view;
+    }
+    auto const& object = materialize<T>(iProduct);
+    return ProductView<T>(object.data(), object.size());
+  }
+}
+
 TestProductsOutputer::TestProductsOutputer(unsigned int iNLanes, int iNProducts):
   retrieverPerLane_(iNLanes), nProducts_(iNProducts) {}
 
@@ -24,7 +37,7 @@ bool TestProductsOutputer::usesProductReadyAsync() const {
 }
 
 
-void TestProductsOutputer::outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+void TestProductsOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
   auto const& retrievers = *retrieverPerLane_[iLaneIndex];
 
   if (retrievers.size() != nProducts_) {
@@ -34,26 +47,26 @@ void TestProductsOutputer::outputAsync(unsigned int iLaneIndex, EventIdentifier
   auto const index = iEventID.event -1;
   for(auto const& prod: retrievers) {
     if(prod.name() == "ints") {
-      std::vector<int>* ints = reinterpret_cast<std::vector<int>*>(*prod.address());
-      if(ints->size() != 3) {
-        std::cout <<"ERROR: ints has incorrect size "<<ints->size()<<" in event "<<iEventID.event <<std::endl;
+      auto ints = elements<int>(prod);
+      if(ints.size() != 3) {
+        std::cout <<"ERROR: ints has incorrect size "<<ints.size()<<" in event "<<iEventID.event <<std::endl;
         abort();
       }
       for(int i=0; i<3; ++i) {
-        if( (*ints)[i] != index + i) {
-          std::cout <<"ERROR: ints index "<<i<<" has wrong value "<<(*ints)[i]<<" in event "<<iEventID.event<<std::endl;
+        if( ints[i] != index + i) {
+          std::cout <<"ERROR: ints index "<<i<<" has wrong value "<<ints[i]<<" in event "<<iEventID.event<<std::endl;
           abort();
         }
       }
     } else if(prod.name() == "floats") {
-      std::vector<float>* floats = reinterpret_cast<std::vector<float>*>(*prod.address());
-      if(floats->size() != 3) {
-        std::cout <<"ERROR: floats has incorrect size "<<floats->size()<<" in event "<<iEventID.event<<std::endl;
+      auto floats = elements<float>(prod);
+      if(floats.size() != 3) {
+        std::cout <<"ERROR: floats has incorrect size "<<floats.size()<<" in event "<<iEventID.event<<std::endl;
         abort();
       }
       for(int i=0; i<3; ++i) {
-        if( (*floats)[i] != index*(i+1.f)) {
-          std::cout <<"ERROR: floats index "<<i<<" has wrong value "<<(*floats)[i]<<" (expected "<<index*(i+1.f)<< ") in event "<<iEventID.event<<std::endl;
+        if( floats[i] != index*(i+1.f)) {
+          std::cout <<"ERROR: floats index "<<i<<" has wrong value "<<floats[i]<<" (expected "<<index*(i+1.f)<< ") in event "<<iEventID.event<<std::endl;
           abort();
         }
       }
@@ -12,7 +12,7 @@ class TestProductsOutputer : public OutputerBase {
   bool usesProductReadyAsync() const final;
 
 
-  void outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const final;
 
   void printSummary() const final;
  private:
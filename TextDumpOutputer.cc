@@ -2,13 +2,49 @@
 #include "OutputerFactory.h"
 #include "ConfigurationParameters.h"
 #include "DataProductRetriever.h"
+#include "summarize_queue.h"
+#include "lz4.h"
+#include <algorithm>
 #include <iostream>
 
 using namespace cce::tf;
 
+namespace {
+  unsigned int histogramBin(std::size_t iSize) {
+    //the number of bits needed to hold iSize
+    return iSize == 0 ? 0 : 64 - __builtin_clzll(iSize);
+  }
+}
+
+void TextDumpOutputer::ProductStatistics::fill(std::size_t iSize) {
+  sum_ += iSize;
+  min_ = std::min(min_, iSize);
+  max_ = std::max(max_, iSize);
+  ++histogram_[histogramBin(iSize)];
+}
+
+void TextDumpOutputer::ProductStatistics::add(ProductStatistics const& iOther) {
+  sum_ += iOther.sum_;
+  min_ = std::min(min_, iOther.min_);
+  max_ = std::max(max_, iOther.max_);
+  for(std::size_t i = 0; i < histogram_.size(); ++i) {
+    histogram_[i] += iOther.histogram_[i];
+  }
+  nCompressed_ += iOther.nCompressed_;
+  compressedSum_ += iOther.compressedSum_;
+  uncompressedSum_ += iOther.uncompressedSum_;
+}
+
 void TextDumpOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const& iProducts) {
-  if(iLaneIndex ==0 and summaryDump_) {
-    productSizes_ = std::vector<std::atomic<unsigned long long>>(iProducts.size());
+  auto& lane = laneData_[iLaneIndex];
+  if(summaryDump_) {
+    lane.products_.resize(iProducts.size());
+  }
+  if(perEventDump_) {
+    lane.eventSizes_.resize(iProducts.size());
+    lane.dump_.reserve(dumpBufferSize_);
+  }
+  if(iLaneIndex ==0) {
     productNames_.reserve(iProducts.size());
     for(auto const& prod: iProducts) {
       productNames_.emplace_back(prod.name());
@@ -16,43 +52,108 @@ void TextDumpOutputer::setupForLane(unsigned int iLaneIndex, std::vector<DataPro
   }
 }
 
+void TextDumpOutputer::estimateCompression(LaneData& iLane, ProductStatistics& iStats, DataProductRetriever const& iProduct) const {
+  auto blob = iProduct.serialized();
+  if(blob.empty()) {
+    return;
+  }
+  auto const bound = LZ4_compressBound(blob.size());
+  if(iLane.compressionBuffer_.size() < std::size_t(bound)) {
+    iLane.compressionBuffer_.resize(bound);
+  }
+  //the fast mode is enough to tell which products compress well
+  auto const cSize = LZ4_compress_default(blob.data(), iLane.compressionBuffer_.data(), blob.size(), bound);
+  ++iStats.nCompressed_;
+  iStats.uncompressedSum_ += blob.size();
+  iStats.compressedSum_ += cSize;
+}
 
 void TextDumpOutputer::productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const& iProduct, TaskHolder iCallback) const {
+  //only this task is handling this product of the Lane's event
+  auto& lane = laneData_[iLaneIndex];
   if(summaryDump_) {
-    auto& s = productSizes_[iProduct.index()];
-    s += iProduct.size();
+    auto& stats = lane.products_[iProduct.index()];
+    stats.fill(iProduct.size());
+    if(estimateCompression_) {
+      estimateCompression(lane, stats, iProduct);
+    }
   }
   if(perEventDump_) {
-    queue_.push(*iCallback.group(), [callback = std::move(iCallback), iLaneIndex, &iProduct]() mutable {
-        std::cout <<"lane: "<<iLaneIndex<<" product: "<<iProduct.name()<<" size:"<<iProduct.size()<<"\n";
-        callback.doneWaiting();
-      });
+    lane.eventSizes_[iProduct.index()] = iProduct.size();
   }
 }
 
-void TextDumpOutputer::outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+void TextDumpOutputer::flushDump(LaneData& iLane, TaskHolder iCallback) const {
+  queue_.push(*iCallback.group(), [callback = std::move(iCallback), dump = std::move(iLane.dump_)]() mutable {
+      std::cout <<dump;
+      callback.doneWaiting();
+    });
+  iLane.dump_ = std::string();
+  iLane.dump_.reserve(dumpBufferSize_);
+}
+
+void TextDumpOutputer::outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const {
+  auto& lane = laneData_[iLaneIndex];
   if(perEventDump_) {
-    queue_.push(*iCallback.group(), [callback = std::move(iCallback), iLaneIndex, iEventID]() mutable {
-        std::cout <<"lane: "<<iLaneIndex<<" finished event:"<<iEventID.run<<" "<<iEventID.lumi<<" "<<iEventID.event<<"\n";
-        callback.doneWaiting();
-      });
+    auto const laneName = std::to_string(iLaneIndex);
+    auto itSize = lane.eventSizes_.begin();
+    for(auto const& name: productNames_) {
+      lane.dump_.append("lane: ").append(laneName).append(" product: ").append(name)
+        .append(" size:").append(std::to_string(*itSize)).append("\n");
+      ++itSize;
+    }
+    lane.dump_.append("lane: ").append(laneName).append(" finished event:").append(std::to_string(iEventID.run))
+      .append(" ").append(std::to_string(iEventID.lumi)).append(" ").append(std::to_string(iEventID.event)).append("\n");
+    if(lane.dump_.size() >= dumpBufferSize_) {
+      flushDump(lane, std::move(iCallback));
+    }
   }
   if(summaryDump_) {
-    ++eventCount_;
+    ++lane.nEvents_;
   }
 }
 
 
 void TextDumpOutputer::printSummary() const {
+  //all events are done so what is left in the Lanes can be written directly
+  for(auto& lane: laneData_) {
+    std::cout <<lane.dump_;
+    lane.dump_.clear();
+  }
   if(summaryDump_) {
-    auto itSize = productSizes_.begin();
-    auto nEvents = eventCount_.load();
+    unsigned long long nEvents = 0;
+    std::vector<ProductStatistics> products(productNames_.size());
+    for(auto const& lane: laneData_) {
+      nEvents += lane.nEvents_;
+      for(std::size_t i = 0; i < lane.products_.size(); ++i) {
+        products[i].add(lane.products_[i]);
+      }
+    }
+    auto itStats = products.begin();
     for(auto const& name: productNames_) {
-      double aveSize = double(itSize->load())/nEvents;
-      std::cout <<"product: "<<name<<" ave size: "<<aveSize<<"\n";
-      ++itSize;
+      auto const& stats = *itStats;
+      double aveSize = double(stats.sum_)/nEvents;
+      std::cout <<"product: "<<name<<" ave size: "<<aveSize;
+      if(nEvents != 0) {
+        std::cout <<" min size: "<<stats.min_<<" max size: "<<stats.max_;
+      }
+      if(stats.nCompressed_ != 0) {
+        std::cout <<" ave LZ4 compressed size: "<<double(stats.compressedSum_)/stats.nCompressed_
+                  <<" compression ratio: "<<double(stats.uncompressedSum_)/std::max(stats.compressedSum_, 1ULL);
+      }
+      std::cout <<"\n";
+      //the bins are labeled by their smallest size
+      std::cout <<"  sizes:";
+      for(std::size_t i = 0; i < stats.histogram_.size(); ++i) {
+        if(stats.histogram_[i] != 0) {
+          std::cout <<" >="<<(i == 0 ? 0ULL : 1ULL << (i-1))<<":"<<stats.histogram_[i];
+        }
+      }
+      std::cout <<"\n";
+      ++itStats;
     }
   }
+  summarize_queue("output", queue_);
 }
 
 
@@ -63,7 +164,9 @@ namespace {
     std::unique_ptr<OutputerBase> create(unsigned int iNLanes, ConfigurationParameters const& params) const final {
       bool perEvent = params.get<bool>("perEvent",true);
       bool summary = params.get<bool>("summary", false);
-      return std::make_unique<TextDumpOutputer>(perEvent, summary);
+      bool estimateCompression = params.get<bool>("estimateCompression", false);
+      auto dumpBufferSize = params.get<std::size_t>("dumpBufferSize", 64*1024);
+      return std::make_unique<TextDumpOutputer>(iNLanes, perEvent, summary, estimateCompression, dumpBufferSize);
     }
     };
 
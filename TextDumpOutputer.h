@@ -1,30 +1,70 @@
 #if !defined(TextDumpOutputer_h)
 #define TextDumpOutputer_h
 
+#include <array>
+#include <limits>
+#include <string>
+#include <vector>
+
 #include "OutputerBase.h"
 #include "SerialTaskQueue.h"
+#include "PerLaneCounter.h"
 
 namespace cce::tf {
 class TextDumpOutputer final : public OutputerBase {
  public:
- TextDumpOutputer(bool perEventDump, bool summaryDump): eventCount_{0}, perEventDump_(perEventDump), summaryDump_(summaryDump) {}
+  TextDumpOutputer(unsigned int iNLanes, bool perEventDump, bool summaryDump, bool estimateCompression, std::size_t iDumpBufferSize):
+    laneData_(iNLanes), perEventDump_(perEventDump), summaryDump_(summaryDump), estimateCompression_(estimateCompression),
+    dumpBufferSize_(iDumpBufferSize) {}
 
   ~TextDumpOutputer() = default;
   
   void setupForLane(unsigned int iLaneIndex, std::vector<DataProductRetriever> const&);
   void productReadyAsync(unsigned int iLaneIndex, DataProductRetriever const&, TaskHolder iCallback) const;
 
-  void outputAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const;
+  void outputAsync(unsigned int iLaneIndex, long iEventIndex, EventIdentifier const& iEventID, TaskHolder iCallback) const;
   bool usesProductReadyAsync() const {return true;}
 
   void printSummary() const;
  private:
+    //number of entries with a size of 0, [1,2), [2,4), ... [2^62, 2^63) and >= 2^63
+    using SizeHistogram = std::array<unsigned long long, 65>;
+
+    struct ProductStatistics {
+      void fill(std::size_t iSize);
+      void add(ProductStatistics const&);
+
+      unsigned long long sum_ = 0;
+      std::size_t min_ = std::numeric_limits<std::size_t>::max();
+      std::size_t max_ = 0;
+      SizeHistogram histogram_ = {};
+      //only filled for products given to the Outputer as serialized bytes
+      unsigned long long nCompressed_ = 0;
+      unsigned long long compressedSum_ = 0;
+      unsigned long long uncompressedSum_ = 0;
+    };
+
+    //Only used by one Lane. Each product has its own entries since
+    // productReadyAsync may run concurrently for the different products of
+    // an event, while outputAsync is only run once all of them are done.
+    struct alignas(kCacheLineSize) LaneData {
+      std::vector<ProductStatistics> products_;
+      std::vector<std::size_t> eventSizes_;
+      std::vector<char> compressionBuffer_;
+      unsigned long long nEvents_ = 0;
+      std::string dump_;
+    };
+
+    void estimateCompression(LaneData&, ProductStatistics&, DataProductRetriever const&) const;
+    void flushDump(LaneData&, TaskHolder iCallback) const;
+
     mutable SerialTaskQueue queue_;
     std::vector<std::string> productNames_;
-    mutable std::vector<std::atomic<unsigned long long>> productSizes_;
-    mutable std::atomic<unsigned long> eventCount_;
+    mutable std::vector<LaneData> laneData_;
     bool perEventDump_;
     bool summaryDump_;
+    bool estimateCompression_;
+    std::size_t dumpBufferSize_;
 };
 }
 #endif
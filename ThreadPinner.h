@@ -0,0 +1,68 @@
+#if !defined(ThreadPinner_h)
+#define ThreadPinner_h
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include "tbb/task_scheduler_observer.h"
+
+#include "CPUAffinity.h"
+#include "RunReport.h"
+
+namespace cce::tf {
+  /**
+     Binds each thread, the TBB workers and the main thread, to one CPU the
+     first time it joins any task arena of the job. The threads get the CPUs
+     in the order given, in the order in which they first join. If there are
+     more threads than CPUs the order is started over.
+   */
+  class ThreadPinner : public tbb::task_scheduler_observer {
+  public:
+    explicit ThreadPinner(std::vector<int> iCPUs): cpus_{std::move(iCPUs)} { observe(true); }
+    ~ThreadPinner() { observe(false); }
+
+    void on_scheduler_entry(bool) final {
+      thread_local bool s_pinned = false;
+      if(s_pinned or cpus_.empty()) {
+        return;
+      }
+      s_pinned = true;
+      int const cpu = cpus_[next_.fetch_add(1) % cpus_.size()];
+      bool const pinned = pinThisThread({cpu});
+      std::lock_guard<std::mutex> guard(mutex_);
+      if(pinned) {
+        threadCPUs_.push_back(cpu);
+      } else {
+        ++nFailed_;
+      }
+    }
+
+    std::vector<int> const& cpus() const { return cpus_; }
+
+    void printSummary() const {
+      std::lock_guard<std::mutex> guard(mutex_);
+      std::cout <<"Thread affinity: pinned threads "<<threadCPUs_.size()<<" failed "<<nFailed_<<" CPUs in order:";
+      for(auto cpu: cpus_) {
+        std::cout <<" "<<cpu;
+      }
+      std::cout <<"\n";
+    }
+    void fillReport(RunReport& oReport) const {
+      std::lock_guard<std::mutex> guard(mutex_);
+      oReport.set("cpus", std::vector<double>(cpus_.begin(), cpus_.end()));
+      //the CPU of each pinned thread, in the order the threads were pinned
+      oReport.set("threadCPUs", std::vector<double>(threadCPUs_.begin(), threadCPUs_.end()));
+      oReport.set("failedThreads", nFailed_);
+    }
+
+  private:
+    std::vector<int> const cpus_;
+    std::atomic<unsigned int> next_{0};
+    mutable std::mutex mutex_;
+    std::vector<int> threadCPUs_;
+    unsigned int nFailed_ = 0;
+  };
+}
+#endif
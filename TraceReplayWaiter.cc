@@ -0,0 +1,262 @@
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <map>
+#include <memory>
+#include <iostream>
+#include "EventIdentifier.h"
+#include "DataProductRetriever.h"
+#include "TaskHolder.h"
+#include "WaiterBase.h"
+#include "WaiterFactory.h"
+#include "WaiterTimer.h"
+
+
+namespace cce::tf {
+  /**
+     Replays a trace of the modules run for each event. A module sleeps for its
+     duration once all the data products it consumes have been retrieved and
+     all the modules it runs after have finished, so modules of the same event
+     run concurrently as allowed by their dependencies.
+   */
+  class TraceReplayWaiter : public WaiterBase {
+ public:
+    struct Module {
+      std::string name_;
+      double time_;
+      std::vector<std::string> consumes_;
+      std::vector<unsigned int> after_;
+    };
+    struct TraceEvent {
+      std::vector<Module> modules_;
+      //modules which run after each module
+      std::vector<std::vector<unsigned int>> successors_;
+      //filled once the data product names are known
+      std::vector<std::vector<unsigned int>> consumers_;
+      std::vector<unsigned int> nDependencies_;
+      std::vector<unsigned int> roots_;
+    };
+
+    TraceReplayWaiter(std::vector<TraceEvent> iEvents, unsigned int iNLanes, bool iAsyncSleep):
+      events_(std::move(iEvents)),
+      laneStates_(iNLanes) {
+      if(iAsyncSleep) {
+        timer_ = std::make_unique<WaiterTimer>();
+      }
+    }
+
+    void waitAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, long iEventIndex,
+                   std::vector<DataProductRetriever> const& iRetrievers, unsigned int index,
+                   TaskHolder iCallback) const final {
+      std::call_once(resolved_, [this, &iRetrievers]() { resolveProducts(iRetrievers); });
+
+      auto const& event = events_[iEventIndex % events_.size()];
+      auto& state = laneStates_[iLaneIndex];
+      std::vector<unsigned int> ready;
+      {
+        std::lock_guard<std::mutex> guard(state.mutex_);
+        if(state.eventIndex_ != iEventIndex) {
+          //first data product of a new event
+          state.eventIndex_ = iEventIndex;
+          state.remaining_ = event.nDependencies_;
+          ready = event.roots_;
+        }
+        for(auto m: event.consumers_[index]) {
+          if(--state.remaining_[m] == 0) {
+            ready.push_back(m);
+          }
+        }
+      }
+      for(auto m: ready) {
+        runModule(iLaneIndex, event, m, iCallback);
+      }
+    }
+
+ private:
+    struct LaneState {
+      std::mutex mutex_;
+      long eventIndex_ = -1;
+      std::vector<unsigned int> remaining_;
+    };
+
+    //the module holds a copy of the callback so the event is not done before the module
+    void runModule(unsigned int iLaneIndex, TraceEvent const& iEvent, unsigned int iModule, TaskHolder iCallback) const {
+      using namespace std::chrono_literals;
+      auto time = iEvent.modules_[iModule].time_*1us;
+      if(timer_) {
+        timer_->callAfter(time, [this, iLaneIndex, &iEvent, iModule, callback = std::move(iCallback)]() {
+            moduleDone(iLaneIndex, iEvent, iModule, callback);
+          });
+        return;
+      }
+      auto group = iCallback.group();
+      group->run([this, iLaneIndex, &iEvent, iModule, time, callback = std::move(iCallback)]() {
+          std::this_thread::sleep_for(time);
+          moduleDone(iLaneIndex, iEvent, iModule, callback);
+        });
+    }
+
+    void moduleDone(unsigned int iLaneIndex, TraceEvent const& iEvent, unsigned int iModule, TaskHolder const& iCallback) const {
+      std::vector<unsigned int> ready;
+      {
+        auto& state = laneStates_[iLaneIndex];
+        std::lock_guard<std::mutex> guard(state.mutex_);
+        for(auto s: iEvent.successors_[iModule]) {
+          if(--state.remaining_[s] == 0) {
+            ready.push_back(s);
+          }
+        }
+      }
+      for(auto s: ready) {
+        runModule(iLaneIndex, iEvent, s, iCallback);
+      }
+    }
+
+    void resolveProducts(std::vector<DataProductRetriever> const& iRetrievers) const {
+      std::map<std::string, unsigned int> productIndices;
+      for(unsigned int i = 0; i < iRetrievers.size(); ++i) {
+        productIndices.emplace(iRetrievers[i].name(), i);
+      }
+      for(auto& event: events_) {
+        event.consumers_.assign(iRetrievers.size(), {});
+        event.nDependencies_.assign(event.modules_.size(), 0);
+        event.roots_.clear();
+        for(unsigned int m = 0; m < event.modules_.size(); ++m) {
+          auto const& module = event.modules_[m];
+          unsigned int nDependencies = module.after_.size();
+          for(auto const& product: module.consumes_) {
+            auto itFound = productIndices.find(product);
+            if(itFound == productIndices.end()) {
+              std::cout <<"TraceReplayWaiter: module "<<module.name_<<" consumes unknown data product "<<product<<", ignoring it"<<std::endl;
+              continue;
+            }
+            event.consumers_[itFound->second].push_back(m);
+            ++nDependencies;
+          }
+          event.nDependencies_[m] = nDependencies;
+          if(nDependencies == 0) {
+            event.roots_.push_back(m);
+          }
+        }
+      }
+    }
+
+    mutable std::vector<TraceEvent> events_;
+    mutable std::once_flag resolved_;
+    mutable std::vector<LaneState> laneStates_;
+    //only used for asyncSleep
+    std::unique_ptr<WaiterTimer> timer_;
+};
+}
+
+namespace {
+
+  using namespace cce::tf;
+
+  std::vector<std::string> splitList(std::string const& iList) {
+    std::vector<std::string> items;
+    if(iList == "-") {
+      return items;
+    }
+    std::istringstream stream(iList);
+    std::string item;
+    while(std::getline(stream, item, ',')) {
+      if(not item.empty()) {
+        items.push_back(item);
+      }
+    }
+    return items;
+  }
+
+  //returns false if a module is not listed before the modules which run after it
+  bool fillSuccessors(TraceReplayWaiter::TraceEvent& iEvent, std::map<std::string, unsigned int> const& iModuleIndices,
+                      std::vector<std::vector<std::string>> const& iAfterNames) {
+    iEvent.successors_.assign(iEvent.modules_.size(), {});
+    for(unsigned int m = 0; m < iEvent.modules_.size(); ++m) {
+      for(auto const& name: iAfterNames[m]) {
+        auto itFound = iModuleIndices.find(name);
+        if(itFound == iModuleIndices.end() or itFound->second >= m) {
+          std::cout <<"TraceReplayWaiter: module "<<iEvent.modules_[m].name_<<" runs after "<<name<<" which is not listed before it"<<std::endl;
+          return false;
+        }
+        iEvent.modules_[m].after_.push_back(itFound->second);
+        iEvent.successors_[itFound->second].push_back(m);
+      }
+    }
+    return true;
+  }
+
+  class Maker : public WaiterMakerBase {
+  public:
+    Maker(): WaiterMakerBase("TraceReplayWaiter") {}
+
+    std::unique_ptr<WaiterBase> create(unsigned int iNLanes, std::size_t iNDataProducts, ConfigurationParameters const& params) const final {
+      auto scale = params.get<float>("scale", 1.);
+
+      auto filename = params.get<std::string>("filename");
+      if(not filename) {
+        std::cout <<"no file name give for TraceReplayWaiter"<<std::endl;
+        return {};
+      }
+
+      std::ifstream file(*filename);
+      if(not file.is_open()) {
+        std::cout <<"unable to open file "<<*filename<<" with module traces";
+        return {};
+      }
+      std::vector<TraceReplayWaiter::TraceEvent> events;
+      std::map<std::string, unsigned int> moduleIndices;
+      std::vector<std::vector<std::string>> afterNames;
+      std::string line;
+      while(std::getline(file, line)) {
+        std::istringstream lineStream(line);
+        std::string first;
+        if(not (lineStream >> first) or first[0] == '#') {
+          continue;
+        }
+        if(first == "event") {
+          if(not events.empty() and not fillSuccessors(events.back(), moduleIndices, afterNames)) {
+            return {};
+          }
+          events.emplace_back();
+          moduleIndices.clear();
+          afterNames.clear();
+          continue;
+        }
+        if(events.empty()) {
+          std::cout <<"file "<<*filename<<" must start with 'event'"<<std::endl;
+          return {};
+        }
+        TraceReplayWaiter::Module module;
+        module.name_ = first;
+        std::string consumes;
+        std::string after;
+        if(not (lineStream >> module.time_ >> consumes >> after)) {
+          std::cout <<"badly formed line in "<<*filename<<": "<<line<<std::endl;
+          return {};
+        }
+        module.time_ *= scale;
+        module.consumes_ = splitList(consumes);
+        moduleIndices[module.name_] = events.back().modules_.size();
+        afterNames.push_back(splitList(after));
+        events.back().modules_.push_back(std::move(module));
+      }
+      if(events.empty()) {
+        std::cout <<"file "<<*filename<<" contained no events"<<std::endl;
+        return {};
+      }
+      if(not fillSuccessors(events.back(), moduleIndices, afterNames)) {
+        return {};
+      }
+
+      return std::make_unique<TraceReplayWaiter>(std::move(events), iNLanes, params.get<bool>("asyncSleep", false));
+    }
+
+  };
+
+  Maker s_maker;
+}
@@ -0,0 +1,105 @@
+#include "Tracer.h"
+#include "RunReport.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cce::tf {
+  std::atomic<bool> Tracer::s_enabled{false};
+
+  namespace {
+    //Lanes are given rows which can not clash with the thread ids
+    constexpr unsigned int kFirstLaneRow = 1000000;
+
+    struct Event {
+      std::string_view name_;
+      std::string_view category_;
+      Tracer::Clock::time_point start_;
+      Tracer::Clock::time_point end_;
+      unsigned int row_;
+    };
+
+    struct ThreadBuffer {
+      explicit ThreadBuffer(unsigned int iRow): row_{iRow} { events_.reserve(1 << 14); }
+      unsigned int row_;
+      std::vector<Event> events_;
+    };
+
+    std::mutex s_buffersMutex;
+    //buffers are kept after their thread ends
+    std::vector<std::unique_ptr<ThreadBuffer>> s_buffers;
+    Tracer::Clock::time_point s_origin;
+    thread_local ThreadBuffer* t_buffer = nullptr;
+
+    ThreadBuffer& threadBuffer() {
+      if(not t_buffer) {
+        std::lock_guard<std::mutex> guard(s_buffersMutex);
+        s_buffers.push_back(std::make_unique<ThreadBuffer>(s_buffers.size()+1));
+        t_buffer = s_buffers.back().get();
+      }
+      return *t_buffer;
+    }
+
+    double toMicroseconds(Tracer::Clock::duration iDuration) {
+      return std::chrono::duration<double, std::micro>(iDuration).count();
+    }
+
+    void writeThreadName(std::ostream& oStream, unsigned int iRow, std::string const& iName) {
+      oStream <<"{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "<<iRow
+              <<", \"args\": {\"name\": "<<jsonString(iName)<<"}}";
+    }
+  }
+
+  void Tracer::enable() {
+    std::lock_guard<std::mutex> guard(s_buffersMutex);
+    if(not enabled()) {
+      s_origin = Clock::now();
+      s_enabled.store(true);
+    }
+  }
+
+  void Tracer::record(std::string_view iName, std::string_view iCategory, Clock::time_point iStart, Clock::time_point iEnd) {
+    auto& buffer = threadBuffer();
+    buffer.events_.push_back({iName, iCategory, iStart, iEnd, buffer.row_});
+  }
+
+  void Tracer::recordForLane(unsigned int iLane, std::string_view iName, std::string_view iCategory, Clock::time_point iStart, Clock::time_point iEnd) {
+    threadBuffer().events_.push_back({iName, iCategory, iStart, iEnd, kFirstLaneRow+iLane});
+  }
+
+  void Tracer::write(std::ostream& oStream) {
+    std::lock_guard<std::mutex> guard(s_buffersMutex);
+    std::vector<unsigned int> laneRows;
+    oStream <<"{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    auto separate = [&first, &oStream]() {
+      if(not first) {
+        oStream <<",\n";
+      }
+      first = false;
+    };
+    oStream.precision(15);
+    for(auto const& buffer: s_buffers) {
+      separate();
+      writeThreadName(oStream, buffer->row_, "thread "+std::to_string(buffer->row_));
+      for(auto const& e: buffer->events_) {
+        if(e.row_ >= kFirstLaneRow and std::find(laneRows.begin(), laneRows.end(), e.row_) == laneRows.end()) {
+          laneRows.push_back(e.row_);
+        }
+        separate();
+        oStream <<"{\"name\": "<<jsonString(e.name_)<<", \"cat\": "<<jsonString(e.category_)
+                <<", \"ph\": \"X\", \"pid\": 1, \"tid\": "<<e.row_
+                <<", \"ts\": "<<toMicroseconds(e.start_ - s_origin)
+                <<", \"dur\": "<<toMicroseconds(e.end_ - e.start_)<<"}";
+      }
+    }
+    for(auto row: laneRows) {
+      separate();
+      writeThreadName(oStream, row, "Lane "+std::to_string(row-kFirstLaneRow));
+    }
+    oStream <<"\n]}\n";
+  }
+}
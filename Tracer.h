@@ -0,0 +1,60 @@
+#if !defined(Tracer_h)
+#define Tracer_h
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <string_view>
+
+namespace cce::tf {
+  /**
+     Collects the start and end times of tasks so they can be looked at as a
+     timeline, e.g. in chrome://tracing or Perfetto. Each thread records into
+     its own buffer so recording needs no locks. Nothing is recorded until
+     enable is called and the cost is then only a check of a flag.
+     The names and categories must stay valid until write is called.
+   */
+  class Tracer {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void enable();
+
+    //shown on the row of the calling thread
+    static void record(std::string_view iName, std::string_view iCategory, Clock::time_point iStart, Clock::time_point iEnd);
+    //shown on a row of its own for the Lane
+    static void recordForLane(unsigned int iLane, std::string_view iName, std::string_view iCategory, Clock::time_point iStart, Clock::time_point iEnd);
+
+    //writes everything recorded so far in the Chrome trace event format.
+    // Must not be called while other threads are still recording.
+    static void write(std::ostream&);
+
+  private:
+    static std::atomic<bool> s_enabled;
+  };
+
+  //records the time from its construction to its destruction
+  class TraceScope {
+  public:
+    TraceScope(std::string_view iName, std::string_view iCategory) {
+      if(Tracer::enabled()) {
+        name_ = iName;
+        category_ = iCategory;
+        start_ = Tracer::Clock::now();
+      }
+    }
+    ~TraceScope() {
+      if(not category_.empty()) {
+        Tracer::record(name_, category_, start_, Tracer::Clock::now());
+      }
+    }
+    TraceScope(TraceScope const&) = delete;
+    TraceScope& operator=(TraceScope const&) = delete;
+  private:
+    std::string_view name_;
+    std::string_view category_;
+    Tracer::Clock::time_point start_;
+  };
+}
+#endif
@@ -4,9 +4,21 @@
 
 #include "TStreamerElement.h"
 #include <iostream>
+#include <type_traits>
 
 using namespace cce::tf;
 using namespace cce::tf::unrolling;
 
-UnrolledDeserializer::UnrolledDeserializer(TClass* iClass): offsetAndSequences_{buildReadActionSequence(*iClass)}{}
+template<typename BUFFER>
+UnrolledDeserializerT<BUFFER>::UnrolledDeserializerT(TClass* iClass): offsetAndSequences_{buildReadActionSequence(*iClass)}, bufferFile_{TBuffer::kRead} {
+  if(useJit()) {
+    jitted_ = jitRead(*iClass, std::is_same_v<BUFFER, NativeEndianBufferFile>);
+    jitProxies_ = collectionsInJitOrder(offsetAndSequences_);
+  }
+}
+
+namespace cce::tf {
+  template class UnrolledDeserializerT<TBufferFile>;
+  template class UnrolledDeserializerT<NativeEndianBufferFile>;
+}
 
@@ -6,27 +6,39 @@
 #include "TClass.h"
 #include "TStreamerInfoActions.h"
 #include "common_unrolling.h"
+#include "jit_unrolling.h"
+#include "NativeEndianBufferFile.h"
 
 namespace cce::tf {
-class UnrolledDeserializer {
+//BUFFER must match the one used by the UnrolledSerializerT which wrote the data.
+//The buffer is reused for each call so an instance must only be used by one lane.
+template<typename BUFFER>
+class UnrolledDeserializerT {
 public:
-  UnrolledDeserializer(TClass*);
+  UnrolledDeserializerT(TClass*);
 
+  UnrolledDeserializerT(UnrolledDeserializerT&& iOther):
+    offsetAndSequences_(std::move(iOther.offsetAndSequences_)), jitted_(std::move(iOther.jitted_)), jitProxies_(std::move(iOther.jitProxies_)),
+    bufferFile_{TBuffer::kRead} {}
 
-  int deserialize(std::vector<char> const& iBuffer, void* iWriteTo) const {
+  UnrolledDeserializerT(UnrolledDeserializerT const& ) = delete;
+
+  int deserialize(std::vector<char> const& iBuffer, void* iWriteTo) {
     return deserialize(&iBuffer.front(), iBuffer.size(), iWriteTo);
   }
-  int deserialize(char const * iBuffer, size_t iBufferSize, void* iWriteTo) const{
-    TBufferFile bufferFile{TBuffer::kRead};
-
-    bufferFile.SetBuffer( const_cast<char*>(iBuffer), iBufferSize, kFALSE);
+  int deserialize(char const * iBuffer, size_t iBufferSize, void* iWriteTo) {
+    bufferFile_.SetBuffer( const_cast<char*>(iBuffer), iBufferSize, kFALSE);
 
-    deserialize(bufferFile, iWriteTo, offsetAndSequences_.m_objects, offsetAndSequences_.m_collections);
-    return bufferFile.Length();
+    if(jitted_) {
+      unrolling::readJitted(*jitted_, bufferFile_, iWriteTo, jitProxies_);
+    } else {
+      deserialize(bufferFile_, iWriteTo, offsetAndSequences_.m_objects, offsetAndSequences_.m_collections);
+    }
+    return bufferFile_.Length();
   }
 
 private:
-  void deserialize(TBufferFile& bufferFile, void* address, 
+  void deserialize(BUFFER& bufferFile, void* address, 
                    unrolling::OffsetAndSequences const& offsetAndSequences, unrolling::SequencesForCollections const& seq4Collections) const {
     for(auto& offNSeq: offsetAndSequences) {
       //seq->Print();
@@ -40,7 +52,11 @@ private:
       Int_t size;
       bufferFile >> size;      
       coll.m_collProxy->Allocate(size, true);
-      
+
+      if(coll.m_builtinType != kNoType_t) {
+        unrolling::readBuiltins(bufferFile, coll.m_builtinType, size ? (*coll.m_collProxy)[0] : nullptr, size);
+        continue;
+      }
       for(Int_t item=0; item<size; ++item) {
         auto elementAddress = (*coll.m_collProxy)[item];
         deserialize(bufferFile, elementAddress, coll.m_offsetAndSequences, coll.m_collections);
@@ -48,6 +64,13 @@ private:
     }
   }
   unrolling::ObjectAndCollectionsSequences offsetAndSequences_;
+  //set if unrolling::useJit() was on when constructed
+  std::shared_ptr<unrolling::JittedStreamer const> jitted_;
+  std::vector<TVirtualCollectionProxy*> jitProxies_;
+  BUFFER bufferFile_;
 };
+
+using UnrolledDeserializer = UnrolledDeserializerT<TBufferFile>;
+using NativeUnrolledDeserializer = UnrolledDeserializerT<NativeEndianBufferFile>;
 }
 #endif
@@ -5,10 +5,22 @@
 #include "TStreamerElement.h"
 
 #include <iostream>
+#include <type_traits>
 
 using namespace cce::tf;
 using namespace cce::tf::unrolling;
 
-UnrolledSerializer::UnrolledSerializer(TClass* iClass):
+template<typename BUFFER>
+UnrolledSerializerT<BUFFER>::UnrolledSerializerT(TClass* iClass):
   bufferFile_{TBuffer::kWrite},
-  offsetAndSequences_{buildWriteActionSequence(*iClass)} {}
+  offsetAndSequences_{buildWriteActionSequence(*iClass)} {
+  if(useJit()) {
+    jitted_ = jitWrite(*iClass, std::is_same_v<BUFFER, NativeEndianBufferFile>);
+    jitProxies_ = collectionsInJitOrder(offsetAndSequences_);
+  }
+}
+
+namespace cce::tf {
+  template class UnrolledSerializerT<TBufferFile>;
+  template class UnrolledSerializerT<NativeEndianBufferFile>;
+}
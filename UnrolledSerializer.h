@@ -1,37 +1,167 @@
 #if !defined(UnrolledSerializer_h)
 #define UnrolledSerializer_h
 
+#include <algorithm>
+#include <memory>
 #include <vector>
 #include "TBufferFile.h"
 #include "TClass.h"
 #include "TStreamerInfoActions.h"
 #include "common_unrolling.h"
+#include "jit_unrolling.h"
+#include "BlobView.h"
+#include "NativeEndianBufferFile.h"
 
 namespace cce::tf {
-class UnrolledSerializer {
+//BUFFER is the TBufferFile type used to stream, which sets the byte order of the numbers
+template<typename BUFFER>
+class UnrolledSerializerT {
 public:
-  UnrolledSerializer(TClass*);
+  UnrolledSerializerT(TClass*);
 
-  UnrolledSerializer(UnrolledSerializer&& iOther):
-  bufferFile_{TBuffer::kWrite}, offsetAndSequences_(std::move(iOther.offsetAndSequences_))  {}
+  UnrolledSerializerT(UnrolledSerializerT&& iOther):
+  bufferFile_{TBuffer::kWrite, iOther.bufferFile_.BufferSize()}, offsetAndSequences_(std::move(iOther.offsetAndSequences_)),
+  jitted_(std::move(iOther.jitted_)), jitProxies_(std::move(iOther.jitProxies_)), chunkElements_(iOther.chunkElements_) {}
   
-  UnrolledSerializer(UnrolledSerializer const& ) = delete;
+  UnrolledSerializerT(UnrolledSerializerT const& ) = delete;
 
   std::vector<char> serialize(void const* address) {
     bufferFile_.Reset();
 
-    serialize(address, offsetAndSequences_.m_objects, offsetAndSequences_.m_collections);
+    serializeObject(address);
 
     //The blob contains the serialized data product
     std::vector<char> blob(bufferFile_.Buffer(), bufferFile_.Buffer()+bufferFile_.Length());
     return blob;
   }
 
+  //Avoids copying the serialized data product. The view is valid until the next call.
+  BlobView serializeToView(void const* address) {
+    bufferFile_.Reset();
+
+    serializeObject(address);
+    return BlobView(bufferFile_.Buffer(), bufferFile_.Length());
+  }
+
+  int capacity() const { return bufferFile_.BufferSize(); }
+  //grows the buffer once up front rather than through repeated expansions while writing
+  void reserve(int iSize) {
+    if(iSize > bufferFile_.BufferSize()) {
+      bufferFile_.Expand(iSize, false);
+    }
+  }
+
+  //Top level collections, i.e. those not inside another collection, with more
+  // than iElements elements are serialized in chunks of iElements elements
+  // by startChunked and serializeChunk. 0, the default, means no chunks.
+  void setChunkElements(unsigned int iElements) { chunkElements_ = iElements; }
+  unsigned int chunkElements() const { return chunkElements_; }
+
+  //Serializes all but the chunks of the large collections and returns the
+  // number of chunks. Each chunk must then be given to serializeChunk, which
+  // can be called concurrently for different chunks, before finishChunked
+  // gives the same bytes serializeToView would. The view is valid until the next call.
+  std::size_t startChunked(void const* address) {
+    bufferFile_.Reset();
+    activeChunks_.clear();
+    chunkedCollections_.clear();
+
+    for(auto& offAndSeq: offsetAndSequences_.m_objects) {
+      bufferFile_.ApplySequence(*(offAndSeq.second), const_cast<char*>(static_cast<char const*>(address)+offAndSeq.first));
+    }
+    auto& collections = offsetAndSequences_.m_collections;
+    if(chunksPerCollection_.size() < collections.size()) {
+      chunksPerCollection_.resize(collections.size());
+    }
+    for(std::size_t index = 0; index < collections.size(); ++index) {
+      auto& coll = collections[index];
+      auto collAddress = static_cast<char const*>(address) + coll.m_offset;
+
+      TVirtualCollectionProxy::TPushPop helper(coll.m_collProxy.get(), const_cast<char*>(collAddress));
+      Int_t size =coll.m_collProxy->Size();
+      bufferFile_ << size;
+
+      if(coll.m_builtinType != kNoType_t) {
+        unrolling::writeBuiltins(bufferFile_, coll.m_builtinType, size ? (*coll.m_collProxy)[0] : nullptr, size);
+        continue;
+      }
+      if(static_cast<unsigned int>(size) <= chunkElements_) {
+        for(Int_t item=0; item<size; ++item) {
+          serialize(bufferFile_, (*coll.m_collProxy)[item], coll.m_offsetAndSequences, coll.m_collections);
+        }
+        continue;
+      }
+      //only std::vectors are unrolled so the elements are contiguous
+      std::size_t const stride = coll.m_collProxy->GetValueClass()->Size();
+      auto const first = static_cast<char const*>((*coll.m_collProxy)[0]);
+      std::size_t const nChunks = (size + chunkElements_ - 1)/chunkElements_;
+      auto& chunks = chunksPerCollection_[index];
+      while(chunks.size() < nChunks) {
+        chunks.push_back(std::make_unique<Chunk>(coll));
+      }
+      chunkedCollections_.push_back({bufferFile_.Length(), activeChunks_.size(), nChunks});
+      for(std::size_t i = 0; i < nChunks; ++i) {
+        auto& chunk = *chunks[i];
+        chunk.first_ = first + i*chunkElements_*stride;
+        chunk.stride_ = stride;
+        chunk.nElements_ = std::min<Int_t>(chunkElements_, size - i*chunkElements_);
+        activeChunks_.push_back(&chunk);
+      }
+    }
+    return activeChunks_.size();
+  }
+
+  void serializeChunk(std::size_t iChunk) {
+    auto& chunk = *activeChunks_[iChunk];
+    chunk.buffer_.Reset();
+    for(Int_t item=0; item<chunk.nElements_; ++item) {
+      serialize(chunk.buffer_, chunk.first_ + item*chunk.stride_, chunk.collection_.m_offsetAndSequences, chunk.collection_.m_collections);
+    }
+  }
+
+  BlobView finishChunked() {
+    if(chunkedCollections_.empty()) {
+      return BlobView(bufferFile_.Buffer(), bufferFile_.Length());
+    }
+    std::size_t size = bufferFile_.Length();
+    for(auto const* chunk: activeChunks_) {
+      size += chunk->buffer_.Length();
+    }
+    assembled_.clear();
+    assembled_.reserve(size);
+    int position = 0;
+    for(auto const& c: chunkedCollections_) {
+      assembled_.insert(assembled_.end(), bufferFile_.Buffer()+position, bufferFile_.Buffer()+c.bufferPosition_);
+      for(std::size_t i = c.firstChunk_; i < c.firstChunk_+c.nChunks_; ++i) {
+        auto const& buffer = activeChunks_[i]->buffer_;
+        assembled_.insert(assembled_.end(), buffer.Buffer(), buffer.Buffer()+buffer.Length());
+      }
+      position = c.bufferPosition_;
+    }
+    assembled_.insert(assembled_.end(), bufferFile_.Buffer()+position, bufferFile_.Buffer()+bufferFile_.Length());
+    return BlobView(assembled_.data(), assembled_.size());
+  }
+
+  //Appends the serialized data product to iBuffer, e.g. a buffer shared by the data products of an event
+  void serializeInto(BUFFER& iBuffer, void const* address) {
+    if(jitted_) {
+      unrolling::writeJitted(*jitted_, iBuffer, address, jitProxies_);
+      return;
+    }
+    serialize(iBuffer, address, offsetAndSequences_.m_objects, offsetAndSequences_.m_collections);
+  }
+
+  using Buffer = BUFFER;
+
 private:
-  void serialize(void const* address, unrolling::OffsetAndSequences& offsetAndSequences, unrolling::SequencesForCollections& seq4Collections) {
+  void serializeObject(void const* address) {
+    serializeInto(bufferFile_, address);
+  }
+
+  static void serialize(BUFFER& buffer, void const* address, unrolling::OffsetAndSequences& offsetAndSequences, unrolling::SequencesForCollections& seq4Collections) {
     for(auto& offAndSeq: offsetAndSequences) {
       //seq->Print();
-      bufferFile_.ApplySequence(*(offAndSeq.second), const_cast<char*>(static_cast<char const*>(address)+offAndSeq.first));
+      buffer.ApplySequence(*(offAndSeq.second), const_cast<char*>(static_cast<char const*>(address)+offAndSeq.first));
     }
 
     for(auto& coll: seq4Collections) {
@@ -39,17 +169,54 @@ private:
 
       TVirtualCollectionProxy::TPushPop helper(coll.m_collProxy.get(), const_cast<char*>(collAddress));
       Int_t size =coll.m_collProxy->Size();
-      bufferFile_ << size;
+      buffer << size;
 
+      if(coll.m_builtinType != kNoType_t) {
+        unrolling::writeBuiltins(buffer, coll.m_builtinType, size ? (*coll.m_collProxy)[0] : nullptr, size);
+        continue;
+      }
       for(Int_t item=0; item<size; ++item) {
         auto elementAddress = (*coll.m_collProxy)[item];
-        serialize(elementAddress, coll.m_offsetAndSequences, coll.m_collections);
+        serialize(buffer, elementAddress, coll.m_offsetAndSequences, coll.m_collections);
       }
     }
   }
 
-  TBufferFile bufferFile_;
+  //Elements [first_, first_+nElements_*stride_) of a top level collection
+  // streamed into a buffer of their own. The bytes are those the elements add
+  // to the blob when serialized in one go.
+  struct Chunk {
+    explicit Chunk(unrolling::CollectionActions const& iCollection):
+      buffer_{TBuffer::kWrite}, collection_{unrolling::copyCollectionActions(iCollection)} {}
+
+    BUFFER buffer_;
+    unrolling::CollectionActions collection_;
+    char const* first_ = nullptr;
+    std::size_t stride_ = 0;
+    Int_t nElements_ = 0;
+  };
+  //the chunks go into the blob at bufferPosition_ of bufferFile_
+  struct ChunkedCollection {
+    int bufferPosition_;
+    std::size_t firstChunk_;
+    std::size_t nChunks_;
+  };
+
+  BUFFER bufferFile_;
   unrolling::ObjectAndCollectionsSequences offsetAndSequences_;
+  //set if unrolling::useJit() was on when constructed
+  std::shared_ptr<unrolling::JittedStreamer const> jitted_;
+  std::vector<TVirtualCollectionProxy*> jitProxies_;
+
+  unsigned int chunkElements_ = 0;
+  //reused from event to event, one list per top level collection
+  std::vector<std::vector<std::unique_ptr<Chunk>>> chunksPerCollection_;
+  std::vector<Chunk*> activeChunks_;
+  std::vector<ChunkedCollection> chunkedCollections_;
+  std::vector<char> assembled_;
 };
+
+using UnrolledSerializer = UnrolledSerializerT<TBufferFile>;
+using NativeUnrolledSerializer = UnrolledSerializerT<NativeEndianBufferFile>;
 }
 #endif
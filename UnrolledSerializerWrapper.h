@@ -3,42 +3,124 @@
 
 #include <vector>
 #include <chrono>
+#include <type_traits>
 #include "TClass.h"
+#include "SerializedSizeStats.h"
+#include "ProductProfile.h"
 
 #include "tbb/task_group.h"
 #include "UnrolledSerializer.h"
 #include "TaskHolder.h"
+#include "FunctorTask.h"
 
 namespace cce::tf {
-class UnrolledSerializerWrapper {
+template<typename SERIALIZER>
+class UnrolledSerializerWrapperT {
 public:
- UnrolledSerializerWrapper(std::string_view iName,  TClass* tClass):
+ UnrolledSerializerWrapperT(std::string_view iName,  TClass* tClass):
   name_{iName}, class_(tClass), serializer_{tClass},
-  accumulatedTime_{std::chrono::microseconds::zero()} {}
+  accumulatedTime_{std::chrono::microseconds::zero()} {
+    if(auto profile = serializationProfile(iName)) {
+      serializer_.reserve(profile->p99Bytes_);
+    }
+  }
 
   void doWorkAsync(tbb::task_group& iGroup, void** iAddress, TaskHolder iCallback) {
+    if(serializer_.chunkElements() != 0) {
+      doChunkedWorkAsync(iGroup, iAddress, std::move(iCallback));
+      return;
+    }
     iGroup.run([this, iAddress, callback=std::move(iCallback)] () {
-	{
-          //gDebug=3;
-	  auto start = std::chrono::high_resolution_clock::now();
-	  blob_ = serializer_.serialize(*iAddress);
-          //gDebug=0;
-	  accumulatedTime_ += std::chrono::duration_cast<decltype(accumulatedTime_)>(std::chrono::high_resolution_clock::now() - start);
-	}
+	doWork(iAddress);
 	const_cast<TaskHolder&>(callback).doneWaiting();
       });
   }
-  std::vector<char> const& blob() const {return blob_;}
+  //serializes in the calling task
+  void doWork(void** iAddress) {
+    //gDebug=3;
+    auto start = std::chrono::high_resolution_clock::now();
+    serializer_.reserve(sizeStats_.p99());
+    auto const capacity = serializer_.capacity();
+    blob_ = serializer_.serializeToView(*iAddress);
+    if(serializer_.capacity() > capacity) {
+      ++nExpansions_;
+    }
+    sizeStats_.fill(blob_.size());
+    //gDebug=0;
+    accumulatedTime_ += std::chrono::duration_cast<decltype(accumulatedTime_)>(std::chrono::high_resolution_clock::now() - start);
+  }
+  //The chunks of large top level collections are serialized by their own
+  // tasks, see UnrolledSerializerT::setChunkElements. The blob is the same.
+  void doChunkedWorkAsync(tbb::task_group& iGroup, void** iAddress, TaskHolder iCallback) {
+    iGroup.run([this, &iGroup, iAddress, callback=std::move(iCallback)] () {
+        auto start = std::chrono::high_resolution_clock::now();
+        auto const nChunks = serializer_.startChunked(*iAddress);
+        TaskHolder assembled(iGroup, make_functor_task([this, start, callback]() {
+              blob_ = serializer_.finishChunked();
+              sizeStats_.fill(blob_.size());
+              accumulatedTime_ += std::chrono::duration_cast<decltype(accumulatedTime_)>(std::chrono::high_resolution_clock::now() - start);
+              const_cast<TaskHolder&>(callback).doneWaiting();
+            }));
+        if(nChunks == 0) {
+          return;
+        }
+        ++nChunked_;
+        for(std::size_t i = 1; i < nChunks; ++i) {
+          iGroup.run([this, i, assembled]() {
+              serializer_.serializeChunk(i);
+            });
+        }
+        serializer_.serializeChunk(0);
+      });
+  }
+  //Appends the data product to iBuffer, see EventSerializationBuffer. Returns false if the
+  // serialization does not write a TBufferFile or the bytes refer to positions in the buffer.
+  bool serializeInto(TBufferFile& iBuffer, void** iAddress, int& oStart, int& oLength) {
+    if constexpr(not std::is_same_v<typename SERIALIZER::Buffer, TBufferFile>) {
+      //the numbers are written in a different byte order
+      return false;
+    } else {
+      auto start = std::chrono::high_resolution_clock::now();
+      oStart = iBuffer.Length();
+      iBuffer.ResetMap();
+      serializer_.serializeInto(iBuffer, *iAddress);
+      if(iBuffer.GetMapCount() != 0) {
+        iBuffer.SetBufferOffset(oStart);
+        iBuffer.ResetMap();
+        return false;
+      }
+      oLength = iBuffer.Length() - oStart;
+      sizeStats_.fill(oLength);
+      accumulatedTime_ += std::chrono::duration_cast<decltype(accumulatedTime_)>(std::chrono::high_resolution_clock::now() - start);
+      return true;
+    }
+  }
+  void setChunkElements(unsigned int iElements) { serializer_.setChunkElements(iElements); }
+  //number of serializations which were split into chunks
+  unsigned long long nChunked() const { return nChunked_; }
+
+  BlobView blob() const {return blob_;}
 
   std::string_view  name() const {return name_;}
   char const* className() const { return class_->GetName(); }
   std::chrono::microseconds accumulatedTime() const { return accumulatedTime_;}
+  //number of times the buffer had to grow while serializing
+  unsigned int nExpansions() const { return nExpansions_;}
+  //bytes held by the serialization buffer
+  std::size_t bufferCapacity() const { return serializer_.capacity();}
+  SerializedSizeStats const& sizeStats() const { return sizeStats_;}
 private:
-  std::vector<char> blob_;
+  BlobView blob_;
   std::string_view name_;
   TClass const* class_;
-  UnrolledSerializer serializer_;
+  SERIALIZER serializer_;
   std::chrono::microseconds accumulatedTime_;
+  SerializedSizeStats sizeStats_;
+  unsigned int nExpansions_ = 0;
+  unsigned long long nChunked_ = 0;
 };
+
+using UnrolledSerializerWrapper = UnrolledSerializerWrapperT<UnrolledSerializer>;
+using NativeUnrolledSerializerWrapper = UnrolledSerializerWrapperT<NativeUnrolledSerializer>;
 }
 #endif
@@ -3,9 +3,12 @@
 
 #include <vector>
 #include <thread>
+#include <optional>
 #include "EventIdentifier.h"
 #include "DataProductRetriever.h"
 #include "TaskHolder.h"
+#include "RunReport.h"
+#include "ProductNeeds.h"
 
 namespace cce::tf {
 class WaiterBase {
@@ -18,6 +21,16 @@ class WaiterBase {
   // iEventIndex is the index of the event within the Source
   // iProductIndex is which element of iRetrievers is to be waited upon
   virtual void waitAsync(unsigned int iLaneIndex, EventIdentifier const& iEventID, long iEventIndex, std::vector<DataProductRetriever> const& iRetrievers, unsigned int iProductIndex, TaskHolder iCallback) const = 0;
+
+  virtual void fillReport(RunReport&) const {}
+
+  //The data products waitAsync is called for, in that order. Nothing if not declared,
+  // in which case it is called for all data products the job needs.
+  std::optional<ProductNeeds> const& neededProducts() const { return neededProducts_; }
+  void setNeededProducts(ProductNeeds iNeeds) { neededProducts_ = std::move(iNeeds); }
+
+ private:
+  std::optional<ProductNeeds> neededProducts_;
 };
 }
 #endif
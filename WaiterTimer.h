@@ -0,0 +1,87 @@
+#if !defined(WaiterTimer_h)
+#define WaiterTimer_h
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "CPUAffinity.h"
+
+namespace cce::tf {
+  /**
+     Calls functions once their delay has passed using a dedicated thread, so
+     a waiter can wait without blocking a TBB worker. The functions are called
+     from the timer's thread and so should only be used to release a TaskHolder
+     or start new tasks.
+
+     callAfter() can be called concurrently.
+   */
+  class WaiterTimer {
+  public:
+    WaiterTimer(): thread_{[this]() { pinDedicatedThread(); run(); }} {}
+
+    //functions whose deadline has not yet passed are called before returning
+    ~WaiterTimer() {
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        stop_ = true;
+      }
+      cv_.notify_all();
+      thread_.join();
+    }
+
+    WaiterTimer(WaiterTimer const&) = delete;
+    WaiterTimer& operator=(WaiterTimer const&) = delete;
+
+    template<typename Rep, typename Period>
+    void callAfter(std::chrono::duration<Rep, Period> iDelay, std::function<void()> iFunction) {
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(iDelay);
+      bool earliest;
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        earliest = deadlines_.empty() or deadline < deadlines_.begin()->first;
+        deadlines_.emplace(deadline, std::move(iFunction));
+      }
+      //only need to wake the thread if it has to wait for less time
+      if(earliest) {
+        cv_.notify_all();
+      }
+    }
+
+  private:
+    void run() {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while(true) {
+        if(deadlines_.empty()) {
+          if(stop_) {
+            return;
+          }
+          cv_.wait(lock);
+          continue;
+        }
+        auto it = deadlines_.begin();
+        if(not stop_ and std::chrono::steady_clock::now() < it->first) {
+          cv_.wait_until(lock, it->first);
+          continue;
+        }
+        auto function = std::move(it->second);
+        deadlines_.erase(it);
+        lock.unlock();
+        function();
+        lock.lock();
+      }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> deadlines_;
+    bool stop_ = false;
+
+    //must be last so all other members are initialized before the thread starts
+    std::thread thread_;
+  };
+}
+#endif
@@ -0,0 +1,135 @@
+#if !defined(WriteBehindBuffer_h)
+#define WriteBehindBuffer_h
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "CPUAffinity.h"
+
+namespace cce::tf {
+  /**
+     Uses a dedicated thread to do writes so the caller does not wait on the
+     file system. Once more than iMaxBytes bytes are waiting to be written,
+     functions passed to whenWritten are held until the last pushed buffer is
+     written. Holding a Lane's callback that way bounds the memory used.
+
+     push() and whenWritten() are expected to be called serially, e.g. from a SerialTaskQueue.
+   */
+  class WriteBehindBuffer {
+  public:
+    WriteBehindBuffer(std::size_t iMaxBytes, std::function<void(std::vector<char> const&)> iWrite):
+      write_{std::move(iWrite)}, maxBytes_{iMaxBytes},
+      thread_{[this]() { pinDedicatedThread(); run(); }} {}
+
+    //all pushed buffers are written before returning
+    ~WriteBehindBuffer() {
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        stop_ = true;
+      }
+      cv_.notify_all();
+      thread_.join();
+    }
+
+    WriteBehindBuffer(WriteBehindBuffer const&) = delete;
+    WriteBehindBuffer& operator=(WriteBehindBuffer const&) = delete;
+
+    void push(std::vector<char> iBuffer) {
+      if(iBuffer.empty()) {
+        return;
+      }
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        bytes_ += iBuffer.size();
+        if(bytes_ > maxBytesHeld_) {
+          maxBytesHeld_ = bytes_;
+        }
+        entries_.push_back({std::move(iBuffer), {}});
+      }
+      cv_.notify_all();
+    }
+
+    //iDone is called now unless too many bytes are waiting, else once the last pushed buffer is written
+    void whenWritten(std::function<void()> iDone) {
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if(bytes_ > maxBytes_ and not entries_.empty()) {
+          ++nDelayed_;
+          entries_.back().whenWritten_.push_back(std::move(iDone));
+          return;
+        }
+      }
+      iDone();
+    }
+
+    //returns once all pushed buffers are written
+    void waitForWrites() {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return entries_.empty(); });
+    }
+
+    ///number of whenWritten calls which had to wait for a write
+    unsigned long long nDelayed() const { return nDelayed_; }
+    ///largest number of bytes waiting to be written
+    std::size_t maxBytesHeld() const { return maxBytesHeld_; }
+    ///time the thread spent writing
+    std::chrono::microseconds writeTime() const { return writeTime_; }
+
+  private:
+    struct Entry {
+      std::vector<char> buffer_;
+      std::vector<std::function<void()>> whenWritten_;
+    };
+
+    void run() {
+      while(true) {
+        Entry entry;
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          cv_.wait(lock, [this]() { return stop_ or not entries_.empty(); });
+          if(entries_.empty()) {
+            return;
+          }
+          //keep the entry in the queue so whenWritten can still attach to it
+          entry.buffer_ = std::move(entries_.front().buffer_);
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        write_(entry.buffer_);
+        writeTime_ += std::chrono::duration_cast<decltype(writeTime_)>(std::chrono::high_resolution_clock::now() - start);
+        {
+          std::lock_guard<std::mutex> guard(mutex_);
+          bytes_ -= entry.buffer_.size();
+          entry.whenWritten_ = std::move(entries_.front().whenWritten_);
+          entries_.pop_front();
+        }
+        //wakes waitForWrites
+        cv_.notify_all();
+        for(auto& done: entry.whenWritten_) {
+          done();
+        }
+      }
+    }
+
+    std::function<void(std::vector<char> const&)> write_;
+    std::size_t const maxBytes_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Entry> entries_;
+    std::size_t bytes_ = 0;
+    bool stop_ = false;
+
+    unsigned long long nDelayed_ = 0;
+    std::size_t maxBytesHeld_ = 0;
+    std::chrono::microseconds writeTime_ = std::chrono::microseconds::zero();
+
+    //must be last so all other members are initialized before the thread starts
+    std::thread thread_;
+  };
+}
+#endif
@@ -0,0 +1,86 @@
+#include "arrow_common.h"
+
+#include "TClass.h"
+#include "TDataType.h"
+#include "TVirtualCollectionProxy.h"
+
+#include <fstream>
+#include <stdexcept>
+
+using namespace cce::tf;
+
+std::shared_ptr<arrow::DataType> arrowcolumns::listElementType(TClass& iClass) {
+  auto proxy = iClass.GetCollectionProxy();
+  if(not proxy or proxy->GetCollectionType() != ROOT::kSTLvector or proxy->GetValueClass() or proxy->HasPointers()) {
+    return {};
+  }
+  switch(proxy->GetType()) {
+  case kChar_t: return arrow::int8();
+  case kUChar_t: return arrow::uint8();
+  case kShort_t: return arrow::int16();
+  case kUShort_t: return arrow::uint16();
+  case kInt_t: return arrow::int32();
+  case kUInt_t: return arrow::uint32();
+  case kLong_t:
+  case kLong64_t: return arrow::int64();
+  case kULong_t:
+  case kULong64_t: return arrow::uint64();
+  case kFloat_t: return arrow::float32();
+  case kDouble_t: return arrow::float64();
+  default: return {};
+  }
+}
+
+std::size_t arrowcolumns::elementSize(arrow::DataType const& iType) {
+  return static_cast<arrow::FixedWidthType const&>(iType).bit_width()/8;
+}
+
+std::pair<std::size_t, void const*> arrowcolumns::vectorElements(TVirtualCollectionProxy& iProxy, void* iObject) {
+  TVirtualCollectionProxy::TPushPop helper(&iProxy, iObject);
+  std::size_t size = iProxy.Size();
+  return {size, size == 0 ? nullptr : iProxy.At(0)};
+}
+
+void* arrowcolumns::resizeVector(TVirtualCollectionProxy& iProxy, void* iObject, std::size_t iSize) {
+  TVirtualCollectionProxy::TPushPop helper(&iProxy, iObject);
+  iProxy.Allocate(iSize, true);
+  return iSize == 0 ? nullptr : iProxy.At(0);
+}
+
+std::optional<arrowcolumns::Format> arrowcolumns::toFormat(std::string const& iName) {
+  if(iName == "parquet") {
+    return Format::kParquet;
+  }
+  if(iName == "ipc") {
+    return Format::kIPC;
+  }
+  return {};
+}
+
+std::optional<arrowcolumns::Format> arrowcolumns::formatOfFile(std::string const& iFileName) {
+  std::ifstream file(iFileName, std::ios_base::binary);
+  char magic[6] = {};
+  file.read(magic, sizeof(magic));
+  if(file.gcount() >= 4 and std::string(magic, 4) == "PAR1") {
+    return Format::kParquet;
+  }
+  if(file.gcount() == 6 and std::string(magic, 6) == "ARROW1") {
+    return Format::kIPC;
+  }
+  return {};
+}
+
+std::optional<arrow::Compression::type> arrowcolumns::toArrowCompression(pds::Compression iCompression, Format iFormat) {
+  switch(iCompression) {
+  case pds::Compression::kNone: return arrow::Compression::UNCOMPRESSED;
+  case pds::Compression::kLZ4: return iFormat == Format::kParquet ? arrow::Compression::LZ4_RAW : arrow::Compression::LZ4_FRAME;
+  case pds::Compression::kZSTD: return arrow::Compression::ZSTD;
+  default: return {};
+  }
+}
+
+void arrowcolumns::check(arrow::Status const& iStatus, char const* iWhat) {
+  if(not iStatus.ok()) {
+    throw std::runtime_error(std::string(iWhat)+" failed: "+iStatus.ToString());
+  }
+}
@@ -0,0 +1,52 @@
+#if !defined(arrow_common_h)
+#define arrow_common_h
+
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "arrow/api.h"
+
+#include "pds_common.h"
+
+class TClass;
+class TVirtualCollectionProxy;
+
+namespace cce::tf::arrowcolumns {
+  //key of the file metadata holding the pds::Serialization of the binary columns
+  constexpr char const* const kSerializationKey = "serialization";
+  //key of the field metadata holding the class name of the data product
+  constexpr char const* const kClassNameKey = "classname";
+  //names of the columns holding the EventIdentifier
+  constexpr char const* const kRunColumn = "run";
+  constexpr char const* const kLumiColumn = "lumi";
+  constexpr char const* const kEventColumn = "event";
+
+  //The type of the elements of iClass if it is a std::vector of a number whose
+  // elements can be copied directly into a list column, else nullptr.
+  // std::vector<bool> does not hold its elements contiguously so is not one.
+  std::shared_ptr<arrow::DataType> listElementType(TClass& iClass);
+  std::size_t elementSize(arrow::DataType const&);
+
+  //the number of elements of the std::vector at iObject and where they start
+  std::pair<std::size_t, void const*> vectorElements(TVirtualCollectionProxy&, void* iObject);
+  //resizes the std::vector at iObject to iSize elements and returns where they start
+  void* resizeVector(TVirtualCollectionProxy&, void* iObject, std::size_t iSize);
+
+  enum class Format {kParquet, kIPC};
+  std::optional<Format> toFormat(std::string const&);
+  //from the magic bytes at the start of the file
+  std::optional<Format> formatOfFile(std::string const& iFileName);
+
+  //only None, LZ4 and ZSTD are supported by both Parquet and Arrow IPC, which use different LZ4 framings
+  std::optional<arrow::Compression::type> toArrowCompression(pds::Compression, Format);
+
+  //throws std::runtime_error with iWhat if iStatus is not ok
+  void check(arrow::Status const& iStatus, char const* iWhat);
+  template<typename T>
+  T check(arrow::Result<T> iResult, char const* iWhat) {
+    check(iResult.status(), iWhat);
+    return std::move(iResult).ValueUnsafe();
+  }
+}
+#endif
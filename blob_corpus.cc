@@ -0,0 +1,103 @@
+#include "blob_corpus.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace cce::tf::corpus {
+  namespace {
+    void writeWord(std::ofstream& iFile, uint32_t iWord) {
+      iFile.write(reinterpret_cast<char const*>(&iWord), sizeof(iWord));
+    }
+
+    bool readWord(std::ifstream& iFile, uint32_t& oWord) {
+      return static_cast<bool>(iFile.read(reinterpret_cast<char*>(&oWord), sizeof(oWord)));
+    }
+  }
+
+  std::string fileName(std::string_view iClassName) {
+    std::string name;
+    name.reserve(iClassName.size()+kFileSuffix.size());
+    for(auto c: iClassName) {
+      if(std::isalnum(static_cast<unsigned char>(c)) or c == '_' or c == '.') {
+        name.push_back(c);
+      } else if(c != ' ') {
+        name.push_back('_');
+      }
+    }
+    name += kFileSuffix;
+    return name;
+  }
+
+  CorpusWriter::CorpusWriter(std::string const& iDirectory, std::string_view iClassName, uint32_t iSerialization):
+    file_(iDirectory+"/"+fileName(iClassName), std::ios_base::binary | std::ios_base::trunc) {
+    if(not file_) {
+      throw std::runtime_error("unable to open "+iDirectory+"/"+fileName(iClassName));
+    }
+    writeWord(file_, kFileMarker);
+    writeWord(file_, iSerialization);
+    writeWord(file_, iClassName.size());
+    file_.write(iClassName.data(), iClassName.size());
+  }
+
+  void CorpusWriter::write(BlobView iBlob) {
+    writeWord(file_, iBlob.size());
+    file_.write(iBlob.data(), iBlob.size());
+    if(not file_) {
+      throw std::runtime_error("failed writing a blob to the corpus");
+    }
+    ++nBlobs_;
+    bytes_ += iBlob.size();
+  }
+
+  CorpusFile readCorpusFile(std::string const& iFileName) {
+    std::ifstream file(iFileName, std::ios_base::binary);
+    if(not file) {
+      throw std::runtime_error("unable to open "+iFileName);
+    }
+    CorpusFile corpus;
+    uint32_t marker = 0;
+    uint32_t nameSize = 0;
+    if(not readWord(file, marker) or marker != kFileMarker or not readWord(file, corpus.serialization_) or not readWord(file, nameSize)) {
+      throw std::runtime_error(iFileName+" is not a blob corpus file");
+    }
+    corpus.className_.resize(nameSize);
+    if(not file.read(corpus.className_.data(), nameSize)) {
+      throw std::runtime_error(iFileName+" ends within its header");
+    }
+    uint32_t size = 0;
+    while(readWord(file, size)) {
+      std::vector<char> blob(size);
+      if(not file.read(blob.data(), size)) {
+        throw std::runtime_error(iFileName+" ends within a blob");
+      }
+      corpus.blobs_.push_back(std::move(blob));
+    }
+    return corpus;
+  }
+
+  std::vector<std::string> corpusFiles(std::string const& iDirectory) {
+    std::vector<std::string> files;
+    auto dir = opendir(iDirectory.c_str());
+    if(nullptr == dir) {
+      return files;
+    }
+    while(auto entry = readdir(dir)) {
+      std::string_view name(entry->d_name);
+      if(name.size() > kFileSuffix.size() and name.substr(name.size()-kFileSuffix.size()) == kFileSuffix) {
+        files.push_back(iDirectory+"/"+std::string(name));
+      }
+    }
+    closedir(dir);
+    std::sort(files.begin(), files.end());
+    return files;
+  }
+
+  bool makeDirectory(std::string const& iDirectory) {
+    return 0 == ::mkdir(iDirectory.c_str(), 0755) or errno == EEXIST;
+  }
+}
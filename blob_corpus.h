@@ -0,0 +1,54 @@
+#if !defined(blob_corpus_h)
+#define blob_corpus_h
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "BlobView.h"
+
+namespace cce::tf::corpus {
+  //A corpus is a directory with one file per data product type holding the
+  // serialized data products of that type, as written by BlobDumpOutputer and
+  // read by codec_bench. A file is
+  //   kFileMarker
+  //   the serialization used, see pds::Serialization
+  //   size of the class name in bytes, the class name
+  //   for each blob, its size in bytes and its bytes
+  // where all numbers are uint32_t in the byte order of the host.
+  constexpr uint32_t kFileMarker = 0x42434f52; //"ROCB" on little endian
+  constexpr std::string_view kFileSuffix = ".blobs";
+
+  //the name of the file in the corpus for a class, characters not allowed in file names are replaced
+  std::string fileName(std::string_view iClassName);
+
+  //Appends blobs to the file of one class. Throws std::runtime_error if the file can not be written.
+  class CorpusWriter {
+  public:
+    CorpusWriter(std::string const& iDirectory, std::string_view iClassName, uint32_t iSerialization);
+
+    void write(BlobView iBlob);
+    unsigned long long nBlobs() const { return nBlobs_; }
+    unsigned long long bytes() const { return bytes_; }
+  private:
+    std::ofstream file_;
+    unsigned long long nBlobs_ = 0;
+    unsigned long long bytes_ = 0;
+  };
+
+  struct CorpusFile {
+    std::string className_;
+    uint32_t serialization_ = 0;
+    std::vector<std::vector<char>> blobs_;
+  };
+  //throws std::runtime_error if the file is not a corpus file
+  CorpusFile readCorpusFile(std::string const& iFileName);
+
+  //the corpus files in the directory, sorted by name
+  std::vector<std::string> corpusFiles(std::string const& iDirectory);
+  //makes the directory if it does not exist, returns false if that failed
+  bool makeDirectory(std::string const& iDirectory);
+}
+#endif
@@ -0,0 +1,169 @@
+#include "byte_shuffle.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define SHUFFLE_X86
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SHUFFLE_ARM
+#endif
+
+namespace cce::tf {
+  namespace {
+    //elements [iBegin, iEnd) of the n elements. Bytes at or after iInSize are taken as 0.
+    void shuffleElements(char const* iIn, std::size_t iInSize, char* oOut, std::size_t n, unsigned int iTypeSize,
+                         std::size_t iBegin, std::size_t iEnd) {
+      for(std::size_t i = iBegin; i < iEnd; ++i) {
+        for(unsigned int j = 0; j < iTypeSize; ++j) {
+          auto const index = i*iTypeSize+j;
+          oOut[j*n+i] = index < iInSize ? iIn[index] : 0;
+        }
+      }
+    }
+
+    void unshuffleElements(char const* iIn, char* oOut, std::size_t n, unsigned int iTypeSize,
+                           std::size_t iBegin, std::size_t iEnd) {
+      for(std::size_t i = iBegin; i < iEnd; ++i) {
+        for(unsigned int j = 0; j < iTypeSize; ++j) {
+          oOut[i*iTypeSize+j] = iIn[j*n+i];
+        }
+      }
+    }
+
+    //number of 4 byte elements handled per step of the vectorized loops
+#if defined(SHUFFLE_X86)
+    constexpr std::size_t kVectorElements = 8;
+
+    //within each 128 bit lane, transposes the 4x4 bytes of 4 elements
+    __attribute__((target("avx2")))
+    __m256i transpose4x4(__m256i iValue) {
+      auto const mask = _mm256_setr_epi8(0,4,8,12,1,5,9,13,2,6,10,14,3,7,11,15,
+                                         0,4,8,12,1,5,9,13,2,6,10,14,3,7,11,15);
+      return _mm256_shuffle_epi8(iValue, mask);
+    }
+
+    //compiled for AVX2 but only called if the CPU supports it
+    __attribute__((target("avx2")))
+    void shuffle4Vector(char const* iIn, char* oOut, std::size_t n, std::size_t iEnd) {
+      //puts byte j of all 8 elements in the j-th 64 bits
+      auto const permute = _mm256_setr_epi32(0,4,1,5,2,6,3,7);
+      for(std::size_t i = 0; i < iEnd; i += kVectorElements) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(iIn+i*4));
+        v = _mm256_permutevar8x32_epi32(transpose4x4(v), permute);
+        alignas(32) int64_t streams[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(streams), v);
+        for(unsigned int j = 0; j < 4; ++j) {
+          std::memcpy(oOut+j*n+i, &streams[j], 8);
+        }
+      }
+    }
+
+    __attribute__((target("avx2")))
+    void unshuffle4Vector(char const* iIn, char* oOut, std::size_t n, std::size_t iEnd) {
+      //gathers the first 4 bytes of each stream in the low lane and the next 4 in the high lane
+      auto const permute = _mm256_setr_epi32(0,2,4,6,1,3,5,7);
+      for(std::size_t i = 0; i < iEnd; i += kVectorElements) {
+        int64_t streams[4];
+        for(unsigned int j = 0; j < 4; ++j) {
+          std::memcpy(&streams[j], iIn+j*n+i, 8);
+        }
+        auto v = _mm256_setr_epi64x(streams[0], streams[1], streams[2], streams[3]);
+        v = transpose4x4(_mm256_permutevar8x32_epi32(v, permute));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(oOut+i*4), v);
+      }
+    }
+
+    bool hasVector() {
+      static bool const s_hasAVX2 = __builtin_cpu_supports("avx2");
+      return s_hasAVX2;
+    }
+#elif defined(SHUFFLE_ARM)
+    constexpr std::size_t kVectorElements = 16;
+
+    void shuffle4Vector(char const* iIn, char* oOut, std::size_t n, std::size_t iEnd) {
+      for(std::size_t i = 0; i < iEnd; i += kVectorElements) {
+        //de-interleaves so val[j] holds byte j of the 16 elements
+        auto v = vld4q_u8(reinterpret_cast<uint8_t const*>(iIn+i*4));
+        vst1q_u8(reinterpret_cast<uint8_t*>(oOut+i), v.val[0]);
+        vst1q_u8(reinterpret_cast<uint8_t*>(oOut+n+i), v.val[1]);
+        vst1q_u8(reinterpret_cast<uint8_t*>(oOut+2*n+i), v.val[2]);
+        vst1q_u8(reinterpret_cast<uint8_t*>(oOut+3*n+i), v.val[3]);
+      }
+    }
+
+    void unshuffle4Vector(char const* iIn, char* oOut, std::size_t n, std::size_t iEnd) {
+      for(std::size_t i = 0; i < iEnd; i += kVectorElements) {
+        uint8x16x4_t v;
+        v.val[0] = vld1q_u8(reinterpret_cast<uint8_t const*>(iIn+i));
+        v.val[1] = vld1q_u8(reinterpret_cast<uint8_t const*>(iIn+n+i));
+        v.val[2] = vld1q_u8(reinterpret_cast<uint8_t const*>(iIn+2*n+i));
+        v.val[3] = vld1q_u8(reinterpret_cast<uint8_t const*>(iIn+3*n+i));
+        vst4q_u8(reinterpret_cast<uint8_t*>(oOut+i*4), v);
+      }
+    }
+
+    bool hasVector() { return true; }
+#else
+    constexpr std::size_t kVectorElements = 1;
+
+    void shuffle4Vector(char const* iIn, char* oOut, std::size_t n, std::size_t iEnd) {
+      shuffleElements(iIn, iEnd*4, oOut, n, 4, 0, iEnd);
+    }
+    void unshuffle4Vector(char const* iIn, char* oOut, std::size_t n, std::size_t iEnd) {
+      unshuffleElements(iIn, oOut, n, 4, 0, iEnd);
+    }
+
+    bool hasVector() { return false; }
+#endif
+  }
+
+  void byteShuffle(char const* iIn, std::size_t iInSize, char* oOut, std::size_t iSize, unsigned int iTypeSize) {
+    std::size_t const n = iTypeSize < 2 ? 0 : iSize/iTypeSize;
+    std::size_t vectorEnd = 0;
+    if(iTypeSize == 4 and hasVector()) {
+      //only whole vectors of elements which are all in iIn
+      vectorEnd = (std::min(iInSize, iSize)/4/kVectorElements)*kVectorElements;
+      shuffle4Vector(iIn, oOut, n, vectorEnd);
+    }
+    shuffleElements(iIn, iInSize, oOut, n, iTypeSize, vectorEnd, n);
+    for(std::size_t index = n*iTypeSize; index < iSize; ++index) {
+      oOut[index] = index < iInSize ? iIn[index] : 0;
+    }
+  }
+
+  void byteUnshuffle(char const* iIn, char* oOut, std::size_t iSize, unsigned int iTypeSize) {
+    std::size_t const n = iTypeSize < 2 ? 0 : iSize/iTypeSize;
+    std::size_t vectorEnd = 0;
+    if(iTypeSize == 4 and hasVector()) {
+      vectorEnd = (n/kVectorElements)*kVectorElements;
+      unshuffle4Vector(iIn, oOut, n, vectorEnd);
+    }
+    unshuffleElements(iIn, oOut, n, iTypeSize, vectorEnd, n);
+    std::memcpy(oOut+n*iTypeSize, iIn+n*iTypeSize, iSize-n*iTypeSize);
+  }
+
+  unsigned int shuffleTypeSize(std::string_view iClassName) {
+    for(std::string_view prefix: {"std::vector<", "vector<"}) {
+      if(iClassName.substr(0, prefix.size()) == prefix and iClassName.back() == '>') {
+        iClassName = iClassName.substr(prefix.size(), iClassName.size()-prefix.size()-1);
+        break;
+      }
+    }
+    for(std::string_view name: {"float", "int", "unsigned int", "Float_t", "Int_t", "UInt_t"}) {
+      if(iClassName == name) {
+        return 4;
+      }
+    }
+    for(std::string_view name: {"double", "long", "unsigned long", "long long", "unsigned long long",
+                                "Double_t", "Long64_t", "ULong64_t"}) {
+      if(iClassName == name) {
+        return 8;
+      }
+    }
+    return 0;
+  }
+}
@@ -0,0 +1,25 @@
+#if !defined(byte_shuffle_h)
+#define byte_shuffle_h
+
+#include <cstddef>
+#include <string_view>
+
+namespace cce::tf {
+  //Blosc style byte shuffle. The iSize bytes are taken as iSize/iTypeSize
+  // elements and byte j of every element is gathered into the j-th stream, so
+  // e.g. the exponent bytes of floats end up next to each other. Bytes after
+  // the last whole element are copied unchanged. Only iInSize <= iSize bytes
+  // are read from iIn, the missing ones are taken as 0 (e.g. the padding of a
+  // blob stored in whole words). Uses AVX2 or NEON when the CPU has it.
+  void byteShuffle(char const* iIn, std::size_t iInSize, char* oOut, std::size_t iSize, unsigned int iTypeSize);
+  inline void byteShuffle(char const* iIn, char* oOut, std::size_t iSize, unsigned int iTypeSize) {
+    byteShuffle(iIn, iSize, oOut, iSize, iTypeSize);
+  }
+  //the inverse of byteShuffle
+  void byteUnshuffle(char const* iIn, char* oOut, std::size_t iSize, unsigned int iTypeSize);
+
+  //the element size to shuffle a data product of the class with, 0 if it
+  // should not be shuffled. Only the basic numeric types and std::vectors of them are shuffled.
+  unsigned int shuffleTypeSize(std::string_view iClassName);
+}
+#endif
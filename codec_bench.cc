@@ -0,0 +1,264 @@
+#include "blob_corpus.h"
+#include "pds_writer.h"
+#include "pds_reading.h"
+#include "byte_shuffle.h"
+#include "RunReport.h"
+
+#include "tbb/global_control.h"
+#include "tbb/parallel_for.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+  Compresses the data products of a corpus written by BlobDumpOutputer with
+  each compression algorithm and level, without and with the pre-filters
+  which apply to the type, and prints per data product type the compression
+  ratio and the MB/s of the compression and of the decompression. Each blob
+  is compressed on its own, as PDSOutputer's perProductCompression does.
+  The pre-filters are
+    shuffle: the byte shuffle of PDSOutputer's shuffle option, for types of
+             numbers and std::vectors of them
+    dictionary: a ZSTD dictionary trained on the blobs of the type
+  The combinations are run in parallel, one per thread, use -t 1 to have the
+  throughputs not share the machine.
+  Usage: codec_bench [-t <# threads>] [--codecs <algorithm/level,...>] [--dictionary-size <bytes>]
+                     [--report <file>] <corpus directory>
+*/
+namespace {
+  using namespace cce::tf;
+
+  struct Codec {
+    pds::Compression algorithm_;
+    int level_;
+  };
+
+  enum class PreFilter {kNone, kShuffle, kDictionary};
+  char const* name(PreFilter iFilter) {
+    switch(iFilter) {
+    case PreFilter::kNone: return "none";
+    case PreFilter::kShuffle: return "shuffle";
+    case PreFilter::kDictionary: return "dictionary";
+    }
+    return "unknown";
+  }
+
+  std::string name(Codec const& iCodec) {
+    return std::string(pds::name(iCodec.algorithm_))+"/"+std::to_string(iCodec.level_);
+  }
+
+  struct Type {
+    corpus::CorpusFile corpus_;
+    unsigned long long bytes_ = 0;
+    unsigned int shuffleTypeSize_ = 0;
+    std::vector<char> dictionary_;
+  };
+
+  struct Measurement {
+    std::size_t type_;
+    Codec codec_;
+    PreFilter filter_;
+    unsigned long long compressedBytes_ = 0;
+    std::chrono::microseconds compressTime_ = std::chrono::microseconds::zero();
+    std::chrono::microseconds decompressTime_ = std::chrono::microseconds::zero();
+  };
+
+  //MB/s, i.e. bytes per microsecond
+  double throughput(unsigned long long iBytes, std::chrono::microseconds iTime) {
+    return iTime.count() == 0 ? 0. : double(iBytes)/iTime.count();
+  }
+
+  std::vector<Codec> parseCodecs(std::string const& iCodecs) {
+    std::vector<Codec> codecs;
+    std::istringstream stream(iCodecs);
+    std::string item;
+    while(std::getline(stream, item, ',')) {
+      if(item.empty()) {
+        continue;
+      }
+      int level = 0;
+      auto slash = item.find('/');
+      if(slash != std::string::npos) {
+        level = std::stoi(item.substr(slash+1));
+        item.resize(slash);
+      }
+      auto algorithm = pds::toCompression(item);
+      if(not algorithm) {
+        throw std::runtime_error("unknown compression "+item);
+      }
+      codecs.push_back({*algorithm, level});
+    }
+    return codecs;
+  }
+
+  void measure(Type const& iType, Measurement& ioMeasurement) {
+    pds::CompressionContext compressContext;
+    pds::DecompressionContext decompressContext;
+    std::unique_ptr<pds::CompressionDictionary> compressDictionary;
+    std::unique_ptr<pds::DecompressionDictionary> decompressDictionary;
+    if(ioMeasurement.filter_ == PreFilter::kDictionary) {
+      compressDictionary = std::make_unique<pds::CompressionDictionary>(iType.dictionary_, ioMeasurement.codec_.level_);
+      decompressDictionary = std::make_unique<pds::DecompressionDictionary>(iType.dictionary_);
+      compressContext.setDictionary(compressDictionary.get());
+      decompressContext.setDictionary(decompressDictionary.get());
+    }
+    bool const shuffle = ioMeasurement.filter_ == PreFilter::kShuffle;
+    std::vector<char> shuffled;
+    std::vector<char> uncompressed;
+    std::vector<char> unshuffled;
+    for(auto const& blob: iType.corpus_.blobs_) {
+      auto start = std::chrono::high_resolution_clock::now();
+      BlobView toCompress(blob);
+      if(shuffle) {
+        shuffled.resize(blob.size());
+        byteShuffle(blob.data(), shuffled.data(), blob.size(), iType.shuffleTypeSize_);
+        toCompress = BlobView(shuffled);
+      }
+      auto compressed = pds::compressBuffer(0, 0, ioMeasurement.codec_.algorithm_, ioMeasurement.codec_.level_, toCompress, compressContext);
+      auto decompressStart = std::chrono::high_resolution_clock::now();
+      uncompressed.resize(blob.size());
+      pds::uncompressBuffer(ioMeasurement.codec_.algorithm_, compressed.data(), compressed.size(), blob.size(), uncompressed.data(), decompressContext);
+      if(shuffle) {
+        unshuffled.resize(blob.size());
+        byteUnshuffle(uncompressed.data(), unshuffled.data(), blob.size(), iType.shuffleTypeSize_);
+        uncompressed.swap(unshuffled);
+      }
+      auto end = std::chrono::high_resolution_clock::now();
+      ioMeasurement.compressTime_ += std::chrono::duration_cast<std::chrono::microseconds>(decompressStart - start);
+      ioMeasurement.decompressTime_ += std::chrono::duration_cast<std::chrono::microseconds>(end - decompressStart);
+      ioMeasurement.compressedBytes_ += compressed.size();
+      if(uncompressed != blob) {
+        throw std::runtime_error(name(ioMeasurement.codec_)+" with "+name(ioMeasurement.filter_)+" did not give back the bytes of a "+iType.corpus_.className_);
+      }
+    }
+  }
+}
+
+int main(int argc, char* argv[]) {
+  unsigned int nThreads = std::max(std::thread::hardware_concurrency(), 1U);
+  std::string codecNames = "None/0,LZ4/0,LZ4HC/9,ZSTD/1,ZSTD/3,ZSTD/9,ZSTD/18,LongZSTD/18";
+  std::size_t dictionarySize = 112640;
+  std::string reportFile;
+  std::string directory;
+  for(int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if((arg == "-t" or arg == "--codecs" or arg == "--dictionary-size" or arg == "--report") and i+1 < argc) {
+      std::string value(argv[++i]);
+      if(arg == "-t") {
+        nThreads = std::stoul(value);
+      } else if(arg == "--codecs") {
+        codecNames = value;
+      } else if(arg == "--dictionary-size") {
+        dictionarySize = std::stoul(value);
+      } else {
+        reportFile = value;
+      }
+    } else if(directory.empty() and arg[0] != '-') {
+      directory = arg;
+    } else {
+      directory.clear();
+      break;
+    }
+  }
+  if(directory.empty() or nThreads == 0) {
+    std::cout <<"usage: codec_bench [-t <# threads>] [--codecs <algorithm/level,...>] [--dictionary-size <bytes>] [--report <file>] <corpus directory>"<<std::endl;
+    return 1;
+  }
+
+  try {
+    auto codecs = parseCodecs(codecNames);
+    std::vector<Type> types;
+    for(auto const& file: corpus::corpusFiles(directory)) {
+      Type type;
+      type.corpus_ = corpus::readCorpusFile(file);
+      if(type.corpus_.blobs_.empty()) {
+        continue;
+      }
+      for(auto const& blob: type.corpus_.blobs_) {
+        type.bytes_ += blob.size();
+      }
+      type.shuffleTypeSize_ = shuffleTypeSize(type.corpus_.className_);
+      types.push_back(std::move(type));
+    }
+    if(types.empty()) {
+      std::cout <<"no blobs found in "<<directory<<std::endl;
+      return 1;
+    }
+
+    tbb::global_control control(tbb::global_control::max_allowed_parallelism, nThreads);
+
+    bool const usesZSTD = std::any_of(codecs.begin(), codecs.end(), [](auto const& c) { return pds::isZSTD(c.algorithm_); });
+    if(usesZSTD and dictionarySize != 0) {
+      tbb::parallel_for(std::size_t(0), types.size(), [&](std::size_t i) {
+          //the blobs as words as PDSOutputer trains on
+          std::vector<std::vector<uint32_t>> samples;
+          samples.reserve(types[i].corpus_.blobs_.size());
+          for(auto const& blob: types[i].corpus_.blobs_) {
+            std::vector<uint32_t> words(blob.size()/4 + ((blob.size() % 4) == 0 ? 0 : 1), 0);
+            std::memcpy(words.data(), blob.data(), blob.size());
+            samples.push_back(std::move(words));
+          }
+          types[i].dictionary_ = pds::trainDictionary(samples, dictionarySize);
+        });
+    }
+
+    std::vector<Measurement> measurements;
+    for(std::size_t t = 0; t < types.size(); ++t) {
+      for(auto const& codec: codecs) {
+        measurements.push_back({t, codec, PreFilter::kNone});
+        if(codec.algorithm_ == pds::Compression::kNone) {
+          continue;
+        }
+        if(types[t].shuffleTypeSize_ != 0) {
+          measurements.push_back({t, codec, PreFilter::kShuffle});
+        }
+        if(pds::isZSTD(codec.algorithm_) and not types[t].dictionary_.empty()) {
+          measurements.push_back({t, codec, PreFilter::kDictionary});
+        }
+      }
+    }
+    tbb::parallel_for(std::size_t(0), measurements.size(), [&](std::size_t i) {
+        measure(types[measurements[i].type_], measurements[i]);
+      }, tbb::simple_partitioner());
+
+    RunReport report;
+    auto& typesReport = report.section("types");
+    std::size_t t = types.size();
+    for(auto const& m: measurements) {
+      auto const& type = types[m.type_];
+      if(m.type_ != t) {
+        t = m.type_;
+        std::cout <<type.corpus_.className_<<" blobs: "<<type.corpus_.blobs_.size()<<" bytes: "<<type.bytes_<<"\n";
+        auto& typeReport = typesReport.section(type.corpus_.className_);
+        typeReport.set("blobs", type.corpus_.blobs_.size());
+        typeReport.set("bytes", type.bytes_);
+      }
+      double const ratio = double(type.bytes_)/std::max(m.compressedBytes_, 1ULL);
+      std::cout <<"  "<<std::left<<std::setw(14)<<name(m.codec_)<<std::setw(12)<<name(m.filter_)<<std::right
+                <<" ratio "<<std::setw(8)<<ratio
+                <<" compress "<<std::setw(10)<<throughput(type.bytes_, m.compressTime_)<<" MB/s"
+                <<" decompress "<<std::setw(10)<<throughput(type.bytes_, m.decompressTime_)<<" MB/s\n";
+      auto& entry = typesReport.section(type.corpus_.className_).section(name(m.codec_)+":"+name(m.filter_));
+      entry.set("compressedBytes", m.compressedBytes_);
+      entry.set("compressTime_us", m.compressTime_.count());
+      entry.set("decompressTime_us", m.decompressTime_.count());
+    }
+    if(not reportFile.empty()) {
+      std::ofstream file(reportFile);
+      report.write(file);
+    }
+  } catch(std::exception const& e) {
+    std::cout <<"codec_bench failed: "<<e.what()<<std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -8,6 +8,8 @@
 #include "SequenceFinderForBuiltins.h"
 
 #include <set>
+#include <mutex>
+#include <unordered_map>
 #include <iostream>
 
 using namespace cce::tf;
@@ -338,6 +340,7 @@ namespace {
               oCollections.emplace_back(collProxy->Generate(), baseOffset+element->GetOffset());
               //base offset is 0 since it is relative to the item in the container
               oCollections.back().m_offsetAndSequences.emplace_back(0, setActionSequence(nullptr, sinfo, nullptr, create, false, -1, 0));
+              oCollections.back().m_builtinType = static_cast<EDataType>(collProxy->GetType());
               return;
             }
           }
@@ -387,13 +390,126 @@ namespace {
  }
 }
 
+namespace {
+  struct SequencesCache {
+    std::mutex mutex_;
+    std::unordered_map<TClass const*, unrolling::ObjectAndCollectionsSequences> sequences_;
+  };
+
+  unrolling::ObjectAndCollectionsSequences sharedActionSequence(SequencesCache& iCache, TClass& iClass, TStreamerInfoActions::TActionSequence::SequenceGetter_t create) {
+    //building the sequences uses ROOT's meta data which is not thread safe so building is also serialized
+    std::lock_guard<std::mutex> guard(iCache.mutex_);
+    auto itFound = iCache.sequences_.find(&iClass);
+    if(itFound == iCache.sequences_.end()) {
+      itFound = iCache.sequences_.emplace(&iClass, buildActionSequence(iClass, create)).first;
+    }
+    auto const& original = itFound->second;
+    unrolling::ObjectAndCollectionsSequences copy;
+    copy.m_objects = original.m_objects;
+    copy.m_collections.reserve(original.m_collections.size());
+    for(auto const& c: original.m_collections) {
+      copy.m_collections.push_back(unrolling::copyCollectionActions(c));
+    }
+    return copy;
+  }
+}
+
 namespace cce::tf::unrolling {
+  CollectionActions copyCollectionActions(CollectionActions const& iOriginal) {
+    CollectionActions copy(iOriginal.m_collProxy->Generate(), iOriginal.m_offset);
+    copy.m_offsetAndSequences = iOriginal.m_offsetAndSequences;
+    copy.m_builtinType = iOriginal.m_builtinType;
+    copy.m_collections.reserve(iOriginal.m_collections.size());
+    for(auto const& c: iOriginal.m_collections) {
+      copy.m_collections.push_back(copyCollectionActions(c));
+    }
+    return copy;
+  }
+
   unrolling::ObjectAndCollectionsSequences buildReadActionSequence(TClass& iClass) {
-    return buildActionSequence(iClass, TStreamerInfoActions::TActionSequence::ReadMemberWiseActionsGetter);
+    static SequencesCache s_cache;
+    return sharedActionSequence(s_cache, iClass, TStreamerInfoActions::TActionSequence::ReadMemberWiseActionsGetter);
   }
 
   unrolling::ObjectAndCollectionsSequences buildWriteActionSequence(TClass& iClass) {
-    return buildActionSequence(iClass, TStreamerInfoActions::TActionSequence::WriteMemberWiseActionsGetter);
+    static SequencesCache s_cache;
+    return sharedActionSequence(s_cache, iClass, TStreamerInfoActions::TActionSequence::WriteMemberWiseActionsGetter);
+  }
+
+  namespace {
+    template<typename T>
+    void writeArray(TBuffer& oBuffer, void const* iBegin, Int_t iSize) {
+      oBuffer.WriteFastArray(static_cast<T const*>(iBegin), iSize);
+    }
+    template<typename T>
+    void readArray(TBuffer& iBuffer, void* iBegin, Int_t iSize) {
+      iBuffer.ReadFastArray(static_cast<T*>(iBegin), iSize);
+    }
+  }
+
+  namespace {
+    std::size_t countStreams(OffsetAndSequences const& iObjects, SequencesForCollections const& iCollections) {
+      std::size_t n = iObjects.size();
+      for(auto const& coll: iCollections) {
+        n += numberOfSplitStreams(coll);
+      }
+      return n;
+    }
+  }
+
+  std::size_t numberOfSplitStreams(ObjectAndCollectionsSequences const& iSequences) {
+    return countStreams(iSequences.m_objects, iSequences.m_collections);
+  }
+
+  std::size_t numberOfSplitStreams(CollectionActions const& iCollection) {
+    if(iCollection.m_builtinType != kNoType_t) {
+      return 2;
+    }
+    return 1 + countStreams(iCollection.m_offsetAndSequences, iCollection.m_collections);
+  }
+
+  void writeBuiltins(TBuffer& oBuffer, EDataType iType, void const* iBegin, Int_t iSize) {
+    if(iSize == 0) {
+      return;
+    }
+    switch(iType) {
+    case kFloat_t: { writeArray<Float_t>(oBuffer, iBegin, iSize); break; }
+    case kDouble_t: { writeArray<Double_t>(oBuffer, iBegin, iSize); break; }
+    case kInt_t: { writeArray<Int_t>(oBuffer, iBegin, iSize); break; }
+    case kUInt_t: { writeArray<UInt_t>(oBuffer, iBegin, iSize); break; }
+    case kLong_t: { writeArray<Long_t>(oBuffer, iBegin, iSize); break; }
+    case kULong_t: { writeArray<ULong_t>(oBuffer, iBegin, iSize); break; }
+    case kShort_t: { writeArray<Short_t>(oBuffer, iBegin, iSize); break; }
+    case kUShort_t: { writeArray<UShort_t>(oBuffer, iBegin, iSize); break; }
+    case kChar_t: { writeArray<Char_t>(oBuffer, iBegin, iSize); break; }
+    case kUChar_t: { writeArray<UChar_t>(oBuffer, iBegin, iSize); break; }
+    default: {
+      std::cout <<"unsupported builtin type "<<iType<<std::endl;
+      abort();
+    }
+    }
+  }
+
+  void readBuiltins(TBuffer& iBuffer, EDataType iType, void* iBegin, Int_t iSize) {
+    if(iSize == 0) {
+      return;
+    }
+    switch(iType) {
+    case kFloat_t: { readArray<Float_t>(iBuffer, iBegin, iSize); break; }
+    case kDouble_t: { readArray<Double_t>(iBuffer, iBegin, iSize); break; }
+    case kInt_t: { readArray<Int_t>(iBuffer, iBegin, iSize); break; }
+    case kUInt_t: { readArray<UInt_t>(iBuffer, iBegin, iSize); break; }
+    case kLong_t: { readArray<Long_t>(iBuffer, iBegin, iSize); break; }
+    case kULong_t: { readArray<ULong_t>(iBuffer, iBegin, iSize); break; }
+    case kShort_t: { readArray<Short_t>(iBuffer, iBegin, iSize); break; }
+    case kUShort_t: { readArray<UShort_t>(iBuffer, iBegin, iSize); break; }
+    case kChar_t: { readArray<Char_t>(iBuffer, iBegin, iSize); break; }
+    case kUChar_t: { readArray<UChar_t>(iBuffer, iBegin, iSize); break; }
+    default: {
+      std::cout <<"unsupported builtin type "<<iType<<std::endl;
+      abort();
+    }
+    }
   }
 
 }
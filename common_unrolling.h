@@ -3,11 +3,15 @@
 
 #include "TClass.h"
 #include "TStreamerInfoActions.h"
+#include "TDataType.h"
+#include "TBuffer.h"
 #include <memory>
 #include <vector>
 
 namespace cce::tf::unrolling {
-  using Sequence = std::unique_ptr<TStreamerInfoActions::TActionSequence>;  
+  //A sequence is only read while streaming so one is shared by all the copies
+  // made for a given TClass
+  using Sequence = std::shared_ptr<TStreamerInfoActions::TActionSequence const>;
   using OffsetAndSequences = std::vector<std::pair<int, Sequence>>;
 
   struct CollectionActions {
@@ -19,6 +23,10 @@ namespace cce::tf::unrolling {
     OffsetAndSequences m_offsetAndSequences;
 
     std::vector<CollectionActions> m_collections;
+
+    //set if the collection is a std::vector of a fundamental type. The elements
+    // are then contiguous and are read or written with one call
+    EDataType m_builtinType = kNoType_t;
   };
 
   using SequencesForCollections = std::vector<CollectionActions>;
@@ -28,8 +36,25 @@ namespace cce::tf::unrolling {
     SequencesForCollections m_collections;
   };
 
+  //The sequences are built once per TClass and shared by all returned values. Each
+  // returned value has its own collection proxies since those hold the address
+  // of the collection being streamed.
   ObjectAndCollectionsSequences buildReadActionSequence(TClass& iClass);
   ObjectAndCollectionsSequences buildWriteActionSequence(TClass& iClass);
+  //shares the sequences but has its own collection proxies
+  CollectionActions copyCollectionActions(CollectionActions const& iOriginal);
+
+  //iBegin is the first of iSize contiguous elements of type iType. The bytes
+  // are the same as applying the element's action sequence to each element.
+  void writeBuiltins(TBuffer& oBuffer, EDataType iType, void const* iBegin, Int_t iSize);
+  void readBuiltins(TBuffer& iBuffer, EDataType iType, void* iBegin, Int_t iSize);
+
+  //The number of streams a split serialization writes, see SplitSerializer. Each
+  // sequence is one stream and a collection adds a stream for its sizes followed
+  // by either one stream for its builtin elements or the streams of its elements.
+  std::size_t numberOfSplitStreams(ObjectAndCollectionsSequences const&);
+  //includes the stream for the sizes
+  std::size_t numberOfSplitStreams(CollectionActions const&);
 
 
 }
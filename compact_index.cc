@@ -0,0 +1,129 @@
+#include "compact_index.h"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace cce::tf {
+  namespace {
+    void encodeVarint(uint64_t iValue, std::vector<char>& oBytes) {
+      while(iValue >= 0x80) {
+        oBytes.push_back(static_cast<char>((iValue & 0x7F) | 0x80));
+        iValue >>= 7;
+      }
+      oBytes.push_back(static_cast<char>(iValue));
+    }
+
+    uint64_t zigzag(int64_t iValue) {
+      return (static_cast<uint64_t>(iValue) << 1) ^ static_cast<uint64_t>(iValue >> 63);
+    }
+    int64_t unzigzag(uint64_t iValue) {
+      return static_cast<int64_t>(iValue >> 1) ^ -static_cast<int64_t>(iValue & 1);
+    }
+
+    //reads iN varints, none of which may be larger than iMax
+    template<typename T>
+    unsigned char const* decodeVarints(unsigned char const* iBegin, unsigned char const* iEnd, std::size_t iN, uint64_t iMax, T* oValues) {
+      std::size_t i = 0;
+      while(i < iN) {
+        if(iN-i >= 8 and iEnd-iBegin >= 8) {
+          //no continuation bit in the next 8 bytes, so each is a whole number
+          uint64_t word;
+          std::memcpy(&word, iBegin, sizeof(word));
+          if((word & 0x8080808080808080ULL) == 0) {
+            for(std::size_t j = 0; j < 8; ++j) {
+              oValues[i+j] = iBegin[j];
+            }
+            i += 8;
+            iBegin += 8;
+            continue;
+          }
+        }
+        uint64_t value = 0;
+        unsigned int shift = 0;
+        while(true) {
+          if(iBegin == iEnd or shift > 63) {
+            throw std::runtime_error("compact batch index ends inside a number");
+          }
+          auto const byte = *(iBegin++);
+          value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+          if((byte & 0x80) == 0) {
+            break;
+          }
+          shift += 7;
+        }
+        if(value > iMax) {
+          throw std::runtime_error("compact batch index holds the value "+std::to_string(value)+" which is out of range");
+        }
+        oValues[i++] = value;
+      }
+      return iBegin;
+    }
+  }
+
+  void encodeBatchIndex(std::vector<EventIdentifier> const& iEventIDs, std::vector<uint32_t> const& iOffsets,
+                        std::size_t iEntriesPerEvent, std::vector<char>& oBytes) {
+    if(iOffsets.size() != iEventIDs.size()*iEntriesPerEvent) {
+      throw std::runtime_error("encodeBatchIndex given "+std::to_string(iOffsets.size())+" offsets for "
+                               +std::to_string(iEventIDs.size())+" events");
+    }
+    oBytes.reserve(oBytes.size() + 1 + 3*iEventIDs.size() + iOffsets.size()*2);
+    encodeVarint(iEventIDs.size(), oBytes);
+    EventIdentifier previous{0, 0, 0};
+    for(auto const& id: iEventIDs) {
+      encodeVarint(zigzag(int64_t(id.run) - int64_t(previous.run)), oBytes);
+      encodeVarint(zigzag(int64_t(id.lumi) - int64_t(previous.lumi)), oBytes);
+      encodeVarint(zigzag(static_cast<int64_t>(id.event - previous.event)), oBytes);
+      previous = id;
+    }
+    for(std::size_t begin = 0; begin < iOffsets.size(); begin += iEntriesPerEvent) {
+      uint32_t last = 0;
+      for(std::size_t i = begin; i < begin+iEntriesPerEvent; ++i) {
+        if(iOffsets[i] < last) {
+          throw std::runtime_error("encodeBatchIndex given decreasing offsets");
+        }
+        encodeVarint(iOffsets[i] - last, oBytes);
+        last = iOffsets[i];
+      }
+    }
+  }
+
+  void decodeBatchIndex(char const* iBytes, std::size_t iSize, std::size_t iEntriesPerEvent,
+                        std::vector<EventIdentifier>& oEventIDs, std::vector<uint32_t>& oOffsets) {
+    auto it = reinterpret_cast<unsigned char const*>(iBytes);
+    auto const end = it+iSize;
+    uint64_t nEvents;
+    it = decodeVarints(it, end, 1, std::numeric_limits<uint32_t>::max(), &nEvents);
+    //every number takes at least one byte
+    if(nEvents*(3+iEntriesPerEvent) > static_cast<uint64_t>(end-it)) {
+      throw std::runtime_error("compact batch index is too short for "+std::to_string(nEvents)+" events");
+    }
+
+    std::vector<uint64_t> ids(3*nEvents);
+    it = decodeVarints(it, end, ids.size(), std::numeric_limits<uint64_t>::max(), ids.data());
+    oEventIDs.resize(nEvents);
+    EventIdentifier previous{0, 0, 0};
+    for(std::size_t i = 0; i < nEvents; ++i) {
+      previous.run = static_cast<unsigned int>(previous.run + unzigzag(ids[3*i]));
+      previous.lumi = static_cast<unsigned int>(previous.lumi + unzigzag(ids[3*i+1]));
+      previous.event += static_cast<unsigned long long>(unzigzag(ids[3*i+2]));
+      oEventIDs[i] = previous;
+    }
+
+    oOffsets.resize(nEvents*iEntriesPerEvent);
+    it = decodeVarints(it, end, oOffsets.size(), std::numeric_limits<uint32_t>::max(), oOffsets.data());
+    if(it != end) {
+      throw std::runtime_error("compact batch index has "+std::to_string(end-it)+" bytes left over");
+    }
+    for(std::size_t begin = 0; begin < oOffsets.size(); begin += iEntriesPerEvent) {
+      for(std::size_t i = begin+1; i < begin+iEntriesPerEvent; ++i) {
+        auto const sum = oOffsets[i-1] + oOffsets[i];
+        if(sum < oOffsets[i-1]) {
+          throw std::runtime_error("compact batch index offsets do not fit in 32 bits");
+        }
+        oOffsets[i] = sum;
+      }
+    }
+  }
+}
@@ -0,0 +1,25 @@
+#if !defined(compact_index_h)
+#define compact_index_h
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "EventIdentifier.h"
+
+namespace cce::tf {
+  //Compact form of the event identifiers and offsets of a batch of events. Each
+  // number is stored as a LEB128 varint: first the number of events, then for
+  // each event the zigzag encoded differences of run, lumi and event number to
+  // the previous event, and last for each event its iEntriesPerEvent offsets as
+  // the first offset followed by the differences to the offset before. Consecutive
+  // events and small data products then take one byte per number.
+  // The compact form is appended to oBytes.
+  void encodeBatchIndex(std::vector<EventIdentifier> const& iEventIDs, std::vector<uint32_t> const& iOffsets,
+                        std::size_t iEntriesPerEvent, std::vector<char>& oBytes);
+  //the inverse of encodeBatchIndex. Runs of 8 one byte varints are decoded
+  // together. Throws if the bytes do not hold a whole index.
+  void decodeBatchIndex(char const* iBytes, std::size_t iSize, std::size_t iEntriesPerEvent,
+                        std::vector<EventIdentifier>& oEventIDs, std::vector<uint32_t>& oOffsets);
+}
+#endif
@@ -0,0 +1,85 @@
+#include "crc32c.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CRC32C_X86
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32C_ARM
+#endif
+
+namespace cce::tf {
+  namespace {
+    uint32_t crc32cSoftware(uint32_t iCRC, unsigned char const* iData, std::size_t iSize) {
+      static auto const s_table = []() {
+        std::array<uint32_t, 256> table;
+        for(uint32_t i = 0; i < table.size(); ++i) {
+          uint32_t c = i;
+          for(int bit = 0; bit < 8; ++bit) {
+            c = (c >> 1) ^ ((c & 1) ? 0x82F63B78 : 0);
+          }
+          table[i] = c;
+        }
+        return table;
+      }();
+      for(; iSize != 0; --iSize) {
+        iCRC = s_table[(iCRC ^ *(iData++)) & 0xFF] ^ (iCRC >> 8);
+      }
+      return iCRC;
+    }
+
+#if defined(CRC32C_X86)
+    //compiled for SSE4.2 but only called if the CPU supports it
+    __attribute__((target("sse4.2")))
+    uint32_t crc32cHardware(uint32_t iCRC, unsigned char const* iData, std::size_t iSize) {
+      uint64_t crc = iCRC;
+      for(; iSize >= 8; iSize -= 8, iData += 8) {
+        uint64_t word;
+        std::memcpy(&word, iData, 8);
+        crc = _mm_crc32_u64(crc, word);
+      }
+      iCRC = crc;
+      for(; iSize != 0; --iSize) {
+        iCRC = _mm_crc32_u8(iCRC, *(iData++));
+      }
+      return iCRC;
+    }
+
+    bool hasHardware() {
+      static bool const s_hasSSE42 = __builtin_cpu_supports("sse4.2");
+      return s_hasSSE42;
+    }
+#elif defined(CRC32C_ARM)
+    uint32_t crc32cHardware(uint32_t iCRC, unsigned char const* iData, std::size_t iSize) {
+      for(; iSize >= 8; iSize -= 8, iData += 8) {
+        uint64_t word;
+        std::memcpy(&word, iData, 8);
+        iCRC = __crc32cd(iCRC, word);
+      }
+      for(; iSize != 0; --iSize) {
+        iCRC = __crc32cb(iCRC, *(iData++));
+      }
+      return iCRC;
+    }
+
+    bool hasHardware() { return true; }
+#else
+    uint32_t crc32cHardware(uint32_t iCRC, unsigned char const* iData, std::size_t iSize) {
+      return crc32cSoftware(iCRC, iData, iSize);
+    }
+
+    bool hasHardware() { return false; }
+#endif
+  }
+
+  uint32_t crc32c(void const* iData, std::size_t iSize) {
+    auto data = static_cast<unsigned char const*>(iData);
+    if(hasHardware()) {
+      return ~crc32cHardware(~uint32_t(0), data, iSize);
+    }
+    return ~crc32cSoftware(~uint32_t(0), data, iSize);
+  }
+}
@@ -0,0 +1,11 @@
+#if !defined(crc32c_h)
+#define crc32c_h
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cce::tf {
+  //CRC32C (Castagnoli) of the bytes, using the CPU's CRC32 instruction when it has one
+  uint32_t crc32c(void const* iData, std::size_t iSize);
+}
+#endif
@@ -0,0 +1,75 @@
+#include "UnrolledSerializer.h"
+#include "UnrolledDeserializer.h"
+#include "Serializer.h"
+#include "Deserializer.h"
+
+#include "TClass.h"
+#include "TBufferFile.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "test_classes/TestClasses.h"
+
+/*
+  Compares deserializing with a TBufferFile constructed for each call against
+  the Deserializer and UnrolledDeserializer which reuse their buffer.
+  Usage: deserialize_benchmark [number of iterations]
+*/
+namespace {
+  template<typename F>
+  double timePerCall(unsigned int iNIterations, F&& iFunc) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for(unsigned int i=0; i<iNIterations; ++i) {
+      iFunc();
+    }
+    auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start);
+    return double(time.count())/iNIterations;
+  }
+
+  template<typename T>
+  void benchmark(const char* iName, T const& iObject, unsigned int iNIterations) {
+    using namespace cce::tf;
+    auto cls = TClass::GetClass(typeid(T));
+    if(nullptr == cls) {
+      std::cout <<"FAILED TO GET CLASS "<<iName<<std::endl;
+      abort();
+    }
+    T newObj;
+
+    Serializer s;
+    auto buffer = s.serialize(&iObject, cls);
+    auto fresh = timePerCall(iNIterations, [&]() {
+        TBufferFile bufferFile{TBuffer::kRead};
+        bufferFile.SetBuffer(buffer.data(), buffer.size(), kFALSE);
+        cls->ReadBuffer(bufferFile, &newObj);
+      });
+    Deserializer d(cls);
+    auto reused = timePerCall(iNIterations, [&]() { d.deserialize(buffer, &newObj); });
+
+    UnrolledSerializer us(cls);
+    auto unrolledBuffer = us.serialize(&iObject);
+    UnrolledDeserializer ud(cls);
+    auto unrolled = timePerCall(iNIterations, [&]() { ud.deserialize(unrolledBuffer, &newObj); });
+
+    std::cout <<iName<<"\n"
+              <<"  new TBufferFile per call: "<<fresh<<"ns\n"
+              <<"  reused Deserializer: "<<reused<<"ns\n"
+              <<"  reused UnrolledDeserializer: "<<unrolled<<"ns"<<std::endl;
+  }
+}
+
+int main(int argc, char** argv) {
+  unsigned int nIterations = 100000;
+  if(argc > 1) {
+    nIterations = std::stoul(argv[1]);
+  }
+
+  benchmark("SimpleClass", cce::tf::test::SimpleClass(5), nIterations);
+  benchmark("TestClass", cce::tf::test::TestClass("foo", 78.9), nIterations);
+  benchmark("TestClassWithFloatVector", cce::tf::test::TestClassWithFloatVector({1,2,3,5}), nIterations);
+  benchmark("std::vector<int>", std::vector<int>(1000, 3), nIterations);
+  return 0;
+}
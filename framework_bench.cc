@@ -0,0 +1,307 @@
+#include "TaskHolder.h"
+#include "OptionalTaskHolder.h"
+#include "FunctorTask.h"
+#include "SerialTaskQueue.h"
+#include "ProxyVector.h"
+#include "Lane.h"
+#include "EmptySource.h"
+#include "DummyOutputer.h"
+#include "RunReport.h"
+
+#include "tbb/task_group.h"
+#include "tbb/task_arena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+  Measures the raw costs of the framework's primitives, without any I/O, so
+  the part of an end-to-end number which is the framework's own overhead is
+  known. Each measurement prints the time per operation
+    TaskHolder copy: copying and destroying a TaskHolder which is not the last
+    TaskHolder doneWaiting: making a task, holding it and running it once released
+    OptionalTaskHolder runNow: making a task and running it on the calling thread
+    OptionalTaskHolder release: making a task, releasing it to a TaskHolder and running it
+    SerialTaskQueue push: pushing a task from each of P producers, for P in 1..N threads
+    ProxyVector iteration: one element of a range based for loop, compared to a
+                           std::vector<std::unique_ptr<>>
+    Lane: a full event cycle of EmptySource and DummyOutputer with one Lane per
+          thread, for 1..N threads, giving the per event floor of threaded_io_test
+  Usage: framework_bench [-t <max # threads>] [-n <# iterations>] [-e <# events>] [--report <file>]
+*/
+namespace {
+  using namespace cce::tf;
+
+  //keeps the compiler from removing the loops being measured
+  std::atomic<long long> s_sink{0};
+
+  struct Result {
+    std::string name_;
+    unsigned int threads_ = 1;
+    unsigned long long nOps_ = 0;
+    std::chrono::nanoseconds time_;
+
+    double nsPerOp() const { return double(time_.count())/std::max(nOps_, 1ULL); }
+  };
+
+  template<typename F>
+  std::chrono::nanoseconds timed(F&& iFunc) {
+    auto start = std::chrono::high_resolution_clock::now();
+    iFunc();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now()-start);
+  }
+
+  //1, 2, 4, ... up to and including iMaxThreads
+  std::vector<unsigned int> threadCounts(unsigned int iMaxThreads) {
+    std::vector<unsigned int> counts;
+    for(unsigned int t = 1; t < iMaxThreads; t *= 2) {
+      counts.push_back(t);
+    }
+    counts.push_back(iMaxThreads);
+    return counts;
+  }
+
+  Result taskHolderCopy(unsigned long long iN) {
+    tbb::task_group group;
+    long long count = 0;
+    auto time = timed([&]() {
+        TaskHolder holder(group, make_functor_task([&count]() { ++count; }));
+        for(unsigned long long i = 0; i < iN; ++i) {
+          TaskHolder copy(holder);
+        }
+      });
+    group.wait();
+    s_sink += count;
+    return {"TaskHolder copy", 1, iN, time};
+  }
+
+  Result taskHolderDoneWaiting(unsigned long long iN) {
+    tbb::task_group group;
+    std::atomic<long long> count{0};
+    auto time = timed([&]() {
+        for(unsigned long long i = 0; i < iN; ++i) {
+          TaskHolder holder(group, make_functor_task([&count]() { ++count; }));
+        }
+        group.wait();
+      });
+    s_sink += count;
+    return {"TaskHolder doneWaiting", 1, iN, time};
+  }
+
+  Result optionalTaskHolderRunNow(unsigned long long iN) {
+    tbb::task_group group;
+    long long count = 0;
+    auto time = timed([&]() {
+        for(unsigned long long i = 0; i < iN; ++i) {
+          OptionalTaskHolder holder(group, make_functor_task([&count]() { ++count; }));
+          holder.runNow();
+        }
+      });
+    s_sink += count;
+    return {"OptionalTaskHolder runNow", 1, iN, time};
+  }
+
+  Result optionalTaskHolderRelease(unsigned long long iN) {
+    tbb::task_group group;
+    std::atomic<long long> count{0};
+    auto time = timed([&]() {
+        for(unsigned long long i = 0; i < iN; ++i) {
+          OptionalTaskHolder holder(group, make_functor_task([&count]() { ++count; }));
+          holder.releaseToTaskHolder();
+        }
+        group.wait();
+      });
+    s_sink += count;
+    return {"OptionalTaskHolder release", 1, iN, time};
+  }
+
+  Result serialTaskQueuePush(unsigned int iProducers, unsigned long long iN) {
+    tbb::task_arena arena(iProducers);
+    SerialTaskQueue queue;
+    //the queue runs one task at a time so a plain counter suffices
+    long long count = 0;
+    unsigned long long const perProducer = iN/iProducers;
+    auto time = timed([&]() {
+        arena.execute([&]() {
+            tbb::task_group group;
+            for(unsigned int p = 0; p < iProducers; ++p) {
+              group.run([&]() {
+                  for(unsigned long long i = 0; i < perProducer; ++i) {
+                    queue.push(group, [&count]() { ++count; });
+                  }
+                });
+            }
+            group.wait();
+          });
+      });
+    if(count != static_cast<long long>(perProducer*iProducers)) {
+      throw std::runtime_error("SerialTaskQueue ran "+std::to_string(count)+" tasks instead of "+std::to_string(perProducer*iProducers));
+    }
+    return {"SerialTaskQueue push", iProducers, perProducer*iProducers, time};
+  }
+
+  class Base {
+  public:
+    virtual ~Base() = default;
+    virtual int value() const = 0;
+  };
+
+  class Derived : public Base {
+  public:
+    explicit Derived(int iValue): value_{iValue} {}
+    int value() const final { return value_; }
+  private:
+    int value_;
+  };
+
+  std::vector<Result> proxyVectorIteration(unsigned long long iN) {
+    constexpr unsigned int kSize = 1000;
+    unsigned long long const nLoops = std::max(iN/kSize, 1ULL);
+    auto proxies = ProxyVector<Base, int>::make<Derived>();
+    proxies.reserve(kSize);
+    std::vector<std::unique_ptr<Base>> pointers;
+    pointers.reserve(kSize);
+    for(unsigned int i = 0; i < kSize; ++i) {
+      proxies.emplace_back(i);
+      pointers.push_back(std::make_unique<Derived>(i));
+    }
+
+    long long sum = 0;
+    auto proxyTime = timed([&]() {
+        for(unsigned long long l = 0; l < nLoops; ++l) {
+          for(auto const& e: proxies) {
+            sum += e.value();
+          }
+        }
+      });
+    auto pointerTime = timed([&]() {
+        for(unsigned long long l = 0; l < nLoops; ++l) {
+          for(auto const& e: pointers) {
+            sum += e->value();
+          }
+        }
+      });
+    s_sink += sum;
+    return {{"ProxyVector iteration", 1, nLoops*kSize, proxyTime},
+            {"unique_ptr vector iteration", 1, nLoops*kSize, pointerTime}};
+  }
+
+  //processes iNEvents with one Lane per thread, as runScanStep of threaded_io_test does
+  Result laneCycle(unsigned int iThreads, unsigned long long iNEvents) {
+    tbb::task_arena arena(iThreads);
+    DummyOutputer out;
+    EmptySource source(iNEvents);
+    std::vector<Lane> lanes;
+    lanes.reserve(iThreads);
+    std::vector<tbb::task_group> groups(iThreads);
+    std::atomic<long> ievt{0};
+    std::chrono::nanoseconds time;
+    arena.execute([&]() {
+        for(unsigned int i = 0; i < iThreads; ++i) {
+          lanes.emplace_back(i, &source, nullptr);
+          auto& lane = lanes.back();
+          for(unsigned int slot = 0; slot < lane.numberOfSlots(); ++slot) {
+            out.setupForLane(lane.sourceLaneIndex(slot), lane.dataProducts(slot));
+          }
+        }
+        time = timed([&]() {
+            for(unsigned int i = 0; i < iThreads; ++i) {
+              auto& lane = lanes[i];
+              auto& group = groups[i];
+              TaskHolder finalTask(group, make_functor_task([&group, task=group.defer([](){})]() mutable { group.run(std::move(task)); }));
+              group.run([&, ft=std::move(finalTask)]() {lane.processEventsAsync(ievt, group, out, std::move(ft));});
+            }
+            for(auto& group: groups) {
+              group.wait();
+            }
+          });
+      });
+    unsigned long long nEventsProcessed = 0;
+    for(auto const& lane: lanes) {
+      nEventsProcessed += lane.numberOfEventsProcessed();
+    }
+    return {"Lane event cycle", iThreads, nEventsProcessed, time};
+  }
+}
+
+int main(int argc, char* argv[]) {
+  unsigned int nThreads = std::max(std::thread::hardware_concurrency(), 1U);
+  unsigned long long nIterations = 1000000;
+  unsigned long long nEvents = 100000;
+  std::string reportFile;
+  for(int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if((arg == "-t" or arg == "-n" or arg == "-e" or arg == "--report") and i+1 < argc) {
+      std::string value(argv[++i]);
+      if(arg == "-t") {
+        nThreads = std::stoul(value);
+      } else if(arg == "-n") {
+        nIterations = std::stoull(value);
+      } else if(arg == "-e") {
+        nEvents = std::stoull(value);
+      } else {
+        reportFile = value;
+      }
+    } else {
+      nThreads = 0;
+      break;
+    }
+  }
+  if(nThreads == 0 or nIterations == 0 or nEvents == 0) {
+    std::cout <<"usage: framework_bench [-t <max # threads>] [-n <# iterations>] [-e <# events>] [--report <file>]"<<std::endl;
+    return 1;
+  }
+
+  try {
+    std::vector<Result> results;
+    results.push_back(taskHolderCopy(nIterations));
+    results.push_back(taskHolderDoneWaiting(nIterations));
+    results.push_back(optionalTaskHolderRunNow(nIterations));
+    results.push_back(optionalTaskHolderRelease(nIterations));
+    for(auto producers: threadCounts(nThreads)) {
+      results.push_back(serialTaskQueuePush(producers, nIterations));
+    }
+    for(auto& r: proxyVectorIteration(nIterations)) {
+      results.push_back(std::move(r));
+    }
+    for(auto threads: threadCounts(nThreads)) {
+      results.push_back(laneCycle(threads, nEvents));
+    }
+
+    RunReport report;
+    auto& resultsReport = report.section("results");
+    for(auto const& r: results) {
+      std::cout <<std::left<<std::setw(30)<<r.name_<<std::right
+                <<" threads "<<std::setw(4)<<r.threads_
+                <<" ops "<<std::setw(10)<<r.nOps_
+                <<std::fixed<<std::setprecision(1)
+                <<" "<<std::setw(10)<<r.nsPerOp()<<" ns/op";
+      if(r.threads_ > 1) {
+        //the thread time spent per operation, to compare with the single threaded cost
+        std::cout <<" "<<std::setw(10)<<r.nsPerOp()*r.threads_<<" thread ns/op";
+      }
+      std::cout <<"\n";
+      auto& entry = resultsReport.section(r.name_).section(std::to_string(r.threads_));
+      entry.set("ops", r.nOps_);
+      entry.set("time_ns", r.time_.count());
+      entry.set("nsPerOp", r.nsPerOp());
+    }
+    std::cout.flush();
+    if(not reportFile.empty()) {
+      std::ofstream file(reportFile);
+      report.write(file);
+    }
+  } catch(std::exception const& e) {
+    std::cout <<"framework_bench failed: "<<e.what()<<std::endl;
+    return 1;
+  }
+  return 0;
+}
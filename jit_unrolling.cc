@@ -0,0 +1,311 @@
+#include "jit_unrolling.h"
+
+#include "TInterpreter.h"
+#include "TStreamerInfo.h"
+#include "TVirtualCollectionProxy.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+using namespace cce::tf;
+
+namespace {
+  std::atomic<bool> s_useJit{false};
+
+  //declared once before any generated function
+  constexpr char const* const kHelpers = R"(
+#include "TBuffer.h"
+#include "Bytes.h"
+#include "TStreamerInfoActions.h"
+#include "TVirtualCollectionProxy.h"
+#include <cstring>
+namespace cce_tf_jit {
+  inline char* writeStart(TBuffer& b, Int_t n) {
+    if(b.Length() + n > b.BufferSize()) {
+      b.AutoExpand(b.Length() + n);
+    }
+    return b.Buffer() + b.Length();
+  }
+  inline char* readStart(TBuffer& b) { return b.Buffer() + b.Length(); }
+  inline void end(TBuffer& b, char* w) { b.SetBufferOffset(w - b.Buffer()); }
+}
+)";
+
+  constexpr char const* const kParameters =
+    "(TBuffer& b, char* a0, TStreamerInfoActions::TActionSequence const* const* s, TVirtualCollectionProxy* const* p,"
+    " char* (*c)(TVirtualCollectionProxy* const*, int, char*, Int_t*))";
+
+  struct BasicType {
+    char const* name_;
+    int size_;
+  };
+
+  std::optional<BasicType> basicType(int iType) {
+    switch(iType) {
+    case TVirtualStreamerInfo::kChar: return BasicType{"Char_t", 1};
+    case TVirtualStreamerInfo::kShort: return BasicType{"Short_t", 2};
+    case TVirtualStreamerInfo::kInt: return BasicType{"Int_t", 4};
+    case TVirtualStreamerInfo::kFloat: return BasicType{"Float_t", 4};
+    case TVirtualStreamerInfo::kDouble: return BasicType{"Double_t", 8};
+    case TVirtualStreamerInfo::kUChar: return BasicType{"UChar_t", 1};
+    case TVirtualStreamerInfo::kUShort: return BasicType{"UShort_t", 2};
+    case TVirtualStreamerInfo::kUInt: return BasicType{"UInt_t", 4};
+    case TVirtualStreamerInfo::kLong64: return BasicType{"Long64_t", 8};
+    case TVirtualStreamerInfo::kULong64: return BasicType{"ULong64_t", 8};
+    case TVirtualStreamerInfo::kBool: return BasicType{"Bool_t", 1};
+    }
+    //e.g. Double32_t and the TObject bits need the actions' own handling
+    return {};
+  }
+
+  //same types as unrolling::writeBuiltins
+  char const* builtinName(EDataType iType) {
+    switch(iType) {
+    case kFloat_t: return "Float_t";
+    case kDouble_t: return "Double_t";
+    case kInt_t: return "Int_t";
+    case kUInt_t: return "UInt_t";
+    case kLong_t: return "Long_t";
+    case kULong_t: return "ULong_t";
+    case kShort_t: return "Short_t";
+    case kUShort_t: return "UShort_t";
+    case kChar_t: return "Char_t";
+    case kUChar_t: return "UChar_t";
+    default: break;
+    }
+    throw std::runtime_error("jitted streamer given unsupported builtin type "+std::to_string(iType));
+  }
+
+  struct Member {
+    BasicType type_;
+    int offset_;
+    int length_;
+  };
+
+  //the data members if every action of the sequence streams a fundamental type or a fixed size array of one
+  std::optional<std::vector<Member>> basicMembers(TStreamerInfoActions::TActionSequence const& iSequence) {
+    std::vector<Member> members;
+    members.reserve(iSequence.fActions.size());
+    for(auto const& action: iSequence.fActions) {
+      auto const* config = action.fConfiguration;
+      auto const* info = config->fCompInfo;
+      if(not info or info->fType != info->fNewType) {
+        return {};
+      }
+      int type = info->fType;
+      int length = 1;
+      if(type > TVirtualStreamerInfo::kOffsetL and type < TVirtualStreamerInfo::kOffsetP) {
+        type -= TVirtualStreamerInfo::kOffsetL;
+        length = info->fLength;
+      }
+      auto basic = basicType(type);
+      if(not basic) {
+        return {};
+      }
+      members.push_back({*basic, static_cast<int>(config->fOffset), length});
+    }
+    return members;
+  }
+
+  class Generator {
+  public:
+    Generator(bool iWrite, bool iNativeEndian): write_{iWrite}, nativeEndian_{iNativeEndian} {}
+
+    void generate(unrolling::ObjectAndCollectionsSequences const& iSequences) {
+      stream(iSequences.m_objects, iSequences.m_collections, 0);
+    }
+    std::string body() const { return out_.str(); }
+    std::vector<unrolling::Sequence> const& sequences() const { return sequences_; }
+
+  private:
+    void stream(unrolling::OffsetAndSequences const& iObjects, unrolling::SequencesForCollections const& iCollections, int iDepth) {
+      auto const address = "a"+std::to_string(iDepth);
+      for(auto const& offAndSeq: iObjects) {
+        if(offAndSeq.second->fActions.empty()) {
+          continue;
+        }
+        if(auto members = basicMembers(*offAndSeq.second)) {
+          stream(*members, address, offAndSeq.first);
+          continue;
+        }
+        out_ <<"b.ApplySequence(*s["<<sequences_.size()<<"], "<<address<<"+"<<offAndSeq.first<<");\n";
+        sequences_.push_back(offAndSeq.second);
+      }
+
+      auto const d = std::to_string(iDepth);
+      for(auto const& coll: iCollections) {
+        auto const index = nCollections_++;
+        auto const collection = "c(p, "+std::to_string(index)+", "+address+"+"+std::to_string(coll.m_offset)+", &n"+d+")";
+        out_ <<"{\nInt_t n"<<d<<";\n";
+        if(write_) {
+          out_ <<"char* e"<<d<<" = "<<collection<<";\n"
+               <<"b.WriteInt(n"<<d<<");\n";
+        } else {
+          out_ <<"b.ReadInt(n"<<d<<");\n"
+               <<"char* e"<<d<<" = "<<collection<<";\n";
+        }
+        if(coll.m_builtinType != kNoType_t) {
+          out_ <<"if(n"<<d<<") { b."<<(write_ ? "Write" : "Read")<<"FastArray(reinterpret_cast<"<<builtinName(coll.m_builtinType)
+               <<"*>(e"<<d<<"), n"<<d<<"); }\n";
+        } else {
+          auto const stride = coll.m_collProxy->GetValueClass()->Size();
+          out_ <<"for(Int_t i"<<d<<" = 0; i"<<d<<" < n"<<d<<"; ++i"<<d<<") {\n"
+               <<"char* a"<<iDepth+1<<" = e"<<d<<" + i"<<d<<"*"<<stride<<";\n";
+          stream(coll.m_offsetAndSequences, coll.m_collections, iDepth+1);
+          out_ <<"}\n";
+        }
+        out_ <<"}\n";
+      }
+    }
+
+    //the same bytes TBufferFile, or NativeEndianBufferFile, would write for each member
+    void stream(std::vector<Member> const& iMembers, std::string const& iAddress, int iOffset) {
+      int bytes = 0;
+      for(auto const& m: iMembers) {
+        bytes += m.type_.size_*m.length_;
+      }
+      if(write_) {
+        out_ <<"{\nchar* w = cce_tf_jit::writeStart(b, "<<bytes<<");\n";
+      } else {
+        out_ <<"{\nchar* w = cce_tf_jit::readStart(b);\n";
+      }
+      for(auto const& m: iMembers) {
+        auto const member = iAddress+"+"+std::to_string(iOffset+m.offset_);
+        if(nativeEndian_ and m.type_.size_ > 1) {
+          auto const size = m.type_.size_*m.length_;
+          if(write_) {
+            out_ <<"std::memcpy(w, "<<member<<", "<<size<<"); w += "<<size<<";\n";
+          } else {
+            out_ <<"std::memcpy("<<member<<", w, "<<size<<"); w += "<<size<<";\n";
+          }
+          continue;
+        }
+        auto const pointer = std::string("reinterpret_cast<")+m.type_.name_+"*>("+member+")";
+        if(m.length_ == 1) {
+          if(write_) {
+            out_ <<"tobuf(w, *"<<pointer<<");\n";
+          } else {
+            out_ <<"frombuf(w, "<<pointer<<");\n";
+          }
+        } else {
+          out_ <<"for(int j = 0; j < "<<m.length_<<"; ++j) { ";
+          if(write_) {
+            out_ <<"tobuf(w, "<<pointer<<"[j]);";
+          } else {
+            out_ <<"frombuf(w, "<<pointer<<"+j);";
+          }
+          out_ <<" }\n";
+        }
+      }
+      out_ <<"cce_tf_jit::end(b, w);\n}\n";
+    }
+
+    std::ostringstream out_;
+    std::vector<unrolling::Sequence> sequences_;
+    int nCollections_ = 0;
+    bool const write_;
+    bool const nativeEndian_;
+  };
+
+  std::shared_ptr<unrolling::JittedStreamer const> jit(TClass& iClass, bool iWrite, bool iNativeEndian) {
+    static std::mutex s_mutex;
+    static std::map<std::tuple<TClass*, bool, bool>, std::shared_ptr<unrolling::JittedStreamer const>> s_streamers;
+    static bool s_declaredHelpers = false;
+
+    std::lock_guard<std::mutex> guard(s_mutex);
+    auto& streamer = s_streamers[{&iClass, iWrite, iNativeEndian}];
+    if(streamer) {
+      return streamer;
+    }
+    if(not s_declaredHelpers) {
+      if(not gInterpreter->Declare(kHelpers)) {
+        throw std::runtime_error("unable to declare the helpers for jitted streamers");
+      }
+      s_declaredHelpers = true;
+    }
+
+    Generator generator(iWrite, iNativeEndian);
+    generator.generate(iWrite ? unrolling::buildWriteActionSequence(iClass) : unrolling::buildReadActionSequence(iClass));
+
+    auto const name = std::string(iWrite ? "cce_tf_jit_write_" : "cce_tf_jit_read_")+std::to_string(s_streamers.size());
+    auto const code = "void "+name+kParameters+" {\n"+generator.body()+"}\n";
+    if(not gInterpreter->Declare(code.c_str())) {
+      throw std::runtime_error(std::string("unable to jit the ")+(iWrite ? "writing" : "reading")+" of class "+iClass.GetName());
+    }
+    auto const address = gInterpreter->Calc(("(long)&"+name).c_str());
+    if(address == 0) {
+      throw std::runtime_error("unable to find the jitted function "+name+" for class "+iClass.GetName());
+    }
+
+    auto jitted = std::make_shared<unrolling::JittedStreamer>();
+    jitted->function_ = reinterpret_cast<unrolling::JittedStreamer::Function>(address);
+    jitted->sequences_ = generator.sequences();
+    jitted->sequencePointers_.reserve(jitted->sequences_.size());
+    for(auto const& s: jitted->sequences_) {
+      jitted->sequencePointers_.push_back(s.get());
+    }
+    streamer = std::move(jitted);
+    return streamer;
+  }
+
+  char* collectionForWrite(TVirtualCollectionProxy* const* iProxies, int iCollection, char* iAddress, Int_t* oSize) {
+    auto proxy = iProxies[iCollection];
+    TVirtualCollectionProxy::TPushPop helper(proxy, iAddress);
+    *oSize = proxy->Size();
+    return *oSize ? static_cast<char*>((*proxy)[0]) : nullptr;
+  }
+
+  char* collectionForRead(TVirtualCollectionProxy* const* iProxies, int iCollection, char* iAddress, Int_t* iSize) {
+    auto proxy = iProxies[iCollection];
+    TVirtualCollectionProxy::TPushPop helper(proxy, iAddress);
+    proxy->Allocate(*iSize, true);
+    return *iSize ? static_cast<char*>((*proxy)[0]) : nullptr;
+  }
+
+  void addCollections(unrolling::SequencesForCollections const& iCollections, std::vector<TVirtualCollectionProxy*>& oProxies) {
+    for(auto const& coll: iCollections) {
+      oProxies.push_back(coll.m_collProxy.get());
+      addCollections(coll.m_collections, oProxies);
+    }
+  }
+}
+
+namespace cce::tf::unrolling {
+  std::shared_ptr<JittedStreamer const> jitWrite(TClass& iClass, bool iNativeEndian) {
+    return jit(iClass, true, iNativeEndian);
+  }
+
+  std::shared_ptr<JittedStreamer const> jitRead(TClass& iClass, bool iNativeEndian) {
+    return jit(iClass, false, iNativeEndian);
+  }
+
+  std::vector<TVirtualCollectionProxy*> collectionsInJitOrder(ObjectAndCollectionsSequences const& iSequences) {
+    std::vector<TVirtualCollectionProxy*> proxies;
+    addCollections(iSequences.m_collections, proxies);
+    return proxies;
+  }
+
+  void writeJitted(JittedStreamer const& iStreamer, TBuffer& oBuffer, void const* iAddress, std::vector<TVirtualCollectionProxy*> const& iProxies) {
+    iStreamer.function_(oBuffer, const_cast<char*>(static_cast<char const*>(iAddress)), iStreamer.sequencePointers_.data(),
+                        iProxies.data(), collectionForWrite);
+  }
+
+  void readJitted(JittedStreamer const& iStreamer, TBuffer& iBuffer, void* iAddress, std::vector<TVirtualCollectionProxy*> const& iProxies) {
+    iStreamer.function_(iBuffer, static_cast<char*>(iAddress), iStreamer.sequencePointers_.data(),
+                        iProxies.data(), collectionForRead);
+  }
+
+  void setUseJit(bool iUse) {
+    s_useJit = iUse;
+  }
+
+  bool useJit() {
+    return s_useJit.load();
+  }
+}
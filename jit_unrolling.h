@@ -0,0 +1,52 @@
+#if !defined(jit_unrolling_h)
+#define jit_unrolling_h
+
+#include "TBuffer.h"
+#include "TClass.h"
+#include "TStreamerInfoActions.h"
+#include "common_unrolling.h"
+#include <memory>
+#include <vector>
+
+namespace cce::tf::unrolling {
+  //Called by a jitted function for the iCollection'th collection, numbered as
+  // in collectionsInJitOrder. Returns the address of the first element. When
+  // writing ioSize is set to the number of elements, when reading the
+  // collection is resized to ioSize.
+  using JitCollectionFunction = char* (*)(TVirtualCollectionProxy* const* iProxies, int iCollection, char* iAddress, Int_t* ioSize);
+
+  /**
+     The action sequences of a TClass turned into C++ which cling compiles
+     once per class. The function streams data members of fundamental types,
+     and fixed size arrays of them, by copying their bytes directly and loops
+     over the elements of the collections itself. All other members, e.g.
+     strings, are streamed by applying the same action sequence the unrolled
+     serializers apply so the bytes are identical to theirs.
+   */
+  struct JittedStreamer {
+    using Function = void (*)(TBuffer&, char* iAddress, TStreamerInfoActions::TActionSequence const* const* iSequences,
+                              TVirtualCollectionProxy* const* iProxies, JitCollectionFunction);
+    Function function_ = nullptr;
+    //the sequences the function applies, by index
+    std::vector<Sequence> sequences_;
+    std::vector<TStreamerInfoActions::TActionSequence const*> sequencePointers_;
+  };
+
+  //Compiled on first use for a class and shared afterwards. iNativeEndian must
+  // match the use of NativeEndianBufferFile.
+  std::shared_ptr<JittedStreamer const> jitWrite(TClass& iClass, bool iNativeEndian);
+  std::shared_ptr<JittedStreamer const> jitRead(TClass& iClass, bool iNativeEndian);
+
+  //the collection proxies of iSequences in the order a JittedStreamer numbers the collections
+  std::vector<TVirtualCollectionProxy*> collectionsInJitOrder(ObjectAndCollectionsSequences const& iSequences);
+
+  //iProxies come from collectionsInJitOrder of the sequences of the same class
+  void writeJitted(JittedStreamer const&, TBuffer& oBuffer, void const* iAddress, std::vector<TVirtualCollectionProxy*> const& iProxies);
+  void readJitted(JittedStreamer const&, TBuffer& iBuffer, void* iAddress, std::vector<TVirtualCollectionProxy*> const& iProxies);
+
+  //If the unrolled serializers and deserializers made afterwards use jitted
+  // streamers. Off by default.
+  void setUseJit(bool);
+  bool useJit();
+}
+#endif
@@ -1,42 +1,55 @@
-#ifndef MULTIDATASET_PLUGIN_H
-#define MULTIDATASET_PLUGIN_H
+#if !defined(multidataset_plugin_h)
+#define multidataset_plugin_h
 
-//#include <mpi.h>
-#include <stdlib.h>
-#include <string.h>
-#include "hdf5.h"
+#include <map>
+#include <string>
+#include <vector>
+#include "HDFCxx.h"
 #include "H5Timing.h"
-#define ENABLE_MULTIDATASET 0
-#define MULTIDATASET_DEFINE 1
 
-#if MULTIDATASET_DEFINE == 1
-typedef struct H5D_rw_multi_t
-{
-    hid_t dset_id;          /* dataset ID */
-    hid_t dset_space_id;    /* dataset selection dataspace ID */
-    hid_t mem_type_id;      /* memory datatype ID */
-    hid_t mem_space_id;     /* memory selection dataspace ID */
-    union {
-        void *rbuf;         /* pointer to read buffer */
-        const void *wbuf;   /* pointer to write buffer */
-    } u;
-} H5D_rw_multi_t;
-#endif
+namespace cce::tf::hdf5 {
+  /**
+     Collects appends to 1D chunked datasets and writes all of them in flush().
+     The appends to one dataset since the last flush become one hyperslab.
+     With HDF5 1.14 or later all datasets are written by a single H5Dwrite_multi
+     call, else by one H5Dwrite per dataset. Datasets are opened on first use
+     and kept open until the writer is destroyed, which must happen before the
+     file is closed.
+   */
+  class MultiDatasetWriter {
+  public:
+    //if given, the writes are recorded in iTiming
+    explicit MultiDatasetWriter(H5Timing const* iTiming = nullptr): timing_{iTiming} {}
+    ~MultiDatasetWriter();
+    MultiDatasetWriter(MultiDatasetWriter const&) = delete;
+    MultiDatasetWriter& operator=(MultiDatasetWriter const&) = delete;
+
+    //the data is copied
+    void append(hid_t iGroup, std::string const& iName, void const* iData, hsize_t iNElements, hid_t iMemType);
+    template<typename T>
+    void append(hid_t iGroup, std::string const& iName, std::vector<T> const& iData) {
+      append(iGroup, iName, iData.data(), iData.size(), H5memtype_for<T>);
+    }
+
+    void flush();
 
-typedef struct multidataset_array {
-    std::vector<hsize_t> *start;
-    std::vector<hsize_t> *end;
-    hsize_t last_end;
-    hid_t did;
-    hid_t mtype;      /* memory datatype ID */
-    std::vector<char*> *temp_mem;
-} multidataset_array;
+    unsigned long long nFlushes() const { return nFlushes_; }
+    //number of H5Dwrite or H5Dwrite_multi calls
+    unsigned long long nWriteCalls() const { return nWriteCalls_; }
 
-int set_hdf5_method(int hdf5_method);
-int get_hdf5_method();
-int init_multidataset();
-int finalize_multidataset();
-int register_multidataset_request_append(const char *name, hid_t gid, void *buf, hsize_t data_size, hid_t mtype);
-int flush_multidatasets();
-//int check_write_status();
+  private:
+    struct PendingDataset {
+      hid_t dataset_ = H5I_INVALID_HID;
+      hid_t memType_ = H5I_INVALID_HID;
+      //length of the dataset including the elements not yet written
+      hsize_t end_ = 0;
+      hsize_t nPending_ = 0;
+      std::vector<char> buffer_;
+    };
+    std::map<std::string, PendingDataset> datasets_;
+    H5Timing const* timing_;
+    unsigned long long nFlushes_ = 0;
+    unsigned long long nWriteCalls_ = 0;
+  };
+}
 #endif
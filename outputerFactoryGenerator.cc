@@ -8,7 +8,9 @@ cce::tf::outputerFactoryGenerator(std::string_view iType, std::string_view iOpti
   std::function<std::unique_ptr<OutputerBase>(unsigned int)> outFactory;
 
   auto keyValues = cce::tf::configKeyValuePairs(iOptions);
-  outFactory = [type=std::string(iType), params=ConfigurationParameters(keyValues)](unsigned int iNLanes) {
+  outFactory = [type=std::string(iType), keyValues](unsigned int iNLanes) {
+    //each call starts with all parameters unused, e.g. when --scan-threads remakes the component
+    ConfigurationParameters params(keyValues);
     auto maker = OutputerFactory::get()->create(type, iNLanes, params);
     if(not maker) {
       return maker;
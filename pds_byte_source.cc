@@ -0,0 +1,450 @@
+#include "pds_byte_source.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "TFile.h"
+
+#include "StorageEmulator.h"
+#include "BlockCache.h"
+
+using namespace cce::tf::pds;
+
+namespace {
+  class FileByteSource : public ByteSource {
+  public:
+    explicit FileByteSource(std::string const& iName): name_{iName} {
+      fd_ = ::open(iName.c_str(), O_RDONLY);
+      if(fd_ < 0) {
+        throw std::runtime_error("unable to open file "+iName+": "+std::strerror(errno));
+      }
+      struct stat info;
+      if(::fstat(fd_, &info) != 0) {
+        ::close(fd_);
+        throw std::runtime_error("unable to get the size of file "+iName);
+      }
+      size_ = info.st_size;
+    }
+    ~FileByteSource() final { ::close(fd_); }
+
+    uint64_t size() const final { return size_; }
+
+    void read(uint64_t iOffset, std::size_t iSize, char* oBuffer) final {
+      while(iSize != 0) {
+        auto nRead = ::pread(fd_, oBuffer, iSize, iOffset);
+        if(nRead <= 0) {
+          throw std::runtime_error("failed to read "+std::to_string(iSize)+" bytes at "+std::to_string(iOffset)+" from "+name_);
+        }
+        oBuffer += nRead;
+        iOffset += nRead;
+        iSize -= nRead;
+      }
+    }
+
+    void readv(std::vector<Range> const& iRanges) final {
+      //adjacent ranges, e.g. a record header and its buffer, need only one system call
+      auto it = iRanges.begin();
+      while(it != iRanges.end()) {
+        std::vector<iovec> io;
+        auto const offset = it->offset_;
+        auto next = offset;
+        std::size_t size = 0;
+        for(; it != iRanges.end() and it->offset_ == next and io.size() < IOV_MAX; ++it) {
+          io.push_back({it->buffer_, it->size_});
+          next += it->size_;
+          size += it->size_;
+        }
+        auto nRead = ::preadv(fd_, io.data(), io.size(), offset);
+        if(nRead < 0 or static_cast<std::size_t>(nRead) != size) {
+          //a short read, finish one range at a time
+          auto rangeOffset = offset;
+          for(auto const& r: io) {
+            read(rangeOffset, r.iov_len, static_cast<char*>(r.iov_base));
+            rangeOffset += r.iov_len;
+          }
+        }
+      }
+    }
+
+  private:
+    std::string name_;
+    int fd_;
+    uint64_t size_;
+  };
+
+  std::atomic<bool> s_directIO{false};
+  std::atomic<std::size_t> s_nDirectIOFiles{0};
+  std::atomic<std::size_t> s_nDirectIOFallbacks{0};
+
+  uint64_t alignDown(uint64_t iValue) {
+    return iValue/kDirectIOAlignment*kDirectIOAlignment;
+  }
+  uint64_t alignUp(uint64_t iValue) {
+    return alignDown(iValue + kDirectIOAlignment - 1);
+  }
+
+  //The aligned buffer O_DIRECT reads go to. Each thread keeps its own, grown as needed.
+  char* bounceBuffer(std::size_t iSize) {
+    struct Deleter {
+      void operator()(char* iBuffer) const { std::free(iBuffer); }
+    };
+    thread_local std::unique_ptr<char, Deleter> s_buffer;
+    thread_local std::size_t s_size = 0;
+    if(iSize > s_size) {
+      s_buffer.reset();
+      s_buffer.reset(static_cast<char*>(std::aligned_alloc(kDirectIOAlignment, iSize)));
+      if(not s_buffer) {
+        s_size = 0;
+        throw std::bad_alloc();
+      }
+      s_size = iSize;
+    }
+    return s_buffer.get();
+  }
+
+  //A local file opened with O_DIRECT. The reads cover whole aligned blocks,
+  // adjacent ranges of a readv are read with one call.
+  class DirectFileByteSource : public ByteSource {
+  public:
+    //returns nullptr if the file system does not support O_DIRECT
+    static std::unique_ptr<DirectFileByteSource> open(std::string const& iName) {
+      int fd = ::open(iName.c_str(), O_RDONLY | O_DIRECT);
+      if(fd < 0) {
+        if(errno == EINVAL) {
+          return {};
+        }
+        throw std::runtime_error("unable to open file "+iName+": "+std::strerror(errno));
+      }
+      struct stat info;
+      if(::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw std::runtime_error("unable to get the size of file "+iName);
+      }
+      std::unique_ptr<DirectFileByteSource> source(new DirectFileByteSource(iName, fd, info.st_size));
+      //some file systems only refuse the unbuffered reads themselves
+      if(info.st_size != 0 and ::pread(fd, bounceBuffer(kDirectIOAlignment), kDirectIOAlignment, 0) < 0 and errno == EINVAL) {
+        return {};
+      }
+      return source;
+    }
+    ~DirectFileByteSource() final { ::close(fd_); }
+
+    uint64_t size() const final { return size_; }
+
+    void read(uint64_t iOffset, std::size_t iSize, char* oBuffer) final {
+      auto const begin = alignDown(iOffset);
+      auto* buffer = readAligned(begin, iOffset + iSize);
+      std::memcpy(oBuffer, buffer + (iOffset - begin), iSize);
+    }
+
+    void readv(std::vector<Range> const& iRanges) final {
+      auto it = iRanges.begin();
+      while(it != iRanges.end()) {
+        auto const first = it;
+        auto next = it->offset_;
+        for(; it != iRanges.end() and it->offset_ == next; ++it) {
+          next += it->size_;
+        }
+        auto const begin = alignDown(first->offset_);
+        auto* buffer = readAligned(begin, next);
+        for(auto r = first; r != it; ++r) {
+          std::memcpy(r->buffer_, buffer + (r->offset_ - begin), r->size_);
+        }
+      }
+    }
+
+  private:
+    DirectFileByteSource(std::string const& iName, int iFD, uint64_t iSize): name_{iName}, fd_{iFD}, size_{iSize} {}
+
+    //reads the blocks from the aligned iBegin until iEnd, which is within the file
+    char* readAligned(uint64_t iBegin, uint64_t iEnd) {
+      auto const size = alignUp(iEnd) - iBegin;
+      auto* buffer = bounceBuffer(size);
+      //the last block of the file is read short
+      std::size_t nRead = 0;
+      while(iBegin + nRead < iEnd) {
+        auto n = ::pread(fd_, buffer + nRead, size - nRead, iBegin + nRead);
+        if(n <= 0) {
+          throw std::runtime_error("failed to read "+std::to_string(iEnd-iBegin)+" bytes at "+std::to_string(iBegin)+" from "+name_);
+        }
+        nRead += n;
+      }
+      return buffer;
+    }
+
+    std::string name_;
+    int fd_;
+    uint64_t size_;
+  };
+
+  //ROOT's TFile plugins (e.g. XRootD and Davix for HTTP) already know how to
+  // do efficient remote vector reads. A TFile is not thread-safe so access is serialized.
+  class RootByteSource : public ByteSource {
+  public:
+    explicit RootByteSource(std::string const& iName): name_{iName} {
+      auto url = iName + (iName.find('?') == std::string::npos ? "?" : "&") + "filetype=raw";
+      file_.reset(TFile::Open(url.c_str()));
+      if(not file_ or file_->IsZombie()) {
+        throw std::runtime_error("unable to open "+iName);
+      }
+      size_ = file_->GetSize();
+    }
+
+    uint64_t size() const final { return size_; }
+
+    void read(uint64_t iOffset, std::size_t iSize, char* oBuffer) final {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if(file_->ReadBuffer(oBuffer, iOffset, iSize)) {
+        throw std::runtime_error("failed to read "+std::to_string(iSize)+" bytes at "+std::to_string(iOffset)+" from "+name_);
+      }
+    }
+
+    void readv(std::vector<Range> const& iRanges) final {
+      std::vector<Long64_t> positions;
+      std::vector<Int_t> sizes;
+      positions.reserve(iRanges.size());
+      sizes.reserve(iRanges.size());
+      std::size_t total = 0;
+      for(auto const& r: iRanges) {
+        positions.push_back(r.offset_);
+        sizes.push_back(r.size_);
+        total += r.size_;
+      }
+      //ReadBuffers puts the ranges one after the other
+      std::vector<char> buffer(total);
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if(file_->ReadBuffers(buffer.data(), positions.data(), sizes.data(), iRanges.size())) {
+          throw std::runtime_error("failed vector read of "+std::to_string(iRanges.size())+" ranges from "+name_);
+        }
+      }
+      auto itBuffer = buffer.data();
+      for(auto const& r: iRanges) {
+        std::copy(itBuffer, itBuffer+r.size_, r.buffer_);
+        itBuffer += r.size_;
+      }
+    }
+
+  private:
+    std::string name_;
+    std::mutex mutex_;
+    std::unique_ptr<TFile> file_;
+    uint64_t size_;
+  };
+
+  //each read, and each vector read, is one request to the emulated storage
+  class EmulatedByteSource : public ByteSource {
+  public:
+    explicit EmulatedByteSource(std::unique_ptr<ByteSource> iSource): source_{std::move(iSource)} {}
+
+    uint64_t size() const final { return source_->size(); }
+
+    void read(uint64_t iOffset, std::size_t iSize, char* oBuffer) final {
+      cce::tf::emulateStorageRequest(iSize);
+      source_->read(iOffset, iSize, oBuffer);
+    }
+
+    void readv(std::vector<Range> const& iRanges) final {
+      std::size_t total = 0;
+      for(auto const& r: iRanges) {
+        total += r.size_;
+      }
+      cce::tf::emulateStorageRequest(total);
+      source_->readv(iRanges);
+    }
+
+  private:
+    std::unique_ptr<ByteSource> source_;
+  };
+
+  //the blocks read are kept in the local block cache so reading them again does not
+  // go to the remote storage
+  class CachedByteSource : public ByteSource {
+  public:
+    CachedByteSource(std::unique_ptr<ByteSource> iSource, std::string iName, cce::tf::BlockCache& iCache):
+      source_{std::move(iSource)}, name_{std::move(iName)}, cache_{iCache} {}
+
+    uint64_t size() const final { return source_->size(); }
+
+    void read(uint64_t iOffset, std::size_t iSize, char* oBuffer) final {
+      auto const nRead = cache_.read(name_, iOffset, iSize, oBuffer, [this](uint64_t iStart, std::size_t iLength, char* oData) {
+          //whole blocks are asked for so stop at the end of the file
+          std::size_t const size = iStart < source_->size() ? std::min<uint64_t>(iLength, source_->size()-iStart) : 0;
+          if(size != 0) {
+            source_->read(iStart, size, oData);
+          }
+          return size;
+        });
+      if(nRead != iSize) {
+        throw std::runtime_error("failed to read "+std::to_string(iSize)+" bytes at "+std::to_string(iOffset)+" from "+name_);
+      }
+    }
+
+  private:
+    std::unique_ptr<ByteSource> source_;
+    std::string name_;
+    cce::tf::BlockCache& cache_;
+  };
+
+  bool isRemote(std::string const& iName) {
+    auto const scheme = iName.find("://");
+    return scheme != std::string::npos and iName.compare(0, scheme, "file") != 0;
+  }
+
+  std::unique_ptr<ByteSource> openLocal(std::string const& iName) {
+    if(s_directIO) {
+      if(auto source = DirectFileByteSource::open(iName)) {
+        ++s_nDirectIOFiles;
+        return source;
+      }
+      if(s_nDirectIOFallbacks++ == 0) {
+        std::cout <<"O_DIRECT is not supported for "<<iName<<", reading through the page cache"<<std::endl;
+      }
+    }
+    return std::make_unique<FileByteSource>(iName);
+  }
+
+  std::unique_ptr<ByteSource> openUnemulated(std::string const& iName) {
+    auto const scheme = iName.find("://");
+    if(scheme == std::string::npos) {
+      return openLocal(iName);
+    }
+    if(iName.compare(0, scheme, "file") == 0) {
+      return openLocal(iName.substr(scheme+3));
+    }
+    return std::make_unique<RootByteSource>(iName);
+  }
+}
+
+namespace cce::tf::pds {
+  void setDirectIO(bool iUse) { s_directIO = iUse; }
+  bool directIO() { return s_directIO; }
+  std::size_t nDirectIOFiles() { return s_nDirectIOFiles; }
+  std::size_t nDirectIOFallbacks() { return s_nDirectIOFallbacks; }
+
+  bool evictFromPageCache(std::string const& iName) {
+    auto const scheme = iName.find("://");
+    std::string const name = (scheme != std::string::npos and iName.compare(0, scheme, "file") == 0) ? iName.substr(scheme+3) : iName;
+    int fd = ::open(name.c_str(), O_RDONLY);
+    if(fd < 0) {
+      std::cout <<"unable to evict "<<iName<<" from the page cache: "<<std::strerror(errno)<<std::endl;
+      return false;
+    }
+    //dirty pages, e.g. of a file just written, are not dropped
+    ::fdatasync(fd);
+    int const result = ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+    if(result != 0) {
+      std::cout <<"unable to evict "<<iName<<" from the page cache: "<<std::strerror(result)<<std::endl;
+      return false;
+    }
+    return true;
+  }
+}
+
+void ByteSource::readv(std::vector<Range> const& iRanges) {
+  for(auto const& r: iRanges) {
+    read(r.offset_, r.size_, r.buffer_);
+  }
+}
+
+std::unique_ptr<ByteSource> cce::tf::pds::openByteSource(std::string const& iName) {
+  auto source = openUnemulated(iName);
+  if(storageEmulator()) {
+    source = std::make_unique<EmulatedByteSource>(std::move(source));
+  }
+  //an emulated file stands in for a remote one
+  if(auto cache = blockCache(); cache and (isRemote(iName) or storageEmulator())) {
+    source = std::make_unique<CachedByteSource>(std::move(source), iName, *cache);
+  }
+  return source;
+}
+
+ByteSourceStreamBuf::ByteSourceStreamBuf(ByteSource& iSource, std::size_t iBufferSize):
+  source_{iSource}, buffer_(iBufferSize) {
+  setg(buffer_.data(), buffer_.data(), buffer_.data());
+}
+
+ByteSourceStreamBuf::int_type ByteSourceStreamBuf::underflow() {
+  auto const next = bufferOffset_ + (egptr() - eback());
+  auto const fileSize = source_.size();
+  if(next >= fileSize) {
+    return traits_type::eof();
+  }
+  auto const size = std::min<uint64_t>(buffer_.size(), fileSize - next);
+  source_.read(next, size, buffer_.data());
+  bufferOffset_ = next;
+  setg(buffer_.data(), buffer_.data(), buffer_.data()+size);
+  return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize ByteSourceStreamBuf::xsgetn(char_type* oData, std::streamsize iSize) {
+  std::streamsize nCopied = std::min<std::streamsize>(iSize, egptr() - gptr());
+  std::copy(gptr(), gptr()+nCopied, oData);
+  gbump(nCopied);
+  if(nCopied == iSize) {
+    return nCopied;
+  }
+  auto const fileSize = source_.size();
+  auto const start = position();
+  if(static_cast<std::size_t>(iSize - nCopied) < buffer_.size()) {
+    //small reads go through the buffer
+    while(nCopied != iSize and underflow() != traits_type::eof()) {
+      auto n = std::min<std::streamsize>(iSize - nCopied, egptr() - gptr());
+      std::copy(gptr(), gptr()+n, oData+nCopied);
+      gbump(n);
+      nCopied += n;
+    }
+    return nCopied;
+  }
+  //large reads, e.g. an event record, go directly to the caller's memory
+  auto const direct = std::min<uint64_t>(iSize - nCopied, fileSize > start ? fileSize - start : 0);
+  source_.read(start, direct, oData+nCopied);
+  bufferOffset_ = start + direct;
+  setg(buffer_.data(), buffer_.data(), buffer_.data());
+  return nCopied + direct;
+}
+
+ByteSourceStreamBuf::pos_type ByteSourceStreamBuf::seekoff(off_type iOffset, std::ios_base::seekdir iDir, std::ios_base::openmode iMode) {
+  off_type base = 0;
+  if(iDir == std::ios_base::cur) {
+    base = position();
+  } else if(iDir == std::ios_base::end) {
+    base = source_.size();
+  }
+  return seekpos(base + iOffset, iMode);
+}
+
+ByteSourceStreamBuf::pos_type ByteSourceStreamBuf::seekpos(pos_type iPosition, std::ios_base::openmode iMode) {
+  off_type const position = iPosition;
+  if(not (iMode & std::ios_base::in) or position < 0 or static_cast<uint64_t>(position) > source_.size()) {
+    return pos_type(off_type(-1));
+  }
+  if(static_cast<uint64_t>(position) >= bufferOffset_ and static_cast<uint64_t>(position) <= bufferOffset_ + (egptr() - eback())) {
+    //still within what was read
+    setg(eback(), eback() + (position - bufferOffset_), egptr());
+  } else {
+    bufferOffset_ = position;
+    setg(buffer_.data(), buffer_.data(), buffer_.data());
+  }
+  return iPosition;
+}
+
+ByteSourceStream::ByteSourceStream(std::unique_ptr<ByteSource> iSource, std::size_t iBufferSize):
+  std::istream(nullptr),
+  source_{std::move(iSource)},
+  buffer_{*source_, iBufferSize} {
+  rdbuf(&buffer_);
+}
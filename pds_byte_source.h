@@ -0,0 +1,85 @@
+#if !defined(pds_byte_source_h)
+#define pds_byte_source_h
+
+#include <cstdint>
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace cce::tf::pds {
+
+  //Where the bytes of a PDS file come from. read and readv may be called concurrently.
+  class ByteSource {
+  public:
+    virtual ~ByteSource() = default;
+
+    virtual uint64_t size() const = 0;
+    //throws if fewer than iSize bytes could be read
+    virtual void read(uint64_t iOffset, std::size_t iSize, char* oBuffer) = 0;
+
+    struct Range {
+      uint64_t offset_;
+      std::size_t size_;
+      char* buffer_;
+    };
+    //the default does one read per range, a remote source sends them all in one request
+    virtual void readv(std::vector<Range> const& iRanges);
+  };
+
+  //A local file, unless iName is a URL (e.g. root:// or https://) in which case
+  // the file is opened with TFile::Open as a raw file. Throws if it can not be opened.
+  // When a StorageEmulator is set, each read of the returned source is delayed by it.
+  // When a BlockCache is set, the reads of a remote, or emulated, file go through it.
+  std::unique_ptr<ByteSource> openByteSource(std::string const& iName);
+
+  //Once setDirectIO(true) was called, local files opened afterwards are read
+  // with O_DIRECT so the reads bypass, and do not fill, the page cache. Each
+  // read is done into a buffer aligned to kDirectIOAlignment covering whole
+  // blocks and the requested bytes are copied out of it. A file system
+  // refusing O_DIRECT, e.g. tmpfs, is read through the page cache instead.
+  constexpr std::size_t kDirectIOAlignment = 4096;
+  void setDirectIO(bool);
+  bool directIO();
+  //number of files read with O_DIRECT and of those read through the page cache instead
+  std::size_t nDirectIOFiles();
+  std::size_t nDirectIOFallbacks();
+
+  //Writes back and then drops the pages of the local file iName from the
+  // page cache so its next reads come from the storage. Returns false, after
+  // printing why, if that was not possible.
+  bool evictFromPageCache(std::string const& iName);
+
+  //Lets the std::istream based readers use a ByteSource
+  class ByteSourceStreamBuf : public std::streambuf {
+  public:
+    ByteSourceStreamBuf(ByteSource& iSource, std::size_t iBufferSize);
+
+  protected:
+    int_type underflow() final;
+    std::streamsize xsgetn(char_type* oData, std::streamsize iSize) final;
+    pos_type seekoff(off_type iOffset, std::ios_base::seekdir iDir, std::ios_base::openmode iMode) final;
+    pos_type seekpos(pos_type iPosition, std::ios_base::openmode iMode) final;
+
+  private:
+    uint64_t position() const { return bufferOffset_ + (gptr() - eback()); }
+
+    ByteSource& source_;
+    std::vector<char> buffer_;
+    //file position of the start of buffer_
+    uint64_t bufferOffset_ = 0;
+  };
+
+  class ByteSourceStream : public std::istream {
+  public:
+    explicit ByteSourceStream(std::unique_ptr<ByteSource> iSource, std::size_t iBufferSize = 64*1024);
+
+    ByteSource& source() { return *source_; }
+  private:
+    std::unique_ptr<ByteSource> source_;
+    ByteSourceStreamBuf buffer_;
+  };
+}
+#endif
@@ -1,18 +1,89 @@
 #include "pds_common.h"
+#include <atomic>
+#include <cstring>
 #include <optional>
 #include <string_view>
+#include <sys/mman.h>
 
 namespace cce::tf::pds {
 
+  namespace {
+    bool s_useHugePages = false;
+    std::atomic<std::size_t> s_nHugePageBuffers{0};
+    std::atomic<std::size_t> s_hugePageBufferBytes{0};
+
+    void* mapHugePages(std::size_t iBytes) {
+#if defined(MAP_HUGETLB)
+      auto address = ::mmap(nullptr, iBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+      if(address != MAP_FAILED) {
+        return address;
+      }
+#endif
+      //no hugetlbfs pages are reserved so use transparent huge pages
+      address = ::mmap(nullptr, iBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if(address == MAP_FAILED) {
+        return nullptr;
+      }
+#if defined(MADV_HUGEPAGE)
+      ::madvise(address, iBytes, MADV_HUGEPAGE);
+#endif
+      //fault in the pages now, after the advice, so they are huge pages
+#if defined(MADV_POPULATE_WRITE)
+      if(0 != ::madvise(address, iBytes, MADV_POPULATE_WRITE))
+#endif
+      {
+        auto bytes = static_cast<char*>(address);
+        for(std::size_t i = 0; i < iBytes; i += 4096) {
+          bytes[i] = 0;
+        }
+      }
+      return address;
+    }
+  }
+
+  void setUseHugePages(bool iUse) { s_useHugePages = iUse; }
+  bool useHugePages() { return s_useHugePages; }
+  std::size_t nHugePageBuffers() { return s_nHugePageBuffers.load(); }
+  std::size_t hugePageBufferBytes() { return s_hugePageBufferBytes.load(); }
+
+  void BufferDeleter::operator()(void* iMemory) const {
+    if(mappedBytes_ != 0) {
+      ::munmap(iMemory, mappedBytes_);
+    } else {
+      delete [] static_cast<char*>(iMemory);
+    }
+  }
+
+  std::pair<void*, BufferDeleter> allocateBuffer(std::size_t iBytes) {
+    if(s_useHugePages and iBytes >= kHugePageSize) {
+      auto const mappedBytes = (iBytes + kHugePageSize - 1)/kHugePageSize*kHugePageSize;
+      if(auto memory = mapHugePages(mappedBytes)) {
+        ++s_nHugePageBuffers;
+        s_hugePageBufferBytes += mappedBytes;
+        return {memory, BufferDeleter{mappedBytes}};
+      }
+    }
+    return {new char[iBytes], BufferDeleter{}};
+  }
+
   std::optional<Compression> toCompression(std::string_view compressionName) {
-    
-    if(compressionName == "" or compressionName =="None") {
+    if(compressionName == "") {
       return pds::Compression::kNone;
-    } else if (compressionName == "LZ4") {
-      return pds::Compression::kLZ4;
-    } else if (compressionName == "ZSTD") {
-      return pds::Compression::kZSTD;
-    } 
+    }
+    for(auto c: kAllCompressions) {
+      if(compressionName == name(c)) {
+        return c;
+      }
+    }
+    return {};
+  }
+
+  std::optional<Compression> fromFileName(char const* i4Characters) {
+    for(auto c: kAllCompressions) {
+      if(std::strncmp(i4Characters, name(c), 4) == 0) {
+        return c;
+      }
+    }
     return {};
   }
 
@@ -32,6 +103,14 @@ namespace cce::tf::pds {
       {
         return "ZSTD";
       }
+    case Compression::kLZ4HC:
+      {
+        return "LZ4HC";
+      }
+    case Compression::kZSTDLong:
+      {
+        return "LongZSTD";
+      }
     }
     //should never get here
     return "";
@@ -42,6 +121,10 @@ namespace cce::tf::pds {
       return pds::Serialization::kRoot;
     } else if(serializationName == "ROOTUnrolled" or serializationName=="Unrolled") {
       return pds::Serialization::kRootUnrolled;
+    } else if(serializationName == "FixedLayout") {
+      return pds::Serialization::kFixedLayout;
+    } else if(serializationName == "NativeUnrolled") {
+      return pds::Serialization::kNativeUnrolled;
     }
     return {};
   }
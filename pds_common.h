@@ -1,19 +1,187 @@
 #if !defined(pds_common_h)
 #define pds_common_h
 
+#include <array>
 #include <optional>
 #include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "EventIdentifier.h"
 
 namespace cce::tf::pds {
-  enum class Compression {kNone, kLZ4, kZSTD};
-  enum class Serialization {kRoot, kRootUnrolled};
+  //kLZ4HC is LZ4's high compression mode, the data is read as kLZ4
+  //kZSTDLong is ZSTD with long distance matching over a 128MB window, the data is read as kZSTD
+  enum class Compression {kNone, kLZ4, kZSTD, kLZ4HC, kZSTDLong};
+  //new values must also be added here and in name
+  constexpr std::array<Compression, 5> kAllCompressions = {Compression::kNone, Compression::kLZ4, Compression::kZSTD,
+                                                           Compression::kLZ4HC, Compression::kZSTDLong};
+  //the data is ZSTD frames
+  constexpr bool isZSTD(Compression iCompression) { return iCompression == Compression::kZSTD or iCompression == Compression::kZSTDLong; }
+  constexpr bool isLZ4(Compression iCompression) { return iCompression == Compression::kLZ4 or iCompression == Compression::kLZ4HC; }
+  //kFixedLayout uses the FixedLayout registered for a type, else kRootUnrolled
+  //kNativeUnrolled is kRootUnrolled with numbers in the byte order of the host
+  enum class Serialization {kRoot, kRootUnrolled, kFixedLayout, kNativeUnrolled};
 
   //returned value is guaranteed to have starting 4 
   // characters be unique for each compression factor
   // (the 4 may or may not include the trailing \0
   const char* name(Compression compression);
+  //from the first 4 characters of name, as stored in a PDS file header
+  std::optional<Compression> fromFileName(char const* i4Characters);
+
+  //Buffers of at least kHugePageSize bytes are mapped aligned to huge pages
+  // once setUseHugePages(true) was called, which must happen before any buffer
+  // is allocated. They are backed by hugetlbfs pages if the system has
+  // some reserved, otherwise transparent huge pages are asked for. In both
+  // cases all pages are faulted in when the buffer is allocated.
+  constexpr std::size_t kHugePageSize = 2*1024*1024;
+  void setUseHugePages(bool);
+  bool useHugePages();
+  //number of buffers and bytes which were mapped with huge pages
+  std::size_t nHugePageBuffers();
+  std::size_t hugePageBufferBytes();
+
+  struct BufferDeleter {
+    void operator()(void*) const;
+    //0 for memory from operator new[]
+    std::size_t mappedBytes_ = 0;
+  };
+  //returns memory for at least iBytes with the deleter which frees it
+  std::pair<void*, BufferDeleter> allocateBuffer(std::size_t iBytes);
+
+  //Storage meant to be reused from one event to the next. The memory only
+  // grows and, unlike std::vector, resize does not initialize the elements.
+  // T must be trivial, e.g. char or uint32_t.
+  template<typename T>
+  class ReusableBuffer {
+  public:
+    void resize(std::size_t iSize) {
+      if(iSize > capacity_) {
+        auto [memory, deleter] = allocateBuffer(iSize*sizeof(T));
+        data_ = std::unique_ptr<T, BufferDeleter>(static_cast<T*>(memory), deleter);
+        capacity_ = iSize;
+      }
+      size_ = iSize;
+    }
+    std::size_t size() const { return size_; }
+    std::size_t capacity() const { return capacity_; }
+
+    T* data() { return data_.get(); }
+    T const* data() const { return data_.get(); }
+    T* begin() { return data_.get(); }
+    T* end() { return data_.get()+size_; }
+    T const* begin() const { return data_.get(); }
+    T const* end() const { return data_.get()+size_; }
+  private:
+    std::unique_ptr<T, BufferDeleter> data_;
+    std::size_t size_ = 0;
+    std::size_t capacity_ = 0;
+  };
 
   std::optional<Compression> toCompression(std::string_view);
   std::optional<Serialization> toSerialization(std::string_view);  
+
+  //The first word of a record header is the index of its record type in the
+  // record names of the file header. All records have the same header, the
+  // size of the record buffer in words, the buffer and a crosscheck word so
+  // a reader only wanting Events can skip the other records using the size.
+  // LuminosityBlock and Run records are written ahead of the first Event of
+  // a new luminosity block or run, their buffers are empty for now.
+  constexpr uint32_t kEventRecordType = 0;
+  constexpr uint32_t kLuminosityBlockRecordType = 1;
+  constexpr uint32_t kRunRecordType = 2;
+  //the record type, run, luminosity block and the 2 words of the event number
+  constexpr size_t kEventHeaderSizeInWords = 5;
+
+  //The optional event index is stored after the last event as a record whose
+  // first header word is kEventIndexRecord. The buffer of the record holds the
+  // number of events followed by kEventIndexEntrySizeInWords words per event
+  //   offset of the event record from the start of the file in words (2 words, low word first)
+  //   run, lumi, event (2 words, high word first)
+  //   size of the record buffer in words
+  //   uncompressed size of the event in bytes
+  // The last kEventIndexTrailerSizeInWords words of the file are the offset of
+  // the index record in words (2 words, low word first) and kEventIndexMarker.
+  constexpr uint32_t kEventIndexRecord = 0xFFFFFFFF;
+  constexpr uint32_t kEventIndexEntrySizeInWords = 8;
+  constexpr uint32_t kEventIndexTrailerSizeInWords = 3;
+  constexpr uint32_t kEventIndexMarker = 3141592*256+255;
+
+  //An optional luminosity block index record directly follows the event
+  // index record. The event index is then ordered by run and luminosity block
+  // and the buffer holds the number of luminosity blocks followed by
+  // kLumiIndexEntrySizeInWords words per luminosity block
+  //   run, lumi, position of its first event in the event index, number of events
+  constexpr uint32_t kLumiIndexRecord = 0xFFFFFFFE;
+  constexpr uint32_t kLumiIndexEntrySizeInWords = 4;
+
+  //In a file whose header has kHeaderRepeatedProductsTag, a data product in
+  // an uncompressed event buffer whose index word has kRepeatedProductBit set
+  // has a stored size of 1 word holding the entry of the repeated products
+  // record which has its bytes. That record follows the events and any event
+  // index, its buffer holds the number of entries followed for each entry by
+  //   index of the data product, size of the bytes in words, the bytes padded to a whole number of words
+  // The last kRepeatedProductsTrailerSizeInWords words of the file are the
+  // offset of the record in words (2 words, low word first) and
+  // kRepeatedProductsMarker. They follow the event index trailer.
+  constexpr uint32_t kRepeatedProductBit = 0x80000000;
+  constexpr uint32_t kRepeatedProductsRecord = 0xFFFFFFFD;
+  constexpr uint32_t kRepeatedProductsTrailerSizeInWords = 3;
+  constexpr uint32_t kRepeatedProductsMarker = 2718281*256+255;
+
+  struct EventIndexEntry {
+    uint64_t offsetInWords_;
+    EventIdentifier eventID_;
+    uint32_t compressedSizeInWords_;
+    uint32_t uncompressedSizeInBytes_;
+  };
+
+  struct LumiIndexEntry {
+    uint32_t run_;
+    uint32_t lumi_;
+    uint32_t firstEvent_;
+    uint32_t nEvents_;
+  };
+
+  //The file header may end with optional sections placed after the product
+  // information. Each section is a tag, the size of its payload in bytes and
+  // then the payload padded to a whole number of words.
+  //  payload is the ZSTD dictionary used to compress the events
+  constexpr uint32_t kHeaderDictionaryTag = 1;
+  //  no payload. Each data product of an event was compressed on its own so the
+  //  event buffer holds
+  //   uncompressed size of the event in bytes (always a multiple of 4)
+  //   number of data products
+  //   for each data product: product index, compressed size in bytes, uncompressed size in bytes
+  //   the compressed data products, each padded to a whole number of words
+  constexpr uint32_t kHeaderPerProductCompressionTag = 2;
+  //  no payload. The last word of each event record buffer is the crc32c of
+  //  the words of the buffer before it. The record size includes that word.
+  constexpr uint32_t kHeaderChecksumTag = 3;
+  //  payload is one byte per data product, in the order of the data products
+  //  in the header, giving the element size the bytes of the data product
+  //  were shuffled with before compression (see byteShuffle), 0 if not
+  //  shuffled. For a whole event buffer the shuffle covers all the stored
+  //  words of the data product, including its padding.
+  constexpr uint32_t kHeaderShuffleTag = 4;
+  //  payload is one word per data product, in the order of the data products
+  //  in the header, giving the number of streams its unrolled serialization
+  //  was split into (see SplitSerializer). Each Event record then holds a
+  //  batch of events, its header has the identifier of the first one, and
+  //  the record buffer holds
+  //   number of events
+  //   for each event: run, lumi, event (2 words, high word first)
+  //   for each stream of each data product: compressed size in bytes, uncompressed size in bytes
+  //   the compressed streams, each padded to a whole number of words
+  //  An uncompressed stream starts with one word per event giving the end of
+  //  the event's bytes, counted from the end of those words.
+  constexpr uint32_t kHeaderSplitTag = 5;
+  //  no payload. A data product which serialized to the same bytes as in the
+  //  event written before may be stored as a reference to the one copy of
+  //  those bytes kept at the end of the file, see kRepeatedProductsRecord.
+  constexpr uint32_t kHeaderRepeatedProductsTag = 6;
 }
 #endif
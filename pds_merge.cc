@@ -0,0 +1,222 @@
+//Concatenates PDS files with the same file header into one file. The event
+// records are copied as they are, without being decompressed, and a new event
+// index is written at the end.
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "pds_common.h"
+#include "pds_reading.h"
+#include "pds_writer.h"
+
+using namespace cce::tf;
+
+namespace {
+  struct Header {
+    pds::Compression compression_;
+    pds::Serialization serialization_;
+    pds::FileOptions options_;
+    std::vector<pds::ProductInfo> products_;
+    //the bytes of the preamble and header, the events begin right after
+    std::vector<char> bytes_;
+  };
+
+  Header readHeader(std::ifstream& iFile) {
+    Header header;
+    header.products_ = pds::readFileHeader(iFile, header.compression_, header.serialization_, header.options_);
+    auto const size = static_cast<std::size_t>(iFile.tellg());
+    header.bytes_.resize(size);
+    iFile.seekg(0);
+    iFile.read(header.bytes_.data(), size);
+    return header;
+  }
+
+  //empty if the files can be concatenated
+  std::string differences(Header const& iFirst, Header const& iOther) {
+    if(iFirst.compression_ != iOther.compression_) {
+      return "compression";
+    }
+    if(iFirst.serialization_ != iOther.serialization_) {
+      return "serialization";
+    }
+    if(iFirst.products_.size() != iOther.products_.size()) {
+      return "number of data products";
+    }
+    for(std::size_t i = 0; i < iFirst.products_.size(); ++i) {
+      auto const& f = iFirst.products_[i];
+      auto const& o = iOther.products_[i];
+      if(f.name() != o.name() or f.className() != o.className()) {
+        return "data product "+f.name()+" of type "+f.className();
+      }
+    }
+    if(iFirst.options_.dictionary_ != iOther.options_.dictionary_) {
+      //the events can only be uncompressed with the dictionary of their own file
+      return "compression dictionary";
+    }
+    if(iFirst.options_.perProductCompression_ != iOther.options_.perProductCompression_) {
+      return "per data product compression";
+    }
+    if(iFirst.options_.shuffle_ != iOther.options_.shuffle_) {
+      return "byte shuffle of the data products";
+    }
+    if(iFirst.bytes_ != iOther.bytes_) {
+      return "file header";
+    }
+    return {};
+  }
+
+  //adds an entry for each event record following the header, returns the size in bytes of all the records
+  // including any Run and LuminosityBlock records
+  uint64_t scanEvents(std::ifstream& iFile, uint64_t iOutputOffsetInWords, std::vector<pds::EventIndexEntry>& oIndex) {
+    uint64_t size = 0;
+    while(true) {
+      //the event header, the record size and the first word of the record, the uncompressed size
+      std::array<uint32_t, pds::kEventHeaderSizeInWords+2> words;
+      iFile.read(reinterpret_cast<char*>(words.data()), words.size()*4);
+      if(not iFile or words[0] == pds::kEventIndexRecord) {
+        break;
+      }
+      uint32_t const recordSize = words[pds::kEventHeaderSizeInWords];
+      if(words[0] == pds::kEventRecordType) {
+        uint64_t eventID = words[3];
+        eventID = (eventID << 32) + words[4];
+        oIndex.push_back({iOutputOffsetInWords+size/4, {words[1], words[2], eventID}, recordSize, words.back() & ~uint32_t(3)});
+      }
+      //the record is followed by a crosscheck word
+      uint64_t const eventSize = (pds::kEventHeaderSizeInWords+1+recordSize+1)*4;
+      size += eventSize;
+      iFile.seekg(eventSize - words.size()*4, std::ios_base::cur);
+    }
+    iFile.clear();
+    return size;
+  }
+
+  void writeAll(int iFD, char const* iData, std::size_t iSize) {
+    while(iSize != 0) {
+      auto written = ::write(iFD, iData, iSize);
+      if(written < 0) {
+        throw std::runtime_error(std::string("write failed: ")+std::strerror(errno));
+      }
+      iData += written;
+      iSize -= written;
+    }
+  }
+
+  //copies iSize bytes starting at iOffset, in the kernel when possible
+  void copyBytes(int iInFD, off_t iOffset, int iOutFD, uint64_t iSize) {
+#if defined(__linux__)
+    while(iSize != 0) {
+      auto copied = ::copy_file_range(iInFD, &iOffset, iOutFD, nullptr, iSize, 0);
+      if(copied <= 0) {
+        if(copied < 0 and errno != EXDEV and errno != ENOSYS and errno != EINVAL and errno != EOPNOTSUPP) {
+          throw std::runtime_error(std::string("copy_file_range failed: ")+std::strerror(errno));
+        }
+        //e.g. an older kernel or files on different file systems
+        break;
+      }
+      iSize -= copied;
+    }
+#endif
+    std::vector<char> buffer(std::min<uint64_t>(iSize, 1<<20));
+    while(iSize != 0) {
+      auto read = ::pread(iInFD, buffer.data(), std::min<uint64_t>(iSize, buffer.size()), iOffset);
+      if(read <= 0) {
+        throw std::runtime_error(std::string("read failed: ")+std::strerror(errno));
+      }
+      writeAll(iOutFD, buffer.data(), read);
+      iOffset += read;
+      iSize -= read;
+    }
+  }
+}
+
+int main(int argc, char* argv[]) {
+  bool writeIndex = true;
+  std::vector<std::string> names;
+  for(int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if(arg == "--no-index") {
+      writeIndex = false;
+    } else {
+      names.push_back(arg);
+    }
+  }
+  if(names.size() < 2) {
+    std::cout <<"usage: pds_merge [--no-index] <output file> <input file>..."<<std::endl;
+    return 1;
+  }
+
+  std::string const& outputName = names[0];
+  int outFD = ::open(outputName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(outFD < 0) {
+    std::cout <<"unable to open "<<outputName<<": "<<std::strerror(errno)<<std::endl;
+    return 1;
+  }
+
+  try {
+    Header first;
+    std::vector<pds::EventIndexEntry> index;
+    uint64_t outputSize = 0;
+    for(std::size_t i = 1; i < names.size(); ++i) {
+      auto const& name = names[i];
+      std::ifstream file(name, std::ios_base::binary);
+      if(not file) {
+        std::cout <<"unable to open "<<name<<std::endl;
+        return 1;
+      }
+      auto header = readHeader(file);
+      if(header.options_.repeatedProducts_) {
+        //its events refer to the repeated products record at the end of the file
+        std::cout <<name<<" stores repeated data products at its end so can not be merged"<<std::endl;
+        return 1;
+      }
+      auto const headerSize = header.bytes_.size();
+      if(i == 1) {
+        writeAll(outFD, header.bytes_.data(), header.bytes_.size());
+        outputSize = header.bytes_.size();
+        first = std::move(header);
+      } else if(auto diff = differences(first, header); not diff.empty()) {
+        std::cout <<name<<" can not be merged with "<<names[1]<<", they differ in their "<<diff<<std::endl;
+        return 1;
+      }
+      auto const nEventsBefore = index.size();
+      auto const eventsSize = scanEvents(file, outputSize/4, index);
+
+      int inFD = ::open(name.c_str(), O_RDONLY);
+      if(inFD < 0) {
+        std::cout <<"unable to open "<<name<<": "<<std::strerror(errno)<<std::endl;
+        return 1;
+      }
+      //the records of a file are next to each other so are copied in one go
+      copyBytes(inFD, headerSize, outFD, eventsSize);
+      ::close(inFD);
+      outputSize += eventsSize;
+      std::cout <<name<<": "<<index.size()-nEventsBefore<<" events"<<std::endl;
+    }
+    if(writeIndex) {
+      auto const record = pds::eventIndexRecord(index, outputSize/4);
+      writeAll(outFD, reinterpret_cast<char const*>(record.data()), record.size()*4);
+      outputSize += record.size()*4;
+    }
+    std::cout <<"wrote "<<index.size()<<" events, "<<outputSize<<" bytes, to "<<outputName<<std::endl;
+  } catch(std::exception const& iE) {
+    std::cout <<"pds_merge failed: "<<iE.what()<<std::endl;
+    ::close(outFD);
+    return 1;
+  }
+  if(::close(outFD) != 0) {
+    std::cout <<"unable to close "<<outputName<<": "<<std::strerror(errno)<<std::endl;
+    return 1;
+  }
+  return 0;
+}
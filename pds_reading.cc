@@ -3,10 +3,16 @@
 #include <array>
 #include <algorithm>
 #include <iostream>
+#include <stdexcept>
+#include <iterator>
+#include <string>
 
 #include "lz4.h"
 #include "zstd.h"
 
+#include "crc32c.h"
+#include "byte_shuffle.h"
+
 #include "TClass.h"
 #include "TBufferFile.h"
 
@@ -14,18 +20,12 @@ using namespace cce::tf::pds;
 
 namespace {
   Compression whichCompression(const char* iName) {
-  if(iName[0] == 'N') {
-    return Compression::kNone;
-  }
-  if(iName[0] == 'L') {
-    return Compression::kLZ4;
-  }
-  if(iName[0] == 'Z') {
-    return Compression::kZSTD;
+    auto compression = fromFileName(iName);
+    if(not compression) {
+      throw std::runtime_error("unknown compression '"+std::string(iName, 4)+"' in PDS file header");
+    }
+    return *compression;
   }
-  assert(false);
-  return Compression::kNone;
-}
 
   struct Preamble {
     uint32_t bufferSize;
@@ -35,10 +35,20 @@ namespace {
 Preamble readPreamble(std::istream& iFile) {
   std::array<uint32_t, 4> header;
   iFile.read(reinterpret_cast<char*>(header.data()),4*4);
-  assert(iFile.rdstate() == std::ios_base::goodbit);
+  if(iFile.rdstate() != std::ios_base::goodbit) {
+    throw std::runtime_error("unable to read the start of the PDS file header");
+  }
 
-  assert(3141592*256+1 == header[0] or 3141592*256+2 == header[0]);
-  Serialization serialization = (header[0] -3141592*256-1) == 0? Serialization::kRoot : Serialization::kRootUnrolled; 
+  Serialization serialization;
+  switch(header[0]) {
+  case 3141592*256+1: serialization = Serialization::kRoot; break;
+  case 3141592*256+2: serialization = Serialization::kRootUnrolled; break;
+  case 3141592*256+3: serialization = Serialization::kFixedLayout; break;
+  case 3141592*256+4: serialization = Serialization::kNativeUnrolled; break;
+  default:
+    //not a PDS file or one written by a newer version
+    throw std::runtime_error("unknown magic word "+std::to_string(header[0])+" in PDS file header");
+  }
   return {header[3], whichCompression(reinterpret_cast<const char*>(&header[2])), serialization};
 }
 
@@ -116,6 +126,24 @@ size_t bytesToWords(size_t nBytes) {
 
 using namespace cce::tf;
 
+pds::DecompressionDictionary::DecompressionDictionary(std::vector<char> const& iDictionary):
+  zstd_{ZSTD_createDDict(iDictionary.data(), iDictionary.size())} {}
+
+void pds::DecompressionDictionary::ZSTDDeleter::operator()(ZSTD_DDict_s* iDictionary) const {
+  ZSTD_freeDDict(iDictionary);
+}
+
+void pds::DecompressionContext::ZSTDDeleter::operator()(ZSTD_DCtx_s* iContext) const {
+  ZSTD_freeDCtx(iContext);
+}
+
+ZSTD_DCtx_s* pds::DecompressionContext::zstd() {
+  if(not zstd_) {
+    zstd_.reset(ZSTD_createDCtx());
+  }
+  return zstd_.get();
+}
+
 uint32_t pds::readword(std::istream& iFile) {
   int32_t word;
   iFile.read(reinterpret_cast<char*>(&word), 4);
@@ -136,7 +164,58 @@ std::vector<uint32_t> pds::readWords(std::istream& iFile, uint32_t bufferSize) {
   return words;
 }
 
+ProductMap pds::selectProducts(std::vector<ProductInfo>& ioInfo, ProductSelector const& iSelector) {
+  if(iSelector.keepsAll()) {
+    return ProductMap();
+  }
+  std::vector<uint32_t> map;
+  map.reserve(ioInfo.size());
+  std::vector<ProductInfo> kept;
+  for(auto& info: ioInfo) {
+    if(iSelector.keep(info.name())) {
+      map.push_back(kept.size());
+      kept.push_back(std::move(info));
+    } else {
+      map.push_back(ProductMap::kNotRead);
+    }
+  }
+  ioInfo = std::move(kept);
+  return ProductMap(std::move(map));
+}
+
+std::vector<uint8_t> pds::selectShuffle(std::vector<uint8_t> const& iShuffle, ProductMap const& iMap, std::size_t iNKept) {
+  if(iShuffle.empty() or iMap.readsAll()) {
+    return iShuffle;
+  }
+  std::vector<uint8_t> kept(iNKept, 0);
+  for(uint32_t i = 0; i < iShuffle.size(); ++i) {
+    auto index = iMap(i);
+    if(index != ProductMap::kNotRead) {
+      kept[index] = iShuffle[i];
+    }
+  }
+  return kept;
+}
+
 std::vector<ProductInfo> pds::readFileHeader(std::istream& file, Compression& compression, Serialization& serialization) {
+  FileOptions options;
+  auto productInfo = readFileHeader(file, compression, serialization, options);
+  if(not options.dictionary_.empty()) {
+    throw std::runtime_error("PDS file uses a compression dictionary which this reader does not support");
+  }
+  if(options.perProductCompression_) {
+    throw std::runtime_error("PDS file uses per data product compression which this reader does not support");
+  }
+  if(not options.shuffle_.empty()) {
+    throw std::runtime_error("PDS file uses byte shuffled data products which this reader does not support");
+  }
+  if(options.repeatedProducts_) {
+    throw std::runtime_error("PDS file stores repeated data products at its end which this reader does not support");
+  }
+  return productInfo;
+}
+
+std::vector<ProductInfo> pds::readFileHeader(std::istream& file, Compression& compression, Serialization& serialization, FileOptions& oOptions, bool iAllowSplit) {
   auto preamble = readPreamble(file);
   auto bufferSize = preamble.bufferSize;
   compression = preamble.compression;
@@ -153,6 +232,56 @@ std::vector<ProductInfo> pds::readFileHeader(std::istream& file, Compression& co
   readTypes(itBuffer, itEnd);
   auto productInfo = readProductInfo(itBuffer, itEnd, types);
   assert(itBuffer != itEnd);
+  oOptions = FileOptions();
+  while(itBuffer+1 != itEnd) {
+    //optional sections: tag, size in bytes and the padded payload
+    assert(itBuffer+2 < itEnd);
+    auto tag = *(itBuffer++);
+    auto payloadSize = *(itBuffer++);
+    assert(itBuffer+bytesToWords(payloadSize) < itEnd);
+    auto itChars = reinterpret_cast<const char*>(&(*itBuffer));
+    switch(tag) {
+    case kHeaderDictionaryTag: {
+      oOptions.dictionary_.assign(itChars, itChars+payloadSize);
+      break;
+    }
+    case kHeaderPerProductCompressionTag: {
+      oOptions.perProductCompression_ = true;
+      break;
+    }
+    case kHeaderChecksumTag: {
+      oOptions.checksum_ = true;
+      break;
+    }
+    case kHeaderShuffleTag: {
+      if(payloadSize != productInfo.size()) {
+        throw std::runtime_error("byte shuffle section of PDS file header has "+std::to_string(payloadSize)+" entries but there are "
+                                 +std::to_string(productInfo.size())+" data products");
+      }
+      oOptions.shuffle_.assign(itChars, itChars+payloadSize);
+      break;
+    }
+    case kHeaderSplitTag: {
+      if(not iAllowSplit) {
+        throw std::runtime_error("PDS file holds split batches of events which this reader does not support, use SplitPDSSource");
+      }
+      if(payloadSize != 4*productInfo.size()) {
+        throw std::runtime_error("split section of PDS file header has "+std::to_string(payloadSize/4)+" entries but there are "
+                                 +std::to_string(productInfo.size())+" data products");
+      }
+      oOptions.split_ = true;
+      oOptions.splitStreams_.assign(itBuffer, itBuffer+productInfo.size());
+      break;
+    }
+    case kHeaderRepeatedProductsTag: {
+      oOptions.repeatedProducts_ = true;
+      break;
+    }
+    default:
+      throw std::runtime_error("unknown optional section "+std::to_string(tag)+" in PDS file header");
+    }
+    itBuffer += bytesToWords(payloadSize);
+  }
   assert(itBuffer+1 == itEnd);
   //std::cout <<*itBuffer <<" "<<bufferSize<<std::endl;
   assert(*itBuffer == bufferSize);
@@ -169,11 +298,22 @@ bool pds::readCompressedEventBuffer(std::istream&file, EventIdentifier& iEventID
 
   //std::cout <<"readEventContent"<<std::endl;
   std::array<uint32_t, kEventHeaderSizeInWords+1> headerBuffer;
-  file.read(reinterpret_cast<char*>(headerBuffer.data()), (kEventHeaderSizeInWords+1)*4);
-  if( file.rdstate() & std::ios_base::eofbit) {
-    return false;
+  while(true) {
+    file.read(reinterpret_cast<char*>(headerBuffer.data()), (kEventHeaderSizeInWords+1)*4);
+    if( file.rdstate() & std::ios_base::eofbit) {
+      return false;
+    }
+    assert(file.rdstate() == std::ios_base::goodbit);
+    if(headerBuffer[0] == kEventIndexRecord or headerBuffer[0] == kRepeatedProductsRecord) {
+      //the index and the repeated products follow the last event
+      return false;
+    }
+    if(headerBuffer[0] == kEventRecordType) {
+      break;
+    }
+    //skip the buffer and crosscheck of a Run or LuminosityBlock record
+    file.seekg(std::streamoff(headerBuffer[kEventHeaderSizeInWords]+1)*4, std::ios_base::cur);
   }
-  assert(file.rdstate() == std::ios_base::goodbit);
 
   int32_t bufferSize = headerBuffer[kEventHeaderSizeInWords];
 
@@ -190,40 +330,371 @@ bool pds::readCompressedEventBuffer(std::istream&file, EventIdentifier& iEventID
   return true;
 }
 
+namespace {
+  //the repeated products record and its trailer may follow the event index trailer
+  std::streamoff indexTrailerEnd(std::istream& iFile) {
+    std::array<uint32_t, kRepeatedProductsTrailerSizeInWords> trailer;
+    iFile.seekg(-std::streamoff(trailer.size()*4), std::ios_base::end);
+    iFile.read(reinterpret_cast<char*>(trailer.data()), trailer.size()*4);
+    if(iFile and trailer[2] == kRepeatedProductsMarker) {
+      uint64_t recordOffset = trailer[1];
+      recordOffset = (recordOffset << 32) + trailer[0];
+      return recordOffset*4;
+    }
+    iFile.clear();
+    iFile.seekg(0, std::ios_base::end);
+    return iFile.tellg();
+  }
+}
+
+std::vector<RepeatedProduct> pds::readRepeatedProducts(std::istream& iFile) {
+  std::vector<RepeatedProduct> products;
+  auto startPosition = iFile.tellg();
+  auto restore = [&iFile, startPosition]() {
+    iFile.clear();
+    iFile.seekg(startPosition);
+  };
+
+  std::array<uint32_t, kRepeatedProductsTrailerSizeInWords> trailer;
+  iFile.seekg(-std::streamoff(trailer.size()*4), std::ios_base::end);
+  iFile.read(reinterpret_cast<char*>(trailer.data()), trailer.size()*4);
+  if(not iFile or trailer[2] != kRepeatedProductsMarker) {
+    restore();
+    return products;
+  }
+  uint64_t recordOffset = trailer[1];
+  recordOffset = (recordOffset << 32) + trailer[0];
+
+  std::array<uint32_t, kEventHeaderSizeInWords+1> headerBuffer;
+  iFile.seekg(recordOffset*4);
+  iFile.read(reinterpret_cast<char*>(headerBuffer.data()), headerBuffer.size()*4);
+  if(not iFile or headerBuffer[0] != kRepeatedProductsRecord) {
+    restore();
+    return products;
+  }
+  uint32_t bufferSize = headerBuffer[kEventHeaderSizeInWords];
+  auto buffer = readWords(iFile, bufferSize+1);
+  assert(buffer[bufferSize] == bufferSize);
+
+  uint32_t nEntries = buffer[0];
+  products.reserve(nEntries);
+  auto it = buffer.begin()+1;
+  for(uint32_t i = 0; i < nEntries; ++i) {
+    auto const sizeInWords = it[1];
+    products.push_back({it[0], std::vector<uint32_t>(it+2, it+2+sizeInWords)});
+    it += 2+sizeInWords;
+  }
+  assert(it == buffer.begin()+bufferSize);
+  restore();
+  return products;
+}
+
+std::vector<EventIndexEntry> pds::readEventIndex(std::istream& iFile) {
+  std::vector<EventIndexEntry> index;
+  auto startPosition = iFile.tellg();
+  auto restore = [&iFile, startPosition]() {
+    iFile.clear();
+    iFile.seekg(startPosition);
+  };
+
+  std::array<uint32_t, kEventIndexTrailerSizeInWords> trailer;
+  iFile.seekg(indexTrailerEnd(iFile)-std::streamoff(trailer.size()*4));
+  iFile.read(reinterpret_cast<char*>(trailer.data()), trailer.size()*4);
+  if(not iFile or trailer[2] != kEventIndexMarker) {
+    restore();
+    return index;
+  }
+  uint64_t indexOffset = trailer[1];
+  indexOffset = (indexOffset << 32) + trailer[0];
+
+  std::array<uint32_t, kEventHeaderSizeInWords+1> headerBuffer;
+  iFile.seekg(indexOffset*4);
+  iFile.read(reinterpret_cast<char*>(headerBuffer.data()), headerBuffer.size()*4);
+  if(not iFile or headerBuffer[0] != kEventIndexRecord) {
+    restore();
+    return index;
+  }
+  uint32_t bufferSize = headerBuffer[kEventHeaderSizeInWords];
+  auto buffer = readWords(iFile, bufferSize+1);
+  assert(buffer[bufferSize] == bufferSize);
+
+  uint32_t nEvents = buffer[0];
+  assert(1+nEvents*kEventIndexEntrySizeInWords == bufferSize);
+  index.reserve(nEvents);
+  for(auto it = buffer.begin()+1; it != buffer.begin()+1+nEvents*kEventIndexEntrySizeInWords; it += kEventIndexEntrySizeInWords) {
+    uint64_t offset = it[1];
+    offset = (offset << 32) + it[0];
+    unsigned long long eventID = it[4];
+    eventID = (eventID << 32) + it[5];
+    index.push_back({offset, {it[2], it[3], eventID}, it[6], it[7]});
+  }
+  restore();
+  return index;
+}
+
+std::vector<LumiIndexEntry> pds::readLumiIndex(std::istream& iFile) {
+  std::vector<LumiIndexEntry> lumis;
+  auto startPosition = iFile.tellg();
+  auto restore = [&iFile, startPosition]() {
+    iFile.clear();
+    iFile.seekg(startPosition);
+  };
+
+  std::array<uint32_t, kEventIndexTrailerSizeInWords> trailer;
+  iFile.seekg(indexTrailerEnd(iFile)-std::streamoff(trailer.size()*4));
+  iFile.read(reinterpret_cast<char*>(trailer.data()), trailer.size()*4);
+  if(not iFile or trailer[2] != kEventIndexMarker) {
+    restore();
+    return lumis;
+  }
+  uint64_t indexOffset = trailer[1];
+  indexOffset = (indexOffset << 32) + trailer[0];
+
+  //skip the event index record
+  std::array<uint32_t, kEventHeaderSizeInWords+1> headerBuffer;
+  iFile.seekg(indexOffset*4);
+  iFile.read(reinterpret_cast<char*>(headerBuffer.data()), headerBuffer.size()*4);
+  if(not iFile or headerBuffer[0] != kEventIndexRecord) {
+    restore();
+    return lumis;
+  }
+  iFile.seekg(std::streamoff(headerBuffer[kEventHeaderSizeInWords]+1)*4, std::ios_base::cur);
+
+  iFile.read(reinterpret_cast<char*>(headerBuffer.data()), headerBuffer.size()*4);
+  if(not iFile or headerBuffer[0] != kLumiIndexRecord) {
+    restore();
+    return lumis;
+  }
+  uint32_t bufferSize = headerBuffer[kEventHeaderSizeInWords];
+  auto buffer = readWords(iFile, bufferSize+1);
+  assert(buffer[bufferSize] == bufferSize);
+
+  uint32_t nLumis = buffer[0];
+  assert(1+nLumis*kLumiIndexEntrySizeInWords == bufferSize);
+  lumis.reserve(nLumis);
+  for(auto it = buffer.begin()+1; it != buffer.begin()+1+nLumis*kLumiIndexEntrySizeInWords; it += kLumiIndexEntrySizeInWords) {
+    lumis.push_back({it[0], it[1], it[2], it[3]});
+  }
+  restore();
+  return lumis;
+}
+
+std::vector<EventIndexEntry> pds::selectLumis(std::vector<EventIndexEntry> const& iIndex, std::vector<LumiIndexEntry> const& iLumis,
+                                              std::vector<std::pair<uint32_t, uint32_t>> const& iSelected) {
+  auto isSelected = [&iSelected](uint32_t iRun, uint32_t iLumi) {
+    return iSelected.end() != std::find(iSelected.begin(), iSelected.end(), std::make_pair(iRun, iLumi));
+  };
+  std::vector<EventIndexEntry> selected;
+  if(iLumis.empty()) {
+    std::copy_if(iIndex.begin(), iIndex.end(), std::back_inserter(selected),
+                 [&isSelected](auto const& iEntry) { return isSelected(iEntry.eventID_.run, iEntry.eventID_.lumi); });
+    return selected;
+  }
+  for(auto const& l: iLumis) {
+    if(isSelected(l.run_, l.lumi_)) {
+      assert(l.firstEvent_+l.nEvents_ <= iIndex.size());
+      selected.insert(selected.end(), iIndex.begin()+l.firstEvent_, iIndex.begin()+l.firstEvent_+l.nEvents_);
+    }
+  }
+  return selected;
+}
+
+void pds::readCompressedEventBuffer(ByteSource& iSource, EventIndexEntry const& iEntry, std::vector<uint32_t>& buffer) {
+  std::vector<std::vector<uint32_t>> buffers(1);
+  buffers[0].swap(buffer);
+  readCompressedEventBuffers(iSource, &iEntry, &iEntry+1, buffers);
+  buffer.swap(buffers[0]);
+}
+
+void pds::readCompressedEventBuffers(ByteSource& iSource, EventIndexEntry const* iBegin, EventIndexEntry const* iEnd,
+                                     std::vector<std::vector<uint32_t>>& oBuffers) {
+  //the event identifier is already in the index so the header is only used as a crosscheck
+  std::vector<std::array<uint32_t, kEventHeaderSizeInWords+1>> headerBuffers(iEnd-iBegin);
+  oBuffers.resize(iEnd-iBegin);
+  std::vector<ByteSource::Range> ranges;
+  ranges.reserve(2*(iEnd-iBegin));
+  for(auto it = iBegin; it != iEnd; ++it) {
+    auto& header = headerBuffers[it-iBegin];
+    auto& buffer = oBuffers[it-iBegin];
+    buffer.resize(it->compressedSizeInWords_+1);
+    uint64_t const offset = it->offsetInWords_*4;
+    ranges.push_back({offset, header.size()*4, reinterpret_cast<char*>(header.data())});
+    ranges.push_back({offset+header.size()*4, buffer.size()*4, reinterpret_cast<char*>(buffer.data())});
+  }
+  iSource.readv(ranges);
+  for(auto it = iBegin; it != iEnd; ++it) {
+    assert(headerBuffers[it-iBegin][kEventHeaderSizeInWords] == it->compressedSizeInWords_);
+    assert(oBuffers[it-iBegin].back() == it->compressedSizeInWords_);
+  }
+}
+
+void pds::checkRecordChecksum(uint32_t const* iBegin, uint32_t const* iEnd, EventIdentifier const& iEventID) {
+  assert(iEnd > iBegin);
+  if(crc32c(iBegin, (iEnd-1-iBegin)*4) != *(iEnd-1)) {
+    throw std::runtime_error("checksum mismatch for PDS event run:"+std::to_string(iEventID.run)+" lumi:"+std::to_string(iEventID.lumi)
+                             +" event:"+std::to_string(iEventID.event));
+  }
+}
 
 std::vector<uint32_t> pds::uncompressEventBuffer(pds::Compression compression, std::vector<uint32_t> const& buffer) {
-  int32_t bufferSize = buffer.size();
-  //lower 2 bits are the number of bytes used in the last word of the compressed sized
-  int32_t uncompressedBufferSize = buffer[0]/4;
-  int32_t bytesInLastWord = buffer[0] % 4;
-  int32_t compressedBufferSizeInBytes = (bufferSize-1)*4 + (bytesInLastWord == 0? 0 : (-4+bytesInLastWord));
-  //std::cout <<"compressed "<<compressedBufferSizeInBytes <<" uncompressed "<<uncompressedBufferSize*4<<" extra bytes "<<bytesInLastWord<<std::endl;
-  std::vector<uint32_t> uBuffer(size_t(uncompressedBufferSize), 0);
-  if(Compression::kLZ4 == compression) {
-    LZ4_decompress_safe(reinterpret_cast<char const*>(&(*(buffer.begin()+1))), reinterpret_cast<char*>(uBuffer.data()),
-                        compressedBufferSizeInBytes,
-                        uncompressedBufferSize*4);
-  } else if(Compression::kZSTD == compression) {
-    ZSTD_decompress(uBuffer.data(), uncompressedBufferSize*4, &(*(buffer.begin()+1)), compressedBufferSizeInBytes);
-  } else if(Compression::kNone == compression) {
-    assert(buffer.size() == uBuffer.size()+2);
-    std::copy(buffer.begin()+1, buffer.begin()+buffer.size(), uBuffer.begin());
+  return uncompressEventBuffer(compression, buffer.data(), buffer.data()+buffer.size());
+}
+
+namespace {
+  uint32_t uncompressedEventBufferSize(uint32_t const* iBegin) {
+    //lower 2 bits are the number of bytes used in the last word of the compressed sized
+    return iBegin[0]/4;
   }
+
+  size_t zstdDecompress(void* iDest, size_t iDestCapacity, void const* iSource, size_t iSourceSize, DecompressionContext* iContext) {
+    if(iContext) {
+      if(iContext->dictionary()) {
+        return ZSTD_decompress_usingDDict(iContext->zstd(), iDest, iDestCapacity, iSource, iSourceSize, iContext->dictionary()->zstd());
+      }
+      return ZSTD_decompressDCtx(iContext->zstd(), iDest, iDestCapacity, iSource, iSourceSize);
+    }
+    return ZSTD_decompress(iDest, iDestCapacity, iSource, iSourceSize);
+  }
+
+  void uncompressEventBufferInto(Compression compression, uint32_t const* iBegin, uint32_t const* iEnd, uint32_t* oBuffer, DecompressionContext* iContext) {
+    int32_t bufferSize = iEnd - iBegin;
+    int32_t uncompressedBufferSize = uncompressedEventBufferSize(iBegin);
+    int32_t bytesInLastWord = iBegin[0] % 4;
+    int32_t compressedBufferSizeInBytes = (bufferSize-1)*4 + (bytesInLastWord == 0? 0 : (-4+bytesInLastWord));
+    //std::cout <<"compressed "<<compressedBufferSizeInBytes <<" uncompressed "<<uncompressedBufferSize*4<<" extra bytes "<<bytesInLastWord<<std::endl;
+    if(isLZ4(compression)) {
+      LZ4_decompress_safe(reinterpret_cast<char const*>(iBegin+1), reinterpret_cast<char*>(oBuffer),
+                          compressedBufferSizeInBytes,
+                          uncompressedBufferSize*4);
+    } else if(isZSTD(compression)) {
+      zstdDecompress(oBuffer, uncompressedBufferSize*4, iBegin+1, compressedBufferSizeInBytes, iContext);
+    } else if(Compression::kNone == compression) {
+      assert(bufferSize == uncompressedBufferSize+2);
+      std::copy(iBegin+1, iBegin+1+uncompressedBufferSize, oBuffer);
+    }
+  }
+
+  void uncompressBufferInto(Compression compression, char const* iBuffer, uint32_t iBufferSize, uint32_t uncompressedBufferSize, char* oBuffer, DecompressionContext* iContext) {
+    if(isLZ4(compression)) {
+      auto size = LZ4_decompress_safe(iBuffer, oBuffer,
+                                      iBufferSize,
+                                      uncompressedBufferSize);
+      if(size != uncompressedBufferSize) {
+        if(size > 0) {
+          std::cout <<" LZ4_decompress_safe decompressed less bytes ("<<size<<") than expected ("<<uncompressedBufferSize<<")"<<std::endl;
+        } else {
+          throw std::runtime_error("LZ4_decompress_safe failed to decompress");
+        }
+      }
+      assert(size == uncompressedBufferSize);
+    } else if(isZSTD(compression)) {
+      zstdDecompress(oBuffer, uncompressedBufferSize, iBuffer, iBufferSize, iContext);
+    } else if(Compression::kNone == compression) {
+      assert(iBufferSize == uncompressedBufferSize);
+      std::copy(iBuffer, iBuffer+iBufferSize, oBuffer);
+    }
+  }
+
+  void uncompressBufferInto(Compression compression, std::vector<char> const& buffer, uint32_t uncompressedBufferSize, char* oBuffer, DecompressionContext* iContext) {
+    uncompressBufferInto(compression, buffer.data(), buffer.size(), uncompressedBufferSize, oBuffer, iContext);
+  }
+
+  constexpr size_t kProductTableEntrySizeInWords = 3;
+
+  //[iBegin, iEnd) is an uncompressed event buffer whose data products were shuffled, oBuffer must be as large
+  void unshuffleDataProducts(uint32_t const* it, uint32_t const* itEnd, std::vector<uint8_t> const& iShuffle, uint32_t* oBuffer) {
+    while(it < itEnd) {
+      auto const productIndex = *it;
+      auto const storedSize = it[1];
+      if(productIndex >= iShuffle.size()) {
+        throw std::runtime_error("data product index "+std::to_string(productIndex)+" has no byte shuffle entry");
+      }
+      *(oBuffer++) = *(it++);
+      *(oBuffer++) = *(it++);
+      byteUnshuffle(reinterpret_cast<char const*>(it), reinterpret_cast<char*>(oBuffer), storedSize*4, iShuffle[productIndex]);
+      it += storedSize;
+      oBuffer += storedSize;
+    }
+    assert(it == itEnd);
+  }
+}
+
+std::vector<uint32_t> pds::uncompressEventBuffer(pds::Compression compression, uint32_t const* iBegin, uint32_t const* iEnd) {
+  std::vector<uint32_t> uBuffer(size_t(uncompressedEventBufferSize(iBegin)), 0);
+  uncompressEventBufferInto(compression, iBegin, iEnd, uBuffer.data(), nullptr);
   return uBuffer;
 }
 
-void pds::deserializeDataProducts(buffer_iterator it, buffer_iterator itEnd, std::vector<DataProductRetriever>& dataProducts, DeserializeStrategy const& deserializers) {
+void pds::uncompressEventBuffer(pds::Compression compression, uint32_t const* iBegin, uint32_t const* iEnd, ReusableBuffer<uint32_t>& oBuffer, DecompressionContext& iContext) {
+  auto const size = uncompressedEventBufferSize(iBegin);
+  oBuffer.resize(size);
+  if(not iContext.shuffle().empty()) {
+    auto& shuffled = iContext.shuffledBuffer();
+    shuffled.resize(size);
+    uncompressEventBufferInto(compression, iBegin, iEnd, shuffled.data(), &iContext);
+    unshuffleDataProducts(shuffled.begin(), shuffled.end(), iContext.shuffle(), oBuffer.data());
+    return;
+  }
+  uncompressEventBufferInto(compression, iBegin, iEnd, oBuffer.data(), &iContext);
+}
 
+namespace {
+  //a DataProductRetriever which was given a serialization by its Source is only given
+  // the view of its bytes, see DataProductRetriever::setSerialized
+  void deserializeOrView(DeserializeProxyBase& iDeserializer, char const* iBegin, size_t iSize, DataProductRetriever& iProduct) {
+    if(auto serialization = iProduct.serialization()) {
+      iProduct.setSerialized(BlobView(iBegin, iSize), *serialization);
+      return;
+    }
+    iProduct.setSize(iDeserializer.deserialize(iBegin, iSize, *iProduct.address()));
+  }
+}
+
+void pds::deserializeDataProducts(buffer_iterator it, buffer_iterator itEnd, std::vector<DataProductRetriever>& dataProducts, DeserializeStrategy& deserializers) {
+  if(it == itEnd) {
+    return;
+  }
+  deserializeDataProducts(&(*it), &(*it)+(itEnd-it), dataProducts, deserializers);
+}
+
+void pds::RepeatedProductsCache::deserialize(uint32_t iEntry, DeserializeProxyBase& iDeserializer, uint32_t iProductIndex, DataProductRetriever& iProduct) {
+  if(held_[iProductIndex] == iEntry) {
+    ++nReused_;
+    return;
+  }
+  auto const& words = products_->at(iEntry).words_;
+  deserializeOrView(iDeserializer, reinterpret_cast<char const*>(words.data()), words.size()*4, iProduct);
+  held_[iProductIndex] = iEntry;
+}
+
+void pds::deserializeDataProducts(uint32_t const* it, uint32_t const* itEnd, std::vector<DataProductRetriever>& dataProducts, DeserializeStrategy& deserializers,
+                                  ProductMap const& iMap, RepeatedProductsCache* iRepeated) {
+
+  auto deserializerView = deserializers.view();
   while(it < itEnd) {
-    auto productIndex = *(it++);
+    auto const indexWord = *(it++);
+    auto productIndex = iMap(indexWord & ~kRepeatedProductBit);
     auto storedSize = *(it++);
+    if(productIndex == ProductMap::kNotRead) {
+      it = it+storedSize;
+      continue;
+    }
+    if(indexWord & kRepeatedProductBit) {
+      if(not iRepeated or iRepeated->empty()) {
+        throw std::runtime_error("PDS event holds a repeated data product but the repeated products of the file were not read");
+      }
+      iRepeated->deserialize(*it, deserializerView[productIndex], productIndex, dataProducts[productIndex]);
+      it = it+storedSize;
+      continue;
+    }
+    if(iRepeated) {
+      iRepeated->given(productIndex);
+    }
     //std::cout <<" deserialize "<<productIndex<<" "<<storedSize<<std::endl;
 
     //std::cout <<dataProducts[productIndex].name()<<" "<<dataProducts[productIndex].classType()->GetName()<<std::endl;
     //std::cout <<"storedSize "<<storedSize<<" "<<storedSize*4<<std::endl;
-    auto readSize = deserializers[productIndex].deserialize(reinterpret_cast<char const*>(&*it), storedSize*4, *dataProducts[productIndex].address());
-    dataProducts[productIndex].setSize(readSize);
-    //std::cout <<" readSize "<<readSize<<"\n";
+    deserializeOrView(deserializerView[productIndex], reinterpret_cast<char const*>(&*it), storedSize*4, dataProducts[productIndex]);
 
     it = it+storedSize;
     //std::cout <<itEnd - it<<std::endl;
@@ -232,47 +703,123 @@ void pds::deserializeDataProducts(buffer_iterator it, buffer_iterator itEnd, std
 }
 
 
+void pds::productBuffers(uint32_t const* iBegin, uint32_t const* iEnd, std::vector<ProductBuffer>& oBuffers) {
+  oBuffers.clear();
+  assert(iEnd-iBegin >= 2);
+  //first word is the uncompressed size of the whole event
+  auto nProducts = iBegin[1];
+  auto itTable = iBegin+2;
+  auto itData = itTable + nProducts*kProductTableEntrySizeInWords;
+  assert(itData <= iEnd);
+  oBuffers.reserve(nProducts);
+  for(uint32_t i=0; i< nProducts; ++i, itTable += kProductTableEntrySizeInWords) {
+    oBuffers.push_back({itTable[0], itTable[1], itTable[2], itData});
+    itData += bytesToWords(itTable[1]);
+  }
+  assert(itData == iEnd);
+}
+
+void pds::uncompressProductBuffer(pds::Compression compression, ProductBuffer const& iProduct, ReusableBuffer<char>& oBuffer, DecompressionContext& iContext) {
+  oBuffer.resize(iProduct.uncompressedSizeInBytes_);
+  auto const& shuffle = iContext.shuffle();
+  if(not shuffle.empty() and shuffle.at(iProduct.productIndex_) != 0) {
+    auto& shuffled = iContext.shuffledBuffer();
+    shuffled.resize(bytesToWords(iProduct.uncompressedSizeInBytes_));
+    auto shuffledChars = reinterpret_cast<char*>(shuffled.data());
+    uncompressBufferInto(compression, reinterpret_cast<char const*>(iProduct.compressed_), iProduct.compressedSizeInBytes_,
+                         iProduct.uncompressedSizeInBytes_, shuffledChars, &iContext);
+    byteUnshuffle(shuffledChars, oBuffer.data(), iProduct.uncompressedSizeInBytes_, shuffle[iProduct.productIndex_]);
+    return;
+  }
+  uncompressBufferInto(compression, reinterpret_cast<char const*>(iProduct.compressed_), iProduct.compressedSizeInBytes_,
+                       iProduct.uncompressedSizeInBytes_, oBuffer.data(), &iContext);
+}
+
+void pds::deserializeDataProduct(char const* iBegin, uint32_t iSize, uint32_t iProductIndex, std::vector<DataProductRetriever>& dataProducts, DeserializeStrategy& deserializers) {
+  deserializeOrView(deserializers[iProductIndex], iBegin, iSize, dataProducts[iProductIndex]);
+}
+
+void pds::uncompressAndDeserializeProducts(pds::Compression compression, uint32_t const* iBegin, uint32_t const* iEnd, ReusableBuffer<char>& oBuffer, DecompressionContext& iContext,
+                                           std::vector<DataProductRetriever>& dataProducts, DeserializeStrategy& deserializers, ProductMap const& iMap) {
+  assert(iEnd-iBegin >= 2);
+  auto nProducts = iBegin[1];
+  auto itTable = iBegin+2;
+  auto itData = itTable + nProducts*kProductTableEntrySizeInWords;
+  for(uint32_t i=0; i< nProducts; ++i, itTable += kProductTableEntrySizeInWords) {
+    ProductBuffer product{itTable[0], itTable[1], itTable[2], itData};
+    itData += bytesToWords(product.compressedSizeInBytes_);
+    auto index = iMap(product.productIndex_);
+    if(index == ProductMap::kNotRead) {
+      continue;
+    }
+    uncompressProductBuffer(compression, product, oBuffer, iContext);
+    deserializeDataProduct(oBuffer.data(), oBuffer.size(), index, dataProducts, deserializers);
+  }
+  assert(itData == iEnd);
+}
+
 std::vector<char> pds::uncompressBuffer(pds::Compression compression, std::vector<char> const& buffer, uint32_t uncompressedBufferSize) {
   std::vector<char> uBuffer(size_t(uncompressedBufferSize), 0);
-  if(Compression::kLZ4 == compression) {
-    auto size = LZ4_decompress_safe(&(*(buffer.begin())), uBuffer.data(),
-                                    buffer.size(),
-                                    uncompressedBufferSize);
-    if(size != uncompressedBufferSize) {
-      if(size > 0) {
-        std::cout <<" LZ4_decompress_safe decompressed less bytes ("<<size<<") than expected ("<<uncompressedBufferSize<<")"<<std::endl;
-      } else {
-        throw std::runtime_error("LZ4_decompress_safe failed to decompress");
-      }
+  uncompressBufferInto(compression, buffer, uncompressedBufferSize, uBuffer.data(), nullptr);
+  return uBuffer;
+}
+
+void pds::uncompressBuffer(pds::Compression compression, std::vector<char> const& buffer, uint32_t uncompressedBufferSize, ReusableBuffer<char>& oBuffer, DecompressionContext& iContext) {
+  oBuffer.resize(uncompressedBufferSize);
+  uncompressBufferInto(compression, buffer, uncompressedBufferSize, oBuffer.data(), &iContext);
+}
+
+void pds::uncompressBuffer(pds::Compression compression, char const* iBuffer, std::size_t iBufferSize, std::size_t iUncompressedSize, char* oBuffer,
+                           DecompressionContext& iContext) {
+  uncompressBufferInto(compression, iBuffer, iBufferSize, iUncompressedSize, oBuffer, &iContext);
+}
+
+void pds::zstdFrames(std::vector<char> const& iBuffer, std::vector<CompressedFrame>& oFrames) {
+  oFrames.clear();
+  std::size_t compressedBegin = 0;
+  std::size_t uncompressedBegin = 0;
+  while(compressedBegin < iBuffer.size()) {
+    auto const source = iBuffer.data()+compressedBegin;
+    auto const remaining = iBuffer.size()-compressedBegin;
+    auto const compressedSize = ZSTD_findFrameCompressedSize(source, remaining);
+    auto const uncompressedSize = ZSTD_getFrameContentSize(source, remaining);
+    if(ZSTD_isError(compressedSize) or uncompressedSize == ZSTD_CONTENTSIZE_UNKNOWN or uncompressedSize == ZSTD_CONTENTSIZE_ERROR) {
+      oFrames.clear();
+      return;
     }
-    assert(size == uncompressedBufferSize);
-  } else if(Compression::kZSTD == compression) {
-    ZSTD_decompress(uBuffer.data(), uncompressedBufferSize, &(*(buffer.begin())), buffer.size());
-  } else if(Compression::kNone == compression) {
-    assert(buffer.size() == uBuffer.size());
-    std::copy(buffer.begin(), buffer.begin()+buffer.size(), uBuffer.begin());
+    oFrames.push_back({compressedBegin, compressedSize, uncompressedBegin, static_cast<std::size_t>(uncompressedSize)});
+    compressedBegin += compressedSize;
+    uncompressedBegin += uncompressedSize;
   }
-  return uBuffer;
+  if(oFrames.size() == 1) {
+    oFrames.clear();
+  }
+}
+
+void pds::uncompressFrame(std::vector<char> const& iBuffer, CompressedFrame const& iFrame, char* oBuffer, DecompressionContext& iContext) {
+  zstdDecompress(oBuffer, iFrame.uncompressedSize_, iBuffer.data()+iFrame.compressedBegin_, iFrame.compressedSize_, &iContext);
 }
 
 void pds::deserializeDataProducts(const char* it, const char* itEnd, 
                                   table_iterator itTable, table_iterator itTableEnd,
-                                  std::vector<DataProductRetriever>& dataProducts, DeserializeStrategy const& deserializers) {
+                                  std::vector<DataProductRetriever>& dataProducts, DeserializeStrategy& deserializers, ProductMap const& iMap) {
 
   auto itBegin = it;
+  auto deserializerView = deserializers.view();
   uint32_t productIndex = 0;
   while(it < itEnd and itTable != itTableEnd) {
     auto start = *itTable;
     auto next = *(++itTable);
     auto storedSize = next - start;
-    if( storedSize != 0) {
+    auto index = iMap(productIndex);
+    if( storedSize != 0 and index == ProductMap::kNotRead) {
+      it = itBegin + next;
+    } else if( storedSize != 0) {
       //std::cout <<" deserialize "<<productIndex<<" "<<storedSize<<std::endl;
 
       //std::cout <<dataProducts[productIndex].name()<<" "<<dataProducts[productIndex].classType()->GetName()<<std::endl;
       //std::cout <<"storedSize "<<storedSize<<" "<<storedSize*4<<std::endl;
-      auto readSize = deserializers[productIndex].deserialize(it, storedSize, *dataProducts[productIndex].address());
-      dataProducts[productIndex].setSize(readSize);
-      //std::cout <<" readSize "<<readSize<<"\n";
+      deserializeOrView(deserializerView[index], it, storedSize, dataProducts[index]);
 
       it = itBegin + next;
       //std::cout <<itEnd - it<<std::endl;
@@ -282,24 +829,51 @@ void pds::deserializeDataProducts(const char* it, const char* itEnd,
   assert(it==itEnd);
 }
 
+void pds::passThroughDataProducts(const char* itBegin, const char* itEnd,
+                                  table_iterator itTable, table_iterator itTableEnd,
+                                  std::vector<DataProductRetriever>& dataProducts, Serialization iSerialization, ProductMap const& iMap) {
+  uint32_t productIndex = 0;
+  while(itTable+1 < itTableEnd) {
+    auto start = *itTable;
+    auto next = *(++itTable);
+    assert(itBegin+next <= itEnd);
+    auto index = iMap(productIndex);
+    if(index != ProductMap::kNotRead) {
+      dataProducts[index].setSerialized(BlobView(itBegin+start, next-start), iSerialization);
+    }
+    ++productIndex;
+  }
+}
+
 
 bool pds::skipToNextEvent(std::istream& iFile) {
-  iFile.seekg(kEventHeaderSizeInWords*4, std::ios_base::cur);
-  if( iFile.rdstate() & std::ios_base::eofbit) {
-    return false;
-  }
-  assert(iFile.rdstate() == std::ios_base::goodbit);
+  //Run and LuminosityBlock records are skipped as well
+  uint32_t recordType;
+  do {
+    recordType = readwordNoCheck(iFile);
+    if( iFile.rdstate() & std::ios_base::eofbit) {
+      return false;
+    }
+    if(recordType == kEventIndexRecord or recordType == kRepeatedProductsRecord) {
+      return false;
+    }
+    iFile.seekg((kEventHeaderSizeInWords-1)*4, std::ios_base::cur);
+    if( iFile.rdstate() & std::ios_base::eofbit) {
+      return false;
+    }
+    assert(iFile.rdstate() == std::ios_base::goodbit);
 
-  int32_t bufferSize = readwordNoCheck(iFile);
-  if( iFile.rdstate() & std::ios_base::eofbit) {
-    return false;
-  }
+    int32_t bufferSize = readwordNoCheck(iFile);
+    if( iFile.rdstate() & std::ios_base::eofbit) {
+      return false;
+    }
 
-  iFile.seekg(bufferSize*4,std::ios_base::cur);
-  assert(iFile.rdstate() == std::ios_base::goodbit);
+    iFile.seekg(bufferSize*4,std::ios_base::cur);
+    assert(iFile.rdstate() == std::ios_base::goodbit);
 
-  int32_t crossCheckBufferSize = readword(iFile);
-  assert(crossCheckBufferSize == bufferSize);
+    int32_t crossCheckBufferSize = readword(iFile);
+    assert(crossCheckBufferSize == bufferSize);
+  } while(recordType != kEventRecordType);
 
   return true;
 }
@@ -9,9 +9,49 @@
 #include "DataProductRetriever.h"
 
 #include "pds_common.h"
+#include "pds_byte_source.h"
+#include "ProductSelector.h"
+
+struct ZSTD_DCtx_s;
+struct ZSTD_DDict_s;
 
 namespace cce::tf::pds {
 
+  //A ZSTD dictionary prepared for decompression. It can be shared between threads.
+  class DecompressionDictionary {
+  public:
+    explicit DecompressionDictionary(std::vector<char> const& iDictionary);
+
+    ZSTD_DDict_s const* zstd() const { return zstd_.get(); }
+  private:
+    struct ZSTDDeleter { void operator()(ZSTD_DDict_s*) const; };
+    std::unique_ptr<ZSTD_DDict_s, ZSTDDeleter> zstd_;
+  };
+
+  //Holds the decompression state so it does not have to be created for each call.
+  // A context must only be used by one thread at a time, e.g. have one per Lane.
+  class DecompressionContext {
+  public:
+    ZSTD_DCtx_s* zstd();
+
+    void setDictionary(DecompressionDictionary const* iDictionary) { dictionary_ = iDictionary; }
+    DecompressionDictionary const* dictionary() const { return dictionary_; }
+
+    //the shuffle element size of each data product, indexed like the product indices of the
+    // buffers being uncompressed, see kHeaderShuffleTag. Empty if nothing was shuffled.
+    void setShuffle(std::vector<uint8_t> iShuffle) { shuffle_ = std::move(iShuffle); }
+    std::vector<uint8_t> const& shuffle() const { return shuffle_; }
+    //holds the still shuffled data after decompression
+    ReusableBuffer<uint32_t>& shuffledBuffer() { return shuffledBuffer_; }
+
+  private:
+    struct ZSTDDeleter { void operator()(ZSTD_DCtx_s*) const; };
+    std::unique_ptr<ZSTD_DCtx_s, ZSTDDeleter> zstd_;
+    DecompressionDictionary const* dictionary_ = nullptr;
+    std::vector<uint8_t> shuffle_;
+    ReusableBuffer<uint32_t> shuffledBuffer_;
+  };
+
   uint32_t readword(std::istream& iFile);
 
   uint32_t readwordNoCheck(std::istream& iFile);
@@ -30,18 +70,148 @@ namespace cce::tf::pds {
     uint32_t index_;
   };
   
+  //Taken from the optional sections at the end of the file header
+  struct FileOptions {
+    //the ZSTD dictionary used for the events, empty if there is none
+    std::vector<char> dictionary_;
+    //each data product of an event was compressed separately
+    bool perProductCompression_ = false;
+    //each event record ends with a checksum, see kHeaderChecksumTag
+    bool checksum_ = false;
+    //the shuffle element size of each data product, empty if none were shuffled, see kHeaderShuffleTag
+    std::vector<uint8_t> shuffle_;
+    //the Event records hold batches of events split into streams, see kHeaderSplitTag
+    bool split_ = false;
+    //the number of streams of each data product when split_ is set
+    std::vector<uint32_t> splitStreams_;
+    //events may store data products as an entry of the repeated products record, see kHeaderRepeatedProductsTag
+    bool repeatedProducts_ = false;
+  };
+
+  //Maps the index of a data product in the file to the index of its
+  // DataProductRetriever. A default constructed map reads all data products.
+  class ProductMap {
+  public:
+    static constexpr uint32_t kNotRead = 0xFFFFFFFF;
+
+    ProductMap() = default;
+    explicit ProductMap(std::vector<uint32_t> iMap): map_(std::move(iMap)) {}
+
+    uint32_t operator()(uint32_t iFileIndex) const { return map_.empty() ? iFileIndex : map_[iFileIndex]; }
+    bool readsAll() const { return map_.empty(); }
+  private:
+    std::vector<uint32_t> map_;
+  };
+  //removes the data products not kept by the selector from ioInfo
+  ProductMap selectProducts(std::vector<ProductInfo>& ioInfo, ProductSelector const&);
+  //the entries of iShuffle for the data products kept by iMap, indexed like the DataProductRetrievers
+  std::vector<uint8_t> selectShuffle(std::vector<uint8_t> const& iShuffle, ProductMap const& iMap, std::size_t iNKept);
+
+  //throws if the file uses options the caller can not handle
   std::vector<ProductInfo> readFileHeader(std::istream&, Compression&, Serialization&);
+  //only a reader passing iAllowSplit can read files with split events
+  std::vector<ProductInfo> readFileHeader(std::istream&, Compression&, Serialization&, FileOptions& oOptions, bool iAllowSplit = false);
+
+  //The bytes of a data product kept once at the end of the file, see kRepeatedProductsRecord
+  struct RepeatedProduct {
+    uint32_t productIndex_;
+    std::vector<uint32_t> words_;
+  };
+  //returns an empty container if the file has no repeated products record. The stream position is left unchanged.
+  std::vector<RepeatedProduct> readRepeatedProducts(std::istream&);
+
+  //Per Lane, remembers which repeated product each data product was last
+  // given so an event storing the same one needs no deserialization.
+  class RepeatedProductsCache {
+  public:
+    RepeatedProductsCache() = default;
+    //iProducts is shared by all Lanes and must outlive the cache
+    RepeatedProductsCache(std::vector<RepeatedProduct> const* iProducts, std::size_t iNDataProducts):
+      products_{iProducts}, held_(iNDataProducts, kNone) {}
+
+    //the data product is given the bytes of iEntry unless it already holds them
+    void deserialize(uint32_t iEntry, DeserializeProxyBase&, uint32_t iProductIndex, DataProductRetriever&);
+    //the data product was given bytes from the event
+    void given(uint32_t iProductIndex) { held_[iProductIndex] = kNone; }
+    bool empty() const { return products_ == nullptr; }
+
+    //number of times a data product already held the bytes
+    unsigned long long nReused() const { return nReused_; }
+  private:
+    static constexpr uint32_t kNone = 0xFFFFFFFF;
+    std::vector<RepeatedProduct> const* products_ = nullptr;
+    std::vector<uint32_t> held_;
+    unsigned long long nReused_ = 0;
+  };
 
-  constexpr size_t kEventHeaderSizeInWords = 5;
   bool skipToNextEvent(std::istream&); //returns true if an event was skipped
   bool readCompressedEventBuffer(std::istream&, EventIdentifier&, std::vector<uint32_t>& buffer);
+
+  //returns an empty container if the file has no index. The stream position is left unchanged.
+  std::vector<EventIndexEntry> readEventIndex(std::istream&);
+  //returns an empty container if the file has no luminosity block index. The stream position is left unchanged.
+  std::vector<LumiIndexEntry> readLumiIndex(std::istream&);
+  //the entries of iIndex in the selected (run, lumi) pairs, found using iLumis if it is not empty
+  std::vector<EventIndexEntry> selectLumis(std::vector<EventIndexEntry> const& iIndex, std::vector<LumiIndexEntry> const& iLumis,
+                                          std::vector<std::pair<uint32_t, uint32_t>> const& iSelected);
+  //reads the record header and buffer with one vector read so can be called concurrently for the same ByteSource
+  void readCompressedEventBuffer(ByteSource&, EventIndexEntry const&, std::vector<uint32_t>& buffer);
+  //reads the events [iBegin, iEnd) of the index with one vector read, oBuffers is resized to hold one buffer per event
+  void readCompressedEventBuffers(ByteSource&, EventIndexEntry const* iBegin, EventIndexEntry const* iEnd,
+                                  std::vector<std::vector<uint32_t>>& oBuffers);
+  //[iBegin, iEnd) holds the event buffer, excluding the crosscheck word, ending with its checksum.
+  // Throws if the checksum does not match, the buffer to uncompress is then [iBegin, iEnd-1)
+  void checkRecordChecksum(uint32_t const* iBegin, uint32_t const* iEnd, EventIdentifier const&);
   std::vector<uint32_t> uncompressEventBuffer(pds::Compression, std::vector<uint32_t> const& buffer);
-  void deserializeDataProducts(std::vector<uint32_t>::const_iterator, std::vector<uint32_t>::const_iterator, std::vector<DataProductRetriever>&, DeserializeStrategy const&);
+  //[iBegin, iEnd) holds the compressed event buffer, excluding the crosscheck word
+  std::vector<uint32_t> uncompressEventBuffer(pds::Compression, uint32_t const* iBegin, uint32_t const* iEnd);
+  //oBuffer is resized to the uncompressed size, avoiding any allocation if it is already large enough
+  void uncompressEventBuffer(pds::Compression, uint32_t const* iBegin, uint32_t const* iEnd, ReusableBuffer<uint32_t>& oBuffer, DecompressionContext&);
+  void deserializeDataProducts(std::vector<uint32_t>::const_iterator, std::vector<uint32_t>::const_iterator, std::vector<DataProductRetriever>&, DeserializeStrategy&);
+  //iRepeated is needed if the file has repeated products, see kHeaderRepeatedProductsTag
+  void deserializeDataProducts(uint32_t const* iBegin, uint32_t const* iEnd, std::vector<DataProductRetriever>&, DeserializeStrategy&,
+                               ProductMap const& iMap = ProductMap(), RepeatedProductsCache* iRepeated = nullptr);
+
+  //A data product in an event buffer written with per product compression
+  struct ProductBuffer {
+    uint32_t productIndex_;
+    uint32_t compressedSizeInBytes_;
+    uint32_t uncompressedSizeInBytes_;
+    uint32_t const* compressed_;
+  };
+  //[iBegin, iEnd) holds the event buffer, excluding the crosscheck word. The
+  // ProductBuffers point into that range.
+  void productBuffers(uint32_t const* iBegin, uint32_t const* iEnd, std::vector<ProductBuffer>& oBuffers);
+  void uncompressProductBuffer(pds::Compression, ProductBuffer const&, ReusableBuffer<char>& oBuffer, DecompressionContext&);
+  void deserializeDataProduct(char const* iBegin, uint32_t iSize, uint32_t iProductIndex, std::vector<DataProductRetriever>&, DeserializeStrategy&);
+  //decompresses and deserializes each data product in turn, reusing oBuffer
+  // Data products not read according to iMap are not decompressed.
+  void uncompressAndDeserializeProducts(pds::Compression, uint32_t const* iBegin, uint32_t const* iEnd, ReusableBuffer<char>& oBuffer, DecompressionContext&,
+                                        std::vector<DataProductRetriever>&, DeserializeStrategy&, ProductMap const& iMap = ProductMap());
 
   std::vector<char> uncompressBuffer(pds::Compression, std::vector<char> const& buffer, uint32_t uncompressedSize);
+  void uncompressBuffer(pds::Compression, std::vector<char> const& buffer, uint32_t uncompressedSize, ReusableBuffer<char>& oBuffer, DecompressionContext&);
+  //oBuffer must be able to hold iUncompressedSize bytes. Buffers can be uncompressed concurrently using different contexts.
+  void uncompressBuffer(pds::Compression, char const* iBuffer, std::size_t iBufferSize, std::size_t iUncompressedSize, char* oBuffer, DecompressionContext&);
+
+  //One ZSTD frame of a buffer holding concatenated frames, as written when compressing in chunks
+  struct CompressedFrame {
+    std::size_t compressedBegin_;
+    std::size_t compressedSize_;
+    std::size_t uncompressedBegin_;
+    std::size_t uncompressedSize_;
+  };
+  //oFrames is left empty unless iBuffer holds more than one ZSTD frame and all frames store their uncompressed size
+  void zstdFrames(std::vector<char> const& iBuffer, std::vector<CompressedFrame>& oFrames);
+  //oBuffer must be able to hold the uncompressed frame. Frames can be uncompressed concurrently using different contexts.
+  void uncompressFrame(std::vector<char> const& iBuffer, CompressedFrame const&, char* oBuffer, DecompressionContext&);
   void deserializeDataProducts(const char* iBufferBegin, const char* iBufferEnd, 
                                std::vector<uint32_t>::const_iterator itTableBegin, std::vector<uint32_t>::const_iterator itTableEnd, 
-                               std::vector<DataProductRetriever>&, DeserializeStrategy const&);
+                               std::vector<DataProductRetriever>&, DeserializeStrategy&, ProductMap const& iMap = ProductMap());
+  //in place of deserializeDataProducts, gives each DataProductRetriever read the view of its bytes in the buffer, see DataProductRetriever::setSerialized
+  void passThroughDataProducts(const char* iBufferBegin, const char* iBufferEnd,
+                               std::vector<uint32_t>::const_iterator itTableBegin, std::vector<uint32_t>::const_iterator itTableEnd,
+                               std::vector<DataProductRetriever>&, Serialization, ProductMap const& iMap = ProductMap());
 
 }
 
@@ -1,65 +1,162 @@
 #include "pds_writer.h"
 #include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
 #include <iostream>
+#include <set>
+#include <tuple>
 
 #include "lz4.h"
+#include "lz4hc.h"
 #include "zstd.h"
+#include "zdict.h"
+
+using namespace cce::tf::pds;
 
 namespace {
   static inline size_t bytesToWords(size_t nBytes) {
     return nBytes/4 + ( (nBytes % 4) == 0 ? 0 : 1);
   }
   
-  std::pair<std::vector<uint32_t>,int> lz4CompressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, std::vector<uint32_t> const& iBuffer) {
+  int lz4Compress(char const* iSource, char* iDest, int iSourceSize, int iDestCapacity, CompressionContext* iContext) {
+    if(iContext) {
+      //1 is the acceleration used by LZ4_compress_default
+      return LZ4_compress_fast_extState(iContext->lz4State(), iSource, iDest, iSourceSize, iDestCapacity, 1);
+    }
+    return LZ4_compress_default(iSource, iDest, iSourceSize, iDestCapacity);
+  }
+
+  int lz4HCCompress(char const* iSource, char* iDest, int iSourceSize, int iDestCapacity, int iCompressionLevel, CompressionContext* iContext) {
+    if(iContext) {
+      return LZ4_compress_HC_extStateHC(iContext->lz4HCState(), iSource, iDest, iSourceSize, iDestCapacity, iCompressionLevel);
+    }
+    return LZ4_compress_HC(iSource, iDest, iSourceSize, iDestCapacity, iCompressionLevel);
+  }
+
+  //the largest window a ZSTD decompressor accepts without being told to allow more
+  constexpr int kZSTDLongWindowLog = 27;
+
+  size_t zstdLongCompress(void* iDest, size_t iDestCapacity, void const* iSource, size_t iSourceSize, int iCompressionLevel, CompressionContext* iContext) {
+    std::unique_ptr<ZSTD_CCtx, size_t(*)(ZSTD_CCtx*)> temp{nullptr, ZSTD_freeCCtx};
+    ZSTD_CCtx* context = nullptr;
+    if(iContext) {
+      context = iContext->zstd();
+    } else {
+      temp.reset(ZSTD_createCCtx());
+      context = temp.get();
+    }
+    //the parameters are sticky so start from the defaults each time
+    ZSTD_CCtx_reset(context, ZSTD_reset_session_and_parameters);
+    if(iContext and iContext->dictionary()) {
+      ZSTD_CCtx_refCDict(context, iContext->dictionary()->zstd());
+    } else {
+      ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel, iCompressionLevel);
+    }
+    ZSTD_CCtx_setParameter(context, ZSTD_c_enableLongDistanceMatching, 1);
+    ZSTD_CCtx_setParameter(context, ZSTD_c_windowLog, kZSTDLongWindowLog);
+    return ZSTD_compress2(context, iDest, iDestCapacity, iSource, iSourceSize);
+  }
+
+  size_t zstdCompress(void* iDest, size_t iDestCapacity, void const* iSource, size_t iSourceSize, int iCompressionLevel, CompressionContext* iContext) {
+    if(iContext) {
+      if(iContext->dictionary()) {
+        return ZSTD_compress_usingCDict(iContext->zstd(), iDest, iDestCapacity, iSource, iSourceSize, iContext->dictionary()->zstd());
+      }
+      return ZSTD_compressCCtx(iContext->zstd(), iDest, iDestCapacity, iSource, iSourceSize, iCompressionLevel);
+    }
+    return ZSTD_compress(iDest, iDestCapacity, iSource, iSourceSize, iCompressionLevel);
+  }
+
+  //cBuffer may hold a previous event, only the bytes after the compressed data in its last word need clearing
+  void finishWordBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, int iCompressedSize, std::vector<uint32_t>& cBuffer) {
+    cBuffer.resize(bytesToWords(iCompressedSize)+iLeadPadding+iTrailingPadding);
+    auto const nUsedInLastWord = iCompressedSize % 4;
+    if(nUsedInLastWord != 0) {
+      auto lastWord = reinterpret_cast<char*>(cBuffer.data()+iLeadPadding)+iCompressedSize;
+      std::fill(lastWord, lastWord+(4-nUsedInLastWord), 0);
+    }
+  }
+
+  //iCompressionLevel < 0 uses LZ4's fast mode
+  int lz4CompressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, std::vector<uint32_t> const& iBuffer, int iCompressionLevel, CompressionContext* iContext, std::vector<uint32_t>& cBuffer) {
     int cSize = 0;
     auto const bound = LZ4_compressBound(iBuffer.size()*4);
-    std::vector<uint32_t> cBuffer(bytesToWords(size_t(bound))+iLeadPadding+iTrailingPadding, 0);
-    cSize = LZ4_compress_default(reinterpret_cast<char const*>(&(*iBuffer.begin())), reinterpret_cast<char*>(&(*(cBuffer.begin()+iLeadPadding))), iBuffer.size()*4, bound);
-    cBuffer.resize(bytesToWords(cSize)+iLeadPadding+iTrailingPadding);
-    return {cBuffer,cSize};
+    cBuffer.resize(bytesToWords(size_t(bound))+iLeadPadding+iTrailingPadding);
+    auto source = reinterpret_cast<char const*>(iBuffer.data());
+    auto dest = reinterpret_cast<char*>(cBuffer.data()+iLeadPadding);
+    if(iCompressionLevel < 0) {
+      cSize = lz4Compress(source, dest, iBuffer.size()*4, bound, iContext);
+    } else {
+      cSize = lz4HCCompress(source, dest, iBuffer.size()*4, bound, iCompressionLevel, iContext);
+    }
+    finishWordBuffer(iLeadPadding, iTrailingPadding, cSize, cBuffer);
+    return cSize;
   }
   
-  std::pair<std::vector<uint32_t>, int> noCompressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, std::vector<uint32_t> const& iBuffer) {
-    int cSize = 0;
-    auto const bound = iBuffer.size()*4;
-    std::vector<uint32_t> cBuffer(iBuffer.size()+iLeadPadding+iTrailingPadding, uint32_t(0));
-    cSize = bound;
+  int noCompressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, std::vector<uint32_t> const& iBuffer, std::vector<uint32_t>& cBuffer) {
+    cBuffer.resize(iBuffer.size()+iLeadPadding+iTrailingPadding);
     std::copy(iBuffer.begin(), iBuffer.end(), cBuffer.begin()+iLeadPadding);
-    return {cBuffer, cSize};
+    return iBuffer.size()*4;
   }
   
-  std::pair<std::vector<uint32_t>, int> zstdCompressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, std::vector<uint32_t> const& iBuffer, int compressionLevel) {
+  int zstdCompressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, std::vector<uint32_t> const& iBuffer, int compressionLevel, bool iLong, CompressionContext* iContext, std::vector<uint32_t>& cBuffer) {
     int cSize = 0;
     auto const bound = ZSTD_compressBound(iBuffer.size()*4);
-    std::vector<uint32_t> cBuffer(bytesToWords(size_t(bound))+iLeadPadding+iTrailingPadding, 0);
-    cSize = ZSTD_compress(&(*(cBuffer.begin()+iLeadPadding)), bound, &(*iBuffer.begin()),  iBuffer.size()*4, compressionLevel);
+    cBuffer.resize(bytesToWords(size_t(bound))+iLeadPadding+iTrailingPadding);
+    auto compress = iLong ? zstdLongCompress : zstdCompress;
+    cSize = compress(cBuffer.data()+iLeadPadding, bound, iBuffer.data(),  iBuffer.size()*4, compressionLevel, iContext);
     if(ZSTD_isError(cSize)) {
       std::cout <<"ERROR in comparession "<<ZSTD_getErrorName(cSize)<<std::endl;
     }
-    cBuffer.resize(bytesToWords(cSize)+iLeadPadding+iTrailingPadding);
-    return {cBuffer,cSize};
+    finishWordBuffer(iLeadPadding, iTrailingPadding, cSize, cBuffer);
+    return cSize;
+  }
+
+  int compressWordBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, Compression iAlgorithm, int iCompressionLevel, std::vector<uint32_t> const& iBuffer, CompressionContext* iContext,
+                         std::vector<uint32_t>& oBuffer) {
+    switch(iAlgorithm) {
+    case Compression::kLZ4 : {
+      return lz4CompressBuffer(iLeadPadding,iTrailingPadding, iBuffer, -1, iContext, oBuffer);
+    }
+    case Compression::kLZ4HC : {
+      return lz4CompressBuffer(iLeadPadding,iTrailingPadding, iBuffer, iCompressionLevel, iContext, oBuffer);
+    }
+    case Compression::kZSTD : {
+      return zstdCompressBuffer(iLeadPadding, iTrailingPadding, iBuffer, iCompressionLevel, false, iContext, oBuffer);
+    }
+    case Compression::kZSTDLong : {
+      return zstdCompressBuffer(iLeadPadding, iTrailingPadding, iBuffer, iCompressionLevel, true, iContext, oBuffer);
+    }
+    case Compression::kNone :
+    default:
+      return noCompressBuffer(iLeadPadding, iTrailingPadding, iBuffer, oBuffer);
+    }
   }
 
 
-  std::vector<char> lz4CompressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, std::vector<char> const& iBuffer) {
+  std::vector<char> lz4CompressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, cce::tf::BlobView iBuffer, int iCompressionLevel, CompressionContext* iContext) {
     auto const bound = LZ4_compressBound(iBuffer.size());
     std::vector<char> cBuffer(bound+iLeadPadding+iTrailingPadding, 0);
-    auto cSize = LZ4_compress_default(&(*iBuffer.begin()), &(*(cBuffer.begin()+iLeadPadding)), iBuffer.size(), bound);
+    auto dest = &(*(cBuffer.begin()+iLeadPadding));
+    auto cSize = iCompressionLevel < 0 ? lz4Compress(iBuffer.data(), dest, iBuffer.size(), bound, iContext)
+                                       : lz4HCCompress(iBuffer.data(), dest, iBuffer.size(), bound, iCompressionLevel, iContext);
     cBuffer.resize(cSize+iLeadPadding+iTrailingPadding);
     return cBuffer;
   }
   
-  std::vector<char> noCompressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, std::vector<char> const& iBuffer) {
+  std::vector<char> noCompressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, cce::tf::BlobView iBuffer) {
     std::vector<char> cBuffer(iBuffer.size()+iLeadPadding+iTrailingPadding, uint32_t(0));
     std::copy(iBuffer.begin(), iBuffer.end(), cBuffer.begin()+iLeadPadding);
     return cBuffer;
   }
   
-  std::vector<char> zstdCompressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, std::vector<char> const& iBuffer, int compressionLevel) {
+  std::vector<char> zstdCompressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, cce::tf::BlobView iBuffer, int compressionLevel, bool iLong, CompressionContext* iContext) {
     int cSize = 0;
     auto const bound = ZSTD_compressBound(iBuffer.size());
     std::vector<char> cBuffer(bound+iLeadPadding+iTrailingPadding, 0);
-    cSize = ZSTD_compress(&(*(cBuffer.begin()+iLeadPadding)), bound, &(*iBuffer.begin()),  iBuffer.size(), compressionLevel);
+    auto compress = iLong ? zstdLongCompress : zstdCompress;
+    cSize = compress(&(*(cBuffer.begin()+iLeadPadding)), bound, iBuffer.data(),  iBuffer.size(), compressionLevel, iContext);
     if(ZSTD_isError(cSize)) {
       std::cout <<"ERROR in comparession "<<ZSTD_getErrorName(cSize)<<std::endl;
     }
@@ -69,42 +166,368 @@ namespace {
 
 }
 
-namespace cce::tf::pds {
-  
-  std::pair<std::vector<uint32_t>, int> compressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, Compression iAlgorithm, int iCompressionLevel, std::vector<uint32_t> const& iBuffer) {
-
+namespace {
+  template<typename BUFFER>
+  auto compressBufferImpl(unsigned int iLeadPadding, unsigned int iTrailingPadding, Compression iAlgorithm, int iCompressionLevel, BUFFER const& iBuffer, CompressionContext* iContext) {
     switch(iAlgorithm) {
     case Compression::kLZ4 : {
-      return lz4CompressBuffer(iLeadPadding,iTrailingPadding, iBuffer);
+      return lz4CompressBuffer(iLeadPadding,iTrailingPadding, iBuffer, -1, iContext);
     }    
+    case Compression::kLZ4HC : {
+      return lz4CompressBuffer(iLeadPadding,iTrailingPadding, iBuffer, iCompressionLevel, iContext);
+    }
     case Compression::kNone : {
       return noCompressBuffer(iLeadPadding, iTrailingPadding, iBuffer);
     } 
     case Compression::kZSTD : {
-      return zstdCompressBuffer(iLeadPadding, iTrailingPadding, iBuffer, iCompressionLevel);
+      return zstdCompressBuffer(iLeadPadding, iTrailingPadding, iBuffer, iCompressionLevel, false, iContext);
+    }
+    case Compression::kZSTDLong : {
+      return zstdCompressBuffer(iLeadPadding, iTrailingPadding, iBuffer, iCompressionLevel, true, iContext);
     }
     default:
       return noCompressBuffer(iLeadPadding, iTrailingPadding, iBuffer);
       
     }
   }
+}
 
-  std::vector<char> compressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, Compression iAlgorithm, int iCompressionLevel, std::vector<char> const& iBuffer) {
+namespace cce::tf::pds {
 
-    switch(iAlgorithm) {
-    case Compression::kLZ4 : {
-      return lz4CompressBuffer(iLeadPadding,iTrailingPadding, iBuffer);
-    }    
-    case Compression::kNone : {
-      return noCompressBuffer(iLeadPadding, iTrailingPadding, iBuffer);
-    } 
-    case Compression::kZSTD : {
-      return zstdCompressBuffer(iLeadPadding, iTrailingPadding, iBuffer, iCompressionLevel);
+  CompressionDictionary::CompressionDictionary(std::vector<char> const& iDictionary, int iCompressionLevel):
+    zstd_{ZSTD_createCDict(iDictionary.data(), iDictionary.size(), iCompressionLevel)} {}
+
+  void CompressionDictionary::ZSTDDeleter::operator()(ZSTD_CDict_s* iDictionary) const {
+    ZSTD_freeCDict(iDictionary);
+  }
+
+  std::vector<char> trainDictionary(std::vector<std::vector<uint32_t>> const& iSamples, std::size_t iMaxDictionarySize) {
+    std::vector<char> samples;
+    std::vector<size_t> sampleSizes;
+    sampleSizes.reserve(iSamples.size());
+    for(auto const& s: iSamples) {
+      auto begin = reinterpret_cast<char const*>(s.data());
+      samples.insert(samples.end(), begin, begin+s.size()*4);
+      sampleSizes.push_back(s.size()*4);
     }
-    default:
-      return noCompressBuffer(iLeadPadding, iTrailingPadding, iBuffer);
-      
+    std::vector<char> dictionary(iMaxDictionarySize);
+    auto size = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), samples.data(), sampleSizes.data(), sampleSizes.size());
+    if(ZDICT_isError(size)) {
+      std::cout <<"ZSTD dictionary training failed: "<<ZDICT_getErrorName(size)<<std::endl;
+      return {};
+    }
+    dictionary.resize(size);
+    return dictionary;
+  }
+
+  void CompressionContext::ZSTDDeleter::operator()(ZSTD_CCtx_s* iContext) const {
+    ZSTD_freeCCtx(iContext);
+  }
+
+  ZSTD_CCtx_s* CompressionContext::zstd() {
+    if(not zstd_) {
+      zstd_.reset(ZSTD_createCCtx());
+    }
+    return zstd_.get();
+  }
+
+  void* CompressionContext::lz4State() {
+    if(not lz4State_) {
+      //operator new[] gives memory aligned enough for LZ4
+      lz4State_ = std::make_unique<char[]>(LZ4_sizeofState());
+    }
+    return lz4State_.get();
+  }
+
+  void* CompressionContext::lz4HCState() {
+    if(not lz4HCState_) {
+      lz4HCState_ = std::make_unique<char[]>(LZ4_sizeofStateHC());
+    }
+    return lz4HCState_.get();
+  }
+  
+  std::vector<uint32_t> eventIndexRecord(std::vector<EventIndexEntry> const& iIndex, uint64_t iIndexOffsetInWords,
+                                         std::vector<LumiIndexEntry> const& iLumis) {
+    std::vector<uint32_t> record = {kEventIndexRecord, 0, 0, 0, 0};
+    record.reserve(record.size()+3+iIndex.size()*kEventIndexEntrySizeInWords+kEventIndexTrailerSizeInWords);
+    auto const bufferBegin = record.size();
+    record.push_back(1+iIndex.size()*kEventIndexEntrySizeInWords);
+    record.push_back(iIndex.size());
+    for(auto const& e: iIndex) {
+      record.push_back(e.offsetInWords_ & 0xFFFFFFFF);
+      record.push_back(e.offsetInWords_ >> 32);
+      record.push_back(e.eventID_.run);
+      record.push_back(e.eventID_.lumi);
+      record.push_back((e.eventID_.event >> 32) & 0xFFFFFFFF);
+      record.push_back(e.eventID_.event & 0xFFFFFFFF);
+      record.push_back(e.compressedSizeInWords_);
+      record.push_back(e.uncompressedSizeInBytes_);
+    }
+    //crosscheck
+    record.push_back(record[bufferBegin]);
+
+    if(not iLumis.empty()) {
+      record.insert(record.end(), {kLumiIndexRecord, 0, 0, 0, 0});
+      auto const lumiBufferBegin = record.size();
+      record.push_back(1+iLumis.size()*kLumiIndexEntrySizeInWords);
+      record.push_back(iLumis.size());
+      for(auto const& l: iLumis) {
+        record.insert(record.end(), {l.run_, l.lumi_, l.firstEvent_, l.nEvents_});
+      }
+      record.push_back(record[lumiBufferBegin]);
+    }
+
+    record.push_back(iIndexOffsetInWords & 0xFFFFFFFF);
+    record.push_back(iIndexOffsetInWords >> 32);
+    record.push_back(kEventIndexMarker);
+    return record;
+  }
+
+  std::optional<uint32_t> RepeatedProducts::entry(uint32_t iProductIndex, uint64_t iHash, BlobView iBlob) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    bool const repeated = hasLast_[iProductIndex] and lastHashes_[iProductIndex] == iHash;
+    lastHashes_[iProductIndex] = iHash;
+    hasLast_[iProductIndex] = true;
+    if(not repeated) {
+      return std::nullopt;
+    }
+    //the bytes are compared so a hash collision can not give the wrong entry
+    auto range = entriesByHash_.equal_range(iHash);
+    for(auto it = range.first; it != range.second; ++it) {
+      auto const& e = entries_[it->second];
+      if(e.productIndex_ == iProductIndex and e.bytes_.size() == iBlob.size() and std::equal(iBlob.begin(), iBlob.end(), e.bytes_.begin())) {
+        ++nReferences_;
+        referencedBytes_ += iBlob.size();
+        return it->second;
+      }
+    }
+    uint32_t const index = entries_.size();
+    entries_.push_back({iProductIndex, iHash, std::vector<char>(iBlob.begin(), iBlob.end())});
+    entriesByHash_.emplace(iHash, index);
+    ++nReferences_;
+    referencedBytes_ += iBlob.size();
+    return index;
+  }
+
+  std::vector<uint32_t> RepeatedProducts::record(uint64_t iRecordOffsetInWords) const {
+    std::vector<uint32_t> record = {kRepeatedProductsRecord, 0, 0, 0, 0};
+    auto const bufferBegin = record.size();
+    record.push_back(0);
+    record.push_back(entries_.size());
+    for(auto const& e: entries_) {
+      uint32_t const sizeInWords = bytesToWords(e.bytes_.size());
+      record.push_back(e.productIndex_);
+      record.push_back(sizeInWords);
+      auto const bytesBegin = record.size();
+      record.resize(record.size()+sizeInWords, 0);
+      std::copy(e.bytes_.begin(), e.bytes_.end(), reinterpret_cast<char*>(record.data()+bytesBegin));
+    }
+    record[bufferBegin] = record.size()-bufferBegin-1;
+    //crosscheck
+    record.push_back(record[bufferBegin]);
+
+    record.push_back(iRecordOffsetInWords & 0xFFFFFFFF);
+    record.push_back(iRecordOffsetInWords >> 32);
+    record.push_back(kRepeatedProductsMarker);
+    return record;
+  }
+
+  std::vector<uint32_t> fileHeader(Serialization iSerialization, Compression iCompression, std::vector<std::pair<std::string, std::string>> const& iProducts,
+                                   std::vector<char> const& iDictionary, bool iPerProductCompression, bool iChecksum, std::vector<uint8_t> const& iShuffle,
+                                   bool iSplit, std::vector<uint32_t> const& iSplitStreams, bool iRepeatedProducts) {
+    std::set<std::string> typeNamesSet;
+    for(auto const& p: iProducts) {
+      std::string n(p.second);
+      n.push_back('\0');
+      typeNamesSet.insert(n);
+    }
+    std::vector<std::string> typeNames(typeNamesSet.begin(), typeNamesSet.end());
+    typeNamesSet.clear();
+    size_t nCharactersInTypeNames = 0U;
+    for(auto const& n: typeNames) {
+      nCharactersInTypeNames += n.size();
+    }
+
+    std::vector<std::pair<uint32_t, std::string>> dataProducts;
+    dataProducts.reserve(iProducts.size());
+    size_t nCharactersInDataProducts = 0U;
+    for(auto const& p: iProducts) {
+      std::string className(p.second);
+      className.push_back('\0');
+      auto itFind = std::lower_bound(typeNames.begin(), typeNames.end(), className);
+      std::string name{p.first};
+      name.push_back('\0');
+      dataProducts.emplace_back(itFind - typeNames.begin(), name);
+      //pad to 32 bit size
+      while( 0 != dataProducts.back().second.size() % 4) {
+        dataProducts.back().second.push_back('\0');
+      }
+      nCharactersInDataProducts += 4 + dataProducts.back().second.size();
+    }
+
+    //in the order of their record types
+    std::array<char, 28> transitions = {'E','v','e','n','t','\0',
+                                        'L','u','m','i','n','o','s','i','t','y','B','l','o','c','k','\0',
+                                        'R','u','n','\0','\0','\0'};
+
+    const auto nWordsInTypeNames = bytesToWords(nCharactersInTypeNames);
+    const auto nWordsInDictionary = iDictionary.empty() ? 0 : 2+bytesToWords(iDictionary.size());
+    const auto nWordsInPerProductCompression = iPerProductCompression ? 2 : 0;
+    const auto nWordsInChecksum = iChecksum ? 2 : 0;
+    const auto nWordsInShuffle = iShuffle.empty() ? 0 : 2+bytesToWords(iShuffle.size());
+    const auto nWordsInSplit = iSplit ? 2+iSplitStreams.size() : 0;
+    const auto nWordsInRepeatedProducts = iRepeatedProducts ? 2 : 0;
+    const uint32_t bufferSize = 1+transitions.size()/4+1+nWordsInTypeNames+1+1+nCharactersInDataProducts/4+nWordsInDictionary+nWordsInPerProductCompression+nWordsInChecksum
+      +nWordsInShuffle+nWordsInSplit+nWordsInRepeatedProducts;
+
+    //the file type identifier, the 'unique' file id, the compression and the header buffer size come before the buffer
+    constexpr size_t kLeadingWords = 4;
+    std::vector<uint32_t> header(kLeadingWords+bufferSize+1, 0);
+    uint32_t* buffer = header.data()+kLeadingWords;
+    size_t bufferPosition = 0;
+
+    //The different record types stored
+    buffer[bufferPosition++] = transitions.size()/4;
+    std::memcpy(reinterpret_cast<char*>(buffer+bufferPosition), transitions.data(), transitions.size());
+    bufferPosition += transitions.size()/4;
+
+    //The 'top level' types stored in the file
+    buffer[bufferPosition++] = nWordsInTypeNames;
+
+    size_t bufferPositionInChars = bufferPosition*4;
+    for(auto const& t: typeNames) {
+      std::memcpy(reinterpret_cast<char*>(buffer)+bufferPositionInChars, t.data(), t.size());
+      bufferPositionInChars+=t.size();
+    }
+    assert(bufferPositionInChars-bufferPosition*4 == nCharactersInTypeNames);
+
+    bufferPosition += nWordsInTypeNames;
+
+    //Information about types that are not at the 'top level' (none for now)
+    buffer[bufferPosition++] = 0;
+
+    //The different data products to be stored
+    buffer[bufferPosition++] = dataProducts.size();
+    for(auto const& dp : dataProducts) {
+      buffer[bufferPosition++] = dp.first;
+      std::memcpy(reinterpret_cast<char*>(buffer+bufferPosition), dp.second.data(), dp.second.size());
+      assert(0 == dp.second.size() % 4);
+      bufferPosition += dp.second.size()/4;
+    }
+
+    if(not iDictionary.empty()) {
+      //Optional ZSTD dictionary used to compress the events
+      buffer[bufferPosition++] = kHeaderDictionaryTag;
+      buffer[bufferPosition++] = iDictionary.size();
+      std::memcpy(reinterpret_cast<char*>(buffer+bufferPosition), iDictionary.data(), iDictionary.size());
+      bufferPosition += bytesToWords(iDictionary.size());
+    }
+    if(iPerProductCompression) {
+      buffer[bufferPosition++] = kHeaderPerProductCompressionTag;
+      buffer[bufferPosition++] = 0;
+    }
+    if(iChecksum) {
+      buffer[bufferPosition++] = kHeaderChecksumTag;
+      buffer[bufferPosition++] = 0;
+    }
+    if(not iShuffle.empty()) {
+      buffer[bufferPosition++] = kHeaderShuffleTag;
+      buffer[bufferPosition++] = iShuffle.size();
+      std::memcpy(reinterpret_cast<char*>(buffer+bufferPosition), iShuffle.data(), iShuffle.size());
+      bufferPosition += bytesToWords(iShuffle.size());
+    }
+    if(iSplit) {
+      assert(iSplitStreams.size() == iProducts.size());
+      buffer[bufferPosition++] = kHeaderSplitTag;
+      buffer[bufferPosition++] = iSplitStreams.size()*4;
+      std::copy(iSplitStreams.begin(), iSplitStreams.end(), buffer+bufferPosition);
+      bufferPosition += iSplitStreams.size();
+    }
+    if(iRepeatedProducts) {
+      buffer[bufferPosition++] = kHeaderRepeatedProductsTag;
+      buffer[bufferPosition++] = 0;
+    }
+    assert(bufferPosition == bufferSize);
+
+    {
+      //The file type identifier
+      uint32_t comp = 0;
+      if(iSerialization == Serialization::kRootUnrolled) {
+        comp = 1;
+      } else if(iSerialization == Serialization::kFixedLayout) {
+        comp = 2;
+      } else if(iSerialization == Serialization::kNativeUnrolled) {
+        comp = 3;
+      }
+      header[0] = 3141592*256+1 + comp;
+    }
+    //The 'unique' file id, just dummy for now
+    header[1] = 0;
+    //Compression type used
+    // note want exactly 4 bytes so sometimes skip trailing \0
+    std::memcpy(&header[2], pds::name(iCompression), 4);
+    //The size of the header buffer in words (excluding first 3 words), before and after the buffer
+    header[3] = bufferSize;
+    header.back() = bufferSize;
+    return header;
+  }
+
+  std::vector<LumiIndexEntry> lumiIndex(std::vector<EventIndexEntry>& ioIndex) {
+    std::stable_sort(ioIndex.begin(), ioIndex.end(), [](auto const& iLHS, auto const& iRHS) {
+        return std::tie(iLHS.eventID_.run, iLHS.eventID_.lumi) < std::tie(iRHS.eventID_.run, iRHS.eventID_.lumi);
+      });
+    std::vector<LumiIndexEntry> lumis;
+    for(uint32_t i = 0; i < ioIndex.size(); ++i) {
+      auto const& id = ioIndex[i].eventID_;
+      if(lumis.empty() or lumis.back().run_ != id.run or lumis.back().lumi_ != id.lumi) {
+        lumis.push_back({id.run, id.lumi, i, 0});
+      }
+      ++lumis.back().nEvents_;
     }
+    return lumis;
+  }
+
+  std::pair<std::vector<uint32_t>, int> compressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, Compression iAlgorithm, int iCompressionLevel, std::vector<uint32_t> const& iBuffer) {
+    std::vector<uint32_t> cBuffer;
+    auto cSize = compressWordBuffer(iLeadPadding, iTrailingPadding, iAlgorithm, iCompressionLevel, iBuffer, nullptr, cBuffer);
+    return {std::move(cBuffer), cSize};
+  }
+
+  std::pair<std::vector<uint32_t>, int> compressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, Compression iAlgorithm, int iCompressionLevel, std::vector<uint32_t> const& iBuffer, CompressionContext& iContext) {
+    std::vector<uint32_t> cBuffer;
+    auto cSize = compressWordBuffer(iLeadPadding, iTrailingPadding, iAlgorithm, iCompressionLevel, iBuffer, &iContext, cBuffer);
+    return {std::move(cBuffer), cSize};
+  }
+
+  int compressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, Compression iAlgorithm, int iCompressionLevel, std::vector<uint32_t> const& iBuffer, CompressionContext& iContext,
+                     std::vector<uint32_t>& oBuffer) {
+    return compressWordBuffer(iLeadPadding, iTrailingPadding, iAlgorithm, iCompressionLevel, iBuffer, &iContext, oBuffer);
+  }
+
+  void eventRecord(EventIdentifier const& iEventID, std::vector<uint32_t> const& iUncompressed, Compression iAlgorithm, int iCompressionLevel,
+                   CompressionContext& iContext, std::vector<uint32_t>& oRecord) {
+    //the event header, record size and uncompressed size come before the compressed buffer
+    constexpr unsigned int kLeadingWords = kEventHeaderSizeInWords+2;
+    auto cSize = compressWordBuffer(kLeadingWords, 1, iAlgorithm, iCompressionLevel, iUncompressed, &iContext, oRecord);
+    uint32_t const recordSize = bytesToWords(cSize)+1;
+    oRecord[0] = kEventRecordType;
+    oRecord[1] = iEventID.run;
+    oRecord[2] = iEventID.lumi;
+    oRecord[3] = (iEventID.event >> 32) & 0xFFFFFFFF;
+    oRecord[4] = iEventID.event & 0xFFFFFFFF;
+    oRecord[kEventHeaderSizeInWords] = recordSize;
+    //the number of bytes used in the last word of the compressed buffer is in the lowest 2 bits
+    oRecord[kEventHeaderSizeInWords+1] = iUncompressed.size()*4 + (cSize % 4);
+    oRecord.back() = recordSize;
+    assert(oRecord.size() == kEventHeaderSizeInWords+recordSize+2);
+  }
+
+  std::vector<char> compressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, Compression iAlgorithm, int iCompressionLevel, BlobView iBuffer) {
+    return compressBufferImpl(iLeadPadding, iTrailingPadding, iAlgorithm, iCompressionLevel, iBuffer, nullptr);
+  }
+
+  std::vector<char> compressBuffer(unsigned int iLeadPadding, unsigned int iTrailingPadding, Compression iAlgorithm, int iCompressionLevel, BlobView iBuffer, CompressionContext& iContext) {
+    return compressBufferImpl(iLeadPadding, iTrailingPadding, iAlgorithm, iCompressionLevel, iBuffer, &iContext);
   }
 
 }
@@ -2,16 +2,149 @@
 #define pds_writer_h
 
 #include "pds_common.h"
+#include "BlobView.h"
+#include "EventIdentifier.h"
 
+#include <algorithm>
+#include <cassert>
 #include <utility>
 #include <vector>
+#include <string>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+struct ZSTD_CCtx_s;
+struct ZSTD_CDict_s;
 
 namespace cce::tf::pds {
 
+  //A ZSTD dictionary prepared for compression at a given level. It can be
+  // shared between threads.
+  class CompressionDictionary {
+  public:
+    CompressionDictionary(std::vector<char> const& iDictionary, int iCompressionLevel);
+
+    ZSTD_CDict_s const* zstd() const { return zstd_.get(); }
+  private:
+    struct ZSTDDeleter { void operator()(ZSTD_CDict_s*) const; };
+    std::unique_ptr<ZSTD_CDict_s, ZSTDDeleter> zstd_;
+  };
+
+  //Returns an empty container if training failed
+  std::vector<char> trainDictionary(std::vector<std::vector<uint32_t>> const& iSamples, std::size_t iMaxDictionarySize);
+
+  //Holds the compression state so it does not have to be created for each call.
+  // The state is made the first time it is needed. A context must only be
+  // used by one thread at a time, e.g. have one per Lane.
+  class CompressionContext {
+  public:
+    ZSTD_CCtx_s* zstd();
+    void* lz4State();
+    void* lz4HCState();
+
+    //when set, ZSTD compression uses the dictionary and ignores the requested compression level
+    void setDictionary(CompressionDictionary const* iDictionary) { dictionary_ = iDictionary; }
+    CompressionDictionary const* dictionary() const { return dictionary_; }
+
+  private:
+    struct ZSTDDeleter { void operator()(ZSTD_CCtx_s*) const; };
+    std::unique_ptr<ZSTD_CCtx_s, ZSTDDeleter> zstd_;
+    std::unique_ptr<char[]> lz4State_;
+    std::unique_ptr<char[]> lz4HCState_;
+    CompressionDictionary const* dictionary_ = nullptr;
+  };
+
+  //The words of a file header, from the file type identifier to the repeated header size. iProducts
+  // holds the name and class name of each data product, in the order of their indices in the events.
+  // The optional sections are added for a non empty iDictionary or iShuffle and a true iPerProductCompression, iChecksum, iSplit
+  // or iRepeatedProducts. iSplitStreams holds the number of streams of each data product, see kHeaderSplitTag.
+  std::vector<uint32_t> fileHeader(Serialization, Compression, std::vector<std::pair<std::string, std::string>> const& iProducts,
+                                   std::vector<char> const& iDictionary = {}, bool iPerProductCompression = false,
+                                   bool iChecksum = false, std::vector<uint8_t> const& iShuffle = {},
+                                   bool iSplit = false, std::vector<uint32_t> const& iSplitStreams = {},
+                                   bool iRepeatedProducts = false);
+
+  //Keeps one copy of the bytes of the data products which serialized the same
+  // as in the event handled before, see kRepeatedProductsRecord. Can be used
+  // from several threads.
+  class RepeatedProducts {
+  public:
+    explicit RepeatedProducts(std::size_t iNProducts): lastHashes_(iNProducts, 0), hasLast_(iNProducts, false) {}
+
+    //returns the entry to store in place of the bytes, std::nullopt if the bytes must be stored
+    std::optional<uint32_t> entry(uint32_t iProductIndex, uint64_t iHash, BlobView iBlob);
+    //the words of the repeated products record and the file trailer, for a record starting iRecordOffsetInWords into the file
+    std::vector<uint32_t> record(uint64_t iRecordOffsetInWords) const;
+
+    std::size_t nEntries() const { return entries_.size(); }
+    //number of data products stored as an entry and the bytes they did not need
+    unsigned long long nReferences() const { return nReferences_; }
+    unsigned long long referencedBytes() const { return referencedBytes_; }
+  private:
+    struct Entry {
+      uint32_t productIndex_;
+      uint64_t hash_;
+      std::vector<char> bytes_;
+    };
+    std::mutex mutex_;
+    std::vector<uint64_t> lastHashes_;
+    std::vector<bool> hasLast_;
+    std::vector<Entry> entries_;
+    std::unordered_multimap<uint64_t, uint32_t> entriesByHash_;
+    unsigned long long nReferences_ = 0;
+    unsigned long long referencedBytes_ = 0;
+  };
+
+  //the words of the event index record, the luminosity block index record if iLumis is not empty, and the file trailer,
+  // for an index starting iIndexOffsetInWords into the file
+  std::vector<uint32_t> eventIndexRecord(std::vector<EventIndexEntry> const& iIndex, uint64_t iIndexOffsetInWords,
+                                         std::vector<LumiIndexEntry> const& iLumis = {});
+  //orders ioIndex by run and luminosity block, keeping the order of the events within one, and returns the luminosity block index
+  std::vector<LumiIndexEntry> lumiIndex(std::vector<EventIndexEntry>& ioIndex);
+
   std::pair<std::vector<uint32_t>, int> compressBuffer(unsigned int iReserveFirstNWords, unsigned int iPadding, Compression iAlgorithm, int iCompressionLevel, std::vector<uint32_t> const& iBuffer);
+  std::pair<std::vector<uint32_t>, int> compressBuffer(unsigned int iReserveFirstNWords, unsigned int iPadding, Compression iAlgorithm, int iCompressionLevel, std::vector<uint32_t> const& iBuffer, CompressionContext&);
+  //compresses into oBuffer, reusing its memory, and returns the compressed size in bytes
+  int compressBuffer(unsigned int iReserveFirstNWords, unsigned int iPadding, Compression iAlgorithm, int iCompressionLevel, std::vector<uint32_t> const& iBuffer, CompressionContext&,
+                     std::vector<uint32_t>& oBuffer);
+
+  //Fills oBuffer with the uncompressed event buffer of the data products serialized by iSerializers: for each,
+  // in the order of their indices, its index, its size in words and its bytes padded to a whole word.
+  // oBuffer's memory is reused.
+  template<typename SERIALIZERS>
+  void uncompressedEventBuffer(SERIALIZERS const& iSerializers, std::vector<uint32_t>& oBuffer) {
+    auto bytesToWords = [](std::size_t nBytes) -> uint32_t { return nBytes/4 + ( (nBytes % 4) == 0 ? 0 : 1); };
+    uint32_t bufferSize = 0;
+    for(auto const& s: iSerializers) {
+      bufferSize += 2 + bytesToWords(s.blob().size());
+    }
+    oBuffer.resize(bufferSize);
+    uint32_t bufferIndex = 0;
+    uint32_t dataProductIndex = 0;
+    for(auto const& s: iSerializers) {
+      oBuffer[bufferIndex++] = dataProductIndex++;
+      uint32_t const sizeInWords = bytesToWords(s.blob().size());
+      oBuffer[bufferIndex++] = sizeInWords;
+      if(sizeInWords != 0) {
+        oBuffer[bufferIndex+sizeInWords-1] = 0;
+      }
+      std::copy(s.blob().begin(), s.blob().end(), reinterpret_cast<char*>(oBuffer.data()+bufferIndex));
+      bufferIndex += sizeInWords;
+    }
+    assert(bufferIndex == bufferSize);
+  }
+
+  //Compresses iUncompressed into oRecord, reusing its memory, as a whole event record: the event header, the record
+  // size, the uncompressed size, the compressed buffer and the repeated record size. The record has no checksum.
+  void eventRecord(EventIdentifier const&, std::vector<uint32_t> const& iUncompressed, Compression, int iCompressionLevel,
+                   CompressionContext&, std::vector<uint32_t>& oRecord);
 
-  std::vector<char> compressBuffer(unsigned int iReserveFirstNWords, unsigned int iPadding, Compression iAlgorithm, int iCompressionLevel, std::vector<char> const& iBuffer);
+  //a std::vector<char> converts to a BlobView
+  std::vector<char> compressBuffer(unsigned int iReserveFirstNWords, unsigned int iPadding, Compression iAlgorithm, int iCompressionLevel, BlobView iBuffer);
+  std::vector<char> compressBuffer(unsigned int iReserveFirstNWords, unsigned int iPadding, Compression iAlgorithm, int iCompressionLevel, BlobView iBuffer, CompressionContext&);
 
 }
 
@@ -0,0 +1,81 @@
+#include "pluginLoader.h"
+
+#include <dlfcn.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+  std::vector<std::string> pluginDirectories() {
+    std::vector<std::string> directories;
+    if(auto path = std::getenv("TF_PLUGIN_PATH")) {
+      std::istringstream stream(path);
+      std::string item;
+      while(std::getline(stream, item, ':')) {
+        if(not item.empty()) {
+          directories.push_back(item);
+        }
+      }
+      return directories;
+    }
+    std::string exe(4096, '\0');
+    auto size = readlink("/proc/self/exe", exe.data(), exe.size());
+    if(size > 0) {
+      exe.resize(size);
+      auto slash = exe.rfind('/');
+      if(slash != std::string::npos) {
+        directories.push_back(exe.substr(0, slash));
+      }
+    }
+    return directories;
+  }
+
+  std::vector<std::string> pluginFiles(std::string const& iDirectory) {
+    constexpr std::string_view kPrefix = "libtfplugin_";
+    constexpr std::string_view kSuffix = ".so";
+    std::vector<std::string> files;
+    auto dir = opendir(iDirectory.c_str());
+    if(nullptr == dir) {
+      return files;
+    }
+    while(auto entry = readdir(dir)) {
+      std::string_view name(entry->d_name);
+      if(name.size() > kPrefix.size()+kSuffix.size() and name.substr(0, kPrefix.size()) == kPrefix
+         and name.substr(name.size()-kSuffix.size()) == kSuffix) {
+        files.push_back(iDirectory+"/"+std::string(name));
+      }
+    }
+    closedir(dir);
+    //load in a reproducible order
+    std::sort(files.begin(), files.end());
+    return files;
+  }
+}
+
+namespace cce::tf {
+  bool loadPlugins() {
+    static std::once_flag s_once;
+    bool loaded = false;
+    std::call_once(s_once, [&loaded]() {
+        for(auto const& directory: pluginDirectories()) {
+          for(auto const& file: pluginFiles(directory)) {
+            //the libraries are never unloaded since their Makers stay registered
+            if(nullptr == dlopen(file.c_str(), RTLD_NOW | RTLD_GLOBAL)) {
+              std::cout <<"failed to load plugin "<<file<<": "<<dlerror()<<std::endl;
+              continue;
+            }
+            loaded = true;
+          }
+        }
+      });
+    return loaded;
+  }
+}
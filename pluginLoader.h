@@ -0,0 +1,13 @@
+#if !defined(pluginLoader_h)
+#define pluginLoader_h
+
+namespace cce::tf {
+  //Loads the shared libraries named libtfplugin_*.so from the directories
+  // in the TF_PLUGIN_PATH environment variable, separated by ':', or if it
+  // is not set from the directory of the executable. Their static Makers
+  // then register with the factories. The libraries are only looked for
+  // the first time this is called, later calls return false.
+  //returns true if any library was loaded
+  bool loadPlugins();
+}
+#endif
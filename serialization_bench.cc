@@ -0,0 +1,164 @@
+#include "UnrolledSerializer.h"
+#include "UnrolledDeserializer.h"
+#include "Serializer.h"
+#include "Deserializer.h"
+#include "pds_writer.h"
+#include "pds_reading.h"
+#include "byte_shuffle.h"
+#include "BatchDecompressor.h"
+
+#include "TClass.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cms/EventAuxiliary.h"
+#include "test_classes/TestClasses.h"
+
+/*
+  Times the serializers, deserializers and compression algorithms on their
+  own so changes to them can be measured without running a full job. Each
+  result is the time per call and the number of serialized, i.e.
+  uncompressed, bytes handled per second.
+  Usage: serialization_bench [number of iterations]
+*/
+namespace {
+  using namespace cce::tf;
+
+  template<typename F>
+  double timePerCall(unsigned int iNIterations, F&& iFunc) {
+    //the first call may have to allocate buffers
+    iFunc();
+    auto start = std::chrono::high_resolution_clock::now();
+    for(unsigned int i=0; i<iNIterations; ++i) {
+      iFunc();
+    }
+    auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start);
+    return double(time.count())/iNIterations;
+  }
+
+  void printResult(const char* iWhat, double iTimePerCall, std::size_t iBytes) {
+    std::cout <<"  "<<std::left<<std::setw(24)<<iWhat<<std::right<<std::setw(12)<<iTimePerCall<<"ns "
+              <<std::setw(12)<<iBytes*1.e3/iTimePerCall<<" MB/s\n";
+  }
+
+  //the serialized data of all the classes is used to time the compression
+  std::vector<char> s_allSerialized;
+
+  template<typename T>
+  void benchmark(const char* iName, T const& iObject, unsigned int iNIterations) {
+    auto cls = TClass::GetClass(typeid(T));
+    if(nullptr == cls) {
+      std::cout <<"FAILED TO GET CLASS "<<iName<<std::endl;
+      abort();
+    }
+    T newObj;
+
+    std::cout <<iName<<"\n";
+    Serializer s;
+    auto buffer = s.serialize(&iObject, cls);
+    s_allSerialized.insert(s_allSerialized.end(), buffer.begin(), buffer.end());
+    printResult("Serializer", timePerCall(iNIterations, [&]() { s.serializeToView(&iObject, cls); }), buffer.size());
+
+    Deserializer d(cls);
+    printResult("Deserializer", timePerCall(iNIterations, [&]() { d.deserialize(buffer, &newObj); }), buffer.size());
+
+    UnrolledSerializer us(cls);
+    auto unrolledBuffer = us.serialize(&iObject);
+    printResult("UnrolledSerializer", timePerCall(iNIterations, [&]() { us.serializeToView(&iObject); }), unrolledBuffer.size());
+
+    UnrolledDeserializer ud(cls);
+    printResult("UnrolledDeserializer", timePerCall(iNIterations, [&]() { ud.deserialize(unrolledBuffer, &newObj); }), unrolledBuffer.size());
+    std::cout <<std::flush;
+  }
+
+  //compresses an event buffer the way PDSOutputer does
+  void benchmarkCompression(const char* iName, pds::Compression iAlgorithm, int iLevel, std::vector<uint32_t> const& iEvent, unsigned int iNIterations) {
+    pds::CompressionContext compressContext;
+    auto [compressed, compressedSize] = pds::compressBuffer(2, 1, iAlgorithm, iLevel, iEvent, compressContext);
+    //what is stored is the size word, the compressed data and the padding of the last word
+    compressed[1] = iEvent.size()*4 + (compressedSize % 4);
+
+    std::cout <<iName<<" level "<<iLevel<<" compression ratio "<<double(iEvent.size()*4)/compressedSize<<"\n";
+    printResult("compressBuffer", timePerCall(iNIterations, [&]() {
+          pds::compressBuffer(2, 1, iAlgorithm, iLevel, iEvent, compressContext);
+        }), iEvent.size()*4);
+
+    pds::DecompressionContext decompressContext;
+    pds::ReusableBuffer<uint32_t> uncompressed;
+    //skip the record size and the crosscheck word
+    auto begin = compressed.data()+1;
+    auto end = compressed.data()+compressed.size()-1;
+    printResult("uncompressEventBuffer", timePerCall(iNIterations, [&]() {
+          pds::uncompressEventBuffer(iAlgorithm, begin, end, uncompressed, decompressContext);
+        }), iEvent.size()*4);
+    std::cout <<std::flush;
+  }
+
+  //decompresses many event buffers at once the way SharedRootBatchEventsSource does with chunked batches
+  void benchmarkBatchDecompression(const char* iName, pds::Compression iAlgorithm, int iLevel, std::vector<uint32_t> const& iEvent,
+                                   std::size_t iNBuffers, unsigned int iNIterations) {
+    auto [compressed, compressedSize] = pds::compressBuffer(0, 0, iAlgorithm, iLevel, iEvent);
+    std::vector<char> uncompressed(iNBuffers*iEvent.size()*4);
+    std::vector<BatchDecompressor::Request> requests;
+    requests.reserve(iNBuffers);
+    for(std::size_t i = 0; i < iNBuffers; ++i) {
+      requests.push_back({reinterpret_cast<char const*>(compressed.data()), static_cast<std::size_t>(compressedSize),
+                          uncompressed.data()+i*iEvent.size()*4, iEvent.size()*4});
+    }
+    std::cout <<iName<<" batch of "<<iNBuffers<<" buffers\n";
+    BatchDecompressor cpu(iAlgorithm, false);
+    printResult("BatchDecompressor CPU", timePerCall(iNIterations, [&]() { cpu.decompress(requests); }), uncompressed.size());
+    BatchDecompressor gpu(iAlgorithm, true);
+    if(gpu.usesGPU()) {
+      printResult("BatchDecompressor GPU", timePerCall(iNIterations, [&]() { gpu.decompress(requests); }), uncompressed.size());
+    }
+    std::cout <<std::flush;
+  }
+}
+
+int main(int argc, char** argv) {
+  unsigned int nIterations = 100000;
+  if(argc > 1) {
+    nIterations = std::stoul(argv[1]);
+  }
+
+  benchmark("SimpleClass", cce::tf::test::SimpleClass(5), nIterations);
+  benchmark("TestClass", cce::tf::test::TestClass("foo", 78.9), nIterations);
+  benchmark("TestClassWithFloatVector", cce::tf::test::TestClassWithFloatVector({1,2,3,5}), nIterations);
+  benchmark("std::vector<int>", std::vector<int>(1000, 3), nIterations);
+  benchmark("edm::EventAuxiliary", edm::EventAuxiliary({1,1,1}, "32981", edm::Timestamp{0}, true, edm::EventAuxiliary::PhysicsTrigger,12), nIterations);
+
+  //make an event sized buffer by repeating the serialized data
+  constexpr std::size_t kEventBytes = 64*1024;
+  std::vector<uint32_t> event(kEventBytes/4);
+  auto eventBytes = reinterpret_cast<char*>(event.data());
+  for(std::size_t i = 0; i < kEventBytes; ++i) {
+    eventBytes[i] = s_allSerialized[i % s_allSerialized.size()];
+  }
+  //compression is much slower than serialization
+  unsigned int const nCompressions = std::max(nIterations/100, 1U);
+  benchmarkCompression("LZ4", pds::Compression::kLZ4, 9, event, nCompressions);
+  benchmarkCompression("ZSTD", pds::Compression::kZSTD, 18, event, nCompressions);
+  benchmarkCompression("ZSTD", pds::Compression::kZSTD, 3, event, nCompressions);
+  benchmarkCompression("LZ4HC", pds::Compression::kLZ4HC, 9, event, nCompressions);
+  benchmarkCompression("LongZSTD", pds::Compression::kZSTDLong, 18, event, nCompressions);
+
+  std::cout <<"byte shuffle\n";
+  std::vector<uint32_t> shuffled(event.size());
+  auto shuffledBytes = reinterpret_cast<char*>(shuffled.data());
+  std::vector<char> unshuffled(kEventBytes);
+  printResult("byteShuffle", timePerCall(nIterations, [&]() {
+        byteShuffle(eventBytes, shuffledBytes, kEventBytes, 4); }), kEventBytes);
+  printResult("byteUnshuffle", timePerCall(nIterations, [&]() {
+        byteUnshuffle(shuffledBytes, unshuffled.data(), kEventBytes, 4); }), kEventBytes);
+  benchmarkCompression("ZSTD shuffled", pds::Compression::kZSTD, 3, shuffled, nCompressions);
+
+  unsigned int const nBatches = std::max(nIterations/10000, 1U);
+  benchmarkBatchDecompression("LZ4", pds::Compression::kLZ4, 9, event, 256, nBatches);
+  benchmarkBatchDecompression("ZSTD", pds::Compression::kZSTD, 3, event, 256, nBatches);
+  return 0;
+}
@@ -1,6 +1,7 @@
 #include "sourceFactoryGenerator.h"
 #include "SourceFactory.h"
 #include "configKeyValuePairs.h"
+#include "FileChainSource.h"
 #include <iostream>
 
 std::function<std::unique_ptr<cce::tf::SharedSourceBase>(unsigned int, unsigned long long)> 
@@ -8,8 +9,17 @@ cce::tf::sourceFactoryGenerator(std::string_view iType, std::string_view iOption
   std::function<std::unique_ptr<SharedSourceBase>(unsigned int, unsigned long long)> sourceFactory;
 
   auto keyValues = cce::tf::configKeyValuePairs(iOptions);
-  sourceFactory = [type = std::string(iType), params=ConfigurationParameters(keyValues)]
+  std::string type(iType);
+  //a list of files is read by a FileChainSource using a Source of the given type for each file
+  if(auto itFile = keyValues.find("fileName"); itFile != keyValues.end() and isFileList(itFile->second) and
+     type != "FileChainSource") {
+    keyValues["source"] = type;
+    type = "FileChainSource";
+  }
+  sourceFactory = [type, keyValues]
     (unsigned int iNLanes, unsigned long long iNEvents) {
+    //each call starts with all parameters unused, e.g. when --scan-threads remakes the component
+    ConfigurationParameters params(keyValues);
     auto maker = SourceFactory::get()->create(type, iNLanes, iNEvents, params);
     
     if(not maker) {
@@ -0,0 +1,23 @@
+#if !defined(summarize_batches_h)
+#define summarize_batches_h
+
+#include <iostream>
+#include "SizeTargetBatcher.h"
+
+namespace cce::tf {
+template<typename T>
+inline void summarize_batches(SizeTargetBatcher<T> const& iBatcher) {
+  auto const& stats = iBatcher.stats();
+  if(stats.nBatches_ == 0) {
+    return;
+  }
+  std::cout <<"  batches: "<<stats.nBatches_
+            <<" closed by batchSize "<<stats.nClosedByEntryLimit_<<"\n"
+            <<"  events per batch: min "<<stats.minEntries_
+            <<" average "<<stats.nEntries_/double(stats.nBatches_)
+            <<" max "<<stats.maxEntries_<<"\n"
+            <<"  bytes per batch: average "<<stats.bytes_/double(stats.nBatches_)
+            <<" max "<<stats.maxBytes_<<"\n";
+}
+}
+#endif
@@ -0,0 +1,49 @@
+#if !defined(summarize_queue_h)
+#define summarize_queue_h
+
+#include <iostream>
+#include <string_view>
+#include "SerialTaskQueue.h"
+#include "RunReport.h"
+
+namespace cce::tf {
+inline void summarize_queue(std::string_view iName, SerialTaskQueue const& iQueue) {
+  auto const& stats = iQueue.statistics();
+  std::cout <<"  "<<iName<<" queue: tasks "<<stats.nTasks
+            <<" TBB spawns "<<stats.nSpawns
+            <<" group hops "<<stats.nGroupHops
+            <<" max depth "<<stats.maxDepth<<"\n";
+  if(not SerialTaskQueue::timingEnabled()) {
+    return;
+  }
+  std::cout <<"  "<<iName<<" queue tasks which waited "<<stats.nWaited
+            <<" wait time: total "<<stats.waitTime.count()<<"us";
+  if(stats.nTasks != 0) {
+    std::cout <<" average "<<stats.waitTime.count()/double(stats.nTasks)<<"us";
+  }
+  std::cout <<" max "<<stats.maxWaitTime.count()<<"us\n"
+            <<"  "<<iName<<" queue run time: total "<<stats.runTime.count()<<"us";
+  if(stats.nTasks != 0) {
+    std::cout <<" average "<<stats.runTime.count()/double(stats.nTasks)<<"us";
+  }
+  std::cout <<" max "<<stats.maxRunTime.count()<<"us\n";
+}
+
+inline void report_queue(RunReport& oReport, std::string_view iName, SerialTaskQueue const& iQueue) {
+  auto const& stats = iQueue.statistics();
+  auto& queue = oReport.section(std::string(iName)+"Queue");
+  queue.set("tasks", stats.nTasks);
+  queue.set("spawns", stats.nSpawns);
+  queue.set("maxDepth", stats.maxDepth);
+  queue.set("groupHops", stats.nGroupHops);
+  if(not SerialTaskQueue::timingEnabled()) {
+    return;
+  }
+  queue.set("waited", stats.nWaited);
+  queue.set("waitTime_us", stats.waitTime.count());
+  queue.set("maxWaitTime_us", stats.maxWaitTime.count());
+  queue.set("runTime_us", stats.runTime.count());
+  queue.set("maxRunTime_us", stats.maxRunTime.count());
+}
+}
+#endif
@@ -5,7 +5,10 @@
 #include <iostream>
 #include <chrono>
 #include <iomanip>
+#include <algorithm>
 #include "SerializerWrapper.h"
+#include "RunReport.h"
+#include "ProductProfile.h"
 
 namespace cce::tf {
 template <typename C>
@@ -15,32 +18,98 @@ inline void summarize_serializers(std::vector<C> const& iSerializersPerLane) {
   
   std::vector<std::pair<std::string_view, std::chrono::microseconds>> serializerTimes;
   serializerTimes.reserve( iSerializersPerLane[0].size());
+  //buffer expansions summed over Lanes and largest serialized size
+  std::vector<std::pair<unsigned int, std::size_t>> expansions;
+  expansions.reserve( iSerializersPerLane[0].size());
+  std::size_t bufferBytes = 0;
   bool isFirst = true;
   for(auto const& serializers: iSerializersPerLane) {
+    for(auto const& s: serializers) {
+      bufferBytes += s.bufferCapacity();
+    }
     if(isFirst) {
       isFirst = false;
       for(auto& s: serializers) {
 	serializerTimes.emplace_back(s.name(), s.accumulatedTime());
 	serializerTime += s.accumulatedTime();
+	expansions.emplace_back(s.nExpansions(), s.sizeStats().max());
       }
     } else {
       int i =0;
       for(auto& s: serializers) {
+	expansions[i].first += s.nExpansions();
+	expansions[i].second = std::max(expansions[i].second, s.sizeStats().max());
 	serializerTimes[i++].second += s.accumulatedTime();
 	serializerTime += s.accumulatedTime();
       }
     }
   }
 
+  std::cout <<"Serialization buffer expansions\n";
+  {
+    int i = 0;
+    for(auto const& p: expansions) {
+      std::cout <<"expansions: "<<p.first<<"\tmax size: "<<p.second<<"\tname: "<<serializerTimes[i++].first<<"\n";
+    }
+  }
+
   std::sort(serializerTimes.begin(),serializerTimes.end(), [](auto const& iLHS, auto const& iRHS) {
       return iLHS.second > iRHS.second;
     });
 
+  std::cout <<"Serialization buffers: "<<bufferBytes<<" bytes\n";
   std::cout <<"Serialization total time: "<<serializerTime.count()<<"us\n";
   std::cout <<"Serialization times\n";
   for(auto const& p: serializerTimes) {
     std::cout <<"time: "<<p.second.count()<<"us "<<std::setprecision(4)<<(100.*p.second.count()/serializerTime.count())<<"%\tname: "<<p.first<<"\n";
   }
 }
+
+//returns the total number of bytes serialized
+template <typename C>
+inline std::uint64_t report_serializers(RunReport& oReport, std::vector<C> const& iSerializersPerLane) {
+  auto& section = oReport.section("serializers");
+  std::uint64_t totalBytes = 0;
+  std::size_t totalBufferBytes = 0;
+  std::chrono::microseconds totalTime = std::chrono::microseconds::zero();
+  for(std::size_t i = 0; i < iSerializersPerLane[0].size(); ++i) {
+    std::chrono::microseconds time = std::chrono::microseconds::zero();
+    std::uint64_t bytes = 0;
+    std::size_t maxSize = 0;
+    unsigned int nExpansions = 0;
+    std::size_t bufferBytes = 0;
+    for(auto const& serializers: iSerializersPerLane) {
+      auto const& s = serializers[i];
+      bufferBytes += s.bufferCapacity();
+      time += s.accumulatedTime();
+      bytes += s.sizeStats().total();
+      maxSize = std::max(maxSize, s.sizeStats().max());
+      nExpansions += s.nExpansions();
+    }
+    auto& product = section.section(iSerializersPerLane[0][i].name());
+    product.set("time_us", time.count());
+    product.set("bytes", bytes);
+    product.set("maxSize", maxSize);
+    product.set("expansions", nExpansions);
+    product.set("bufferBytes", bufferBytes);
+    totalBytes += bytes;
+    totalBufferBytes += bufferBytes;
+    totalTime += time;
+  }
+  oReport.set("serializeTime_us", totalTime.count());
+  oReport.set("serializedBytes", totalBytes);
+  oReport.set("serializerBufferBytes", totalBufferBytes);
+  return totalBytes;
+}
+
+template <typename C>
+inline void profile_serializers(ProductProfile& oProfile, std::vector<C> const& iSerializersPerLane) {
+  for(auto const& serializers: iSerializersPerLane) {
+    for(auto const& s: serializers) {
+      auto const& stats = s.sizeStats();
+      oProfile.add(s.name(), {stats.nEntries(), stats.total(), stats.p99(), stats.max(), static_cast<double>(s.accumulatedTime().count())});
+    }
+  }
+}
 }
 #endif
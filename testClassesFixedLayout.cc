@@ -0,0 +1,60 @@
+#include "FixedLayout.h"
+#include "test_classes/TestClasses.h"
+
+//Fixed layouts for the test classes whose data members are fixed fields or
+// contiguous arrays of fundamental types.
+namespace cce::tf {
+  template<>
+  struct FixedLayout<test::SimpleClass> {
+    static void write(TBufferFile& oBuffer, test::SimpleClass const& iValue) {
+      oBuffer << iValue.value();
+    }
+    static void read(TBufferFile& iBuffer, test::SimpleClass& oValue) {
+      Int_t value;
+      iBuffer >> value;
+      oValue = test::SimpleClass(value);
+    }
+  };
+
+  template<>
+  struct FixedLayout<test::TestClassWithFloatVector> {
+    static void write(TBufferFile& oBuffer, test::TestClassWithFloatVector const& iValue) {
+      FixedLayout<std::vector<float>>::write(oBuffer, iValue.values());
+    }
+    static void read(TBufferFile& iBuffer, test::TestClassWithFloatVector& oValue) {
+      std::vector<float> values;
+      FixedLayout<std::vector<float>>::read(iBuffer, values);
+      oValue = test::TestClassWithFloatVector(std::move(values));
+    }
+  };
+
+  template<>
+  struct FixedLayout<test::TestClassWithFloatCArray> {
+    static void write(TBufferFile& oBuffer, test::TestClassWithFloatCArray const& iValue) {
+      oBuffer.WriteFastArray(iValue.m_values, std::size(iValue.m_values));
+    }
+    static void read(TBufferFile& iBuffer, test::TestClassWithFloatCArray& oValue) {
+      iBuffer.ReadFastArray(oValue.m_values, std::size(oValue.m_values));
+    }
+  };
+
+  template<>
+  struct FixedLayout<test::TestClassWithFloatArray> {
+    static void write(TBufferFile& oBuffer, test::TestClassWithFloatArray const& iValue) {
+      oBuffer.WriteFastArray(iValue.values().data(), iValue.values().size());
+    }
+    static void read(TBufferFile& iBuffer, test::TestClassWithFloatArray& oValue) {
+      std::array<float,3> values;
+      iBuffer.ReadFastArray(values.data(), values.size());
+      oValue = test::TestClassWithFloatArray(values);
+    }
+  };
+}
+
+namespace {
+  using namespace cce::tf;
+  FixedLayoutRegistration<test::SimpleClass> s_simpleClass;
+  FixedLayoutRegistration<test::TestClassWithFloatVector> s_floatVector;
+  FixedLayoutRegistration<test::TestClassWithFloatCArray> s_floatCArray;
+  FixedLayoutRegistration<test::TestClassWithFloatArray> s_floatArray;
+}
@@ -0,0 +1,60 @@
+#include "catch2/catch.hpp"
+#include <vector>
+#include "ActiveLaneLimit.h"
+
+TEST_CASE("Test ActiveLaneLimit", "[ActiveLaneLimit]") {
+  using namespace cce::tf;
+  ActiveLaneLimit limit(2);
+  std::vector<int> resumed;
+  auto resume = [&resumed](int iLane) { return [&resumed, iLane]() { resumed.push_back(iLane); }; };
+
+  SECTION("within limit") {
+    limit.acquire(resume(0));
+    limit.acquire(resume(1));
+    REQUIRE(resumed == std::vector<int>({0,1}));
+    limit.release();
+    limit.release();
+    limit.acquire(resume(2));
+    REQUIRE(resumed == std::vector<int>({0,1,2}));
+    REQUIRE(limit.nParked() == 0);
+  }
+  SECTION("parked in order") {
+    for(int i=0; i<4; ++i) {
+      limit.acquire(resume(i));
+    }
+    REQUIRE(resumed == std::vector<int>({0,1}));
+    REQUIRE(limit.nParked() == 2);
+    REQUIRE(limit.maxParked() == 2);
+    limit.release();
+    REQUIRE(resumed == std::vector<int>({0,1,2}));
+    limit.release();
+    REQUIRE(resumed == std::vector<int>({0,1,2,3}));
+    limit.release();
+    limit.release();
+    limit.acquire(resume(4));
+    limit.acquire(resume(5));
+    REQUIRE(resumed == std::vector<int>({0,1,2,3,4,5}));
+  }
+  SECTION("change number of tokens") {
+    for(int i=0; i<4; ++i) {
+      limit.acquire(resume(i));
+    }
+    REQUIRE(resumed == std::vector<int>({0,1}));
+    limit.setNTokens(3);
+    REQUIRE(resumed == std::vector<int>({0,1,2}));
+    REQUIRE(limit.nTokens() == 3);
+    limit.setNTokens(1);
+    //the next two releases give up their tokens
+    limit.release();
+    limit.release();
+    REQUIRE(resumed == std::vector<int>({0,1,2}));
+    limit.release();
+    REQUIRE(resumed == std::vector<int>({0,1,2,3}));
+    limit.release();
+    limit.acquire(resume(4));
+    limit.acquire(resume(5));
+    REQUIRE(resumed == std::vector<int>({0,1,2,3,4}));
+    limit.setNTokens(2);
+    REQUIRE(resumed == std::vector<int>({0,1,2,3,4,5}));
+  }
+}
@@ -0,0 +1,87 @@
+#include "catch2/catch.hpp"
+#include <sstream>
+#include "BenchmarkBaseline.h"
+#include "RunReport.h"
+
+TEST_CASE("Test BenchmarkBaseline", "[BenchmarkBaseline]") {
+  using namespace cce::tf;
+
+  SECTION("scenarios") {
+    std::istringstream text("# a comment\n\npds 4 SharedPDSSource=test.pds DummyOutputer\nroot 2 RootSource=test.root PDSOutputer=out.pds:compressionAlgorithm=LZ4 8\n");
+    auto scenarios = readScenarios(text);
+    REQUIRE(scenarios);
+    REQUIRE(scenarios->size() == 2);
+    REQUIRE((*scenarios)[0].name_ == "pds");
+    REQUIRE((*scenarios)[0].threads_ == 4);
+    REQUIRE((*scenarios)[0].lanes_ == 4);
+    REQUIRE((*scenarios)[0].source_ == "SharedPDSSource=test.pds");
+    REQUIRE((*scenarios)[1].outputer_ == "PDSOutputer=out.pds:compressionAlgorithm=LZ4");
+    REQUIRE((*scenarios)[1].lanes_ == 8);
+
+    std::istringstream missing("pds 4 SharedPDSSource=test.pds\n");
+    REQUIRE(not readScenarios(missing));
+    std::istringstream twice("a 1 EmptySource DummyOutputer\na 2 EmptySource DummyOutputer\n");
+    REQUIRE(not readScenarios(twice));
+  }
+  SECTION("write and read") {
+    BenchmarkBaseline baseline;
+    auto& samples = baseline["pds \"4\""];
+    samples.scenario_ = {"pds \"4\"", "SharedPDSSource=test.pds", "DummyOutputer", 4, 6};
+    samples.metrics_["eventRate"] = {100.5, 101, 99.25};
+    samples.metrics_["outputer.serialTime_us"] = {1e-3, 2e-3};
+    RunReport report;
+    fillBaseline(report, baseline);
+    std::ostringstream out;
+    report.write(out);
+    std::istringstream in(out.str());
+    auto read = readBaseline(in);
+    REQUIRE(read);
+    REQUIRE(read->size() == 1);
+    auto const& r = read->begin()->second;
+    REQUIRE(r.scenario_.name_ == "pds \"4\"");
+    REQUIRE(r.scenario_.source_ == "SharedPDSSource=test.pds");
+    REQUIRE(r.scenario_.threads_ == 4);
+    REQUIRE(r.scenario_.lanes_ == 6);
+    REQUIRE(r.metrics_ == samples.metrics_);
+
+    std::istringstream bad("{\"scenarios\": [1,");
+    REQUIRE(not readBaseline(bad));
+  }
+  SECTION("compare") {
+    //within the noise
+    auto same = compareMetric({100, 102, 98}, {99, 101, 97}, true, 0.05);
+    REQUIRE(not same.regression_);
+    REQUIRE(same.hasInterval_);
+    REQUIRE(same.changeLow_ < 0);
+    REQUIRE(same.changeHigh_ > 0);
+    //clearly slower
+    auto slower = compareMetric({100, 101, 99}, {80, 81, 79}, true, 0.05);
+    REQUIRE(slower.regression_);
+    REQUIRE(slower.change_ == Approx(-0.2));
+    REQUIRE(slower.changeHigh_ < 0);
+    //faster is not a regression
+    REQUIRE(not compareMetric({100, 101, 99}, {120, 121, 119}, true, 0.05).regression_);
+    //a drop larger than the threshold but too noisy to be significant
+    REQUIRE(not compareMetric({100, 140, 60}, {90, 130, 50}, true, 0.05).regression_);
+    //times: higher is worse
+    REQUIRE(compareMetric({10, 10.1, 9.9}, {12, 12.1, 11.9}, false, 0.05).regression_);
+    //without repetitions only the threshold is used
+    auto single = compareMetric({100}, {90}, true, 0.05);
+    REQUIRE(not single.hasInterval_);
+    REQUIRE(single.regression_);
+
+    BenchmarkBaseline base;
+    base["a"].metrics_["eventRate"] = {100, 101, 99};
+    base["a"].metrics_["source.readTime_us"] = {5, 5, 5};
+    base["b"].metrics_["eventRate"] = {100};
+    BenchmarkBaseline current;
+    current["a"].metrics_["eventRate"] = {80, 81, 79};
+    current["a"].metrics_["source.readTime_us"] = {5, 5, 5};
+    current["c"].metrics_["eventRate"] = {100};
+    auto comparisons = compareBaselines(base, current, 0.05);
+    REQUIRE(comparisons.size() == 2);
+    REQUIRE(comparisons[0].metric_ == "eventRate");
+    REQUIRE(comparisons[0].regression_);
+    REQUIRE(not comparisons[1].regression_);
+  }
+}
@@ -0,0 +1,84 @@
+#include "catch2/catch.hpp"
+#include <numeric>
+#include <vector>
+#include "BlockCache.h"
+
+TEST_CASE("Test BlockCache", "[BlockCache]") {
+  using namespace cce::tf;
+
+  //a 10000 byte file
+  std::vector<char> file(10000);
+  std::iota(file.begin(), file.end(), 0);
+  unsigned int nFetches = 0;
+  BlockCache::Fetch fetch = [&](uint64_t iOffset, std::size_t iSize, char* oBuffer) -> std::size_t {
+    ++nFetches;
+    if(iOffset >= file.size()) {
+      return 0;
+    }
+    auto n = std::min<std::size_t>(iSize, file.size()-iOffset);
+    std::copy(file.begin()+iOffset, file.begin()+iOffset+n, oBuffer);
+    return n;
+  };
+  auto same = [&](uint64_t iOffset, std::vector<char> const& iRead) {
+    return std::equal(iRead.begin(), iRead.end(), file.begin()+iOffset);
+  };
+
+  SECTION("parse") {
+    auto config = parseBlockCacheConfig("dir=/tmp:size_MB=10:block_kB=64:shards=4");
+    REQUIRE(config);
+    REQUIRE(config->directory_ == "/tmp");
+    REQUIRE(config->size_ == 10000000);
+    REQUIRE(config->blockSize_ == 65536);
+    REQUIRE(config->nShards_ == 4);
+    REQUIRE(not parseBlockCacheConfig("size_MB=10"));
+    REQUIRE(not parseBlockCacheConfig("dir=/tmp:size=10"));
+    REQUIRE(not parseBlockCacheConfig("dir=/tmp:shards=0"));
+  }
+  SECTION("hits and misses") {
+    BlockCache cache({".", 100000, 1024, 2});
+    std::vector<char> read(3000);
+    REQUIRE(cache.read("a", 500, read.size(), read.data(), fetch) == read.size());
+    REQUIRE(same(500, read));
+    //blocks 0 to 3 in one request
+    REQUIRE(nFetches == 1);
+    REQUIRE(cache.nMisses() == 4);
+    REQUIRE(cache.nHits() == 0);
+
+    REQUIRE(cache.read("a", 600, read.size(), read.data(), fetch) == read.size());
+    REQUIRE(same(600, read));
+    REQUIRE(nFetches == 1);
+    REQUIRE(cache.nHits() == 4);
+    REQUIRE(cache.bytesFromCache() == read.size());
+
+    //a different file is not a hit
+    REQUIRE(cache.read("b", 600, read.size(), read.data(), fetch) == read.size());
+    REQUIRE(nFetches == 2);
+  }
+  SECTION("end of file") {
+    BlockCache cache({".", 100000, 1024, 1});
+    std::vector<char> read(2000);
+    REQUIRE(cache.read("a", 9000, read.size(), read.data(), fetch) == 1000);
+    REQUIRE(std::equal(file.begin()+9000, file.end(), read.begin()));
+    REQUIRE(cache.read("a", 9500, read.size(), read.data(), fetch) == 500);
+    REQUIRE(std::equal(file.begin()+9500, file.end(), read.begin()));
+    REQUIRE(nFetches == 1);
+  }
+  SECTION("eviction") {
+    //room for 2 blocks
+    BlockCache cache({".", 2048, 1024, 1});
+    std::vector<char> read(10);
+    cache.read("a", 0, read.size(), read.data(), fetch);
+    cache.read("a", 1024, read.size(), read.data(), fetch);
+    //block 0 is now the most recently used
+    cache.read("a", 0, read.size(), read.data(), fetch);
+    cache.read("a", 2048, read.size(), read.data(), fetch);
+    REQUIRE(cache.nEvictions() == 1);
+    REQUIRE(nFetches == 3);
+    cache.read("a", 5, read.size(), read.data(), fetch);
+    REQUIRE(same(5, read));
+    REQUIRE(nFetches == 3);
+    cache.read("a", 1030, read.size(), read.data(), fetch);
+    REQUIRE(same(1030, read));
+    REQUIRE(nFetches == 4);
+  }
+}
@@ -0,0 +1,44 @@
+#include "catch2/catch.hpp"
+#include "CPUAffinity.h"
+
+TEST_CASE("Test CPUAffinity", "[CPUAffinity]") {
+  using namespace cce::tf;
+
+  SECTION("parse CPU list") {
+    REQUIRE(parseCPUList("3") == std::vector<int>{3});
+    REQUIRE(parseCPUList("0-3,8,10-11") == std::vector<int>{0,1,2,3,8,10,11});
+    REQUIRE(not parseCPUList(""));
+    REQUIRE(not parseCPUList("3-1"));
+    REQUIRE(not parseCPUList("a"));
+    REQUIRE(not parseCPUList("1,,2"));
+    REQUIRE(not parseCPUList("-1"));
+  }
+  SECTION("parse affinity") {
+    REQUIRE(parseAffinityConfig("compact")->policy_ == AffinityPolicy::kCompact);
+    REQUIRE(parseAffinityConfig("scatter")->policy_ == AffinityPolicy::kScatter);
+    auto list = parseAffinityConfig("4,2");
+    REQUIRE(list->policy_ == AffinityPolicy::kList);
+    REQUIRE(list->cpus_ == std::vector<int>{4,2});
+    REQUIRE(not parseAffinityConfig("spread"));
+  }
+  SECTION("order") {
+    //2 packages of 2 cores with 2 SMT siblings, siblings numbered as linux does
+    std::vector<CPUTopology> cpus = {
+      {0,0,0}, {1,0,1}, {2,1,0}, {3,1,1},
+      {4,0,0}, {5,0,1}, {6,1,0}, {7,1,1}};
+    REQUIRE(orderCPUs(cpus, {AffinityPolicy::kCompact, {}}) == std::vector<int>{0,4,1,5,2,6,3,7});
+    REQUIRE(orderCPUs(cpus, {AffinityPolicy::kScatter, {}}) == std::vector<int>{0,2,1,3,4,6,5,7});
+    //CPUs the process can not use are dropped
+    REQUIRE(orderCPUs(cpus, {AffinityPolicy::kList, {7,9,1}}) == std::vector<int>{7,1});
+  }
+  SECTION("pin") {
+    auto allowed = allowedCPUs();
+    REQUIRE(not allowed.empty());
+    std::vector<int> all;
+    for(auto const& c: allowed) {
+      all.push_back(c.cpu_);
+    }
+    REQUIRE(pinThisThread(all));
+    REQUIRE(not pinThisThread({}));
+  }
+}
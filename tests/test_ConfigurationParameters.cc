@@ -1,5 +1,6 @@
 #include "catch2/catch.hpp"
 #include "ConfigurationParameters.h"
+#include <memory>
 
 TEST_CASE("Test ConfigurationParameters class", "[ConfigurationParameters]") {
   using namespace cce::tf;
@@ -89,4 +90,33 @@ TEST_CASE("Test ConfigurationParameters class", "[ConfigurationParameters]") {
     }
   }
 
+  SECTION("takeUnusedKeyValues") {
+    ConfigurationParameters::KeyValueMap map = {{"foo", "bar"}, {"a", "1"}, {"b", "2"}};
+    ConfigurationParameters params(map);
+    REQUIRE(params.get<std::string>("foo") == "bar");
+    auto unused = params.takeUnusedKeyValues();
+    REQUIRE(unused.size() == 2);
+    REQUIRE(unused["a"] == "1");
+    REQUIRE(unused["b"] == "2");
+    REQUIRE(params.unusedKeys().empty());
+    REQUIRE(params.takeUnusedKeyValues().empty());
+  }
+
+  SECTION("copy") {
+    ConfigurationParameters::KeyValueMap map = {{"foo", "bar"}, {"a", "1"}, {"b", "2"}};
+    auto params = std::make_unique<ConfigurationParameters>(map);
+    REQUIRE(params->get<std::string>("foo") == "bar");
+    ConfigurationParameters copy(*params);
+    //the copy must not refer to the keys of the original
+    params.reset();
+    REQUIRE(copy.unusedKeys().size() == 2);
+    REQUIRE(copy.unusedKeys()[0] == "a");
+    REQUIRE(copy.unusedKeys()[1] == "b");
+    REQUIRE(copy.get<int>("a") == 1);
+    REQUIRE(copy.unusedKeys().size() == 1);
+    auto unused = copy.takeUnusedKeyValues();
+    REQUIRE(unused.size() == 1);
+    REQUIRE(unused["b"] == "2");
+  }
+
 }
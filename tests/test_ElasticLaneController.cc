@@ -0,0 +1,71 @@
+#include "catch2/catch.hpp"
+#include "ElasticLaneController.h"
+
+TEST_CASE("Test ElasticLaneController", "[ElasticLaneController]") {
+  using namespace cce::tf;
+  using namespace std::chrono_literals;
+  ElasticLaneController::Config config;
+  config.minLanes_ = 2;
+  config.maxLanes_ = 8;
+  config.probeIntervals_ = 2;
+
+  SECTION("climbs while the rate rises") {
+    ElasticLaneController controller(config);
+    REQUIRE(controller.activeLanes() == 2);
+    REQUIRE(controller.update(1000ms, 100., 0) == 3);
+    REQUIRE(controller.update(2000ms, 150., 0) == 4);
+    REQUIRE(controller.update(3000ms, 190., 0) == 5);
+    //no gain so goes back and stays
+    REQUIRE(controller.update(4000ms, 192., 0) == 4);
+    REQUIRE(controller.update(5000ms, 190., 0) == 4);
+    REQUIRE(controller.changes().size() == 4);
+    REQUIRE(controller.bestLanes() == 5);
+  }
+  SECTION("probes both directions once settled") {
+    ElasticLaneController controller(config);
+    controller.update(1000ms, 100., 0);
+    REQUIRE(controller.update(2000ms, 100., 0) == 2);
+    REQUIRE(controller.update(3000ms, 100., 0) == 2);
+    //probe more
+    REQUIRE(controller.update(4000ms, 100., 0) == 3);
+    REQUIRE(controller.update(5000ms, 100., 0) == 2);
+    REQUIRE(controller.update(6000ms, 100., 0) == 2);
+    //probe fewer stops at the minimum
+    REQUIRE(controller.update(7000ms, 100., 0) == 2);
+  }
+  SECTION("fewer lanes kept when the rate holds") {
+    config.minLanes_ = 1;
+    config.probeIntervals_ = 1;
+    ElasticLaneController controller(config);
+    controller.update(1000ms, 100., 0);
+    REQUIRE(controller.update(2000ms, 200., 0) == 3);
+    REQUIRE(controller.update(3000ms, 200., 0) == 2);
+    REQUIRE(controller.update(4000ms, 200., 0) == 3);
+    REQUIRE(controller.update(5000ms, 200., 0) == 2);
+    //probe fewer, the rate drops so goes back
+    REQUIRE(controller.update(6000ms, 200., 0) == 1);
+    REQUIRE(controller.update(7000ms, 100., 0) == 2);
+  }
+  SECTION("memory limit removes lanes") {
+    config.maxResidentBytes_ = 1000;
+    ElasticLaneController controller(config);
+    controller.update(1000ms, 100., 0);
+    controller.update(2000ms, 200., 0);
+    REQUIRE(controller.activeLanes() == 4);
+    REQUIRE(controller.update(3000ms, 300., 2000) == 3);
+    REQUIRE(controller.nMemoryLimited() == 1);
+  }
+  SECTION("parse") {
+    auto parsed = parseElasticLaneConfig("min=3:step=2:interval_ms=500:gain=0.1:maxRSS_MB=2:probe=4", 16);
+    REQUIRE(parsed);
+    REQUIRE(parsed->minLanes_ == 3);
+    REQUIRE(parsed->maxLanes_ == 16);
+    REQUIRE(parsed->step_ == 2);
+    REQUIRE(parsed->interval_ == 500ms);
+    REQUIRE(parsed->minGain_ == 0.1);
+    REQUIRE(parsed->maxResidentBytes_ == 2000000);
+    REQUIRE(parsed->probeIntervals_ == 4);
+    REQUIRE(not parseElasticLaneConfig("min=0", 4));
+    REQUIRE(not parseElasticLaneConfig("lanes=2", 4));
+  }
+}
@@ -0,0 +1,52 @@
+#include "catch2/catch.hpp"
+#include <sstream>
+#include <stdexcept>
+#include "EventList.h"
+
+TEST_CASE("Test EventList", "[EventList]") {
+  using namespace cce::tf;
+  SECTION("read") {
+    std::istringstream list("# run lumi event\n1 2 3\n\n  4 5 6000000000\n");
+    auto events = readEventList(list);
+    REQUIRE(events.size() == 2);
+    REQUIRE(events[0].run == 1);
+    REQUIRE(events[0].lumi == 2);
+    REQUIRE(events[0].event == 3);
+    REQUIRE(events[1].event == 6000000000ULL);
+  }
+  SECTION("bad line") {
+    std::istringstream list("1 2\n");
+    REQUIRE_THROWS_AS(readEventList(list), std::runtime_error);
+    std::istringstream extra("1 2 3 4\n");
+    REQUIRE_THROWS_AS(readEventList(extra), std::runtime_error);
+  }
+  SECTION("select") {
+    std::vector<EventIdentifier> file = {{1,1,3}, {1,1,1}, {1,2,1}, {2,1,1}, {1,1,2}};
+    auto positions = selectEvents(file, {{2,1,1}, {1,1,3}, {1,1,2}, {9,9,9}});
+    REQUIRE(positions == std::vector<long>({0,3,4}));
+    REQUIRE(selectEvents(file, {}).empty());
+  }
+  SECTION("selection") {
+    EventSelection all("");
+    REQUIRE(all.selectsAll());
+    REQUIRE(all({7,8,9}));
+
+    EventSelection selection("1.3-1.7,5,2.1.10-2.1.20");
+    REQUIRE(not selection.selectsAll());
+    REQUIRE(selection({1,3,1}));
+    REQUIRE(selection({1,7,6000000000ULL}));
+    REQUIRE(not selection({1,2,100}));
+    REQUIRE(not selection({1,8,0}));
+    REQUIRE(selection({5,1,1}));
+    REQUIRE(selection({5,4000000000U,1}));
+    REQUIRE(not selection({4,1,1}));
+    REQUIRE(selection({2,1,10}));
+    REQUIRE(selection({2,1,20}));
+    REQUIRE(not selection({2,1,21}));
+  }
+  SECTION("bad selection") {
+    REQUIRE_THROWS_AS(EventSelection("1.x"), std::runtime_error);
+    REQUIRE_THROWS_AS(EventSelection("1.2.3.4"), std::runtime_error);
+    REQUIRE_THROWS_AS(EventSelection("1-"), std::runtime_error);
+  }
+}
@@ -0,0 +1,56 @@
+#include "catch2/catch.hpp"
+#include <memory>
+#include <vector>
+#include "EventReorderBuffer.h"
+
+TEST_CASE("Test EventReorderBuffer", "[EventReorderBuffer]") {
+  using namespace cce::tf;
+  EventReorderBuffer<int> buffer(2);
+  std::vector<int> passed;
+  auto pass = [&passed](int iValue) { passed.push_back(iValue); };
+
+  SECTION("in order") {
+    for(int i=0; i<3; ++i) {
+      buffer.push(i, 10*i, pass);
+    }
+    REQUIRE(passed == std::vector<int>({0,10,20}));
+    REQUIRE(buffer.size() == 0);
+  }
+  SECTION("out of order") {
+    buffer.push(2, 20, pass);
+    REQUIRE(passed.empty());
+    REQUIRE(not buffer.isFull());
+    buffer.push(1, 10, pass);
+    REQUIRE(passed.empty());
+    REQUIRE(buffer.isFull());
+    REQUIRE(buffer.isNext(0));
+    buffer.push(0, 0, pass);
+    REQUIRE(passed == std::vector<int>({0,10,20}));
+    REQUIRE(buffer.size() == 0);
+    REQUIRE(buffer.maxHeldReached() == 2);
+    REQUIRE(buffer.isNext(3));
+  }
+  SECTION("first index") {
+    buffer.setFirstEventIndex(5);
+    buffer.push(6, 60, pass);
+    REQUIRE(passed.empty());
+    buffer.push(5, 50, pass);
+    REQUIRE(passed == std::vector<int>({50,60}));
+    REQUIRE(buffer.isNext(7));
+  }
+  SECTION("flush") {
+    buffer.push(3, 30, pass);
+    buffer.push(1, 10, pass);
+    buffer.flush(pass);
+    REQUIRE(passed == std::vector<int>({10,30}));
+    REQUIRE(buffer.isNext(4));
+  }
+  SECTION("move only") {
+    EventReorderBuffer<std::unique_ptr<int>> ptrs(2);
+    std::vector<int> values;
+    auto passPtr = [&values](std::unique_ptr<int> iValue) { values.push_back(*iValue); };
+    ptrs.push(1, std::make_unique<int>(1), passPtr);
+    ptrs.push(0, std::make_unique<int>(0), passPtr);
+    REQUIRE(values == std::vector<int>({0,1}));
+  }
+}
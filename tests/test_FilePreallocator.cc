@@ -0,0 +1,72 @@
+#include "catch2/catch.hpp"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include "FilePreallocator.h"
+
+TEST_CASE("Test FilePreallocator", "[FilePreallocator]") {
+  using namespace cce::tf;
+  using namespace std::chrono_literals;
+
+  SECTION("extent size") {
+    REQUIRE(FilePreallocator::extentSize(1000, 0., 1.) == 1000);
+    REQUIRE(FilePreallocator::extentSize(1000, 500., 1.) == 1000);
+    //rounded up to a multiple of the smallest extent
+    REQUIRE(FilePreallocator::extentSize(1000, 2500., 1.) == 3000);
+    REQUIRE(FilePreallocator::extentSize(1000, 2500., 2.) == 5000);
+    //at most 64 times the smallest extent
+    REQUIRE(FilePreallocator::extentSize(1000, 1.e9, 1.) == 64000);
+  }
+  SECTION("allocate ahead") {
+    std::string const fileName = "test_FilePreallocator.dat";
+    std::ofstream file(fileName, std::ios_base::out | std::ios_base::binary);
+    auto sizeOf = [&fileName]() {
+      struct stat info;
+      stat(fileName.c_str(), &info);
+      return info.st_size;
+    };
+    {
+      FilePreallocator preallocator(fileName, 4096);
+      auto const start = FilePreallocator::Clock::now();
+      preallocator.written(0, start);
+      bool const supported = preallocator.supported();
+      if(supported) {
+        REQUIRE(preallocator.nAllocations() == 1);
+        REQUIRE(preallocator.allocatedEnd() == 4096);
+        //the allocation does not change the size of the file
+        REQUIRE(sizeOf() == 0);
+      }
+
+      std::string const data(1000, 'a');
+      file.write(data.data(), data.size());
+      file.flush();
+      //still more than half of the smallest extent ahead
+      preallocator.written(1000, start+1s);
+      if(supported) {
+        REQUIRE(preallocator.nAllocations() == 1);
+      }
+
+      for(int i = 0; i < 3; ++i) {
+        file.write(data.data(), data.size());
+      }
+      file.flush();
+      //written at 4000 bytes per second, one second ahead rounds up to 4096 bytes
+      preallocator.written(4000, start+1s);
+      if(supported) {
+        REQUIRE(preallocator.nAllocations() == 2);
+        REQUIRE(preallocator.allocatedEnd() == 8192);
+      }
+      REQUIRE(sizeOf() == 4000);
+
+      preallocator.finish();
+      if(supported) {
+        REQUIRE(preallocator.unusedBytes() == 4192);
+      }
+    }
+    REQUIRE(sizeOf() == 4000);
+    file.close();
+    std::remove(fileName.c_str());
+  }
+}
@@ -0,0 +1,50 @@
+#include "catch2/catch.hpp"
+#include "InFlightLimit.h"
+
+TEST_CASE("Test InFlightLimit", "[InFlightLimit]") {
+  using namespace cce::tf;
+  int nCalled = 0;
+  auto called = [&nCalled]() { ++nCalled; };
+
+  SECTION("no limit") {
+    InFlightLimit limit(0, 0);
+    for(int i=0; i<3; ++i) {
+      limit.add(100);
+    }
+    limit.whenRoom(called);
+    REQUIRE(nCalled == 1);
+    REQUIRE(limit.maxEventsHeld() == 3);
+    REQUIRE(limit.maxBytesHeld() == 300);
+    REQUIRE(limit.nWaited() == 0);
+  }
+  SECTION("event limit") {
+    InFlightLimit limit(2, 0);
+    limit.add(10);
+    limit.whenRoom(called);
+    REQUIRE(nCalled == 1);
+    limit.add(10);
+    limit.whenRoom(called);
+    limit.whenRoom(called);
+    REQUIRE(nCalled == 1);
+    REQUIRE(limit.nWaited() == 2);
+    limit.remove(10);
+    REQUIRE(nCalled == 3);
+    limit.remove(10);
+    REQUIRE(nCalled == 3);
+  }
+  SECTION("byte limit") {
+    InFlightLimit limit(0, 100);
+    limit.add(60);
+    limit.add(60);
+    limit.whenRoom(called);
+    REQUIRE(nCalled == 0);
+    limit.remove(60);
+    REQUIRE(nCalled == 1);
+    limit.add(60);
+    limit.whenRoom(called);
+    REQUIRE(nCalled == 1);
+    limit.remove(60);
+    REQUIRE(nCalled == 2);
+    REQUIRE(limit.maxBytesHeld() == 120);
+  }
+}
@@ -0,0 +1,61 @@
+#include "catch2/catch.hpp"
+#include "LatencyHistogram.h"
+
+TEST_CASE("Test LatencyHistogram", "[LatencyHistogram]") {
+  using namespace cce::tf;
+
+  SECTION("bins") {
+    for(std::uint64_t v: {0ULL, 1ULL, 63ULL, 64ULL, 65ULL, 1000ULL, 123456789ULL, ~0ULL}) {
+      auto bin = LatencyHistogram::binIndex(v);
+      REQUIRE(bin < LatencyHistogram::kNBins);
+      REQUIRE(LatencyHistogram::lowestInBin(bin) <= v);
+      REQUIRE(LatencyHistogram::highestInBin(bin) >= v);
+    }
+    //small values are exact
+    REQUIRE(LatencyHistogram::highestInBin(LatencyHistogram::binIndex(63)) == 63);
+    //larger values are within the bin width
+    auto bin = LatencyHistogram::binIndex(1000000);
+    REQUIRE(LatencyHistogram::highestInBin(bin) - LatencyHistogram::lowestInBin(bin) < 1000000/LatencyHistogram::kSubBuckets);
+  }
+  SECTION("empty") {
+    LatencyHistogram h;
+    REQUIRE(h.count() == 0);
+    REQUIRE(h.percentile(0.5) == 0);
+    REQUIRE(h.mean() == 0.);
+  }
+  SECTION("percentiles") {
+    LatencyHistogram h;
+    for(std::uint64_t v = 1; v <= 100; ++v) {
+      h.record(v);
+    }
+    REQUIRE(h.count() == 100);
+    REQUIRE(h.max() == 100);
+    REQUIRE(h.mean() == Approx(50.5));
+    REQUIRE(h.percentile(0.5) == 50);
+    REQUIRE(h.percentile(0.99) == 99);
+    REQUIRE(h.percentile(1.) == 100);
+    REQUIRE(h.percentile(0.) == 1);
+  }
+  SECTION("tail") {
+    LatencyHistogram h;
+    for(int i = 0; i < 999; ++i) {
+      h.record(10);
+    }
+    h.record(100000);
+    REQUIRE(h.percentile(0.99) == 10);
+    REQUIRE(h.percentile(0.999) == 10);
+    REQUIRE(h.percentile(0.9999) == 100000);
+  }
+  SECTION("add") {
+    LatencyHistogram h1;
+    LatencyHistogram h2;
+    h1.record(5);
+    h2.record(7);
+    h2.record(9);
+    h1.add(h2);
+    REQUIRE(h1.count() == 3);
+    REQUIRE(h1.sum() == 21);
+    REQUIRE(h1.max() == 9);
+    REQUIRE(h1.percentile(0.5) == 7);
+  }
+}
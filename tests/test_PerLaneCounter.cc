@@ -0,0 +1,42 @@
+#include "catch2/catch.hpp"
+#include "PerLaneCounter.h"
+
+#include <thread>
+#include <vector>
+
+TEST_CASE("Test PerLaneCounter", "[PerLaneCounter]") {
+  using namespace cce::tf;
+
+  SECTION("empty") {
+    PerLaneCounter<long long> counter(3);
+    REQUIRE(counter.sum() == 0);
+  }
+  SECTION("sum of lanes") {
+    PerLaneCounter<long long> counter(3);
+    counter.add(0, 5);
+    counter.add(2, 7);
+    counter.add(2, 1);
+    REQUIRE(counter.sum() == 13);
+  }
+  SECTION("no lanes") {
+    PerLaneCounter<long long> counter(0);
+    counter.add(0, 2);
+    REQUIRE(counter.sum() == 2);
+  }
+  SECTION("concurrent lanes") {
+    constexpr unsigned int kNLanes = 4;
+    PerLaneCounter<long long> counter(kNLanes);
+    std::vector<std::thread> threads;
+    for(unsigned int lane = 0; lane < kNLanes; ++lane) {
+      threads.emplace_back([&counter, lane]() {
+          for(int i=0; i<1000; ++i) {
+            counter.add(lane, 1);
+          }
+        });
+    }
+    for(auto& thread: threads) {
+      thread.join();
+    }
+    REQUIRE(counter.sum() == kNLanes*1000);
+  }
+}
@@ -0,0 +1,34 @@
+#include "catch2/catch.hpp"
+#include "PipelineSpec.h"
+
+TEST_CASE("Test PipelineSpec", "[PipelineSpec]") {
+  using namespace cce::tf;
+
+  SECTION("parse") {
+    auto spec = parsePipelineSpec("read SharedPDSSource=test.pds DummyOutputer");
+    REQUIRE(spec);
+    REQUIRE(spec->name_ == "read");
+    REQUIRE(spec->source_ == "SharedPDSSource=test.pds");
+    REQUIRE(spec->outputer_ == "DummyOutputer");
+    REQUIRE(spec->lanes_ == 0);
+    REQUIRE(spec->waiter_.empty());
+
+    spec = parsePipelineSpec(" write  EmptySource RootEventOutputer=out.eroot 4 ScaleWaiter=scale=2 ");
+    REQUIRE(spec);
+    REQUIRE(spec->lanes_ == 4);
+    REQUIRE(spec->outputer_ == "RootEventOutputer=out.eroot");
+    REQUIRE(spec->waiter_ == "ScaleWaiter=scale=2");
+
+    REQUIRE(not parsePipelineSpec("read SharedPDSSource=test.pds"));
+    REQUIRE(not parsePipelineSpec("read EmptySource DummyOutputer 0"));
+    REQUIRE(not parsePipelineSpec("read EmptySource DummyOutputer four"));
+    REQUIRE(not parsePipelineSpec("read EmptySource DummyOutputer 4 ScaleWaiter extra"));
+  }
+  SECTION("partition threads") {
+    REQUIRE(partitionThreads(8, {2, 2}) == std::vector<int>{4, 4});
+    REQUIRE(partitionThreads(8, {1, 3}) == std::vector<int>{2, 6});
+    REQUIRE(partitionThreads(5, {1, 1}) == std::vector<int>{3, 2});
+    REQUIRE(partitionThreads(2, {1, 1, 1}) == std::vector<int>{1, 1, 1});
+    REQUIRE(partitionThreads(4, {}).empty());
+  }
+}
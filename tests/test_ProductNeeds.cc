@@ -0,0 +1,37 @@
+#include "catch2/catch.hpp"
+#include "ProductNeeds.h"
+
+TEST_CASE("Test ProductNeeds", "[ProductNeeds]") {
+  using namespace cce::tf;
+  std::vector<std::string> names = {"ints", "vfloats", "vecDouble", "vecInt", "EventAuxiliary"};
+
+  SECTION("all") {
+    ProductNeeds needs;
+    REQUIRE(needs.needsAll());
+    REQUIRE(needs.order(names) == std::vector<unsigned int>({0, 1, 2, 3, 4}));
+    REQUIRE(ProductNeeds(",").needsAll());
+  }
+  SECTION("none") {
+    auto needs = ProductNeeds::none();
+    REQUIRE(not needs.needsAll());
+    REQUIRE(needs.order(names).empty());
+  }
+  SECTION("declared order") {
+    ProductNeeds needs("vec*,ints,vecInt,missing");
+    REQUIRE(not needs.needsAll());
+    REQUIRE(needs.order(names) == std::vector<unsigned int>({2, 3, 0}));
+    REQUIRE(ProductNeeds("EventAuxiliary,vfloats").order(names) == std::vector<unsigned int>({4, 1}));
+  }
+  SECTION("add") {
+    ProductNeeds needs("vfloats");
+    needs.add(ProductNeeds("ints,vfloats"));
+    REQUIRE(needs.order(names) == std::vector<unsigned int>({1, 0}));
+    auto none = ProductNeeds::none();
+    none.add(ProductNeeds("vecInt"));
+    REQUIRE(none.order(names) == std::vector<unsigned int>({3}));
+    needs.add(ProductNeeds());
+    REQUIRE(needs.needsAll());
+    needs.add(ProductNeeds("ints"));
+    REQUIRE(needs.needsAll());
+  }
+}
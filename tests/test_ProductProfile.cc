@@ -0,0 +1,39 @@
+#include "catch2/catch.hpp"
+#include <sstream>
+#include "ProductProfile.h"
+
+TEST_CASE("Test ProductProfile", "[ProductProfile]") {
+  using namespace cce::tf;
+
+  SECTION("add") {
+    ProductProfile profile;
+    REQUIRE(profile.empty());
+    profile.add("ints", {10, 400, 64, 80, 5.});
+    profile.add("ints", {20, 600, 32, 100, 7.});
+    auto entry = profile.find("ints");
+    REQUIRE(entry);
+    REQUIRE(entry->nEntries_ == 30);
+    REQUIRE(entry->totalBytes_ == 1000);
+    REQUIRE(entry->p99Bytes_ == 64);
+    REQUIRE(entry->maxBytes_ == 100);
+    REQUIRE(entry->meanSerializeTime_us() == Approx(0.4));
+    REQUIRE(not profile.find("floats"));
+  }
+  SECTION("write and read") {
+    ProductProfile profile;
+    profile.add("ints", {10, 400, 64, 80, 5.5});
+    profile.add("vfloats", {10, 4000, 512, 600, 20.});
+    std::stringstream text;
+    profile.write(text);
+    auto read = ProductProfile::read(text);
+    REQUIRE(read);
+    REQUIRE(read->entries().size() == 2);
+    REQUIRE(read->find("vfloats")->p99Bytes_ == 512);
+    REQUIRE(read->find("ints")->serializeTime_us_ == Approx(5.5));
+
+    std::istringstream noHeader("ints 10 400 64 80 5\n");
+    REQUIRE(not ProductProfile::read(noHeader));
+    std::istringstream missing("# threaded_io_test product profile\nints 10 400\n");
+    REQUIRE(not ProductProfile::read(missing));
+  }
+}
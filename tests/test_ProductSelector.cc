@@ -0,0 +1,49 @@
+#include "catch2/catch.hpp"
+#include "ProductSelector.h"
+
+TEST_CASE("Test matchesPattern function", "[ProductSelector]") {
+  using namespace cce::tf;
+  SECTION("exact") {
+    REQUIRE(matchesPattern("ints", "ints"));
+    REQUIRE(not matchesPattern("ints", "int"));
+    REQUIRE(not matchesPattern("int", "ints"));
+  }
+  SECTION("wildcards") {
+    REQUIRE(matchesPattern("*", "ints"));
+    REQUIRE(matchesPattern("*", ""));
+    REQUIRE(matchesPattern("in*", "ints"));
+    REQUIRE(matchesPattern("*ts", "ints"));
+    REQUIRE(matchesPattern("i*t*s", "ints"));
+    REQUIRE(matchesPattern("*Aux*", "EventAuxiliary"));
+    REQUIRE(not matchesPattern("*Aux*", "floats"));
+    REQUIRE(not matchesPattern("f*ts", "floatsA"));
+  }
+}
+
+TEST_CASE("Test ProductSelector", "[ProductSelector]") {
+  using namespace cce::tf;
+  SECTION("empty selection") {
+    ProductSelector s;
+    REQUIRE(s.keepsAll());
+    REQUIRE(s.keep("ints"));
+    REQUIRE(ProductSelector("").keepsAll());
+  }
+  SECTION("include") {
+    ProductSelector s("ints,vec*");
+    REQUIRE(not s.keepsAll());
+    REQUIRE(s.keep("ints"));
+    REQUIRE(s.keep("vecFloats"));
+    REQUIRE(not s.keep("floats"));
+  }
+  SECTION("exclude") {
+    ProductSelector s("-floats");
+    REQUIRE(s.keep("ints"));
+    REQUIRE(not s.keep("floats"));
+  }
+  SECTION("include then exclude") {
+    ProductSelector s("vec*,-vecDouble");
+    REQUIRE(s.keep("vecFloats"));
+    REQUIRE(not s.keep("vecDouble"));
+    REQUIRE(not s.keep("ints"));
+  }
+}
@@ -0,0 +1,66 @@
+#include "catch2/catch.hpp"
+#include <memory>
+#include <vector>
+#include "ProxyVector.h"
+
+namespace {
+  class Base {
+  public:
+    virtual ~Base() = default;
+    virtual int value() const = 0;
+    virtual void increment() = 0;
+  };
+
+  //larger than Base so the stride differs from sizeof(Base)
+  class Derived final : public Base {
+  public:
+    Derived(int iValue): value_{iValue} {}
+    int value() const final { return value_;}
+    void increment() final { ++value_; }
+  private:
+    int value_;
+    double padding_[3] = {};
+  };
+}
+
+TEST_CASE("Test ProxyVector", "[ProxyVector]") {
+  using namespace cce::tf;
+  auto v = ProxyVector<Base, int>::make<Derived>();
+  v.reserve(5);
+  for(int i=0; i<5; ++i) {
+    v.emplace_back(i);
+  }
+  REQUIRE(v.size() == 5);
+
+  SECTION("view") {
+    auto const& cv = v;
+    auto view = cv.view();
+    REQUIRE(view.size() == 5);
+    for(int i=0; i<5; ++i) {
+      REQUIRE(view[i].value() == i);
+      REQUIRE(&view[i] == &cv[i]);
+    }
+  }
+  SECTION("for_each") {
+    v.for_each([](Base& b) { b.increment(); });
+    std::vector<int> values;
+    auto const& cv = v;
+    cv.for_each([&values](Base const& b) { values.push_back(b.value()); });
+    REQUIRE(values == std::vector<int>({1,2,3,4,5}));
+  }
+  SECTION("range for") {
+    int expected = 0;
+    for(auto const& b: v) {
+      REQUIRE(b.value() == expected++);
+    }
+    REQUIRE(expected == 5);
+  }
+  SECTION("empty") {
+    auto e = ProxyVector<Base, int>::make<Derived>();
+    int n = 0;
+    e.for_each([&n](Base&) { ++n; });
+    REQUIRE(n == 0);
+    REQUIRE(e.view().size() == 0);
+    REQUIRE(not (e.begin() != e.end()));
+  }
+}
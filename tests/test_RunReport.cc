@@ -0,0 +1,74 @@
+#include "catch2/catch.hpp"
+#include <sstream>
+#include <limits>
+#include "RunReport.h"
+
+TEST_CASE("Test jsonString", "[RunReport]") {
+  using namespace cce::tf;
+  REQUIRE(jsonString("abc") == "\"abc\"");
+  REQUIRE(jsonString("a\"b") == "\"a\\\"b\"");
+  REQUIRE(jsonString("a\\b") == "\"a\\\\b\"");
+  REQUIRE(jsonString("a\nb") == "\"a\\nb\"");
+  REQUIRE(jsonString(std::string_view("\x01", 1)) == "\"\\u0001\"");
+}
+
+TEST_CASE("Test RunReport", "[RunReport]") {
+  using namespace cce::tf;
+
+  auto toString = [](RunReport const& iReport) {
+    std::ostringstream s;
+    iReport.write(s);
+    return s.str();
+  };
+
+  SECTION("empty") {
+    RunReport report;
+    REQUIRE(report.empty());
+    REQUIRE(toString(report) == "{}");
+  }
+  SECTION("values") {
+    RunReport report;
+    report.set("events", 10);
+    report.set("rate", 2.5);
+    report.set("name", "PDSOutputer");
+    report.set("ordered", true);
+    REQUIRE(toString(report) == "{\n  \"events\": 10,\n  \"rate\": 2.5,\n  \"name\": \"PDSOutputer\",\n  \"ordered\": true\n}");
+  }
+  SECTION("replace") {
+    RunReport report;
+    report.set("events", 10);
+    report.set("other", 1);
+    report.set("events", 20);
+    REQUIRE(toString(report) == "{\n  \"events\": 20,\n  \"other\": 1\n}");
+  }
+  SECTION("sections") {
+    RunReport report;
+    report.section("source").set("readTime_us", 5);
+    report.section("source").set("nReads", 2);
+    report.section("outputer");
+    REQUIRE(toString(report) == "{\n  \"source\": {\n    \"readTime_us\": 5,\n    \"nReads\": 2\n  },\n  \"outputer\": {}\n}");
+  }
+  SECTION("numbers") {
+    RunReport report;
+    report.set("events", 10);
+    report.set("name", "PDSOutputer");
+    report.set("ordered", true);
+    report.set("rates", std::vector<double>{1., 2.});
+    report.section("source").set("readTime_us", 2.5);
+    auto numbers = report.numbers();
+    REQUIRE(numbers.size() == 2);
+    REQUIRE(numbers[0] == std::pair<std::string, double>("events", 10.));
+    REQUIRE(numbers[1] == std::pair<std::string, double>("source.readTime_us", 2.5));
+  }
+  SECTION("not finite") {
+    RunReport report;
+    report.set("ratio", std::numeric_limits<double>::infinity());
+    REQUIRE(toString(report) == "{\n  \"ratio\": null\n}");
+  }
+  SECTION("array") {
+    RunReport report;
+    report.set("rate", std::vector<double>{1., 2.5, std::numeric_limits<double>::infinity()});
+    report.set("empty", std::vector<double>());
+    REQUIRE(toString(report) == "{\n  \"rate\": [1, 2.5, null],\n  \"empty\": []\n}");
+  }
+}
@@ -0,0 +1,85 @@
+#include "catch2/catch.hpp"
+#include "ShmEventRing.h"
+
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+TEST_CASE("Test ShmEventRing", "[ShmEventRing]") {
+  using namespace cce::tf;
+  using namespace std::chrono_literals;
+  std::string const name = "tio_test_ring_"+std::to_string(::getpid());
+  std::vector<uint32_t> const header = {1, 2, 3};
+
+  SECTION("header and records") {
+    auto feeder = ShmEventRing::create(name, header, 2, 64, 1, 1000ms);
+    auto consumer = ShmEventRing::attach(name, 1000ms);
+    REQUIRE(consumer.header() == header);
+    REQUIRE(consumer.nConsumers() == 1);
+    REQUIRE(consumer.consumerIndex() == 0);
+
+    std::vector<uint32_t> record = {10, 11, 12};
+    feeder.publish(record.data(), record.data()+record.size());
+    auto n = consumer.claim();
+    REQUIRE(n);
+    REQUIRE(*n == 0);
+    auto r = consumer.record(*n);
+    REQUIRE(std::vector<uint32_t>(r.begin_, r.end_) == record);
+    consumer.release(*n);
+
+    feeder.finish();
+    REQUIRE(not consumer.claim());
+    REQUIRE(feeder.waitUntilReleased());
+    REQUIRE(feeder.nPublished() == 1);
+  }
+  SECTION("every consumer sees every record") {
+    auto feeder = ShmEventRing::create(name, header, 2, 64, 2, 1000ms);
+    auto first = ShmEventRing::attach(name, 1000ms);
+    auto second = ShmEventRing::attach(name, 1000ms);
+    REQUIRE(second.consumerIndex() == 1);
+    REQUIRE_THROWS_AS(ShmEventRing::attach(name, 1000ms), std::runtime_error);
+
+    constexpr uint32_t kNRecords = 20;
+    std::thread feed([&feeder]() {
+        for(uint32_t i = 0; i < kNRecords; ++i) {
+          std::vector<uint32_t> record(1+i%5, i);
+          feeder.publish(record.data(), record.data()+record.size());
+        }
+        feeder.finish();
+      });
+    //checked after the threads end as REQUIRE is not thread safe
+    uint32_t nSeen[2] = {0, 0};
+    bool inOrder[2] = {true, true};
+    std::vector<std::thread> consumers;
+    for(int i = 0; i < 2; ++i) {
+      //the ring only has 2 slots so the feeder waits for the consumers
+      consumers.emplace_back([consumer = i == 0 ? &first : &second, &seen = nSeen[i], &ordered = inOrder[i]]() {
+          while(auto n = consumer->claim()) {
+            auto r = consumer->record(*n);
+            if(r.end_-r.begin_ != 1+seen%5 or *r.begin_ != seen) {
+              ordered = false;
+            }
+            consumer->release(*n);
+            ++seen;
+          }
+        });
+    }
+    for(auto& c: consumers) {
+      c.join();
+    }
+    feed.join();
+    REQUIRE(nSeen[0] == kNRecords);
+    REQUIRE(nSeen[1] == kNRecords);
+    REQUIRE(inOrder[0]);
+    REQUIRE(inOrder[1]);
+    REQUIRE(feeder.waitUntilReleased());
+  }
+  SECTION("record too large") {
+    auto feeder = ShmEventRing::create(name, header, 1, 64, 1, 1000ms);
+    std::vector<uint32_t> record(17, 0);
+    REQUIRE_THROWS_AS(feeder.publish(record.data(), record.data()+record.size()), std::runtime_error);
+  }
+  SECTION("no feeder") {
+    REQUIRE_THROWS_AS(ShmEventRing::attach(name, 10ms), std::runtime_error);
+  }
+}
@@ -0,0 +1,34 @@
+#include "catch2/catch.hpp"
+#include <vector>
+#include "SizeTargetBatcher.h"
+
+TEST_CASE("Test SizeTargetBatcher", "[SizeTargetBatcher]") {
+  using namespace cce::tf;
+
+  SECTION("closed by bytes") {
+    SizeTargetBatcher<int> batcher(10, 0);
+    REQUIRE(batcher.add(1, 4).empty());
+    REQUIRE(batcher.add(2, 4).empty());
+    REQUIRE(batcher.add(3, 4) == std::vector<int>({1,2,3}));
+    REQUIRE(batcher.add(4, 20) == std::vector<int>({4}));
+    REQUIRE(batcher.takeRemaining().empty());
+
+    auto const& stats = batcher.stats();
+    REQUIRE(stats.nBatches_ == 2);
+    REQUIRE(stats.nEntries_ == 4);
+    REQUIRE(stats.minEntries_ == 1);
+    REQUIRE(stats.maxEntries_ == 3);
+    REQUIRE(stats.bytes_ == 32);
+    REQUIRE(stats.maxBytes_ == 20);
+    REQUIRE(stats.nClosedByEntryLimit_ == 0);
+  }
+  SECTION("closed by entries") {
+    SizeTargetBatcher<int> batcher(100, 2);
+    REQUIRE(batcher.add(1, 1).empty());
+    REQUIRE(batcher.add(2, 1) == std::vector<int>({1,2}));
+    REQUIRE(batcher.add(3, 1).empty());
+    REQUIRE(batcher.takeRemaining() == std::vector<int>({3}));
+    REQUIRE(batcher.stats().nBatches_ == 2);
+    REQUIRE(batcher.stats().nClosedByEntryLimit_ == 1);
+  }
+}
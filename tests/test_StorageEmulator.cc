@@ -0,0 +1,53 @@
+#include "catch2/catch.hpp"
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "StorageEmulator.h"
+
+TEST_CASE("Test StorageEmulator", "[StorageEmulator]") {
+  using namespace cce::tf;
+  using namespace std::chrono_literals;
+  auto timed = [](auto iFunction) {
+    auto start = std::chrono::steady_clock::now();
+    iFunction();
+    return std::chrono::steady_clock::now() - start;
+  };
+
+  SECTION("parse") {
+    auto config = parseStorageEmulatorConfig("latency_us=2000:bandwidth_MBps=1.5:concurrency=4");
+    REQUIRE(config);
+    REQUIRE(config->latency_ == 2000us);
+    REQUIRE(config->bandwidth_ == 1.5e6);
+    REQUIRE(config->maxConcurrent_ == 4);
+    REQUIRE(parseStorageEmulatorConfig(""));
+    REQUIRE(not parseStorageEmulatorConfig("latency=5"));
+    REQUIRE(not parseStorageEmulatorConfig("latency_us=5ms"));
+  }
+  SECTION("latency") {
+    StorageEmulator emulator({10ms, 0, 0});
+    REQUIRE(timed([&]() { emulator.request(100); }) >= 10ms);
+    REQUIRE(emulator.nRequests() == 1);
+    REQUIRE(emulator.bytes() == 100);
+    REQUIRE(emulator.delayTime() >= 10ms);
+  }
+  SECTION("bandwidth") {
+    //1MB/s so 20kB take 20ms
+    StorageEmulator emulator({0us, 1.e6, 0});
+    REQUIRE(timed([&]() { emulator.request(10000); emulator.request(10000); }) >= 20ms);
+  }
+  SECTION("concurrency") {
+    StorageEmulator emulator({20ms, 0, 1});
+    auto time = timed([&]() {
+        std::thread other([&]() { emulator.request(1); });
+        emulator.request(1);
+        other.join();
+      });
+    //the requests do not overlap their latencies
+    REQUIRE(time >= 40ms);
+    REQUIRE(emulator.nWaitedForSlot() == 1);
+  }
+  SECTION("no global emulator") {
+    REQUIRE(storageEmulator() == nullptr);
+    emulateStorageRequest(100);
+  }
+}
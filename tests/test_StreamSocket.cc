@@ -0,0 +1,56 @@
+#include "catch2/catch.hpp"
+#include "StreamSocket.h"
+
+#include <istream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Test StreamSocket", "[StreamSocket]") {
+  using namespace cce::tf;
+  using namespace std::chrono_literals;
+  auto listener = StreamSocket::listen("127.0.0.1:0", 4);
+  auto const address = "127.0.0.1:"+std::to_string(listener.port());
+
+  SECTION("send and receive through a stream") {
+    //larger than the socket buffers so the sender waits for the receiver
+    std::vector<uint32_t> sent(4*1024*1024);
+    std::iota(sent.begin(), sent.end(), 0);
+    std::thread sender([&]() {
+        auto socket = StreamSocket::connect(address, 1000ms);
+        socket.sendAll(sent.data(), 4*3);
+        socket.sendAll(sent.data()+3, (sent.size()-3)*4);
+        socket.shutdownSend();
+      });
+    auto socket = listener.accept(1000ms);
+    StreamSocketBuf buffer(socket, 1024);
+    std::istream stream(&buffer);
+    std::vector<uint32_t> received(sent.size());
+    stream.read(reinterpret_cast<char*>(received.data()), 4);
+    stream.read(reinterpret_cast<char*>(received.data()+1), (received.size()-1)*4);
+    sender.join();
+    REQUIRE(stream.good());
+    REQUIRE(received == sent);
+    char c;
+    stream.read(&c, 1);
+    REQUIRE(stream.eof());
+  }
+  SECTION("wait for readable") {
+    auto first = StreamSocket::connect(address, 1000ms);
+    auto second = StreamSocket::connect(address, 1000ms);
+    auto firstIn = listener.accept(1000ms);
+    auto secondIn = listener.accept(1000ms);
+    REQUIRE(-1 == waitForReadable({firstIn.fd(), secondIn.fd()}, 0, 10ms));
+    uint32_t word = 7;
+    second.sendAll(&word, 4);
+    REQUIRE(1 == waitForReadable({firstIn.fd(), secondIn.fd()}, 0, 1000ms));
+    first.shutdownSend();
+    REQUIRE(0 == waitForReadable({firstIn.fd(), secondIn.fd()}, 0, 1000ms));
+    REQUIRE(1 == waitForReadable({firstIn.fd(), secondIn.fd()}, 1, 1000ms));
+    REQUIRE(0 == firstIn.receive(&word, 4));
+  }
+  SECTION("no connection") {
+    REQUIRE_THROWS_AS(listener.accept(10ms), std::runtime_error);
+  }
+}
@@ -0,0 +1,42 @@
+#include "catch2/catch.hpp"
+#include <sstream>
+#include <thread>
+#include "Tracer.h"
+
+TEST_CASE("Test Tracer", "[Tracer]") {
+  using namespace cce::tf;
+
+  auto toString = []() {
+    std::ostringstream s;
+    Tracer::write(s);
+    return s.str();
+  };
+
+  //the Tracer is global so the order of the checks matters
+  REQUIRE(not Tracer::enabled());
+  {
+    TraceScope scope("notRecorded", "test");
+  }
+  REQUIRE(toString().find("notRecorded") == std::string::npos);
+
+  Tracer::enable();
+  REQUIRE(Tracer::enabled());
+  {
+    TraceScope scope("scope", "test");
+  }
+  std::thread([]() {
+      TraceScope scope("otherThread", "test");
+    }).join();
+  auto now = Tracer::Clock::now();
+  Tracer::recordForLane(3, "process", "lane", now, now+std::chrono::microseconds(5));
+
+  auto trace = toString();
+  REQUIRE(trace.find("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [") == 0);
+  REQUIRE(trace.find("\"name\": \"scope\", \"cat\": \"test\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1,") != std::string::npos);
+  REQUIRE(trace.find("\"name\": \"otherThread\", \"cat\": \"test\", \"ph\": \"X\", \"pid\": 1, \"tid\": 2,") != std::string::npos);
+  REQUIRE(trace.find("\"tid\": 1000003,") != std::string::npos);
+  REQUIRE(trace.find("\"dur\": 5}") != std::string::npos);
+  REQUIRE(trace.find("{\"name\": \"Lane 3\"}") != std::string::npos);
+  REQUIRE(trace.find("{\"name\": \"thread 2\"}") != std::string::npos);
+  REQUIRE(trace.substr(trace.size()-4) == "\n]}\n");
+}
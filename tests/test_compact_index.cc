@@ -0,0 +1,53 @@
+#include "catch2/catch.hpp"
+#include <stdexcept>
+#include <vector>
+#include "compact_index.h"
+
+TEST_CASE("Test compact_index", "[compact_index]") {
+  using namespace cce::tf;
+  SECTION("round trip") {
+    std::vector<EventIdentifier> ids;
+    std::vector<uint32_t> offsets;
+    constexpr std::size_t kEntries = 4;
+    for(unsigned int i = 0; i < 20; ++i) {
+      //a new lumi and an out of order event part way through
+      ids.push_back({1, i < 10 ? 1U : 2U, i == 15 ? 3ULL : 0x100000000ULL+i});
+      uint32_t offset = 0;
+      for(std::size_t e = 0; e < kEntries; ++e) {
+        offsets.push_back(offset);
+        offset += (e == 2 and i == 7) ? 100000 : i*e;
+      }
+    }
+    std::vector<char> bytes;
+    encodeBatchIndex(ids, offsets, kEntries, bytes);
+    REQUIRE(bytes.size() < offsets.size()*sizeof(uint32_t));
+
+    std::vector<EventIdentifier> readIDs;
+    std::vector<uint32_t> readOffsets;
+    decodeBatchIndex(bytes.data(), bytes.size(), kEntries, readIDs, readOffsets);
+    REQUIRE(readOffsets == offsets);
+    REQUIRE(readIDs.size() == ids.size());
+    for(std::size_t i = 0; i < ids.size(); ++i) {
+      REQUIRE(readIDs[i].run == ids[i].run);
+      REQUIRE(readIDs[i].lumi == ids[i].lumi);
+      REQUIRE(readIDs[i].event == ids[i].event);
+    }
+  }
+  SECTION("empty batch") {
+    std::vector<char> bytes;
+    encodeBatchIndex({}, {}, 3, bytes);
+    REQUIRE(bytes.size() == 1);
+    std::vector<EventIdentifier> readIDs(2);
+    std::vector<uint32_t> readOffsets(6);
+    decodeBatchIndex(bytes.data(), bytes.size(), 3, readIDs, readOffsets);
+    REQUIRE(readIDs.empty());
+    REQUIRE(readOffsets.empty());
+  }
+  SECTION("truncated") {
+    std::vector<char> bytes;
+    encodeBatchIndex({{1, 1, 1}}, {0, 300}, 2, bytes);
+    std::vector<EventIdentifier> readIDs;
+    std::vector<uint32_t> readOffsets;
+    REQUIRE_THROWS_AS(decodeBatchIndex(bytes.data(), bytes.size()-1, 2, readIDs, readOffsets), std::runtime_error);
+  }
+}
@@ -0,0 +1,24 @@
+#include "catch2/catch.hpp"
+#include <string>
+#include <vector>
+#include "crc32c.h"
+
+TEST_CASE("Test crc32c", "[crc32c]") {
+  using namespace cce::tf;
+  SECTION("known values") {
+    REQUIRE(crc32c(nullptr, 0) == 0);
+    std::string check("123456789");
+    REQUIRE(crc32c(check.data(), check.size()) == 0xE3069283);
+    std::vector<unsigned char> zeros(32, 0);
+    REQUIRE(crc32c(zeros.data(), zeros.size()) == 0x8A9136AA);
+  }
+  SECTION("detects a changed byte") {
+    std::vector<char> data(1000);
+    for(std::size_t i = 0; i < data.size(); ++i) {
+      data[i] = i*7;
+    }
+    auto const original = crc32c(data.data(), data.size());
+    data[997] ^= 1;
+    REQUIRE(crc32c(data.data(), data.size()) != original);
+  }
+}
@@ -2,24 +2,58 @@
 #include "TVirtualStreamerInfo.h"
 #include "TObject.h"
 #include <iostream>
+#include <fstream>
 #include <vector>
 #include <string>
 #include <atomic>
 #include <iomanip>
 #include <cmath>
+#include <optional>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "CLI11.hpp"
 
 #include "outputerFactoryGenerator.h"
 #include "sourceFactoryGenerator.h"
 #include "waiterFactoryGenerator.h"
+#include "TeeOutputer.h"
+#include "ProductNeeds.h"
 
 #include "Lane.h"
+#include "ClusterIndexClaimer.h"
+#include "RunReport.h"
+#include "Tracer.h"
+#include "PerfCounters.h"
+#include "MemoryUsage.h"
 #include "FunctorTask.h"
+#include "TaskHolder.h"
+#include "SerialTaskQueue.h"
+#include "pds_common.h"
+#include "pds_byte_source.h"
+#include "RootIMT.h"
+#include "StorageEmulator.h"
+#include "EmulatedTFile.h"
+#include "BlockCache.h"
+#include "CachedTFile.h"
+#include "jit_unrolling.h"
+#include "ElasticLaneController.h"
+#include "CPUAffinity.h"
+#include "ThreadPinner.h"
+#include "BenchmarkBaseline.h"
+#include "PipelineSpec.h"
+#include "ProductProfile.h"
+#if defined(TF_ENABLE_MPI)
+#include "MPIEventDistributor.h"
+#endif
 
 #include "tbb/task_group.h"
 #include "tbb/global_control.h"
 #include "tbb/task_arena.h"
+#include "tbb/info.h"
+#include "tbb/parallel_for.h"
 
 namespace {
   std::pair<std::string, std::string> parseCompound(std::string_view iArg) {
@@ -32,6 +66,469 @@ namespace {
     }
     return std::pair(sArg, std::string());
   }
+
+  //discards what is written to std::cout while it exists
+  class SilenceCout {
+  public:
+    SilenceCout(): old_{std::cout.rdbuf(nullptr)} {}
+    ~SilenceCout() {
+      std::cout.rdbuf(old_);
+      std::cout.clear();
+    }
+    SilenceCout(SilenceCout const&) = delete;
+    SilenceCout& operator=(SilenceCout const&) = delete;
+  private:
+    std::streambuf* old_;
+  };
+
+  struct Sample {
+    std::chrono::milliseconds time_;
+    double eventRate_;
+    unsigned long long residentBytes_;
+  };
+
+  //sets the flag once the duration has passed, a duration of 0 never sets it
+  class StopTimer {
+  public:
+    StopTimer(std::chrono::duration<double> iDuration, std::atomic<bool>& oStop) {
+      if(iDuration.count() > 0) {
+        thread_ = std::thread([this, iDuration, &oStop]() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if(not condition_.wait_for(lock, iDuration, [this]() { return cancelled_; })) {
+              oStop = true;
+            }
+          });
+      }
+    }
+    ~StopTimer() {
+      if(thread_.joinable()) {
+        {
+          std::lock_guard<std::mutex> guard(mutex_);
+          cancelled_ = true;
+        }
+        condition_.notify_one();
+        thread_.join();
+      }
+    }
+    StopTimer(StopTimer const&) = delete;
+    StopTimer& operator=(StopTimer const&) = delete;
+  private:
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool cancelled_ = false;
+    std::thread thread_;
+  };
+
+  //the Source must also provide the warm up events
+  unsigned long long sourceEventLimit(unsigned long long iNEvents, unsigned long long iWarmupEvents) {
+    if(iNEvents > std::numeric_limits<unsigned long long>::max() - iWarmupEvents) {
+      return std::numeric_limits<unsigned long long>::max();
+    }
+    return iNEvents + iWarmupEvents;
+  }
+
+  //the files of --evict-cache, dropped from the page cache right before each timed run
+  std::vector<std::string> s_filesToEvict;
+  void evictInputFiles() {
+    for(auto const& name: s_filesToEvict) {
+      cce::tf::pds::evictFromPageCache(name);
+    }
+  }
+
+  using namespace cce::tf;
+  using SourceFactory = std::function<std::unique_ptr<SharedSourceBase>(unsigned int, unsigned long long)>;
+  using OutputerFactory = std::function<std::unique_ptr<OutputerBase>(unsigned int)>;
+  using WaiterFactory = std::function<std::unique_ptr<WaiterBase>(unsigned int, size_t)>;
+
+  struct ScanStep {
+    int threads_;
+    unsigned int lanes_;
+    unsigned long long events_;
+    std::chrono::microseconds time_;
+    double eventRate() const { return time_.count() == 0 ? 0. : events_*1.e6/time_.count(); }
+  };
+
+  //The indices of the data products the Waiter and Outputers use, in the order they are used.
+  // Nothing if all data products are used, in the order of the Source.
+  std::optional<std::vector<unsigned int>> neededProductOrder(SharedSourceBase& iSource, WaiterBase const* iWaiter,
+                                                              std::initializer_list<OutputerBase const*> iOutputers) {
+    std::optional<ProductNeeds> needs;
+    auto add = [&needs](std::optional<ProductNeeds> const& iNeeds) {
+      if(not iNeeds) {
+        return;
+      }
+      if(needs) {
+        needs->add(*iNeeds);
+      } else {
+        needs = iNeeds;
+      }
+    };
+    if(iWaiter) {
+      add(iWaiter->neededProducts());
+    }
+    for(auto const* out: iOutputers) {
+      if(out) {
+        add(out->neededProducts());
+      }
+    }
+    if(not needs or needs->needsAll()) {
+      return {};
+    }
+    std::vector<std::string> names;
+    for(auto const& dp: iSource.dataProducts(0, 0)) {
+      names.push_back(dp.name());
+    }
+    return needs->order(names);
+  }
+
+  //processes the events with a newly made Source, Outputer and Waiter in an arena with iThreads threads
+  std::optional<ScanStep> runScanStep(int iThreads, unsigned int iLanes, unsigned int iPrefetchDepth, unsigned int iIndexChunkSize,
+                                      unsigned long long iNEvents, unsigned long long iWarmupEvents, std::chrono::duration<double> iDuration,
+                                      SourceFactory const& iSourceFactory,
+                                      OutputerFactory const& iOutFactory, WaiterFactory const& iWaiterFactory,
+                                      RunReport* oReport = nullptr) {
+    tbb::task_arena arena(iThreads);
+    unsigned int const nSourceLanes = iLanes*iPrefetchDepth;
+    auto out = iOutFactory(nSourceLanes);
+    auto source = iSourceFactory(nSourceLanes, sourceEventLimit(iNEvents, iWarmupEvents));
+    if(not out or not source) {
+      std::cout <<"failed to create the Source or Outputer for "<<iThreads<<" threads"<<std::endl;
+      return {};
+    }
+    std::unique_ptr<WaiterBase> waiter;
+    if(iWaiterFactory) {
+      waiter = iWaiterFactory(nSourceLanes, source->numberOfDataProducts());
+      if(not waiter) {
+        std::cout <<"failed to create the Waiter for "<<iThreads<<" threads"<<std::endl;
+        return {};
+      }
+    }
+    std::vector<Lane> lanes;
+    lanes.reserve(iLanes);
+    std::vector<tbb::task_group> groups(iLanes);
+    std::atomic<long> ievt{0};
+    std::atomic<bool> stop{false};
+    auto processEvents = [&]() {
+      for(unsigned int i = 0; i < iLanes; ++i) {
+        auto& lane = lanes[i];
+        auto& group = groups[i];
+        TaskHolder finalTask(group, make_functor_task([&group, task=group.defer([](){})]() mutable { group.run(std::move(task)); }));
+        group.run([&, ft=std::move(finalTask)]() {lane.processEventsAsync(ievt, group, *out, std::move(ft));});
+      }
+      for(auto& group: groups) {
+        group.wait();
+      }
+    };
+    auto start = std::chrono::high_resolution_clock::now();
+    arena.execute([&]() {
+        for(unsigned int i = 0; i< iLanes; ++i) {
+          lanes.emplace_back(i, source.get(), waiter.get(), iPrefetchDepth);
+          auto& lane = lanes.back();
+          lane.setIndexChunkSize(iIndexChunkSize);
+          lane.setStopFlag(&stop);
+          for(unsigned int slot = 0; slot < lane.numberOfSlots(); ++slot) {
+            out->setupForLane(lane.sourceLaneIndex(slot), lane.dataProducts(slot));
+          }
+        }
+        if(auto order = neededProductOrder(*source, waiter.get(), {out.get()})) {
+          source->setNeededProducts(*order);
+          for(auto& lane: lanes) {
+            lane.setNeededProducts(*order);
+          }
+        }
+        if(iWarmupEvents != 0) {
+          for(auto& lane: lanes) {
+            lane.setEndIndex(iWarmupEvents);
+          }
+          processEvents();
+          for(auto& lane: lanes) {
+            lane.setEndIndex(std::numeric_limits<long>::max());
+            lane.resetStatistics();
+          }
+          //the indices claimed beyond the end of the warm up were not used
+          ievt = iWarmupEvents;
+        }
+        evictInputFiles();
+        start = std::chrono::high_resolution_clock::now();
+        StopTimer timer(iDuration, stop);
+        processEvents();
+      });
+    auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now()-start);
+    unsigned long long nEventsProcessed = 0;
+    for(auto const& lane: lanes) {
+      nEventsProcessed += lane.numberOfEventsProcessed();
+    }
+    if(oReport) {
+      source->fillReport(oReport->section("source"));
+      out->fillReport(oReport->section("outputer"));
+    }
+    return ScanStep{iThreads, iLanes, nEventsProcessed, time};
+  }
+
+  //Runs each scenario iRepetitions times, alternating between the scenarios
+  // so slow drifts of the machine affect all of them alike. Besides the event
+  // rate the times, i.e. the '_us' values, the Source and Outputer report are
+  // kept per event.
+  std::optional<BenchmarkBaseline> runScenarios(std::vector<BenchmarkScenario> const& iScenarios, unsigned int iRepetitions,
+                                                unsigned int iPrefetchDepth, unsigned int iIndexChunkSize,
+                                                unsigned long long iNEvents, unsigned long long iWarmupEvents, std::chrono::duration<double> iDuration,
+                                                WaiterFactory const& iWaiterFactory) {
+    std::vector<std::pair<SourceFactory, OutputerFactory>> factories;
+    for(auto const& scenario: iScenarios) {
+      auto [sourceType, sourceOptions] = parseCompound(scenario.source_);
+      auto sourceFactory = sourceFactoryGenerator(sourceType, sourceOptions);
+      auto [outputType, outputInfo] = parseCompound(scenario.outputer_);
+      auto outFactory = outputerFactoryGenerator(outputType, outputInfo);
+      if(not sourceFactory or not outFactory) {
+        std::cout <<"unknown Source or Outputer type in scenario "<<scenario.name_<<std::endl;
+        return {};
+      }
+      factories.emplace_back(std::move(sourceFactory), std::move(outFactory));
+    }
+    BenchmarkBaseline samples;
+    for(unsigned int repetition = 0; repetition < iRepetitions; ++repetition) {
+      for(std::size_t i = 0; i < iScenarios.size(); ++i) {
+        auto const& scenario = iScenarios[i];
+        std::cout <<"scenario "<<scenario.name_<<" repetition "<<repetition+1<<" of "<<iRepetitions<<std::endl;
+        RunReport stages;
+        auto step = runScanStep(scenario.threads_, scenario.lanes_, iPrefetchDepth, iIndexChunkSize, iNEvents, iWarmupEvents, iDuration,
+                                factories[i].first, factories[i].second, iWaiterFactory, &stages);
+        if(not step) {
+          return {};
+        }
+        auto& s = samples[scenario.name_];
+        s.scenario_ = scenario;
+        s.metrics_[std::string(kEventRateMetric)].push_back(step->eventRate());
+        if(step->events_ == 0) {
+          continue;
+        }
+        for(auto const& [key, value]: stages.numbers()) {
+          if(key.size() > 3 and key.compare(key.size()-3, 3, "_us") == 0) {
+            s.metrics_[key].push_back(value/step->events_);
+          }
+        }
+      }
+    }
+    return samples;
+  }
+
+  struct PipelineResult {
+    std::string name_;
+    //the threads of the pipeline's own arena, 0 when the arena is shared
+    int threads_ = 0;
+    unsigned int lanes_;
+    unsigned long long events_;
+    std::chrono::microseconds time_;
+    double eventRate() const { return time_.count() == 0 ? 0. : events_*1.e6/time_.count(); }
+  };
+
+  //Runs the pipelines at the same time, each with its own Source, Outputer,
+  // Waiter, Lanes and event counter. A pipeline's time lasts until its last
+  // Lane finished. With iThreadsPerPipeline each pipeline runs in its own
+  // arena with that many threads, otherwise all Lanes share one arena of iThreads.
+  std::optional<std::vector<PipelineResult>> runPipelines(std::vector<PipelineSpec> const& iSpecs, int iThreads, std::vector<int> const& iThreadsPerPipeline,
+                                                          unsigned int iPrefetchDepth, unsigned int iIndexChunkSize,
+                                                          unsigned long long iNEvents, unsigned long long iWarmupEvents, std::chrono::duration<double> iDuration,
+                                                          RunReport* oReport = nullptr) {
+    using TimePoint = decltype(std::chrono::high_resolution_clock::now());
+    struct Pipeline {
+      std::unique_ptr<SharedSourceBase> source_;
+      std::unique_ptr<OutputerBase> out_;
+      std::unique_ptr<WaiterBase> waiter_;
+      tbb::task_arena* arena_ = nullptr;
+      std::vector<Lane> lanes_;
+      std::vector<tbb::task_group> groups_;
+      std::vector<TimePoint> laneFinished_;
+      std::atomic<long> ievt_{0};
+    };
+
+    std::vector<std::unique_ptr<tbb::task_arena>> arenas;
+    if(iThreadsPerPipeline.empty()) {
+      arenas.push_back(std::make_unique<tbb::task_arena>(iThreads));
+    } else {
+      for(auto threads: iThreadsPerPipeline) {
+        arenas.push_back(std::make_unique<tbb::task_arena>(threads));
+      }
+    }
+    std::atomic<bool> stop{false};
+    std::vector<std::unique_ptr<Pipeline>> pipelines;
+    for(std::size_t p = 0; p < iSpecs.size(); ++p) {
+      auto const& spec = iSpecs[p];
+      auto [sourceType, sourceOptions] = parseCompound(spec.source_);
+      auto sourceFactory = sourceFactoryGenerator(sourceType, sourceOptions);
+      auto [outputType, outputInfo] = parseCompound(spec.outputer_);
+      auto outFactory = outputerFactoryGenerator(outputType, outputInfo);
+      WaiterFactory waiterFactory;
+      if(not spec.waiter_.empty()) {
+        auto [waiterType, waiterOptions] = parseCompound(spec.waiter_);
+        waiterFactory = waiterFactoryGenerator(waiterType, waiterOptions);
+        if(not waiterFactory) {
+          std::cout <<"unknown waiter type "<<waiterType<<" in pipeline "<<spec.name_<<std::endl;
+          return {};
+        }
+      }
+      if(not sourceFactory or not outFactory) {
+        std::cout <<"unknown Source or Outputer type in pipeline "<<spec.name_<<std::endl;
+        return {};
+      }
+      auto pipeline = std::make_unique<Pipeline>();
+      unsigned int const nSourceLanes = spec.lanes_*iPrefetchDepth;
+      pipeline->out_ = outFactory(nSourceLanes);
+      pipeline->source_ = sourceFactory(nSourceLanes, sourceEventLimit(iNEvents, iWarmupEvents));
+      if(not pipeline->out_ or not pipeline->source_) {
+        std::cout <<"failed to create the Source or Outputer of pipeline "<<spec.name_<<std::endl;
+        return {};
+      }
+      if(waiterFactory) {
+        pipeline->waiter_ = waiterFactory(nSourceLanes, pipeline->source_->numberOfDataProducts());
+        if(not pipeline->waiter_) {
+          std::cout <<"failed to create the Waiter of pipeline "<<spec.name_<<std::endl;
+          return {};
+        }
+      }
+      pipeline->arena_ = arenas[iThreadsPerPipeline.empty() ? 0 : p].get();
+      pipeline->groups_ = std::vector<tbb::task_group>(spec.lanes_);
+      pipeline->laneFinished_.resize(spec.lanes_);
+      auto& pl = *pipeline;
+      pl.arena_->execute([&pl, &stop, &spec, iPrefetchDepth, iIndexChunkSize]() {
+          pl.lanes_.reserve(spec.lanes_);
+          for(unsigned int i = 0; i< spec.lanes_; ++i) {
+            pl.lanes_.emplace_back(i, pl.source_.get(), pl.waiter_.get(), iPrefetchDepth);
+            auto& lane = pl.lanes_.back();
+            lane.setIndexChunkSize(iIndexChunkSize);
+            lane.setStopFlag(&stop);
+            for(unsigned int slot = 0; slot < lane.numberOfSlots(); ++slot) {
+              pl.out_->setupForLane(lane.sourceLaneIndex(slot), lane.dataProducts(slot));
+            }
+          }
+          if(auto order = neededProductOrder(*pl.source_, pl.waiter_.get(), {pl.out_.get()})) {
+            pl.source_->setNeededProducts(*order);
+            for(auto& lane: pl.lanes_) {
+              lane.setNeededProducts(*order);
+            }
+          }
+        });
+      pipelines.push_back(std::move(pipeline));
+    }
+
+    //all pipelines are started before any is waited for
+    auto processEvents = [&pipelines]() {
+      for(auto& pipeline: pipelines) {
+        auto& pl = *pipeline;
+        pl.arena_->execute([&pl]() {
+            for(unsigned int i = 0; i < pl.lanes_.size(); ++i) {
+              auto& lane = pl.lanes_[i];
+              auto& group = pl.groups_[i];
+              TaskHolder finalTask(group, make_functor_task([&group, &finished = pl.laneFinished_[i], task=group.defer([](){})]() mutable {
+                    finished = std::chrono::high_resolution_clock::now();
+                    group.run(std::move(task)); }));
+              group.run([&, ft=std::move(finalTask)]() {lane.processEventsAsync(pl.ievt_, group, *pl.out_, std::move(ft));});
+            }
+          });
+      }
+      for(auto& pipeline: pipelines) {
+        for(auto& group: pipeline->groups_) {
+          pipeline->arena_->execute([&group]() { group.wait(); });
+        }
+      }
+    };
+
+    if(iWarmupEvents != 0) {
+      for(auto& pipeline: pipelines) {
+        for(auto& lane: pipeline->lanes_) {
+          lane.setEndIndex(iWarmupEvents);
+        }
+      }
+      processEvents();
+      for(auto& pipeline: pipelines) {
+        for(auto& lane: pipeline->lanes_) {
+          lane.setEndIndex(std::numeric_limits<long>::max());
+          lane.resetStatistics();
+        }
+        //the indices claimed beyond the end of the warm up were not used
+        pipeline->ievt_ = iWarmupEvents;
+      }
+    }
+    evictInputFiles();
+    auto const start = std::chrono::high_resolution_clock::now();
+    {
+      StopTimer timer(iDuration, stop);
+      processEvents();
+    }
+
+    std::vector<PipelineResult> results;
+    for(std::size_t p = 0; p < pipelines.size(); ++p) {
+      auto const& pl = *pipelines[p];
+      auto const finished = *std::max_element(pl.laneFinished_.begin(), pl.laneFinished_.end());
+      unsigned long long nEventsProcessed = 0;
+      for(auto const& lane: pl.lanes_) {
+        nEventsProcessed += lane.numberOfEventsProcessed();
+      }
+      results.push_back({iSpecs[p].name_, iThreadsPerPipeline.empty() ? 0 : iThreadsPerPipeline[p], iSpecs[p].lanes_, nEventsProcessed,
+                         std::chrono::duration_cast<std::chrono::microseconds>(finished-start)});
+      if(oReport) {
+        auto& section = oReport->section(iSpecs[p].name_);
+        pl.source_->fillReport(section.section("source"));
+        pl.out_->fillReport(section.section("outputer"));
+      }
+    }
+    return results;
+  }
+
+  void printPipelines(std::vector<PipelineResult> const& iResults) {
+    std::cout <<"----------\n"
+              <<"        pipeline threads   lanes      events     time(us)     events/s\n";
+    for(auto const& result: iResults) {
+      std::cout <<std::setw(16)<<result.name_<<std::setw(8)<<(result.threads_ == 0 ? std::string("shared") : std::to_string(result.threads_))
+                <<std::setw(8)<<result.lanes_<<std::setw(12)<<result.events_
+                <<std::setw(13)<<result.time_.count()<<std::setw(13)<<std::lround(result.eventRate())<<"\n";
+    }
+    std::cout <<"----------"<<std::endl;
+  }
+
+  void reportPipelines(RunReport& oReport, std::vector<PipelineResult> const& iResults) {
+    for(auto const& result: iResults) {
+      auto& section = oReport.section(result.name_);
+      section.set("threads", result.threads_);
+      section.set("lanes", result.lanes_);
+      section.set("events", result.events_);
+      section.set("time_us", result.time_.count());
+      section.set("eventRate", result.eventRate());
+    }
+  }
+
+  //the speedup and efficiency are relative to the first step
+  void printScan(std::vector<ScanStep> const& iSteps) {
+    std::cout <<"----------\n"
+              <<" threads   lanes      events     time(us)     events/s  speedup  efficiency\n";
+    for(auto const& step: iSteps) {
+      double speedup = iSteps[0].eventRate() == 0. ? 0. : step.eventRate()/iSteps[0].eventRate();
+      double efficiency = speedup*iSteps[0].threads_/step.threads_;
+      std::cout <<std::setw(8)<<step.threads_<<std::setw(8)<<step.lanes_<<std::setw(12)<<step.events_
+                <<std::setw(13)<<step.time_.count()<<std::setw(13)<<std::lround(step.eventRate())
+                <<std::setw(9)<<std::lround(speedup*100)/100.<<std::setw(12)<<std::lround(efficiency*100)/100.<<"\n";
+    }
+    std::cout <<"----------"<<std::endl;
+  }
+
+  void reportScan(RunReport& oReport, std::vector<ScanStep> const& iSteps) {
+    std::vector<double> threads, lanes, events, rates, speedups, efficiencies;
+    for(auto const& step: iSteps) {
+      double speedup = iSteps[0].eventRate() == 0. ? 0. : step.eventRate()/iSteps[0].eventRate();
+      threads.push_back(step.threads_);
+      lanes.push_back(step.lanes_);
+      events.push_back(step.events_);
+      rates.push_back(step.eventRate());
+      speedups.push_back(speedup);
+      efficiencies.push_back(speedup*iSteps[0].threads_/step.threads_);
+    }
+    oReport.set("threads", threads);
+    oReport.set("lanes", lanes);
+    oReport.set("events", events);
+    oReport.set("eventRate", rates);
+    oReport.set("speedup", speedups);
+    oReport.set("efficiency", efficiencies);
+  }
 }
 
 int main(int argc, char* argv[]) {
@@ -39,7 +536,7 @@ int main(int argc, char* argv[]) {
   CLI::App app{"test different I/O systems under threading"};
 
   std::string sourceConfig;
-  app.add_option("-s,--source",sourceConfig,"configure Source")->required();
+  app.add_option("-s,--source",sourceConfig,"configure Source. Required unless --scenarios is given.");
   
   int parallelism = tbb::this_task_arena::max_concurrency();
   app.add_option("-t,--num-threads", parallelism, "number of threads to use.\nDefault is all cores on the machine.");
@@ -47,25 +544,322 @@ int main(int argc, char* argv[]) {
   bool useIMT = false;
   app.add_option("--use-IMT", useIMT, "Use ROOT's Implicit MultiThreading.\nDefault is false.");
 
+  std::string imtScopeName = "all";
+  app.add_option("--IMT-scope", imtScopeName, "With --use-IMT, which components have ROOT use IMT: 'all', 'sources' (e.g. parallel unzipping) or 'outputers' (e.g. compressing baskets in parallel).\nDefault is 'all'.");
+
   unsigned int nLanes = parallelism;
   app.add_option("-l,--num-lanes", nLanes, "Number of concurrently processing event Lanes.\nDefault is number of threads.");
 
   unsigned long long nEvents = std::numeric_limits<unsigned long long>::max();
   app.add_option("-n,--num-events", nEvents, "Number of events to process.\nDefault is max value.");
 
-  std::string outputerConfig="DummyOutputer";
-  app.add_option("-o,--outputer", outputerConfig, "configure Outputer.\nDefault is 'DummyOutputer'.");
+  std::vector<std::string> outputerConfigs{"DummyOutputer"};
+  app.add_option("-o,--outputer", outputerConfigs, "configure Outputer. If given more than once, each event is given to all the Outputers.\nDefault is 'DummyOutputer'.");
 
   std::string waiterConfig;
   app.add_option("-w,--waiter", waiterConfig, "configure Waiter.\nDefault is no waiter denoted by ''.");
 
+  unsigned int indexChunkSize = 1;
+  app.add_option("--index-chunk", indexChunkSize, "Number of consecutive event indices a Lane claims at one time.\nDefault is 1.")->check(CLI::PositiveNumber);
+  unsigned int clusterClaim = 0;
+  app.add_option("--cluster-claim", clusterClaim, "A Lane claims consecutive events of one cluster of the Source (e.g. the baskets of a TTree), up to this many or --index-chunk if larger, so it keeps reading from the cluster it already has at hand.\nDefault is 0 which claims without regard to clusters.");
+
+  bool useNUMA = false;
+  app.add_flag("--numa", useNUMA, "Partition Lanes across NUMA nodes with one task arena per node.");
+  std::string affinity;
+  app.add_option("--affinity", affinity, "Pin each thread running tasks to one CPU: 'compact' fills the SMT siblings of a core first, 'scatter' spreads over cores and packages first, or a list of CPUs, e.g. '0-7,16'.\nDefault is no pinning denoted by ''.");
+  std::string ioCores;
+  app.add_option("--io-cores", ioCores, "Bind the dedicated threads of read ahead, write behind and timed waits to these CPUs, e.g. '30-31'.\nDefault is no binding denoted by ''.");
+
+  unsigned int activeLanes = 0;
+  app.add_option("--active-lanes", activeLanes, "Most Lanes processing an event at one time. The other Lanes only have their events read until a Lane finishes its event.\nDefault is 0, i.e. no limit.");
+  std::string elasticLanes;
+  app.add_option("--elastic-lanes", elasticLanes, "Start with a few active Lanes and add or remove active Lanes while running, up to the number of Lanes, following the event rate. e.g. 'min=2:step=1:interval_ms=1000:gain=0.05:maxRSS_MB=8000:probe=10'.\nDefault is a fixed number of Lanes denoted by ''.");
+
+  bool drainFirst = false;
+  app.add_flag("--drain-first", drainFirst, "Start the reads of new events in a low priority task arena so threads finish the events already read before reading more.");
+
+  bool coroutineLanes = false;
+#if defined(TF_ENABLE_COROUTINES)
+  app.add_flag("--coroutine-lanes", coroutineLanes, "Run each Lane's event loop as a coroutine. Can not be used with --prefetch-depth > 1 or --drain-first.");
+#endif
+
+  unsigned int prefetchDepth = 1;
+  app.add_option("--prefetch-depth", prefetchDepth, "Number of events each Lane can have read from the Source at one time.\nDefault is 1, i.e. no read-ahead.")->check(CLI::PositiveNumber);
+
+  bool batchEvents = false;
+  app.add_flag("--batch-events", batchEvents, "Each Lane reads its --prefetch-depth events with one request to the Source and gives them to the Outputer together.");
+
+  bool inlineContinuations = false;
+  app.add_flag("--inline-continuations", inlineContinuations, "When a task makes the next task of the same Lane ready, run that task on the same thread once the first returns instead of handing it to the scheduler.");
+
+  unsigned int sampleInterval = 0;
+  app.add_option("--sample-interval", sampleInterval, "Every this many ms record the event rate and memory use for a timeline in the summary.\nDefault is 0, i.e. no sampling.");
+
+  std::string traceFile;
+  app.add_option("--trace", traceFile, "Write the start and end of the tasks run during event processing to this file in the Chrome trace format.\nDefault is no tracing denoted by ''.");
+  bool queueTiming = false;
+  app.add_flag("--queue-timing", queueTiming, "Measure the wait and run time of the tasks of the serial queues of the Sources and Outputers. Always done with --trace.");
+
+  bool usePerfCounters = false;
+  app.add_flag("--perf-counters", usePerfCounters, "Count CPU cycles, instructions and cache misses for the read, decompress, deserialize, serialize and compress stages.");
+  bool useHugePages = false;
+  app.add_flag("--huge-pages", useHugePages, "Back the reused decompression buffers of at least 2MB with huge pages which are faulted in when the buffer is allocated.");
+  bool jitUnrolled = false;
+  app.add_flag("--jit-unrolled", jitUnrolled, "Have the Unrolled and NativeUnrolled serializers and deserializers stream with code cling compiles for each class from its streamer actions. The bytes are unchanged.");
+  bool directIO = false;
+  app.add_flag("--direct-io", directIO, "Read local PDS files with O_DIRECT so the reads bypass the page cache.");
+  std::vector<std::string> evictCache;
+  app.add_option("--evict-cache", evictCache, "Comma separated files to drop from the page cache after the warm up, right before the timed event processing, so they are read from the storage.\nDefault is none.")->delimiter(',');
+
+  double duration = 0;
+  app.add_option("--duration", duration, "Stop starting new events once this many seconds of event processing have passed.\nDefault is 0, i.e. no time limit.")->check(CLI::NonNegativeNumber);
+
+  unsigned long long warmupEvents = 0;
+  app.add_option("--warmup-events", warmupEvents, "Number of events to process with all the Lanes before the timing starts.\nDefault is 0 which only processes 1 event with a separate Source and Outputer.");
+
+  bool discardWarmup = false;
+  app.add_flag("--discard-warmup", discardWarmup, "Give the warm up events to an in memory SerializeOutputer so they are not written. Without --warmup-events, 1 event is used instead of making a separate Source and Outputer.");
+
+  std::vector<int> scanThreads;
+  app.add_option("--scan-threads", scanThreads, "Comma separated numbers of threads. Each is run in turn within this job, with the number of Lanes equal to the number of threads unless -l is given, and a table of the event rates is printed.")->delimiter(',')->check(CLI::PositiveNumber);
+
+  std::vector<std::string> pipelineConfigs;
+  app.add_option("--pipeline", pipelineConfigs, "Run a pipeline, '<name> <Source configuration> <Outputer configuration> [<# lanes> [<Waiter configuration>]]', at the same time as the other pipelines given. Each has its own Lanes and event counter, -n applies to each and a table of their event rates is printed. Used in place of -s, -o and -w.\nDefault is the one pipeline of -s, -o and -w.");
+  bool partitionPipelineThreads = false;
+  app.add_flag("--partition-threads", partitionPipelineThreads, "With --pipeline, give each pipeline its own task arena with a share of the threads in proportion to its Lanes instead of all Lanes sharing one task arena.");
+
+  std::string storageEmulation;
+  app.add_option("--emulate-storage", storageEmulation, "Delay the reads and writes of PDS files, and of ROOT files opened as emulate:<file>, as remote storage would. e.g. 'latency_us=2000:bandwidth_MBps=100:concurrency=8'.\nDefault is no emulation denoted by ''.");
+  std::string blockCacheConfig;
+  app.add_option("--block-cache", blockCacheConfig, "Keep the blocks read from remote PDS files, and from ROOT files opened as cache:<file>, in files on a local disk so reading them again does not go to the remote storage. With --emulate-storage all PDS files count as remote. e.g. 'dir=/nvme/cache:size_MB=4096:block_kB=1024:shards=16'.\nDefault is no cache denoted by ''.");
+
+  std::string scenarioFile;
+  app.add_option("--scenarios", scenarioFile, "File with one benchmark scenario per line: '<name> <# threads> <Source configuration> <Outputer configuration> [<# lanes>]'. Used with --save-baseline or --compare-baseline in place of -s, -o and -t.\nDefault is one scenario per --scan-threads, or -t, value with the -s and -o of the job.");
+  unsigned int repetitions = 3;
+  app.add_option("--repetitions", repetitions, "Number of times each benchmark scenario is run for --save-baseline or --compare-baseline.\nDefault is 3.")->check(CLI::PositiveNumber);
+  std::string saveBaseline;
+  app.add_option("--save-baseline", saveBaseline, "Run the benchmark scenarios and write their event rates and stage times to this JSON file.\nDefault is not to denoted by ''.");
+  std::string compareBaseline;
+  app.add_option("--compare-baseline", compareBaseline, "Run the benchmark scenarios and compare them to those stored in this file by --save-baseline. The job fails if any got significantly worse.\nDefault is not to denoted by ''.");
+  double regressionThreshold = 0.05;
+  app.add_option("--regression-threshold", regressionThreshold, "Smallest relative change of a benchmark metric which counts as a regression.\nDefault is 0.05.")->check(CLI::NonNegativeNumber);
+
+  std::string reportFile;
+  app.add_option("--report", reportFile, "Write the job's summary as JSON to this file.\nDefault is no report denoted by ''.");
+
+  std::string writeProfile;
+  app.add_option("--write-profile", writeProfile, "Write the serialized sizes and serialization times of each data product the Outputers measured to this file for --use-profile of a later job.\nDefault is no profile denoted by ''.");
+  std::string useProfile;
+  app.add_option("--use-profile", useProfile, "Size the serialization buffers of each data product from a file written by --write-profile and know from the first event which data products coalesceBytes applies to.\nDefault is no profile denoted by ''.");
+
+#if defined(TF_ENABLE_MPI)
+  bool useMPI = false;
+  long mpiBatch = 0;
+  app.add_flag("--mpi", useMPI, "Share the event indices among the MPI ranks of the job. Each rank runs its own Lanes, Source and Outputer and rank 0 prints the summary.");
+  app.add_option("--mpi-batch", mpiBatch, "Number of event indices a rank takes at one time from the counter shared by the ranks. Rounded up to a multiple of the indices a Lane claims.\nDefault is 0 which uses 4 times the number of Lanes times --index-chunk.")->check(CLI::NonNegativeNumber);
+#endif
+
   CLI11_PARSE(app, argc, argv);
 
+#if defined(TF_ENABLE_MPI)
+  std::unique_ptr<MPISession> mpi;
+  if(useMPI) {
+    if(not scanThreads.empty()) {
+      std::cout <<"--mpi can not be used with --scan-threads"<<std::endl;
+      return 1;
+    }
+    if(clusterClaim != 0) {
+      std::cout <<"--mpi can not be used with --cluster-claim"<<std::endl;
+      return 1;
+    }
+    if(not pipelineConfigs.empty()) {
+      std::cout <<"--mpi can not be used with --pipeline"<<std::endl;
+      return 1;
+    }
+    if(not saveBaseline.empty() or not compareBaseline.empty()) {
+      std::cout <<"--mpi can not be used with --save-baseline or --compare-baseline"<<std::endl;
+      return 1;
+    }
+    mpi = std::make_unique<MPISession>(argc, argv);
+  }
+#endif
+
+  //must be set before any Source makes its buffers
+  pds::setUseHugePages(useHugePages);
+  //must be set before any serializer or deserializer is made
+  unrolling::setUseJit(jitUnrolled);
+  //must be set before any task is run
+  TaskHolder::setInlineContinuations(inlineContinuations);
+  //must be set before any task is pushed to a queue
+  if(queueTiming or not traceFile.empty()) {
+    SerialTaskQueue::enableTiming();
+  }
+  //must be set before any serializer is made
+  if(not useProfile.empty()) {
+    std::ifstream file(useProfile);
+    if(not file) {
+      std::cout <<"unable to open profile "<<useProfile<<std::endl;
+      return 1;
+    }
+    auto profile = ProductProfile::read(file);
+    if(not profile) {
+      return 1;
+    }
+    std::cout <<"data products in profile: "<<profile->entries().size()<<std::endl;
+    setSerializationProfile(std::move(*profile));
+  }
+
+  //must be set before any file is opened
+  pds::setDirectIO(directIO);
+  s_filesToEvict = evictCache;
+  std::string evictedFiles;
+  for(auto const& name: evictCache) {
+    evictedFiles += (evictedFiles.empty() ? "" : ",") + name;
+  }
+  if(not storageEmulation.empty()) {
+    auto emulatorConfig = parseStorageEmulatorConfig(storageEmulation);
+    if(not emulatorConfig) {
+      return 1;
+    }
+    setStorageEmulator(std::make_unique<StorageEmulator>(*emulatorConfig));
+    registerEmulatedTFile();
+  }
+  if(not blockCacheConfig.empty()) {
+    auto cacheConfig = parseBlockCacheConfig(blockCacheConfig);
+    if(not cacheConfig) {
+      return 1;
+    }
+    try {
+      setBlockCache(std::make_unique<BlockCache>(*cacheConfig));
+    } catch(std::exception const& e) {
+      std::cout <<e.what()<<std::endl;
+      return 1;
+    }
+    registerCachedTFile();
+  }
+
+  //must exist before any thread joins a task arena
+  std::optional<ThreadPinner> threadPinner;
+  if(not affinity.empty()) {
+    if(useNUMA) {
+      std::cout <<"--affinity can not be used with --numa"<<std::endl;
+      return 1;
+    }
+    auto affinityConfig = parseAffinityConfig(affinity);
+    if(not affinityConfig) {
+      return 1;
+    }
+    auto cpus = orderCPUs(allowedCPUs(), *affinityConfig);
+    if(cpus.empty()) {
+      std::cout <<"none of the CPUs of --affinity "<<affinity<<" can be used by the job"<<std::endl;
+      return 1;
+    }
+    threadPinner.emplace(std::move(cpus));
+  }
+  if(not ioCores.empty()) {
+    auto cpus = parseCPUList(ioCores);
+    if(not cpus) {
+      std::cout <<"--io-cores "<<ioCores<<" is not a list of CPUs, e.g. 30-31"<<std::endl;
+      return 1;
+    }
+    setDedicatedThreadCPUs(std::move(*cpus));
+  }
+
+  bool const lanesGiven = app.count("--num-lanes") != 0;
+  bool const runBenchmark = not saveBaseline.empty() or not compareBaseline.empty();
+  std::vector<BenchmarkScenario> scenarios;
+  if(runBenchmark) {
+    if(not scenarioFile.empty()) {
+      std::ifstream file(scenarioFile);
+      auto read = readScenarios(file);
+      if(not file.is_open() or not read or read->empty()) {
+        std::cout <<"no benchmark scenarios found in "<<scenarioFile<<std::endl;
+        return 1;
+      }
+      scenarios = std::move(*read);
+    } else {
+      if(outputerConfigs.size() != 1) {
+        std::cout <<"give the benchmark scenarios with more than one Outputer using --scenarios"<<std::endl;
+        return 1;
+      }
+      std::vector<int> threads = scanThreads.empty() ? std::vector<int>{parallelism} : scanThreads;
+      for(auto t: threads) {
+        scenarios.push_back({"t"+std::to_string(t), sourceConfig, outputerConfigs[0], t, lanesGiven ? nLanes : static_cast<unsigned int>(t)});
+      }
+    }
+    for(auto const& scenario: scenarios) {
+      parallelism = std::max(parallelism, scenario.threads_);
+    }
+  } else if(not scenarioFile.empty()) {
+    std::cout <<"--scenarios requires --save-baseline or --compare-baseline"<<std::endl;
+    return 1;
+  }
+  std::vector<PipelineSpec> pipelines;
+  for(auto const& config: pipelineConfigs) {
+    auto spec = parsePipelineSpec(config);
+    if(not spec) {
+      return 1;
+    }
+    if(spec->lanes_ == 0) {
+      spec->lanes_ = nLanes;
+    }
+    for(auto const& p: pipelines) {
+      if(p.name_ == spec->name_) {
+        std::cout <<"pipeline "<<spec->name_<<" is given more than once"<<std::endl;
+        return 1;
+      }
+    }
+    pipelines.push_back(std::move(*spec));
+  }
+  if(not writeProfile.empty() and (not pipelines.empty() or runBenchmark or not scanThreads.empty())) {
+    std::cout <<"--write-profile can not be used with --pipeline, --scan-threads, --save-baseline or --compare-baseline"<<std::endl;
+    return 1;
+  }
+  if((not traceFile.empty() or usePerfCounters or sampleInterval != 0) and (not pipelines.empty() or not scanThreads.empty() or runBenchmark)) {
+    std::cout <<"--trace, --perf-counters and --sample-interval can not be used with --pipeline, --scan-threads, --save-baseline or --compare-baseline"<<std::endl;
+    return 1;
+  }
+  if(not scanThreads.empty() and (useNUMA or activeLanes != 0 or not elasticLanes.empty() or drainFirst or coroutineLanes or batchEvents or clusterClaim != 0 or discardWarmup)) {
+    std::cout <<"--scan-threads can not be used with --numa, --active-lanes, --elastic-lanes, --drain-first, --coroutine-lanes, --batch-events, --cluster-claim or --discard-warmup"<<std::endl;
+    return 1;
+  }
+  if(runBenchmark and (useNUMA or activeLanes != 0 or not elasticLanes.empty() or drainFirst or coroutineLanes or batchEvents or clusterClaim != 0 or discardWarmup)) {
+    std::cout <<"--save-baseline and --compare-baseline can not be used with --numa, --active-lanes, --elastic-lanes, --drain-first, --coroutine-lanes, --batch-events, --cluster-claim or --discard-warmup"<<std::endl;
+    return 1;
+  }
+  if(not pipelines.empty()) {
+    if(app.count("--source") != 0 or app.count("--outputer") != 0 or app.count("--waiter") != 0 or runBenchmark or not scanThreads.empty()) {
+      std::cout <<"--pipeline can not be used with -s, -o, -w, --scan-threads, --save-baseline or --compare-baseline"<<std::endl;
+      return 1;
+    }
+    if(useNUMA or activeLanes != 0 or not elasticLanes.empty() or drainFirst or coroutineLanes or batchEvents or clusterClaim != 0 or discardWarmup) {
+      std::cout <<"--pipeline can not be used with --numa, --active-lanes, --elastic-lanes, --drain-first, --coroutine-lanes, --batch-events, --cluster-claim or --discard-warmup"<<std::endl;
+      return 1;
+    }
+  } else if(partitionPipelineThreads) {
+    std::cout <<"--partition-threads requires --pipeline"<<std::endl;
+    return 1;
+  }
+  if(sourceConfig.empty() and pipelines.empty() and (scenarioFile.empty() or not runBenchmark)) {
+    std::cout <<"a Source must be given with -s"<<std::endl;
+    return 1;
+  }
+  if(not scanThreads.empty()) {
+    //the arena of each step limits its own number of threads
+    parallelism = std::max(parallelism, *std::max_element(scanThreads.begin(), scanThreads.end()));
+  }
+
   tbb::global_control c(tbb::global_control::max_allowed_parallelism, parallelism);
 
   //Tell Root we want to be multi-threaded
+  auto imtScope = toIMTScope(imtScopeName);
+  if(not imtScope) {
+    std::cout <<"unknown --IMT-scope "<<imtScopeName<<std::endl;
+    return 1;
+  }
   if(useIMT) {
-    ROOT::EnableImplicitMT(parallelism);
+    enableRootIMT(parallelism, *imtScope);
   } else {
     ROOT::EnableThreadSafety();
   }
@@ -75,15 +869,142 @@ int main(int argc, char* argv[]) {
   //Have to avoid having Streamers modify themselves after they have been used
   TVirtualStreamerInfo::Optimize(false);
 
+  if(not pipelines.empty()) {
+    std::vector<int> threadsPerPipeline;
+    if(partitionPipelineThreads) {
+      std::vector<unsigned int> lanes;
+      for(auto const& p: pipelines) {
+        lanes.push_back(p.lanes_);
+      }
+      threadsPerPipeline = partitionThreads(parallelism, lanes);
+    }
+    RunReport report;
+    auto results = runPipelines(pipelines, parallelism, threadsPerPipeline, prefetchDepth, indexChunkSize, nEvents, warmupEvents,
+                                std::chrono::duration<double>(duration), reportFile.empty() ? nullptr : &report.section("pipelines"));
+    if(not results) {
+      return 1;
+    }
+    std::cout <<"----------\n";
+    for(auto const& p: pipelines) {
+      std::cout <<"Pipeline "<<p.name_<<": Source "<<p.source_<<" Outputer "<<p.outputer_<<" Waiter "<<p.waiter_<<"\n";
+    }
+    std::cout <<"# threads "<<parallelism<<(partitionPipelineThreads ? " partitioned" : " shared")<<"\n"
+              <<"allocator "<<allocatorName()<<"\n";
+    printPipelines(*results);
+    if(not reportFile.empty()) {
+      auto& job = report.section("job");
+      job.set("threads", parallelism);
+      job.set("partitionThreads", partitionPipelineThreads);
+      job.set("prefetchDepth", prefetchDepth);
+      job.set("indexChunkSize", indexChunkSize);
+      job.set("warmupEvents", warmupEvents);
+      job.set("allocator", allocatorName());
+      reportPipelines(report.section("pipelines"), *results);
+      std::ofstream file(reportFile);
+      report.write(file);
+      file <<"\n";
+      if(not file) {
+        std::cout <<"failed to write report "<<reportFile<<std::endl;
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  if(runBenchmark) {
+    decltype(waiterFactoryGenerator(waiterConfig, waiterConfig)) benchmarkWaiterFactory;
+    if(not waiterConfig.empty()) {
+      auto [type, options] = parseCompound(waiterConfig);
+      benchmarkWaiterFactory = waiterFactoryGenerator(type, options);
+      if(not benchmarkWaiterFactory) {
+        std::cout <<"unknown waiter type "<<type<<std::endl;
+        return 1;
+      }
+    }
+    std::optional<BenchmarkBaseline> baseline;
+    if(not compareBaseline.empty()) {
+      std::ifstream file(compareBaseline);
+      if(not file) {
+        std::cout <<"unable to open baseline "<<compareBaseline<<std::endl;
+        return 1;
+      }
+      baseline = readBaseline(file);
+      if(not baseline) {
+        return 1;
+      }
+    }
+    auto samples = runScenarios(scenarios, repetitions, prefetchDepth, indexChunkSize, nEvents, warmupEvents,
+                                std::chrono::duration<double>(duration), benchmarkWaiterFactory);
+    if(not samples) {
+      return 1;
+    }
+    RunReport current;
+    fillBaseline(current, *samples);
+    if(not saveBaseline.empty()) {
+      std::ofstream file(saveBaseline);
+      current.write(file);
+      file <<"\n";
+      if(not file) {
+        std::cout <<"failed to write baseline "<<saveBaseline<<std::endl;
+        return 1;
+      }
+    }
+    std::vector<MetricComparison> comparisons;
+    if(baseline) {
+      for(auto const& scenario: scenarios) {
+        if(baseline->find(scenario.name_) == baseline->end()) {
+          std::cout <<"scenario "<<scenario.name_<<" is not in the baseline"<<std::endl;
+        }
+      }
+      comparisons = compareBaselines(*baseline, *samples, regressionThreshold);
+      printComparisons(comparisons);
+    }
+    if(not reportFile.empty()) {
+      RunReport report;
+      auto& job = report.section("job");
+      job.set("repetitions", repetitions);
+      job.set("regressionThreshold", regressionThreshold);
+      job.set("allocator", allocatorName());
+      fillBaseline(report.section("benchmark"), *samples);
+      if(baseline) {
+        fillComparisonReport(report.section("baselineComparison"), comparisons);
+      }
+      std::ofstream file(reportFile);
+      report.write(file);
+      file <<"\n";
+    }
+    bool const regressed = std::any_of(comparisons.begin(), comparisons.end(), [](auto const& c) { return c.regression_; });
+    return regressed ? 1 : 0;
+  }
+
   std::vector<Lane> lanes;
 
+  std::string outputerConfig;
   std::function<std::unique_ptr<OutputerBase>(unsigned int)> outFactory;
   {
-    auto [outputType, outputInfo] = parseCompound(outputerConfig);
-    outFactory = outputerFactoryGenerator(outputType, outputInfo);
-    if(not outFactory) {
-      std::cout <<"unknown output type "<<outputType<<std::endl;
-      return 1;
+    std::vector<std::function<std::unique_ptr<OutputerBase>(unsigned int)>> factories;
+    for(auto const& config: outputerConfigs) {
+      auto [outputType, outputInfo] = parseCompound(config);
+      factories.push_back(outputerFactoryGenerator(outputType, outputInfo));
+      if(not factories.back()) {
+        std::cout <<"unknown output type "<<outputType<<std::endl;
+        return 1;
+      }
+      outputerConfig += (outputerConfig.empty() ? "" : " ") + config;
+    }
+    if(factories.size() == 1) {
+      outFactory = std::move(factories[0]);
+    } else {
+      outFactory = [factories, outputerConfigs](unsigned int iNLanes) -> std::unique_ptr<OutputerBase> {
+        std::vector<std::unique_ptr<OutputerBase>> outputers;
+        for(auto const& factory: factories) {
+          outputers.push_back(factory(iNLanes));
+          if(not outputers.back()) {
+            return {};
+          }
+        }
+        return std::make_unique<TeeOutputer>(outputerConfigs, std::move(outputers));
+      };
     }
   }
 
@@ -104,7 +1025,26 @@ int main(int argc, char* argv[]) {
     }
   }
 
-  {
+  std::optional<ElasticLaneController> elasticController;
+  if(not elasticLanes.empty()) {
+    if(activeLanes != 0) {
+      std::cout <<"--elastic-lanes can not be used with --active-lanes"<<std::endl;
+      return 1;
+    }
+    auto elasticConfig = parseElasticLaneConfig(elasticLanes, nLanes);
+    if(not elasticConfig) {
+      return 1;
+    }
+    elasticController.emplace(*elasticConfig);
+  }
+
+  if(discardWarmup) {
+    if(warmupEvents == 0) {
+      //the warm up event is taken from the real Source
+      warmupEvents = 1;
+    }
+  }
+  if(warmupEvents == 0) {
     //warm up the system by processing 1 event 
     tbb::task_arena arena(1);
     auto out = outFactory(1);
@@ -133,62 +1073,637 @@ int main(int argc, char* argv[]) {
   }
   std::cout <<"finished warmup"<<std::endl;
 
-  auto out = outFactory(nLanes);
-  auto source = sourceFactory(nLanes, nEvents);
+  if(not scanThreads.empty()) {
+    std::vector<ScanStep> steps;
+    for(auto threads: scanThreads) {
+      unsigned int lanes = lanesGiven ? nLanes : threads;
+      std::cout <<"scan: "<<threads<<" threads "<<lanes<<" lanes"<<std::endl;
+      auto step = runScanStep(threads, lanes, prefetchDepth, indexChunkSize, nEvents, warmupEvents, std::chrono::duration<double>(duration),
+                              sourceFactory, outFactory, waiterFactory);
+      if(not step) {
+        return 1;
+      }
+      steps.push_back(*step);
+    }
+    std::cout <<"Source "<<sourceConfig<<"\n"
+              <<"Outputer "<<outputerConfig<<"\n"
+              <<"Waiter "<<waiterConfig<<"\n"
+              <<"allocator "<<allocatorName()<<"\n";
+    printScan(steps);
+    if(not reportFile.empty()) {
+      RunReport report;
+      auto& job = report.section("job");
+      job.set("source", sourceConfig);
+      job.set("outputer", outputerConfig);
+      job.set("waiter", waiterConfig);
+      job.set("prefetchDepth", prefetchDepth);
+      job.set("allocator", allocatorName());
+      reportScan(report.section("scan"), steps);
+      std::ofstream file(reportFile);
+      report.write(file);
+      file <<"\n";
+      if(not file) {
+        std::cout <<"failed to write report "<<reportFile<<std::endl;
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  //each Lane needs one Source, Waiter and Outputer lane per event it can hold
+  unsigned int const nSourceLanes = nLanes*prefetchDepth;
+  auto out = outFactory(nSourceLanes);
+  auto source = sourceFactory(nSourceLanes, sourceEventLimit(nEvents, warmupEvents));
   std::unique_ptr<WaiterBase> waiter;
   if(waiterFactory) {
-    waiter = waiterFactory(nLanes, source->numberOfDataProducts());
+    waiter = waiterFactory(nSourceLanes, source->numberOfDataProducts());
     if(not waiter) {
       std::cout <<"failed to create Waiter "<<waiterConfig<<std::endl;
       return 1;
     }
   }
+  //With NUMA, each node gets its own arena and Lanes are dealt out round robin
+  // to the nodes. The Lanes are set up from within their arena so memory first
+  // touched during setup is placed on the Lane's node.
+  std::vector<tbb::task_arena> arenas;
+  if(useNUMA) {
+    auto nodes = tbb::info::numa_nodes();
+    arenas.reserve(nodes.size());
+    unsigned int const nNodes = nodes.size();
+    for(unsigned int n = 0; n < nNodes; ++n) {
+      int nodeParallelism = parallelism / nNodes + ( (n < parallelism % nNodes) ? 1 : 0);
+      arenas.emplace_back(tbb::task_arena::constraints(nodes[n], std::max(nodeParallelism,1)));
+    }
+  } else {
+    arenas.emplace_back(parallelism);
+  }
+  //the reads of each arena go to a low priority arena with the same threads
+  std::vector<tbb::task_arena> readArenas;
+  if(drainFirst) {
+    readArenas.reserve(arenas.size());
+    if(useNUMA) {
+      auto nodes = tbb::info::numa_nodes();
+      for(unsigned int n = 0; n < arenas.size(); ++n) {
+        readArenas.emplace_back(tbb::task_arena::constraints(nodes[n], arenas[n].max_concurrency()), 0, tbb::task_arena::priority::low);
+      }
+    } else {
+      readArenas.emplace_back(parallelism, 0, tbb::task_arena::priority::low);
+    }
+  }
+  //counts the workers going to ROOT's IMT arena, the harness arenas' joins are taken from those of all arenas
+  std::optional<ArenaJoinCounter> allArenaJoins;
+  std::vector<std::unique_ptr<ArenaJoinCounter>> harnessArenaJoins;
+  std::vector<unsigned int> laneToArena(nLanes);
+  for(unsigned int i = 0; i< nLanes; ++i) {
+    laneToArena[i] = i % arenas.size();
+  }
+
+  if(coroutineLanes and (prefetchDepth > 1 or drainFirst or batchEvents)) {
+    std::cout <<"--coroutine-lanes can not be used with --prefetch-depth > 1, --drain-first or --batch-events"<<std::endl;
+    return 1;
+  }
+  std::optional<ActiveLaneLimit> activeLaneLimit;
+  if(elasticController) {
+    activeLaneLimit.emplace(elasticController->activeLanes());
+  } else if(activeLanes != 0 and activeLanes < nLanes) {
+    activeLaneLimit.emplace(activeLanes);
+  }
+
+  std::atomic<bool> stopLanes{false};
   lanes.reserve(nLanes);
   for(unsigned int i = 0; i< nLanes; ++i) {
-    lanes.emplace_back(i, source.get(), waiter.get());
-    out->setupForLane(i, lanes.back().dataProducts());
+    auto& arena = arenas[laneToArena[i]];
+    auto readArena = drainFirst ? &readArenas[laneToArena[i]] : nullptr;
+    arena.execute([&lanes, &source, &waiter, &out, &stopLanes, &arena, &activeLaneLimit, readArena, i, indexChunkSize, prefetchDepth, coroutineLanes, batchEvents]() {
+        lanes.emplace_back(i, source.get(), waiter.get(), prefetchDepth);
+        auto& lane = lanes.back();
+        if(readArena) {
+          lane.setArenas(&arena, readArena);
+        }
+        if(activeLaneLimit) {
+          lane.setActiveLaneLimit(&*activeLaneLimit);
+        }
+#if defined(TF_ENABLE_COROUTINES)
+        lane.setUseCoroutine(coroutineLanes);
+#endif
+        lane.setBatchEvents(batchEvents);
+        lane.setIndexChunkSize(indexChunkSize);
+        lane.setStopFlag(&stopLanes);
+      });
+  }
+  //receives the warm up events when they are not to be written
+  std::unique_ptr<OutputerBase> warmupOut;
+  if(discardWarmup) {
+    warmupOut = outputerFactoryGenerator("SerializeOutputer", "")(nSourceLanes);
+    out->setFirstEventIndex(warmupEvents);
+  }
+  if(auto order = neededProductOrder(*source, waiter.get(), {out.get(), warmupOut.get()})) {
+    std::cout <<"data products used: "<<order->size()<<" of "<<source->numberOfDataProducts()<<std::endl;
+    source->setNeededProducts(*order);
+    for(auto& lane: lanes) {
+      lane.setNeededProducts(*order);
+    }
+  }
+  for(auto* pOutputer: {out.get(), warmupOut.get()}) {
+    if(not pOutputer) {
+      continue;
+    }
+    auto setupLane = [pOutputer](Lane const& iLane) {
+      for(unsigned int slot = 0; slot < iLane.numberOfSlots(); ++slot) {
+        pOutputer->setupForLane(iLane.sourceLaneIndex(slot), iLane.dataProducts(slot));
+      }
+    };
+    bool const parallelSetup = pOutputer->setupForLaneIsThreadSafe();
+    for(unsigned int iArena = 0; iArena < arenas.size(); ++iArena) {
+      //the memory of each Lane's Outputer state is allocated from the threads of its arena
+      arenas[iArena].execute([&lanes, &laneToArena, &setupLane, parallelSetup, iArena]() {
+          auto setupIfInArena = [&](unsigned int i) {
+            if(laneToArena[i] == iArena) {
+              setupLane(lanes[i]);
+            }
+          };
+          if(parallelSetup) {
+            tbb::parallel_for(0U, static_cast<unsigned int>(lanes.size()), setupIfInArena);
+          } else {
+            for(unsigned int i = 0; i < lanes.size(); ++i) {
+              setupIfInArena(i);
+            }
+          }
+        });
+    }
   }
 
   std::atomic<long> ievt{0};
-  
-  tbb::task_arena arena(parallelism);
-
+  std::unique_ptr<ClusterIndexClaimer> clusterClaimer;
+  if(clusterClaim != 0) {
+    clusterClaimer = std::make_unique<ClusterIndexClaimer>(*source, ievt, clusterClaim);
+    for(auto& lane: lanes) {
+      lane.setIndexClaimer(clusterClaimer.get());
+    }
+  }
   decltype(std::chrono::high_resolution_clock::now()) start;
+  std::vector<decltype(start)> laneFinished(nLanes);
   auto pOut = out.get();
-  arena.execute([&lanes, &ievt, pOut, &start]() {
-    std::vector<tbb::task_group> groups(lanes.size());
-    start = std::chrono::high_resolution_clock::now();
-    auto itGroup = groups.begin();
-    {
-      for(auto& lane: lanes) {
-        auto& group = *itGroup;
-        TaskHolder finalTask(group, make_functor_task([&group, task=group.defer([](){})]() mutable { group.run(std::move(task)); }));
-        group.run([&, ft=std::move(finalTask)]() {lane.processEventsAsync(ievt, group, *pOut, std::move(ft));});
-        ++itGroup;
-      }
+  std::vector<tbb::task_group> groups(lanes.size());
+  auto processEvents = [&lanes, &groups, &laneToArena, &laneFinished, &ievt, &arenas](OutputerBase const* pOut) {
+    for(unsigned int iArena = 0; iArena < arenas.size(); ++iArena) {
+      arenas[iArena].execute([&lanes, &groups, &laneToArena, &laneFinished, &ievt, pOut, iArena]() {
+        for(unsigned int i = 0; i < lanes.size(); ++i) {
+          if(laneToArena[i] != iArena) {
+            continue;
+          }
+          auto& lane = lanes[i];
+          auto& group = groups[i];
+          TaskHolder finalTask(group, make_functor_task([&group, &finished = laneFinished[i], task=group.defer([](){})]() mutable {
+                finished = std::chrono::high_resolution_clock::now();
+                group.run(std::move(task)); }));
+          group.run([&, ft=std::move(finalTask)]() {lane.processEventsAsync(ievt, group, *pOut, std::move(ft));});
+        }
+      });
     }
     //be sure all groups have fully finished
-    for(auto& group: groups) {
-      group.wait();
+    for(unsigned int i = 0; i < lanes.size(); ++i) {
+      arenas[laneToArena[i]].execute([&group = groups[i]]() { group.wait(); });
+    }
+  };
+
+  if(warmupEvents != 0) {
+    std::cout <<"begin warmup of "<<warmupEvents<<" events"<<std::endl;
+    for(auto& lane: lanes) {
+      lane.setEndIndex(warmupEvents);
+    }
+    processEvents(warmupOut ? warmupOut.get() : pOut);
+    for(auto& lane: lanes) {
+      lane.setEndIndex(std::numeric_limits<long>::max());
+      lane.resetStatistics();
+    }
+    //the indices claimed beyond the end of the warm up were not used
+    ievt = warmupEvents;
+    std::cout <<"finished warmup"<<std::endl;
+  }
+
+  auto const unpooledAllocationsAtStart = TaskPool::unpooledAllocations();
+  auto const inlineContinuationsAtStart = TaskHolder::inlineContinuations();
+
+  if(not traceFile.empty()) {
+    Tracer::enable();
+  }
+  if(usePerfCounters and not PerfCounters::enable()) {
+    std::cout <<"hardware performance counters are not available, --perf-counters is ignored"<<std::endl;
+  }
+
+#if defined(TF_ENABLE_MPI)
+  std::unique_ptr<MPIEventDistributor> mpiDistributor;
+  if(mpi) {
+    long const laneChunk = lanes[0].indexChunkSize();
+    long batch = mpiBatch != 0 ? mpiBatch : 4*laneChunk*static_cast<long>(nLanes);
+    batch = (batch+laneChunk-1)/laneChunk*laneChunk;
+    //each rank did its own warm up with the indices before warmupEvents.
+    // Making the counter waits for all ranks so they start together.
+    mpiDistributor = std::make_unique<MPIEventDistributor>(*mpi, warmupEvents, batch);
+    for(auto& lane: lanes) {
+      lane.setIndexClaimer(mpiDistributor.get());
     }
-  });
+  }
+#endif
+  if(useIMT) {
+    allArenaJoins.emplace();
+    for(auto* harnessArenas: {&arenas, &readArenas}) {
+      for(auto& arena: *harnessArenas) {
+        harnessArenaJoins.push_back(std::make_unique<ArenaJoinCounter>(arena));
+      }
+    }
+  }
+  evictInputFiles();
+  start = std::chrono::high_resolution_clock::now();
+  std::optional<StopTimer> stopTimer;
+  stopTimer.emplace(std::chrono::duration<double>(duration), stopLanes);
+
+  std::vector<Sample> samples;
+  std::mutex samplerMutex;
+  std::condition_variable samplerCondition;
+  bool stopSampler = false;
+  std::thread sampler;
+  if(sampleInterval != 0) {
+    sampler = std::thread([&]() {
+        auto const interval = std::chrono::milliseconds(sampleInterval);
+        auto last = start;
+        unsigned long long lastEvents = 0;
+        std::unique_lock<std::mutex> lock(samplerMutex);
+        while(not samplerCondition.wait_for(lock, interval, [&stopSampler]() { return stopSampler; })) {
+          auto now = std::chrono::high_resolution_clock::now();
+          unsigned long long events = 0;
+          for(auto const& lane: lanes) {
+            events += lane.eventLatencies().count();
+          }
+          auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - last).count();
+          samples.push_back({std::chrono::duration_cast<std::chrono::milliseconds>(now - start),
+                             elapsed == 0 ? 0. : (events - lastEvents)*1.e6/elapsed, residentBytes()});
+          last = now;
+          lastEvents = events;
+        }
+      });
+  }
+
+  //changes the number of active Lanes at the end of each interval
+  std::mutex elasticMutex;
+  std::condition_variable elasticCondition;
+  bool stopElastic = false;
+  std::thread elastic;
+  if(elasticController) {
+    elastic = std::thread([&]() {
+        auto const interval = elasticController->config().interval_;
+        auto last = start;
+        unsigned long long lastEvents = 0;
+        std::unique_lock<std::mutex> lock(elasticMutex);
+        while(not elasticCondition.wait_for(lock, interval, [&stopElastic]() { return stopElastic; })) {
+          auto now = std::chrono::high_resolution_clock::now();
+          unsigned long long events = 0;
+          for(auto const& lane: lanes) {
+            events += lane.eventLatencies().count();
+          }
+          auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - last).count();
+          double const rate = elapsed == 0 ? 0. : (events - lastEvents)*1.e6/elapsed;
+          auto const before = elasticController->activeLanes();
+          auto const active = elasticController->update(std::chrono::duration_cast<std::chrono::milliseconds>(now - start), rate, residentBytes());
+          if(active != before) {
+            activeLaneLimit->setNTokens(active);
+            std::cout <<"elastic lanes: "<<before<<" -> "<<active<<" after "<<rate<<" events/s"<<std::endl;
+          }
+          last = now;
+          lastEvents = events;
+        }
+      });
+  }
+
+  processEvents(pOut);
 
   std::chrono::microseconds eventTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now()-start);
+  //taken before the end of job work of the components changes the memory use
+  auto const endResidentBytes = residentBytes();
+  auto const peakResident = peakResidentBytes();
+  stopTimer.reset();
+  unsigned long long imtArenaJoins = 0;
+  if(allArenaJoins) {
+    imtArenaJoins = allArenaJoins->joins();
+    for(auto const& joins: harnessArenaJoins) {
+      imtArenaJoins -= std::min(imtArenaJoins, joins->joins());
+    }
+    allArenaJoins.reset();
+    harnessArenaJoins.clear();
+  }
+  if(sampler.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(samplerMutex);
+      stopSampler = true;
+    }
+    samplerCondition.notify_one();
+    sampler.join();
+  }
+  if(elastic.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(elasticMutex);
+      stopElastic = true;
+    }
+    elasticCondition.notify_one();
+    elastic.join();
+  }
 
-  //NOTE: each lane will go 1 beyond the # events so ievt is more then the # events
+  //the Outputer writes what it still holds and closes its files. Each Outputer of a
+  // TeeOutputer, or shard of a ShardedOutputer, does so in its own tasks.
+  auto const endOfJobStart = std::chrono::high_resolution_clock::now();
+  arenas[0].execute([pOut]() {
+      tbb::task_group group;
+      pOut->finishAsync(TaskHolder(group, make_functor_task([](){})));
+      group.wait();
+    });
+  auto const endOfJobTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now()-endOfJobStart);
+
+  //NOTE: each lane will go beyond the # events so ievt is more then the # events
+  unsigned long long nEventsProcessed = 0;
+  LatencyHistogram latencies;
+  for(auto const& lane: lanes) {
+    nEventsProcessed += lane.numberOfEventsProcessed();
+    latencies.add(lane.eventLatencies());
+  }
+#if defined(TF_ENABLE_MPI)
+  std::optional<MPISession::RankTotals> mpiTotals;
+  std::optional<SilenceCout> silence;
+  if(mpi) {
+    mpiTotals = mpi->gather(nEventsProcessed, eventTime);
+    //only rank 0 prints the summary and writes the trace and the report
+    if(mpi->rank() != 0) {
+      silence.emplace();
+      traceFile.clear();
+      reportFile.clear();
+    }
+  }
+#endif
   std::cout <<"----------"<<std::endl;
   std::cout <<"Source "<<sourceConfig<<"\n"
             <<"Outputer "<<outputerConfig<<"\n"
 	    <<"Waiter "<<waiterConfig<<"\n"
 	    <<"# threads "<<parallelism<<"\n"
 	    <<"# concurrent events "<<nLanes <<"\n"
-	    <<"use ROOT IMT "<< (useIMT? "true\n":"false\n");
+	    <<"index chunk size "<<indexChunkSize<<"\n"
+	    <<"cluster claim "<<clusterClaim<<"\n"
+	    <<"prefetch depth "<<prefetchDepth<<"\n"
+	    <<"batch events "<< (batchEvents? "true\n":"false\n")
+	    <<"inline continuations "<< (inlineContinuations? "true\n":"false\n")
+	    <<"queue timing "<< (SerialTaskQueue::timingEnabled()? "true\n":"false\n")
+	    <<"profile used "<<useProfile<<"\n"
+	    <<"direct I/O "<< (directIO? "true\n":"false\n")
+	    <<"evicted from page cache "<<evictedFiles<<"\n"
+	    <<"warmup events "<<warmupEvents<<"\n"
+	    <<"duration limit "<<duration<<"s\n"
+	    <<"# NUMA nodes "<< (useNUMA ? arenas.size() : 0) <<"\n"
+	    <<"active lanes "<< (activeLaneLimit ? activeLaneLimit->nTokens() : nLanes) <<"\n"
+	    <<"drain first "<< (drainFirst? "true\n":"false\n")
+	    <<"coroutine lanes "<< (coroutineLanes? "true\n":"false\n")
+	    <<"use ROOT IMT "<< (useIMT? "true (scope "+name(*imtScope)+")\n":"false\n");
+  if(useIMT) {
+    std::cout <<"ROOT IMT arena worker joins: "<<imtArenaJoins<<" sources: "<<(rootIMTForSources() ? "on" : "off")
+              <<" outputers: "<<(rootIMTForOutputers() ? "on" : "off")<<"\n";
+  }
   std::cout <<"Event processing time: "<<eventTime.count()<<"us"<<std::endl;
-  std::cout <<"number events: "<<ievt.load() -nLanes<<std::endl;
+  std::cout <<"Outputer end of job time: "<<endOfJobTime.count()<<"us"<<std::endl;
+  std::cout <<"number events: "<<nEventsProcessed<<std::endl;
+  if(clusterClaimer) {
+    std::cout <<"cluster claims: "<<clusterClaimer->nClaims()<<std::endl;
+  }
+#if defined(TF_ENABLE_MPI)
+  if(mpi) {
+    std::cout <<"MPI ranks: "<<mpi->size()<<" batch size: "<<mpiDistributor->batchSize()
+              <<" number events all ranks: "<<mpiTotals->totalEvents()
+              <<" slowest rank time: "<<mpiTotals->maxEventTime_us()<<"us"
+              <<" aggregate rate: "<<mpiTotals->aggregateEventRate()<<" events/s\n";
+    for(int rank = 0; rank < mpi->size(); ++rank) {
+      std::cout <<" rank "<<rank<<" number events: "<<mpiTotals->events_[rank]<<" time: "<<mpiTotals->eventTimes_us_[rank]<<"us\n";
+    }
+    std::cout <<std::flush;
+  }
+#endif
+  std::cout <<"event latency: mean "<<latencies.mean()/1000.<<"us p50 "<<latencies.percentile(0.5)/1000.
+            <<"us p99 "<<latencies.percentile(0.99)/1000.<<"us p99.9 "<<latencies.percentile(0.999)/1000.
+            <<"us max "<<latencies.max()/1000.<<"us"<<std::endl;
+  std::cout <<"resident memory: peak "<<peakResident/(1024*1024)<<"MB at end of events "<<endResidentBytes/(1024*1024)
+            <<"MB peak per thread "<<peakResident/(1024*1024)/parallelism<<"MB allocator "<<allocatorName()<<std::endl;
+  if(not samples.empty()) {
+    std::cout <<"timeline:\n   time(ms)   events/s   RSS(MB)\n";
+    for(auto const& sample: samples) {
+      std::cout <<std::setw(11)<<sample.time_.count()<<std::setw(11)<<std::lround(sample.eventRate_)
+                <<std::setw(10)<<sample.residentBytes_/(1024*1024)<<"\n";
+    }
+    std::cout <<std::flush;
+  }
+  if(activeLaneLimit) {
+    std::cout <<"number events parked: "<<activeLaneLimit->nParked()<<" most lanes parked: "<<activeLaneLimit->maxParked()
+              <<" parked time: "<<activeLaneLimit->parkedTime().count()<<"us"<<std::endl;
+  }
+  if(elasticController) {
+    elasticController->printSummary();
+  }
+  if(threadPinner) {
+    threadPinner->printSummary();
+  }
+  if(prefetchDepth > 1) {
+    unsigned long long nPrefetched = 0;
+    for(auto const& lane: lanes) {
+      nPrefetched += lane.numberOfPrefetchedEvents();
+    }
+    std::cout <<"number events read while Lane was busy: "<<nPrefetched<<std::endl;
+  }
+  if(useNUMA) {
+    for(unsigned int iArena = 0; iArena < arenas.size(); ++iArena) {
+      unsigned long long nodeEvents = 0;
+      auto nodeFinished = start;
+      unsigned int nodeLanes = 0;
+      for(unsigned int i = 0; i < lanes.size(); ++i) {
+        if(laneToArena[i] == iArena) {
+          nodeEvents += lanes[i].numberOfEventsProcessed();
+          nodeFinished = std::max(nodeFinished, laneFinished[i]);
+          ++nodeLanes;
+        }
+      }
+      auto nodeTime = std::chrono::duration_cast<std::chrono::microseconds>(nodeFinished - start);
+      std::cout <<"NUMA node "<<iArena<<": # lanes "<<nodeLanes<<" # threads "<<arenas[iArena].max_concurrency()
+                <<" number events: "<<nodeEvents<<" time: "<<nodeTime.count()<<"us";
+      if(nodeTime.count() != 0) {
+        std::cout <<" rate: "<< nodeEvents*1.e6/nodeTime.count() <<" events/s";
+      }
+      std::cout <<std::endl;
+    }
+  }
+  {
+    unsigned long long heapAllocations = 0;
+    unsigned long long reusedAllocations = 0;
+    for(auto const& lane: lanes) {
+      heapAllocations += lane.taskPool().heapAllocations();
+      reusedAllocations += lane.taskPool().reusedAllocations();
+    }
+    std::cout <<"Lane task pool heap allocations: "<<heapAllocations<<" reused: "<<reusedAllocations<<"\n"
+              <<"unpooled task allocations: "<<TaskPool::unpooledAllocations()-unpooledAllocationsAtStart<<std::endl;
+    if(inlineContinuations) {
+      std::cout <<"tasks run inline after the task which made them ready: "<<TaskHolder::inlineContinuations()-inlineContinuationsAtStart<<std::endl;
+    }
+  }
   std::cout <<"----------"<<std::endl;
 
   source->printSummary();
   out->printSummary();
+  if(PerfCounters::enabled()) {
+    PerfCounters::printSummary(std::cout);
+  }
+  if(storageEmulator()) {
+    storageEmulator()->printSummary();
+  }
+  if(blockCache()) {
+    blockCache()->printSummary();
+  }
+  if(pds::useHugePages()) {
+    std::cout <<"huge page buffers: "<<pds::nHugePageBuffers()<<" bytes: "<<pds::hugePageBufferBytes()<<std::endl;
+  }
+  if(pds::directIO()) {
+    std::cout <<"O_DIRECT files: "<<pds::nDirectIOFiles()<<" read through the page cache instead: "<<pds::nDirectIOFallbacks()<<std::endl;
+  }
+
+  if(not writeProfile.empty()) {
+    ProductProfile profile;
+    out->fillProfile(profile);
+    std::ofstream file(writeProfile);
+    profile.write(file);
+    if(not file) {
+      std::cout <<"failed to write profile "<<writeProfile<<std::endl;
+      return 1;
+    }
+    std::cout <<"data products profiled: "<<profile.entries().size()<<std::endl;
+  }
+
+  if(not traceFile.empty()) {
+    std::ofstream file(traceFile);
+    Tracer::write(file);
+    if(not file) {
+      std::cout <<"failed to write trace "<<traceFile<<std::endl;
+      return 1;
+    }
+  }
+
+  if(not reportFile.empty()) {
+    RunReport report;
+    auto& job = report.section("job");
+    job.set("source", sourceConfig);
+    job.set("outputer", outputerConfig);
+    job.set("waiter", waiterConfig);
+    job.set("threads", parallelism);
+    job.set("concurrentEvents", nLanes);
+    job.set("indexChunkSize", indexChunkSize);
+    job.set("clusterClaim", clusterClaim);
+    job.set("prefetchDepth", prefetchDepth);
+    job.set("batchEvents", batchEvents);
+    job.set("warmupEvents", warmupEvents);
+    job.set("duration_s", duration);
+    job.set("numaNodes", useNUMA ? arenas.size() : 0);
+    job.set("affinity", affinity);
+    job.set("ioCores", ioCores);
+    job.set("activeLanes", activeLaneLimit ? activeLaneLimit->nTokens() : nLanes);
+    job.set("drainFirst", drainFirst);
+    job.set("coroutineLanes", coroutineLanes);
+    job.set("inlineContinuations", inlineContinuations);
+    job.set("queueTiming", SerialTaskQueue::timingEnabled());
+    job.set("useProfile", useProfile);
+    job.set("directIO", directIO);
+    job.set("evictCache", evictedFiles);
+    job.set("writeProfile", writeProfile);
+    job.set("useIMT", useIMT);
+    if(useIMT) {
+      job.set("imtScope", name(*imtScope));
+      report.set("imtArenaJoins", imtArenaJoins);
+    }
+    report.set("eventProcessingTime_us", eventTime.count());
+    report.set("outputerEndOfJobTime_us", endOfJobTime.count());
+    report.set("events", nEventsProcessed);
+    if(eventTime.count() != 0) {
+      report.set("eventRate", nEventsProcessed*1.e6/eventTime.count());
+    }
+    {
+      auto& latency = report.section("eventLatency");
+      latency.set("mean_us", latencies.mean()/1000.);
+      latency.set("p50_us", latencies.percentile(0.5)/1000.);
+      latency.set("p99_us", latencies.percentile(0.99)/1000.);
+      latency.set("p999_us", latencies.percentile(0.999)/1000.);
+      latency.set("max_us", latencies.max()/1000.);
+    }
+#if defined(TF_ENABLE_MPI)
+    if(mpi) {
+      auto& ranks = report.section("mpi");
+      ranks.set("ranks", mpi->size());
+      ranks.set("batchSize", mpiDistributor->batchSize());
+      ranks.set("events", mpiTotals->totalEvents());
+      ranks.set("maxEventProcessingTime_us", mpiTotals->maxEventTime_us());
+      ranks.set("aggregateEventRate", mpiTotals->aggregateEventRate());
+      ranks.set("rankEvents", mpiTotals->events_);
+      ranks.set("rankEventProcessingTime_us", mpiTotals->eventTimes_us_);
+    }
+#endif
+    {
+      auto& memory = report.section("memory");
+      memory.set("peakResidentBytes", peakResident);
+      memory.set("endResidentBytes", endResidentBytes);
+      memory.set("peakResidentBytesPerThread", peakResident/parallelism);
+      memory.set("allocator", allocatorName());
+    }
+    if(activeLaneLimit) {
+      auto& parking = report.section("parkedLanes");
+      parking.set("events", activeLaneLimit->nParked());
+      parking.set("maxLanes", activeLaneLimit->maxParked());
+      parking.set("time_us", activeLaneLimit->parkedTime().count());
+    }
+    if(inlineContinuations) {
+      report.section("tasks").set("inlineContinuations", TaskHolder::inlineContinuations()-inlineContinuationsAtStart);
+    }
+    if(elasticController) {
+      elasticController->fillReport(report.section("elasticLanes"));
+    }
+    if(threadPinner) {
+      threadPinner->fillReport(report.section("affinity"));
+    }
+    if(not ioCores.empty()) {
+      fillDedicatedThreadReport(report.section("ioCores"));
+    }
+    if(not samples.empty()) {
+      std::vector<double> times, rates, rss;
+      for(auto const& sample: samples) {
+        times.push_back(sample.time_.count());
+        rates.push_back(sample.eventRate_);
+        rss.push_back(sample.residentBytes_);
+      }
+      auto& timeline = report.section("timeline");
+      timeline.set("time_ms", times);
+      timeline.set("eventRate", rates);
+      timeline.set("residentBytes", rss);
+    }
+    source->fillReport(report.section("source"));
+    out->fillReport(report.section("outputer"));
+    if(waiter) {
+      waiter->fillReport(report.section("waiter"));
+    }
+    if(PerfCounters::enabled()) {
+      PerfCounters::fillReport(report.section("perfCounters"));
+    }
+    if(storageEmulator()) {
+      storageEmulator()->fillReport(report.section("storageEmulation"));
+    }
+    if(blockCache()) {
+      blockCache()->fillReport(report.section("blockCache"));
+    }
+    std::ofstream file(reportFile);
+    report.write(file);
+    file <<"\n";
+    if(not file) {
+      std::cout <<"failed to write report "<<reportFile<<std::endl;
+      return 1;
+    }
+  }
 
   return 0;
 }
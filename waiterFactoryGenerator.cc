@@ -8,12 +8,19 @@ cce::tf::waiterFactoryGenerator(std::string_view iType, std::string_view iOption
   std::function<std::unique_ptr<WaiterBase>(unsigned int, std::size_t)> waitFactory;
 
   auto keyValues = cce::tf::configKeyValuePairs(iOptions);
-  waitFactory = [type=std::string(iType), params=ConfigurationParameters(keyValues)](unsigned int iNLanes, size_t iNDataProducts) {
+  waitFactory = [type=std::string(iType), keyValues](unsigned int iNLanes, size_t iNDataProducts) {
+    //each call starts with all parameters unused, e.g. when --scan-threads remakes the component
+    ConfigurationParameters params(keyValues);
     auto maker = WaiterFactory::get()->create(type, iNLanes, iNDataProducts, params);
     if(not maker) {
       return maker;
     }
-    
+    //any Waiter can declare the data products it waits on
+    if(auto products = params.get<std::string>("products")) {
+      maker->setNeededProducts(ProductNeeds(*products));
+    }
+
+
     //make sure all parameters given were used
     auto unusedOptions = params.unusedKeys();
     if(not unusedOptions.empty()) {